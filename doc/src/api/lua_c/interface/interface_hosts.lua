@@ -58,6 +58,11 @@ function interface.getHostInfo(string host_ip, int vlan_id=nil)
 --! @return the host country code on success, nil otherwise.
 function interface.getHostCountry(string host_ip)
 
+--! @brief Get the memory used by a local host, broken down by sub-structure (bytes).
+--! @param host_ip host/host@vlan.
+--! @return table with the memory usage on success, nil otherwise (or for remote hosts).
+function interface.getHostMemoryUsage(string host_ip)
+
 --! @brief Search hosts by name, ip or other information.
 --! @param query the string to use.
 --! @return the found hosts information on success, nil otherwise.
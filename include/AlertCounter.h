@@ -41,7 +41,7 @@ class AlertCounter {
   u_int16_t trailing_window_min;
   u_int16_t trailing_window_max_since_hits_reset;
   u_int8_t  trailing_index;
-  bool hits_reset_req;
+  std::atomic<bool> hits_reset_req; /* Set by the host checks, served by inc() on the packet thread */
   
   void reset_window(time_t when = 0);
 
@@ -24,36 +24,56 @@
 
 #include "ntop_includes.h"
 
-class AlertFifoQueue : public FifoQueue<AlertFifoItem> {
+/*
+  Alert string shared by all the recipient queues the alert has been
+  enqueued to. It is freed when the last reference is released.
+*/
+class AlertFifoPayload {
+ private:
+  std::atomic<u_int32_t> num_refs;
+  char *alert;
+
+ public:
+  AlertFifoPayload(const char *_alert) { num_refs = 1; alert = _alert ? strdup(_alert) : NULL; };
+  ~AlertFifoPayload()                  { if(alert) free(alert); };
+
+  inline const char* get()     const { return(alert);         };
+  inline bool isValid()        const { return(alert != NULL); };
+  inline void incRefs()              { num_refs++;            };
+  inline void decRefs()              { if(--num_refs == 0) delete this; };
+};
+
+/*
+  Bounded lockless ring of alert notifications. Several producers (the
+  interfaces enqueueing flow/host alerts and the Lua VMs) can enqueue
+  concurrently, a single consumer at a time dequeues in batches.
+*/
+class AlertFifoQueue {
+ private:
+  BoundedRing<AlertFifoItem> ring;
+  u_int64_t dequeue_pos; /* Only accessed by the consumer */
+  std::atomic<u_int64_t> num_enqueued, num_not_enqueued, num_dequeued;
+
  public:
-  AlertFifoQueue(u_int32_t queue_size) : FifoQueue<AlertFifoItem>(queue_size) {}
-
-  ~AlertFifoQueue() {
-    while(!q.empty()) {
-      AlertFifoItem item = q.front();
-      q.pop();
-      free(item.alert);
-    }
-  }
-
-  AlertFifoItem dequeue() {
-    AlertFifoItem rv;
-
-    m.lock(__FILE__, __LINE__);
-
-    if(q.empty()) {
-      rv.alert_severity = alert_level_none;
-      rv.alert = NULL;
-    } else {
-      rv = q.front();
-      q.pop();
-      num_dequeued++;
-    }
-    m.unlock(__FILE__, __LINE__);
-
-    return(rv);
-  }
+  /**
+   * @param queue_size The number of notifications (rounded up to the next power of 2)
+   */
+  AlertFifoQueue(u_int32_t queue_size);
+  ~AlertFifoQueue();
+
+  /* Enqueues the notification taking a reference to the payload. Returns false if the queue is full */
+  bool enqueue(const AlertFifoItem* const notification, AlertFifoPayload *payload);
+
+  /*
+    Dequeues up to max_notifications notifications. The caller owns a
+    reference to the payload of each of them, to be released with decRefs().
+  */
+  u_int32_t dequeue(AlertFifoItem *notifications, u_int32_t max_notifications);
 
+  inline u_int32_t getLength()  const { return((u_int32_t)(num_enqueued - num_dequeued)); };
+  inline bool empty()           const { return(getLength() == 0); };
+  inline u_int8_t fillPct()     const { return(getLength() / (float)ring.getNumSlots() * 100); };
+  inline u_int64_t getNumNotEnqueued() const { return(num_not_enqueued); };
 };
 
 #endif /* _ALERT_FIFO_QUEUE_H */
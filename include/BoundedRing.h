@@ -0,0 +1,104 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _BOUNDED_RING_H_
+#define _BOUNDED_RING_H_
+
+#include "ntop_includes.h"
+
+/*
+  Slots of a bounded lockless MPMC queue (by D. Vyukov), shared by
+  DocumentRing and AlertFifoQueue. A slot with seq == pos is free for the
+  producer at pos, seq == pos + 1 means that it holds the item at pos, and
+  it becomes free again for pos + num_slots once released. Items are kept
+  in the slots, so buffers they point to can be reused. Consumers track
+  their own position.
+*/
+template <typename T> class BoundedRing {
+ private:
+  typedef struct {
+    std::atomic<u_int64_t> seq;
+    T item;
+  } bounded_ring_slot_t;
+
+  bounded_ring_slot_t *slots;
+  u_int32_t num_slots, mask;
+  std::atomic<u_int64_t> enqueue_pos;
+
+ public:
+  /**
+   * @param size The number of items (rounded up to the next power of 2)
+   */
+  BoundedRing(u_int32_t size) {
+    num_slots = Utils::pow2(size), mask = num_slots - 1;
+    enqueue_pos = 0;
+
+    /* Value-initialized: items start zeroed */
+    if((slots = new (std::nothrow) bounded_ring_slot_t[num_slots]()) == NULL)
+      throw std::bad_alloc();
+
+    for(u_int32_t i = 0; i < num_slots; i++)
+      slots[i].seq = i; /* Free for the producer at position i */
+  }
+
+  virtual ~BoundedRing() { delete[] slots; }
+
+  inline u_int32_t getNumSlots() const { return(num_slots); };
+
+  /* Item stored in the slot of position pos, whatever its state */
+  inline T* getItem(u_int64_t pos)             { return(&slots[pos & mask].item); };
+  inline const T* getItem(u_int64_t pos) const { return(&slots[pos & mask].item); };
+
+  /*
+    Takes the next position for a producer, returning its item to be filled
+    and then published. NULL when full: the oldest slot is still in use.
+  */
+  T* reserve(u_int64_t *pos) {
+    u_int64_t p = enqueue_pos.load(std::memory_order_relaxed);
+
+    while(true) {
+      bounded_ring_slot_t *s = &slots[p & mask];
+      int64_t diff = (int64_t)s->seq.load(std::memory_order_acquire) - (int64_t)p;
+
+      if(diff == 0) {
+	if(enqueue_pos.compare_exchange_weak(p, p + 1, std::memory_order_relaxed)) {
+	  *pos = p;
+	  return(&s->item);
+	}
+      } else if(diff < 0)
+	return(NULL);
+      else
+	p = enqueue_pos.load(std::memory_order_relaxed);
+    }
+  }
+
+  inline void publish(u_int64_t pos) { slots[pos & mask].seq.store(pos + 1, std::memory_order_release); };
+
+  /* False when the item at pos is not yet published (or the ring is empty) */
+  inline bool isPublished(u_int64_t pos) const {
+    return(slots[pos & mask].seq.load(std::memory_order_acquire) == pos + 1);
+  };
+
+  /* Frees the slot of the consumed item at pos */
+  inline void release(u_int64_t pos) { slots[pos & mask].seq.store(pos + num_slots, std::memory_order_release); };
+};
+
+#endif /* _BOUNDED_RING_H_ */
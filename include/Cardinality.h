@@ -29,36 +29,45 @@
 class Cardinality {
  private:
   struct ndpi_hll hll;
+  u_int8_t bits;
+
+  /* Registers are allocated on the first element added */
+  inline bool allocate() {
+    return(hll.registers || (bits && (ndpi_hll_init(&hll, bits) == 0)));
+  }
 
 public:
   Cardinality() {
     memset(&hll, 0, sizeof(hll));
+    bits = 0;
   }
   
   ~Cardinality() {
-    ndpi_hll_destroy(&hll);
+    if(hll.registers) ndpi_hll_destroy(&hll);
   }
 
-  void init(u_int8_t bits) {
-    if(ndpi_hll_init(&hll, bits))
-      throw "init error";
+  void init(u_int8_t _bits) {
+    bits = _bits;
   }
   
   void addElement(const char *value, size_t value_len) {
-    ndpi_hll_add(&hll, value, value_len);
+    if(allocate()) ndpi_hll_add(&hll, value, value_len);
   }
   
   void addElement(u_int32_t value) {
-    ndpi_hll_add_number(&hll, value);
+    if(allocate()) ndpi_hll_add_number(&hll, value);
   }
 
   u_int32_t getEstimate() {
-    return((u_int32_t)ndpi_hll_count(&hll));
+    return(hll.registers ? (u_int32_t)ndpi_hll_count(&hll) : 0);
   }
 
   void reset() {
-    memset(hll.registers, 0, hll.size); /* A lock might help here... */
+    if(hll.registers)
+      memset(hll.registers, 0, hll.size); /* A lock might help here... */
   }
+
+  inline u_int32_t getMemoryUsage() const { return(hll.registers ? hll.size : 0); }
 };
 
 #endif /* _CARDINALITY_H_ */
@@ -0,0 +1,86 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#ifndef _DOCUMENT_RING_H_
+#define _DOCUMENT_RING_H_
+
+#include "ntop_includes.h"
+
+/*
+  Fixed-size ring of serialized documents (e.g. flow JSONs) waiting to be
+  exported in bulk. Producers are lockless (several threads can enqueue,
+  e.g. the dumpers of the interfaces of a view) and copy the document into
+  a slot buffer that is kept and reused, so no allocation takes place in
+  steady state. Consumers claim a batch of consecutive documents, read them
+  in place and release them when done: several batches can be in flight at
+  the same time and can be released in any order.
+*/
+class DocumentRing {
+ private:
+  typedef struct {
+    char *doc;
+    u_int32_t len, size;
+  } document_ring_doc_t;
+
+  BoundedRing<document_ring_doc_t> ring;
+  u_int64_t dequeue_pos; /* Protected by claim_lock */
+  Mutex claim_lock;
+  Condvar not_empty;
+  u_int32_t wakeup_threshold;
+  std::atomic<u_int64_t> num_enqueued, num_claimed;
+
+ public:
+  /**
+   * @param size The number of documents (rounded up to the next power of 2)
+   * @param _wakeup_threshold Number of queued documents that wakes up a waiting consumer
+   */
+  DocumentRing(u_int32_t size, u_int32_t _wakeup_threshold);
+  ~DocumentRing();
+
+  /* Copies the document into the ring. Returns false if the ring is full or on allocation failure */
+  bool enqueue(const char *doc, u_int32_t len);
+
+  /* Number of documents enqueued and not claimed yet */
+  inline u_int32_t getNumQueued() const { return((u_int32_t)(num_enqueued - num_claimed)); };
+
+  /*
+    Claims up to max_docs documents (and max_bytes, unless a single document
+    is larger), returning their number and the position of the first one.
+    doc_overhead is added to the length of each document (e.g. a bulk header).
+    Returns 0 also when the next document is still being copied by its producer.
+  */
+  u_int32_t claim(u_int32_t max_docs, u_int32_t max_bytes, u_int32_t doc_overhead, u_int64_t *first_pos);
+  /* Document at position pos: valid until the batch it belongs to is released */
+  inline const char* getDocument(u_int64_t pos, u_int32_t *len) const {
+    const document_ring_doc_t *d = ring.getItem(pos);
+
+    *len = d->len;
+    return(d->doc);
+  };
+  void release(u_int64_t first_pos, u_int32_t num_docs);
+
+  /* Waits until the wakeup threshold is reached, or until the expiration */
+  inline void wait(struct timespec *expiration) { not_empty.timedWait(expiration); };
+  inline void wakeup()                          { not_empty.signalAll();           };
+};
+
+#endif /* _DOCUMENT_RING_H_ */
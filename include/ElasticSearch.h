@@ -26,10 +26,12 @@
 
 class ElasticSearch : public DB {
  private:
-  pthread_t esThreadLoop;
-  u_int num_queued_elems;
-  struct string_list *head, *tail;
-  Mutex listMutex;
+  pthread_t esThreadLoop, bulkThreads[ES_BULK_MAX_INFLIGHT - 1];
+  u_int8_t num_bulk_threads;
+  DocumentRing *queue;
+  std::atomic<u_int32_t> num_inflight_bulks;
+  std::atomic<u_int64_t> inflight_bytes;
+  Mutex statsMutex; /* Bulk threads update the exported and dropped flows */
   bool reportDrops;
   char *es_template_push_url, *es_version_query_url;
   char es_version[2];
@@ -49,10 +51,12 @@ class ElasticSearch : public DB {
     return ver && strcmp(ver, "6") >= 0;
   };
   void pushEStemplate();
+  void startBulkThreads();
   void indexESdata();
 
   virtual bool dumpFlow(time_t when, Flow *f, char *json);
   virtual bool startQueryLoop();
+  virtual void lua(lua_State* vm, bool since_last_checkpoint) const;
 };
 
 
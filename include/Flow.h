@@ -35,7 +35,7 @@ typedef struct {
 class FlowAlert;
 class FlowCheck;
 
-class Flow : public GenericHashEntry {
+class Flow : public GenericHashEntry, public PoolAllocated {
  private:
   Host *cli_host, *srv_host;
   IpAddress *cli_ip_addr, *srv_ip_addr;
@@ -91,6 +91,7 @@ class Flow : public GenericHashEntry {
   CounterTrend throughputTrend, goodputTrend, thptRatioTrend;
 #endif
   ndpi_protocol ndpiDetectedProtocol;
+  flow_index_refs_t *index_refs; /* Owned by the interface FlowIndexes, NULL when not indexed */
   custom_app_t custom_app;
   json_object *json_info;
   ndpi_serializer *tlv_info;
@@ -292,6 +293,8 @@ class Flow : public GenericHashEntry {
        u_int8_t *_view_cli_mac, u_int8_t *_view_srv_mac);
   ~Flow();
 
+  void set_hash_entry_state_idle();
+
   inline Bitmap128 getAlertsBitmap() const { return(alerts_map); }
 
   /* Enqueues an alert to all available flow recipients. */
@@ -383,6 +386,7 @@ class Flow : public GenericHashEntry {
   };
   inline const char* getServerCipherClass()  const { return(isTLS() ? cipher_weakness2str(protos.tls.ja3.server_unsafe_cipher) : NULL); }
   char* serialize(bool use_labels = false);
+  const char* serialize(JSONWriter *w, bool use_labels, u_int32_t *json_len = NULL);
   /* Prepares an alert JSON and puts int in the resulting `serializer`. */
   void alert2JSON(FlowAlert *alert, ndpi_serializer *serializer);
   json_object* flow2JSON();
@@ -516,6 +520,8 @@ class Flow : public GenericHashEntry {
   bool needsExtraDissection();
   bool hasDissectedTooManyPackets();
   bool get_partial_traffic_stats_view(PartializableFlowTrafficStats *delta, bool *first_partial);
+  /* TCP flows not established (or without payload) and unidirectional UDP flows, accounted when idle */
+  bool isIncomplete() const;
   bool update_partial_traffic_stats_db_dump();
   inline float get_pkts_thpt()           const { return(pkts_thpt_cli2srv + pkts_thpt_srv2cli);                   };
   inline float get_bytes_thpt()          const { return(bytes_thpt_cli2srv + bytes_thpt_srv2cli);                 };
@@ -526,6 +532,8 @@ class Flow : public GenericHashEntry {
   inline u_int32_t get_duration()        const { return((u_int32_t)(get_last_seen() - get_first_seen())); };
   inline char* get_protocol_name()       const { return(Utils::l4proto2name(protocol));   };
 
+  inline flow_index_refs_t* getIndexRefs() const { return(index_refs); };
+  inline void setIndexRefs(flow_index_refs_t *r) { index_refs = r;      };
   inline Host* get_cli_host()               const { return(cli_host);    };
   inline Host* get_srv_host()               const { return(srv_host);    };
   inline const IpAddress* get_cli_ip_addr() const { return(cli_ip_addr); };
@@ -588,6 +596,12 @@ class Flow : public GenericHashEntry {
   bool is_hash_entry_state_idle_transition_ready();
   void hosts_periodic_stats_update(NetworkInterface *iface, Host *cli_host, Host *srv_host, PartializableFlowTrafficStats *partial,
 				   bool first_partial, const struct timeval *tv) const;
+  /* The two halves of hosts_periodic_stats_update: stats shared with other hosts (interface, pools,
+     VLAN, networks, ASes...) and stats owned by cli_host and srv_host only */
+  void hosts_shared_stats_update(NetworkInterface *iface, Host *cli_host, Host *srv_host, PartializableFlowTrafficStats *partial,
+				 const struct timeval *tv) const;
+  void hosts_own_stats_update(Host *cli_host, Host *srv_host, PartializableFlowTrafficStats *partial,
+			      bool first_partial, const struct timeval *tv) const;
   void periodic_stats_update(const struct timeval *tv);
   void  set_hash_entry_id(u_int assigned_hash_entry_id);
   u_int get_hash_entry_id() const;
@@ -28,6 +28,20 @@ class FlowCheck : public Check {
  private:
   bool has_protocol_detected, has_periodic_update, has_flow_end, has_flow_begin;
 
+  /*
+    Flows the check can fire for: the executor does not call the check
+    hooks for the other flows
+  */
+  u_int8_t l4_protocols;               /* FLOW_CHECK_L4_* */
+  bool has_l7_filter;
+  NDPI_PROTOCOL_BITMASK l7_protocols;  /* Master or app protocols, if has_l7_filter */
+  ndpi_risk_enum required_risk;        /* Set by FlowChecksLoader, NDPI_NO_RISK if none */
+
+ protected:
+  /* To be called by the constructors of the checks bound to some protocols */
+  inline void setL4Protocols(u_int8_t _l4_protocols) { l4_protocols = _l4_protocols; };
+  void addL7Protocol(u_int16_t l7_proto);
+
  public:
   FlowCheck(NtopngEdition _edition, bool _packet_interface_only, bool _nedge_exclude, bool _nedge_only,
 	       bool _has_protocok_detected, bool _has_periodic_update, bool _has_flow_end, bool _has_flow_begin = false);
@@ -43,6 +57,16 @@ class FlowCheck : public Check {
   virtual FlowAlert *buildAlert(Flow *f) { return NULL; };
 
   void addCheck(std::list<FlowCheck*> *l, NetworkInterface *iface, FlowChecks check);
+
+  inline u_int8_t getL4Protocols()         const { return(l4_protocols);  };
+  inline bool hasL7Filter()                const { return(has_l7_filter); };
+  inline bool matchesL7Protocol(const ndpi_protocol *p) const {
+    NDPI_PROTOCOL_BITMASK *b = (NDPI_PROTOCOL_BITMASK*)&l7_protocols;
+
+    return(NDPI_ISSET(b, p->master_protocol) || NDPI_ISSET(b, p->app_protocol));
+  };
+  inline ndpi_risk_enum getRequiredRisk()  const { return(required_risk); };
+  inline void setRequiredRisk(ndpi_risk_enum r)  { required_risk = r;     };
   virtual bool loadConfiguration(json_object *config);
   
   virtual std::string getName()        const = 0;
@@ -26,19 +26,39 @@
 
 class Flow;
 
+/* A check bound to a hook, with the filters copied from the check and its cost */
+typedef struct {
+  FlowCheck *check;
+  u_int8_t l4_protocols;
+  bool has_l7_filter;
+  ndpi_risk_enum required_risk;
+  u_int64_t num_calls, num_skipped, num_ticks;
+} flow_check_entry_t;
+
 class FlowChecksExecutor { /* One instance per ntopng Interface */
  private:
   NetworkInterface *iface;
-  std::list<FlowCheck*> *protocol_detected, *periodic_update, *flow_end, *flow_begin;
+  /* Contiguous arrays of checks, one per hook (flow_check_protocol_detected ... flow_check_flow_begin) */
+  flow_check_entry_t *checks[flow_check_flow_none];
+  u_int16_t num_checks[flow_check_flow_none];
 
   void loadFlowChecksAlerts(std::list<FlowCheck*> *cb_list);
   void loadFlowChecks(FlowChecksLoader *fcl);
+  void loadHookChecks(FlowChecks c, std::list<FlowCheck*> *cb_list);
 
  public:
   FlowChecksExecutor(FlowChecksLoader *fcl, NetworkInterface *_iface);
   virtual ~FlowChecksExecutor();
 
+  /*
+    Runs the checks of the hook on a single flow: hooks fire inline with
+    the flow lifecycle (e.g. before the flow is dumped), so flows are not
+    batched into spans.
+  */
   FlowAlert *execChecks(Flow *f, FlowChecks c);
+
+  /* Per-check number of calls, of skipped flows and of CPU cycles spent in each hook */
+  void lua(lua_State *vm) const;
 };
 
 #endif /* _FLOW_CHECKS_EXECUTOR_H_ */
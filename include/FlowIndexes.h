@@ -0,0 +1,102 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#ifndef _FLOW_INDEXES_H_
+#define _FLOW_INDEXES_H_
+
+#include "ntop_includes.h"
+
+class Flow;
+class Host;
+class Paginator;
+
+/** @class FlowIndexes
+ *  @brief Secondary indexes of the flows of an interface, used to answer
+ *  paginated flow queries without walking the whole flows hash.
+ *  @details Each column maps a value (e.g. a protocol id) to the posting
+ *  of the flows having it. Postings are updated when flows are created,
+ *  detected, alerted or become idle, so they must be consistent with
+ *  the flows hash. A flow remembers its position in each posting (see
+ *  flow_index_refs_t), so that it can be removed in constant time.
+ *  Each column has its own lock. Updates never wait for a query walking
+ *  a column: they are deferred and applied by flushPending(), inline with
+ *  the purge. The refs positions are protected by the column locks,
+ *  their pending flags and the pending flows by m. A flow whose removal
+ *  is deferred is kept in use until flushPending(), so that it is never
+ *  deleted while still pending.
+ */
+class FlowIndexes {
+ private:
+  RwLock column_locks[flow_index_num_columns];
+  std::unordered_map<u_int64_t, std::vector<Flow*> > postings[flow_index_num_columns];
+  Mutex m; /* Protects the flags, the pending flows and the counters */
+  bool maintained; /* Flows are indexed as they change */
+  bool usable;     /* All the flows have been indexed, queries can use the postings */
+  std::unordered_set<Flow*> pending; /* Flows with deferred updates, see flushPending() */
+  u_int32_t num_indexed_flows;
+  u_int64_t num_updates, num_deferred, num_queries, num_candidates;
+  ticks tot_update_ticks;
+
+  static void getKeys(Flow *f, u_int64_t *keys, bool *present);
+  void addRef(Flow *f, flow_index_refs_t *refs, u_int8_t ref, u_int64_t key);
+  void removeRef(flow_index_refs_t *refs, u_int8_t ref);
+  u_int8_t updateColumns(Flow *f, flow_index_refs_t *refs, u_int8_t columns, bool wait);
+  u_int8_t removeColumns(flow_index_refs_t *refs, u_int8_t columns, bool wait);
+  void freeRefs(Flow *f);
+  void defer(Flow *f);
+  void selectPosting(FlowIndexColumn *best_column, u_int64_t *best_key, size_t *best_size, bool *found,
+		     FlowIndexColumn column, u_int64_t key);
+  size_t getColumnMemory(u_int8_t column);
+
+ public:
+  FlowIndexes();
+  ~FlowIndexes();
+
+  inline bool isMaintained() const { return(maintained); };
+  inline bool isUsable()     const { return(usable);     };
+  /* Called before indexing the flows already in the hash */
+  void startMaintenance();
+  /* Called once all the flows in the hash have been indexed */
+  void setUsable();
+  void disable();
+
+  /* Never blocks: columns being queried are updated later */
+  void indexFlow(Flow *f);
+  /* Blocks only when wait is set, i.e., when the flow is about to be freed */
+  void unindexFlow(Flow *f, bool wait);
+  /* Applies the deferred updates, waiting for the queries to complete */
+  void flushPending();
+
+  /**
+   * @brief Walk the flows of the most selective posting matching the filters.
+   * @details Candidates are a superset of the matching flows: the walker must
+   *          still check all the filters.
+   *
+   * @return false if no posting can be used, and thus the flows hash must be walked.
+   */
+  bool walk(Paginator *p, Host *host,
+	    bool (*walker)(GenericHashEntry *h, void *user_data, bool *matched), void *user_data);
+
+  void lua(lua_State *vm);
+};
+
+#endif /* _FLOW_INDEXES_H_ */
@@ -25,6 +25,7 @@
 #include "ntop_includes.h"
 
 class GenericHashEntry;
+class HousekeepingEngine;
 
 /** @defgroup MonitoringData Monitoring Data
  * This is the group that contains all classes and datastructures that handle monitoring data.
@@ -38,17 +39,75 @@ class GenericHashEntry;
  *
  */
 class GenericHash {
+ private:
+  /* Open addressing engine: the table is split in num_stripes independent
+     tables, each one protected by its own lock. Probing never crosses a stripe. */
+  typedef struct {
+    u_int8_t *tags;             /**< Per-slot 7-bit fingerprint (MSB set), HASH_SLOT_EMPTY or HASH_SLOT_DELETED */
+    GenericHashEntry **slots;   /**< Entries, NULL when the tag is not a fingerprint */
+    u_int32_t num_used;         /**< Slots holding an entry */
+    u_int32_t num_deleted;      /**< Tombstones, reclaimed by compactStripe() */
+  } HashStripe;
+
+  HashTableEngine engine;
+  HashStripe *stripes;
+  u_int32_t num_stripes, num_locks;
+
+  void initOpenAddressing();
+  void compactStripe(HashStripe *s);
+  bool addOpenAddressing(GenericHashEntry *h, bool do_lock);
+  GenericHashEntry* lookupOpenAddressing(u_int32_t key,
+					 bool (*matches)(GenericHashEntry *h, void *user_data),
+					 void *user_data, bool do_lock, bool inc_uses);
+  bool walkOpenAddressing(u_int32_t *begin_slot, bool walk_all,
+			  bool (*walker)(GenericHashEntry *h, void *user_data, bool *entryMatched), void *user_data);
+  bool housekeepEntry(GenericHashEntry *head, const struct timeval *tv, time_t now, bool force_idle);
+  u_int purgeBucket(u_int i, const struct timeval *tv, time_t now, bool force_idle,
+		    vector<GenericHashEntry*> *detached, u_int *buckets_checked);
+
+  /* Offloaded housekeeping: the partitions are walked in parallel by the
+     HousekeepingEngine workers, which run the periodic activities under the
+     bucket locks and idle the entries they detach. purgeIdle() hands those
+     entries to the purge and publishes the next round. */
+  typedef struct {
+    std::atomic<u_int8_t> state; /**< HousekeepingPartitionState */
+    u_int32_t begin, end;        /**< Buckets (chaining) or stripes (open addressing) of the partition: [begin, end) */
+    u_int32_t last_purged;       /**< Last bucket visited, the walk resumes from the next one */
+    struct timeval tv;           /**< Timestamp of the round published */
+    vector<GenericHashEntry*> detached; /**< Entries detached and idled by the worker, to be purged */
+  } HousekeepingPartition;
+
+  HousekeepingEngine *housekeeping;
+  HousekeepingPartition hk_partitions[HOUSEKEEPING_NUM_PARTITIONS];
+  u_int8_t num_hk_partitions;
+  bool hk_overrun; /**< Some partitions were still pending or running at the last purgeIdle() */
+  Mutex idle_entries_lock; /**< Serializes the inline walks and the completed partitions on idle_entries_shadow */
+  std::vector<ObjectPool*> pools; /**< Pools the entries are allocated from, for stats only (not owned) */
+  struct {
+    std::atomic<u_int64_t> num_walks, num_visited, walk_usec, max_walk_usec, num_overruns;
+  } walk_stats;
+
+  void initPartitions();
+  void claimPartitions();
+  void releasePartitions();
+  void purgeIdlePartition(HousekeepingPartition *hp);
+  u_int completePartition(HousekeepingPartition *hp);
+  void updateWalkStats(u_int64_t begin_usec, u_int visited);
+  /* Wraps before the multiplication overflows, so ids stay congruent to entry_id_unit */
+  inline u_int nextEntryId() { return((last_entry_id++ % (0xFFFFFFFF / num_entry_id_units)) * num_entry_id_units + entry_id_unit); };
+
  protected:
   GenericHashEntry **table; /**< Entry table. It is used for maintain an update history */
   char *name;
   u_int32_t num_hashes; /**< Number of hash */
-  u_int32_t current_size; /**< Current size of hash (including idle or ready-to-purge elements) */
+  std::atomic<u_int32_t> current_size; /**< Current size of hash (including idle or ready-to-purge elements) */
   u_int32_t max_hash_size; /**< Max size of hash */
   u_int32_t upper_num_visited_entries; /**< Max number of entries to purge per run */
   RwLock **locks;
   NetworkInterface *iface; /**< Pointer of network interface for this generic hash */
   u_int last_purged_hash; /**< Index of last purged hash */
-  u_int last_entry_id; /**< An uniue identifier assigned to each entry in the hash table */
+  std::atomic<u_int> last_entry_id; /**< An uniue identifier assigned to each entry in the hash table */
+  u_int8_t entry_id_unit, num_entry_id_units; /**< Entry ids are last_entry_id * num_entry_id_units + entry_id_unit */
   u_int purge_step;
   u_int walk_idle_start_hash_id; /**< The id of the hash bucket from which to start walkIdle hash table walk */
   struct {
@@ -59,7 +118,23 @@ class GenericHash {
   vector<GenericHashEntry*> *idle_entries_in_use;   /**< Vector used by the offline thread in charge to hold idle entries but still in use */
   vector<GenericHashEntry*> *idle_entries;          /**< Vector used by the offline thread in charge of deleting hash table entries */
   vector<GenericHashEntry*> *idle_entries_shadow;   /**< Vector prepared by the purgeIdle and periodically swapped to idle_entries */
-  
+
+  /**
+   * @brief Find a non-idle entry, regardless of the hash table engine in use.
+   * @details This is the lookup primitive used by the get()/find() methods of the subclasses.
+   *
+   * @details A template on the match function, so the chaining walk calls it directly (inlined).
+   *
+   * @param matches Function returning true when the entry passed is the one searched
+   * @param key The entry key, that is, the value returned by GenericHashEntry::key() of the entry searched
+   * @param user_data Opaque value passed to matches
+   * @param do_lock Whether the bucket (or stripe) has to be read-locked. Inline callers don't need to lock, unless the table is walked by the housekeeping workers.
+   * @param inc_uses Whether a use has to be taken on the entry found before the lock is released, so that it cannot be idled and deleted meanwhile.
+   * @return The entry found, or NULL if no entry matches.
+   */
+  template <bool (*matches)(GenericHashEntry *h, void *user_data)>
+    GenericHashEntry* lookup(u_int32_t key, void *user_data, bool do_lock, bool inc_uses = false);
+
  public:
 
   /**
@@ -70,10 +145,13 @@ class GenericHash {
    * @param _num_hashes Number of hashes.
    * @param _max_hash_size Max size of new hash.
    * @param _name Hash name (debug)
+   * @param _engine Hash table engine. When not specified, the one set in the preferences is used.
    * @return A new Instance of GenericHash.
    */
   GenericHash(NetworkInterface *_iface, u_int _num_hashes,
 	      u_int _max_hash_size, const char *_name);
+  GenericHash(NetworkInterface *_iface, u_int _num_hashes,
+	      u_int _max_hash_size, const char *_name, HashTableEngine _engine);
 
   /**
    * @brief A Destructor
@@ -88,6 +166,15 @@ class GenericHash {
    */
   inline u_int32_t getNumEntries() { return(current_size); };
 
+  /**
+   * @brief Make the entry ids unique among num_units tables (e.g. the flows of the packet shards of an interface).
+   * @details Entry ids become congruent to unit modulo num_units. Set before any entry is added.
+   *
+   * @param unit The id of this table, lower than num_units.
+   * @param num_units The number of tables.
+   */
+  inline void setEntryIdUnit(u_int8_t unit, u_int8_t num_units) { entry_id_unit = unit, num_entry_id_units = num_units; };
+
   /**
    * @brief Get number of idle entries, that is, entries no longer in the hash table but still to be purged.
    * @details Inline method.
@@ -140,6 +227,30 @@ class GenericHash {
    */
   u_int purgeIdle(const struct timeval * tv, bool force_idle, bool full_scan);
 
+  /**
+   * @brief Hand the periodic walks of this hash table to a housekeeping engine.
+   * @details Once set, lookups and additions always lock as the table is walked
+   *          by other threads. Forced and full scans are still performed inline.
+   *
+   * @param hk The engine, or NULL to walk the table inline again.
+   */
+  void setHousekeepingEngine(HousekeepingEngine *hk);
+
+  /**
+   * @brief Report the occupancy of a pool used by the entries of this table in its stats.
+   *
+   * @param pool The pool, which must outlive the hash table.
+   */
+  inline void addPool(ObjectPool *pool) { pools.push_back(pool); };
+
+  /**
+   * @brief Walk one partition published by purgeIdle(). Called by the housekeeping workers.
+   * @details The entries detached are handed to the purge by the next purgeIdle().
+   *
+   * @return true if a partition has been walked, false if none was pending.
+   */
+  bool runHousekeeping();
+
   /**
    * @brief Purge all hash entries.
    *
@@ -162,6 +273,11 @@ class GenericHash {
    */
   inline const char* getName() const { return name; };
 
+  /**
+   * @brief Return the engine used by this hash table
+   */
+  inline HashTableEngine getEngine() const { return engine; };
+
   /**
    * @brief Check whether the hash has empty space
    *
@@ -181,4 +297,42 @@ class GenericHash {
 
 };
 
+/* ************************************ */
+
+template <bool (*matches)(GenericHashEntry *h, void *user_data)>
+  GenericHashEntry* GenericHash::lookup(u_int32_t key, void *user_data, bool do_lock, bool inc_uses) {
+  u_int32_t hash;
+  GenericHashEntry *head;
+
+  if(housekeeping) do_lock = true; /* Concurrently walked by the housekeeping workers */
+
+  if(engine == hash_table_engine_open_addressing)
+    return(lookupOpenAddressing(key, matches, user_data, do_lock, inc_uses));
+
+  hash = key % num_hashes;
+
+  if(table[hash] == NULL)
+    return(NULL);
+
+  if(do_lock)
+    locks[hash]->rdlock(__FILE__, __LINE__);
+
+  head = table[hash];
+
+  while(head) {
+    if(matches(head, user_data))
+      break;
+    else
+      head = head->next();
+  }
+
+  if(head && inc_uses)
+    head->incUses();
+
+  if(do_lock)
+    locks[hash]->unlock(__FILE__, __LINE__);
+
+  return(head);
+}
+
 #endif /* _GENERIC_HASH_H_ */
@@ -24,7 +24,7 @@
 
 #include "ntop_includes.h"
 
-class Generichash;
+class GenericHash;
 
 /** @class GenericHashEntry
  *  @brief Base hash entry class.
@@ -55,6 +55,10 @@ class GenericTrafficElement {
     if(dscpStats) delete dscpStats;
   };
   inline void incNumDroppedFlows()         { total_num_dropped_flows++;      };
+  /* Adds traffic accounted elsewhere, e.g. before the element state was restored */
+  inline void incTraffic(time_t t, u_int64_t sent_pkts, u_int64_t sent_bytes, u_int64_t rcvd_pkts, u_int64_t rcvd_bytes) {
+    sent.incStats(t, sent_pkts, sent_bytes), rcvd.incStats(t, rcvd_pkts, rcvd_bytes);
+  };
 
   inline TcpPacketStats* getTcpPacketSentStats() { return(&tcp_packet_stats_sent); }
   inline TcpPacketStats* getTcpPacketRcvdStats() { return(&tcp_packet_stats_rcvd); }
@@ -41,6 +41,7 @@ class HTTPserver {
   const char *https_binding_addr1, *https_binding_addr2;
   const char *http_options[32];
   int cur_http_options;
+  LuaEnginePool *lua_engine_pool;
 
   void addHTTPOption(const char *k, const char*v);
   void startHttpServer();
@@ -66,6 +67,7 @@ class HTTPserver {
 
   inline char*     get_docs_dir()    { return(docs_dir);         };
   inline char*     get_scripts_dir() { return(scripts_dir);      };
+  inline LuaEnginePool* getLuaEnginePool() { return(lua_engine_pool); };
   inline bool      is_ssl_enabled()  { return(ssl_enabled);      };
   inline bool      is_gui_access_restricted() { return(gui_access_restricted); };
   inline void      start_accepting_requests() { can_accept_requests = true; };
@@ -26,7 +26,7 @@
 
 class HostAlert;
 
-class Host : public GenericHashEntry, public HostAlertableEntity, public Score, public HostChecksStatus {
+class Host : public GenericHashEntry, public HostAlertableEntity, public Score, public HostChecksStatus, public PoolAllocated {
  protected:
   IpAddress ip;
   Mac *mac;
@@ -74,8 +74,9 @@ class Host : public GenericHashEntry, public HostAlertableEntity, public Score,
   } icmp_flood;
 
   struct {
-    u_int32_t syn_sent_last_min, synack_recvd_last_min; /* (attacker) */
-    u_int32_t syn_recvd_last_min, synack_sent_last_min; /* (victim) */
+    /* Atomic as the SYNScan check resets them outside of the packet thread */
+    std::atomic<u_int32_t> syn_sent_last_min, synack_recvd_last_min; /* (attacker) */
+    std::atomic<u_int32_t> syn_recvd_last_min, synack_sent_last_min; /* (victim) */
   } syn_scan;
   std::atomic<u_int32_t> num_active_flows_as_client, num_active_flows_as_server; /* Need atomic as inc/dec done on different threads */
   u_int32_t asn;
@@ -95,7 +96,7 @@ class Host : public GenericHashEntry, public HostAlertableEntity, public Score,
     TCP flows with SYN only, resets or unidirectional UDP flows not sent to broad/multicast addresees
     Counter reset every minute
   */
-  u_int32_t num_incomplete_flows;
+  std::atomic<u_int32_t> num_incomplete_flows; /* Reset by the ScanDetection check */
 
   Mutex m;
   u_int32_t mac_last_seen;
@@ -239,6 +240,10 @@ class Host : public GenericHashEntry, public HostAlertableEntity, public Score,
   virtual HTTPstats* getHTTPstats()           { return(NULL);                  };
   virtual DnsStats*  getDNSstats()            { return(NULL);                  };
   virtual ICMPstats* getICMPstats()           { return(NULL);                  };
+  /* Same as above but allocate the stats on first use (packet processing only) */
+  virtual HTTPstats* allocHTTPstats()         { return(NULL);                  };
+  virtual DnsStats*  allocDNSstats()          { return(NULL);                  };
+  virtual ICMPstats* allocICMPstats()         { return(NULL);                  };
   inline u_int8_t getConsecutiveHighScore()   { return(stats->getConsecutiveHighScore()); };
   inline void resetConsecutiveHighScore()     { stats->resetConsecutiveHighScore(); };
   inline void incrConsecutiveHighScore()      { stats->incrConsecutiveHighScore(); };
@@ -378,7 +383,14 @@ class Host : public GenericHashEntry, public HostAlertableEntity, public Score,
 
   inline u_int32_t syn_scan_victim_hits()   const { return syn_scan.syn_recvd_last_min > syn_scan.synack_sent_last_min ? syn_scan.syn_recvd_last_min - syn_scan.synack_sent_last_min : 0; };
   inline u_int32_t syn_scan_attacker_hits() const { return syn_scan.syn_sent_last_min > syn_scan.synack_recvd_last_min ? syn_scan.syn_sent_last_min - syn_scan.synack_recvd_last_min : 0; };
-  inline void reset_syn_scan_hits() { syn_scan.syn_sent_last_min = syn_scan.synack_recvd_last_min = syn_scan.syn_recvd_last_min = syn_scan.synack_sent_last_min = 0; };
+  /* Hits since the last call: the counters start over, without losing the increments done meanwhile */
+  inline void getAndResetSynScanHits(u_int32_t *attacker_hits, u_int32_t *victim_hits) {
+    u_int32_t syn_sent = syn_scan.syn_sent_last_min.exchange(0), synack_recvd = syn_scan.synack_recvd_last_min.exchange(0);
+    u_int32_t syn_recvd = syn_scan.syn_recvd_last_min.exchange(0), synack_sent = syn_scan.synack_sent_last_min.exchange(0);
+
+    *attacker_hits = (syn_sent > synack_recvd) ? syn_sent - synack_recvd : 0;
+    *victim_hits = (syn_recvd > synack_sent) ? syn_recvd - synack_sent : 0;
+  };
 
   void incNumFlows(time_t t, bool as_client);
   void decNumFlows(time_t t, bool as_client);
@@ -438,6 +450,7 @@ class Host : public GenericHashEntry, public HostAlertableEntity, public Score,
   virtual void lua_get_timeseries(lua_State* vm)        { lua_pushnil(vm); };
   virtual void lua_peers_stats(lua_State* vm)     const { lua_pushnil(vm); };
   virtual void lua_contacts_stats(lua_State *vm)  const { lua_pushnil(vm); };
+  virtual void lua_memory_stats(lua_State *vm)    const { lua_pushnil(vm); };
   DeviceProtoStatus getDeviceAllowedProtocolStatus(ndpi_protocol proto, bool as_client);
 
   virtual void serialize(json_object *obj, DetailsLevel details_level);
@@ -533,12 +546,7 @@ class Host : public GenericHashEntry, public HostAlertableEntity, public Score,
   inline void setViewInterfaceMac(u_int8_t *_view_interface_mac) { if(_view_interface_mac) memcpy(view_interface_mac, _view_interface_mac, sizeof(view_interface_mac)); }
 
   inline void incIncompleteFlows()         { num_incomplete_flows++;       }
-  inline u_int32_t getAndResetNumIncompleteFlows() {
-    u_int32_t _num_incomplete_flows = num_incomplete_flows;
-
-    num_incomplete_flows = 0;
-    return(_num_incomplete_flows);
-  }
+  inline u_int32_t getAndResetNumIncompleteFlows() { return(num_incomplete_flows.exchange(0)); }
 };
 
 #endif /* _HOST_H_ */
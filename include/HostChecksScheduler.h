@@ -0,0 +1,83 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#ifndef _HOST_CHECKS_SCHEDULER_H_
+#define _HOST_CHECKS_SCHEDULER_H_
+
+#include "ntop_includes.h"
+
+class Host;
+
+typedef struct {
+  Host *h;
+  time_t due; /* When the checks were due, used to compute the lag */
+} host_checks_item_t;
+
+/*
+  Runs the host checks outside of the purgeIdle loop. Hosts are kept in a
+  timing wheel (one slot per second) keyed by the time their next
+  minute/5-minute checks are due. A ticker thread moves the due hosts
+  (at most HOST_CHECKS_TICK_BUDGET per second) to a ready queue that is
+  drained by a small pool of workers.
+
+  Hosts in the wheel hold no reference, so they can go idle: the idle
+  transition (Host::housekeep) removes them from the wheel before they
+  can be deleted. Ready hosts and hosts being checked hold a reference
+  (incUses) taken by the ticker and released by the worker.
+*/
+class HostChecksScheduler {
+ private:
+  Mutex m;
+  Condvar ready_cond;
+  std::vector<host_checks_item_t> wheel[HOST_CHECKS_WHEEL_SLOTS];
+  std::deque<host_checks_item_t> ready;
+  time_t last_tick;
+  bool started, stopping;
+  pthread_t ticker;
+  pthread_t workers[HOST_CHECKS_NUM_WORKERS];
+
+  /* Stats, protected by m */
+  u_int32_t num_scheduled;
+  u_int64_t num_executed, num_deferred, max_ready;
+  u_int64_t lag_histogram[HOST_CHECKS_LAG_BUCKETS];
+
+  void addToWheel(Host *h, time_t slot_time, time_t due);
+  void updateLag(time_t now, time_t due);
+  void tick(time_t now);
+
+ public:
+  HostChecksScheduler();
+  ~HostChecksScheduler();
+
+  void start();
+  void shutdown();
+
+  void tickerLoop();
+  void workerLoop(u_int8_t worker_id);
+
+  bool schedule(Host *h);
+  void unschedule(Host *h);
+
+  void lua(lua_State *vm);
+};
+
+#endif /* _HOST_CHECKS_SCHEDULER_H_ */
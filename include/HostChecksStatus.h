@@ -33,9 +33,16 @@ class HostChecksStatus { /* Container to keep per-check status (e.g., traffic de
   u_int64_t dns_bytes;  /* Holds the DNS bytes and is used to compute the delta of DNS bytes across consecutive check calls */
   u_int64_t pkt_counter;
 
+  /* HostChecksScheduler state: set under the scheduler lock */
+  bool checks_scheduled;
+  time_t checks_due;
+  /* Serializes the checks (scheduler workers) with the release of the alerts on idle */
+  Mutex checks_lock;
+
  public:
   HostChecksStatus() {
     last_call_min = last_call_5min = 0;
+    checks_scheduled = false, checks_due = 0;
     /* Set members to their maximum values to discard the first delta */
     ntp_bytes = p2p_bytes = dns_bytes = pkt_counter = (u_int64_t)-1; 
   }
@@ -46,6 +53,13 @@ class HostChecksStatus { /* Container to keep per-check status (e.g., traffic de
 
   inline void setMinLastCallTime(time_t now)  { last_call_min  = now; }
   inline void set5MinLastCallTime(time_t now) { last_call_5min = now; }
+  inline time_t getNextChecksTime()     const { time_t m = last_call_min + 60, f = last_call_5min + 300; return((m < f) ? m : f); }
+
+  inline bool areChecksScheduled()      const { return(checks_scheduled); }
+  inline void setChecksScheduled(bool s, time_t due) { checks_scheduled = s, checks_due = due; }
+  inline time_t getChecksDue()          const { return(checks_due); }
+  inline void lockChecks()                    { checks_lock.lock(__FILE__, __LINE__);   }
+  inline void unlockChecks()                  { checks_lock.unlock(__FILE__, __LINE__); }
 
   /* Checks status API */
   inline u_int64_t cb_status_delta_ntp_bytes(u_int64_t new_value) { return Utils::uintDiff(&ntp_bytes, new_value); };
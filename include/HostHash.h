@@ -32,8 +32,8 @@ class HostHash : public GenericHash {
  public:
   HostHash(NetworkInterface *iface, u_int _num_hashes, u_int _max_hash_size);
 
-  /* Search for an host by IP and VLAN */
-  Host* get(VLANid vlanId, IpAddress *key, bool is_inline_call, u_int16_t observation_point_id);
+  /* Search for an host by IP and VLAN. When inc_uses is set, the host returned holds a use the caller has to release */
+  Host* get(VLANid vlanId, IpAddress *key, bool is_inline_call, u_int16_t observation_point_id, bool inc_uses = false);
 
   void incNumHTTPEntries();  
   void decNumHTTPEntries();
@@ -158,6 +158,9 @@ class HostStats: public GenericTrafficElement {
   virtual HTTPstats* getHTTPstats()  { return(NULL); }
   virtual DnsStats*  getDNSstats()   { return(NULL); }
   virtual ICMPstats* getICMPstats()  { return(NULL); }
+  virtual HTTPstats* allocHTTPstats()  { return(NULL); }
+  virtual DnsStats*  allocDNSstats()   { return(NULL); }
+  virtual ICMPstats* allocICMPstats()  { return(NULL); }
 
   virtual void incCliContactedPorts(u_int16_t port)  { ; }
   virtual void incSrvPortsContacts(u_int16_t port)   { ; }
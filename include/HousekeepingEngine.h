@@ -0,0 +1,64 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#ifndef _HOUSEKEEPING_ENGINE_H_
+#define _HOUSEKEEPING_ENGINE_H_
+
+#include "ntop_includes.h"
+
+class GenericHash;
+
+/*
+  Pool of workers walking the hash tables (hosts, MACs, ASes...) of all the
+  interfaces out of the packet path. The packet threads only publish the
+  rounds (see GenericHash::purgeIdle) and never wait: each table is split in
+  bucket ranges (partitions) that are walked in parallel by the workers.
+  Workers run the periodic activities of the entries under the bucket locks,
+  detach and idle the idle ones and hand them back to the packet thread,
+  which only queues them for deletion.
+*/
+class HousekeepingEngine {
+ private:
+  RwLock tables_lock; /* Workers hold it in read while walking, (un)registrations in write */
+  std::vector<GenericHash*> tables;
+  Condvar work_cond;
+  pthread_t workers[HOUSEKEEPING_MAX_NUM_WORKERS];
+  u_int8_t num_workers;
+  bool started;
+  volatile bool stopping;
+
+ public:
+  HousekeepingEngine(u_int8_t _num_workers);
+  ~HousekeepingEngine();
+
+  void start();
+  void shutdown();
+
+  void registerHash(GenericHash *h);
+  void unregisterHash(GenericHash *h);
+
+  inline void notify() { work_cond.signal(); }
+
+  void workerLoop(u_int8_t worker_id);
+};
+
+#endif /* _HOUSEKEEPING_ENGINE_H_ */
@@ -0,0 +1,93 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _INFLUXDB_STREAMER_H_
+#define _INFLUXDB_STREAMER_H_
+
+#include "ntop_includes.h"
+
+/*
+  Streams the timeseries points to InfluxDB (see InfluxDBTimeseriesExporter).
+  Lines are formatted straight into pooled batches that a sender thread
+  gzips and posts over a kept-alive connection, as soon as they are full or
+  CONST_INFLUXDB_FLUSH_TIME seconds old. Only the batches that can't be
+  posted, or that don't fit the pool, are written to <workingdir>/tmp/influxdb
+  where the influxdb driver export() picks them up.
+*/
+class InfluxDBStreamer {
+ private:
+  typedef struct {
+    char *data;
+    u_int32_t len, num_points;
+    time_t first_point; /* Enqueue time of the first point */
+  } influxdb_batch_t;
+
+  influxdb_batch_t batches[INFLUXDB_STREAM_NUM_BATCHES];
+  std::vector<influxdb_batch_t*> free_batches;
+  std::deque<influxdb_batch_t*> ready_batches;
+  influxdb_batch_t *cur; /* Being filled */
+  Mutex lock;            /* Protects the batches, the endpoint and the spill sequence */
+  Condvar ready_cond;
+  pthread_t sender;
+  bool started;
+  volatile bool stopping;
+
+  std::string write_url, username, password;
+  char spill_dir[PATH_MAX];
+  u_int32_t spill_seq;
+
+  /* Sender thread */
+  CURL *curl;
+  char *gz_buf;
+  u_long gz_buf_len;
+#ifdef HAVE_ZLIB
+  z_stream zs;
+  bool zs_ready;
+#endif
+
+  /* Stats */
+  u_int64_t num_points_enqueued, num_points_spilled, num_points_dropped, bytes_formatted; /* Updated under lock */
+  u_int64_t num_points_posted, num_posts, num_failed_posts, num_retries;
+  u_int64_t bytes_posted, bytes_posted_uncompressed;
+  u_int32_t last_post_ms;
+
+  bool compress(influxdb_batch_t *b, const char **out, u_int32_t *out_len);
+  bool post(influxdb_batch_t *b, bool stop);
+  void spill(influxdb_batch_t *b);
+  void release(influxdb_batch_t *b);
+
+ public:
+  InfluxDBStreamer();
+  ~InfluxDBStreamer();
+
+  void start();
+  /* Posts the pending batches (once) and stops the sender */
+  void shutdown();
+
+  void setEndpoint(const char *url, const char *db, const char *user, const char *pwd);
+  /* Appends the line protocol point described by the Lua arguments (see TimeseriesExporter) */
+  bool enqueue(lua_State *vm, int (*escape_fn)(char *outbuf, int outlen, const char *orig));
+
+  void senderLoop();
+  void lua(lua_State *vm);
+};
+
+#endif /* _INFLUXDB_STREAMER_H_ */
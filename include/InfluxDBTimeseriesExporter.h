@@ -24,18 +24,8 @@
 
 #include "ntop_includes.h"
 
+/* Points are streamed by the InfluxDBStreamer, shared by all the interfaces */
 class InfluxDBTimeseriesExporter : public TimeseriesExporter {
- private:
-  time_t flushTime;
-  u_int32_t cursize;
-  u_int32_t num_exports;
-  FILE *fp;
-  char fbase[PATH_MAX], fname[PATH_MAX+32];
-  u_int num_cached_entries; 
-  Mutex m;
-  
-  void createDump();
-  
  public:
   InfluxDBTimeseriesExporter(NetworkInterface *_if);
   ~InfluxDBTimeseriesExporter();
@@ -0,0 +1,97 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#ifndef _JSON_SCANNER_H_
+#define _JSON_SCANNER_H_
+
+#include "ntop_includes.h"
+
+#define JSON_SCANNER_MAX_DEPTH 32
+
+typedef enum {
+  json_scanner_null = 0,
+  json_scanner_bool,
+  json_scanner_int,
+  json_scanner_double,
+  json_scanner_string,
+  json_scanner_object,
+  json_scanner_array
+} JSONScannerType;
+
+typedef struct {
+  JSONScannerType type;
+  char *string;      /* Strings: unescaped in place and NUL terminated */
+  const char *raw;   /* Any other type: the (not terminated) token text */
+  u_int32_t len;     /* Length of string or raw */
+  int64_t int_num;
+  double double_num;
+  bool boolean;
+} json_scanner_value_t;
+
+/** @class JSONScanner
+ *  @brief Single pass pull parser working in place on a JSON buffer.
+ *  @details Keys and string values are unescaped directly inside the buffer
+ *  and returned as NUL terminated pointers into it, so no allocation takes
+ *  place while scanning. Nested objects and arrays can either be walked with
+ *  enterObject()/enterArray() or returned as raw text by readValue(), to be
+ *  parsed on demand with toJSONObject() only when their content is needed.
+ *  The buffer must be writable, it does not need to be NUL terminated.
+ */
+class JSONScanner {
+ private:
+  char *start, *cur, *end;
+  bool first[JSON_SCANNER_MAX_DEPTH]; /* No item read yet at this nesting level */
+  u_int8_t depth;
+  bool failed;
+
+  inline bool fail()         { failed = true; return(false); };
+  inline void skipSpaces()   { while((cur < end) && ((*cur == ' ') || (*cur == '\n') || (*cur == '\r') || (*cur == '\t'))) cur++; };
+  bool enter(char open);
+  bool next(char close);
+  bool scanString(char **out, u_int32_t *out_len);
+  bool scanNumber(json_scanner_value_t *v);
+  bool scanLiteral(const char *literal, u_int32_t literal_len);
+  bool skipNested();
+
+ public:
+  JSONScanner(char *buf, u_int32_t len);
+
+  /* First character of the next token, 0 at the end of the buffer */
+  char peek();
+  inline bool enterObject() { return(enter('{')); };
+  inline bool enterArray()  { return(enter('[')); };
+  /* Moves to the next member of the current object: false at its end or on error */
+  bool nextMember(char **key, u_int32_t *key_len);
+  /* Moves to the next element of the current array: false at its end or on error */
+  inline bool nextElement() { return(next(']')); };
+  /* Reads the value of the current member/element */
+  bool readValue(json_scanner_value_t *v);
+
+  inline bool hasFailed()     const { return(failed); };
+  inline u_int32_t getOffset() const { return(cur - start); };
+
+  static const char* getTypeName(JSONScannerType type);
+  /* Builds the json-c equivalent of a value, parsing nested objects/arrays with tok */
+  static json_object* toJSONObject(const json_scanner_value_t *v, json_tokener *tok);
+};
+
+#endif /* _JSON_SCANNER_H_ */
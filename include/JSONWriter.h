@@ -0,0 +1,79 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#ifndef _JSON_WRITER_H_
+#define _JSON_WRITER_H_
+
+#include "ntop_includes.h"
+
+#define JSON_WRITER_RESERVED_KEYS 128
+
+/** @class JSONWriter
+ *  @brief Writes a JSON object into a reusable buffer.
+ *  @details Output is byte-identical to json_object_to_json_string() of the
+ *  equivalent json-c object (JSON_C_TO_STRING_SPACED, json-c >= 0.13 number
+ *  formatting and escaping), including the case of a key added twice, whose
+ *  value is replaced in place as json_object_object_add() does. The buffer
+ *  only grows, so no allocation takes place once it has reached its size.
+ *  Not thread safe: each thread needs its own writer.
+ */
+class JSONWriter {
+ private:
+  typedef struct {
+    u_int32_t hash, key_off, key_len, val_off, val_len;
+  } json_writer_key_t;
+
+  char *buf, *scratch;
+  u_int32_t len, size, scratch_size;
+  u_int32_t entry_start, key_start, val_start;
+  bool had_children, failed;
+  std::vector<json_writer_key_t> keys; /* Cleared on reset(), its capacity is kept */
+
+  bool reserve(u_int32_t n);
+  void append(const char *s, u_int32_t n);
+  inline void append(const char *s) { append(s, strlen(s)); };
+  void appendEscaped(const char *s);
+  void appendDouble(double d);
+  void beginValue(const char *key);
+  void endValue();
+
+ public:
+  JSONWriter(u_int32_t initial_size = 2048);
+  ~JSONWriter();
+
+  /* Starts a new object, discarding the previous one */
+  void reset();
+
+  void addString(const char *key, const char *value);
+  void addInt(const char *key, int32_t value);
+  void addInt64(const char *key, int64_t value);
+  void addBool(const char *key, bool value);
+  void addDouble(const char *key, double value);
+  void addDoubleArray(const char *key, const double *values, u_int16_t num_values);
+  /* Adds a value already serialized as JSON (e.g. a nested object) */
+  void addRaw(const char *key, const char *json);
+
+  /* Closes the object: the returned string is valid until the next reset(). NULL on allocation failure */
+  const char* end(u_int32_t *out_len = NULL);
+};
+
+#endif /* _JSON_WRITER_H_ */
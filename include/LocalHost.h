@@ -52,6 +52,8 @@ class LocalHost : public Host, public SerializableElement {
   bool systemHost;
   time_t initialization_time;
   LocalHostStats *initial_ts_point;
+  LocalHostCacheRequest *pending_restore; /* State being restored in background */
+  bool restore_deferred; /* The local host cache queue was full: the restore is retried */
   std::unordered_map<u_int32_t, DoHDoTStats*> doh_dot_map;
   
   /* LocalHost data: update LocalHost::deleteHostData when adding new fields */
@@ -60,6 +62,9 @@ class LocalHost : public Host, public SerializableElement {
   /* END Host data: */
 
   void initialize();
+  void deserializeHostData(json_object *obj);
+  void requestRestore();
+  void applyRestoredState();
   void freeLocalHostData();
   virtual void deleteHostData();
 
@@ -73,6 +78,8 @@ class LocalHost : public Host, public SerializableElement {
   virtual ~LocalHost();
 
   virtual void set_hash_entry_state_idle();
+  void saveState();
+  inline bool isRestorePending() const         { return(pending_restore || restore_deferred); };
   virtual int16_t get_local_network_id() const { return(local_network_id);  };
   virtual bool isLocalHost()  const            { return(true);              };
   virtual bool isSystemHost() const            { return(systemHost);        };
@@ -81,7 +88,7 @@ class LocalHost : public Host, public SerializableElement {
     return(iface->getNetworkStats(networkId));
   };
   virtual u_int32_t getActiveHTTPHosts() { return(getHTTPstats() ? getHTTPstats()->get_num_virtual_hosts() : 0); };
-  virtual HostStats* allocateStats()     { return(new LocalHostStats(this)); };
+  virtual HostStats* allocateStats()     { return(new (iface->get_local_host_stats_pool()) LocalHostStats(this)); };
 
   virtual bool dropAllTraffic() const { return(drop_all_host_traffic); };
   virtual void inlineSetOSDetail(const char *_os_detail);
@@ -94,10 +101,14 @@ class LocalHost : public Host, public SerializableElement {
   virtual void lua_get_timeseries(lua_State* vm);
   virtual void lua_peers_stats(lua_State* vm)    const;
   virtual void lua_contacts_stats(lua_State *vm) const;
+  virtual void lua_memory_stats(lua_State *vm)   const;
   virtual void incrVisitedWebSite(char *hostname)  { stats->incrVisitedWebSite(hostname); };
   virtual HTTPstats* getHTTPstats()                { return(stats->getHTTPstats());       };
   virtual DnsStats*  getDNSstats()                 { return(stats->getDNSstats());        };
   virtual ICMPstats* getICMPstats()                { return(stats->getICMPstats());       };
+  virtual HTTPstats* allocHTTPstats()              { return(stats->allocHTTPstats());     };
+  virtual DnsStats*  allocDNSstats()               { return(stats->allocDNSstats());      };
+  virtual ICMPstats* allocICMPstats()              { return(stats->allocICMPstats());     };
   virtual void luaTCP(lua_State *vm)               { stats->lua(vm,false,details_normal); };
   virtual u_int16_t getNumActiveContactsAsClient() { return stats->getNumActiveContactsAsClient(); };
   virtual u_int16_t getNumActiveContactsAsServer() { return stats->getNumActiveContactsAsServer(); };
@@ -112,7 +123,7 @@ class LocalHost : public Host, public SerializableElement {
 
   virtual void lua(lua_State* vm, AddressTree * ptree, bool host_details,
 		   bool verbose, bool returnHost, bool asListElement);
-  void custom_periodic_stats_update(const struct timeval *tv) { ; }
+  void custom_periodic_stats_update(const struct timeval *tv);
 
   virtual void luaHostBehaviour(lua_State* vm)    { if(stats) stats->luaHostBehaviour(vm); }
   virtual void incDohDoTUses(Host *srv_host);
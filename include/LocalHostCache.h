@@ -0,0 +1,105 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#ifndef _LOCAL_HOST_CACHE_H_
+#define _LOCAL_HOST_CACHE_H_
+
+#include "ntop_includes.h"
+
+typedef enum {
+  local_host_cache_restore = 0,
+  local_host_cache_save,
+  local_host_cache_delete
+} LocalHostCacheOp;
+
+/* ******************************* */
+
+class LocalHostCacheRequest {
+ private:
+  std::atomic<u_int8_t> num_refs;
+  std::atomic<bool> completed;
+
+ public:
+  LocalHostCacheOp op;
+  char *key, *value;
+  json_object *state; /* Save: state to write. Restore: restored state, NULL if none */
+  u_int32_t expire_secs;
+  struct timeval enqueue_time;
+
+  LocalHostCacheRequest(LocalHostCacheOp _op, const char *_key, u_int8_t _num_refs);
+  ~LocalHostCacheRequest();
+
+  inline void setCompleted()        { completed = true;   };
+  inline bool isCompleted()   const { return(completed);  };
+  inline json_object* getState()    { return(state);      };
+  /* Both the cache and the host hold a reference to a restore: the last one frees it */
+  inline void release()             { if(--num_refs == 0) delete this; };
+};
+
+/* ******************************* */
+
+/** @class LocalHostCache
+ *  @brief Loads and saves the local hosts state (local host cache) in background.
+ *  @details Requests are queued by the threads updating the hosts and served
+ *  in order by a per-interface thread, which sends them to redis in
+ *  pipelines and does the JSON (de)serialization. As the queue is FIFO, a
+ *  host restored just after having been saved gets the saved state. The
+ *  callers never wait: when the queue is full saves and deletes are dropped,
+ *  and restores are retried by the hosts. Restored states are applied by
+ *  the hosts themselves, see LocalHost::applyRestoredState().
+ */
+class LocalHostCache {
+ private:
+  NetworkInterface *iface;
+  pthread_t loaderThread;
+  bool thread_started, shutdown;
+  std::queue<LocalHostCacheRequest*> requests;
+  Mutex queue_lock;
+  Condvar queue_cond;
+
+  struct {
+    u_int64_t num_restores, num_restored, num_saves, num_deletes, num_inline, num_full, num_dropped;
+    u_int64_t restore_total_ms, restore_max_ms, restore_last_ms;
+    u_int32_t max_queued;
+  } stats;
+
+  bool enqueue(LocalHostCacheRequest *req);
+  void enqueueOrDrop(LocalHostCacheRequest *req);
+  void processBatch(LocalHostCacheRequest **reqs, u_int num_reqs);
+
+ public:
+  LocalHostCache(NetworkInterface *_iface);
+  ~LocalHostCache();
+
+  inline bool isRunning() const { return(thread_started); };
+  /* NULL when not queued: the caller restores inline if !isRunning(), otherwise it retries later */
+  LocalHostCacheRequest* restore(const char *key);
+  /* The cache takes ownership of state */
+  void save(const char *key, json_object *state, u_int32_t expire_secs);
+  void save(const char *key, const char *value, u_int32_t expire_secs);
+  void del(const char *key);
+
+  void loaderLoop();
+  void lua(lua_State *vm);
+};
+
+#endif /* _LOCAL_HOST_CACHE_H_ */
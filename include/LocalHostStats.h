@@ -22,7 +22,7 @@
 #ifndef _LOCAL_HOST_STATS_H_
 #define _LOCAL_HOST_STATS_H_
 
-class LocalHostStats: public HostStats {
+class LocalHostStats: public HostStats, public PoolAllocated {
  protected:
   /* Written by NetworkInterface::processPacket thread */
   DnsStats *dns;
@@ -39,14 +39,15 @@ class LocalHostStats: public HostStats {
 
   /* Estimate of the number of different Domain Names contacted */
   Cardinality num_contacted_domain_names;
+  std::atomic<bool> domain_names_reset_req; /* Set by the host checks, served when the next name is added */
  
   /* Estimate the number of contacted hosts using HyperLogLog */
-  struct ndpi_hll hll_contacted_hosts;
+  Cardinality hll_contacted_hosts;
   double old_hll_value, new_hll_value, hll_delta_value;
   DESCounter contacted_hosts;
 
   /* Estimate the number of contacted countries using HyperLogLog */
-  struct ndpi_hll hll_countries_contacts;
+  Cardinality hll_countries_contacts;
   u_int8_t old_hll_countries_value, new_hll_countries_value, hll_delta_countries_value;
 
 
@@ -59,6 +60,8 @@ class LocalHostStats: public HostStats {
 
   PeerStats *peers;
 
+  void initCardinalities();
+  MostVisitedList* allocTopSites();
   void updateHostContacts();
   void removeRedisSitesKey();
   void addRedisSitesKey();
@@ -82,12 +85,18 @@ class LocalHostStats: public HostStats {
 			bool peer_is_unicast);
   virtual void updateStats(const struct timeval *tv);
   virtual void getJSONObject(json_object *my_object, DetailsLevel details_level);
+  /* Same as getJSONObject() without saving the top sites */
+  void getCountersJSONObject(json_object *my_object, DetailsLevel details_level);
   virtual void deserialize(json_object *obj);
   virtual void lua(lua_State* vm, bool mask_host, DetailsLevel details_level);
   virtual void resetTopSitesData();
-  virtual void addContactedDomainName(char* domain_name)    { num_contacted_domain_names.addElement(domain_name,strlen(domain_name));  }
-  virtual u_int32_t getDomainNamesCardinality()             { return num_contacted_domain_names.getEstimate(); }  
-  virtual void resetDomainNamesCardinality()                { num_contacted_domain_names.reset();              } 
+  virtual void addContactedDomainName(char* domain_name) {
+    /* The reset is done by the thread adding the names, as AlertCounter does */
+    if(domain_names_reset_req.exchange(false)) num_contacted_domain_names.reset();
+    num_contacted_domain_names.addElement(domain_name, strlen(domain_name));
+  }
+  virtual u_int32_t getDomainNamesCardinality()             { return(domain_names_reset_req ? 0 : num_contacted_domain_names.getEstimate()); }  
+  virtual void resetDomainNamesCardinality()                { domain_names_reset_req = true;                   }
 
   virtual void luaDNS(lua_State *vm, bool verbose)  { if(dns) dns->lua(vm, verbose); }
   virtual void luaHTTP(lua_State *vm)  { if(http) http->lua(vm); }
@@ -103,17 +112,21 @@ class LocalHostStats: public HostStats {
   virtual HTTPstats* getHTTPstats() { return(http); };
   virtual DnsStats*  getDNSstats()  { return(dns);  };
   virtual ICMPstats* getICMPstats() { return(icmp); };
+  virtual HTTPstats* allocHTTPstats();
+  virtual DnsStats*  allocDNSstats();
+  virtual ICMPstats* allocICMPstats();
+  u_int32_t luaMemory(lua_State *vm);
   virtual u_int16_t getNumActiveContactsAsClient() { return(num_contacts_as_cli); }
   virtual u_int16_t getNumActiveContactsAsServer() { return(num_contacts_as_srv); }
 
   virtual void incCliContactedPorts(u_int16_t port)  { num_contacted_ports_as_client.addElement(port);      }
   virtual void incSrvPortsContacts(u_int16_t port)   { num_host_contacted_ports_as_server.addElement(port); }
 
-  virtual u_int32_t getSlidingAvgCliContactedPeers() { return(peers->getCliSlidingEstimate()); };
-  virtual u_int32_t getSlidingAvgSrvContactedPeers() { return(peers->getSrvSlidingEstimate()); };
-  virtual u_int32_t getTotAvgCliContactedPeers()     { return(peers->getCliTotEstimate()); };
-  virtual u_int32_t getTotAvgSrvContactedPeers()     { return(peers->getSrvTotEstimate()); };
-  virtual bool getSlidingWinStatus()                 { return(peers->getSlidingWinStatus()); };
+  virtual u_int32_t getSlidingAvgCliContactedPeers() { return(peers ? peers->getCliSlidingEstimate() : 0); };
+  virtual u_int32_t getSlidingAvgSrvContactedPeers() { return(peers ? peers->getSrvSlidingEstimate() : 0); };
+  virtual u_int32_t getTotAvgCliContactedPeers()     { return(peers ? peers->getCliTotEstimate() : 0); };
+  virtual u_int32_t getTotAvgSrvContactedPeers()     { return(peers ? peers->getSrvTotEstimate() : 0); };
+  virtual bool getSlidingWinStatus()                 { return(peers ? peers->getSlidingWinStatus() : false); };
 
   virtual u_int32_t getNTPContactCardinality()  { return(num_ntp_servers.getEstimate());  };
   virtual u_int32_t getDNSContactCardinality()  { return(num_dns_servers.getEstimate());  };
@@ -136,9 +149,9 @@ class LocalHostStats: public HostStats {
       num_contacted_services_as_client.addElement(name, strlen(name));
   }
 
-  virtual void incCountriesContacts(char *country)    { ndpi_hll_add(&hll_countries_contacts, country, strlen(country)); }
-  virtual u_int8_t getCountriesContactsCardinality()  { return((u_int8_t)ndpi_hll_count(&hll_countries_contacts));       }
-  virtual void resetCountriesContacts()               { ndpi_hll_reset(&hll_countries_contacts);                         } 
+  virtual void incCountriesContacts(char *country)    { hll_countries_contacts.addElement(country, strlen(country)); }
+  virtual u_int8_t getCountriesContactsCardinality()  { return((u_int8_t)hll_countries_contacts.getEstimate());      }
+  virtual void resetCountriesContacts()               { hll_countries_contacts.reset();                              }
 
 };
 
@@ -0,0 +1,50 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _LUA_BYTECODE_CACHE_H_
+#define _LUA_BYTECODE_CACHE_H_
+
+#include "ntop_includes.h"
+
+typedef struct {
+  time_t mtime;
+  off_t size;
+  std::string bytecode; /* As returned by lua_dump() */
+} lua_bytecode_cache_entry_t;
+
+/** @class LuaBytecodeCache
+ *  @brief Compiled Lua chunks shared among VMs, keyed by script path and mtime.
+ */
+class LuaBytecodeCache {
+ private:
+  RwLock lock;
+  std::map<std::string, lua_bytecode_cache_entry_t> entries;
+  u_int64_t num_hits, num_misses, tot_bytes;
+
+ public:
+  LuaBytecodeCache();
+
+  /* Pushes the compiled chunk on the stack, same return codes as luaL_loadfile */
+  int load(lua_State *L, const char *script_path);
+  void lua(lua_State *vm);
+};
+
+#endif /* _LUA_BYTECODE_CACHE_H_ */
@@ -38,13 +38,19 @@
 
 class ThreadedActivity;
 class ThreadedActivityStats;
+class LuaBytecodeCache;
 
 class LuaEngine {
  protected:
   lua_State *L; /**< The LuaEngine state.*/
   char *loaded_script_path;
+  bool http_vm_ready; /**< Libraries and classes already loaded (see init_http_vm) */
+  LuaBytecodeCache *bytecode_cache;
+  u_int32_t num_http_requests;
   
   void lua_register_classes(lua_State *L, bool http_mode);
+  void cleanupContext(struct ntopngLuaContext *ctx);
+  int run_http_file(char *script_path);
 
  public:
   /**
@@ -77,6 +83,11 @@ class LuaEngine {
 
   int load_script(char *script_path, NetworkInterface *iface);
   int run_loaded_script();
+  void reset_script_context(NetworkInterface *iface);
+
+  /* VMs reused across HTTP requests (see LuaEnginePool) */
+  void init_http_vm(LuaBytecodeCache *cache);
+  bool reset_http_vm();
 
   /**
    * @brief Handling of request info of script.
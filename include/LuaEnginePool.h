@@ -0,0 +1,66 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _LUA_ENGINE_POOL_H_
+#define _LUA_ENGINE_POOL_H_
+
+#include "ntop_includes.h"
+
+/* Upper bounds (ms) of the request latency histogram buckets, the last one is unbounded */
+#define LUA_ENGINE_POOL_LATENCY_BUCKETS { 1, 5, 10, 25, 50, 100, 250, 500, 1000, 2500 }
+#define LUA_ENGINE_POOL_NUM_BUCKETS     11
+/* Scripts with their own histograms, the others are accounted under LUA_ENGINE_POOL_OTHER_PATHS */
+#define LUA_ENGINE_POOL_MAX_PATHS       256
+#define LUA_ENGINE_POOL_OTHER_PATHS     "other"
+
+struct lua_engine_pool_latency {
+  u_int64_t hit[LUA_ENGINE_POOL_NUM_BUCKETS], miss[LUA_ENGINE_POOL_NUM_BUCKETS];
+};
+
+/** @class LuaEnginePool
+ *  @brief Warmed HTTP LuaEngine instances reused across requests.
+ *  @details An engine is returned to the pool once its request is over, after
+ *  LuaEngine::reset_http_vm() has brought it back to its initial globals. The
+ *  pool keeps at most one idle engine per web server thread.
+ */
+class LuaEnginePool {
+ private:
+  Mutex m;
+  std::vector<LuaEngine*> idle_engines;
+  u_int16_t max_idle_engines;
+  LuaBytecodeCache bytecode_cache;
+  u_int64_t num_hits, num_misses, num_discarded;
+  struct lua_engine_pool_latency latency;
+  std::map<std::string, struct lua_engine_pool_latency> latency_by_path;
+
+  static void luaHistogram(lua_State *vm, const char *name, const u_int64_t *buckets);
+  static void luaLatency(lua_State *vm, const struct lua_engine_pool_latency *l);
+
+ public:
+  LuaEnginePool(u_int16_t _max_idle_engines);
+  ~LuaEnginePool();
+
+  LuaEngine* get(bool *reused);
+  void release(LuaEngine *l, bool reused, const char *path, u_int32_t latency_ms);
+  void lua(lua_State *vm);
+};
+
+#endif /* _LUA_ENGINE_POOL_H_ */
@@ -37,6 +37,25 @@ class MySQLDB : public DB {
   volatile bool db_created;
   pthread_t queryThreadLoop;
 
+  /*
+    Batch mode (--mysql-batch-rows > 1): the dumper appends the flows to the
+    filling batch, the query thread runs the flushing one. Two batches are
+    swapped so that the dumper never waits for the database.
+  */
+  typedef struct {
+    char *sql[2]; /* [0] IPv4, [1] IPv6: INSERT ... VALUES (...),(...) */
+    u_int32_t sql_len[2], sql_size[2], num_rows[2];
+    struct timeval first_row;
+  } mysql_batch_t;
+
+  mysql_batch_t batches[2], *filling, *flushing;
+  Mutex batch_lock;
+  Condvar batch_ready;
+  u_int32_t batch_max_rows;
+  /* Batch stats */
+  u_int64_t num_batches, num_batch_rows;
+  float last_batch_ms, total_batch_ms, last_batch_rows_sec;
+
   bool connectToDB(MYSQL *conn, bool select_db);
   void open_log();
   char* get_last_db_error(MYSQL *conn) { return((char*)mysql_error(conn)); }
@@ -46,6 +65,12 @@ class MySQLDB : public DB {
   virtual bool createDBSchema();
   bool createNprobeDBView();
   MYSQL* mysql_try_connect(MYSQL *conn, const char *dbname);
+  bool initBatch(mysql_batch_t *b);
+  void resetBatch(mysql_batch_t *b);
+  bool appendToBatch(bool ipv4, const char *values, u_int32_t values_len);
+  bool swapBatches();
+  void flushBatch(mysql_batch_t *b);
+  void batchQueryLoop();
   int exec_quick_sql_query(char *sql, char *out, u_int out_len);
   void mysql_result_to_lua(lua_State *vm, MYSQL_RES *result,
 			   int num_fields, bool limitRows);
@@ -64,6 +89,7 @@ class MySQLDB : public DB {
   int exec_sql_query(lua_State *vm, char *sql, bool limitRows, bool wait_for_db_created);
   virtual bool startQueryLoop();
   void shutdown();
+  virtual void lua(lua_State* vm, bool since_last_checkpoint) const;
   int exec_single_query(lua_State *vm, char *sql);
   int select_database(char *dbname);
 };
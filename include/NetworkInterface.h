@@ -60,6 +60,7 @@ class HostChecksExecutor;
 class L7Policer;
 class FlowInterfacesStats;
 class TrafficShaper;
+class PacketShard;
 #endif
 
 /** @class NetworkInterface
@@ -132,6 +133,9 @@ class NetworkInterface : public NetworkInterfaceAlertableEntity {
     JSON. If this flag is false, flow fields are keyed with nProbe integer flow keys.
    */
   bool flows_dump_json_use_labels;
+  /* Buffer where flow JSONs are serialized for the dump, reused across flows */
+  JSONWriter *flows_dump_json_writer;
+  LocalHostCache *local_host_cache; /* Local hosts state saved/restored in background */
 
   /* Queue containing the ip@vlan strings of the hosts to restore. */
   StringFifoQueue *hosts_to_restore;
@@ -156,6 +160,16 @@ class NetworkInterface : public NetworkInterfaceAlertableEntity {
   FlowHashingEnum flowHashingMode;
   std::map<u_int64_t, NetworkInterface*> flowHashing;
 
+  /* Packet dissection workers (--packet-workers) */
+  PacketShard **packet_shards;
+  u_int8_t num_packet_shards;
+  NetworkInterface *shard_parent; /* When this is a packet shard, the interface it dissects packets for */
+  Mutex shard_hosts_lock;         /* Serializes the shards updating (and the purge of) the hosts of this interface */
+
+  /* Secondary flow indexes (see FlowIndexes), built inline with the purge */
+  FlowIndexes *flow_indexes;
+  bool flow_indexes_requested;
+
   /* Network Discovery */
   NetworkDiscovery *discovery;
   MDNS *mdns;
@@ -230,6 +244,8 @@ class NetworkInterface : public NetworkInterfaceAlertableEntity {
   L4Stats l4Stats;
   SyslogStats syslogStats;
   FlowHash *flows_hash; /**< Hash used to store flows information. */
+  /* Slab allocators of the hot objects, see ObjectPool */
+  ObjectPool *flows_pool, *ndpi_flows_pool, *local_hosts_pool, *remote_hosts_pool, *local_host_stats_pool;
   u_int32_t last_remote_pps, last_remote_bps;
   TimeseriesExporter *influxdb_ts_exporter, *rrd_ts_exporter;
 
@@ -283,6 +299,19 @@ class NetworkInterface : public NetworkInterfaceAlertableEntity {
   void deleteDataStructures();
 
   NetworkInterface* getDynInterface(u_int64_t criteria, bool parser_interface);
+  void initPacketShards();
+  void offloadHousekeeping();
+  void allocateFlowsPools();
+  void allocateHostsPools();
+  void stopPacketShards();
+  bool walkHashTables(u_int32_t *begin_slot, bool walk_all, WalkerType wtype,
+		      bool (*walker)(GenericHashEntry *h, void *user_data, bool *entryMatched),
+		      void *user_data);
+  bool walkFlows(u_int32_t *begin_slot, bool walk_all, Paginator *p, Host *host,
+		 bool (*walker)(GenericHashEntry *h, void *user_data, bool *entryMatched),
+		 void *user_data);
+  bool canUseFlowIndexes();
+  void checkFlowIndexes();
   Flow* getFlow(Mac *srcMac, Mac *dstMac, VLANid vlan_id,
 		u_int16_t observation_domain_id,
 		u_int32_t deviceIP, u_int32_t inIndex, u_int32_t outIndex,
@@ -337,7 +366,8 @@ class NetworkInterface : public NetworkInterfaceAlertableEntity {
 		AddressTree *allowed_hosts,
 		Host *host,
 		Paginator *p,
-		const char *sortColumn);
+		const char *sortColumn,
+		bool top_only);
 
   void addRedisSitesKey();
   void removeRedisSitesKey();
@@ -446,6 +476,8 @@ class NetworkInterface : public NetworkInterfaceAlertableEntity {
   virtual const char* get_type()    const      { return(customIftype ? customIftype : CONST_INTERFACE_TYPE_UNKNOWN); }
   virtual InterfaceType getIfType() const      { return(interface_type_UNKNOWN); }
   inline FlowHash *get_flows_hash()            { return flows_hash;     }
+  inline ObjectPool* get_ndpi_flows_pool()      { return(ndpi_flows_pool);       }
+  inline ObjectPool* get_local_host_stats_pool() { return(local_host_stats_pool); }
   inline TcpFlowStats* getTcpFlowStats()       { return(&tcpFlowStats); }
   virtual bool is_ndpi_enabled() const         { return(true);          }
   inline u_int  getNumnDPIProtocols()          { return(ndpi_get_num_supported_protocols(get_ndpi_struct())); };
@@ -569,6 +601,11 @@ class NetworkInterface : public NetworkInterfaceAlertableEntity {
   void updateLbdIdentifier();
   void updateDiscardProbingTraffic();
   void updateFlowsOnlyInterface();
+  void updateFlowIndexes();
+  void requestFlowIndexes(bool enabled);
+  void indexFlow(Flow *f);
+  void unindexFlow(Flow *f, bool wait);
+  void luaFlowIndexes(lua_State *vm);
   bool restoreHost(char *host_ip, VLANid vlan_id);
   void checkHostsToRestore();
   u_int printAvailableInterfaces(bool printHelp, int idx, char *ifname, u_int ifname_len);
@@ -804,6 +841,7 @@ class NetworkInterface : public NetworkInterfaceAlertableEntity {
   inline void setBridgeWanInterfaceId(u_int32_t v) { bridge_wan_interface_id = v;     };
   inline u_int32_t getBridgeWanInterfaceId()       { return(bridge_wan_interface_id); };
   inline HostHash* get_hosts_hash()                { return(hosts_hash);              }
+  inline LocalHostCache* getLocalHostCache()       { return(local_host_cache);        }
   inline bool is_bridge_interface()                { return(bridge_interface);        }
   inline const char* getLocalIPAddresses()         { return(ip_addresses.c_str());    }
   void addInterfaceAddress(char * const addr);
@@ -881,6 +919,17 @@ class NetworkInterface : public NetworkInterfaceAlertableEntity {
     viewed_interface_id = _viewed_interface_id;
   };
 
+  /*
+    Packet shards are internal to their parent interface: they are not registered
+    with ntop, share the parent id and their flows have no hosts, as for viewed
+    interfaces. Hosts are kept by the parent, see shardFlowUpdate.
+  */
+  inline bool isPacketShard()                const { return(shard_parent != NULL);   };
+  inline bool hasPacketShards()              const { return(num_packet_shards > 0);  };
+  inline NetworkInterface* getShardParent()  const { return(shard_parent);           };
+  inline void setPacketShard(NetworkInterface *parent) { shard_parent = parent;      };
+  void shardFlowUpdate(Flow *f, time_t t);
+
   bool getMacInfo(lua_State* vm, char *mac);
   bool resetMacStats(lua_State* vm, char *mac, bool delete_data);
   bool setMacDeviceType(char *strmac, DeviceType dtype, bool alwaysOverwrite);
@@ -1008,6 +1057,7 @@ class NetworkInterface : public NetworkInterfaceAlertableEntity {
   void execPeriodicUpdateChecks(Flow *f);
   void execFlowEndChecks(Flow *f);
   void execFlowBeginChecks(Flow *f);
+  void luaFlowChecksStats(lua_State *vm);
   void execHostChecks(Host *h);
   
   inline void incHostAnomalies(u_int32_t local, u_int32_t remote) {
@@ -105,6 +105,11 @@ class Ntop {
   /* Checks */
   FlowChecksLoader *flow_checks_loader;
   HostChecksLoader *host_checks_loader;
+  HostChecksScheduler *host_checks_scheduler;
+  HousekeepingEngine *housekeeping_engine;
+  RRDWriteEngine *rrd_write_engine;
+  TimeseriesStore *ts_store;
+  InfluxDBStreamer *influxdb_streamer;
 
   /* Hosts Control (e.g., disabled alerts) */
 #ifdef NTOPNG_PRO
@@ -414,6 +419,8 @@ class Ntop {
 #endif
   void setScriptsDir();
   void lua_periodic_activities_stats(NetworkInterface *iface, lua_State* vm);
+  /* Drops the VMs kept by the periodic scripts of the interface */
+  void purgePeriodicActivitiesVMs(NetworkInterface *iface);
   void getUsers(lua_State* vm);
   bool getLocalNetworkAlias(lua_State *vm, u_int8_t network_id);
   bool isUserAdministrator(lua_State* vm);
@@ -511,7 +518,7 @@ class Ntop {
   bool   recipients_are_empty();
   bool   recipients_enqueue(AlertFifoItem *notification, AlertEntity alert_entity);
   bool   recipient_enqueue(u_int16_t recipient_id, const AlertFifoItem* const notification);
-  bool   recipient_dequeue(u_int16_t recipient_id, AlertFifoItem *notification);
+  u_int32_t recipient_dequeue(u_int16_t recipient_id, AlertFifoItem *notifications, u_int32_t max_notifications);
   void   recipient_stats(u_int16_t recipient_id, lua_State* vm);
   time_t recipient_last_use(u_int16_t recipient_id);
   void   recipient_delete(u_int16_t recipient_id);
@@ -565,6 +572,11 @@ class Ntop {
 
   inline FlowChecksLoader* getFlowChecksLoader() { return(flow_checks_loader); }
   inline HostChecksLoader* getHostChecksLoader() { return(host_checks_loader); }
+  inline HostChecksScheduler* getHostChecksScheduler() { return(host_checks_scheduler); }
+  inline HousekeepingEngine* getHousekeepingEngine()     { return(housekeeping_engine);   }
+  inline RRDWriteEngine* getRRDWriteEngine()             { return(rrd_write_engine);      }
+  inline TimeseriesStore* getTimeseriesStore()           { return(ts_store);              }
+  inline InfluxDBStreamer* getInfluxDBStreamer()         { return(influxdb_streamer);     }
   inline u_int8_t getFlowAlertScore(FlowAlertTypeEnum alert_id) const { return flow_alerts_loader.getAlertScore(alert_id); };
   inline ndpi_risk_enum getFlowAlertRisk(FlowAlertTypeEnum alert_id) const { return flow_alerts_loader.getAlertRisk(alert_id); };
   inline const char * getRiskStr(ndpi_risk_enum risk_id) { return(ndpi_risk2str(risk_id)); };
@@ -0,0 +1,114 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#ifndef _OBJECT_POOL_H_
+#define _OBJECT_POOL_H_
+
+#include "ntop_includes.h"
+
+/*
+  Slab allocator for fixed size objects (flows, hosts, nDPI flows...).
+
+  Objects are carved out of slabs and recycled through a free list owned
+  by the allocating thread (the first thread allocating from the pool,
+  i.e., the packet thread of the interface), so allocations never lock.
+  Objects released by other threads (e.g., the purge loop deleting idle
+  entries) are pushed to a lock-free return stack that the owner drains
+  when its own list is empty.
+
+  Allocations from other threads, larger than the pool object size or
+  exceeding the pool capacity fall back to malloc. A header in front of
+  each object records where it comes from, so ObjectPool::release() works
+  for both. Only the owner has a cached free list: the other threads
+  allocating from the pool (e.g., hosts restored by the periodic scripts)
+  are rare, hence they use malloc rather than per-thread caches.
+
+  Objects can outlive the interface owning the pool (e.g., entries still
+  queued for deletion): destroy() only drops the reference of the creator
+  and the pool is deleted when its last object is released.
+*/
+class ObjectPool {
+ private:
+  typedef struct pool_chunk {
+    ObjectPool *pool;        /* NULL when the chunk has been malloc'ed */
+    struct pool_chunk *next; /* Free list, valid only when the chunk is free */
+  } pool_chunk_t;
+
+  char *name;
+  size_t object_size, chunk_size;
+  u_int32_t objects_per_slab, max_slabs;
+  std::vector<void*> slabs; /* Owner only */
+  pool_chunk_t *local_free; /* Owner only */
+  std::atomic<pool_chunk_t*> remote_free;
+  std::atomic<u_int8_t> owner_state;
+  pthread_t owner;
+
+  std::atomic<u_int32_t> num_slabs, num_in_use;
+  std::atomic<u_int32_t> num_refs; /* One per object in use, plus one until destroy() */
+  std::atomic<u_int64_t> num_allocs, num_fallback_allocs, num_remote_frees;
+
+  bool isOwner();
+  bool addSlab();
+  void push(pool_chunk_t *c);
+
+  void unref();
+
+  static void* mallocChunk(size_t sz);
+  static inline pool_chunk_t* chunkOf(void *ptr) { return(((pool_chunk_t*)ptr) - 1); }
+
+  ~ObjectPool(); /* See destroy() */
+
+ public:
+  ObjectPool(const char *_name, size_t _object_size, u_int32_t max_objects);
+
+  /* Use instead of delete: the pool is freed once all its objects have been released */
+  void destroy();
+
+  /* Uninitialized memory for an object of sz bytes, NULL if out of memory */
+  void* alloc(size_t sz);
+
+  /* Return memory obtained with alloc() to its pool (or to the heap) */
+  static void release(void *ptr);
+
+  /* Allocations that work also when no pool is available */
+  static inline void* alloc(ObjectPool *pool, size_t sz) { return(pool ? pool->alloc(sz) : mallocChunk(sz)); }
+
+  inline const char* getName() const { return(name); }
+  void lua(lua_State *vm);
+};
+
+/*
+  Mixin routing new/delete of a class through an ObjectPool:
+  new (pool) Flow(...) allocates from the pool, while plain new and
+  new (std::nothrow) keep using the heap.
+*/
+class PoolAllocated {
+ public:
+  static void* operator new(size_t sz);
+  static void* operator new(size_t sz, const std::nothrow_t&) throw();
+  static void* operator new(size_t sz, ObjectPool *pool) throw();
+  static void operator delete(void *ptr);
+  static void operator delete(void *ptr, const std::nothrow_t&);
+  static void operator delete(void *ptr, ObjectPool *pool);
+};
+
+#endif /* _OBJECT_POOL_H_ */
@@ -0,0 +1,90 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _PACKET_SHARD_H_
+#define _PACKET_SHARD_H_
+
+#include "ntop_includes.h"
+
+/* Preallocated packets per shard (see PacketShard::PacketShard) */
+#define NUM_PACKET_SHARD_ITEMS (PACKET_SHARD_QUEUE_LEN - QUEUE_WATERMARK)
+
+/* A decoded packet, copied by the capture thread for a shard worker */
+typedef struct {
+  struct pcap_pkthdr h;
+  struct bpf_timeval when;
+  u_int64_t packet_time;
+  struct ndpi_ethhdr eth; /* Copied as it can be a dummy header not part of the packet */
+  u_int32_t bridge_iface_idx, len_on_wire;
+  VLANid vlan_id;
+  u_int16_t ip_offset, encapsulation_overhead;
+  bool ingressPacket, is_ipv6;
+  u_char *packet;       /* Grown by the capture thread to hold the whole caplen */
+  u_int32_t packet_size;
+} PacketShardItem;
+
+/** @class PacketShard
+ *  @brief A worker thread processing a subset of the flows of a packet interface.
+ *  @details The capture thread of the (parent) interface dissects packets and
+ *  dispatches them to the shard owning their flow using a symmetric 5-tuple hash.
+ *  Each shard is a sub-interface with its own flows hash table, and its thread is the
+ *  only one calling processPacket() and purgeIdle() on it. The shard owns the
+ *  sub-interface, which is not registered with ntop (see NetworkInterface::initPacketShards).
+ */
+class PacketShard {
+ private:
+  NetworkInterface *iface; /**< The shard sub-interface */
+  u_int8_t shard_id;
+  PacketShardItem *items;
+  PacketShardItem *spare_item; /**< Dequeued by the capture thread but not yet used */
+  SPSCQueue<PacketShardItem*> *queue;      /**< Capture thread -> worker */
+  SPSCQueue<PacketShardItem*> *free_items; /**< Worker -> capture thread */
+  pthread_t workerLoop;
+  bool workerLoopCreated;
+  volatile bool stopRequested;
+  u_int64_t num_enqueued, num_dropped, num_processed, num_waits;
+
+ public:
+  PacketShard(NetworkInterface *_iface, u_int8_t _shard_id);
+  ~PacketShard();
+
+  static u_int32_t symmetricHash(const struct ndpi_iphdr *iph, const struct ndpi_ipv6hdr *ip6,
+				 const u_char *packet, u_int16_t ip_offset, u_int32_t caplen);
+
+  inline NetworkInterface* getInterface() const { return(iface);         };
+  inline u_int64_t getNumDropped()        const { return(num_dropped);   };
+
+  /* wait_for_room: wait for the worker instead of dropping (e.g. reading a pcap file) */
+  bool enqueue(u_int32_t bridge_iface_idx, bool ingressPacket,
+	       const struct bpf_timeval *when, const u_int64_t packet_time,
+	       struct ndpi_ethhdr *eth, VLANid vlan_id,
+	       bool is_ipv6, u_int16_t ip_offset,
+	       u_int16_t encapsulation_overhead, u_int32_t len_on_wire,
+	       const struct pcap_pkthdr *h, const u_char *packet,
+	       bool wait_for_room);
+
+  bool startWorker();
+  void stopWorker();
+  void processLoop();
+  void lua(lua_State *vm) const;
+};
+
+#endif /* _PACKET_SHARD_H_ */
@@ -67,6 +67,14 @@ class ParsedFlow : public ParsedFlowCore, public ParsedeBPF {
     additional_fields_tlv = NULL;
     return tlv; 
   };
+  /* Takes ownership of tlv (not copied by the copy constructor) */
+  inline void setAdditionalFieldsTLV(ndpi_serializer *tlv) {
+    if(additional_fields_tlv) {
+      ndpi_term_serializer(additional_fields_tlv);
+      free(additional_fields_tlv);
+    }
+    additional_fields_tlv = tlv;
+  };
   inline bool hasParsedeBPF() const { return has_parsed_ebpf; };
   inline void setParsedeBPF()       { has_parsed_ebpf = true; };
   virtual ~ParsedFlow();
@@ -33,7 +33,7 @@ class PartializableFlowTrafficStats {
   u_int64_t cli2srv_goodput_bytes, srv2cli_goodput_bytes;
   FlowTCPPacketStats cli2srv_tcp_stats, srv2cli_tcp_stats;
   u_int16_t cli_host_score[MAX_NUM_SCORE_CATEGORIES], srv_host_score[MAX_NUM_SCORE_CATEGORIES];
-  bool is_flow_alerted; /* NOTE: only used by view interfaces. Potentially removed in the future after views rework */
+  bool is_flow_alerted; /* NOTE: only used by view interfaces (and packet shards). Potentially removed in the future after views rework */
   union {
     FlowHTTPStats http;
     FlowDNSStats dns;
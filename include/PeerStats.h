@@ -47,6 +47,11 @@ public:
       ndpi_free_data_analysis(contacted_peer_as_srv, 1);
   }
 
+  inline u_int32_t getMemoryUsage() const {
+    /* Each analysis keeps a window of _max_series_len u_int32_t values */
+    return(sizeof(*this) + 2 * (sizeof(struct ndpi_analyze_struct) + _max_series_len * sizeof(u_int32_t)));
+  }
+
   void init(u_int16_t _max_series_len) { ndpi_init_data_analysis(contacted_peer_as_cli, _max_series_len); };
   
   /* bool cli_or_srv => cli - true ; srv - false */
@@ -0,0 +1,59 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#ifndef _PERFECT_HASH_H_
+#define _PERFECT_HASH_H_
+
+#include "ntop_includes.h"
+
+/** @class PerfectHash
+ *  @brief Minimal-collision static map from strings to 64 bit values.
+ *  @details Built once from a known set of keys with the hash-and-displace
+ *  scheme: keys are first split into buckets, then each bucket is given a
+ *  seed that places all its keys into free slots. A lookup costs two hashes
+ *  of the key and a single memcmp() against the only candidate, regardless
+ *  of the number of keys. The table is immutable once built: rebuild a new
+ *  one to add keys. Lookups are thread safe.
+ */
+class PerfectHash {
+ private:
+  int32_t *displacements; /* Per bucket: seed (> 0) or -(slot + 1) for single-key buckets */
+  int32_t *slots;         /* Per slot: index of the key or -1 */
+  u_int32_t *key_offsets, *key_lens;
+  u_int64_t *values;
+  char *keys;
+  u_int32_t num_keys, mask;
+
+  static u_int32_t hash(u_int32_t seed, const char *key, u_int32_t key_len);
+  void cleanup();
+
+ public:
+  PerfectHash();
+  ~PerfectHash();
+
+  /* Returns false on allocation failure or when no placement could be found */
+  bool build(const std::vector<std::pair<std::string, u_int64_t> > &entries);
+  bool find(const char *key, u_int32_t key_len, u_int64_t *value) const;
+  inline u_int32_t getNumKeys() const { return(num_keys); };
+};
+
+#endif /* _PERFECT_HASH_H_ */
@@ -40,6 +40,7 @@ class PeriodicActivities {
 
   void startPeriodicActivitiesLoop();
   void lua(NetworkInterface *iface, lua_State *vm);
+  void purgeVMs(NetworkInterface *iface);
   void run();
 
   inline bool isRunning() { return(thread_running); }
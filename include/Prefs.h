@@ -110,6 +110,12 @@ class Prefs {
   char *local_networks;
   bool local_networks_set, shutdown_when_done, simulate_vlans, simulate_macs, ignore_vlans, ignore_macs;
   bool insecure_tls; /**< Unsecure TLS connections a-la curl */
+  HashTableEngine hash_table_engine; /**< Engine used by GenericHash tables (--hash-table-engine) */
+  u_int8_t num_packet_shards; /**< Packet dissection threads per packet interface (--packet-workers) */
+  u_int8_t num_view_workers;  /**< Flow aggregation threads per view interface (--view-workers) */
+  u_int8_t num_housekeeping_workers; /**< Threads walking the hosts, MACs... hash tables (--housekeeping-workers) */
+  u_int8_t num_zmq_collector_workers; /**< Receive/decode threads per ZMQ collector interface (--zmq-collector-workers) */
+  u_int8_t num_rrd_writers; /**< Threads writing the RRD updates (--rrd-writers) */
   u_int32_t num_simulated_ips;
   char *data_dir, *install_dir, *docs_dir, *scripts_dir,
 	  *callbacks_dir, *pcap_dir
@@ -134,7 +140,7 @@ class Prefs {
 #ifdef __linux__
   cpu_set_t other_cpu_affinity_mask;
 #endif
-  u_int8_t redis_db_id;
+  u_int8_t redis_db_id, num_redis_connections;
   int redis_port;
   int dns_mode;
   bool json_labels_string_format;
@@ -144,6 +150,7 @@ class Prefs {
   int flows_syslog_facility;
 #endif
   int mysql_port;
+  u_int32_t mysql_batch_rows, mysql_batch_window_ms; /**< Multi-row INSERTs (--mysql-batch-rows/--mysql-batch-window) */
   int clickhouse_tcp_port;
   char *ls_host,*ls_port,*ls_proto;
   bool has_cmdl_trace_lvl; /**< Indicate whether a verbose level 
@@ -273,6 +280,12 @@ class Prefs {
   inline bool  do_simulate_vlans()                      { return(simulate_vlans);                   };
   inline bool  do_simulate_macs()                       { return(simulate_macs);                    };
   inline bool  do_insecure_tls()                        { return(insecure_tls);                     };
+  inline HashTableEngine get_hash_table_engine()        { return(hash_table_engine);                };
+  inline u_int8_t get_num_packet_shards()               { return(num_packet_shards);                };
+  inline u_int8_t get_num_view_workers()                { return(num_view_workers);                 };
+  inline u_int8_t get_num_housekeeping_workers()        { return(num_housekeeping_workers);         };
+  inline u_int8_t get_num_zmq_collector_workers()       { return(num_zmq_collector_workers);        };
+  inline u_int8_t get_num_rrd_writers()                 { return(num_rrd_writers);                  };
   inline char* get_cpu_affinity()                       { return(cpu_affinity);                     };
   inline char* get_other_cpu_affinity()                 { return(other_cpu_affinity);               };
 #ifdef __linux__
@@ -285,6 +298,7 @@ class Prefs {
   inline char* get_redis_password()                     { return(redis_password); }
   inline u_int get_redis_port()                         { return(redis_port);     };
   inline u_int get_redis_db_id()                        { return(redis_db_id);    };
+  inline u_int8_t get_num_redis_connections()           { return(num_redis_connections); };
   inline char* get_pid_path()                           { return(pid_path);       };
   inline char* get_packet_filter()                      { return(packet_filter);  };
 
@@ -337,6 +351,8 @@ class Prefs {
   inline bool use_promiscuous()         { return(use_promiscuous_mode);  };
   inline char* get_mysql_host()         { return(mysql_host);            };
   inline int get_mysql_port()           { return(mysql_port);            };
+  inline u_int32_t get_mysql_batch_rows()      { return(mysql_batch_rows);      };
+  inline u_int32_t get_mysql_batch_window_ms() { return(mysql_batch_window_ms); };
   inline int get_clickhouse_tcp_port()  { return(clickhouse_tcp_port);   };
   inline char* get_mysql_dbname()       { return(mysql_dbname);          };
   inline char* get_mysql_tablename()    { return((char*)"flows");        };
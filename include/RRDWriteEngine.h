@@ -0,0 +1,86 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _RRD_WRITE_ENGINE_H_
+#define _RRD_WRITE_ENGINE_H_
+
+#include "ntop_includes.h"
+
+/*
+  Writes the RRD updates submitted in batches by the timeseries scripts
+  (see RRDTimeseriesExporter and ntop.rrd_update_batch) out of the Lua
+  threads. Each RRD file belongs to a writer thread that journals its
+  points: a pass over the journal updates every file once with all its
+  pending points, in path order. The slower the disk, the more points each
+  pass coalesces. Submitters wait when the journal is full, and the points
+  that still don't fit are dropped.
+*/
+class RRDWriteEngine {
+ private:
+  typedef struct {
+    u_int32_t timestamp;
+    time_t queued;      /* Submission time, to detect the points written late */
+    std::string update; /* <timestamp>:<value>[:<value>...] as accepted by rrd_update */
+  } rrd_point_t;
+
+  typedef std::map<std::string, std::vector<rrd_point_t> > rrd_journal_t; /* By RRD path */
+
+  typedef struct {
+    pthread_t thread;
+    Mutex lock;          /* Protects journal and num_pending */
+    Condvar work_cond, room_cond;
+    rrd_journal_t journal;
+    u_int32_t num_pending;
+    time_t last_pass;
+    /* Stats */
+    u_int64_t num_submitted, num_dropped; /* Updated under lock */
+    u_int64_t num_written, num_rejected, num_files, num_passes, num_late;
+    u_int32_t max_delay, last_pass_ms;
+    time_t last_rate_update;
+    u_int64_t last_rate_written;
+    float points_rate;
+  } rrd_writer_t;
+
+  rrd_writer_t writers[RRD_WRITERS_MAX_NUM];
+  u_int8_t num_writers;
+  bool started;
+  volatile bool stopping;
+
+  static bool comparePoints(const rrd_point_t &a, const rrd_point_t &b) { return(a.timestamp < b.timestamp); };
+  void applyJournal(rrd_writer_t *w, rrd_journal_t *journal);
+  void updateRate(rrd_writer_t *w, time_t now);
+
+ public:
+  RRDWriteEngine(u_int8_t _num_writers);
+  ~RRDWriteEngine();
+
+  void start();
+  /* Writes the pending points and stops the writers */
+  void shutdown();
+
+  /* points are <RRD path, update> pairs. Returns the number of points accepted */
+  u_int32_t submit(const std::vector<std::pair<std::string, std::string> > &points);
+
+  void writerLoop(u_int8_t writer_id);
+  void lua(lua_State *vm);
+};
+
+#endif /* _RRD_WRITE_ENGINE_H_ */
@@ -29,13 +29,22 @@ class RecipientQueues {
  private:
   u_int16_t recipient_id;
 
-  AlertFifoQueue *queue;
+  /* Allocated by the first enqueue: most recipients only get a few notifications, if any */
+  std::atomic<AlertFifoQueue*> queue;
+
+  /* Serializes the consumers (Lua VMs) of the single-consumer queue */
+  Mutex dequeue_lock;
 
   /* Counters for the number of drops occurred when enqueuing */
-  u_int64_t drops;
+  std::atomic<u_int64_t> drops;
 
   /* Counters for the number of enqueues */
-  time_t uses;
+  std::atomic<u_int64_t> uses;
+
+  /* Time spent enqueueing notifications (nsec) */
+  std::atomic<u_int64_t> enqueue_nsec, max_enqueue_nsec;
+
+  AlertFifoQueue* getQueue();
 
   /* Timestamp of the last dequeue, regardless of queue priority */
   time_t last_use;
@@ -54,21 +63,24 @@ class RecipientQueues {
   ~RecipientQueues();
 
   /**
-  * @brief Dequeues a notification from a `recipient_id` queue
-  * @param notification The dequeued notification
+  * @brief Dequeues up to `max_notifications` notifications from a `recipient_id` queue
+  * @param notifications The dequeued notifications, whose payload must be released with decRefs()
+  * @param max_notifications The maximum number of notifications to dequeue
   *
-  * @return Boolean, true if the dequeue was successful and `notification` is populated correctly, false otherwise
+  * @return The number of dequeued notifications
   */
-  bool dequeue(AlertFifoItem *notification);
+  u_int32_t dequeue(AlertFifoItem *notifications, u_int32_t max_notifications);
   
   /**
   * @brief Enqueues a notification to a `recipient_id` queue
-  * @param recipient_id An integer recipient identifier
-  * @param notification A string containing the notification
+  * @param notification The notification to be enqueued
+  * @param alert_entity The entity of the alert, used to filter host pools
+  * @param payload The alert string shared with the other recipients
   *
   * @return True if the enqueue succeeded, false otherwise
   */
-  bool enqueue(const AlertFifoItem* const notification, AlertEntity alert_entity);
+  bool enqueue(const AlertFifoItem* const notification, AlertEntity alert_entity,
+	       AlertFifoPayload *payload);
   
   /**
   * @brief Sets the minimum severity for notifications to use this recipient
@@ -95,7 +107,7 @@ class RecipientQueues {
   inline void setEnabledHostPools(Bitmap128 _enabled_pools)       { enabled_host_pools = _enabled_pools; };
   
   /**
-   * @brief Returns queue status (drops and uses)
+   * @brief Returns queue status (drops, uses, fill level and enqueue latency)
    * @param vm A Lua VM instance
    *
    * @return
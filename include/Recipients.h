@@ -29,20 +29,22 @@ class Recipients {
  private:
   /* Per-recipient queues */
   RecipientQueues* recipient_queues[MAX_NUM_RECIPIENTS];
-  Mutex m;
+  /* Write-locked only to register/delete recipients */
+  RwLock m;
 
 public:
   Recipients();
   ~Recipients();
 
   /**
-  * @brief Dequeues a notification from a `recipient_id` queue, given a certain priority
+  * @brief Dequeues up to `max_notifications` notifications from a `recipient_id` queue
   * @param recipient_id An integer recipient identifier
-  * @param notification The dequeued notification
+  * @param notifications The dequeued notifications, whose payload must be released with decRefs()
+  * @param max_notifications The maximum number of notifications to dequeue
   *
-  * @return Boolean, true if the dequeue was successful and `notification` is populated correctly, false otherwise
+  * @return The number of dequeued notifications
   */
-  bool dequeue(u_int16_t recipient_id, AlertFifoItem *notification);
+  u_int32_t dequeue(u_int16_t recipient_id, AlertFifoItem *notifications, u_int32_t max_notifications);
 
   /**
   * @brief Enqueues a notification to a `recipient_id` queue, depending on the priority
@@ -26,23 +26,59 @@
 
 class Host;
 
+#define REDIS_PIPELINE_MAX_ARGS 8
+
+typedef struct {
+  int argc;
+  const char *argv[REDIS_PIPELINE_MAX_ARGS];
+  size_t argvlen[REDIS_PIPELINE_MAX_ARGS];
+  redisReply *reply; /* Set by Redis::pipeline(), to be freed with freeReplyObject() */
+} redis_pipeline_cmd_t;
+
+/* Command classes with their own latency histogram */
+typedef enum {
+  redis_latency_get = 0,
+  redis_latency_set,
+  redis_latency_del,
+  redis_latency_hash,
+  redis_latency_list,
+  redis_latency_other,
+  redis_latency_pipeline,
+  redis_latency_num_classes
+} RedisLatencyClass;
+
+typedef struct {
+  u_int32_t num_expire, num_get, num_ttl, num_del,
+    num_hget, num_hset, num_hdel, num_set,
+    num_keys, num_hkeys, num_llen, num_other,
+    num_hgetall, num_trim, num_lpush_rpush,
+    num_lpop_rpop, num_strlen, num_saved_lookups,
+    num_get_address, num_set_resolved_address,
+    num_pipelines;
+  u_int32_t num_reconnections;
+  u_int32_t num_locks;
+  u_int64_t lock_wait_usec, max_lock_wait_usec;
+  /* Bucket i counts commands that took less than 2^i usec, the last one the slower ones */
+  u_int32_t latency[redis_latency_num_classes][REDIS_LATENCY_BUCKETS];
+} redis_stats_t;
+
+/* Each connection serializes its own commands: threads are spread across
+   the connections so they no longer contend on a single context */
+typedef struct {
+  redisContext *ctx;
+  Mutex *m;
+  redis_stats_t stats; /* Updated while holding m */
+} redis_connection_t;
+
 class Redis {
  private:
-  redisContext *redis;
-  Mutex *l;
+  redis_connection_t *connections;
+  u_int8_t num_connections;
   char *redis_host, *redis_password, *redis_version;
 #ifdef __linux__
   bool is_socket_connection;
 #endif
-  struct {
-    u_int32_t num_expire, num_get, num_ttl, num_del,
-      num_hget, num_hset, num_hdel, num_set,
-      num_keys, num_hkeys, num_llen, num_other,
-      num_hgetall, num_trim, num_lpush_rpush,
-      num_lpop_rpop, num_strlen, num_saved_lookups,
-      num_get_address, num_set_resolved_address;
-    u_int32_t num_reconnections;
-  } stats;
+  redis_stats_t stats; /* Address resolution counters, the rest is per connection */
   u_int32_t num_redis_version;
   u_int16_t redis_port;
   u_int8_t redis_db_id;
@@ -50,12 +86,17 @@ class Redis {
   pthread_t lsThreadLoop;
   bool operational;
   bool initializationCompleted;
-  std::map<std::string, StringCache> stringCache;
+  StringLRUCache *stringCache;
   StringFifoQueue *localToResolve, *remoteToResolve;
-  u_int numCached;
 
   char* getRedisVersion();
-  void reconnectRedis(bool giveup_on_failure);
+  void reconnectRedis(redis_connection_t *c, bool giveup_on_failure);
+  redis_connection_t* lockConnection(const char *filename, const int line, bool trace_errors = true);
+  void unlockConnection(redis_connection_t *c, const char *filename, const int line, bool trace_errors = true);
+  redisReply* command(redis_connection_t *c, RedisLatencyClass latency_class, const char *format, ...);
+  redisReply* commandArgv(redis_connection_t *c, RedisLatencyClass latency_class,
+			  int argc, const char **argv, const size_t *argvlen);
+  void sumStats(redis_stats_t *tot);
   int msg_push(const char * cmd, const char * queue_name, const char * msg, u_int queue_trim_size,
 	       bool trace_errors = true, bool head_trim = true);
   int lrpop(const char *queue_name, char *buf, u_int buf_len, bool lpop);
@@ -70,7 +111,7 @@ class Redis {
   Redis(const char *redis_host = (char*)"127.0.0.1",
 	const char *redis_password = NULL,
 	u_int16_t redis_port = 6379, u_int8_t _redis_db_id = 0,
-	bool giveup_on_failure = false);
+	bool giveup_on_failure = false, u_int8_t _num_connections = 1);
   ~Redis();
 
   inline char* getVersion()        { return(redis_version);     }
@@ -94,6 +135,9 @@ class Redis {
   int hashKeys(const char *pattern, char ***keys_p);
   int hashGetAll(const char *key, char ***keys_p, char ***values_p);
   int del(char *key);
+  /* Sends all the commands in a single round trip and collects their replies */
+  int pipeline(redis_pipeline_cmd_t *cmds, u_int num_cmds);
+  inline u_int8_t getNumConnections() { return(num_connections); };
   int pushHostToResolve(char *hostname, bool dont_check_for_existence, bool localHost);
   int popHostToResolve(char *hostname, u_int hostname_len);
 
@@ -33,6 +33,9 @@ template <typename T> class SPSCQueue {
  private:
   char *name;
   u_int64_t num_failed_enqueues; /* Counts the number of times the enqueue has failed (queue full) */
+  u_int64_t num_enqueued;        /* Producer side */
+  u_int64_t num_dequeued;        /* Consumer side */
+  u_int32_t max_length;          /* Highest number of queued items seen by dequeueBatch() */
   u_int64_t shadow_head;
   volatile u_int64_t head;
   volatile u_int64_t tail;
@@ -51,7 +54,8 @@ template <typename T> class SPSCQueue {
     queue.resize(queue_size);
     tail = shadow_tail = queue_size-1;
     head = shadow_head = 0;
-    num_failed_enqueues = 0;
+    num_failed_enqueues = num_enqueued = num_dequeued = 0;
+    max_length = 0;
     name = strdup(_name ? _name : "");
   }
 
@@ -92,6 +96,7 @@ template <typename T> class SPSCQueue {
 
     T item = queue[next_tail];
     shadow_tail = next_tail;
+    num_dequeued++;
 
     if ((shadow_tail & QUEUE_WATERMARK_MASK) == 0)
       tail = shadow_tail;
@@ -99,6 +104,37 @@ template <typename T> class SPSCQueue {
     return item;
   }
 
+  /**
+   * Pop up to max_items items from the tail with a single read of the head
+   * and a single update of the tail
+   * Return the number of items copied to items (0 if the queue is empty)
+   */
+  inline u_int32_t dequeueBatch(T *items, u_int32_t max_items) {
+    u_int32_t cur_head = head, num = 0, queued;
+
+    queued = (cur_head - shadow_tail - 1) & (queue_size-1);
+    if(queued > max_length) max_length = queued;
+
+    while((num < max_items) && (num < queued)) {
+      shadow_tail = (shadow_tail + 1) & (queue_size-1);
+      items[num++] = queue[shadow_tail];
+    }
+
+    if(num > 0) {
+      tail = shadow_tail;
+      num_dequeued += num;
+    }
+
+    return num;
+  }
+
+  /**
+   * Return the number of items waiting to be dequeued (consumer side)
+   */
+  inline u_int32_t getLength() const {
+    return (head - shadow_tail - 1) & (queue_size-1);
+  }
+
   inline bool wait() {
     return((c.wait() < 0) ? false : true);
   }
@@ -118,6 +154,7 @@ template <typename T> class SPSCQueue {
       queue[shadow_head] = item;
 
       shadow_head = next_head;
+      num_enqueued++;
       c.signal();
       
       if (flush || (shadow_head & QUEUE_WATERMARK_MASK) == 0)
@@ -130,6 +167,13 @@ template <typename T> class SPSCQueue {
     return false; /* no room */
   }
 
+  /**
+   * Makes the items enqueued without flush available to the consumer
+   */
+  inline void flush() {
+    head = shadow_head;
+  }
+
   /**
    * Return the number of failed enqueue attempts
    */
@@ -142,6 +186,10 @@ template <typename T> class SPSCQueue {
     if(vm) {
       lua_newtable(vm);
       lua_push_uint64_table_entry(vm, "num_failed_enqueues", num_failed_enqueues);
+      lua_push_uint64_table_entry(vm, "num_enqueued", num_enqueued);
+      lua_push_uint64_table_entry(vm, "num_dequeued", num_dequeued);
+      lua_push_uint32_table_entry(vm, "length", getLength());
+      lua_push_uint32_table_entry(vm, "max_length", max_length);
       lua_pushstring(vm, name ? name : "");
       lua_insert(vm, -2);
       lua_settable(vm, -3);
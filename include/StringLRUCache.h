@@ -0,0 +1,96 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#ifndef _STRING_LRU_CACHE_H_
+#define _STRING_LRU_CACHE_H_
+
+#include "ntop_includes.h"
+
+/** @class StringLRUCache
+ *  @brief Bounded string to string cache with per-key expiration.
+ *  @details Keys are spread over independently locked shards so that
+ *  concurrent readers seldom meet. Each shard holds at most
+ *  max_entries / num_shards keys and evicts the least recently used one
+ *  when full. Keys with a TTL are also linked in a one second timing wheel
+ *  which is advanced on every access, so expired keys are released even if
+ *  they are never read again. Lookups by const char* do not allocate.
+ *  Values read from the backing store are added with fill(), which is
+ *  discarded if the shard has been written since getVersion(): a slow
+ *  reader cannot overwrite a newer value with the one it read.
+ */
+class StringLRUCache {
+ private:
+  struct Entry {
+    Entry *hash_next;               /* Bucket chain */
+    Entry *lru_prev, *lru_next;     /* Most recently used first */
+    Entry *wheel_prev, *wheel_next; /* Expiration slot (unused when expire is 0) */
+    u_int32_t hash;
+    time_t expire;
+    std::string key, value;
+  };
+
+  struct Shard {
+    Mutex m;
+    Entry **buckets;
+    Entry *lru_head, *lru_tail;
+    Entry *wheel[STRING_LRU_CACHE_WHEEL_SLOTS];
+    time_t wheel_last; /* Last second whose slot has been purged */
+    u_int32_t num_entries;
+    u_int64_t version; /* Bumped by every write */
+    u_int64_t num_hits, num_misses, num_evictions, num_expirations, num_stale_fills;
+  };
+
+  Shard *shards;
+  u_int32_t num_shards, max_shard_entries, bucket_mask;
+
+  static u_int32_t hash(const char *key);
+  inline Shard* getShard(u_int32_t h) { return(&shards[(h >> 24) & (num_shards - 1)]); };
+  Entry* find(Shard *s, const char *key, u_int32_t h);
+  void lruUnlink(Shard *s, Entry *e);
+  void lruPushFront(Shard *s, Entry *e);
+  void wheelUnlink(Shard *s, Entry *e);
+  void wheelLink(Shard *s, Entry *e);
+  void remove(Shard *s, Entry *e);
+  void purgeExpired(Shard *s, time_t now);
+  void store(Shard *s, const char *key, u_int32_t h, const char *value, u_int expire_secs);
+
+ public:
+  /* num_shards is rounded up to a power of two (max 256) */
+  StringLRUCache(u_int32_t num_shards, u_int32_t max_entries);
+  ~StringLRUCache();
+
+  /* Copies the value into rsp: returns false on miss or expired key */
+  bool get(const char *key, char *rsp, u_int rsp_len);
+  void set(const char *key, const char *value, u_int expire_secs);
+  /* To be read before fetching the value to fill() */
+  u_int64_t getVersion(const char *key);
+  /* As set() unless the key shard has been written since version: returns false then */
+  bool fill(const char *key, const char *value, u_int expire_secs, u_int64_t version);
+  /* Returns false when the key is not cached */
+  bool expire(const char *key, u_int expire_secs);
+  void remove(const char *key);
+  void clear();
+  u_int32_t getNumEntries();
+  void lua(lua_State *vm);
+};
+
+#endif /* _STRING_LRU_CACHE_H_ */
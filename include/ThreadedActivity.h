@@ -27,6 +27,12 @@
 class ThreadPool;
 class PeriodicScript;
 
+typedef struct {
+  LuaEngine *vm;       /* VM with the script already loaded */
+  time_t script_mtime; /* Modification time of the script when it was loaded */
+  time_t created;
+} threaded_activity_vm_t;
+
 class ThreadedActivity {
  private:
   u_int32_t deadline_approaching_secs;
@@ -35,6 +41,7 @@ class ThreadedActivity {
   u_int32_t next_schedule;
   PeriodicScript *periodic_script;
   std::map<std::string, ThreadedActivityStats*> threaded_activity_stats;
+  std::map<std::string, threaded_activity_vm_t> idle_vms; /* VMs kept across runs, protected by m */
 
   void updateNextSchedule(u_int32_t now);
   void setDeadlineApproachingSecs();
@@ -43,6 +50,10 @@ class ThreadedActivity {
   void updateThreadedActivityStatsBegin(NetworkInterface *iface, char *script_name, struct timeval *begin);
   void updateThreadedActivityStatsEnd(NetworkInterface *iface, char *script_name, u_long latest_duration);
   LuaEngine* loadVM(char *script_path, NetworkInterface *iface, time_t when);
+  bool getPooledVM(char *script_path, NetworkInterface *iface, time_t when, threaded_activity_vm_t *pooled);
+  void releaseVM(char *script_path, NetworkInterface *iface, threaded_activity_vm_t *pooled);
+  bool isVMReusable();
+  static std::string vmKey(char *script_name, NetworkInterface *iface);
   void set_state(NetworkInterface *iface, char *script_name, ThreadedActivityState ta_state);
   static const char* get_state_label(ThreadedActivityState ta_state);
   bool isValidScript(char* dir, char *path);
@@ -79,6 +90,8 @@ class ThreadedActivity {
 						  bool allocate_if_missing);
 
   void lua(NetworkInterface *iface, lua_State *vm);
+  /* Drops the idle VMs of the interface, e.g. when it is removed */
+  void purgeVMs(NetworkInterface *iface);
   void schedule(u_int32_t now);
 };
 
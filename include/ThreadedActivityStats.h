@@ -58,6 +58,8 @@ class ThreadedActivityStats {
   const ThreadedActivity *threaded_activity;
   u_long num_not_executed, num_is_slow;
   u_long max_duration_ms, last_duration_ms;
+  u_long num_vm_created, num_vm_reused;
+  ticks tot_vm_load_ticks; /* Time spent creating VMs and loading the script */
   int progress;
   time_t scheduled_time, deadline;
   static ticks tickspersec;
@@ -87,6 +89,7 @@ class ThreadedActivityStats {
   void updateStatsQueuedTime(time_t queued_time);
   void updateStatsBegin(struct timeval *begin);
   void updateStatsEnd(u_long duration_ms);
+  void updateVMStats(bool reused, ticks load_ticks);
 
   void setNotExecutedActivity(bool _not_executed);
   void setSlowPeriodicActivity(bool _slow);
@@ -0,0 +1,70 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _TIMESERIES_BLOCK_H_
+#define _TIMESERIES_BLOCK_H_
+
+#include "ntop_includes.h"
+
+/*
+  Compresses the points of a series as done by Facebook Gorilla: the
+  timestamps as delta-of-deltas, the values XOR-ed with the previous
+  value of the same metric. Regular steps and slowly changing counters
+  take a few bits per point.
+
+  Layout: the timestamps, then the values of each metric in turn.
+*/
+class TimeseriesBlock {
+ private:
+  class BitWriter {
+  private:
+    std::string *out;
+    u_int8_t free_bits; /* In the last byte of out */
+
+  public:
+    BitWriter(std::string *_out) { out = _out, free_bits = 0; };
+    void write(u_int64_t value, u_int8_t num_bits);
+  };
+
+  class BitReader {
+  private:
+    const u_int8_t *data;
+    u_int32_t data_len, bit_offset;
+
+  public:
+    BitReader(const u_int8_t *_data, u_int32_t _data_len) { data = _data, data_len = _data_len, bit_offset = 0; };
+    /* false when reading past the end of the data */
+    bool read(u_int8_t num_bits, u_int64_t *value);
+  };
+
+  static void encodeValues(BitWriter *w, const double *values, u_int16_t num_points, u_int8_t stride);
+  static bool decodeValues(BitReader *r, double *values, u_int16_t num_points, u_int8_t stride);
+
+ public:
+  /* values holds num_metrics values per point. timestamps must be increasing */
+  static void encode(const u_int32_t *timestamps, const double *values,
+		     u_int16_t num_points, u_int8_t num_metrics, std::string *out);
+  static bool decode(const u_int8_t *data, u_int32_t data_len,
+		     u_int16_t num_points, u_int8_t num_metrics,
+		     u_int32_t *timestamps, double *values);
+};
+
+#endif /* _TIMESERIES_BLOCK_H_ */
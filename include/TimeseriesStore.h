@@ -0,0 +1,193 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _TIMESERIES_STORE_H_
+#define _TIMESERIES_STORE_H_
+
+#include "ntop_includes.h"
+
+/*
+  Embedded append-only timeseries store, used by the "tsdb" timeseries
+  driver. The recent points of a series are kept in a head block in
+  memory, then compressed (see TimeseriesBlock) and appended to the
+  segment file of their schema and day:
+
+    <working dir>/tsdb/<schema>/<day start>.tsb
+
+  A segment is a sequence of blocks: a header, the series key and the
+  compressed points. Segments are read through mmap and deleted as a whole
+  when older than the data retention. Queries consolidate the points in
+  the step requested, turning counters into per-second rates.
+
+  Queries find the blocks of a series through an in-memory index of the
+  segment (block offsets by series key), built on its first query and
+  extended with the blocks appended since. Blocks are sealed under the
+  lock but written after releasing it: until written they are also read
+  from memory. Queries only open the segments and copy the points in
+  memory under the lock, the blocks are mapped and decoded after releasing
+  it.
+*/
+class TimeseriesStore {
+ private:
+  typedef struct {
+    u_int32_t magic;
+    u_int32_t t_min, t_max;
+    u_int32_t data_len;
+    u_int16_t num_points, key_len;
+    u_int8_t num_metrics;
+    u_int8_t unused[3];
+  } ts_block_header_t; /* Followed by the series key and the compressed points */
+
+  typedef struct {
+    u_int8_t num_metrics;
+    u_int32_t window;           /* Segment of the points in memory */
+    u_int32_t last_timestamp;   /* Also of the points already written */
+    std::vector<u_int32_t> timestamps;
+    std::vector<double> values; /* num_metrics per point */
+  } ts_head_t;
+
+  typedef std::map<std::string, ts_head_t> ts_heads_t; /* By series key */
+
+  typedef struct {
+    std::string schema;
+    u_int32_t window;
+    std::string buf;            /* Blocks, in the segment format */
+  } ts_pending_write_t;
+
+  typedef struct {
+    u_int32_t t_max;            /* Of the newest block */
+    std::vector<size_t> offsets;
+  } ts_key_blocks_t;
+
+  typedef struct {
+    ino_t ino;                  /* Of the file indexed: segments are replaced when rewritten */
+    size_t len;                 /* Bytes of the segment indexed */
+    u_int64_t last_use;         /* To evict the least recently used */
+    std::map<std::string, ts_key_blocks_t> keys;
+  } ts_segment_index_t;
+
+  typedef struct {
+    u_int8_t num_metrics;
+    std::vector<u_int32_t> timestamps;
+    std::vector<double> values; /* num_metrics per point */
+  } ts_points_t;
+
+  typedef std::map<std::string, ts_points_t> ts_series_points_t; /* By series key */
+
+  typedef struct {
+    std::vector<std::string> paths; /* Segments of the range, oldest first */
+    std::vector<int> fds;           /* Opened under the lock, still readable if deleted or replaced */
+    std::string pending;            /* Copy of the pending blocks of the series */
+    ts_series_points_t heads;       /* Copy of the points in memory of the series */
+  } ts_query_snapshot_t;
+
+  std::string base_dir;
+  Mutex write_lock; /* Serializes the segment writes, taken before lock */
+  RwLock lock; /* Protects the head blocks, the pending writes and the segment files */
+  std::map<std::string, ts_heads_t> heads; /* By schema */
+  std::list<ts_pending_write_t> pending;   /* Sealed blocks not yet removed after their write, oldest first */
+  std::set<std::string> checked_segments;  /* Tail checked after a possible crash (write_lock) */
+  Mutex indexes_lock;
+  std::map<std::string, ts_segment_index_t> indexes; /* By segment path */
+  u_int64_t num_index_uses;
+  time_t last_flush;
+
+  /* Stats */
+  u_int64_t num_points, num_rejected, num_blocks, num_written_points, num_bytes, num_raw_bytes;
+  u_int64_t num_write_errors;
+  std::atomic<u_int64_t> num_queries, query_usec;
+
+  static bool validSchema(const char *schema);
+  std::string schemaPath(const std::string &schema) const;
+  std::string segmentPath(const std::string &schema, u_int32_t window) const;
+  void listSegments(const std::string &schema, std::vector<u_int32_t> *windows) const;
+  void listSchemas(std::set<std::string> *schemas) const;
+
+  bool mapSegment(const std::string &path, u_int8_t **addr, size_t *len, ino_t *ino = NULL) const;
+  bool mapSegmentFd(int fd, const std::string &path, u_int8_t **addr, size_t *len, ino_t *ino) const;
+  static bool readBlock(const u_int8_t *addr, size_t len, size_t *offset,
+			ts_block_header_t *hdr, const u_int8_t **key, const u_int8_t **data);
+  static bool matchesKey(const u_int8_t *key, u_int16_t key_len, const std::vector<std::string> &filters);
+  static bool selectsKey(const u_int8_t *key, u_int16_t key_len,
+			 const std::string *selected_key, const std::vector<std::string> *filters);
+  static bool dropBlocks(const u_int8_t *addr, size_t len, const std::vector<std::string> &filters, std::string *kept);
+
+  ts_segment_index_t* indexSegment(const std::string &path, const u_int8_t *addr, size_t len, ino_t ino);
+  void findBlocks(const std::string &path, const u_int8_t *addr, size_t len, ino_t ino,
+		  const std::string *key, const std::vector<std::string> *filters,
+		  u_int32_t from, std::vector<size_t> *offsets);
+  void dropIndexes(const std::string &path);
+
+  void sealHead(const std::string &key, ts_head_t *head, std::string *buf);
+  void queueWrite(const std::string &schema, u_int32_t window, std::string *buf);
+  void writePending();
+  void writePendingLocked();
+  void checkSegmentTail(const std::string &path);
+  bool writeSegment(const std::string &schema, u_int32_t window, const std::string &buf);
+  void flushSchema(const std::string &schema, ts_heads_t *schema_heads, time_t now, bool force);
+  bool rewriteSegment(const std::string &path, const std::vector<std::string> &filters);
+
+  static void addPoints(ts_points_t *points, const u_int32_t *timestamps, const double *values,
+			u_int32_t num_points, u_int8_t num_metrics, u_int32_t from, u_int32_t to);
+  void snapshotQuery(const std::string &schema, const std::string *key, const std::vector<std::string> *filters,
+		     u_int32_t from, u_int32_t to, ts_query_snapshot_t *snapshot);
+  void collectPoints(const std::string *key, const std::vector<std::string> *filters,
+		     u_int32_t from, u_int32_t to, ts_query_snapshot_t *snapshot, ts_series_points_t *series);
+  static void pushConsolidated(lua_State *vm, const ts_points_t *points, u_int32_t start, u_int32_t step,
+			       u_int32_t count, TsConsolidation cf, bool is_counter);
+
+ public:
+  TimeseriesStore(const char *working_dir);
+  ~TimeseriesStore();
+
+  /* false when the point is not newer than the last one of the series */
+  bool append(const char *schema, const char *key, u_int32_t timestamp,
+	      const double *values, u_int8_t num_metrics);
+  /* Writes the head blocks older than TSDB_HEAD_BLOCK_MAX_AGE, all of them when forced */
+  void flush(bool force);
+
+  /*
+    Pushes start, step, the values of each metric and their number,
+    consolidated in steps from tstart to tend. Returns the number of values
+    pushed, 0 when the series has no points in the range.
+  */
+  int fetch(lua_State *vm, const char *schema, const char *key,
+	    u_int32_t tstart, u_int32_t tend, u_int32_t step,
+	    TsConsolidation cf, bool is_counter);
+  /*
+    As fetch, for all the series having all the filters ("<tag>=<value>")
+    among their key tags, in a single pass over the segments: pushes start,
+    step, a table of the values of each metric by series key and their number
+  */
+  int fetchMany(lua_State *vm, const char *schema, const std::vector<std::string> &filters,
+		u_int32_t tstart, u_int32_t tend, u_int32_t step,
+		TsConsolidation cf, bool is_counter);
+  /* Pushes the keys of the series of the schema with points since start_time */
+  void listSeries(lua_State *vm, const char *schema, u_int32_t start_time);
+
+  /* Deletes the series having all the filters ("<tag>=<value>") among their key tags */
+  bool deleteSeries(const char *schema_prefix, const std::vector<std::string> &filters);
+  void deleteOldData(u_int32_t retention_secs);
+
+  void lua(lua_State *vm);
+};
+
+#endif /* _TIMESERIES_STORE_H_ */
@@ -0,0 +1,63 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#ifndef _TOPK_SELECTOR_H_
+#define _TOPK_SELECTOR_H_
+
+#include "ntop_includes.h"
+
+/** @class TopKSelector
+ *  @brief Keeps the best K of a stream of qsort()-style elements in a bounded heap.
+ *  @details Used when only a page of results is needed, so that the matching
+ *  entries do not have to be all stored and sorted. The caller owns the buffer,
+ *  which must be able to hold k+1 elements: the last one is the scratch slot
+ *  filled with candidate() and checked with commit().
+ */
+class TopKSelector {
+ private:
+  u_int8_t *elems, *tmp;
+  size_t elem_size;
+  u_int32_t k, num;
+  int dir; /* 1 = keep the greatest elements, -1 = keep the smallest */
+  int (*cmp)(const void *_a, const void *_b);
+
+  inline u_int8_t* at(u_int32_t i) const { return(&elems[i * elem_size]); };
+  /* True if a has to leave the heap before b */
+  inline bool worse(u_int32_t a, u_int32_t b) const { return((dir * cmp(at(a), at(b))) < 0); };
+  void swap(u_int32_t a, u_int32_t b);
+  void siftUp(u_int32_t i);
+  void siftDown(u_int32_t i);
+
+ public:
+  TopKSelector(void *_elems, size_t _elem_size, u_int32_t _k,
+	       int (*_cmp)(const void *_a, const void *_b), bool keep_greatest);
+  ~TopKSelector();
+
+  inline void* candidate() const { return(at(num < k ? num : k)); };
+  void commit();
+  /* Sorts the selected elements in ascending order, the heap is no longer usable */
+  void sort();
+
+  inline u_int32_t size() const { return(num); };
+};
+
+#endif /* _TOPK_SELECTOR_H_ */
@@ -95,6 +95,13 @@ public:
 			       char *json, int timeout,
 			       HTTPTranferStats *stats, char *return_data,
 			       int return_data_size, int *response_code);
+  static bool postHTTPJsonIovec(char *username, char *password, char *url,
+				const struct iovec *iov, u_int iovcnt,
+				int timeout, HTTPTranferStats *stats);
+  static long postHTTPKeepAlive(CURL *curl, const char *username, const char *password,
+				const char *url, const char *content_type, const char *content_encoding,
+				const char *data, u_int32_t data_len, int timeout,
+				HTTPTranferStats *stats, char *return_data, int return_data_size);
   static bool sendMail(lua_State* vm, char *from, char *to, char *cc, char *message, char *smtp_server, char *username, char *password);
   static bool postHTTPTextFile(lua_State* vm, char *username, char *password,
 			       char *url, char *path, int timeout, HTTPTranferStats *stats);
@@ -144,7 +151,8 @@ public:
   static bool isMulticastMac(const u_int8_t *mac);
   static int numberOfSetBits(u_int32_t i);
   static void initRedis(Redis **r, const char *redis_host, const char *redis_password,
-			u_int16_t redis_port, u_int8_t _redis_db_id, bool giveup_on_failure);
+			u_int16_t redis_port, u_int8_t _redis_db_id, bool giveup_on_failure,
+			u_int8_t num_connections = 1);
   static json_object *cloneJSONSimple(json_object *src);
 
   /* ScriptPeriodicity */
@@ -182,6 +190,14 @@ public:
     (*ewma) = (alpha_percent * sample + (100 - alpha_percent) * (*ewma)) / 100;
   }
   static inline u_int64_t toUs(struct timeval *t) { return(((u_int64_t)t->tv_sec)*1000000+((u_int64_t)t->tv_usec)); };
+  /* Monotonic clock, for measuring durations unaffected by wall clock changes */
+  static inline u_int64_t monotonicNsec() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(((u_int64_t)ts.tv_sec) * 1000000000 + ts.tv_nsec);
+  };
+  static inline u_int64_t monotonicUsec() { return(monotonicNsec() / 1000); };
   static void replacestr(char *line, const char *search, const char *replace);
   static u_int32_t getHostManagementIPv4Address();
   static bool isInterfaceUp(char *ifname);
@@ -24,12 +24,40 @@
 
 #include "ntop_includes.h"
 
+class ViewInterface;
+
+/* Flows dequeued by a view worker, whose partials are computed before
+   taking the aggregation locks */
+typedef struct {
+  ViewInterface *iface;
+  u_int8_t worker_id;
+  Flow *flows[VIEW_DEQUEUE_BATCH];
+  PartializableFlowTrafficStats partials[VIEW_DEQUEUE_BATCH];
+  bool first_partial[VIEW_DEQUEUE_BATCH], valid[VIEW_DEQUEUE_BATCH];
+  Host *cli_hosts[VIEW_DEQUEUE_BATCH], *srv_hosts[VIEW_DEQUEUE_BATCH];
+  u_int64_t num_flows, num_batches;
+} view_worker_t;
+
 class ViewInterface : public NetworkInterface {
  private:
   bool is_packet_interface;
   u_int8_t num_viewed_interfaces;
   NetworkInterface *viewed_interfaces[MAX_NUM_VIEW_INTERFACES];
   SPSCQueue<Flow *> *viewed_interfaces_queues[MAX_NUM_VIEW_INTERFACES];
+  /* Worker i dequeues the queues i, i + num_view_workers, ... Worker 0 runs in the
+     poll loop which also purges idle hosts. Host allocation and the stats shared
+     among hosts (interface, AS, country, network...) are updated under shared_stats_lock,
+     the stats of a host under the host_locks shard of its address */
+  u_int8_t num_view_workers;
+  view_worker_t *view_workers[MAX_NUM_VIEW_INTERFACES];
+  pthread_t viewWorkerLoops[MAX_NUM_VIEW_INTERFACES];
+  bool viewWorkerLoopsCreated[MAX_NUM_VIEW_INTERFACES];
+  volatile bool view_workers_stop;
+  Mutex shared_stats_lock, host_locks[VIEW_AGGREGATION_SHARDS];
+
+  inline u_int32_t hostShard(Host *h) const {
+    return((h->get_ip()->key() + h->get_vlan_id()) % VIEW_AGGREGATION_SHARDS);
+  }
 
   virtual void sumStats(TcpFlowStats *_tcpFlowStats, EthStats *_ethStats,
 			LocalTrafficStats *_localStats, nDPIStats *_ndpiStats,
@@ -49,12 +77,22 @@ class ViewInterface : public NetworkInterface {
 	      WalkerType wtype,
 	      bool (*walker)(GenericHashEntry *h, void *user_data, bool *matched),
 	      void *user_data);
-  void viewed_flows_walker(Flow *f, const struct timeval *tv);
+  /* Finds the view hosts of the flow and applies the partials to the stats
+     they share with other hosts: shared_stats_lock must be held */
+  void viewed_flows_shared_update(Flow *f, PartializableFlowTrafficStats *partials,
+				  bool first_partial, const struct timeval *tv,
+				  Host **cli_host, Host **srv_host);
+  /* Applies the partials to the stats owned by the view hosts, locking their shards */
+  void viewed_flows_hosts_update(Flow *f, PartializableFlowTrafficStats *partials,
+				 bool first_partial, const struct timeval *tv,
+				 Host *cli_host, Host *srv_host);
   /* Enqueues a flow to a queue reserved for viewed interface identified by viewed_interface_id */
   bool viewEnqueue(time_t t, Flow *f, u_int8_t viewed_interface_id);
-  /* Dequeues enqueued flows sequentially for each of the viewed interfaces belonging to this view.
+  /* Dequeues in batches the flows of the viewed interfaces owned by the worker.
      The total number of elements dequeued is returned. */
-  u_int64_t viewDequeue(u_int budget);
+  u_int64_t viewDequeue(u_int8_t worker_id, u_int budget);
+  void viewWorkerLoop(u_int8_t worker_id);
+  virtual void shutdown();
   virtual bool areTrafficDirectionsSupported() { return(true); };
   virtual InterfaceType getIfType() const { return interface_type_VIEW;           };
   virtual const char* get_type()    const { return CONST_INTERFACE_TYPE_VIEW;     };
@@ -36,12 +36,23 @@ typedef struct {
 class ZMQCollectorInterface : public ZMQParserInterface {
  private:
   void *context;
-  std::map<u_int8_t, u_int32_t>source_id_last_msg_id;
+  ZMQRecvContext recv_ctx; /* Used when receiving on the interface thread */
   bool is_collector;
   u_int8_t num_subscribers;
   zmq_subscriber subscriber[MAX_ZMQ_SUBSCRIBERS];
   char server_public_key[41], server_secret_key[41];
-    
+  u_int8_t num_workers;
+  ZMQCollectorWorker *workers[MAX_ZMQ_SUBSCRIBERS]; /* --zmq-collector-workers */
+  u_int32_t num_unprocessed_flows; /* Flows parsed by the workers but not processed */
+
+  int decompress(u_int8_t compression, const char *src, u_int32_t src_len, ZMQRecvContext *ctx);
+  void processMessage(u_int8_t subscriber_id, ZMQCollectorMsg *msg);
+  void processItem(ZMQCollectorItem *item);
+  void collectFromWorkers();
+  void startWorkers();
+  void stopWorkers();
+  void updateWorkersStats();
+
 #if ZMQ_VERSION >= ZMQ_MAKE_VERSION(4,1,0)
   char *generateEncryptionKeys();
 #endif
@@ -53,6 +64,8 @@ class ZMQCollectorInterface : public ZMQParserInterface {
   virtual const char* get_type()      const { return(CONST_INTERFACE_TYPE_ZMQ);      };
   inline char* getEndpoint(u_int8_t id)     { return((id < num_subscribers) ?
 						     subscriber[id].endpoint : (char*)""); };
+  inline void* getSocket(u_int8_t id)       { return((id < num_subscribers) ? subscriber[id].socket : NULL); };
+  bool recvMessage(void *socket, ZMQRecvContext *ctx, ZMQCollectorMsg *msg);
   virtual void checkPointCounters(bool drops_only);
   virtual bool isPacketInterface() const  { return(false);      };
   void collect_flows();
@@ -0,0 +1,88 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _ZMQ_COLLECTOR_WORKER_H_
+#define _ZMQ_COLLECTOR_WORKER_H_
+
+#include "ntop_includes.h"
+
+#ifndef HAVE_NEDGE
+
+class ZMQCollectorInterface;
+
+/** @class ZMQCollectorWorker
+ *  @brief A thread receiving, decoding and parsing the messages of some of
+ *  the ZMQ endpoints of a collector interface.
+ *  @details Parsed flows (and the messages that must be parsed by the
+ *  interface, e.g. counters) are handed to the interface thread, the only one
+ *  processing flows, through an SPSC queue. Templates are parsed by the worker
+ *  as they change the way the next flows are parsed.
+ */
+class ZMQCollectorWorker {
+ private:
+  ZMQCollectorInterface *iface;
+  u_int8_t worker_id, num_subscribers;
+  u_int8_t subscriber_ids[MAX_ZMQ_SUBSCRIBERS];
+  SPSCQueue<ZMQCollectorItem> *queue; /**< Worker -> interface thread */
+  ZMQRecvContext recv_ctx;
+  ZMQParserContext parser_ctx;
+  std::vector<ParsedFlow*> parsed_flows;
+  pthread_t workerLoop;
+  bool workerLoopCreated;
+  volatile bool stopRequested;
+  u_int32_t num_templates;
+  u_int64_t num_flows, num_queue_full;
+  /* Rates, updated by the worker every second */
+  time_t last_rate_update;
+  u_int32_t last_num_msgs;
+  u_int64_t last_num_flows;
+  float msgs_rate, flows_rate;
+
+  bool enqueue(ZMQCollectorItem *item);
+  void handleMessage(u_int8_t subscriber_id, ZMQCollectorMsg *msg);
+  void updateRates(time_t now);
+
+ public:
+  ZMQCollectorWorker(ZMQCollectorInterface *_iface, u_int8_t _worker_id);
+  ~ZMQCollectorWorker();
+
+  inline void addSubscriber(u_int8_t subscriber_id) {
+    if(num_subscribers < MAX_ZMQ_SUBSCRIBERS) subscriber_ids[num_subscribers++] = subscriber_id;
+  }
+  inline u_int32_t dequeueBatch(ZMQCollectorItem *items, u_int32_t max_items) {
+    return(queue ? queue->dequeueBatch(items, max_items) : 0);
+  }
+  inline u_int32_t getNumMsgs()         const { return(recv_ctx.num_msgs);            };
+  inline u_int32_t getNumMsgDrops()     const { return(recv_ctx.num_msg_drops);       };
+  inline u_int32_t getNumTemplates()    const { return(num_templates);                };
+  inline u_int32_t getNumInvalidFlows() const { return(parser_ctx.num_invalid_flows); };
+  inline u_int64_t getNumBytesCopied()  const { return(recv_ctx.num_bytes_copied); };
+  inline const ZMQRecvContext* getRecvContext() const { return(&recv_ctx); };
+
+  bool startWorker();
+  void stopWorker();
+  void receiveLoop();
+  void lua(lua_State *vm) const;
+};
+
+#endif /* HAVE_NEDGE */
+
+#endif /* _ZMQ_COLLECTOR_WORKER_H_ */
@@ -0,0 +1,51 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _ZMQ_PARSER_CONTEXT_H_
+#define _ZMQ_PARSER_CONTEXT_H_
+
+#include "ntop_includes.h"
+
+/*
+  Scratch state of a thread parsing ZMQ flows. The interface owns one for
+  its collection thread, each ZMQCollectorWorker owns its own.
+*/
+class ZMQParserContext {
+ public:
+  json_tokener *json_tok;
+  std::vector<json_object*> json_values; /* Values parsed on demand for the flow being processed */
+  std::vector<ParsedFlow*> *parsed_flows; /* When set, flows are copied here rather than processed */
+  u_int32_t num_invalid_flows;           /* Flows discarded while parsing into parsed_flows */
+
+  ZMQParserContext() {
+    json_tok = json_tokener_new();
+    parsed_flows = NULL, num_invalid_flows = 0;
+  }
+
+  ~ZMQParserContext() {
+    for(std::vector<json_object*>::const_iterator it = json_values.begin(); it != json_values.end(); ++it)
+      json_object_put(*it);
+
+    if(json_tok) json_tokener_free(json_tok);
+  }
+};
+
+#endif /* _ZMQ_PARSER_CONTEXT_H_ */
@@ -31,6 +31,10 @@ class ZMQParserInterface : public ParserInterface {
   typedef std::map<pen_value_t, string> descriptions_map_t;
   labels_map_t labels_map; /* Contains mappings between labels and integer IDs (PEN and ID) */
   descriptions_map_t descriptions_map; /* Contains mappings between integer IDs and descriptions */
+  PerfectHash *labels_hash; /* labels_map compiled for lookups, rebuilt when it changes */
+  bool labels_hash_dirty;
+  RwLock labels_lock; /* Templates vs flows parsed by ZMQCollectorWorker threads and Lua lookups */
+  ZMQParserContext parser_ctx; /* Used when parsing on the interface thread */
   
   bool once, is_sampled_traffic;
   u_int32_t flow_max_idle, returned_flow_max_idle;
@@ -45,7 +49,7 @@ class ZMQParserInterface : public ParserInterface {
   CustomAppMaps *custom_app_maps;
 #endif
 
-  bool preprocessFlow(ParsedFlow *flow);
+  bool preprocessFlow(ParsedFlow *flow, ZMQParserContext *ctx);
   void addMapping(const char *sym, u_int32_t num, u_int32_t pen = 0, const char *descr = NULL);
   bool parsePENZeroField(ParsedFlow * const flow, u_int32_t field, ParsedValue *value) const;
   bool parsePENNtopField(ParsedFlow * const flow, u_int32_t field, ParsedValue *value) const;
@@ -53,8 +57,13 @@ class ZMQParserInterface : public ParserInterface {
   bool matchPENNtopField(ParsedFlow * const flow, u_int32_t field, ParsedValue *value) const;
   static bool parseContainerInfo(json_object *jo, ContainerInfo * const container_info);
   bool parseNProbeAgentField(ParsedFlow * const flow, const char * key, ParsedValue *value, json_object * const jvalue) const;
-  int parseSingleJSONFlow(json_object *o, u_int8_t source_id);
-  int parseSingleTLVFlow(ndpi_deserializer *deserializer, u_int8_t source_id);
+  void updateLabelsHash();
+  json_object* getJSONValue(const json_scanner_value_t *v, ZMQParserContext *ctx);
+  void releaseJSONValues(ZMQParserContext *ctx);
+  void parseAdditionalJSON(ParsedFlow * const flow, char *json, u_int32_t json_len) const;
+  int parseSingleJSONFlow(JSONScanner *scanner, u_int8_t source_id, ZMQParserContext *ctx);
+  u_int8_t scanJSONFlow(char *payload, u_int32_t payload_len, u_int8_t source_id, ZMQParserContext *ctx);
+  int parseSingleTLVFlow(ndpi_deserializer *deserializer, u_int8_t source_id, ZMQParserContext *ctx);
   void setFieldMap(const ZMQ_FieldMap * const field_map) const;
   void setFieldValueMap(const ZMQ_FieldValueMap * const field_value_map) const;
 
@@ -80,10 +89,19 @@ public:
 
   bool getKeyId(char *sym, u_int32_t sym_len, u_int32_t * const pen, u_int32_t * const field) const;
   const char* getKeyDescription(u_int32_t pen, u_int32_t field) const;
+  /* As getKeyId() and getKeyDescription(), for the callers not parsing flows (e.g. Lua) */
+  const char* lookupKeyDescription(const char *key);
   bool matchField(ParsedFlow * const flow, const char * key, ParsedValue * value);
 
-  u_int8_t parseJSONFlow(const char * payload, int payload_size, u_int8_t source_id);
-  u_int8_t parseTLVFlow(const char * payload, int payload_size, u_int8_t source_id, void *data);
+  inline u_int8_t parseJSONFlow(char * payload, int payload_size, u_int8_t source_id) {
+    return(parseJSONFlow(payload, payload_size, source_id, &parser_ctx));
+  }
+  inline u_int8_t parseTLVFlow(const char * payload, int payload_size, u_int8_t source_id, void *data) {
+    return(parseTLVFlow(payload, payload_size, source_id, &parser_ctx));
+  }
+  /* Can be called by multiple threads, each with its own ctx. The payload is parsed (and modified) in place */
+  u_int8_t parseJSONFlow(char * payload, int payload_size, u_int8_t source_id, ZMQParserContext *ctx);
+  u_int8_t parseTLVFlow(const char * payload, int payload_size, u_int8_t source_id, ZMQParserContext *ctx);
   u_int8_t parseEvent(const char * payload, int payload_size, u_int8_t source_id, void *data);
   u_int8_t parseCounter(const char * payload, int payload_size, u_int8_t source_id, void *data);
   u_int8_t parseTemplate(const char * payload, int payload_size, u_int8_t source_id, void *data);
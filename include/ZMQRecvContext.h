@@ -0,0 +1,74 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _ZMQ_RECV_CONTEXT_H_
+#define _ZMQ_RECV_CONTEXT_H_
+
+#include "ntop_includes.h"
+
+/*
+  State of a thread receiving ZMQ messages (see
+  ZMQCollectorInterface::recvMessage). The interface owns one for its
+  collection thread, each ZMQCollectorWorker owns its own.
+*/
+class ZMQRecvContext {
+ public:
+  zmq_msg_t payload;  /* Last payload received, decoded in place */
+  char *arena;        /* Decompressed payloads, grown on demand and reused */
+  u_int32_t arena_size;
+  std::map<u_int8_t, u_int32_t> last_msg_ids; /* source_id -> last msg_id, to count drops */
+  u_int32_t num_msgs, num_msg_drops;
+  u_int64_t num_bytes, num_bytes_copied;
+  u_int64_t num_decompressed, decompress_ticks;
+
+  ZMQRecvContext() {
+    zmq_msg_init(&payload);
+    arena = NULL, arena_size = 0;
+    num_msgs = num_msg_drops = 0;
+    num_bytes = num_bytes_copied = 0;
+    num_decompressed = decompress_ticks = 0;
+  }
+
+  ~ZMQRecvContext() {
+    zmq_msg_close(&payload);
+    if(arena) free(arena);
+  }
+
+  /* Makes room for len bytes and a NUL in the arena (its content is lost) */
+  inline bool reserveArena(u_int32_t len) {
+    if(len >= arena_size) {
+      u_int32_t new_size = max(len + 1, 2 * arena_size);
+
+      if(arena) free(arena);
+
+      if((arena = (char*)malloc(new_size)) == NULL) {
+	arena_size = 0;
+	return(false);
+      }
+
+      arena_size = new_size;
+    }
+
+    return(true);
+  }
+};
+
+#endif /* _ZMQ_RECV_CONTEXT_H_ */
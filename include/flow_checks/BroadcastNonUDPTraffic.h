@@ -31,7 +31,9 @@ class BroadcastNonUDPTraffic : public FlowCheck {
  public:
   BroadcastNonUDPTraffic() : FlowCheck(ntopng_edition_community,
                         false /* All interfaces */, false /* Don't exclude for nEdge */, false /* NOT only for nEdge */,
-                        false /* has_protocol_detected */, false /* has_periodic_update */, false /* has_flow_end */, true /* has_flow_begin */) {};
+                        false /* has_protocol_detected */, false /* has_periodic_update */, false /* has_flow_end */, true /* has_flow_begin */) {
+    setL4Protocols(FLOW_CHECK_L4_ANY & ~FLOW_CHECK_L4_UDP);
+  };
   ~BroadcastNonUDPTraffic() {};
 
   void flowBegin(Flow *f);
@@ -36,6 +36,7 @@ class FlowRisk : public FlowCheck {
 						 false /* All interfaces */, false /* Don't exclude for nEdge */, false /* NOT only for nEdge */,
 						 true /* has_protocol_detected */, false /* has_periodic_update */, false /* has_flow_end */) {};
   ~FlowRisk() {};
+  /* NOTE: hooks are only executed for flows having this risk */
   virtual ndpi_risk_enum handledRisk()       { return NDPI_NO_RISK;    };
   void protocolDetected(Flow *f);
 };
@@ -32,7 +32,7 @@ class LowGoodputFlow : public FlowCheck {
  public:
   LowGoodputFlow() : FlowCheck(ntopng_edition_community,
 			       true /* Packet Interfaces only */, true /* Exclude for nEdge */, false /* Only for nEdge */,
-			       false /* has_protocol_detected */, true /* has_periodic_update */, true /* has_flow_end */) {};
+			       false /* has_protocol_detected */, true /* has_periodic_update */, true /* has_flow_end */) { setL4Protocols(FLOW_CHECK_L4_TCP); };
   virtual ~LowGoodputFlow() {};
 
   void periodicUpdate(Flow *f);
@@ -31,7 +31,7 @@ class TCPNoDataExchanged : public FlowCheck {
  public:
   TCPNoDataExchanged() : FlowCheck(ntopng_edition_community,
 				   true /* Packet Interfaces only */, false /* Don't exclude for nEdge */, false /* NOT only for nEdge */,
-				   false /* has_protocol_detected */, false /* has_periodic_update */, true /* has_flow_end */) {};
+				   false /* has_protocol_detected */, false /* has_periodic_update */, true /* has_flow_end */) { setL4Protocols(FLOW_CHECK_L4_TCP); };
   ~TCPNoDataExchanged() {};
 
   bool loadConfiguration(json_object *config1) { return(true); }
@@ -31,7 +31,7 @@ class TCPZeroWindow : public FlowCheck {
  public:
  TCPZeroWindow() : FlowCheck(ntopng_edition_community,
 			     true /* Packet Interfaces only */, true /* Exclude for nEdge */, false /* NOT only for nEdge */,
-			     false /* has_protocol_detected */, true /* has_periodic_update */, true /* has_flow_end */) {};
+			     false /* has_protocol_detected */, true /* has_periodic_update */, true /* has_flow_end */) { setL4Protocols(FLOW_CHECK_L4_TCP); };
   ~TCPZeroWindow() {};
 
   bool loadConfiguration(json_object *config) { return(true); }
@@ -31,7 +31,7 @@ class UDPUnidirectional : public FlowCheck {
  public:
   UDPUnidirectional() : FlowCheck(ntopng_edition_community,
 				     false /* All interfaces */, false /* Don't exclude for nEdge */, false /* NOT only for nEdge */,
-				     false /* has_protocol_detected */, true /* has_periodic_update */, true /* has_flow_end */) {};
+				     false /* has_protocol_detected */, true /* has_periodic_update */, true /* has_flow_end */) { setL4Protocols(FLOW_CHECK_L4_UDP); };
   ~UDPUnidirectional() {};
   
   void periodicUpdate(Flow *f);
@@ -34,7 +34,7 @@ protected:
   const IpAddress* getServerIP(Flow *f) { return(f->get_dhcp_srv_ip_addr()); }
   
  public:
-  UnexpectedDHCPServer() : UnexpectedServer() {};
+  UnexpectedDHCPServer() : UnexpectedServer() { addL7Protocol(NDPI_PROTOCOL_DHCP); };
   ~UnexpectedDHCPServer() {};
   
   FlowAlert *buildAlert(Flow *f) {
@@ -33,7 +33,7 @@ protected:
   const IpAddress* getServerIP(Flow *f) { return(f->get_dns_srv_ip_addr());    }
   
  public:
-  UnexpectedDNSServer() : UnexpectedServer() {};
+  UnexpectedDNSServer() : UnexpectedServer() { addL7Protocol(NDPI_PROTOCOL_DNS); };
   ~UnexpectedDNSServer() {};
   
   FlowAlert *buildAlert(Flow *f) {
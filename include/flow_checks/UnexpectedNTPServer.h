@@ -32,7 +32,7 @@ protected:
   bool isAllowedProto(Flow *f)       { return(f->isNTP());                    }
   
  public:
-  UnexpectedNTPServer() : UnexpectedServer() {};
+  UnexpectedNTPServer() : UnexpectedServer() { addL7Protocol(NDPI_PROTOCOL_NTP); };
   ~UnexpectedNTPServer() {};
   
   FlowAlert *buildAlert(Flow *f) {
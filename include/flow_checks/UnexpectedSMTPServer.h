@@ -32,7 +32,9 @@ protected:
   bool isAllowedProto(Flow *f)       { return(f->isSMTP());                  }
   
  public:
-  UnexpectedSMTPServer() : UnexpectedServer() {};
+  UnexpectedSMTPServer() : UnexpectedServer() {
+    addL7Protocol(NDPI_PROTOCOL_MAIL_SMTP), addL7Protocol(NDPI_PROTOCOL_MAIL_SMTPS);
+  };
   ~UnexpectedSMTPServer() {};
 
   FlowAlert *buildAlert(Flow *f) {
@@ -116,6 +116,11 @@
 #define ZMQ_COMPATIBILITY_MSG_VERSION 1
 #define ZMQ_MSG_VERSION           2
 #define ZMQ_MSG_VERSION_TLV       3
+#define ZMQ_MSG_VERSION_MASK      0x0F /* zmq_msg_hdr.version: the upper bits flag the payload compression */
+#define ZMQ_MSG_COMPRESSION_MASK  0xF0
+#define ZMQ_MSG_COMPRESSION_LZ4   0x10 /* Big-endian 32 bit uncompressed length + LZ4 block */
+#define ZMQ_MSG_COMPRESSION_ZSTD  0x20 /* Zstd frame */
+#define ZMQ_MSG_COMPRESSION_ZLIB  0x30 /* zlib stream, also flagged by a leading 0 byte in JSON payloads */
 #define LOGIN_URL                 "/lua/login.lua"
 #define LOGOUT_URL                "/lua/ntopng_logout.lua"
 #define CAPTIVE_PORTAL_URL        "/lua/captive_portal.lua"
@@ -193,6 +198,17 @@
 #define CONST_DEFAULT_TOP_TALKERS_ENABLED        false
 #define PURGE_FRACTION           60 /* check 1/60 of hashes per iteration */
 #define MIN_NUM_VISITED_ENTRIES  1024
+
+/* Open addressing hash table engine (--hash-table-engine) */
+#define HASH_STRIPE_NUM_SLOTS    512  /* Slots per lock stripe (power of two, multiple of the group size) */
+#define HASH_STRIPE_MAX_LOAD     0.75 /* Sizing load factor used to compute the number of stripes */
+#define HASH_SLOT_EMPTY          0x00 /* Tag of a never used slot: terminates probing */
+#define HASH_SLOT_DELETED        0x01 /* Tag of a purged slot (tombstone) */
+
+#define MAX_NUM_PACKET_SHARDS        16   /* Max --packet-workers */
+#define PACKET_SHARD_QUEUE_LEN       4096 /* Packets queued per shard */
+#define PACKET_SHARD_WALKER_BITS     24   /* Low begin_slot bits used by the shard being walked */
+
 #define MAX_NUM_QUEUED_ADDRS    500 /* Maximum number of queued address for resolution */
 #define MAX_NUM_QUEUED_CONTACTS 25000
 #define NTOP_COPYRIGHT          "(C) 1998-22 ntop.org"
@@ -223,6 +239,8 @@
 #define TRAFFIC_FILTERING_CACHE_DURATION  43200 /* 12 h */
 #define DNS_CACHE_DURATION                 3600  /*  1 h */
 #define LOCAL_HOSTS_CACHE_DURATION         3600  /*  1 h */
+#define LOCAL_HOST_CACHE_QUEUE_LEN         32768 /* Pending host state loads/saves per interface */
+#define LOCAL_HOST_CACHE_BATCH             128   /* Loads/saves sent to redis in a single pipeline */
 #define HOST_LABEL_NAMES_KEY    "ntopng.cache.host_labels.%s"
 #define IFACE_DHCP_RANGE_KEY    "ntopng.prefs.ifid_%u.dhcp_ranges"
 #define HOST_SERIALIZED_KEY     "ntopng.serialized_hosts.ifid_%u__%s@%d"
@@ -288,6 +306,7 @@
 #define CONST_INTERFACE_TYPE_SYSLOG    "syslog"
 #define CONST_INTERFACE_TYPE_VLAN      "Dynamic VLAN"
 #define CONST_INTERFACE_TYPE_FLOW      "Dynamic Flow Collection"
+#define CONST_INTERFACE_TYPE_SHARD     "Packet Shard"
 #define CONST_INTERFACE_TYPE_VIEW      "view"
 #define CONST_INTERFACE_TYPE_PF_RING   "PF_RING"
 #define CONST_INTERFACE_TYPE_NETFILTER "netfilter"
@@ -319,6 +338,7 @@
 #define ASES_BEHAVIOR_REFRESH          300 /* 5 min */
 #define NETWORK_BEHAVIOR_REFRESH       300 /* 5 min */
 #define HOST_SITES_TOP_NUMBER          10
+#define LOCAL_HOST_HLL_BITS            6  /* 64 bytes per sketch, ~13% std error */
 #define HOST_MAX_SERIALIZED_LEN        1048576 /* 1MB, use only when allocating memory in the heap */
 #define POOL_MAX_SERIALIZED_LEN        32768   /* bytes */
 #define POOL_MAX_NAME_LEN              33      /* Characters */
@@ -458,6 +478,9 @@
 #define MAX_SYSLOG_SUBSCRIBERS         8
 #define MAX_ZMQ_POLL_WAIT_MS        1000 /* 1 sec */
 #define MAX_ZMQ_POLLS_BEFORE_PURGE  1000
+#define MAX_ZMQ_DECOMPRESSED_LEN    (64 * 1024 * 1024) /* Max growth of the ZMQ decompression arena */
+#define ZMQ_COLLECTOR_QUEUE_LEN     8192 /* Flows and messages queued per ZMQ collector worker */
+#define ZMQ_COLLECTOR_DEQUEUE_BATCH 256  /* Items processed per worker queue visit */
 #define MAX_SYSLOG_POLL_WAIT_MS        MAX_ZMQ_POLL_WAIT_MS
 #define MAX_SYSLOG_POLLS_BEFORE_PURGE  MAX_ZMQ_POLLS_BEFORE_PURGE
 #define CONST_MAX_NUM_FIND_HITS       10
@@ -490,6 +513,13 @@
 #define CONST_MAX_REDIS_CONN_RETRIES 16
 #define CONST_MAX_LEN_REDIS_KEY      256
 #define CONST_MAX_LEN_REDIS_VALUE    2*65526
+#define REDIS_DEFAULT_NUM_CONNECTIONS 4
+#define REDIS_MAX_NUM_CONNECTIONS    32
+#define REDIS_LATENCY_BUCKETS        16   /* log2(usec): the last bucket holds commands slower than 16 msec */
+#define REDIS_PIPELINE_MAX_CMDS      4096 /* Per ntop.pipelineCache() call */
+#define REDIS_CACHE_SHARDS           16
+#define REDIS_CACHE_MAX_ENTRIES      32768 /* ntopng.cache/prefs/user keys kept in memory */
+#define STRING_LRU_CACHE_WHEEL_SLOTS 256   /* 1 sec each */
 
 #define NTOPNG_NDPI_OS_PROTO_ID      (NDPI_LAST_IMPLEMENTED_PROTOCOL+NDPI_MAX_NUM_CUSTOM_PROTOCOLS-2)
 #define CONST_DEFAULT_HOME_NET       "192.168.1.0/24"
@@ -564,11 +594,21 @@
 
 #define CONST_IEC104_LEARNING_TIME         21600 /* 6 hours */
 #define CONST_INFLUXDB_KEY_EXPORTED_POINTS "ntopng.cache.influxdb.num_exported_points"
+#define CONST_INFLUXDB_KEY_EXPORTS         "ntopng.cache.influxdb.num_exports"
+#define CONST_INFLUXDB_KEY_FAILED_EXPORTS  "ntopng.cache.influxdb.num_failed_exports"
+#define CONST_INFLUXDB_KEY_LAST_ERROR      "ntopng.cache.influxdb.last_error"
+#define CONST_INFLUXDB_FLAG_FAILING_EXPORTS "ntopng.cache.influxdb.flag_failing_exports"
+#define CONST_INFLUXDB_FLAG_DROPPING_POINTS "ntopng.cache.influxdb.flag_dropping_points"
+#define CONST_INFLUXDB_FLAGS_TIMEOUT       60 /* sec, keep in sync with influxdb.lua INFLUX_FLAGS_TIMEOUT */
 #define CONST_INFLUXDB_FLUSH_TIME          10 /* sec */
-#define CONST_INFLUXDB_MAX_DUMP_SIZE       4194304 /* 4 MB */
+#define INFLUXDB_STREAM_BATCH_SIZE         1*1024*1024 /* Line protocol bytes posted at once */
+#define INFLUXDB_STREAM_NUM_BATCHES        8    /* Batches being filled, waiting or being posted */
+#define INFLUXDB_STREAM_MAX_ATTEMPTS       3    /* Posts of a batch before it is spilled to disk */
+#define INFLUXDB_STREAM_TIMEOUT            30   /* sec */
 #define CONST_FLOW_ALERT_EVENT_QUEUE       "ntopng.cache.ifid_%d.flow_alerts_events_queue"
 #define SQLITE_ALERTS_QUEUE_SIZE           8192
 #define ALERTS_NOTIFICATIONS_QUEUE_SIZE    8192
+#define ALERTS_NOTIFICATIONS_DEQUEUE_BATCH 64 /* Notifications dequeued at once from a recipient queue */
 #define MAX_NUM_RECIPIENTS                 64 /* keep in sync with Recipients.lua recipients.MAX_NUM_RECIPIENTS */
 #define INTERNAL_ALERTS_QUEUE_SIZE         1024
 #define CONST_REMOTE_TO_REMOTE_MAX_QUEUE   32
@@ -579,6 +619,7 @@
 #define CONST_DEFAULT_SHOW_DYN_IFACE_TRAFFIC   false
 #define CONST_DEFAULT_LBD_SERIALIZE_AS_MAC     false
 #define CONST_DEFAULT_DISCARD_PROBING_TRAFFIC  false
+#define CONST_DEFAULT_FLOW_INDEXES             false
 #define CONST_DEFAULT_FLOWS_ONLY_INTERFACE     false
 #define CONST_ALERT_DISABLED_PREFS         NTOPNG_PREFS_PREFIX".disable_alerts_generation"
 #define CONST_PREFS_ENABLE_ACCESS_LOG      NTOPNG_PREFS_PREFIX".enable_access_log"
@@ -591,6 +632,7 @@
 #define CONST_DISABLED_FLOW_DUMP_PREFS     NTOPNG_PREFS_PREFIX".ifid_%d.is_flow_dump_disabled"
 #define CONST_LBD_SERIALIZATION_PREFS      NTOPNG_PREFS_PREFIX".ifid_%d.serialize_local_broadcast_hosts_as_macs"
 #define CONST_DISCARD_PROBING_TRAFFIC      NTOPNG_PREFS_PREFIX".ifid_%d.discard_probing_traffic"
+#define CONST_FLOW_INDEXES_PREFS           NTOPNG_PREFS_PREFIX".ifid_%d.flow_indexes_enabled"
 #define CONST_FLOWS_ONLY_INTERFACE         NTOPNG_PREFS_PREFIX".ifid_%d.debug.flows_only_interface"
 #define CONST_NBOX_USER                     NTOPNG_PREFS_PREFIX".nbox_user"
 #define CONST_NBOX_PASSWORD                 NTOPNG_PREFS_PREFIX".nbox_password"
@@ -709,6 +751,9 @@
 #define CONST_MAX_ALERT_MSG_QUEUE_LEN 8192
 #define CONST_MAX_ES_MSG_QUEUE_LEN    8192
 #define CONST_MAX_MYSQL_QUEUE_LEN     8192
+#define MYSQL_BATCH_MAX_ROWS          10000
+#define MYSQL_BATCH_MAX_LEN           (2*1024*1024) /* Per statement: keep it below max_allowed_packet */
+#define MYSQL_BATCH_DEFAULT_WINDOW_MS 1000
 #define CONST_MAX_NUM_READ_ALERTS     32
 #define CONST_MAX_ACTIVITY_DURATION    86400 /* sec */
 #define CONST_TREND_TIME_GRANULARITY   1 /* sec */
@@ -744,6 +789,19 @@
 #define FLOW_LUA_CALL_IDLE_FN_NAME               "flowEnd"
 #define FLOW_LUA_CALL_PERIODIC_UPDATE_SECS       60 /* One minute */
 
+#define HOST_CHECKS_WHEEL_SLOTS                  512  /* One second each: longer than the 5 minute checks period */
+#define HOST_CHECKS_NUM_WORKERS                  2
+#define HOST_CHECKS_TICK_BUDGET                  8192 /* Max hosts made ready every second, the others are deferred */
+#define HOST_CHECKS_WORKER_BATCH                 64
+#define HOST_CHECKS_LAG_BUCKETS                  10   /* 0, 1, 2, 4, ... 128, 256+ seconds */
+
+/* L4 protocols a flow check can fire for (see FlowCheck::setL4Protocols) */
+#define FLOW_CHECK_L4_TCP                        0x01
+#define FLOW_CHECK_L4_UDP                        0x02
+#define FLOW_CHECK_L4_ICMP                       0x04
+#define FLOW_CHECK_L4_OTHER                      0x08
+#define FLOW_CHECK_L4_ANY                        0x0F
+
 /* Tiny Flows */
 #define CONST_DEFAULT_IS_TINY_FLOW_EXPORT_ENABLED        true  /* disabled by default */
 #define CONST_DEFAULT_MAX_NUM_PACKETS_PER_TINY_FLOW 3
@@ -931,6 +989,7 @@
 #define STARTUP_SCRIPT_PATH                  "startup.lua"
 #define BOOT_SCRIPT_PATH                     "boot.lua" /* Executed as root before networking is setup */
 #define SHUTDOWN_SCRIPT_PATH                 "shutdown.lua"
+#define PERIODIC_SCRIPT_VM_MAX_AGE           600 /* Seconds a periodic script VM is reused before being recreated */
 
 
 #define HOUSEKEEPING_SCRIPT_PATH             "housekeeping.lua"
@@ -1012,6 +1071,10 @@
 #define ES_MAX_QUEUE_LEN              32768
 #define ES_BULK_BUFFER_SIZE           1*1024*1024
 #define ES_BULK_MAX_DELAY             5
+#define ES_BULK_MIN_DOCS              8    /* Queued flows that trigger a bulk request */
+#define ES_BULK_MAX_DOCS              4096
+#define ES_BULK_MAX_INFLIGHT          4    /* Concurrent bulk requests (one thread each) */
+#define ES_BULK_CLAIM_BACKOFF_USEC    200  /* Wait when the queued flows are still being copied or taken by another thread */
 
 /* Logstash */
 #define LS_MAX_QUEUE_LEN              32768
@@ -1053,6 +1116,8 @@
 #define HTTP_MAX_CONTENT_TYPE_LENGTH    63
 #define HTTP_MAX_HEADER_LINES           20
 #define HTTP_MAX_POST_DATA_LEN          (1<<17) /* 128K */
+#define HTTP_LUA_VM_POOL_SIZE           5    /* One idle VM per web server thread (num_threads) */
+#define HTTP_LUA_VM_MAX_REQUESTS        1000 /* Requests served by a VM before it is recreated */
 #define HTTP_CONTENT_TYPE_HEADER        "Content-Type: "
 #define CONST_HELLO_HOST                "hello"
 
@@ -1144,6 +1209,25 @@ extern struct ntopngLuaContext* getUserdata(struct lua_State *vm);
  */
 
 #define MAX_VIEW_INTERFACE_QUEUE_LEN      131072
+#define VIEW_DEFAULT_NUM_WORKERS          4   /* --view-workers, capped by the number of viewed interfaces */
+#define VIEW_DEQUEUE_BATCH                256 /* Flows aggregated per view lock acquisition */
+#define VIEW_AGGREGATION_SHARDS           32  /* View host locks, hosts are mapped to them by address */
+#define HOUSEKEEPING_DEFAULT_NUM_WORKERS  2   /* --housekeeping-workers, 0 to walk the hash tables inline */
+#define HOUSEKEEPING_MAX_NUM_WORKERS      16
+#define HOUSEKEEPING_NUM_PARTITIONS       4   /* Bucket ranges each offloaded hash table is split into */
+#define OBJECT_POOL_SLAB_SIZE             (256 * 1024) /* Bytes carved into objects at once by an ObjectPool */
+#define RRD_WRITERS_DEFAULT_NUM           2   /* --rrd-writers, 0 to update the RRDs from the Lua scripts */
+#define RRD_WRITERS_MAX_NUM               16
+#define RRD_WRITER_PASS_INTERVAL          5   /* Min seconds between two passes of a writer over its journal */
+#define RRD_WRITER_DEADLINE               60  /* Seconds: points written later than this after submission are late */
+#define RRD_WRITER_MAX_PENDING            262144 /* Points journaled per writer before submitters wait */
+#define RRD_WRITER_MAX_WAIT_MS            500 /* Max wait of a submitter for room in the journals */
+#define TSDB_SEGMENT_DURATION             86400 /* Seconds of data in a segment file of the embedded timeseries store */
+#define TSDB_HEAD_BLOCK_POINTS            240 /* Points of a series kept in memory before being compressed to disk */
+#define TSDB_HEAD_BLOCK_MAX_AGE           7200 /* Seconds a point can stay in memory (lost on crash) */
+#define TSDB_FLUSH_INTERVAL               60  /* Min seconds between two scans for aged head blocks */
+#define TSDB_MAX_INDEXED_SEGMENTS         256 /* Segments whose block index is kept in memory */
+#define TSDB_BLOCK_MAGIC                  0x31425354 /* "TSB1" */
 
 #define CONST_MAX_NUM_THREADED_ACTIVITIES 64
 
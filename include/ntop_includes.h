@@ -41,6 +41,7 @@
 #include <sys/un.h>
 #include <pthread.h>
 #include <sys/wait.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <poll.h>
@@ -137,6 +138,12 @@ extern "C" {
 #ifdef HAVE_ZLIB
 #include <zlib.h>
 #endif
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
 
 #ifdef WIN32
 /* 
@@ -172,6 +179,7 @@ https://translate.google.co.uk/translate?sl=auto&tl=en&u=http%3A%2F%2Fbugsfixed.
 #include <fstream>
 #include <map>
 #include <unordered_map>
+#include <unordered_set>
 
 #if !defined(__clang__) && (__GNUC__ <= 4) && (__GNUC_MINOR__ < 8) && !defined(WIN32)
 #include <cstdatomic>
@@ -229,7 +237,11 @@ using namespace std;
 #include "ProtoStats.h"
 #include "FlowRiskAlerts.h"
 #include "Utils.h"
+#include "JSONWriter.h"
+#include "JSONScanner.h"
 #include "Bitmap128.h"
+#include "TopKSelector.h"
+#include "PerfectHash.h"
 #include "NtopGlobals.h"
 #include "Alert.h"
 #include "AlertableEntity.h"
@@ -312,8 +324,9 @@ using namespace std;
 #include "MySQLDB.h"
 #endif
 #include "InterfaceStatsHash.h"
-#include "GenericHash.h"
+#include "ObjectPool.h"
 #include "GenericHashEntry.h"
+#include "GenericHash.h"
 #include "MacHash.h"
 #ifdef HAVE_RADIUS
 #include <radcli/radcli.h>
@@ -326,7 +339,11 @@ using namespace std;
 #include "AlertsQueue.h"
 #include "LuaEngineFunctions.h"
 #include "LuaEngine.h"
+#include "LuaBytecodeCache.h"
+#include "LuaEnginePool.h"
 #include "SPSCQueue.h"
+#include "BoundedRing.h"
+#include "DocumentRing.h"
 #include "SyslogLuaEngine.h"
 #include "FifoQueue.h"
 #include "StringFifoQueue.h"
@@ -342,7 +359,9 @@ using namespace std;
 #include "PeriodicityMap.h"
 #endif
 #include "ObservationPointIdTrafficStats.h"
+#include "FlowIndexes.h"
 #include "NetworkInterface.h"
+#include "PacketShard.h"
 #ifndef HAVE_NEDGE
 #include "PcapInterface.h"
 #endif
@@ -353,7 +372,9 @@ using namespace std;
 #include "VirtualHost.h"
 #include "VirtualHostHash.h"
 #include "HTTPstats.h"
+#include "StringLRUCache.h"
 #include "Redis.h"
+#include "LocalHostCache.h"
 #ifndef HAVE_NEDGE
 #include "ElasticSearch.h"
 #ifndef WIN32
@@ -380,8 +401,11 @@ using namespace std;
 #ifndef HAVE_NEDGE
 #include "ParserInterface.h"
 #include "ListeningPorts.h"
+#include "ZMQParserContext.h"
+#include "ZMQRecvContext.h"
 #include "ZMQParserInterface.h"
 #include "ZMQPublisher.h"
+#include "ZMQCollectorWorker.h"
 #include "ZMQCollectorInterface.h"
 #include "SyslogParserInterface.h"
 #include "SyslogCollectorInterface.h"
@@ -436,6 +460,12 @@ using namespace std;
 #include "FlowChecksExecutor.h"
 #include "HostChecksLoader.h"
 #include "HostChecksExecutor.h"
+#include "HostChecksScheduler.h"
+#include "HousekeepingEngine.h"
+#include "RRDWriteEngine.h"
+#include "TimeseriesBlock.h"
+#include "TimeseriesStore.h"
+#include "InfluxDBStreamer.h"
 #include "Ntop.h"
 
 #ifdef NTOPNG_PRO
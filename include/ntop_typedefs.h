@@ -226,6 +226,8 @@ typedef enum {
   IPV6 = 6
 } IPVersion;
 
+class AlertFifoPayload;
+
 /* Used to queue/dequeue elements in recipient queues via AlertFifoQueue.h */
 typedef struct {
   AlertLevel alert_severity;
@@ -243,6 +245,7 @@ typedef struct {
   } pools;
   u_int32_t score;
   char *alert;
+  AlertFifoPayload *payload; /* Shared copy of alert, set when enqueued */
 } AlertFifoItem;
 
 struct zmq_msg_hdr_v0 {
@@ -258,6 +261,28 @@ struct zmq_msg_hdr {
   u_int32_t msg_id;
 };
 
+/* A ZMQ message received and decoded (see ZMQCollectorInterface::recvMessage) */
+typedef struct {
+  char topic;         /* First char of the topic, e.g., 'f' for flow */
+  u_int8_t source_id;
+  u_int32_t msg_id;
+  bool tlv_encoding;
+  char *buf;          /* Decoded message, writable and owned by the ZMQRecvContext until the next
+			 message. NUL terminated except for flows, parsed in place */
+  u_int32_t len;
+} ZMQCollectorMsg;
+
+class ParsedFlow;
+
+/* Handed by a ZMQ collector worker to the interface flow processing thread */
+typedef struct {
+  ParsedFlow *flow;    /* Flow already parsed, NULL for a message to be parsed */
+  char *payload;       /* Decoded message (not a flow or template), NULL terminated */
+  u_int32_t payload_len;
+  u_int8_t subscriber_id, source_id;
+  char topic;
+} ZMQCollectorItem;
+
 typedef u_int8_t dump_mac_t[DUMP_MAC_SIZE];
 typedef char macstr_t[MACSTR_SIZE];
 
@@ -670,6 +695,7 @@ typedef enum {
   flowhashing_vlan,
   flowhashing_vrfid, /* VRF Id */
   flowhashing_probe_ip_and_ingress_iface_idx,
+  flowhashing_packet_shard, /* Packet dissection worker (--packet-workers) */
 } FlowHashingEnum;
 
 typedef enum {
@@ -680,6 +706,38 @@ typedef enum {
   hash_entry_state_idle,
 } HashEntryState;
 
+typedef enum {
+  hash_table_engine_chaining = 0,    /* Buckets of linked GenericHashEntry (default) */
+  hash_table_engine_open_addressing, /* Lock-striped open addressing with tag probing */
+} HashTableEngine;
+
+typedef enum {
+  housekeeping_partition_idle = 0,   /* Nothing to do */
+  housekeeping_partition_publishing, /* Round being published by the packet thread */
+  housekeeping_partition_pending,    /* Waiting for a HousekeepingEngine worker */
+  housekeeping_partition_running,    /* Walked by a worker, or claimed by an inline walk */
+  housekeeping_partition_walked,     /* Walked by a worker, waiting for the packet thread to complete it */
+} HousekeepingPartitionState;
+
+typedef enum {
+  flow_index_ndpi_proto = 0, /* Application and master protocol */
+  flow_index_vlan,
+  flow_index_host,           /* Client and server host */
+  flow_index_alerted,
+  flow_index_num_columns
+} FlowIndexColumn;
+
+/* Where a flow is stored in the FlowIndexes postings, see FlowIndexes.cpp for the meaning of each ref */
+#define FLOW_INDEX_NUM_REFS       6
+#define FLOW_INDEX_NOT_INDEXED    ((u_int32_t)-1)
+
+typedef struct {
+  u_int64_t key[FLOW_INDEX_NUM_REFS];
+  u_int32_t pos[FLOW_INDEX_NUM_REFS]; /* Offset in the posting, FLOW_INDEX_NOT_INDEXED if none */
+  u_int8_t pending_columns;           /* Columns whose update has been deferred (bitmap) */
+  bool pending_unindex;               /* The flow went idle while its postings were busy */
+} flow_index_refs_t;
+
 typedef enum {
   threaded_activity_state_unknown = -1,
   threaded_activity_state_sleeping,
@@ -698,12 +756,6 @@ struct keyval {
   char *val;
 };
 
-class StringCache {
- public:
-  std::string value;
-  time_t expire;
-};
-
 PACK_ON
 
 struct arp_header {
@@ -998,9 +1050,17 @@ typedef struct bcast_domain_info {
 typedef enum ts_driver {
   ts_driver_rrd = 0,
   ts_driver_influxdb,
-  ts_driver_prometheus
+  ts_driver_prometheus,
+  ts_driver_tsdb
 } TsDriver;
 
+typedef enum {
+  ts_cf_average = 0,
+  ts_cf_min,
+  ts_cf_max,
+  ts_cf_last
+} TsConsolidation;
+
 /* Wrapper for pcap_if_t and pfring_if_t */
 typedef struct _ntop_if_t {
   /* pcap fields */
@@ -3395,6 +3395,8 @@ local lang = {
     ["custom_name_popup_msg"] = "Specify an alias for the interface",
     ["discard_probing_traffic"] = "Discard Probing Traffic",
     ["dump_flows_to_database"] = "Dump Flows to Database",
+    ["flow_indexes"] = "Flow Indexes",
+    ["flow_indexes_description"] = "Index active flows by application protocol, VLAN, host and alert status to speed up filtered flow lists, at the cost of some memory per flow.",
     ["gw_macs"] = "MAC Address Based Traffic Directions",
     ["gw_macs_description"] = "This is used to compute traffic direction (ingress or egress) based on the provided MAC address(es) (comma-separated list) as in some case (when capturing traffic from a traffic mirror or PCAP) it is not possible to know the traffic direction. Traffic directed to the configured MAC address(es) is considered as egress traffic.<br><b>Note:</b><br>In case no MAC address is configured, the traffic direction is set using local vs remote hosts traffic (-m).",
     ["gw_macs_example"] = "e.g. %{example}",
@@ -1064,7 +1064,7 @@ function printStatsTimeseries()
 
     multipleTableButtonPrefs(subpage_active.entries["multiple_timeseries_database"].title,
 				    subpage_active.entries["multiple_timeseries_database"].description,
-				    {"RRD", "InfluxDB 1.x"}, {"rrd", "influxdb" },
+				    {"RRD", "InfluxDB 1.x", "Embedded"}, {"rrd", "influxdb", "tsdb" },
 				    "rrd",
 				    "primary",
 				    "timeseries_driver",
@@ -1899,6 +1899,37 @@ function toggle_mirrored_traffic_function_off(){
       </tr>]]
    end
 
+   -- Flow Indexes
+   if not interface.isView() then
+      local flow_indexes = false
+      local flow_indexes_pref = string.format("ntopng.prefs.ifid_%d.flow_indexes_enabled", interface.getId())
+
+      if _SERVER["REQUEST_METHOD"] == "POST" then
+	 if _POST["flow_indexes"] == "1" then
+	    flow_indexes = true
+	 end
+
+	 ntop.setPref(flow_indexes_pref, ternary(flow_indexes == true, '1', '0'))
+	 interface.updateFlowIndexes()
+      else
+	 flow_indexes = ternary(ntop.getPref(flow_indexes_pref) == '1', true, false)
+      end
+
+      print [[<tr>
+	 <th>]] print(i18n("if_stats_config.flow_indexes")) print[[</th>
+    <td>]]
+
+    print(template.gen("on_off_switch.html", {
+	 id = "flow_indexes",
+	 checked = flow_indexes,
+    }))
+
+    print[[
+	 <small>]] print(i18n("if_stats_config.flow_indexes_description")) print[[</small>
+         </td>
+      </tr>]]
+   end
+
    -- per-interface Network Discovery
    if interface.isDiscoverableInterface() then
       local discover = require "discover_utils"
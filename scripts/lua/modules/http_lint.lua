@@ -1760,6 +1760,7 @@ local known_parameters = {
    ["interface_flow_dump"]                         = validateBool,
    ["is_mirrored_traffic"]                         = validateBool,
    ["discard_probing_traffic"]                     = validateBool,
+   ["flow_indexes"]                                = validateBool,
    ["show_dyn_iface_traffic"]                      = validateBool,
    ["interface_network_discovery"]                 = validateBool,
    ["dynamic_iface_vlan_creation"]                 = validateBool,
@@ -1924,7 +1925,7 @@ local known_parameters = {
    ["toggle_theme"]                                = validateChoiceInline({"default", "light", "dark"}),
    ["toggle_host_mask"]                            = validateChoiceInline({"0", "1", "2"}),
    ["topk_heuristic_precision"]                    = validateChoiceInline({"disabled", "more_accurate", "accurate", "aggressive"}),
-   ["timeseries_driver"]                           = validateChoiceInline({"rrd", "influxdb", "prometheus"}),
+   ["timeseries_driver"]                           = validateChoiceInline({"rrd", "influxdb", "prometheus", "tsdb"}),
    ["edition"]                                     = validateEmptyOr(validateChoiceInline({"community", "pro", "enterprise", "enterprise_m", "enterprise_l"})),
    ["hosts_ts_creation"]                           = validateChoiceInline({"off", "light", "full"}),
    ["ts_high_resolution"]                          = validateNumber,
@@ -74,13 +74,8 @@ function alert_store_db.dequeueRecipientAlerts(recipient, budget)
    while budget_used <= budget and more_available do
       local notifications = {}
 
-      for i=1, budget do
-         local notification = ntop.recipient_dequeue(recipient.recipient_id)
-         if notification then
-	    notifications[#notifications + 1] = notification.alert
-         else
-	    break
-         end
+      for _, notification in ipairs(ntop.recipient_dequeue_batch(recipient.recipient_id, budget)) do
+         notifications[#notifications + 1] = notification.alert
       end
 
       if not notifications or #notifications == 0 then
@@ -84,13 +84,8 @@ end
 -- On error, it leaves the queue unchagned to retry on next round.
 function slack.dequeueRecipientAlerts(recipient, budget)
    local notifications = {}
-   for i = 1, budget do
-      local notification = ntop.recipient_dequeue(recipient.recipient_id)
-      if notification then 
-	 notifications[#notifications + 1] = notification.alert
-      else
-	 break
-      end
+   for _, notification in ipairs(ntop.recipient_dequeue_batch(recipient.recipient_id, budget)) do
+      notifications[#notifications + 1] = notification.alert
    end
 
   if not notifications or #notifications == 0 then
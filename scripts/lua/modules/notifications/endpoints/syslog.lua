@@ -157,13 +157,8 @@ function syslog.dequeueRecipientAlerts(recipient, budget)
    local settings = readSettings(recipient)
    local notifications = {}
 
-   for i = 1, budget do
-      local notification = ntop.recipient_dequeue(recipient.recipient_id)
-      if notification then
-         notifications[#notifications + 1] = notification
-      else
-         break
-      end
+   for _, notification in ipairs(ntop.recipient_dequeue_batch(recipient.recipient_id, budget)) do
+      notifications[#notifications + 1] = notification
    end
 
    if not notifications or #notifications == 0 then
@@ -129,13 +129,8 @@ function telegram.dequeueRecipientAlerts(recipient, budget)
 
     -- Dequeue max_alerts_per_request notifications
     local notifications = {}
-    for i=1, max_alerts_per_request do
-       local notification = ntop.recipient_dequeue(recipient.recipient_id)
-       if notification then 
-	  notifications[#notifications + 1] = notification.alert
-       else
-	  break
-       end
+    for _, notification in ipairs(ntop.recipient_dequeue_batch(recipient.recipient_id, max_alerts_per_request)) do
+       notifications[#notifications + 1] = notification.alert
     end
 
     if not notifications or #notifications == 0 then
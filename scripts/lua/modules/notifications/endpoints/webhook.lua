@@ -102,13 +102,8 @@ function webhook.dequeueRecipientAlerts(recipient, budget)
 
     -- Dequeue MAX_ALERTS_PER_REQUEST notifications
     local notifications = {}
-    for i = 1, MAX_ALERTS_PER_REQUEST do
-       local notification = ntop.recipient_dequeue(recipient.recipient_id)
-       if notification then 
-	  notifications[#notifications + 1] = notification.alert
-       else
-	  break
-       end
+    for _, notification in ipairs(ntop.recipient_dequeue_batch(recipient.recipient_id, MAX_ALERTS_PER_REQUEST)) do
+       notifications[#notifications + 1] = notification.alert
     end
 
     if not notifications or #notifications == 0 then
@@ -78,6 +78,11 @@ function driver:new(options)
     cur_dropped_points = 0,
   }
 
+  -- Points appended by the interfaces are streamed there from C (InfluxDBStreamer)
+  if not isEmptyString(obj.url) and not isEmptyString(obj.db) then
+    ntop.influxdb_set_endpoint(obj.url, obj.db, obj.username, obj.password)
+  end
+
   setmetatable(obj, self)
   self.__index = self
 
@@ -908,6 +913,8 @@ end
 -- ##############################################
 
 -- This is a function called by the periodic script influx.lua
+-- Points are streamed from C: only the batches that could not be posted
+-- are found here, written to disk by the InfluxDBStreamer
 
 function driver:export()
    local base_dir = dirs.workingdir .. "/tmp/influxdb"
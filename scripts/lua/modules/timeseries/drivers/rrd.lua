@@ -1086,6 +1086,41 @@ end
 
 -- ##############################################
 
+-- Hands the updates to the native RRD writers, falling back to
+-- update_rrd when they are disabled (--rrd-writers 0)
+local function flush_rrd_batch(batch, batch_points)
+   local num_points = #batch / 2
+
+   if num_points == 0 then
+      return
+   end
+
+   local num_accepted = ntop.rrd_update_batch(batch)
+
+   if num_accepted == nil then
+      for _, point in ipairs(batch_points) do
+	 update_rrd(point.schema, point.rrdfile, point.timestamp, point.metrics)
+      end
+   elseif num_accepted < num_points then
+      ntop.rrd_inc_num_drops(num_points - num_accepted)
+   end
+end
+
+-- ##############################################
+
+-- Formats an update as accepted by rrd_update: <timestamp>:<value>[:<value>...]
+local function rrd_update_string(schema, timestamp, data)
+   local params = { number_to_rrd_string(timestamp, schema), }
+
+   for _, metric in ipairs(schema._metrics) do
+      params[#params + 1] = number_to_rrd_string(data[metric], schema)
+   end
+
+   return table.concat(params, ":")
+end
+
+-- ##############################################
+
 function driver:export()
    if(not(use_rrd_queue)) then
       return -- Nothing to do
@@ -1097,6 +1132,8 @@ function driver:export()
    -- Add the system interface to the available interfaces
    available_interfaces[getSystemInterfaceId()] = getSystemInterfaceName()
    local rrd_queue_max_dequeues_per_interface = 8192
+   local rrd_batch_max_points = 1024
+   local batch, batch_points = {}, {}
 
    for cur_ifid, iface in pairs(available_interfaces) do
       for cur_dequeue=1, rrd_queue_max_dequeues_per_interface do
@@ -1120,13 +1157,25 @@ function driver:export()
 	 if not ntop.notEmptyFile(rrdfile) then
 	    ntop.mkdir(base)
 	    if not create_rrd(schema, rrdfile, timestamp) then
+	       flush_rrd_batch(batch, batch_points)
 	       return false
 	    end
 	 end
 
-	 update_rrd(schema, rrdfile, timestamp, metrics)
+	 -- Points not newer than the last update of their file are discarded
+	 -- by the writers (with a single check per file and batch)
+	 batch[#batch + 1] = rrdfile
+	 batch[#batch + 1] = rrd_update_string(schema, timestamp, metrics)
+	 batch_points[#batch_points + 1] = { schema = schema, rrdfile = rrdfile, timestamp = timestamp, metrics = metrics }
+
+	 if #batch_points >= rrd_batch_max_points then
+	    flush_rrd_batch(batch, batch_points)
+	    batch, batch_points = {}, {}
+	 end
       end
    end
+
+   flush_rrd_batch(batch, batch_points)
 end
 
 -- ##############################################
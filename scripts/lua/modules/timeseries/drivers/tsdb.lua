@@ -0,0 +1,388 @@
+--
+-- (C) 2022 - ntop.org
+--
+
+-- Driver of the timeseries store embedded in ntopng (see TimeseriesStore.cpp).
+-- Points are kept in memory, then compressed and appended to the segment
+-- files under <workingdir>/tsdb. Queries are consolidated natively.
+
+local driver = {}
+
+local ts_common = require("ts_common")
+local data_retention_utils = require "data_retention_utils"
+
+local aggregation_to_consolidation = {
+  [ts_common.aggregation.mean] = "AVERAGE",
+  [ts_common.aggregation.max]  = "MAX",
+  [ts_common.aggregation.min]  = "MIN",
+  [ts_common.aggregation.last] = "LAST",
+}
+
+-- ##############################################
+
+function driver:new(options)
+  local obj = {}
+
+  setmetatable(obj, self)
+  self.__index = self
+
+  return obj
+end
+
+-- ##############################################
+
+local function escape_tag_value(value)
+  return (string.gsub(tostring(value), "[%%,=]", function(c) return string.format("%%%02X", string.byte(c)) end))
+end
+
+local function unescape_tag_value(value)
+  return (string.gsub(value, "%%(%x%x)", function(h) return string.char(tonumber(h, 16)) end))
+end
+
+-- The series key: <tag>=<value>[,<tag>=<value>...] in the schema tags order
+local function series_key(schema, tags)
+  local parts = {}
+
+  for _, tag in ipairs(schema._tags) do
+    parts[#parts + 1] = tag .. "=" .. escape_tag_value(tags[tag] or "")
+  end
+
+  return table.concat(parts, ",")
+end
+
+local function key_to_tags(key)
+  local tags = {}
+
+  for part in string.gmatch(key, "[^,]+") do
+    local tag, value = string.match(part, "^([^=]+)=(.*)$")
+
+    if tag then
+      tags[tag] = unescape_tag_value(value)
+    end
+  end
+
+  return tags
+end
+
+-- ##############################################
+
+local function getConsolidationFunction(schema)
+  return aggregation_to_consolidation[schema:getAggregationFunction()] or "AVERAGE"
+end
+
+local function isCounter(schema)
+  return(schema.options.metrics_type == ts_common.metrics.counter)
+end
+
+-- Native downsampling: the step grows with the queried range
+local function fetch(schema, tags, tstart, tend, options)
+  local time_step = ts_common.calculateSampledTimeStep(schema.options.step, tstart, tend, options)
+
+  return ntop.tsdb_fetch(schema.name, series_key(schema, tags), getConsolidationFunction(schema),
+    tstart, tend, time_step, isCounter(schema))
+end
+
+-- Fetches all the series matching the tags in a single pass over the segments
+local function fetch_many(schema, tags, tstart, tend, options)
+  local time_step = ts_common.calculateSampledTimeStep(schema.options.step, tstart, tend, options)
+  local filters = {}
+
+  for tag, value in pairs(tags) do
+    filters[#filters + 1] = tag .. "=" .. escape_tag_value(value)
+  end
+
+  return ntop.tsdb_fetch_many(schema.name, filters, getConsolidationFunction(schema),
+    tstart, tend, time_step, isCounter(schema))
+end
+
+-- ##############################################
+
+function driver:append(schema, timestamp, tags, metrics)
+  local values = {}
+
+  for _, metric in ipairs(schema._metrics) do
+    values[#values + 1] = tonumber(metrics[metric]) or 0
+  end
+
+  return ntop.tsdb_append(schema.name, series_key(schema, tags), timestamp, values)
+end
+
+-- ##############################################
+
+local function makeTotalSerie(series, count)
+  local total = {}
+
+  for i=1, count do
+    local sum = 0/0
+
+    for _, serie in pairs(series) do
+      local v = serie.data[i]
+
+      if v == v then
+        -- Avoid NaN sum
+        sum = ternary(sum ~= sum, v, sum + v)
+      end
+    end
+
+    total[i] = sum
+  end
+
+  return total
+end
+
+-- ##############################################
+
+function driver:query(schema, tstart, tend, tags, options)
+  local fstart, fstep, fdata, fcount = fetch(schema, tags, tstart, tend, options)
+
+  if fstart == nil then
+    return nil
+  end
+
+  local series = {}
+
+  for idx, metric in ipairs(schema._metrics) do
+    local max_val = ts_common.getMaxPointValue(schema, metric, tags)
+    local serie = fdata[idx] or {}
+
+    for i=1, fcount do
+      serie[i] = ts_common.normalizeVal(serie[i] or 0/0, max_val, options)
+    end
+
+    series[idx] = {label=metric, data=serie}
+  end
+
+  local count = fcount
+  local total_serie = nil
+  local stats = nil
+
+  if options.calculate_stats then
+    total_serie = makeTotalSerie(series, count)
+    stats = ts_common.calculateStatistics(total_serie, fstep, tend - tstart, schema.options.metrics_type) or {}
+    stats.by_serie = {}
+
+    for k, v in pairs(series) do
+      local s = ts_common.calculateStatistics(v.data, fstep, tend - tstart, schema.options.metrics_type)
+      stats.by_serie[k] = table.merge(s, ts_common.calculateMinMax(v.data))
+    end
+  end
+
+  if options.initial_point then
+    local _, _, initial_pt = ntop.tsdb_fetch(schema.name, series_key(schema, tags), getConsolidationFunction(schema),
+      tstart - fstep, tstart, fstep, isCounter(schema))
+
+    for idx, metric in ipairs(schema._metrics) do
+      local max_val = ts_common.getMaxPointValue(schema, metric, tags)
+      local ptval = ts_common.normalizeVal((initial_pt and initial_pt[idx] and initial_pt[idx][1]) or 0/0, max_val, options)
+
+      table.insert(series[idx].data, 1, ptval)
+    end
+
+    count = count + 1
+
+    if total_serie then
+      -- recalculate with additional point
+      total_serie = makeTotalSerie(series, count)
+    end
+  end
+
+  if options.calculate_stats then
+    stats = table.merge(stats, ts_common.calculateMinMax(total_serie))
+  end
+
+  return {
+    start = fstart,
+    step = fstep,
+    count = count,
+    series = series,
+    statistics = stats,
+    additional_series = {
+      total = total_serie,
+    },
+  }
+end
+
+-- ##############################################
+
+function driver:queryTotal(schema, tstart, tend, tags, options)
+  local fstart, fstep, fdata, fcount = fetch(schema, tags, tstart, tend, options)
+
+  if fstart == nil then
+    return nil
+  end
+
+  local totals = {}
+
+  for idx, metric in ipairs(schema._metrics) do
+    local max_val = ts_common.getMaxPointValue(schema, metric, tags)
+    local sum = 0
+
+    for _, v in ipairs(fdata[idx] or {}) do
+      v = ts_common.normalizeVal(v, max_val, options)
+
+      if type(v) == "number" then
+        sum = sum + v * fstep
+      end
+    end
+
+    totals[metric] = sum
+  end
+
+  return totals
+end
+
+-- ##############################################
+
+-- Any tag can be a wildcard: the series of the schema are matched against tags_filter
+function driver:listSeries(schema, tags_filter, wildcard_tags, start_time)
+  local res = {}
+
+  for _, key in ipairs(ntop.tsdb_list_series(schema.name, start_time or 0)) do
+    local serie_tags = key_to_tags(key)
+    local matches = true
+
+    for tag, value in pairs(tags_filter) do
+      if serie_tags[tag] ~= tostring(value) then
+        matches = false
+        break
+      end
+    end
+
+    if matches then
+      res[#res + 1] = serie_tags
+    end
+  end
+
+  if (#wildcard_tags == 0) and (#res == 0) then
+    return nil
+  end
+
+  return res
+end
+
+-- ##############################################
+
+function driver:exists(schema, tags_filter, wildcard_tags)
+  return(self:listSeries(schema, tags_filter, {}, 0) ~= nil)
+end
+
+-- ##############################################
+
+function driver:topk(schema, tags, tstart, tend, options, top_tags)
+  if #top_tags ~= 1 then
+    traceError(TRACE_ERROR, TRACE_CONSOLE, "tsdb driver only supports topk on a single tag")
+    return nil
+  end
+
+  local top_tag = top_tags[1]
+  local fstart, fstep, series, fcount = fetch_many(schema, tags, tstart, tend, options)
+  local items = {}
+  local tag_2_series = {}
+  local total_serie = {}
+  local step = schema.options.step
+
+  if fstart ~= nil then
+    step = fstep
+
+    for key, fdata in pairs(series) do
+      local serie_tags = key_to_tags(key)
+      local partials = {}
+      local sum = 0
+
+      for idx, metric in ipairs(schema._metrics) do
+        local max_val = ts_common.getMaxPointValue(schema, metric, serie_tags)
+        partials[metric] = 0
+
+        for i=1, fcount do
+          local v = ts_common.normalizeVal((fdata[idx] or {})[i] or 0/0, max_val, options)
+
+          total_serie[i] = total_serie[i] or 0
+
+          if type(v) == "number" then
+            sum = sum + v
+            partials[metric] = partials[metric] + v * fstep
+            total_serie[i] = total_serie[i] + v
+          end
+        end
+      end
+
+      items[serie_tags[top_tag]] = sum * fstep
+      tag_2_series[serie_tags[top_tag]] = {serie_tags, partials}
+    end
+  end
+
+  local topk = {}
+
+  for top_item, value in pairsByValues(items, rev) do
+    if value > 0 then
+      topk[#topk + 1] = {
+        tags = tag_2_series[top_item][1],
+        value = value,
+        partials = tag_2_series[top_item][2],
+      }
+    end
+
+    if #topk >= options.top then
+      break
+    end
+  end
+
+  local stats = nil
+
+  if options.calculate_stats then
+    stats = ts_common.calculateStatistics(total_serie, step, tend - tstart, schema.options.metrics_type)
+    stats = table.merge(stats, ts_common.calculateMinMax(total_serie))
+  end
+
+  return {
+    topk = topk,
+    additional_series = {
+      total = total_serie,
+    },
+    statistics = stats,
+  }
+end
+
+-- ##############################################
+
+-- Writes the points in memory for too long
+function driver:export()
+  ntop.tsdb_flush()
+end
+
+-- ##############################################
+
+function driver:getLatestTimestamp(ifid)
+  return os.time()
+end
+
+-- ##############################################
+
+function driver:delete(schema_prefix, tags)
+  local filters = {}
+
+  for tag, value in pairs(tags or {}) do
+    filters[#filters + 1] = tag .. "=" .. escape_tag_value(value)
+  end
+
+  return ntop.tsdb_delete(schema_prefix, filters)
+end
+
+-- ##############################################
+
+-- Segments hold the data of all the interfaces: the expired ones are deleted at once
+function driver:deleteOldData(ifid)
+  ntop.tsdb_delete_old_data(data_retention_utils.getDataRetentionDays() * 86400)
+
+  return true
+end
+
+-- ##############################################
+
+function driver:setup(ts_utils)
+  return true
+end
+
+-- ##############################################
+
+return driver
@@ -151,6 +151,9 @@ function ts_utils.listActiveDrivers()
 	    password = ternary(auth_enabled, ntop.getPref("ntopng.prefs.influx_password"), nil),
 						     })
       active_drivers[#active_drivers + 1] = influxdb_driver
+   elseif driver == "tsdb" then
+      local tsdb_driver = require("tsdb"):new({})
+      active_drivers[#active_drivers + 1] = tsdb_driver
    end
 
    -- cache for future calls
@@ -43,9 +43,8 @@ void AlertCounter::reset_window(time_t when) {
 /* *************************************** */
 
 void AlertCounter::inc(time_t when, AlertableEntity *alertable) {
-  if(hits_reset_req) { /* Reset the maximum as requested and start over */
+  if(hits_reset_req.exchange(false)) { /* Reset the maximum as requested and start over */
     trailing_window_max_since_hits_reset = 0;
-    hits_reset_req = false;
     reset_window(when);
   }
 
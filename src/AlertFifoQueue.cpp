@@ -0,0 +1,80 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#include "ntop_includes.h"
+
+/* ******************************************* */
+
+AlertFifoQueue::AlertFifoQueue(u_int32_t queue_size) : ring(queue_size) {
+  dequeue_pos = 0;
+  num_enqueued = num_not_enqueued = num_dequeued = 0;
+}
+
+/* ******************************************* */
+
+AlertFifoQueue::~AlertFifoQueue() {
+  AlertFifoItem notifications[64];
+  u_int32_t n;
+
+  while((n = dequeue(notifications, 64)) > 0) {
+    for(u_int32_t i = 0; i < n; i++)
+      notifications[i].payload->decRefs();
+  }
+}
+
+/* ******************************************* */
+
+bool AlertFifoQueue::enqueue(const AlertFifoItem* const notification, AlertFifoPayload *payload) {
+  AlertFifoItem *item;
+  u_int64_t pos;
+
+  if((item = ring.reserve(&pos)) == NULL) {
+    num_not_enqueued++;
+    return(false); /* Full */
+  }
+
+  payload->incRefs();
+
+  *item = *notification;
+  item->payload = payload, item->alert = (char*)payload->get();
+  num_enqueued++; /* Before publishing, so that the length never goes negative */
+  ring.publish(pos);
+
+  return(true);
+}
+
+/* ******************************************* */
+
+u_int32_t AlertFifoQueue::dequeue(AlertFifoItem *notifications, u_int32_t max_notifications) {
+  u_int32_t n = 0;
+
+  while((n < max_notifications) && ring.isPublished(dequeue_pos)) {
+    notifications[n++] = *ring.getItem(dequeue_pos);
+    ring.release(dequeue_pos);
+    dequeue_pos++;
+  }
+
+  if(n > 0)
+    num_dequeued += n;
+
+  return(n);
+}
@@ -31,36 +31,20 @@ AutonomousSystemHash::AutonomousSystemHash(NetworkInterface *_iface, u_int _num_
 
 /* ************************************ */
 
-AutonomousSystem* AutonomousSystemHash::get(IpAddress *ipa, bool is_inline_call) {
-  u_int32_t asn, hash;
-
-  ntop->getGeolocation()->getAS(ipa, &asn, NULL /* Don't care about AS name here */);
-  hash = asn;
-  
-  hash %= num_hashes;
-
-  if(table[hash] == NULL) {
-    return(NULL);
-  } else {
-    AutonomousSystem *head;
+static bool as_matches(GenericHashEntry *h, void *user_data) {
+  AutonomousSystem *as = (AutonomousSystem*)h;
 
-    if(!is_inline_call)
-      locks[hash]->rdlock(__FILE__, __LINE__);
+  return(!as->idle() && as->equal(*((u_int32_t*)user_data)));
+}
 
-    head = (AutonomousSystem*)table[hash];
+/* ************************************ */
 
-    while(head != NULL) {
-      if(!head->idle() && head->equal(asn))
-	break;
-      else
-	head = (AutonomousSystem*)head->next();
-    }
+AutonomousSystem* AutonomousSystemHash::get(IpAddress *ipa, bool is_inline_call) {
+  u_int32_t asn;
 
-    if(!is_inline_call)
-      locks[hash]->unlock(__FILE__, __LINE__);
+  ntop->getGeolocation()->getAS(ipa, &asn, NULL /* Don't care about AS name here */);
 
-    return(head);
-  }
+  return((AutonomousSystem*)lookup<as_matches>(asn, &asn, !is_inline_call));
 }
 
 /* ************************************ */
@@ -31,33 +31,17 @@ CountriesHash::CountriesHash(NetworkInterface *_iface, u_int _num_hashes,
 
 /* ************************************ */
 
-Country* CountriesHash::get(const char *country_name, bool is_inline_call) {
-  u_int32_t hash = Utils::stringHash(country_name);
-
-  hash %= num_hashes;
-
-  if(table[hash] == NULL) {
-    return(NULL);
-  } else {
-    Country *head;
-
-    if(!is_inline_call)
-      locks[hash]->rdlock(__FILE__, __LINE__);
+static bool country_matches(GenericHashEntry *h, void *user_data) {
+  Country *country = (Country*)h;
 
-    head = (Country*)table[hash];
-
-    while(head != NULL) {
-      if((!head->idle()) && head->equal(country_name))
-	break;
-      else
-	head = (Country*)head->next();
-    }
+  return((!country->idle()) && country->equal((const char*)user_data));
+}
 
-    if(!is_inline_call)
-      locks[hash]->unlock(__FILE__, __LINE__);
+/* ************************************ */
 
-    return(head);
-  }
+Country* CountriesHash::get(const char *country_name, bool is_inline_call) {
+  return((Country*)lookup<country_matches>(Utils::stringHash(country_name),
+					   (void*)country_name, !is_inline_call));
 }
 
 /* ************************************ */
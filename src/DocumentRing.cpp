@@ -0,0 +1,115 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#include "ntop_includes.h"
+
+/* ******************************************* */
+
+DocumentRing::DocumentRing(u_int32_t size, u_int32_t _wakeup_threshold) : ring(size) {
+  wakeup_threshold = _wakeup_threshold ? _wakeup_threshold : 1;
+  dequeue_pos = 0;
+  num_enqueued = num_claimed = 0;
+}
+
+/* ******************************************* */
+
+DocumentRing::~DocumentRing() {
+  for(u_int32_t i = 0; i < ring.getNumSlots(); i++) {
+    document_ring_doc_t *d = ring.getItem(i);
+
+    if(d->doc) free(d->doc);
+  }
+}
+
+/* ******************************************* */
+
+bool DocumentRing::enqueue(const char *doc, u_int32_t len) {
+  document_ring_doc_t *d;
+  u_int64_t pos;
+
+  if((d = ring.reserve(&pos)) == NULL)
+    return(false); /* Full: the oldest slot is still queued or in flight */
+
+  if(len + 1 > d->size) {
+    u_int32_t new_size = Utils::pow2(len + 1);
+    char *buf = (char*)realloc(d->doc, new_size);
+
+    if(buf == NULL) {
+      /* The position is taken: publish it empty, consumers skip it */
+      d->len = 0;
+      ring.publish(pos);
+      num_enqueued++;
+      return(false);
+    }
+
+    d->doc = buf, d->size = new_size;
+  }
+
+  memcpy(d->doc, doc, len);
+  d->doc[len] = '\0', d->len = len;
+  ring.publish(pos);
+
+  if((++num_enqueued - num_claimed) == wakeup_threshold)
+    not_empty.signal();
+
+  return(true);
+}
+
+/* ******************************************* */
+
+u_int32_t DocumentRing::claim(u_int32_t max_docs, u_int32_t max_bytes, u_int32_t doc_overhead, u_int64_t *first_pos) {
+  u_int32_t n = 0, bytes = 0;
+
+  claim_lock.lock(__FILE__, __LINE__);
+
+  *first_pos = dequeue_pos;
+
+  while(n < max_docs) {
+    u_int32_t len;
+
+    if(!ring.isPublished(dequeue_pos + n))
+      break; /* Not yet published */
+
+    len = ring.getItem(dequeue_pos + n)->len + doc_overhead;
+
+    if((n > 0) && (bytes + len > max_bytes))
+      break;
+
+    bytes += len, n++;
+  }
+
+  dequeue_pos += n;
+  num_claimed += n;
+
+  claim_lock.unlock(__FILE__, __LINE__);
+
+  return(n);
+}
+
+/* ******************************************* */
+
+void DocumentRing::release(u_int64_t first_pos, u_int32_t num_docs) {
+  for(u_int32_t i = 0; i < num_docs; i++)
+    ring.release(first_pos + i);
+}
+
+/* ******************************************* */
@@ -69,7 +69,7 @@ void DummyInterface::forgeFlow(u_int iteration) {
 	     iteration, iteration*1500,
 	     now-120, now-60, sport, dport);
 
-    parseJSONFlow(payload, sizeof(payload), 1 /* source_id */);
+    parseJSONFlow(payload, strlen(payload), 1 /* source_id */);
   }
 
   if(id == 0) sleep(ntop->getPrefs()->get_housekeeping_frequency());
@@ -30,6 +30,7 @@ static void* esLoop(void* ptr) {
   
   ElasticSearch *es = (ElasticSearch *) ptr;
   es->pushEStemplate();  // sends ES ntopng template
+  es->startBulkThreads(); // data is sent only once the template is there
   es->indexESdata();
   
   return(NULL);
@@ -37,16 +38,26 @@ static void* esLoop(void* ptr) {
 
 /* **************************************** */
 
+static void* esBulkLoop(void* ptr) {
+  Utils::setThreadName("ESBulkLoop");
+
+  ((ElasticSearch *) ptr)->indexESdata();
+
+  return(NULL);
+}
+
+/* **************************************** */
+
 ElasticSearch::ElasticSearch(NetworkInterface *_iface) : DB(_iface) {
   snprintf(es_version, sizeof(es_version), "%c", '0');
   es_version_inited = false;
-  num_queued_elems = 0;
-  head = NULL;
-  tail = NULL;
+  num_bulk_threads = 0;
+  num_inflight_bulks = 0, inflight_bytes = 0;
   reportDrops = false;
 
   if(!(es_template_push_url = (char*)malloc(MAX_PATH))
-     || !(es_version_query_url = (char*)malloc(MAX_PATH)))
+     || !(es_version_query_url = (char*)malloc(MAX_PATH))
+     || !(queue = new (std::nothrow) DocumentRing(ES_MAX_QUEUE_LEN, ES_BULK_MIN_DOCS)))
     throw "Not enough memory";
 
   es_template_push_url[0] = '\0', es_version_query_url[0] = '\0';
@@ -60,6 +71,7 @@ ElasticSearch::~ElasticSearch() {
   shutdown();
   if(es_template_push_url) free(es_template_push_url);
   if(es_version_query_url) free(es_version_query_url);
+  if(queue) delete queue;
 }
 
 /* **************************************** */
@@ -69,21 +81,28 @@ void ElasticSearch::shutdown() {
     void *res;
 
     DB::shutdown();
+    queue->wakeup();
     
     pthread_join(esThreadLoop, &res);
+
+    /* num_bulk_threads is final once esThreadLoop is over */
+    for(u_int8_t i = 0; i < num_bulk_threads; i++)
+      pthread_join(bulkThreads[i], &res);
+
+    num_bulk_threads = 0;
   }
 }
 
 /* **************************************** */
 
 bool ElasticSearch::dumpFlow(time_t when, Flow *f, char *msg) {
-  struct string_list *e;
-  bool rc = true;
+  if(!msg)
+    return(false);
 
-  if(num_queued_elems >= ES_MAX_QUEUE_LEN) {
+  if(!queue->enqueue(msg, strlen(msg))) {
     if(!reportDrops) {
-      ntop->getTrace()->traceEvent(TRACE_WARNING, "[ES] Export queue too long [%d]: expect drops",
-				   num_queued_elems);
+      ntop->getTrace()->traceEvent(TRACE_WARNING, "[ES] Export queue too long [%u]: expect drops",
+				   queue->getNumQueued());
       reportDrops = true;
     }
 
@@ -94,31 +113,7 @@ bool ElasticSearch::dumpFlow(time_t when, Flow *f, char *msg) {
     return(false);
   }
 
-  listMutex.lock(__FILE__, __LINE__);
-
-  e = (struct string_list*)calloc(1, sizeof(struct string_list));
-  if(e != NULL) {
-    e->str = strdup(msg), e->next = head;
-
-    if(e->str) {
-      if(head)
-        head->prev = e;
-      head = e;
-      if(tail == NULL)
-	tail = e;
-      num_queued_elems++;
-
-      rc = true;
-    } else {
-      /* Out of memory */
-      free(e);
-      rc = false;
-    }
-  }
-
-  listMutex.unlock(__FILE__, __LINE__);
-
-  return(rc);
+  return(true);
 }
 
 /* **************************************** */
@@ -133,80 +128,128 @@ bool ElasticSearch::startQueryLoop() {
   return(false);
 }
 
+/* **************************************** */
+
+/* Threads sending bulk requests together with esThreadLoop */
+void ElasticSearch::startBulkThreads() {
+  while(num_bulk_threads < ES_BULK_MAX_INFLIGHT - 1) {
+    if(pthread_create(&bulkThreads[num_bulk_threads], NULL, esBulkLoop, (void*)this) != 0)
+      break;
+
+    num_bulk_threads++;
+  }
+}
 
 /* **************************************** */
 
+/*
+  Run by every bulk thread: claims a batch of flows from the queue and
+  posts it straight from the queue slots, then releases them.
+*/
 void ElasticSearch::indexESdata() {
-  const u_int min_buffered_flows = 8;
   time_t last_dump = time(0);
-  char *postbuf = (char*) malloc(ES_BULK_BUFFER_SIZE);
+  struct iovec *iov = (struct iovec*) malloc(3 * ES_BULK_MAX_DOCS * sizeof(struct iovec));
 
-  if(!postbuf) {
+  if(!iov) {
     ntop->getTrace()->traceEvent(TRACE_ERROR, "Cannot allocate ES bulk buffer");
     return;
   }
 
   while(!ntop->getGlobals()->isShutdown() && isRunning()) {
     time_t now = time(0);
+    u_int32_t num_queued = queue->getNumQueued();
 
-    if((num_queued_elems >= min_buffered_flows)
-       || ((num_queued_elems > 0) && (now >= last_dump + ES_BULK_MAX_DELAY))) {
-      u_int len, num_flows;
+    if((num_queued >= ES_BULK_MIN_DOCS)
+       || ((num_queued > 0) && (now >= last_dump + ES_BULK_MAX_DELAY))) {
+      u_int len, num_flows, num_docs, iovcnt, header_len;
+      u_int64_t first_pos;
       char index_name[64], header[256];
-      struct tm* tm_info;
-      struct timeval tv;
+      struct tm tm_info;
       time_t t;
       HTTPTranferStats stats;
 
-      gettimeofday(&tv, NULL);
-      t = tv.tv_sec;
-      tm_info = gmtime(&t);
+      t = time(NULL);
+      gmtime_r(&t, &tm_info);
 
-      strftime(index_name, sizeof(index_name), ntop->getPrefs()->get_es_index(), tm_info);
+      strftime(index_name, sizeof(index_name), ntop->getPrefs()->get_es_index(), &tm_info);
 
-      snprintf(header, sizeof(header),
-	       "{\"index\": {\"_type\": \"%s\", \"_index\": \"%s\"}}",
-	       atleast_version_6() ? (char*)"_doc" /* types no longer supported in 6 */ : ntop->getPrefs()->get_es_type(),
-	       index_name);
-      len = 0, num_flows = 0;
+      header_len = snprintf(header, sizeof(header),
+			    "{\"index\": {\"_type\": \"%s\", \"_index\": \"%s\"}}\n",
+			    atleast_version_6() ? (char*)"_doc" /* types no longer supported in 6 */ : ntop->getPrefs()->get_es_type(),
+			    index_name);
 
-      listMutex.lock(__FILE__, __LINE__);
-      for(u_int i=0; (i < num_queued_elems) && (len <= ES_BULK_BUFFER_SIZE - strlen(header) - strlen(tail->str) -5 ); i++) {
-        struct string_list *prev;
-        prev = tail->prev;
-        len += snprintf(&postbuf[len], ES_BULK_BUFFER_SIZE-len, "%s\n%s\n", header, tail->str), num_flows++;
-        free(tail->str);
-        free(tail);
-        tail = prev, num_queued_elems--;
+      /* Each flow is sent as header, flow and newline */
+      if((num_docs = queue->claim(ES_BULK_MAX_DOCS, ES_BULK_BUFFER_SIZE, header_len + 1, &first_pos)) == 0) {
+	/* Taken by another bulk thread, or not yet published by its producer */
+	_usleep(ES_BULK_CLAIM_BACKOFF_USEC);
+	continue;
+      }
 
-        if(num_queued_elems == 0)
-	  head = NULL;
-      } /* for */
+      len = 0, num_flows = 0, iovcnt = 0;
 
-      listMutex.unlock(__FILE__, __LINE__);
-      postbuf[len] = '\0';
+      for(u_int32_t i = 0; i < num_docs; i++) {
+	u_int32_t doc_len;
+	const char *doc = queue->getDocument(first_pos + i, &doc_len);
 
-      ntop->getTrace()->traceEvent(TRACE_INFO, "ES: Buffered request with %d flows (%d bytes)", num_flows, len);
+	if(doc_len == 0) continue; /* Failed enqueue */
 
-      if(!Utils::postHTTPJsonData(ntop->getPrefs()->get_es_user(),
-				  ntop->getPrefs()->get_es_pwd(),
-				  ntop->getPrefs()->get_es_url(),
-				  postbuf, 0, &stats)) {
-	/* Post failure */
-	ntop->getTrace()->traceEvent(TRACE_ERROR, "ES: POST request for %d flows (%d bytes) failed", num_flows, len);
-	incNumDroppedFlows(num_flows);
-	sleep(1);
-      } else {
-	ntop->getTrace()->traceEvent(TRACE_INFO, "Sent %u flow(s) to ES", num_flows);
-	incNumExportedFlows(num_flows);
+	iov[iovcnt].iov_base = header, iov[iovcnt++].iov_len = header_len;
+	iov[iovcnt].iov_base = (void*)doc, iov[iovcnt++].iov_len = doc_len;
+	iov[iovcnt].iov_base = (void*)"\n", iov[iovcnt++].iov_len = 1;
+	len += header_len + doc_len + 1, num_flows++;
       }
 
+      ntop->getTrace()->traceEvent(TRACE_INFO, "ES: Buffered request with %d flows (%d bytes)", num_flows, len);
+
+      if(num_flows > 0) {
+	bool rc;
+
+	num_inflight_bulks++, inflight_bytes += len;
+	rc = Utils::postHTTPJsonIovec(ntop->getPrefs()->get_es_user(),
+				      ntop->getPrefs()->get_es_pwd(),
+				      ntop->getPrefs()->get_es_url(),
+				      iov, iovcnt, 0, &stats);
+	num_inflight_bulks--, inflight_bytes -= len;
+
+	/* Slots can be reused only now: the request was sent from them */
+	queue->release(first_pos, num_docs);
+
+	if(!rc) {
+	  /* Post failure */
+	  ntop->getTrace()->traceEvent(TRACE_ERROR, "ES: POST request for %d flows (%d bytes) failed", num_flows, len);
+	  statsMutex.lock(__FILE__, __LINE__);
+	  incNumDroppedFlows(num_flows);
+	  statsMutex.unlock(__FILE__, __LINE__);
+	  sleep(1);
+	} else {
+	  ntop->getTrace()->traceEvent(TRACE_INFO, "Sent %u flow(s) to ES", num_flows);
+	  statsMutex.lock(__FILE__, __LINE__);
+	  incNumExportedFlows(num_flows);
+	  statsMutex.unlock(__FILE__, __LINE__);
+	}
+      } else
+	queue->release(first_pos, num_docs);
+
       last_dump = now;
-    } else
-      sleep(1);
+    } else {
+      struct timespec expiration;
+
+      expiration.tv_sec = now + 1, expiration.tv_nsec = 0;
+      queue->wait(&expiration);
+    }
   } /* while */
 
-  free(postbuf);
+  free(iov);
+}
+
+/* **************************************** */
+
+void ElasticSearch::lua(lua_State *vm, bool since_last_checkpoint) const {
+  DB::lua(vm, since_last_checkpoint);
+
+  lua_push_uint32_table_entry(vm, "flow_export_queued", queue->getNumQueued());
+  lua_push_uint32_table_entry(vm, "flow_export_inflight_requests", num_inflight_bulks);
+  lua_push_uint64_table_entry(vm, "flow_export_inflight_bytes", inflight_bytes);
 }
 
 /* **************************************** */
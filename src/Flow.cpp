@@ -42,6 +42,7 @@ Flow::Flow(NetworkInterface *_iface,
 	   u_int8_t *_view_cli_mac, u_int8_t *_view_srv_mac) : GenericHashEntry(_iface) {
   periodic_stats_update_partial = NULL;
   viewFlowStats = NULL;
+  index_refs = NULL;
   vlanId = _vlanId, protocol = _protocol, cli_port = _cli_port, srv_port = _srv_port;
   flow_device.observation_point_id = _observation_point_id;
   cli_host = srv_host = NULL;
@@ -119,7 +120,7 @@ Flow::Flow(NetworkInterface *_iface,
   if(cli_host) {
     NetworkStats *network_stats = cli_host->getNetworkStats(cli_host->get_local_network_id());
 
-    cli_host->incUses(), cli_host->incNumFlows(last_seen, true);
+    cli_host->incNumFlows(last_seen, true); /* The use has been taken by findFlowHosts */
     if(network_stats) network_stats->incNumFlows(last_seen, true);
     cli_ip_addr = cli_host->get_ip();
     cli_host->incCliContactedHosts(_srv_ip);
@@ -137,7 +138,7 @@ Flow::Flow(NetworkInterface *_iface,
   if(srv_host) {
     NetworkStats *network_stats = srv_host->getNetworkStats(srv_host->get_local_network_id());
 
-    srv_host->incUses(), srv_host->incNumFlows(last_seen, false);
+    srv_host->incNumFlows(last_seen, false);
     if(network_stats) network_stats->incNumFlows(last_seen, false);
     srv_ip_addr = srv_host->get_ip();
 
@@ -267,14 +268,23 @@ Flow::Flow(NetworkInterface *_iface,
 /* *************************************** */
 
 void Flow::allocDPIMemory() {
-  if((ndpiFlow = (ndpi_flow_struct*)calloc(1, iface->get_flow_size())) == NULL)
+  u_int flow_size = iface->get_flow_size();
+
+  if((ndpiFlow = (ndpi_flow_struct*)ObjectPool::alloc(iface->get_ndpi_flows_pool(), flow_size)) == NULL)
     throw "Not enough memory";
+
+  memset(ndpiFlow, 0, flow_size);
 }
 
 /* *************************************** */
 
 void Flow::freeDPIMemory() {
-  if(ndpiFlow)  { ndpi_free_flow(ndpiFlow); ndpiFlow = NULL;  }
+  if(ndpiFlow) {
+    /* The struct itself comes from the interface pool (see allocDPIMemory) */
+    ndpi_free_flow_data(ndpiFlow);
+    ObjectPool::release(ndpiFlow);
+    ndpiFlow = NULL;
+  }
 }
 
 /* *************************************** */
@@ -283,6 +293,9 @@ Flow::~Flow() {
   if(getUses() != 0 && !ntop->getGlobals()->isShutdown())
     ntop->getTrace()->traceEvent(TRACE_NORMAL, "[%s] Deleting flow [%u]", __FUNCTION__, getUses());
 
+  /* Deleted without going idle (e.g. hash cleanup), or still pending */
+  iface->unindexFlow(this, true /* wait */);
+
 #ifdef ALERTED_FLOWS_DEBUG
   if(iface_alert_inc && !iface_alert_dec) {
     char buf[256];
@@ -302,7 +315,7 @@ Flow::~Flow() {
    */
   Host *cli_u = getViewSharedClient(), *srv_u = getViewSharedServer();
 
-  if(getInterface()->isViewed()) /* Score decrements done here for 'viewed' interfaces to avoid races. */
+  if(getInterface()->isViewed() || getInterface()->isPacketShard()) /* Score decrements done here for 'viewed' interfaces (and shards) to avoid races. */
     decAllFlowScores();
 
   if(cli_u) {
@@ -836,6 +849,7 @@ void Flow::processDNSPacket(const u_char *ip_packet, u_int16_t ip_len, u_int64_t
   switch(ndpi_get_lower_proto(proto_id)) {
   case NDPI_PROTOCOL_DNS:
     ndpiDetectedProtocol = proto_id; /* Override! */
+    iface->indexFlow(this);
 
     if(ndpiFlow->host_server_name[0] != '\0') {
       if(cli_host) {
@@ -1009,6 +1023,9 @@ void Flow::updateProtocol(ndpi_protocol proto_id) {
    */
   if(ndpiDetectedProtocol.category == NDPI_PROTOCOL_CATEGORY_UNSPECIFIED)
     ndpiDetectedProtocol.category = proto_id.category;
+
+  if(detection_completed) /* Otherwise still seen as unknown, see get_detected_protocol() */
+    iface->indexFlow(this);
 }
 
 /* *************************************** */
@@ -1028,6 +1045,7 @@ void Flow::setProtocolDetectionCompleted(u_int8_t *payload, u_int16_t payload_le
   processDetectedProtocolData();
 
   detection_completed = 1;
+  iface->indexFlow(this);
 
 #ifdef BLACKLISTED_FLOWS_DEBUG
   if(ndpiDetectedProtocol.category == CUSTOM_CATEGORY_MALWARE) {
@@ -1404,6 +1422,18 @@ void Flow::incFlowDroppedCounters() {
 void Flow::hosts_periodic_stats_update(NetworkInterface *iface, Host *cli_host, Host *srv_host,
 				       PartializableFlowTrafficStats *partial,
 				       bool first_partial, const struct timeval *tv) const {
+  hosts_shared_stats_update(iface, cli_host, srv_host, partial, tv);
+  hosts_own_stats_update(cli_host, srv_host, partial, first_partial, tv);
+}
+
+/* *************************************** */
+
+/* Stats shared by the flow hosts with other hosts: the interface, host pools,
+ * VLAN, networks, ASes, observation points, operating systems and countries.
+ * Host members only written here (TCP and quota counters) are included. */
+void Flow::hosts_shared_stats_update(NetworkInterface *iface, Host *cli_host, Host *srv_host,
+				     PartializableFlowTrafficStats *partial,
+				     const struct timeval *tv) const {
   update_pools_stats(iface, cli_host, srv_host, tv, partial->get_cli2srv_packets(), partial->get_cli2srv_bytes(),
 		     partial->get_srv2cli_packets(), partial->get_srv2cli_bytes());
 
@@ -1433,11 +1463,6 @@ void Flow::hosts_periodic_stats_update(NetworkInterface *iface, Host *cli_host,
 
     // Update network stats
     cli_network_stats = cli_host->getNetworkStats(cli_network_id);
-    cli_host->incStats(tv->tv_sec, get_protocol(),
-		       stats_protocol, get_protocol_category(), custom_app,
-		       partial->get_cli2srv_packets(), partial->get_cli2srv_bytes(), partial->get_cli2srv_goodput_bytes(),
-		       partial->get_srv2cli_packets(), partial->get_srv2cli_bytes(), partial->get_srv2cli_goodput_bytes(),
-		       srv_host->get_ip()->isNonEmptyUnicastAddress());
 
     // update per-subnet byte counters
     if(cli_network_stats) { // only if the network is known and local
@@ -1455,11 +1480,6 @@ void Flow::hosts_periodic_stats_update(NetworkInterface *iface, Host *cli_host,
     }
 
     srv_network_stats = srv_host->getNetworkStats(srv_network_id);
-    srv_host->incStats(tv->tv_sec, get_protocol(),
-		       stats_protocol, get_protocol_category(), custom_app,
-		       partial->get_srv2cli_packets(), partial->get_srv2cli_bytes(), partial->get_srv2cli_goodput_bytes(),
-		       partial->get_cli2srv_packets(), partial->get_cli2srv_bytes(), partial->get_cli2srv_goodput_bytes(),
-		       cli_host->get_ip()->isNonEmptyUnicastAddress());
 
     if(srv_network_stats) {
       // local and known server network
@@ -1507,16 +1527,6 @@ void Flow::hosts_periodic_stats_update(NetworkInterface *iface, Host *cli_host,
 			 partial->get_srv2cli_bytes(), partial->get_cli2srv_packets(),
 			 partial->get_cli2srv_bytes());
     }
-    // Update client DSCP stats
-    cli_host->incDSCPStats(getCli2SrvDSCP(),
-      partial->get_cli2srv_packets(), partial->get_cli2srv_bytes(),
-      partial->get_srv2cli_packets(), partial->get_srv2cli_bytes());
-
-    // Update server DSCP stats
-    srv_host->incDSCPStats(getSrv2CliDSCP(),
-      partial->get_srv2cli_packets(), partial->get_srv2cli_bytes(),
-      partial->get_cli2srv_packets(), partial->get_cli2srv_bytes());
-
     // Update Country stats
     Country *cli_country_stats = cli_host->getCountryStats();
     Country *srv_country_stats = srv_host->getCountryStats();
@@ -1588,11 +1598,44 @@ void Flow::hosts_periodic_stats_update(NetworkInterface *iface, Host *cli_host,
   default:
     break;
   }
+}
+
+/* *************************************** */
+
+/* Stats owned by the flow hosts only */
+void Flow::hosts_own_stats_update(Host *cli_host, Host *srv_host,
+				  PartializableFlowTrafficStats *partial,
+				  bool first_partial, const struct timeval *tv) const {
+  if(cli_host && srv_host) {
+    int16_t stats_protocol = getStatsProtocol(); /* The protocol (among ndpi master_ and app_) that is chosen to increase stats */
+
+    cli_host->incStats(tv->tv_sec, get_protocol(),
+		       stats_protocol, get_protocol_category(), custom_app,
+		       partial->get_cli2srv_packets(), partial->get_cli2srv_bytes(), partial->get_cli2srv_goodput_bytes(),
+		       partial->get_srv2cli_packets(), partial->get_srv2cli_bytes(), partial->get_srv2cli_goodput_bytes(),
+		       srv_host->get_ip()->isNonEmptyUnicastAddress());
+
+    srv_host->incStats(tv->tv_sec, get_protocol(),
+		       stats_protocol, get_protocol_category(), custom_app,
+		       partial->get_srv2cli_packets(), partial->get_srv2cli_bytes(), partial->get_srv2cli_goodput_bytes(),
+		       partial->get_cli2srv_packets(), partial->get_cli2srv_bytes(), partial->get_cli2srv_goodput_bytes(),
+		       cli_host->get_ip()->isNonEmptyUnicastAddress());
+
+    // Update client DSCP stats
+    cli_host->incDSCPStats(getCli2SrvDSCP(),
+      partial->get_cli2srv_packets(), partial->get_cli2srv_bytes(),
+      partial->get_srv2cli_packets(), partial->get_srv2cli_bytes());
+
+    // Update server DSCP stats
+    srv_host->incDSCPStats(getSrv2CliDSCP(),
+      partial->get_srv2cli_packets(), partial->get_srv2cli_bytes(),
+      partial->get_cli2srv_packets(), partial->get_cli2srv_bytes());
+  }
 
   switch(ndpi_get_lower_proto(ndpiDetectedProtocol)) {
   case NDPI_PROTOCOL_HTTP:
-    if(cli_host && cli_host->getHTTPstats()) cli_host->getHTTPstats()->incStats(true  /* Client */, partial->get_flow_http_stats());
-    if(srv_host && srv_host->getHTTPstats()) srv_host->getHTTPstats()->incStats(false /* Server */, partial->get_flow_http_stats());
+    if(cli_host && cli_host->allocHTTPstats()) cli_host->getHTTPstats()->incStats(true  /* Client */, partial->get_flow_http_stats());
+    if(srv_host && srv_host->allocHTTPstats()) srv_host->getHTTPstats()->incStats(false /* Server */, partial->get_flow_http_stats());
 
     if(operating_system != os_unknown) {
       if(cli_host
@@ -1607,8 +1650,8 @@ void Flow::hosts_periodic_stats_update(NetworkInterface *iface, Host *cli_host,
         srv_host->offlineSetHTTPName(host_server_name);
       }
 
-      if(srv_host->getHTTPstats()
-         && host_server_name
+      if(host_server_name
+         && srv_host->allocHTTPstats()
          && isThreeWayHandshakeOK()) {
         srv_host->getHTTPstats()->updateHTTPHostRequest(tv->tv_sec, host_server_name,
                   partial->get_num_http_requests(),
@@ -1618,9 +1661,9 @@ void Flow::hosts_periodic_stats_update(NetworkInterface *iface, Host *cli_host,
     }
     break;
   case NDPI_PROTOCOL_DNS:
-    if(cli_host && cli_host->getDNSstats())
+    if(cli_host && cli_host->allocDNSstats())
       cli_host->getDNSstats()->incStats(true  /* Client */, partial->get_flow_dns_stats());
-    if(srv_host && srv_host->getDNSstats())
+    if(srv_host && srv_host->allocDNSstats())
       srv_host->getDNSstats()->incStats(false /* Server */, partial->get_flow_dns_stats());
     break;
 
@@ -1643,14 +1686,14 @@ void Flow::hosts_periodic_stats_update(NetworkInterface *iface, Host *cli_host,
     break;
   case NDPI_PROTOCOL_IP_ICMP:
   case NDPI_PROTOCOL_IP_ICMPV6:
-    if(cli_host && cli_host->getICMPstats()) {
+    if(cli_host && cli_host->allocICMPstats()) {
       if(partial->get_cli2srv_packets())
 	cli_host->getICMPstats()->incStats(partial->get_cli2srv_packets(), protos.icmp.cli2srv.icmp_type, protos.icmp.cli2srv.icmp_code, true  /* Sent */, srv_host);
 
       if(partial->get_srv2cli_packets())
 	cli_host->getICMPstats()->incStats(partial->get_srv2cli_packets(), protos.icmp.srv2cli.icmp_type, protos.icmp.srv2cli.icmp_code, false /* Rcvd */, srv_host);
     }
-    if(srv_host && srv_host->getICMPstats()) {
+    if(srv_host && srv_host->allocICMPstats()) {
       if(partial->get_cli2srv_packets())
 	srv_host->getICMPstats()->incStats(partial->get_cli2srv_packets(), protos.icmp.cli2srv.icmp_type, protos.icmp.cli2srv.icmp_code, false /* Rcvd */, cli_host);
 
@@ -2850,6 +2893,280 @@ json_object* Flow::flow2JSON() {
 
 /* *************************************** */
 
+static inline const char* flowJSONLabel(bool use_labels, int label, const char *label_str,
+					char *buf, u_int buf_len) {
+  if(use_labels)
+    return(label_str);
+
+  snprintf(buf, buf_len, "%d", label);
+  return(buf);
+}
+
+/* *************************************** */
+
+/*
+  Streaming counterpart of serialize(use_labels): the flow is written
+  straight into the writer buffer instead of building a json-c tree.
+  Keep it in sync with flow2JSON(), the output must be byte-identical.
+  The returned string is owned by the writer.
+*/
+const char* Flow::serialize(JSONWriter *w, bool use_labels, u_int32_t *json_len) {
+  char buf[64], jsonbuf[64], *c;
+  u_char community_id[200];
+  time_t t;
+  const IpAddress *cli_ip = get_cli_ip_addr(), *srv_ip = get_srv_ip_addr();
+
+  w->reset();
+
+  if(ntop->getPrefs()->do_dump_flows_on_es()) {
+    struct tm tm_info;
+
+    t = last_seen;
+    gmtime_r(&t, &tm_info);
+    strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S.0Z", &tm_info);
+
+    w->addString("@timestamp", buf);
+    w->addString("type", ntop->getPrefs()->get_es_type());
+
+    if(cli_host && cli_host->getMac() && !cli_host->getMac()->isNull())
+      w->addString(flowJSONLabel(use_labels, IN_SRC_MAC, "IN_SRC_MAC", jsonbuf, sizeof(jsonbuf)),
+		   Utils::formatMac(cli_host->get_mac(), buf, sizeof(buf)));
+
+    if(srv_host && srv_host->getMac() && !srv_host->getMac()->isNull())
+      w->addString(flowJSONLabel(use_labels, OUT_DST_MAC, "OUT_DST_MAC", jsonbuf, sizeof(jsonbuf)),
+		   Utils::formatMac(srv_host->get_mac(), buf, sizeof(buf)));
+  }
+
+  if(ntop->getPrefs()->do_dump_flows_on_syslog()) {
+    if(cli_host && cli_host->getMac() && !cli_host->getMac()->isNull())
+      w->addString(flowJSONLabel(use_labels, IN_SRC_MAC, "IN_SRC_MAC", jsonbuf, sizeof(jsonbuf)),
+		   Utils::formatMac(cli_host->get_mac(), buf, sizeof(buf)));
+
+    if(srv_host && srv_host->getMac() && !srv_host->getMac()->isNull())
+      w->addString(flowJSONLabel(use_labels, OUT_DST_MAC, "OUT_DST_MAC", jsonbuf, sizeof(jsonbuf)),
+		   Utils::formatMac(srv_host->get_mac(), buf, sizeof(buf)));
+
+    if(isTLS() && protos.tls.ja3.client_hash)
+      w->addString(flowJSONLabel(use_labels, JA3C_HASH, "JA3C_HASH", jsonbuf, sizeof(jsonbuf)),
+		   protos.tls.ja3.client_hash);
+
+    if(isSSH() && protos.ssh.hassh.client_hash)
+      w->addString(flowJSONLabel(use_labels, HASSHC_HASH, "HASSHC_HASH", jsonbuf, sizeof(jsonbuf)),
+		   protos.ssh.hassh.client_hash);
+  }
+
+  if(cli_ip) {
+    int16_t cli_network_id = 0;
+
+    if(cli_ip->isIPv4())
+      w->addString(flowJSONLabel(use_labels, IPV4_SRC_ADDR, "IPV4_SRC_ADDR", jsonbuf, sizeof(jsonbuf)),
+		   cli_ip->print(buf, sizeof(buf)));
+    else if(cli_ip->isIPv6())
+      w->addString(flowJSONLabel(use_labels, IPV6_SRC_ADDR, "IPV6_SRC_ADDR", jsonbuf, sizeof(jsonbuf)),
+		   cli_ip->print(buf, sizeof(buf)));
+
+    w->addBool(flowJSONLabel(use_labels, SRC_ADDR_LOCAL, "SRC_ADDR_LOCAL", jsonbuf, sizeof(jsonbuf)),
+	       cli_ip->isLocalHost(&cli_network_id));
+    w->addBool(flowJSONLabel(use_labels, SRC_ADDR_BLACKLISTED, "SRC_ADDR_BLACKLISTED", jsonbuf, sizeof(jsonbuf)),
+	       cli_ip->isBlacklistedAddress());
+
+    if(get_cli_host()) {
+      w->addInt(flowJSONLabel(use_labels, SRC_ADDR_SERVICES, "SRC_ADDR_SERVICES", jsonbuf, sizeof(jsonbuf)),
+		(int32_t)get_cli_host()->getServicesMap());
+      w->addString(flowJSONLabel(use_labels, SRC_NAME, "SRC_NAME", jsonbuf, sizeof(jsonbuf)),
+		   get_cli_host()->get_visual_name(buf, sizeof(buf)));
+    }
+  }
+
+  if(srv_ip) {
+    int16_t srv_network_id = 0;
+
+    if(srv_ip->isIPv4())
+      w->addString(flowJSONLabel(use_labels, IPV4_DST_ADDR, "IPV4_DST_ADDR", jsonbuf, sizeof(jsonbuf)),
+		   srv_ip->print(buf, sizeof(buf)));
+    else if(srv_ip->isIPv6())
+      w->addString(flowJSONLabel(use_labels, IPV6_DST_ADDR, "IPV6_DST_ADDR", jsonbuf, sizeof(jsonbuf)),
+		   srv_ip->print(buf, sizeof(buf)));
+
+    w->addBool(flowJSONLabel(use_labels, DST_ADDR_LOCAL, "DST_ADDR_LOCAL", jsonbuf, sizeof(jsonbuf)),
+	       srv_ip->isLocalHost(&srv_network_id));
+    w->addBool(flowJSONLabel(use_labels, DST_ADDR_BLACKLISTED, "DST_ADDR_BLACKLISTED", jsonbuf, sizeof(jsonbuf)),
+	       srv_ip->isBlacklistedAddress());
+
+    if(get_srv_host()) {
+      w->addInt(flowJSONLabel(use_labels, DST_ADDR_SERVICES, "DST_ADDR_SERVICES", jsonbuf, sizeof(jsonbuf)),
+		(int32_t)get_srv_host()->getServicesMap());
+      w->addString(flowJSONLabel(use_labels, SRC_NAME, "DST_NAME", jsonbuf, sizeof(jsonbuf)),
+		   get_srv_host()->get_visual_name(buf, sizeof(buf)));
+    }
+  }
+
+  w->addInt(flowJSONLabel(use_labels, SRC_TOS, "SRC_TOS", jsonbuf, sizeof(jsonbuf)), getTOS(true));
+  w->addInt(flowJSONLabel(use_labels, DST_TOS, "DST_TOS", jsonbuf, sizeof(jsonbuf)), getTOS(false));
+  w->addInt(flowJSONLabel(use_labels, L4_SRC_PORT, "L4_SRC_PORT", jsonbuf, sizeof(jsonbuf)), get_cli_port());
+  w->addInt(flowJSONLabel(use_labels, L4_DST_PORT, "L4_DST_PORT", jsonbuf, sizeof(jsonbuf)), get_srv_port());
+  w->addInt(flowJSONLabel(use_labels, PROTOCOL, "PROTOCOL", jsonbuf, sizeof(jsonbuf)), protocol);
+
+  if(((get_packets_cli2srv() + get_packets_srv2cli()) > NDPI_MIN_NUM_PACKETS)
+     || (ndpiDetectedProtocol.app_protocol != NDPI_PROTOCOL_UNKNOWN)) {
+    w->addInt(flowJSONLabel(use_labels, L7_PROTO, "L7_PROTO", jsonbuf, sizeof(jsonbuf)),
+	      ndpiDetectedProtocol.app_protocol);
+    w->addString(flowJSONLabel(use_labels, L7_PROTO_NAME, "L7_PROTO_NAME", jsonbuf, sizeof(jsonbuf)),
+		 get_detected_protocol_name(buf, sizeof(buf)));
+  }
+
+  if(protocol == IPPROTO_TCP) {
+    w->addInt(flowJSONLabel(use_labels, TCP_FLAGS, "TCP_FLAGS", jsonbuf, sizeof(jsonbuf)),
+	      src2dst_tcp_flags | dst2src_tcp_flags);
+    w->addInt64(flowJSONLabel(use_labels, TCP_FLAGS, "IN_RETRASMISSIONS", jsonbuf, sizeof(jsonbuf)),
+		stats.get_cli2srv_tcp_retr());
+    w->addInt64(flowJSONLabel(use_labels, TCP_FLAGS, "OUT_RETRASMISSIONS", jsonbuf, sizeof(jsonbuf)),
+		stats.get_srv2cli_tcp_retr());
+    w->addInt64(flowJSONLabel(use_labels, TCP_FLAGS, "IN_OUT_OF_ORDER", jsonbuf, sizeof(jsonbuf)),
+		stats.get_cli2srv_tcp_ooo());
+    w->addInt64(flowJSONLabel(use_labels, TCP_FLAGS, "OUT_OUT_OF_ORDER", jsonbuf, sizeof(jsonbuf)),
+		stats.get_srv2cli_tcp_ooo());
+    w->addInt64(flowJSONLabel(use_labels, TCP_FLAGS, "IN_LOST", jsonbuf, sizeof(jsonbuf)),
+		stats.get_cli2srv_tcp_lost());
+    w->addInt64(flowJSONLabel(use_labels, TCP_FLAGS, "OUT_LOST", jsonbuf, sizeof(jsonbuf)),
+		stats.get_srv2cli_tcp_lost());
+  }
+
+  w->addInt64(flowJSONLabel(use_labels, IN_PKTS, "IN_PKTS", jsonbuf, sizeof(jsonbuf)), get_partial_packets_cli2srv());
+  w->addInt64(flowJSONLabel(use_labels, IN_BYTES, "IN_BYTES", jsonbuf, sizeof(jsonbuf)), get_partial_bytes_cli2srv());
+  w->addInt64(flowJSONLabel(use_labels, OUT_PKTS, "OUT_PKTS", jsonbuf, sizeof(jsonbuf)), get_partial_packets_srv2cli());
+  w->addInt64(flowJSONLabel(use_labels, OUT_BYTES, "OUT_BYTES", jsonbuf, sizeof(jsonbuf)), get_partial_bytes_srv2cli());
+
+  w->addInt(flowJSONLabel(use_labels, FIRST_SWITCHED, "FIRST_SWITCHED", jsonbuf, sizeof(jsonbuf)),
+	    (int32_t)(u_int32_t)get_partial_first_seen());
+  w->addInt(flowJSONLabel(use_labels, LAST_SWITCHED, "LAST_SWITCHED", jsonbuf, sizeof(jsonbuf)),
+	    (int32_t)(u_int32_t)get_partial_last_seen());
+
+  if(json_info && json_object_object_length(json_info) > 0)
+    w->addRaw("json", json_object_to_json_string(json_info));
+
+  if(vlanId > 0)
+    w->addInt(flowJSONLabel(use_labels, SRC_VLAN, "SRC_VLAN", jsonbuf, sizeof(jsonbuf)), vlanId);
+
+  if(protocol == IPPROTO_TCP) {
+    w->addDouble(flowJSONLabel(use_labels, CLIENT_NW_LATENCY_MS, "CLIENT_NW_LATENCY_MS", jsonbuf, sizeof(jsonbuf)),
+		 toMs(&clientNwLatency));
+    w->addDouble(flowJSONLabel(use_labels, SERVER_NW_LATENCY_MS, "SERVER_NW_LATENCY_MS", jsonbuf, sizeof(jsonbuf)),
+		 toMs(&serverNwLatency));
+  }
+
+  c = cli_host ? cli_host->get_country(buf, sizeof(buf)) : NULL;
+  if(c) {
+    float latitude, longitude;
+    double location[2];
+
+    w->addString("SRC_IP_COUNTRY", c);
+    cli_host->get_geocoordinates(&latitude, &longitude);
+    location[0] = longitude, location[1] = latitude;
+    w->addDoubleArray("SRC_IP_LOCATION", location, 2);
+  }
+
+  c = srv_host ? srv_host->get_country(buf, sizeof(buf)) : NULL;
+  if(c) {
+    float latitude, longitude;
+    double location[2];
+
+    w->addString("DST_IP_COUNTRY", c);
+    srv_host->get_geocoordinates(&latitude, &longitude);
+    location[0] = longitude, location[1] = latitude;
+    w->addDoubleArray("DST_IP_LOCATION", location, 2);
+  }
+
+#ifdef NTOPNG_PRO
+#ifndef HAVE_NEDGE
+  if(trafficProfile && trafficProfile->getName())
+    w->addString("PROFILE", trafficProfile->getName());
+#endif
+#endif
+  if(ntop->getPrefs() && ntop->getPrefs()->get_instance_name())
+    w->addString("NTOPNG_INSTANCE_NAME", ntop->getPrefs()->get_instance_name());
+  if(iface && iface->get_name())
+    w->addString("INTERFACE", iface->get_name());
+
+  if(isDNS() && protos.dns.last_query)
+    w->addString("DNS_QUERY", protos.dns.last_query);
+
+  w->addString("COMMUNITY_ID", (char *)getCommunityId(community_id, sizeof(community_id)));
+
+  if(isHTTP()) {
+    if(host_server_name && host_server_name[0] != '\0')
+      w->addString("HTTP_HOST", host_server_name);
+    if(protos.http.last_url && protos.http.last_url[0] != '0')
+      w->addString("HTTP_URL", protos.http.last_url);
+    if(protos.http.last_user_agent && protos.http.last_user_agent[0] != '0')
+      w->addString("HTTP_USER_AGENT", protos.http.last_user_agent);
+    if(protos.http.last_method != NDPI_HTTP_METHOD_UNKNOWN)
+      w->addString("HTTP_METHOD", ndpi_http_method2str(protos.http.last_method));
+    if(protos.http.last_return_code > 0)
+      w->addInt("HTTP_RET_CODE", (int32_t)(u_int32_t)protos.http.last_return_code);
+  }
+
+  if(flow_device.device_ip)
+    w->addString("EXPORTER_IPV4_ADDRESS", intoaV4(flow_device.device_ip, buf, sizeof(buf)));
+
+  if(bt_hash)
+    w->addString("BITTORRENT_HASH", bt_hash);
+
+  if(isTLS() && protos.tls.client_requested_server_name)
+    w->addString("TLS_SERVER_NAME", protos.tls.client_requested_server_name);
+
+#ifdef HAVE_NEDGE
+  if(iface && iface->is_bridge_interface())
+    w->addBool("verdict.pass", isPassVerdict());
+#else
+  if(!passVerdict) w->addBool("verdict.pass", false);
+#endif
+
+  if(cli_ebpf || srv_ebpf) {
+    /* Rare: reuse the json-c code and copy its members */
+    json_object *ebpf_object = json_object_new_object();
+
+    if(ebpf_object) {
+      if(cli_ebpf) cli_ebpf->getJSONObject(ebpf_object, true);
+      if(srv_ebpf) srv_ebpf->getJSONObject(ebpf_object, false);
+
+      json_object_object_foreach(ebpf_object, key, val)
+	w->addRaw(key, val ? json_object_to_json_string(val) : NULL);
+
+      json_object_put(ebpf_object);
+    }
+  }
+
+  if(ntop->getPrefs()->do_dump_extended_json()) {
+    const char *info;
+
+    w->addInt("FLOW_TIME", (int32_t)last_seen);
+
+    if(cli_ip) {
+      if(cli_ip->isIPv4())
+	w->addInt(flowJSONLabel(use_labels, IP_PROTOCOL_VERSION, "IP_PROTOCOL_VERSION", jsonbuf, sizeof(jsonbuf)), 4);
+      else if(cli_ip->isIPv6())
+	w->addInt(flowJSONLabel(use_labels, IP_PROTOCOL_VERSION, "IP_PROTOCOL_VERSION", jsonbuf, sizeof(jsonbuf)), 6);
+    }
+
+    info = getFlowInfo(buf, sizeof(buf), false);
+
+    if(info)
+      w->addString("INFO", info);
+
+#if defined(NTOPNG_PRO) && !defined(HAVE_NEDGE)
+    w->addString("PROFILE", get_profile_name());
+#endif
+
+    w->addInt("INTERFACE_ID", iface->get_id());
+    w->addInt("STATUS", (u_int8_t)getPredominantAlert().id);
+  }
+
+  return(w->end(json_len));
+}
+
+/* *************************************** */
+
 u_char* Flow::getCommunityId(u_char *community_id, u_int community_id_len) {
   if(cli_host && srv_host) {
     IpAddress *c = cli_host->get_ip(), *s = srv_host->get_ip();
@@ -3063,7 +3380,7 @@ void Flow::decAllFlowScores() {
   if(isFlowAlerted()) {
     iface->decNumAlertedFlows(this, Utils::mapScoreToSeverity(getPredominantAlertScore()));
 
-    if(!getInterface()->isViewed() /* Always for non-viewed interfaces (increments are always performed and in the same thread) */
+    if((!getInterface()->isViewed() && !getInterface()->isPacketShard()) /* Always for non-viewed interfaces (increments are always performed and in the same thread) */
       /*
 	For viewed interfaces, do the decrement only if previously incremented.
 	A previous increment can fail when the view flows queue is full and enqueues fail.
@@ -3161,28 +3478,12 @@ void Flow::housekeep(time_t t) {
     /*
       Score decrements MUST be performed here as this is the same thread of checks execution where
       scores are increased.
-      NOTE: for view interfaces, decrement are performed in ~Flow to avoid races.
+      NOTE: for view interfaces (and packet shards), decrement are performed in ~Flow to avoid races.
      */
-    if(!getInterface()->isViewed()) decAllFlowScores();
-
-    switch(protocol) {
-    case IPPROTO_TCP:
-      if(cli_host
-	 && ((getTcpFlagsCli2Srv() == TH_SYN)
-	     || (!non_zero_payload_observed)	     
-	     )
-	 )
-	cli_host->incIncompleteFlows();
-      break;
+    if(!getInterface()->isViewed() && !getInterface()->isPacketShard()) decAllFlowScores();
 
-    case IPPROTO_UDP:
-      if(cli_host
-	 && (get_packets_srv2cli() == 0) /* unidirectional flow */
-	 && srv_ip_addr
-	 && srv_ip_addr->isNonEmptyUnicastAddress())
-	cli_host->incIncompleteFlows();
-      break;
-    }
+    if(cli_host && isIncomplete())
+      cli_host->incIncompleteFlows();
 
 #ifdef DEBUG_SCAN_DETECTION
     char buf[64];
@@ -3203,6 +3504,28 @@ void Flow::housekeep(time_t t) {
     are done before the flow is propagated to the view.
   */
   getInterface()->viewEnqueue(t, this);
+
+  /* Same for packet shards, whose hosts are updated by the parent interface */
+  if(getInterface()->isPacketShard())
+    getInterface()->getShardParent()->shardFlowUpdate(this, t);
+}
+
+/* *************************************** */
+
+bool Flow::isIncomplete() const {
+  switch(protocol) {
+  case IPPROTO_TCP:
+    return((getTcpFlagsCli2Srv() == TH_SYN)
+	   || (!non_zero_payload_observed));
+
+  case IPPROTO_UDP:
+    return((get_packets_srv2cli() == 0) /* unidirectional flow */
+	   && srv_ip_addr
+	   && srv_ip_addr->isNonEmptyUnicastAddress());
+
+  default:
+    return(false);
+  }
 }
 
 /* *************************************** */
@@ -3227,7 +3550,7 @@ bool Flow::get_partial_traffic_stats(PartializableFlowTrafficStats **dst,
 
 /* *************************************** */
 
-/* NOTE: this is only called by the ViewInterface */
+/* NOTE: this is only called by the ViewInterface (and the parent of a packet shard) */
 bool Flow::get_partial_traffic_stats_view(PartializableFlowTrafficStats *fts, bool *first_partial) {
   if(!fts)
     return(false);
@@ -5719,6 +6042,17 @@ void Flow::setPredominantAlert(FlowAlertType alert_type, u_int16_t score) {
   /* Update the current predominant alert and score */
   predominant_alert = alert_type;
   predominant_alert_score = score;
+
+  iface->indexFlow(this);
+}
+
+/* ***************************************************** */
+
+void Flow::set_hash_entry_state_idle() {
+  /* No longer in the flows hash, hence no longer returned by queries */
+  iface->unindexFlow(this, false /* deferred if the postings are being queried */);
+
+  GenericHashEntry::set_hash_entry_state_idle();
 }
 
 /* ***************************************************** */
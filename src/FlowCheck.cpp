@@ -31,6 +31,10 @@ FlowCheck::FlowCheck(NtopngEdition _edition,
   has_periodic_update    = _has_periodic_update;
   has_flow_end           = _has_flow_end;
   has_flow_begin         = _has_flow_begin;
+  l4_protocols           = FLOW_CHECK_L4_ANY;
+  has_l7_filter          = false;
+  required_risk          = NDPI_NO_RISK;
+  NDPI_BITMASK_RESET(l7_protocols);
 };
 
 /* **************************************************** */
@@ -69,6 +73,13 @@ void FlowCheck::addCheck(std::list<FlowCheck*> *l, NetworkInterface *iface, Flow
 
 /* **************************************************** */
 
+void FlowCheck::addL7Protocol(u_int16_t l7_proto) {
+  NDPI_BITMASK_ADD(l7_protocols, l7_proto);
+  has_l7_filter = true;
+}
+
+/* **************************************************** */
+
 bool FlowCheck::loadConfiguration(json_object *config) {
   bool rc = true;
   
@@ -23,27 +23,55 @@
 
 /* **************************************************** */
 
+static const char* hook_names[] = {
+  "protocol_detected", "periodic_update", "flow_end", "flow_begin"
+};
+
+/* **************************************************** */
+
 FlowChecksExecutor::FlowChecksExecutor(FlowChecksLoader *fcl, NetworkInterface *_iface) {
   iface = _iface;
+  memset(checks, 0, sizeof(checks));
+  memset(num_checks, 0, sizeof(num_checks));
   loadFlowChecks(fcl);
 };
 
 /* **************************************************** */
 
 FlowChecksExecutor::~FlowChecksExecutor() {
-  if(protocol_detected) delete protocol_detected;
-  if(periodic_update)   delete periodic_update;
-  if(flow_end)          delete flow_end;
-  if(flow_begin)        delete flow_begin;
+  for(int c = 0; c < flow_check_flow_none; c++) {
+    if(checks[c]) free(checks[c]);
+  }
 };
 
 /* **************************************************** */
 
+void FlowChecksExecutor::loadHookChecks(FlowChecks c, std::list<FlowCheck*> *cb_list) {
+  if(!cb_list)
+    return;
+
+  if(cb_list->size() > 0
+     && (checks[c] = (flow_check_entry_t*)calloc(cb_list->size(), sizeof(flow_check_entry_t))) != NULL) {
+    for(list<FlowCheck*>::iterator it = cb_list->begin(); it != cb_list->end(); ++it) {
+      flow_check_entry_t *e = &checks[c][num_checks[c]++];
+
+      e->check = *it;
+      e->l4_protocols = (*it)->getL4Protocols();
+      e->has_l7_filter = (*it)->hasL7Filter();
+      e->required_risk = (*it)->getRequiredRisk();
+    }
+  }
+
+  delete cb_list;
+}
+
+/* **************************************************** */
+
 void FlowChecksExecutor::loadFlowChecks(FlowChecksLoader *fcl) {
-  protocol_detected = fcl->getProtocolDetectedChecks(iface);
-  periodic_update   = fcl->getPeriodicUpdateChecks(iface);
-  flow_end          = fcl->getFlowEndChecks(iface);
-  flow_begin        = fcl->getFlowBeginChecks(iface);
+  loadHookChecks(flow_check_protocol_detected, fcl->getProtocolDetectedChecks(iface));
+  loadHookChecks(flow_check_periodic_update,   fcl->getPeriodicUpdateChecks(iface));
+  loadHookChecks(flow_check_flow_end,          fcl->getFlowEndChecks(iface));
+  loadHookChecks(flow_check_flow_begin,        fcl->getFlowBeginChecks(iface));
 }
 
 /* **************************************************** */
@@ -51,48 +79,63 @@ void FlowChecksExecutor::loadFlowChecks(FlowChecksLoader *fcl) {
 FlowAlert *FlowChecksExecutor::execChecks(Flow *f, FlowChecks c) {
   FlowAlertType predominant_alert = f->getPredominantAlert();
   FlowCheck *predominant_check = NULL;
-  std::list<FlowCheck*> *checks = NULL;
+  void (FlowCheck::*hook)(Flow *f);
+  ndpi_protocol l7_proto;
+  ndpi_risk risks;
+  u_int8_t l4_proto;
   FlowAlert *alert;
 
   switch (c) {
     case flow_check_protocol_detected:
-      checks = protocol_detected;
+      hook = &FlowCheck::protocolDetected;
       break;
     case flow_check_periodic_update:
-      checks = periodic_update;
+      hook = &FlowCheck::periodicUpdate;
       break;
     case flow_check_flow_end:
-      checks = flow_end;
+      hook = &FlowCheck::flowEnd;
       break;
     case flow_check_flow_begin:
-      checks = flow_begin;
+      hook = &FlowCheck::flowBegin;
       break;
     default:
       return NULL;
   }
 
-  for(list<FlowCheck*>::iterator it = checks->begin(); it != checks->end(); ++it) {
-    switch (c) {
-      case flow_check_protocol_detected:
-        (*it)->protocolDetected(f);
-        break;
-      case flow_check_periodic_update:
-        (*it)->periodicUpdate(f);
-        break;
-      case flow_check_flow_end:
-        (*it)->flowEnd(f);
-        break;
-      case flow_check_flow_begin:
-        (*it)->flowBegin(f);
-        break;
-      default:
-	break;
+  switch(f->get_protocol()) {
+    case IPPROTO_TCP:    l4_proto = FLOW_CHECK_L4_TCP;   break;
+    case IPPROTO_UDP:    l4_proto = FLOW_CHECK_L4_UDP;   break;
+    case IPPROTO_ICMP:
+    case IPPROTO_ICMPV6: l4_proto = FLOW_CHECK_L4_ICMP;  break;
+    default:             l4_proto = FLOW_CHECK_L4_OTHER; break;
+  }
+
+  l7_proto = f->get_detected_protocol();
+  risks = f->getRiskBitmap();
+
+  for(u_int16_t i = 0; i < num_checks[c]; i++) {
+    flow_check_entry_t *e = &checks[c][i];
+    ticks begin;
+
+    /* Skip the checks that cannot fire for this flow */
+    if(!(e->l4_protocols & l4_proto)
+       || ((e->required_risk != NDPI_NO_RISK) && !NDPI_ISSET_BIT(risks, e->required_risk))
+       || (e->has_l7_filter && !e->check->matchesL7Protocol(&l7_proto))) {
+      e->num_skipped++;
+      continue;
     }
-    
+
+    begin = Utils::getticks();
+    (e->check->*hook)(f);
+    e->num_ticks += Utils::getticks() - begin, e->num_calls++;
+
+    /* The check may have set a risk required by the following ones */
+    risks = f->getRiskBitmap();
+
     /* Check if the check triggered a predominant alert */
     if (f->getPredominantAlert().id != predominant_alert.id) {
       predominant_alert = f->getPredominantAlert();
-      predominant_check = (*it);
+      predominant_check = e->check;
     }
   }
 
@@ -106,3 +149,35 @@ FlowAlert *FlowChecksExecutor::execChecks(Flow *f, FlowChecks c) {
 }
 
 /* **************************************************** */
+
+void FlowChecksExecutor::lua(lua_State *vm) const {
+  for(int c = 0; c < flow_check_flow_none; c++) {
+    for(u_int16_t i = 0; i < num_checks[c]; i++) {
+      const flow_check_entry_t *e = &checks[c][i];
+      std::string name = e->check->getName();
+
+      /* One table per check, with one subtable per hook */
+      lua_getfield(vm, -1, name.c_str());
+      if(lua_type(vm, -1) != LUA_TTABLE) {
+	lua_pop(vm, 1);
+	lua_newtable(vm);
+	lua_pushstring(vm, name.c_str());
+	lua_pushvalue(vm, -2);
+	lua_settable(vm, -4);
+      }
+
+      lua_newtable(vm);
+      lua_push_uint64_table_entry(vm, "num_calls", e->num_calls);
+      lua_push_uint64_table_entry(vm, "num_skipped", e->num_skipped);
+      lua_push_uint64_table_entry(vm, "num_cycles", e->num_ticks);
+      lua_push_uint64_table_entry(vm, "avg_cycles", e->num_calls ? e->num_ticks / e->num_calls : 0);
+      lua_pushstring(vm, hook_names[c]);
+      lua_insert(vm, -2);
+      lua_settable(vm, -3);
+
+      lua_pop(vm, 1); /* Check table */
+    }
+  }
+}
+
+/* **************************************************** */
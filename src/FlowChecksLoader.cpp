@@ -52,10 +52,14 @@ void FlowChecksLoader::registerCheck(FlowCheck *cb) {
 
   /*
     If this is a check that handles an nDPI flow risk, the corresponding risk is cleared in the
-    unhandled risks bitmap
+    unhandled risks bitmap. Risk checks only fire for flows having that risk, so they are
+    not executed for the other flows.
    */
   FlowRisk *fr = dynamic_cast<FlowRisk*>(cb);
-  if(fr) NDPI_CLR_BIT(unhandled_ndpi_risks, fr->handledRisk());
+  if(fr) {
+    NDPI_CLR_BIT(unhandled_ndpi_risks, fr->handledRisk());
+    fr->setRequiredRisk(fr->handledRisk());
+  }
 }
 /* **************************************************** */
 
@@ -30,7 +30,27 @@ FlowHash::FlowHash(NetworkInterface *_iface, u_int _num_hashes, u_int _max_hash_
 
 /* ************************************ */
 
-static u_int16_t max_num_loops = 0;
+typedef struct {
+  IpAddress *src_ip, *dst_ip;
+  u_int16_t src_port, dst_port;
+  VLANid vlanId;
+  u_int16_t observation_point_id;
+  u_int8_t protocol;
+  const ICMPinfo *icmp_info;
+  bool *src2dst_direction;
+} FlowHashKey;
+
+static bool flow_matches(GenericHashEntry *h, void *user_data) {
+  Flow *f = (Flow*)h;
+  FlowHashKey *k = (FlowHashKey*)user_data;
+
+  return(!f->idle()
+	 && !f->is_swap_done() /* Do NOT return flows for which swap has been done. Leave them so they will be marked as idle and disappear */
+	 && f->equal(k->src_ip, k->dst_ip, k->src_port, k->dst_port, k->vlanId, k->observation_point_id,
+		     k->protocol, k->icmp_info, k->src2dst_direction));
+}
+
+/* ************************************ */
 
 Flow* FlowHash::find(IpAddress *src_ip, IpAddress *dst_ip,
 		     u_int16_t src_port, u_int16_t dst_port, 
@@ -39,65 +59,29 @@ Flow* FlowHash::find(IpAddress *src_ip, IpAddress *dst_ip,
 		     const ICMPinfo * const icmp_info,
 		     bool *src2dst_direction,
 		     bool is_inline_call) {
-  u_int32_t hash = ((src_ip->key() + dst_ip->key()
-		     + (icmp_info ? icmp_info->key() : 0)
-		     + src_port + dst_port + vlanId + protocol) % num_hashes);
-  Flow *head = (Flow*)table[hash];
-  u_int16_t num_loops = 0;
-
-  // ntop->getTrace()->traceEvent(TRACE_NORMAL, "%u:%u / %u:%u [icmp: %u][key: %u][icmp info key: %u][head: 0x%x]", src_ip->key(), src_port, dst_ip->key(), dst_port, icmp_info ? 1 : 0, hash, icmp_info ? icmp_info->key() : 0, head);
-
-  if(!head)
-    return(NULL);
-
-  if(!is_inline_call)
-    locks[hash]->rdlock(__FILE__, __LINE__);
-
-  while(head) {
-    if(!head->idle()
-       && !head->is_swap_done() /* Do NOT return flows for which swap has been done. Leave them so they will be marked as idle and disappear */
-       && head->equal(src_ip, dst_ip, src_port, dst_port, vlanId, observation_point_id,
-		      protocol, icmp_info, src2dst_direction)) {
-      if(num_loops > max_num_loops) {
-	ntop->getTrace()->traceEvent(TRACE_INFO, "DEBUG: [Num loops: %u][hashId: %u]", num_loops, hash);
-	max_num_loops = num_loops;
-      }
-
-      break;
-    } else
-      head = (Flow*)head->next(), num_loops++;
-  }
-
-  if(num_loops > max_num_loops) {
-    ntop->getTrace()->traceEvent(TRACE_INFO, "DEBUG: [Num loops: %u][hashId: %u]", num_loops, hash);
-    max_num_loops = num_loops;
-  }
-
-  if(!is_inline_call)
-    locks[hash]->unlock(__FILE__, __LINE__);
-
-  return(head);
-}
+  u_int32_t key = src_ip->key() + dst_ip->key()
+    + (icmp_info ? icmp_info->key() : 0)
+    + src_port + dst_port + vlanId + protocol;
+  FlowHashKey k;
 
-/* ************************************ */
+  k.src_ip = src_ip, k.dst_ip = dst_ip, k.src_port = src_port, k.dst_port = dst_port;
+  k.vlanId = vlanId, k.observation_point_id = observation_point_id, k.protocol = protocol;
+  k.icmp_info = icmp_info, k.src2dst_direction = src2dst_direction;
 
-Flow* FlowHash::findByKeyAndHashId(u_int32_t key, u_int hash_id) {
-  u_int32_t hash = key % num_hashes;
-  Flow *head = (Flow*)table[hash];
+  return((Flow*)lookup<flow_matches>(key, &k, !is_inline_call));
+}
 
-  if(head == NULL) return(NULL);
+/* ************************************ */
 
-  locks[hash]->rdlock(__FILE__, __LINE__);
+static bool flow_id_matches(GenericHashEntry *h, void *user_data) {
+  Flow *f = (Flow*)h;
 
-  while(head) {
-    if(!head->idle() && head->get_hash_entry_id() == hash_id)
-      break;
-    else
-      head = (Flow*)head->next();
-  }
+  return(!f->idle() && (f->get_hash_entry_id() == *((u_int*)user_data)));
+}
 
-  locks[hash]->unlock(__FILE__, __LINE__);
+/* ************************************ */
 
-  return((Flow*)head);
+Flow* FlowHash::findByKeyAndHashId(u_int32_t key, u_int hash_id) {
+  return((Flow*)lookup<flow_id_matches>(key, &hash_id, true /* Lock */));
 }
 
@@ -0,0 +1,543 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "ntop_includes.h"
+
+/*
+  Refs of a flow, each one stored in the posting of its column:
+
+  0  application protocol
+  1  master protocol (if any and different from the application one)
+  2  VLAN
+  3  client host
+  4  server host (if different from the client one)
+  5  alerted (only alerted flows are indexed)
+
+  A flow is never stored twice in the same posting.
+*/
+static const FlowIndexColumn ref_column[FLOW_INDEX_NUM_REFS] = {
+  flow_index_ndpi_proto, flow_index_ndpi_proto,
+  flow_index_vlan,
+  flow_index_host, flow_index_host,
+  flow_index_alerted
+};
+
+/* ******************************************* */
+
+FlowIndexes::FlowIndexes() {
+  maintained = usable = false;
+  num_indexed_flows = 0;
+  num_updates = num_deferred = num_queries = num_candidates = 0;
+  tot_update_ticks = 0;
+}
+
+/* ******************************************* */
+
+FlowIndexes::~FlowIndexes() {
+  disable();
+}
+
+/* ******************************************* */
+
+void FlowIndexes::getKeys(Flow *f, u_int64_t *keys, bool *present) {
+  ndpi_protocol proto = f->get_detected_protocol();
+
+  keys[0] = proto.app_protocol, present[0] = true;
+  keys[1] = proto.master_protocol,
+    present[1] = (proto.master_protocol != NDPI_PROTOCOL_UNKNOWN) && (proto.master_protocol != proto.app_protocol);
+  keys[2] = f->get_vlan_id(), present[2] = true;
+  keys[3] = (u_int64_t)f->get_cli_host(), present[3] = (f->get_cli_host() != NULL);
+  keys[4] = (u_int64_t)f->get_srv_host(),
+    present[4] = (f->get_srv_host() != NULL) && (f->get_srv_host() != f->get_cli_host());
+  keys[5] = 1, present[5] = f->isFlowAlerted();
+}
+
+/* ******************************************* */
+
+/* Must be called with the write lock of the ref column held */
+void FlowIndexes::addRef(Flow *f, flow_index_refs_t *refs, u_int8_t ref, u_int64_t key) {
+  std::vector<Flow*> *posting = &postings[ref_column[ref]][key];
+
+  refs->key[ref] = key, refs->pos[ref] = posting->size();
+  posting->push_back(f);
+}
+
+/* ******************************************* */
+
+/* Must be called with the write lock of the ref column held */
+void FlowIndexes::removeRef(flow_index_refs_t *refs, u_int8_t ref) {
+  FlowIndexColumn column = ref_column[ref];
+  std::unordered_map<u_int64_t, std::vector<Flow*> >::iterator it = postings[column].find(refs->key[ref]);
+  u_int32_t pos = refs->pos[ref], last_pos;
+
+  refs->pos[ref] = FLOW_INDEX_NOT_INDEXED;
+
+  if((it == postings[column].end()) || (pos >= it->second.size()))
+    return; /* Not supposed to happen */
+
+  last_pos = it->second.size() - 1;
+
+  if(pos != last_pos) {
+    /* Move the last flow of the posting in place of the removed one */
+    Flow *last = it->second[last_pos];
+    flow_index_refs_t *last_refs = last->getIndexRefs();
+
+    it->second[pos] = last;
+
+    for(u_int8_t i = 0; i < FLOW_INDEX_NUM_REFS; i++) {
+      if((ref_column[i] == column) && (last_refs->pos[i] == last_pos) && (last_refs->key[i] == it->first)) {
+	last_refs->pos[i] = pos;
+	break;
+      }
+    }
+  }
+
+  it->second.pop_back();
+
+  if(it->second.empty())
+    postings[column].erase(it);
+}
+
+/* ******************************************* */
+
+/*
+  Brings the refs of the columns in the bitmap up to date. Unless wait is set,
+  columns being walked by a query are skipped and returned in the bitmap
+*/
+u_int8_t FlowIndexes::updateColumns(Flow *f, flow_index_refs_t *refs, u_int8_t columns, bool wait) {
+  u_int64_t keys[FLOW_INDEX_NUM_REFS];
+  bool present[FLOW_INDEX_NUM_REFS];
+  u_int8_t skipped = 0;
+
+  getKeys(f, keys, present);
+
+  for(u_int8_t c = 0; c < flow_index_num_columns; c++) {
+    if(!(columns & (1 << c)))
+      continue;
+
+    if(wait)
+      column_locks[c].wrlock(__FILE__, __LINE__);
+    else if(!column_locks[c].trywrlock(__FILE__, __LINE__)) {
+      skipped |= (1 << c);
+      continue;
+    }
+
+    /* Removals first so that a flow never appears twice in a posting */
+    for(u_int8_t i = 0; i < FLOW_INDEX_NUM_REFS; i++) {
+      if((ref_column[i] == c) && (refs->pos[i] != FLOW_INDEX_NOT_INDEXED)
+	 && (!present[i] || (refs->key[i] != keys[i])))
+	removeRef(refs, i);
+    }
+
+    for(u_int8_t i = 0; i < FLOW_INDEX_NUM_REFS; i++) {
+      if((ref_column[i] == c) && present[i] && (refs->pos[i] == FLOW_INDEX_NOT_INDEXED))
+	addRef(f, refs, i, keys[i]);
+    }
+
+    column_locks[c].unlock(__FILE__, __LINE__);
+  }
+
+  return(skipped);
+}
+
+/* ******************************************* */
+
+/* Same as updateColumns() for the removal of all the refs */
+u_int8_t FlowIndexes::removeColumns(flow_index_refs_t *refs, u_int8_t columns, bool wait) {
+  u_int8_t skipped = 0;
+
+  for(u_int8_t c = 0; c < flow_index_num_columns; c++) {
+    if(!(columns & (1 << c)))
+      continue;
+
+    if(wait)
+      column_locks[c].wrlock(__FILE__, __LINE__);
+    else if(!column_locks[c].trywrlock(__FILE__, __LINE__)) {
+      skipped |= (1 << c);
+      continue;
+    }
+
+    for(u_int8_t i = 0; i < FLOW_INDEX_NUM_REFS; i++) {
+      if((ref_column[i] == c) && (refs->pos[i] != FLOW_INDEX_NOT_INDEXED))
+	removeRef(refs, i);
+    }
+
+    column_locks[c].unlock(__FILE__, __LINE__);
+  }
+
+  return(skipped);
+}
+
+/* ******************************************* */
+
+/* The flow must no longer be in any posting, m must be held */
+void FlowIndexes::freeRefs(Flow *f) {
+  flow_index_refs_t *refs = f->getIndexRefs();
+
+  if(refs->pending_columns || refs->pending_unindex)
+    pending.erase(f);
+
+  num_indexed_flows--;
+
+  f->setIndexRefs(NULL);
+  free(refs);
+}
+
+/* ******************************************* */
+
+/* m must be held */
+void FlowIndexes::defer(Flow *f) {
+  pending.insert(f);
+  num_deferred++;
+}
+
+/* ******************************************* */
+
+void FlowIndexes::startMaintenance() {
+  m.lock(__FILE__, __LINE__);
+  maintained = true;
+  m.unlock(__FILE__, __LINE__);
+}
+
+/* ******************************************* */
+
+void FlowIndexes::setUsable() {
+  m.lock(__FILE__, __LINE__);
+  usable = maintained;
+  m.unlock(__FILE__, __LINE__);
+}
+
+/* ******************************************* */
+
+void FlowIndexes::indexFlow(Flow *f) {
+  flow_index_refs_t *refs;
+  u_int8_t skipped;
+  ticks begin = Utils::getticks();
+
+  if((refs = f->getIndexRefs()) == NULL) {
+    if((refs = (flow_index_refs_t*)malloc(sizeof(flow_index_refs_t))) == NULL) {
+      /* The postings are now incomplete: queries have to walk the hash */
+      m.lock(__FILE__, __LINE__);
+      usable = false;
+      m.unlock(__FILE__, __LINE__);
+      ntop->getTrace()->traceEvent(TRACE_ERROR, "Not enough memory: flow indexes are no longer used");
+      return;
+    }
+
+    for(u_int8_t i = 0; i < FLOW_INDEX_NUM_REFS; i++)
+      refs->pos[i] = FLOW_INDEX_NOT_INDEXED;
+
+    refs->pending_columns = 0, refs->pending_unindex = false;
+    f->setIndexRefs(refs);
+
+    m.lock(__FILE__, __LINE__);
+    num_indexed_flows++;
+    m.unlock(__FILE__, __LINE__);
+  } else {
+    bool idle;
+
+    m.lock(__FILE__, __LINE__);
+    idle = refs->pending_unindex;
+    m.unlock(__FILE__, __LINE__);
+
+    if(idle)
+      return;
+  }
+
+  skipped = updateColumns(f, refs, (1 << flow_index_num_columns) - 1, false /* Don't wait for queries */);
+
+  m.lock(__FILE__, __LINE__);
+
+  if(skipped) {
+    if(!refs->pending_columns)
+      defer(f);
+
+    refs->pending_columns |= skipped;
+  }
+
+  num_updates++, tot_update_ticks += Utils::getticks() - begin;
+  m.unlock(__FILE__, __LINE__);
+}
+
+/* ******************************************* */
+
+void FlowIndexes::unindexFlow(Flow *f, bool wait) {
+  flow_index_refs_t *refs = f->getIndexRefs();
+  u_int8_t skipped;
+
+  if(refs == NULL)
+    return;
+
+  if(wait) {
+    /* The flow is being deleted: keep flushPending() away from it */
+    m.lock(__FILE__, __LINE__);
+    removeColumns(refs, (1 << flow_index_num_columns) - 1, true /* wait */);
+    freeRefs(f);
+    m.unlock(__FILE__, __LINE__);
+    return;
+  }
+
+  skipped = removeColumns(refs, (1 << flow_index_num_columns) - 1, false /* Don't wait for queries */);
+
+  m.lock(__FILE__, __LINE__);
+
+  if(skipped) {
+    /*
+      Still in some postings: walk() skips idle flows until flushPending().
+      The flow is kept in use so that it is not deleted before then.
+    */
+    if(!refs->pending_columns && !refs->pending_unindex)
+      defer(f);
+
+    if(!refs->pending_unindex) {
+      refs->pending_unindex = true;
+      f->incUses();
+    }
+  } else
+    freeRefs(f);
+
+  m.unlock(__FILE__, __LINE__);
+}
+
+/* ******************************************* */
+
+void FlowIndexes::flushPending() {
+  std::vector<Flow*> unindexed;
+
+  /* Held throughout, so that pending flows can't be deleted meanwhile */
+  m.lock(__FILE__, __LINE__);
+
+  while(!pending.empty()) {
+    Flow *f = *pending.begin();
+    flow_index_refs_t *refs = f->getIndexRefs();
+    u_int8_t columns = refs->pending_columns;
+
+    pending.erase(pending.begin());
+    refs->pending_columns = 0;
+
+    if(refs->pending_unindex) {
+      removeColumns(refs, (1 << flow_index_num_columns) - 1, true /* wait */);
+      refs->pending_unindex = false;
+      freeRefs(f);
+      unindexed.push_back(f);
+    } else
+      updateColumns(f, refs, columns, true /* wait */);
+  }
+
+  m.unlock(__FILE__, __LINE__);
+
+  /* The flows can now be purged */
+  for(std::vector<Flow*>::iterator it = unindexed.begin(); it != unindexed.end(); ++it)
+    (*it)->decUses();
+}
+
+/* ******************************************* */
+
+void FlowIndexes::disable() {
+  std::vector<Flow*> unindexed;
+
+  m.lock(__FILE__, __LINE__);
+
+  maintained = usable = false;
+
+  for(u_int8_t c = 0; c < flow_index_num_columns; c++)
+    column_locks[c].wrlock(__FILE__, __LINE__);
+
+  /* Every indexed flow is either pending or in the VLAN column */
+  for(std::unordered_set<Flow*>::iterator f = pending.begin(); f != pending.end(); ++f) {
+    flow_index_refs_t *refs = (*f)->getIndexRefs();
+
+    if(refs->pending_unindex)
+      unindexed.push_back(*f);
+
+    if(refs->pos[2 /* VLAN */] == FLOW_INDEX_NOT_INDEXED) {
+      (*f)->setIndexRefs(NULL);
+      free(refs);
+    }
+  }
+
+  for(std::unordered_map<u_int64_t, std::vector<Flow*> >::iterator it = postings[flow_index_vlan].begin();
+      it != postings[flow_index_vlan].end(); ++it) {
+    for(std::vector<Flow*>::iterator f = it->second.begin(); f != it->second.end(); ++f) {
+      free((*f)->getIndexRefs());
+      (*f)->setIndexRefs(NULL);
+    }
+  }
+
+  for(u_int8_t c = 0; c < flow_index_num_columns; c++) {
+    postings[c].clear();
+    column_locks[c].unlock(__FILE__, __LINE__);
+  }
+
+  pending.clear();
+  num_indexed_flows = 0;
+
+  m.unlock(__FILE__, __LINE__);
+
+  for(std::vector<Flow*>::iterator it = unindexed.begin(); it != unindexed.end(); ++it)
+    (*it)->decUses();
+}
+
+/* ******************************************* */
+
+/* Keeps the smallest posting, each column is locked in turn */
+void FlowIndexes::selectPosting(FlowIndexColumn *best_column, u_int64_t *best_key, size_t *best_size, bool *found,
+				FlowIndexColumn column, u_int64_t key) {
+  std::unordered_map<u_int64_t, std::vector<Flow*> >::iterator it;
+  size_t size;
+
+  column_locks[column].rdlock(__FILE__, __LINE__);
+  it = postings[column].find(key);
+  size = (it != postings[column].end()) ? it->second.size() : 0;
+  column_locks[column].unlock(__FILE__, __LINE__);
+
+  if(!*found || (size < *best_size))
+    *best_column = column, *best_key = key, *best_size = size;
+
+  *found = true;
+}
+
+/* ******************************************* */
+
+bool FlowIndexes::walk(Paginator *p, Host *host,
+		       bool (*walker)(GenericHashEntry *h, void *user_data, bool *matched), void *user_data) {
+  std::unordered_map<u_int64_t, std::vector<Flow*> >::iterator posting;
+  FlowIndexColumn column = flow_index_vlan;
+  u_int64_t key = 0, candidates = 0;
+  size_t size = 0;
+  bool found = false, alerted;
+  int ndpi_proto;
+  VLANid vlan_id;
+
+  if(!usable)
+    return(false);
+
+  if(host)
+    selectPosting(&column, &key, &size, &found, flow_index_host, (u_int64_t)host);
+
+  if(p) {
+    if(p->l7protoFilter(&ndpi_proto))
+      selectPosting(&column, &key, &size, &found, flow_index_ndpi_proto, (u_int64_t)ndpi_proto);
+
+    if(p->vlanIdFilter(&vlan_id))
+      selectPosting(&column, &key, &size, &found, flow_index_vlan, (u_int64_t)vlan_id);
+
+    if(p->alertedFlows(&alerted) && alerted)
+      selectPosting(&column, &key, &size, &found, flow_index_alerted, 1);
+  }
+
+  if(!found)
+    return(false);
+
+  if(size > 0) {
+    /* Only the selected column is locked while walking */
+    column_locks[column].rdlock(__FILE__, __LINE__);
+
+    if((posting = postings[column].find(key)) != postings[column].end()) {
+      candidates = posting->second.size();
+
+      for(std::vector<Flow*>::iterator it = posting->second.begin(); it != posting->second.end(); ++it) {
+	bool matched = false;
+
+	if(!(*it)->idle() && walker(*it, user_data, &matched))
+	  break;
+      }
+    }
+
+    column_locks[column].unlock(__FILE__, __LINE__);
+  }
+
+  m.lock(__FILE__, __LINE__);
+  num_queries++, num_candidates += candidates;
+  m.unlock(__FILE__, __LINE__);
+
+  return(true);
+}
+
+/* ******************************************* */
+
+/* Approximate, as the containers overhead depends on the STL implementation */
+size_t FlowIndexes::getColumnMemory(u_int8_t column) {
+  size_t tot = postings[column].bucket_count() * sizeof(void*);
+
+  for(std::unordered_map<u_int64_t, std::vector<Flow*> >::iterator it = postings[column].begin();
+      it != postings[column].end(); ++it)
+    tot += sizeof(*it) + sizeof(void*) /* Node link */ + it->second.capacity() * sizeof(Flow*);
+
+  return(tot);
+}
+
+/* ******************************************* */
+
+void FlowIndexes::lua(lua_State *vm) {
+  const char *columns[flow_index_num_columns] = { "ndpi_proto", "vlan", "host", "alerted" };
+  ticks tickspersec = Utils::gettickspersec();
+  size_t memory;
+
+  lua_newtable(vm);
+
+  m.lock(__FILE__, __LINE__);
+
+  memory = num_indexed_flows * sizeof(flow_index_refs_t);
+
+  lua_push_bool_table_entry(vm, "enabled", maintained);
+  lua_push_bool_table_entry(vm, "usable", usable);
+  lua_push_uint64_table_entry(vm, "num_flows", num_indexed_flows);
+  lua_push_uint64_table_entry(vm, "num_updates", num_updates);
+  lua_push_uint64_table_entry(vm, "num_deferred", num_deferred);
+  lua_push_uint64_table_entry(vm, "num_pending", pending.size());
+  lua_push_float_table_entry(vm, "avg_update_usec",
+			     num_updates ? ((float)tot_update_ticks * 1000000 / tickspersec) / num_updates : 0);
+  lua_push_uint64_table_entry(vm, "num_queries", num_queries);
+  lua_push_uint64_table_entry(vm, "num_candidates", num_candidates);
+
+  m.unlock(__FILE__, __LINE__);
+
+  lua_newtable(vm);
+
+  for(u_int8_t i = 0; i < flow_index_num_columns; i++) {
+    u_int64_t num_entries = 0;
+
+    column_locks[i].rdlock(__FILE__, __LINE__);
+
+    for(std::unordered_map<u_int64_t, std::vector<Flow*> >::iterator it = postings[i].begin();
+	it != postings[i].end(); ++it)
+      num_entries += it->second.size();
+
+    memory += getColumnMemory(i);
+
+    lua_newtable(vm);
+    lua_push_uint64_table_entry(vm, "num_keys", postings[i].size());
+    lua_push_uint64_table_entry(vm, "num_entries", num_entries);
+
+    column_locks[i].unlock(__FILE__, __LINE__);
+
+    lua_pushstring(vm, columns[i]);
+    lua_insert(vm, -2);
+    lua_settable(vm, -3);
+  }
+
+  lua_pushstring(vm, "columns");
+  lua_insert(vm, -2);
+  lua_settable(vm, -3);
+
+  lua_push_uint64_table_entry(vm, "memory", memory);
+}
@@ -21,10 +21,71 @@
 
 #include "ntop_includes.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define HASH_GROUP_NUM_SLOTS  32 /* Tags compared at once with a single AVX2 instruction */
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define HASH_GROUP_NUM_SLOTS  16 /* Tags compared at once with a single SSE2 instruction */
+#else
+#define HASH_GROUP_NUM_SLOTS  16
+#endif
+
+#define HASH_STRIPE_NUM_GROUPS (HASH_STRIPE_NUM_SLOTS / HASH_GROUP_NUM_SLOTS)
+
+/* ************************************ */
+
+/* Keys returned by GenericHashEntry::key() are often plain sums (e.g. flows) or small
+   integers (e.g. VLANs and ASNs): mix them (murmur3 finalizer) before using their bits
+   to select the stripe, the first group to probe and the slot fingerprint. */
+static inline u_int32_t mixKey(u_int32_t k) {
+  k ^= k >> 16;
+  k *= 0x85ebca6b;
+  k ^= k >> 13;
+  k *= 0xc2b2ae35;
+  k ^= k >> 16;
+
+  return(k);
+}
+
+static inline u_int8_t keyTag(u_int32_t h)        { return(0x80 | (h >> 25)); }
+static inline u_int32_t firstGroup(u_int32_t h)   { return(((h >> 7) ^ (h >> 19)) % HASH_STRIPE_NUM_GROUPS); }
+static inline bool isFingerprint(u_int8_t tag)    { return((tag & 0x80) != 0); }
+
+/* Returns a bitmap of the slots of the group whose tag is equal to tag */
+static inline u_int32_t matchGroup(const u_int8_t *group, u_int8_t tag) {
+#if defined(__AVX2__)
+  __m256i tags = _mm256_loadu_si256((const __m256i*)group);
+
+  return((u_int32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(tags, _mm256_set1_epi8((char)tag))));
+#elif defined(__SSE2__)
+  __m128i tags = _mm_loadu_si128((const __m128i*)group);
+
+  return((u_int32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(tags, _mm_set1_epi8((char)tag))));
+#else
+  u_int32_t mask = 0;
+
+  for(u_int i = 0; i < HASH_GROUP_NUM_SLOTS; i++)
+    if(group[i] == tag) mask |= (1 << i);
+
+  return(mask);
+#endif
+}
+
 /* ************************************ */
 
 GenericHash::GenericHash(NetworkInterface *_iface, u_int _num_hashes,
-			 u_int _max_hash_size, const char *_name) {
+			 u_int _max_hash_size, const char *_name)
+  : GenericHash(_iface, _num_hashes, _max_hash_size, _name,
+		(ntop && ntop->getPrefs()) ? ntop->getPrefs()->get_hash_table_engine() : hash_table_engine_chaining) {
+  ;
+}
+
+/* ************************************ */
+
+GenericHash::GenericHash(NetworkInterface *_iface, u_int _num_hashes,
+			 u_int _max_hash_size, const char *_name, HashTableEngine _engine) {
+  engine = _engine;
   num_hashes = _num_hashes;
   current_size = 0;
   /* Allow the total number of entries (that is, active and those idle but still not yet purged)
@@ -33,34 +94,81 @@ GenericHash::GenericHash(NetworkInterface *_iface, u_int _num_hashes,
   max_hash_size = _max_hash_size * 1.3;
   upper_num_visited_entries = min_val(200000, (max_hash_size / 10));
   last_entry_id = 0;
-  purge_step = max_val(num_hashes / PURGE_FRACTION, 1);
+  entry_id_unit = 0, num_entry_id_units = 1;
   walk_idle_start_hash_id = 0;
   name = strdup(_name ? _name : "???");
   memset(&entry_state_transition_counters, 0, sizeof(entry_state_transition_counters));
 
   iface = _iface;
-  idle_entries = idle_entries_shadow = NULL;
+  idle_entries = NULL;
+  idle_entries_shadow = new (std::nothrow) vector<GenericHashEntry*>; /* Partitions append to it without swapping first */
+  table = NULL, stripes = NULL, num_stripes = 0;
+
+  if(engine == hash_table_engine_open_addressing)
+    initOpenAddressing();
+  else {
+    table = new (std::nothrow) GenericHashEntry*[num_hashes];
+    for(u_int i = 0; i < num_hashes; i++)
+      table[i] = NULL;
 
-  table = new (std::nothrow) GenericHashEntry*[num_hashes];
-  for(u_int i = 0; i < num_hashes; i++)
-    table[i] = NULL;
+    num_locks = num_hashes;
+  }
 
-  locks = new (std::nothrow) RwLock*[num_hashes];
-  for(u_int i = 0; i < num_hashes; i++) locks[i] = new (std::nothrow) RwLock();
+  locks = new (std::nothrow) RwLock*[num_locks];
+  for(u_int i = 0; i < num_locks; i++) locks[i] = new (std::nothrow) RwLock();
 
   idle_entries_in_use = new (std::nothrow) vector<GenericHashEntry*>;
 
-  last_purged_hash = _num_hashes - 1;
+  /* Walks and purges proceed by bucket (chaining) or by stripe (open addressing) */
+  purge_step = max_val(num_locks / PURGE_FRACTION, 1);
+  last_purged_hash = num_locks - 1;
+
+  housekeeping = NULL;
+  initPartitions();
+}
+
+/* ************************************ */
+
+void GenericHash::initOpenAddressing() {
+  u_int32_t min_num_slots = (u_int32_t)(max_hash_size / HASH_STRIPE_MAX_LOAD);
+
+  num_stripes = max_val((min_num_slots + HASH_STRIPE_NUM_SLOTS - 1) / HASH_STRIPE_NUM_SLOTS, 1);
+  num_locks = num_stripes;
+
+  stripes = new (std::nothrow) HashStripe[num_stripes];
+
+  for(u_int i = 0; i < num_stripes; i++) {
+    stripes[i].tags = (u_int8_t*)calloc(HASH_STRIPE_NUM_SLOTS, sizeof(u_int8_t)); /* HASH_SLOT_EMPTY */
+    stripes[i].slots = (GenericHashEntry**)calloc(HASH_STRIPE_NUM_SLOTS, sizeof(GenericHashEntry*));
+    stripes[i].num_used = stripes[i].num_deleted = 0;
+  }
+
+#ifdef WALK_DEBUG
+  ntop->getTrace()->traceEvent(TRACE_NORMAL, "[%s] Open addressing [stripes: %u][slots: %u][group: %u]",
+			       name, num_stripes, num_stripes * HASH_STRIPE_NUM_SLOTS, HASH_GROUP_NUM_SLOTS);
+#endif
 }
 
 /* ************************************ */
 
 GenericHash::~GenericHash() {
+  if(housekeeping)
+    housekeeping->unregisterHash(this); /* Waits for the workers walking the table */
+
   cleanup();
 
-  delete[] table;
+  if(table) delete[] table;
+
+  if(stripes) {
+    for(u_int i = 0; i < num_stripes; i++) {
+      free(stripes[i].tags);
+      free(stripes[i].slots);
+    }
+
+    delete[] stripes;
+  }
 
-  for(u_int i = 0; i < num_hashes; i++) delete(locks[i]);
+  for(u_int i = 0; i < num_locks; i++) delete(locks[i]);
   delete[] locks;
   free(name);
 }
@@ -83,7 +191,20 @@ void GenericHash::cleanup() {
     }
   }
 
-  for(u_int i = 0; i < num_hashes; i++) {
+  if(stripes) {
+    for(u_int i = 0; i < num_stripes; i++) {
+      HashStripe *s = &stripes[i];
+
+      for(u_int j = 0; j < HASH_STRIPE_NUM_SLOTS; j++) {
+	if(s->slots[j]) delete(s->slots[j]);
+	s->slots[j] = NULL, s->tags[j] = HASH_SLOT_EMPTY;
+      }
+
+      s->num_used = s->num_deleted = 0;
+    }
+  }
+
+  for(u_int i = 0; table && (i < num_hashes); i++) {
     if(table[i] != NULL) {
       GenericHashEntry *head = table[i];
 
@@ -104,6 +225,11 @@ void GenericHash::cleanup() {
 /* ************************************ */
 
 bool GenericHash::add(GenericHashEntry *h, bool do_lock) {
+  if(housekeeping) do_lock = true; /* Concurrently walked by the housekeeping workers */
+
+  if(engine == hash_table_engine_open_addressing)
+    return(addOpenAddressing(h, do_lock));
+
   if(hasEmptyRoom()) {
     u_int32_t hash = (h->key() % num_hashes);
 
@@ -111,7 +237,7 @@ bool GenericHash::add(GenericHashEntry *h, bool do_lock) {
       locks[hash]->wrlock(__FILE__, __LINE__);
 
     h->set_hash_table(this);
-    h->set_hash_entry_id(last_entry_id++);
+    h->set_hash_entry_id(nextEntryId());
     h->set_next(table[hash]);
     table[hash] = h;
     current_size++;
@@ -126,6 +252,149 @@ bool GenericHash::add(GenericHashEntry *h, bool do_lock) {
 
 /* ************************************ */
 
+/*
+  Rebuilds the stripe dropping all the tombstones. Must be called with the stripe
+  write-locked (or inline when no other thread can access the stripe).
+*/
+void GenericHash::compactStripe(HashStripe *s) {
+  GenericHashEntry *entries[HASH_STRIPE_NUM_SLOTS];
+  u_int32_t num_entries = 0;
+
+  for(u_int i = 0; i < HASH_STRIPE_NUM_SLOTS; i++) {
+    if(isFingerprint(s->tags[i]) && s->slots[i])
+      entries[num_entries++] = s->slots[i];
+  }
+
+  memset(s->tags, HASH_SLOT_EMPTY, HASH_STRIPE_NUM_SLOTS);
+  memset(s->slots, 0, HASH_STRIPE_NUM_SLOTS * sizeof(GenericHashEntry*));
+
+  for(u_int i = 0; i < num_entries; i++) {
+    u_int32_t h = mixKey(entries[i]->key()), group = firstGroup(h);
+
+    /* There's always an empty slot as the stripe held num_entries entries */
+    while(true) {
+      u_int32_t empty = matchGroup(&s->tags[group * HASH_GROUP_NUM_SLOTS], HASH_SLOT_EMPTY);
+
+      if(empty) {
+	u_int32_t slot = group * HASH_GROUP_NUM_SLOTS + __builtin_ctz(empty);
+
+	s->slots[slot] = entries[i], s->tags[slot] = keyTag(h);
+	break;
+      }
+
+      group = (group + 1) % HASH_STRIPE_NUM_GROUPS;
+    }
+  }
+
+  s->num_used = num_entries, s->num_deleted = 0;
+}
+
+/* ************************************ */
+
+bool GenericHash::addOpenAddressing(GenericHashEntry *h, bool do_lock) {
+  u_int32_t hk, stripe_id, group;
+  HashStripe *s;
+  bool rc = false;
+
+  if(!hasEmptyRoom())
+    return(false);
+
+  hk = mixKey(h->key()), stripe_id = hk % num_stripes, group = firstGroup(hk);
+  s = &stripes[stripe_id];
+
+  if(do_lock)
+    locks[stripe_id]->wrlock(__FILE__, __LINE__);
+
+  if((s->num_used + s->num_deleted) >= (HASH_STRIPE_NUM_SLOTS - HASH_GROUP_NUM_SLOTS)
+     && (s->num_deleted > 0)) {
+    /* Almost no empty slot left: reclaim the tombstones. When inline,
+       readers from other threads must be excluded before moving entries. */
+    if(do_lock || locks[stripe_id]->trywrlock(__FILE__, __LINE__)) {
+      compactStripe(s);
+
+      if(!do_lock) locks[stripe_id]->unlock(__FILE__, __LINE__);
+    }
+  }
+
+  if(s->num_used < HASH_STRIPE_NUM_SLOTS) {
+    for(u_int i = 0; i < HASH_STRIPE_NUM_GROUPS; i++) {
+      u_int8_t *tags = &s->tags[group * HASH_GROUP_NUM_SLOTS];
+      u_int32_t free_slots = matchGroup(tags, HASH_SLOT_EMPTY) | matchGroup(tags, HASH_SLOT_DELETED);
+
+      if(free_slots) {
+	u_int32_t slot = group * HASH_GROUP_NUM_SLOTS + __builtin_ctz(free_slots);
+
+	if(s->tags[slot] == HASH_SLOT_DELETED) s->num_deleted--;
+
+	h->set_hash_table(this);
+	h->set_hash_entry_id(nextEntryId());
+
+	/* Publish the entry before its tag so lock-free inline readers never see a dangling slot */
+	s->slots[slot] = h;
+	__atomic_store_n(&s->tags[slot], keyTag(hk), __ATOMIC_RELEASE);
+	s->num_used++, current_size++;
+	rc = true;
+	break;
+      }
+
+      group = (group + 1) % HASH_STRIPE_NUM_GROUPS;
+    }
+  }
+
+  if(do_lock)
+    locks[stripe_id]->unlock(__FILE__, __LINE__);
+
+  return(rc);
+}
+
+/* ************************************ */
+
+GenericHashEntry* GenericHash::lookupOpenAddressing(u_int32_t key,
+						    bool (*matches)(GenericHashEntry *h, void *user_data),
+						    void *user_data, bool do_lock, bool inc_uses) {
+  u_int32_t hk = mixKey(key), stripe_id = hk % num_stripes, group = firstGroup(hk);
+  u_int8_t tag = keyTag(hk);
+  HashStripe *s = &stripes[stripe_id];
+  GenericHashEntry *ret = NULL;
+
+  if(s->num_used == 0)
+    return(NULL);
+
+  if(do_lock)
+    locks[stripe_id]->rdlock(__FILE__, __LINE__);
+
+  for(u_int i = 0; (i < HASH_STRIPE_NUM_GROUPS) && (ret == NULL); i++) {
+    const u_int8_t *tags = &s->tags[group * HASH_GROUP_NUM_SLOTS];
+    u_int32_t candidates = matchGroup(tags, tag);
+
+    while(candidates) {
+      GenericHashEntry *e = s->slots[group * HASH_GROUP_NUM_SLOTS + __builtin_ctz(candidates)];
+
+      if(e && matches(e, user_data)) {
+	ret = e;
+	break;
+      }
+
+      candidates &= candidates - 1;
+    }
+
+    if(matchGroup(tags, HASH_SLOT_EMPTY))
+      break; /* The probe sequence ends at the first group with an empty slot */
+
+    group = (group + 1) % HASH_STRIPE_NUM_GROUPS;
+  }
+
+  if(ret && inc_uses)
+    ret->incUses();
+
+  if(do_lock)
+    locks[stripe_id]->unlock(__FILE__, __LINE__);
+
+  return(ret);
+}
+
+/* ************************************ */
+
 u_int64_t GenericHash::purgeQueuedIdleEntries() {
   vector<GenericHashEntry*> *cur_idle = NULL;
   u_int64_t num_purged = entry_state_transition_counters.num_purged;
@@ -199,6 +468,9 @@ bool GenericHash::walk(u_int32_t *begin_slot,
   bool found = false;
   u_int16_t tot_matched = 0;
 
+  if(engine == hash_table_engine_open_addressing)
+    return(walkOpenAddressing(begin_slot, walk_all, walker, user_data));
+
   for(u_int hash_id = *begin_slot; hash_id < num_hashes; hash_id++) {
     if(table[hash_id] != NULL) {
       GenericHashEntry *head;
@@ -265,19 +537,255 @@ bool GenericHash::walk(u_int32_t *begin_slot,
 
 /* ************************************ */
 
+bool GenericHash::walkOpenAddressing(u_int32_t *begin_slot,
+				     bool walk_all,
+				     bool (*walker)(GenericHashEntry *h, void *user_data, bool *entryMatched),
+				     void *user_data) {
+  bool found = false;
+  u_int16_t tot_matched = 0;
+
+  /* Same semantic of walk() with begin_slot being a stripe index */
+  for(u_int stripe_id = *begin_slot; stripe_id < num_stripes; stripe_id++) {
+    HashStripe *s = &stripes[stripe_id];
+
+    if(s->num_used == 0)
+      continue;
+
+    locks[stripe_id]->rdlock(__FILE__, __LINE__);
+
+    for(u_int i = 0; i < HASH_STRIPE_NUM_SLOTS; i++) {
+      GenericHashEntry *head = s->slots[i];
+
+      if(head && isFingerprint(s->tags[i]) && !head->idle()) {
+	bool matched = false;
+	bool rc = walker(head, user_data, &matched);
+
+	if(matched) tot_matched++;
+
+	if(rc) {
+	  found = true;
+	  break;
+	}
+      }
+    }
+
+    locks[stripe_id]->unlock(__FILE__, __LINE__);
+
+    if((tot_matched >= MIN_NUM_HASH_WALK_ELEMS) /* At least a few entries have been returned */
+       && (!walk_all)) {
+      *begin_slot = (stripe_id == (num_stripes-1)) ? 0 /* start over */ : (stripe_id+1);
+      return(found);
+    }
+
+    if(found)
+      break;
+  }
+
+  if(!found)
+    *begin_slot = 0 /* start over */;
+
+  return(found);
+}
+
+/* ************************************ */
+
 /*
   Bucket Lifecycle
 
   Active -> Idle -> Ready to be Purged -> Purged
 */
 
+/*
+  Runs the periodic activities on an entry found in the table, with its bucket
+  locked. Returns true when the entry has to be detached from the table and idled.
+*/
+bool GenericHash::housekeepEntry(GenericHashEntry *head, const struct timeval *tv, time_t now,
+				 bool force_idle) {
+  HashEntryState head_state = head->get_state();
+
+  head->periodic_stats_update(tv);
+
+  switch(head_state) {
+  case hash_entry_state_idle:
+    /* As an idle entry is always removed immediately from the hash table
+       This walk should never find any such entry */
+    ntop->getTrace()->traceEvent(TRACE_ERROR, "Unexpected state found [%u]", head_state);
+    break;
+
+  case hash_entry_state_allocated:
+    /* TCP flows with 3WH not yet completed (or collected with no TCP flags) fall here */
+    /* Don't break */
+  case hash_entry_state_flow_notyetdetected:
+    /* UDP flows or TCP flows for which the 3WH is completed but protocol hasn't been detected yet */
+    /* Don't break  */
+  case hash_entry_state_flow_protocoldetected:
+    head->housekeep(now);
+
+    if(head_state == hash_entry_state_flow_protocoldetected)
+      /*
+	Transition to active if the protocol is detected
+      */
+      head->set_hash_entry_state_active();
+
+    if(force_idle) return(true);
+    break;
+
+  case hash_entry_state_active:
+    if(force_idle
+       || (
+	   iface->is_purge_idle_interface()
+	   && head->is_hash_entry_state_idle_transition_ready()
+	   ))
+      return(true); /* Found entry to purge */
+
+    /* If there hasn't been an active->idle transition, and thus head hasn't been detached,
+       it is safe to execute housekeep. This function is executed also for idle entries below. */
+    head->housekeep(now);
+    break;
+  } /* switch */
+
+  return(false);
+}
+
+/* ************************************ */
+
+/*
+  Walks bucket (chaining) or stripe (open addressing) i, running the periodic
+  activities on its entries. Entries to be idled are detached from the table
+  and appended to detached. Returns the number of detached entries.
+*/
+u_int GenericHash::purgeBucket(u_int i, const struct timeval *tv, time_t now, bool force_idle,
+			       vector<GenericHashEntry*> *detached, u_int *buckets_checked) {
+  u_int num_detached = 0;
+
+  if(engine == hash_table_engine_open_addressing) {
+    HashStripe *s = &stripes[i];
+
+    if(s->num_used == 0)
+      return(0);
+
+    if(!locks[i]->trywrlock(__FILE__, __LINE__))
+      return(0); /* Busy, will retry next round */
+
+    for(u_int slot = 0; slot < HASH_STRIPE_NUM_SLOTS; slot++) {
+      GenericHashEntry *head = s->slots[slot];
+
+      if(!head || !isFingerprint(s->tags[slot]))
+	continue;
+
+      (*buckets_checked)++;
+
+      if(housekeepEntry(head, tv, now, force_idle)) {
+	u_int8_t *group = &s->tags[(slot / HASH_GROUP_NUM_SLOTS) * HASH_GROUP_NUM_SLOTS];
+
+	detached->push_back(head);
+
+	/* If the group already has an empty slot no probe sequence goes
+	   past it, hence the slot can be emptied with no tombstone */
+	if(matchGroup(group, HASH_SLOT_EMPTY))
+	  s->tags[slot] = HASH_SLOT_EMPTY;
+	else
+	  s->tags[slot] = HASH_SLOT_DELETED, s->num_deleted++;
+
+	s->slots[slot] = NULL;
+	s->num_used--;
+	num_detached++, current_size--;
+      }
+    }
+
+    /* Keep probe sequences short */
+    if(s->num_deleted > (HASH_STRIPE_NUM_SLOTS / 4))
+      compactStripe(s);
+
+    locks[i]->unlock(__FILE__, __LINE__);
+  } else if(table[i] != NULL) {
+    GenericHashEntry *head, *prev = NULL;
+
+    // ntop->getTrace()->traceEvent(TRACE_NORMAL, "[purge] Locking %d", i);
+    if(!locks[i]->trywrlock(__FILE__, __LINE__))
+      return(0); /* Busy, will retry next round */
+
+    head = table[i];
+
+    while(head) {
+      GenericHashEntry *next = head->next();
+
+      (*buckets_checked)++;
+
+      if(housekeepEntry(head, tv, now, force_idle)) {
+	detached->push_back(head); /* Found entry to purge */
+
+	if(!prev)
+	  table[i] = next;
+	else
+	  prev->set_next(next);
+
+	num_detached++, current_size--;
+	head = next;
+	continue;
+      }
+
+      prev = head;
+      head = next;
+    } /* while */
+
+    locks[i]->unlock(__FILE__, __LINE__);
+  }
+
+  return(num_detached);
+}
+
+/* ************************************ */
+
 u_int GenericHash::purgeIdle(const struct timeval * tv, bool force_idle, bool full_scan) {
   u_int i, num_detached = 0, buckets_checked = 0;
   time_t now = time(NULL);
   /* Visit all entries when force_idle is true */
-  u_int visit_fraction = (!force_idle && !full_scan) ? purge_step : num_hashes;
+  u_int visit_fraction = (!force_idle && !full_scan) ? purge_step : num_locks;
   size_t idle_entries_shadow_old_size;
   vector<GenericHashEntry*>::const_iterator it;
+  u_int64_t begin_usec;
+
+  if(housekeeping) {
+    if(!force_idle && !full_scan) {
+      bool busy = false;
+
+      /*
+	Complete the rounds walked by the housekeeping workers and publish the
+	next ones, never wait for them
+      */
+      for(u_int8_t p = 0; p < num_hk_partitions; p++) {
+	HousekeepingPartition *hp = &hk_partitions[p];
+	u_int8_t state = hp->state.load();
+
+	if(((state == housekeeping_partition_idle) || (state == housekeeping_partition_walked))
+	   && hp->state.compare_exchange_strong(state, housekeeping_partition_publishing)) {
+	  if(state == housekeeping_partition_walked)
+	    num_detached += completePartition(hp);
+
+	  hp->tv = *tv;
+	  hp->state.store(housekeeping_partition_pending);
+	} else
+	  busy = true; /* Previous round still pending or running */
+      }
+
+      /* An overrun lasts until all the partitions can be published again: count it once */
+      if(busy && !hk_overrun)
+	walk_stats.num_overruns++;
+
+      hk_overrun = busy;
+
+      housekeeping->notify();
+      return(num_detached);
+    }
+
+    /* Forced and full scans are performed inline, with the workers kept out */
+    claimPartitions();
+  }
+
+  begin_usec = Utils::monotonicUsec();
+
+  idle_entries_lock.lock(__FILE__, __LINE__);
 
   if(!idle_entries) {
     idle_entries = idle_entries_shadow;
@@ -286,6 +794,8 @@ u_int GenericHash::purgeIdle(const struct timeval * tv, bool force_idle, bool fu
       idle_entries_shadow = new vector<GenericHashEntry*>;
 
     } catch(std::bad_alloc& ba) {
+      idle_entries_lock.unlock(__FILE__, __LINE__);
+      if(housekeeping) releasePartitions();
       ntop->getTrace()->traceEvent(TRACE_ERROR, "Memory allocation error");
       return 0;
     }
@@ -301,7 +811,8 @@ u_int GenericHash::purgeIdle(const struct timeval * tv, bool force_idle, bool fu
   /* Visit at least MIN_NUM_VISITED_ENTRIES entries at each iteration regardless of the hash size */
   u_int j;
 
-  for(j = 0; j < num_hashes; j++) {
+  /* j iterates over buckets (chaining) or stripes (open addressing) */
+  for(j = 0; j < num_locks; j++) {
     /*
       Initially visit the visit_fraction of the hash, but if we have
       visited too few elements we keep visiting until a minimum number
@@ -312,88 +823,15 @@ u_int GenericHash::purgeIdle(const struct timeval * tv, bool force_idle, bool fu
         (j > visit_fraction && buckets_checked > MIN_NUM_VISITED_ENTRIES)))
       break;
 
-    if(++last_purged_hash == num_hashes) last_purged_hash = 0;
+    if(++last_purged_hash == num_locks) last_purged_hash = 0;
     i = last_purged_hash;
 
-    if(table[i] != NULL) {
-      GenericHashEntry *head, *prev = NULL;
-
-      // ntop->getTrace()->traceEvent(TRACE_NORMAL, "[purge] Locking %d", i);
-      if(!locks[i]->trywrlock(__FILE__, __LINE__))
-	continue; /* Busy, will retry next round */
-
-      head = table[i];
-
-      while(head) {
-	HashEntryState head_state = head->get_state();
-	GenericHashEntry *next = head->next();
-
-	head->periodic_stats_update(tv);
-
-	buckets_checked++;
-
-	switch(head_state) {
-	case hash_entry_state_idle:
-	  /* As an idle entry is always removed immediately from the hash table
-	     This walk should never find any such entry */
-	  ntop->getTrace()->traceEvent(TRACE_ERROR, "Unexpected state found [%u]", head_state);
-	  break;
-
-	case hash_entry_state_allocated:
-	  /* TCP flows with 3WH not yet completed (or collected with no TCP flags) fall here */
-	  /* Don't break */
-	case hash_entry_state_flow_notyetdetected:
-	  /* UDP flows or TCP flows for which the 3WH is completed but protocol hasn't been detected yet */
-	  /* Don't break  */
-	case hash_entry_state_flow_protocoldetected:
-	  head->housekeep(now);
-
-	  if(head_state == hash_entry_state_flow_protocoldetected)
-	    /*
-	      Transition to active if the protocol is detected
-	     */
-	    head->set_hash_entry_state_active();
-
-	  if(force_idle) goto detach_idle_hash_entry;
-	  break;
-
-	case hash_entry_state_active:
-	  if(
-	     force_idle
-	     || (
-		 iface->is_purge_idle_interface()
-		 && head->is_hash_entry_state_idle_transition_ready())
-	     ) {
-	  detach_idle_hash_entry:
-	    idle_entries_shadow->push_back(head); /* Found entry to purge */
-
-	    if(!prev)
-	      table[i] = next;
-	    else
-	      prev->set_next(next);
-
-	    num_detached++, current_size--;
-	    head = next;
-	    continue;
-	  }
-
-	  /* If there hasn't been an active->idle transition, and thus head hasn't been detached,
-	     it is safe to execute housekeep. This function is executed also for idle entries below. */
-	  head->housekeep(now);
-	  break;
-	} /* switch */
-
-	prev = head;
-	head = next;
-      } /* while */
-
-      locks[i]->unlock(__FILE__, __LINE__);
-    }
+    num_detached += purgeBucket(i, tv, now, force_idle, idle_entries_shadow, &buckets_checked);
   }
 
 #ifdef WALK_DEBUG
   ntop->getTrace()->traceEvent(TRACE_NORMAL, "[%s][current_size: %u][visit_fraction: %u/%u (visited %u)][buckets_checked: %u]",
-			       name, current_size, visit_fraction, num_hashes, j, buckets_checked);
+			       name, (u_int32_t)current_size, visit_fraction, num_locks, j, buckets_checked);
 #endif
 
   /* Actual idling can be performed when the hash table is no longer locked. */
@@ -409,18 +847,188 @@ u_int GenericHash::purgeIdle(const struct timeval * tv, bool force_idle, bool fu
     }
   }
 
+  idle_entries_lock.unlock(__FILE__, __LINE__);
+
 #ifdef WALK_DEBUG
   if(/* (num_detached > 0) && */ (!strcmp(name, "FlowHash")))
     ntop->getTrace()->traceEvent(TRACE_NORMAL,
 				 "[%s @ %s] purgeIdle() [num_detached: %u][num_checked: %u][end index: %u][current_size: %u][visit_fraction: %u]",
-				 name, iface->get_name(), num_detached, buckets_checked, last_purged_hash, current_size, visit_fraction);
+				 name, iface->get_name(), num_detached, buckets_checked, last_purged_hash, (u_int32_t)current_size, visit_fraction);
 #endif
 
+  updateWalkStats(begin_usec, buckets_checked);
+
+  if(housekeeping)
+    releasePartitions();
+
   return(num_detached);
 }
 
 /* ************************************ */
 
+void GenericHash::initPartitions() {
+  num_hk_partitions = (u_int8_t)min_val(HOUSEKEEPING_NUM_PARTITIONS, num_locks);
+
+  for(u_int8_t p = 0; p < num_hk_partitions; p++) {
+    HousekeepingPartition *hp = &hk_partitions[p];
+
+    hp->state.store(housekeeping_partition_idle);
+    hp->begin = (u_int32_t)(((u_int64_t)num_locks * p) / num_hk_partitions);
+    hp->end = (u_int32_t)(((u_int64_t)num_locks * (p + 1)) / num_hk_partitions);
+    hp->last_purged = hp->end - 1;
+    memset(&hp->tv, 0, sizeof(hp->tv));
+  }
+
+  hk_overrun = false;
+  walk_stats.num_walks = walk_stats.num_visited = 0;
+  walk_stats.walk_usec = walk_stats.max_walk_usec = walk_stats.num_overruns = 0;
+}
+
+/* ************************************ */
+
+/* Waits for the running partitions and keeps the workers out until releasePartitions() */
+void GenericHash::claimPartitions() {
+  for(u_int8_t p = 0; p < num_hk_partitions; p++) {
+    HousekeepingPartition *hp = &hk_partitions[p];
+
+    while(true) {
+      u_int8_t state = hp->state.load();
+
+      if((state == housekeeping_partition_running) || (state == housekeeping_partition_publishing))
+	_usleep(1000);
+      else if(hp->state.compare_exchange_strong(state, housekeeping_partition_running)) {
+	/* Pending rounds are dropped, the inline walk supersedes them. Walked
+	   rounds still have to hand over the entries they have detached */
+	if(state == housekeeping_partition_walked)
+	  completePartition(hp);
+
+	break;
+      }
+    }
+  }
+}
+
+/* ************************************ */
+
+void GenericHash::releasePartitions() {
+  for(u_int8_t p = 0; p < num_hk_partitions; p++)
+    hk_partitions[p].state.store(housekeeping_partition_idle);
+}
+
+/* ************************************ */
+
+void GenericHash::setHousekeepingEngine(HousekeepingEngine *hk) {
+  if(housekeeping && !hk)
+    claimPartitions(); /* Make sure no worker is still walking the table */
+
+  housekeeping = hk;
+  releasePartitions();
+}
+
+/* ************************************ */
+
+bool GenericHash::runHousekeeping() {
+  for(u_int8_t p = 0; p < num_hk_partitions; p++) {
+    HousekeepingPartition *hp = &hk_partitions[p];
+    u_int8_t state = housekeeping_partition_pending;
+
+    if(hp->state.compare_exchange_strong(state, housekeeping_partition_running)) {
+      purgeIdlePartition(hp);
+      hp->state.store(housekeeping_partition_walked); /* Completed by the next purgeIdle() */
+      return(true);
+    }
+  }
+
+  return(false);
+}
+
+/* ************************************ */
+
+/*
+  Same walk as purgeIdle(), restricted to the buckets of the partition.
+  Runs concurrently with the other partitions of the table: the periodic
+  activities are performed with the bucket locked, as the entries are then
+  out of reach of the lookups and of the walkers. The detached entries are
+  idled here too, and then handed to the purge by completePartition().
+*/
+void GenericHash::purgeIdlePartition(HousekeepingPartition *hp) {
+  u_int32_t span = hp->end - hp->begin;
+  u_int visit_fraction = max_val(span / PURGE_FRACTION, 1);
+  u_int min_visited = MIN_NUM_VISITED_ENTRIES / num_hk_partitions;
+  u_int max_visited = upper_num_visited_entries / num_hk_partitions;
+  u_int buckets_checked = 0;
+  time_t now = time(NULL);
+  u_int64_t begin_usec = Utils::monotonicUsec();
+
+  for(u_int j = 0; j < span; j++) {
+    if(buckets_checked > max_visited
+       || (j > visit_fraction && buckets_checked > min_visited))
+      break;
+
+    if(++hp->last_purged == hp->end) hp->last_purged = hp->begin;
+
+    purgeBucket(hp->last_purged, &hp->tv, now, false, &hp->detached, &buckets_checked);
+  }
+
+  /* Detached entries are no longer reachable through the table: idle them with no lock held, as purgeIdle() does */
+  for(vector<GenericHashEntry*>::const_iterator it = hp->detached.begin(); it != hp->detached.end(); it++) {
+    (*it)->set_hash_entry_state_idle();
+    /* Now that the entry has been set to idle, housekeep can executed one last time */
+    (*it)->housekeep(now);
+  }
+
+  updateWalkStats(begin_usec, buckets_checked);
+}
+
+/* ************************************ */
+
+/*
+  Completes a round walked by a housekeeping worker, on the thread owning the
+  table: the entries detached and idled by the worker are handed to the thread
+  deleting them. Returns the number of entries idled.
+*/
+u_int GenericHash::completePartition(HousekeepingPartition *hp) {
+  u_int num_idled = hp->detached.size();
+
+  if(num_idled == 0)
+    return(0);
+
+  idle_entries_lock.lock(__FILE__, __LINE__);
+
+  if(!idle_entries) {
+    vector<GenericHashEntry*> *shadow = new (std::nothrow) vector<GenericHashEntry*>;
+
+    if(shadow)
+      idle_entries = idle_entries_shadow, idle_entries_shadow = shadow;
+  }
+
+  idle_entries_shadow->insert(idle_entries_shadow->end(), hp->detached.begin(), hp->detached.end());
+  entry_state_transition_counters.num_idle_transitions += num_idled;
+
+  idle_entries_lock.unlock(__FILE__, __LINE__);
+
+  hp->detached.clear();
+
+  return(num_idled);
+}
+
+/* ************************************ */
+
+void GenericHash::updateWalkStats(u_int64_t begin_usec, u_int visited) {
+  u_int64_t elapsed = Utils::monotonicUsec() - begin_usec;
+  u_int64_t cur_max = walk_stats.max_walk_usec;
+
+  walk_stats.num_walks++;
+  walk_stats.num_visited += visited;
+  walk_stats.walk_usec += elapsed;
+
+  while((elapsed > cur_max)
+	&& !walk_stats.max_walk_usec.compare_exchange_weak(cur_max, elapsed))
+    ;
+}
+
+/* ************************************ */
+
 u_int32_t GenericHash::getNumIdleEntries() const {
   return(ndpi_max(0, entry_state_transition_counters.num_idle_transitions - entry_state_transition_counters.num_purged));
 };
@@ -445,6 +1053,8 @@ void GenericHash::lua(lua_State *vm) {
   lua_newtable(vm);
 
   lua_push_uint64_table_entry(vm, "max_hash_size", (u_int64_t)max_hash_size);
+  lua_push_str_table_entry(vm, "engine",
+			   (engine == hash_table_engine_open_addressing) ? "open_addressing" : "chaining");
 
   /* Hash Entry states */
   lua_newtable(vm);
@@ -472,6 +1082,35 @@ void GenericHash::lua(lua_State *vm) {
   lua_insert(vm, -2);
   lua_settable(vm, -3);
 
+  /* Periodic walks (purgeIdle), inline or by the housekeeping workers */
+  lua_newtable(vm);
+
+  lua_push_bool_table_entry(vm, "offloaded", housekeeping != NULL);
+  lua_push_uint64_table_entry(vm, "num_walks", walk_stats.num_walks);
+  lua_push_uint64_table_entry(vm, "num_visited", walk_stats.num_visited);
+  lua_push_uint64_table_entry(vm, "tot_walk_usec", walk_stats.walk_usec);
+  lua_push_uint64_table_entry(vm, "max_walk_usec", walk_stats.max_walk_usec);
+  lua_push_uint64_table_entry(vm, "avg_walk_usec",
+			      walk_stats.num_walks ? (walk_stats.walk_usec / walk_stats.num_walks) : 0);
+  lua_push_uint64_table_entry(vm, "visited_per_sec",
+			      walk_stats.walk_usec ? ((walk_stats.num_visited * 1000000) / walk_stats.walk_usec) : 0);
+  lua_push_uint64_table_entry(vm, "num_overruns", walk_stats.num_overruns);
+
+  lua_pushstring(vm, "walks");
+  lua_insert(vm, -2);
+  lua_settable(vm, -3);
+
+  if(!pools.empty()) {
+    lua_newtable(vm);
+
+    for(std::vector<ObjectPool*>::iterator it = pools.begin(); it != pools.end(); ++it)
+      (*it)->lua(vm);
+
+    lua_pushstring(vm, "pools");
+    lua_insert(vm, -2);
+    lua_settable(vm, -3);
+  }
+
   lua_pushstring(vm, name ? name : "");
   lua_insert(vm, -2);
   lua_settable(vm, -3);
@@ -1314,11 +1314,16 @@ static int handle_lua_request(struct mg_connection *conn) {
 
     if(found) {
       LuaEngine *l;
+      LuaEnginePool *pool = ntop->get_HTTPserver() ? ntop->get_HTTPserver()->getLuaEnginePool() : NULL;
+      struct timeval begin, end;
+      bool reused = false;
 
       ntop->getTrace()->traceEvent(TRACE_INFO, "[HTTP] %s [%s]", request_info->uri, path);
 
+      gettimeofday(&begin, NULL);
+
       try {
-	l = new LuaEngine(NULL);
+	l = pool ? pool->get(&reused) : new LuaEngine(NULL);
       } catch(std::bad_alloc& ba) {
 	ntop->getTrace()->traceEvent(TRACE_ERROR, "[HTTP] Unable to start Lua interpreter.");
 	if(original_uri) request_info->uri  = original_uri;
@@ -1329,7 +1334,8 @@ static int handle_lua_request(struct mg_connection *conn) {
       bool attack_attempt;
 
       // NOTE: username is stored into the engine context, so we must guarantee
-      // that LuaEngine is destroyed after username goes out of context! Indeeed we delete LuaEngine below.
+      // that LuaEngine is destroyed (or its context reset when returned to the pool)
+      // after username goes out of context! Indeeed we release LuaEngine below.
       l->handle_script_request(conn, request_info, path, &attack_attempt, username, group, csrf, localuser);
 
       if(attack_attempt) {
@@ -1340,7 +1346,12 @@ static int handle_lua_request(struct mg_connection *conn) {
 				     request_info->uri);
       }
 
-      delete l;
+      if(pool) {
+	gettimeofday(&end, NULL);
+	pool->release(l, reused, request_info->uri, (u_int32_t)Utils::msTimevalDiff(&end, &begin));
+      } else
+	delete l;
+
       if(original_uri) request_info->uri  = original_uri;
       return(1); /* Handled */
     }
@@ -1543,6 +1554,7 @@ HTTPserver::HTTPserver(const char *_docs_dir, const char *_scripts_dir) {
   httpd_v4 = NULL;
 
   cur_http_options = 0;
+  lua_engine_pool = new (std::nothrow) LuaEnginePool(HTTP_LUA_VM_POOL_SIZE);
 
   /* Silence  format-truncation warning */
 #pragma GCC diagnostic push
@@ -1704,6 +1716,7 @@ HTTPserver::~HTTPserver() {
   if(httpd_captive_v4) mg_stop(httpd_captive_v4);
 #endif
 
+  if(lua_engine_pool) delete lua_engine_pool; /* After mg_stop as no request is in progress */
   if(wispr_captive_data) free(wispr_captive_data);
   if(captive_redirect_addr) free(captive_redirect_addr);
   free(docs_dir), free(scripts_dir);
@@ -54,6 +54,10 @@ Host::~Host() {
      && (!iface->isView() || !ntop->getGlobals()->isShutdownRequested()))
     ntop->getTrace()->traceEvent(TRACE_WARNING, "Internal error: num_uses=%u", getUses());
 
+  /* Hosts in the checks wheel hold no reference: never leave a dangling one there */
+  if(areChecksScheduled() && ntop->getHostChecksScheduler())
+    ntop->getHostChecksScheduler()->unschedule(this);
+
   // ntop->getTrace()->traceEvent(TRACE_NORMAL, "Deleting %s (%s)", k, localHost ? "local": "remote");
 
   if(mac)           mac->decUses();
@@ -169,12 +173,19 @@ void Host::updateSynAckAlertsCounter(time_t when, bool synack_sent) {
   so it must be ultra-fast. Do NOT perform any time-consuming operation here.
  */
 void Host::housekeep(time_t t) {  
+  HostChecksScheduler *scheduler = ntop->getHostChecksScheduler();
+
   switch(get_state()) {
   case hash_entry_state_active:
-    iface->execHostChecks(this);
+    /* Checks are run by the scheduler workers, inline only when it is not available (e.g., shutdown) */
+    if(!areChecksScheduled() && !(scheduler && scheduler->schedule(this)))
+      iface->execHostChecks(this);
     break;
   case hash_entry_state_idle:
+    if(scheduler) scheduler->unschedule(this);
+    lockChecks();
     releaseAllEngagedAlerts();
+    unlockChecks();
     break;
   default:
     break;
@@ -1071,7 +1082,7 @@ void Host::periodic_stats_update(const struct timeval *tv) {
     char buf[64];
     
     ntop->getTrace()->traceEvent(TRACE_NORMAL, "%s: %u",
-				 ip.print(buf, sizeof(buf)), num_incomplete_flows);
+				 ip.print(buf, sizeof(buf)), num_incomplete_flows.load());
   }
 #endif
   
@@ -1585,8 +1596,13 @@ void Host::checkStatsReset() {
 
   if(statsResetRequested()) {
     HostStats *new_stats = allocateStats();
+
+    /* The host checks use the stats: swap them in between (the old ones are deleted at the next call) */
+    lockChecks();
     stats_shadow = stats;
     stats = new_stats;
+    unlockChecks();
+
     stats_shadow->resetTopSitesData();
     blacklistedStatsResetRequested();
     
@@ -0,0 +1,386 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#include "ntop_includes.h"
+
+/* ******************************************* */
+
+HostChecksScheduler::HostChecksScheduler() {
+  last_tick = 0;
+  started = stopping = false;
+  num_scheduled = 0;
+  num_executed = num_deferred = max_ready = 0;
+  memset(lag_histogram, 0, sizeof(lag_histogram));
+}
+
+/* ******************************************* */
+
+HostChecksScheduler::~HostChecksScheduler() {
+  shutdown();
+}
+
+/* ******************************************* */
+
+static void* tickerLoop(void *ptr) {
+  Utils::setThreadName("ntopng-hchk-tick");
+  ((HostChecksScheduler*)ptr)->tickerLoop();
+  return(NULL);
+}
+
+/* ******************************************* */
+
+typedef struct {
+  HostChecksScheduler *s;
+  u_int8_t worker_id;
+} host_checks_worker_arg_t;
+
+static void* workerLoop(void *ptr) {
+  host_checks_worker_arg_t *arg = (host_checks_worker_arg_t*)ptr;
+  HostChecksScheduler *s = arg->s;
+  u_int8_t worker_id = arg->worker_id;
+  char name[32];
+
+  delete arg;
+
+  snprintf(name, sizeof(name), "ntopng-hchk-%u", worker_id);
+  Utils::setThreadName(name);
+  s->workerLoop(worker_id);
+
+  return(NULL);
+}
+
+/* ******************************************* */
+
+void HostChecksScheduler::start() {
+  if(started) return;
+
+  last_tick = time(NULL) - 1;
+
+  for(int i = 0; i < HOST_CHECKS_NUM_WORKERS; i++) {
+    host_checks_worker_arg_t *arg = new host_checks_worker_arg_t;
+
+    arg->s = this, arg->worker_id = i;
+    pthread_create(&workers[i], NULL, ::workerLoop, (void*)arg);
+  }
+
+  pthread_create(&ticker, NULL, ::tickerLoop, (void*)this);
+  started = true;
+}
+
+/* ******************************************* */
+
+void HostChecksScheduler::shutdown() {
+  m.lock(__FILE__, __LINE__);
+  stopping = true;
+  m.unlock(__FILE__, __LINE__);
+
+  if(started) {
+    ready_cond.signalAll();
+
+    pthread_join(ticker, NULL);
+    for(int i = 0; i < HOST_CHECKS_NUM_WORKERS; i++)
+      pthread_join(workers[i], NULL);
+
+    started = false;
+  }
+
+  /* Release the hosts still queued (only the ready ones hold a reference) */
+  m.lock(__FILE__, __LINE__);
+
+  for(int i = 0; i < HOST_CHECKS_WHEEL_SLOTS; i++) {
+    for(std::vector<host_checks_item_t>::iterator it = wheel[i].begin(); it != wheel[i].end(); ++it)
+      it->h->setChecksScheduled(false, 0);
+
+    wheel[i].clear();
+  }
+
+  for(std::deque<host_checks_item_t>::iterator it = ready.begin(); it != ready.end(); ++it)
+    it->h->setChecksScheduled(false, 0), it->h->decUses();
+
+  ready.clear();
+  num_scheduled = 0;
+
+  m.unlock(__FILE__, __LINE__);
+}
+
+/* ******************************************* */
+
+/* Must be called with m locked */
+void HostChecksScheduler::addToWheel(Host *h, time_t slot_time, time_t due) {
+  host_checks_item_t item;
+
+  item.h = h, item.due = due;
+  h->setChecksScheduled(true, slot_time);
+  wheel[slot_time % HOST_CHECKS_WHEEL_SLOTS].push_back(item);
+}
+
+/* ******************************************* */
+
+/* Must be called with m locked */
+void HostChecksScheduler::updateLag(time_t now, time_t due) {
+  u_int bucket = 0;
+
+  if(now > due) {
+    u_int32_t lag = (u_int32_t)(now - due);
+
+    for(bucket = 1; (lag >>= 1) && (bucket < HOST_CHECKS_LAG_BUCKETS - 1); bucket++)
+      ;
+  }
+
+  lag_histogram[bucket]++;
+}
+
+/* ******************************************* */
+
+bool HostChecksScheduler::schedule(Host *h) {
+  time_t now = time(NULL);
+  bool rc = false;
+
+  m.lock(__FILE__, __LINE__);
+
+  if(!stopping) {
+    if(!h->areChecksScheduled()) {
+      /* Spread the first run over a minute to avoid bursts when many hosts are created at once */
+      time_t due = now + 1 + (h->key() % 60);
+
+      addToWheel(h, due, due);
+      num_scheduled++;
+    }
+
+    rc = true;
+  }
+
+  m.unlock(__FILE__, __LINE__);
+
+  return(rc);
+}
+
+/* ******************************************* */
+
+void HostChecksScheduler::unschedule(Host *h) {
+  m.lock(__FILE__, __LINE__);
+
+  if(h->areChecksScheduled()) {
+    std::vector<host_checks_item_t> *slot = &wheel[h->getChecksDue() % HOST_CHECKS_WHEEL_SLOTS];
+
+    for(std::vector<host_checks_item_t>::iterator it = slot->begin(); it != slot->end(); ++it) {
+      if(it->h == h) {
+	*it = slot->back();
+	slot->pop_back();
+
+	h->setChecksScheduled(false, 0);
+	num_scheduled--;
+	break;
+      }
+    }
+
+    /*
+      Not in the wheel: the host is ready or being checked, hence it holds
+      a reference and the worker will release it as it is no longer active
+    */
+  }
+
+  m.unlock(__FILE__, __LINE__);
+}
+
+/* ******************************************* */
+
+/* Must be called with m locked */
+void HostChecksScheduler::tick(time_t now) {
+  u_int32_t budget = HOST_CHECKS_TICK_BUDGET;
+  time_t t = last_tick + 1;
+  std::vector<host_checks_item_t> deferred;
+
+  /* Don't loop more than a full wheel turn after clock jumps */
+  if(now - last_tick > HOST_CHECKS_WHEEL_SLOTS)
+    t = now - HOST_CHECKS_WHEEL_SLOTS + 1;
+
+  for(; t <= now; t++) {
+    std::vector<host_checks_item_t> *slot = &wheel[t % HOST_CHECKS_WHEEL_SLOTS];
+    std::vector<host_checks_item_t> later;
+
+    for(std::vector<host_checks_item_t>::iterator it = slot->begin(); it != slot->end(); ++it) {
+      if(it->h->getChecksDue() > now)
+	later.push_back(*it); /* Belongs to a future wheel turn */
+      else if(budget > 0) {
+	it->h->incUses(); /* Released by the worker */
+	ready.push_back(*it), budget--;
+      } else {
+	/* Out of budget: keep the original due time (lag), moved to the next second below */
+	deferred.push_back(*it);
+	num_deferred++;
+      }
+    }
+
+    slot->swap(later);
+  }
+
+  /*
+    Added once the slots have been walked: after a full wheel turn the slot
+    of the next second is one of them
+  */
+  for(std::vector<host_checks_item_t>::iterator it = deferred.begin(); it != deferred.end(); ++it)
+    addToWheel(it->h, now + 1, it->due);
+
+  last_tick = now;
+
+  if(ready.size() > max_ready)
+    max_ready = ready.size();
+}
+
+/* ******************************************* */
+
+void HostChecksScheduler::tickerLoop() {
+  while(true) {
+    time_t now = time(NULL);
+    bool has_ready;
+
+    m.lock(__FILE__, __LINE__);
+
+    if(stopping) {
+      m.unlock(__FILE__, __LINE__);
+      break;
+    }
+
+    if(now > last_tick)
+      tick(now);
+
+    has_ready = !ready.empty();
+
+    m.unlock(__FILE__, __LINE__);
+
+    if(has_ready)
+      ready_cond.signalAll();
+
+    sleep(1);
+  }
+}
+
+/* ******************************************* */
+
+void HostChecksScheduler::workerLoop(u_int8_t worker_id) {
+  host_checks_item_t batch[HOST_CHECKS_WORKER_BATCH];
+
+  while(true) {
+    u_int num = 0;
+    time_t now;
+
+    m.lock(__FILE__, __LINE__);
+
+    if(stopping) {
+      m.unlock(__FILE__, __LINE__);
+      break;
+    }
+
+    while((num < HOST_CHECKS_WORKER_BATCH) && !ready.empty()) {
+      batch[num++] = ready.front();
+      ready.pop_front();
+    }
+
+    m.unlock(__FILE__, __LINE__);
+
+    if(num == 0) {
+      struct timespec expiration;
+
+      expiration.tv_sec = time(NULL) + 1, expiration.tv_nsec = 0;
+      ready_cond.timedWait(&expiration);
+      continue;
+    }
+
+    now = time(NULL);
+
+    for(u_int i = 0; i < num; i++) {
+      Host *h = batch[i].h;
+
+      /* Serialized with the release of the engaged alerts done by Host::housekeep when idle */
+      h->lockChecks();
+
+      if(h->get_state() == hash_entry_state_active)
+	h->getInterface()->execHostChecks(h);
+
+      h->unlockChecks();
+    }
+
+    m.lock(__FILE__, __LINE__);
+
+    for(u_int i = 0; i < num; i++) {
+      Host *h = batch[i].h;
+
+      updateLag(now, batch[i].due);
+      num_executed++;
+
+      if(!stopping && (h->get_state() == hash_entry_state_active)) {
+	time_t next = h->getNextChecksTime();
+
+	if(next <= now) next = now + 1;
+	addToWheel(h, next, next);
+      } else {
+	h->setChecksScheduled(false, 0);
+	num_scheduled--;
+      }
+
+      /* From now on the host can go idle, which removes it from the wheel */
+      h->decUses();
+    }
+
+    m.unlock(__FILE__, __LINE__);
+  }
+}
+
+/* ******************************************* */
+
+void HostChecksScheduler::lua(lua_State *vm) {
+  m.lock(__FILE__, __LINE__);
+
+  lua_newtable(vm);
+
+  lua_push_uint32_table_entry(vm, "num_scheduled", num_scheduled);
+  lua_push_uint32_table_entry(vm, "num_ready", ready.size());
+  lua_push_uint64_table_entry(vm, "max_ready", max_ready);
+  lua_push_uint64_table_entry(vm, "num_executed", num_executed);
+  lua_push_uint64_table_entry(vm, "num_deferred", num_deferred);
+  lua_push_uint32_table_entry(vm, "num_workers", HOST_CHECKS_NUM_WORKERS);
+
+  /* Lag between the due time and the execution of the checks, buckets are in seconds (power of two) */
+  lua_newtable(vm);
+
+  for(int i = 0; i < HOST_CHECKS_LAG_BUCKETS; i++) {
+    char key[16];
+
+    if(i == 0)
+      snprintf(key, sizeof(key), "0");
+    else if(i == HOST_CHECKS_LAG_BUCKETS - 1)
+      snprintf(key, sizeof(key), "%u+", 1 << (i - 1));
+    else
+      snprintf(key, sizeof(key), "%u", 1 << (i - 1));
+
+    lua_push_uint64_table_entry(vm, key, lag_histogram[i]);
+  }
+
+  lua_pushstring(vm, "lag_histogram");
+  lua_insert(vm, -2);
+  lua_settable(vm, -3);
+
+  m.unlock(__FILE__, __LINE__);
+}
+
+/* ******************************************* */
@@ -30,35 +30,31 @@ HostHash::HostHash(NetworkInterface *_iface, u_int _num_hashes, u_int _max_hash_
 
 /* ************************************ */
 
-Host* HostHash::get(VLANid vlanId, IpAddress *key, bool is_inline_call, u_int16_t observation_point_id) {
-  u_int32_t hash = (key->key() % num_hashes);
+typedef struct {
+  VLANid vlanId;
+  IpAddress *ip;
+  u_int16_t observation_point_id;
+} HostHashKey;
 
-  if(table[hash] == NULL) {
-    return(NULL);
-  } else {
-    Host *head;
+static bool host_matches(GenericHashEntry *h, void *user_data) {
+  Host *host = (Host*)h;
+  HostHashKey *k = (HostHashKey*)user_data;
 
-    if(!is_inline_call)
-      locks[hash]->rdlock(__FILE__, __LINE__);
+  return((!host->idle())
+	 && (host->get_vlan_id() == k->vlanId)
+	 && (host->get_observation_point_id() == k->observation_point_id)
+	 && (host->get_ip() != NULL)
+	 && (host->get_ip()->compare(k->ip) == 0));
+}
+
+/* ************************************ */
 
-    head = (Host*)table[hash];
-    
-    while(head != NULL) {      
-      if((!head->idle())
-	 && (head->get_vlan_id() == vlanId)
-	 && (head->get_observation_point_id() == observation_point_id)
-	 && (head->get_ip() != NULL)
-	 && (head->get_ip()->compare(key) == 0))
-	break;
-      else
-	head = (Host*)head->next();
-    }
+Host* HostHash::get(VLANid vlanId, IpAddress *key, bool is_inline_call, u_int16_t observation_point_id, bool inc_uses) {
+  HostHashKey k;
 
-    if(!is_inline_call)
-      locks[hash]->unlock(__FILE__, __LINE__);
+  k.vlanId = vlanId, k.ip = key, k.observation_point_id = observation_point_id;
 
-    return(head);
-  }
+  return((Host*)lookup<host_matches>(key->key(), &k, !is_inline_call, inc_uses));
 }
 
 /* ************************************ */
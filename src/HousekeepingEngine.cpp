@@ -0,0 +1,157 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#include "ntop_includes.h"
+
+/* ******************************************* */
+
+HousekeepingEngine::HousekeepingEngine(u_int8_t _num_workers) {
+  num_workers = min_val(max_val(_num_workers, 1), HOUSEKEEPING_MAX_NUM_WORKERS);
+  started = stopping = false;
+}
+
+/* ******************************************* */
+
+HousekeepingEngine::~HousekeepingEngine() {
+  shutdown();
+
+  tables_lock.wrlock(__FILE__, __LINE__);
+
+  for(std::vector<GenericHash*>::iterator it = tables.begin(); it != tables.end(); ++it)
+    (*it)->setHousekeepingEngine(NULL);
+
+  tables.clear();
+
+  tables_lock.unlock(__FILE__, __LINE__);
+}
+
+/* ******************************************* */
+
+typedef struct {
+  HousekeepingEngine *engine;
+  u_int8_t worker_id;
+} housekeeping_worker_arg_t;
+
+static void* housekeepingWorker(void *ptr) {
+  housekeeping_worker_arg_t *arg = (housekeeping_worker_arg_t*)ptr;
+  HousekeepingEngine *engine = arg->engine;
+  u_int8_t worker_id = arg->worker_id;
+  char name[32];
+
+  delete arg;
+
+  snprintf(name, sizeof(name), "ntopng-hk-%u", worker_id);
+  Utils::setThreadName(name);
+  engine->workerLoop(worker_id);
+
+  return(NULL);
+}
+
+/* ******************************************* */
+
+void HousekeepingEngine::start() {
+  if(started) return;
+
+  for(u_int8_t i = 0; i < num_workers; i++) {
+    housekeeping_worker_arg_t *arg = new housekeeping_worker_arg_t;
+
+    arg->engine = this, arg->worker_id = i;
+    pthread_create(&workers[i], NULL, housekeepingWorker, (void*)arg);
+  }
+
+  started = true;
+
+  ntop->getTrace()->traceEvent(TRACE_NORMAL, "Hash tables housekeeping running on %u threads", num_workers);
+}
+
+/* ******************************************* */
+
+void HousekeepingEngine::shutdown() {
+  stopping = true;
+
+  if(started) {
+    work_cond.signalAll();
+
+    for(u_int8_t i = 0; i < num_workers; i++)
+      pthread_join(workers[i], NULL);
+
+    started = false;
+  }
+}
+
+/* ******************************************* */
+
+void HousekeepingEngine::registerHash(GenericHash *h) {
+  tables_lock.wrlock(__FILE__, __LINE__);
+
+  if(std::find(tables.begin(), tables.end(), h) == tables.end()) {
+    tables.push_back(h);
+    h->setHousekeepingEngine(this);
+  }
+
+  tables_lock.unlock(__FILE__, __LINE__);
+}
+
+/* ******************************************* */
+
+void HousekeepingEngine::unregisterHash(GenericHash *h) {
+  std::vector<GenericHash*>::iterator it;
+
+  /* Workers walk the tables with the lock held in read: once acquired none is walking h */
+  tables_lock.wrlock(__FILE__, __LINE__);
+
+  if((it = std::find(tables.begin(), tables.end(), h)) != tables.end()) {
+    tables.erase(it);
+    h->setHousekeepingEngine(NULL);
+  }
+
+  tables_lock.unlock(__FILE__, __LINE__);
+}
+
+/* ******************************************* */
+
+void HousekeepingEngine::workerLoop(u_int8_t worker_id) {
+  while(!stopping) {
+    bool found = false;
+
+    tables_lock.rdlock(__FILE__, __LINE__);
+
+    /* Start from a different table on each worker to spread them */
+    for(size_t k = 0, n = tables.size(); (k < n) && !stopping; k++) {
+      if(tables[(worker_id + k) % n]->runHousekeeping()) {
+	found = true;
+	notify(); /* Wake up a peer for the other partitions */
+      }
+    }
+
+    tables_lock.unlock(__FILE__, __LINE__);
+
+    if(!found) {
+      struct timespec expiration;
+
+      expiration.tv_sec = time(NULL) + 1, expiration.tv_nsec = 0;
+      work_cond.timedWait(&expiration);
+    }
+  }
+}
+
+/* ******************************************* */
@@ -0,0 +1,425 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "ntop_includes.h"
+
+/* ******************************************* */
+
+InfluxDBStreamer::InfluxDBStreamer() {
+  cur = NULL;
+  started = stopping = false;
+  spill_seq = 0;
+  curl = NULL, gz_buf = NULL, gz_buf_len = 0;
+#ifdef HAVE_ZLIB
+  zs_ready = false;
+#endif
+  num_points_enqueued = num_points_posted = num_points_spilled = num_points_dropped = 0;
+  num_posts = num_failed_posts = num_retries = 0;
+  bytes_formatted = bytes_posted = bytes_posted_uncompressed = 0;
+  last_post_ms = 0;
+
+  /* All interfaces spill into the same directory (as with ClickHouse) */
+  snprintf(spill_dir, sizeof(spill_dir), "%s/tmp/influxdb/", ntop->get_working_dir());
+  ntop->fixPath(spill_dir);
+
+  for(u_int i = 0; i < INFLUXDB_STREAM_NUM_BATCHES; i++) {
+    influxdb_batch_t *b = &batches[i];
+
+    /* Allocated on first use: nothing is kept when InfluxDB is not used */
+    b->data = NULL, b->len = b->num_points = 0, b->first_point = 0;
+    free_batches.push_back(b);
+  }
+}
+
+/* ******************************************* */
+
+InfluxDBStreamer::~InfluxDBStreamer() {
+  shutdown();
+
+  for(u_int i = 0; i < INFLUXDB_STREAM_NUM_BATCHES; i++) {
+    if(batches[i].data) delete[] batches[i].data;
+  }
+
+  if(curl)   curl_easy_cleanup(curl);
+  if(gz_buf) free(gz_buf);
+#ifdef HAVE_ZLIB
+  if(zs_ready) deflateEnd(&zs);
+#endif
+}
+
+/* ******************************************* */
+
+static void* influxDBSender(void *ptr) {
+  Utils::setThreadName("ntopng-influx");
+  ((InfluxDBStreamer*)ptr)->senderLoop();
+
+  return(NULL);
+}
+
+/* ******************************************* */
+
+void InfluxDBStreamer::start() {
+  if(started) return;
+
+  pthread_create(&sender, NULL, influxDBSender, (void*)this);
+  started = true;
+}
+
+/* ******************************************* */
+
+void InfluxDBStreamer::shutdown() {
+  lock.lock(__FILE__, __LINE__);
+  stopping = true;
+  lock.unlock(__FILE__, __LINE__);
+
+  if(started) {
+    ready_cond.signalAll();
+    pthread_join(sender, NULL);
+    started = false;
+  }
+
+  /* Points enqueued after the last pass of the sender */
+  while(!ready_batches.empty()) {
+    spill(ready_batches.front());
+    ready_batches.pop_front();
+  }
+
+  if(cur && cur->num_points) {
+    spill(cur);
+    cur->len = cur->num_points = 0;
+  }
+}
+
+/* ******************************************* */
+
+void InfluxDBStreamer::setEndpoint(const char *url, const char *db, const char *user, const char *pwd) {
+  lock.lock(__FILE__, __LINE__);
+
+  write_url = std::string(url) + "/write?precision=s&db=" + db;
+  username = user ? user : "", password = pwd ? pwd : "";
+
+  lock.unlock(__FILE__, __LINE__);
+}
+
+/* ******************************************* */
+
+bool InfluxDBStreamer::enqueue(lua_State *vm, int (*escape_fn)(char *outbuf, int outlen, const char *orig)) {
+  bool full = false;
+  int len;
+
+  lock.lock(__FILE__, __LINE__);
+
+  /* Checked under the lock: shutdown() drains cur once this is set */
+  if(stopping) {
+    lock.unlock(__FILE__, __LINE__);
+    return(false);
+  }
+
+  while(!cur) {
+    influxdb_batch_t *oldest;
+
+    if(!free_batches.empty()) {
+      cur = free_batches.back();
+
+      if(!cur->data && ((cur->data = new (std::nothrow) char[INFLUXDB_STREAM_BATCH_SIZE]) == NULL)) {
+	cur = NULL, num_points_dropped++;
+	lock.unlock(__FILE__, __LINE__);
+	return(false);
+      }
+
+      free_batches.pop_back();
+      break;
+    }
+
+    if(ready_batches.empty()) {
+      num_points_dropped++;
+      lock.unlock(__FILE__, __LINE__);
+      return(false);
+    }
+
+    /* The sender can't keep up: the oldest batch goes to disk to make room */
+    oldest = ready_batches.front();
+    ready_batches.pop_front();
+
+    lock.unlock(__FILE__, __LINE__);
+    spill(oldest);
+    oldest->len = oldest->num_points = 0;
+    lock.lock(__FILE__, __LINE__);
+
+    free_batches.push_back(oldest);
+  }
+
+  /* A batch always has room for a line of the maximum length */
+  len = TimeseriesExporter::line_protocol_write_line(vm, &cur->data[cur->len], LINE_PROTOCOL_MAX_LINE, escape_fn);
+
+  if(len >= 0) {
+    if(cur->num_points == 0)
+      cur->first_point = time(NULL);
+
+    cur->len += len, cur->num_points++;
+    num_points_enqueued++, bytes_formatted += len;
+
+    if(cur->len > INFLUXDB_STREAM_BATCH_SIZE - LINE_PROTOCOL_MAX_LINE) {
+      ready_batches.push_back(cur);
+      cur = NULL, full = true;
+    }
+  }
+
+  lock.unlock(__FILE__, __LINE__);
+
+  if(full)
+    ready_cond.signal();
+
+  return(len >= 0);
+}
+
+/* ******************************************* */
+
+bool InfluxDBStreamer::compress(influxdb_batch_t *b, const char **out, u_int32_t *out_len) {
+#ifdef HAVE_ZLIB
+  if(!zs_ready) {
+    memset(&zs, 0, sizeof(zs));
+
+    /* 15 + 16: gzip wrapper, as expected with Content-Encoding: gzip */
+    if(deflateInit2(&zs, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+      return(false);
+
+    zs_ready = true;
+  } else
+    deflateReset(&zs);
+
+  if(!gz_buf) {
+    gz_buf_len = deflateBound(&zs, INFLUXDB_STREAM_BATCH_SIZE);
+
+    if((gz_buf = (char*)malloc(gz_buf_len)) == NULL)
+      return(false);
+  }
+
+  zs.next_in = (Bytef*)b->data, zs.avail_in = b->len;
+  zs.next_out = (Bytef*)gz_buf, zs.avail_out = gz_buf_len;
+
+  if(deflate(&zs, Z_FINISH) != Z_STREAM_END)
+    return(false);
+
+  *out = gz_buf, *out_len = zs.total_out;
+  return(true);
+#else
+  return(false);
+#endif
+}
+
+/* ******************************************* */
+
+bool InfluxDBStreamer::post(influxdb_batch_t *b, bool stop) {
+  std::string url, user, pwd;
+  const char *body, *encoding = NULL;
+  u_int32_t body_len;
+  u_int max_attempts = stop ? 1 : INFLUXDB_STREAM_MAX_ATTEMPTS;
+  char rsp[256], err[320];
+  long http_code = 0;
+
+  lock.lock(__FILE__, __LINE__);
+  url = write_url, user = username, pwd = password;
+  lock.unlock(__FILE__, __LINE__);
+
+  if(url.empty())
+    return(false); /* The influxdb driver has not been set up yet */
+
+  if(!curl && ((curl = curl_easy_init()) == NULL))
+    return(false);
+
+  if(compress(b, &body, &body_len))
+    encoding = "gzip";
+  else
+    body = b->data, body_len = b->len;
+
+  for(u_int attempt = 0; attempt < max_attempts; attempt++) {
+    HTTPTranferStats stats;
+    struct timeval begin, end;
+
+    if(attempt > 0) {
+      /* Backoff of 1, 2, ... seconds, cut short by the shutdown */
+      for(u_int i = 0; (i < (1u << (attempt - 1))) && !stopping; i++)
+	sleep(1);
+
+      if(stopping) break;
+      num_retries++;
+    }
+
+    gettimeofday(&begin, NULL);
+    http_code = Utils::postHTTPKeepAlive(curl, user.c_str(), pwd.c_str(), url.c_str(),
+					 "text/plain; charset=utf-8", encoding, body, body_len,
+					 INFLUXDB_STREAM_TIMEOUT, &stats, rsp, sizeof(rsp));
+    gettimeofday(&end, NULL);
+    last_post_ms = (u_int32_t)Utils::msTimevalDiff(&end, &begin);
+
+    if((http_code >= 200) && (http_code <= 299)) {
+      num_posts++, num_points_posted += b->num_points;
+      bytes_posted += body_len, bytes_posted_uncompressed += b->len;
+
+      ntop->getRedis()->incr(CONST_INFLUXDB_KEY_EXPORTED_POINTS, b->num_points);
+      ntop->getRedis()->incr(CONST_INFLUXDB_KEY_EXPORTS, 1);
+      ntop->getRedis()->del((char*)CONST_INFLUXDB_KEY_LAST_ERROR);
+
+      return(true);
+    }
+
+    /* The points have been rejected (e.g. unknown database): posting them again won't help */
+    if((http_code >= 400) && (http_code <= 499))
+      break;
+  }
+
+  num_failed_posts++;
+
+  if(http_code)
+    snprintf(err, sizeof(err), "HTTP %ld %s", http_code, rsp);
+  else
+    snprintf(err, sizeof(err), "%s", rsp[0] ? rsp : "Unable to post data");
+
+  ntop->getTrace()->traceEvent(TRACE_WARNING, "Unable to export %u points to InfluxDB: %s", b->num_points, err);
+
+  ntop->getRedis()->incr(CONST_INFLUXDB_KEY_FAILED_EXPORTS, 1);
+  ntop->getRedis()->set(CONST_INFLUXDB_KEY_LAST_ERROR, err);
+  ntop->getRedis()->set(CONST_INFLUXDB_FLAG_FAILING_EXPORTS, "true", CONST_INFLUXDB_FLAGS_TIMEOUT);
+
+  return(false);
+}
+
+/* ******************************************* */
+
+/* Writes the batch where the influxdb driver export() posts it later */
+void InfluxDBStreamer::spill(influxdb_batch_t *b) {
+  char ready_fname[PATH_MAX + 32], fname[PATH_MAX + 64];
+  bool ok = false;
+  u_int32_t seq;
+  FILE *fd;
+
+  lock.lock(__FILE__, __LINE__);
+  seq = spill_seq++;
+  lock.unlock(__FILE__, __LINE__);
+
+  snprintf(ready_fname, sizeof(ready_fname), "%s%lu_%u", spill_dir, (unsigned long)time(NULL), seq);
+  snprintf(fname, sizeof(fname), "%s%s", ready_fname, TMP_TRAILER);
+
+  if(!Utils::mkdir_tree(spill_dir))
+    ntop->getTrace()->traceEvent(TRACE_WARNING, "Unable to create directory %s", spill_dir);
+  else if((fd = fopen(fname, "wb")) == NULL)
+    ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to dump TS data onto %s: %s", fname, strerror(errno));
+  else {
+    ok = (fwrite(b->data, 1, b->len, fd) == b->len);
+    ok = (fclose(fd) == 0) && ok;
+
+    /* Files without the .tmp trailer are complete */
+    if(ok)
+      ok = (rename(fname, ready_fname) == 0);
+    else
+      ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to dump TS data onto %s: %s", fname, strerror(errno));
+
+    if(!ok)
+      unlink(fname);
+  }
+
+  lock.lock(__FILE__, __LINE__);
+  if(ok)
+    num_points_spilled += b->num_points;
+  else
+    num_points_dropped += b->num_points;
+  lock.unlock(__FILE__, __LINE__);
+
+  if(!ok)
+    ntop->getRedis()->set(CONST_INFLUXDB_FLAG_DROPPING_POINTS, "true", CONST_INFLUXDB_FLAGS_TIMEOUT);
+}
+
+/* ******************************************* */
+
+void InfluxDBStreamer::release(influxdb_batch_t *b) {
+  b->len = b->num_points = 0;
+
+  lock.lock(__FILE__, __LINE__);
+  free_batches.push_back(b);
+  lock.unlock(__FILE__, __LINE__);
+}
+
+/* ******************************************* */
+
+void InfluxDBStreamer::senderLoop() {
+  while(true) {
+    influxdb_batch_t *b = NULL;
+    bool stop = stopping;
+    time_t now = time(NULL);
+
+    lock.lock(__FILE__, __LINE__);
+
+    /* Full batches first, then the one being filled when it is too old */
+    if(!ready_batches.empty()) {
+      b = ready_batches.front();
+      ready_batches.pop_front();
+    } else if(cur && cur->num_points
+	      && (stop || (now >= cur->first_point + CONST_INFLUXDB_FLUSH_TIME)))
+      b = cur, cur = NULL;
+
+    lock.unlock(__FILE__, __LINE__);
+
+    if(b) {
+      if(!post(b, stop))
+	spill(b);
+
+      release(b);
+      continue;
+    }
+
+    if(stop)
+      break;
+    else {
+      struct timespec expiration;
+
+      expiration.tv_sec = time(NULL) + 1, expiration.tv_nsec = 0;
+      ready_cond.timedWait(&expiration);
+    }
+  }
+}
+
+/* ******************************************* */
+
+void InfluxDBStreamer::lua(lua_State *vm) {
+  u_int32_t num_ready, num_free;
+
+  lock.lock(__FILE__, __LINE__);
+  num_ready = ready_batches.size(), num_free = free_batches.size();
+  lock.unlock(__FILE__, __LINE__);
+
+  lua_newtable(vm);
+  lua_push_uint64_table_entry(vm, "points_enqueued", num_points_enqueued);
+  lua_push_uint64_table_entry(vm, "points_posted", num_points_posted);
+  lua_push_uint64_table_entry(vm, "points_spilled", num_points_spilled);
+  lua_push_uint64_table_entry(vm, "points_dropped", num_points_dropped);
+  lua_push_uint64_table_entry(vm, "posts", num_posts);
+  lua_push_uint64_table_entry(vm, "failed_posts", num_failed_posts);
+  lua_push_uint64_table_entry(vm, "retries", num_retries);
+  lua_push_uint64_table_entry(vm, "bytes_formatted", bytes_formatted);
+  lua_push_uint64_table_entry(vm, "bytes_posted", bytes_posted);
+  lua_push_float_table_entry(vm, "compression_ratio", bytes_posted ? (float)bytes_posted_uncompressed / bytes_posted : 0);
+  lua_push_uint32_table_entry(vm, "last_post_ms", last_post_ms);
+  lua_push_uint32_table_entry(vm, "batches_ready", num_ready);
+  lua_push_uint32_table_entry(vm, "batches_free", num_free);
+}
+
+/* ******************************************* */
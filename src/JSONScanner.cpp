@@ -0,0 +1,381 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#include "ntop_includes.h"
+
+/* ******************************************* */
+
+JSONScanner::JSONScanner(char *buf, u_int32_t len) {
+  start = cur = buf, end = buf + len;
+  depth = 0, failed = false;
+}
+
+/* ******************************************* */
+
+char JSONScanner::peek() {
+  skipSpaces();
+
+  return((cur < end) ? *cur : 0);
+}
+
+/* ******************************************* */
+
+bool JSONScanner::enter(char open) {
+  skipSpaces();
+
+  if((cur >= end) || (*cur != open) || (depth >= JSON_SCANNER_MAX_DEPTH))
+    return(fail());
+
+  cur++;
+  first[depth++] = true;
+
+  return(true);
+}
+
+/* ******************************************* */
+
+bool JSONScanner::next(char close) {
+  if(failed || (depth == 0))
+    return(false);
+
+  skipSpaces();
+
+  if(cur >= end)
+    return(fail());
+
+  if(*cur == close) {
+    cur++, depth--;
+    return(false);
+  }
+
+  if(!first[depth - 1]) {
+    if(*cur != ',')
+      return(fail());
+
+    cur++;
+    skipSpaces();
+  }
+
+  first[depth - 1] = false;
+
+  return(true);
+}
+
+/* ******************************************* */
+
+bool JSONScanner::nextMember(char **key, u_int32_t *key_len) {
+  if(!next('}'))
+    return(false);
+
+  if((cur >= end) || (*cur != '"') || !scanString(key, key_len))
+    return(fail());
+
+  skipSpaces();
+
+  if((cur >= end) || (*cur != ':'))
+    return(fail());
+
+  cur++;
+
+  return(true);
+}
+
+/* ******************************************* */
+
+static int hexValue(char c) {
+  if((c >= '0') && (c <= '9')) return(c - '0');
+  if((c >= 'a') && (c <= 'f')) return(c - 'a' + 10);
+  if((c >= 'A') && (c <= 'F')) return(c - 'A' + 10);
+  return(-1);
+}
+
+/* ******************************************* */
+
+static bool parseHex4(const char *s, u_int32_t *out) {
+  u_int32_t v = 0;
+
+  for(int i = 0; i < 4; i++) {
+    int h = hexValue(s[i]);
+
+    if(h < 0) return(false);
+    v = (v << 4) | h;
+  }
+
+  *out = v;
+  return(true);
+}
+
+/* ******************************************* */
+
+/* cur points to the opening quote. The unescaped string is written over the
+   escaped one, which is never shorter, and terminated where it ends */
+bool JSONScanner::scanString(char **out, u_int32_t *out_len) {
+  char *r = cur + 1, *w = r;
+
+  while(true) {
+    if(r >= end)
+      return(fail());
+
+    if(*r == '"')
+      break;
+
+    if(*r != '\\') {
+      *w++ = *r++;
+      continue;
+    }
+
+    if(r + 1 >= end)
+      return(fail());
+
+    switch(r[1]) {
+    case '"':  *w++ = '"';  break;
+    case '\\': *w++ = '\\'; break;
+    case '/':  *w++ = '/';  break;
+    case 'b':  *w++ = '\b'; break;
+    case 'f':  *w++ = '\f'; break;
+    case 'n':  *w++ = '\n'; break;
+    case 'r':  *w++ = '\r'; break;
+    case 't':  *w++ = '\t'; break;
+    case 'u':
+      {
+	u_int32_t cp, low;
+
+	if((r + 6 > end) || !parseHex4(&r[2], &cp))
+	  return(fail());
+
+	r += 6;
+
+	if((cp >= 0xD800) && (cp < 0xDC00)
+	   && (r + 6 <= end) && (r[0] == '\\') && (r[1] == 'u')
+	   && parseHex4(&r[2], &low) && (low >= 0xDC00) && (low < 0xE000)) {
+	  cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+	  r += 6;
+	}
+
+	if(cp < 0x80)
+	  *w++ = cp;
+	else if(cp < 0x800)
+	  *w++ = 0xC0 | (cp >> 6), *w++ = 0x80 | (cp & 0x3F);
+	else if(cp < 0x10000)
+	  *w++ = 0xE0 | (cp >> 12), *w++ = 0x80 | ((cp >> 6) & 0x3F), *w++ = 0x80 | (cp & 0x3F);
+	else
+	  *w++ = 0xF0 | (cp >> 18), *w++ = 0x80 | ((cp >> 12) & 0x3F),
+	    *w++ = 0x80 | ((cp >> 6) & 0x3F), *w++ = 0x80 | (cp & 0x3F);
+      }
+      continue;
+    default:
+      return(fail());
+    }
+
+    r += 2;
+  }
+
+  *w = '\0';
+  *out = cur + 1, *out_len = w - (cur + 1);
+  cur = r + 1;
+
+  return(true);
+}
+
+/* ******************************************* */
+
+bool JSONScanner::scanNumber(json_scanner_value_t *v) {
+  const char *num = cur;
+  char tail[64];
+  bool is_double = false;
+
+  if(*cur == '-') cur++;
+
+  while(cur < end) {
+    if((*cur >= '0') && (*cur <= '9'))
+      ;
+    else if((*cur == '.') || (*cur == 'e') || (*cur == 'E') || (*cur == '+') || (*cur == '-'))
+      is_double = true;
+    else
+      break;
+
+    cur++;
+  }
+
+  if((cur == num) || ((cur == num + 1) && (*num == '-')))
+    return(fail());
+
+  v->raw = num, v->len = cur - num;
+
+  if(cur == end) {
+    /* Last token of a buffer that could be not terminated: convert a copy */
+    if(v->len >= sizeof(tail))
+      return(fail());
+
+    memcpy(tail, num, v->len);
+    tail[v->len] = '\0', num = tail;
+  }
+
+  if(is_double) {
+    v->type = json_scanner_double;
+    v->double_num = strtod(num, NULL);
+    v->int_num = (int64_t)v->double_num;
+  } else {
+    v->type = json_scanner_int;
+    v->int_num = strtoll(num, NULL, 10);
+    v->double_num = v->int_num;
+  }
+
+  return(true);
+}
+
+/* ******************************************* */
+
+bool JSONScanner::scanLiteral(const char *literal, u_int32_t literal_len) {
+  if((cur + literal_len > end) || strncmp(cur, literal, literal_len))
+    return(fail());
+
+  cur += literal_len;
+
+  return(true);
+}
+
+/* ******************************************* */
+
+/* Skips a nested object or array without modifying it: its syntax is only
+   checked later, if it gets parsed by toJSONObject() */
+bool JSONScanner::skipNested() {
+  u_int32_t level = 0;
+
+  do {
+    if(cur >= end)
+      return(fail());
+
+    switch(*cur++) {
+    case '"':
+      while((cur < end) && (*cur != '"')) {
+	if(*cur == '\\') cur++;
+	cur++;
+      }
+
+      if(cur >= end)
+	return(fail());
+
+      cur++;
+      break;
+    case '{':
+    case '[':
+      level++;
+      break;
+    case '}':
+    case ']':
+      level--;
+      break;
+    }
+  } while(level > 0);
+
+  return(true);
+}
+
+/* ******************************************* */
+
+bool JSONScanner::readValue(json_scanner_value_t *v) {
+  if(failed)
+    return(false);
+
+  skipSpaces();
+
+  if(cur >= end)
+    return(fail());
+
+  v->string = NULL, v->raw = cur, v->len = 0;
+  v->int_num = 0, v->double_num = 0, v->boolean = false;
+
+  switch(*cur) {
+  case '"':
+    v->type = json_scanner_string, v->raw = NULL;
+    return(scanString(&v->string, &v->len));
+
+  case '{':
+  case '[':
+    v->type = (*cur == '{') ? json_scanner_object : json_scanner_array;
+    if(!skipNested()) return(false);
+    break;
+
+  case 't':
+    v->type = json_scanner_bool, v->boolean = true;
+    if(!scanLiteral("true", 4)) return(false);
+    break;
+
+  case 'f':
+    v->type = json_scanner_bool;
+    if(!scanLiteral("false", 5)) return(false);
+    break;
+
+  case 'n':
+    v->type = json_scanner_null;
+    if(!scanLiteral("null", 4)) return(false);
+    break;
+
+  default:
+    return(scanNumber(v));
+  }
+
+  v->len = cur - v->raw;
+
+  return(true);
+}
+
+/* ******************************************* */
+
+const char* JSONScanner::getTypeName(JSONScannerType type) {
+  switch(type) {
+  case json_scanner_null:   return("null");
+  case json_scanner_bool:   return("boolean");
+  case json_scanner_int:    return("int");
+  case json_scanner_double: return("double");
+  case json_scanner_string: return("string");
+  case json_scanner_object: return("object");
+  case json_scanner_array:  return("array");
+  }
+
+  return("unknown");
+}
+
+/* ******************************************* */
+
+json_object* JSONScanner::toJSONObject(const json_scanner_value_t *v, json_tokener *tok) {
+  switch(v->type) {
+  case json_scanner_bool:   return(json_object_new_boolean(v->boolean));
+  case json_scanner_int:    return(json_object_new_int64(v->int_num));
+  case json_scanner_double: return(json_object_new_double(v->double_num));
+  case json_scanner_string: return(json_object_new_string_len(v->string, v->len));
+  case json_scanner_object:
+  case json_scanner_array:
+    if(tok) {
+      json_tokener_reset(tok);
+      return(json_tokener_parse_ex(tok, v->raw, v->len));
+    }
+    break;
+  case json_scanner_null:
+    break;
+  }
+
+  return(NULL);
+}
+
+/* ******************************************* */
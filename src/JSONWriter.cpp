@@ -0,0 +1,297 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#include "ntop_includes.h"
+
+/* ******************************************* */
+
+JSONWriter::JSONWriter(u_int32_t initial_size) {
+  size = initial_size ? initial_size : 1024, len = 0;
+  buf = (char*)malloc(size);
+  scratch = NULL, scratch_size = 0;
+  failed = (buf == NULL);
+  keys.reserve(JSON_WRITER_RESERVED_KEYS);
+
+  reset();
+}
+
+/* ******************************************* */
+
+JSONWriter::~JSONWriter() {
+  if(buf)     free(buf);
+  if(scratch) free(scratch);
+}
+
+/* ******************************************* */
+
+bool JSONWriter::reserve(u_int32_t n) {
+  u_int32_t new_size;
+  char *new_buf;
+
+  if(failed) return(false);
+  if(len + n + 1 <= size) return(true);
+
+  new_size = size;
+  while(len + n + 1 > new_size) new_size *= 2;
+
+  if((new_buf = (char*)realloc(buf, new_size)) == NULL) {
+    failed = true;
+    return(false);
+  }
+
+  buf = new_buf, size = new_size;
+  return(true);
+}
+
+/* ******************************************* */
+
+void JSONWriter::append(const char *s, u_int32_t n) {
+  if(!reserve(n)) return;
+
+  memcpy(&buf[len], s, n);
+  len += n;
+}
+
+/* ******************************************* */
+
+/* Same escaping as json-c json_escape_str() */
+void JSONWriter::appendEscaped(const char *s) {
+  static const char hex[] = "0123456789abcdef";
+  const char *start = s;
+  char esc[7];
+
+  for(; *s; s++) {
+    u_char c = (u_char)*s;
+    const char *r = NULL;
+
+    switch(c) {
+    case '\b': r = "\\b";  break;
+    case '\n': r = "\\n";  break;
+    case '\r': r = "\\r";  break;
+    case '\t': r = "\\t";  break;
+    case '\f': r = "\\f";  break;
+    case '"':  r = "\\\""; break;
+    case '\\': r = "\\\\"; break;
+    case '/':  r = "\\/";  break;
+    default:
+      if(c < ' ') {
+	snprintf(esc, sizeof(esc), "\\u00%c%c", hex[c >> 4], hex[c & 0xF]);
+	r = esc;
+      }
+    }
+
+    if(r) {
+      if(s > start) append(start, s - start);
+      append(r);
+      start = s + 1;
+    }
+  }
+
+  if(s > start) append(start, s - start);
+}
+
+/* ******************************************* */
+
+/* Same formatting as json-c json_object_double_to_json_string() */
+void JSONWriter::appendDouble(double d) {
+  char tmp[64];
+  int n;
+
+  if(isnan(d))
+    append("NaN", 3);
+  else if(isinf(d))
+    append(d > 0 ? "Infinity" : "-Infinity");
+  else {
+    n = snprintf(tmp, sizeof(tmp), "%.17g", d);
+
+    if((n > 0) && (n < (int)sizeof(tmp) - 2)
+       && isdigit((u_char)tmp[(tmp[0] == '-') ? 1 : 0])
+       && (strchr(tmp, '.') == NULL) && (strchr(tmp, 'e') == NULL))
+      strcat(tmp, ".0"), n += 2;
+
+    append(tmp, n);
+  }
+}
+
+/* ******************************************* */
+
+void JSONWriter::reset() {
+  len = 0, had_children = false;
+  keys.clear();
+  failed = (buf == NULL);
+  append("{", 1);
+}
+
+/* ******************************************* */
+
+void JSONWriter::beginValue(const char *key) {
+  entry_start = len;
+
+  if(had_children) append(",", 1);
+  had_children = true;
+
+  append(" \"", 2);
+  key_start = len;
+  appendEscaped(key);
+  append("\": ", 3);
+
+  val_start = len;
+}
+
+/* ******************************************* */
+
+/*
+  Registers the value just written. A key already present keeps its
+  position and takes the new value, as json_object_object_add() does.
+*/
+void JSONWriter::endValue() {
+  u_int32_t hash = 5381, key_off = key_start, key_len = val_start - 3 - key_start, val_len, i;
+
+  if(failed) return;
+
+  for(i = 0; i < key_len; i++) hash = ((hash << 5) + hash) + (u_char)buf[key_off + i];
+
+  val_len = len - val_start;
+
+  for(i = 0; i < keys.size(); i++) {
+    json_writer_key_t *k = &keys[i];
+
+    if((k->hash == hash) && (k->key_len == key_len)
+       && (memcmp(&buf[k->key_off], &buf[key_off], key_len) == 0)) {
+      u_int32_t old_end = k->val_off + k->val_len;
+      int32_t delta = (int32_t)val_len - (int32_t)k->val_len;
+
+      /* Move the new value aside and drop the whole new entry */
+      if(scratch_size < val_len) {
+	char *s = (char*)realloc(scratch, val_len);
+
+	if(s == NULL) { failed = true; return; }
+	scratch = s, scratch_size = val_len;
+      }
+
+      memcpy(scratch, &buf[val_start], val_len);
+      len = entry_start;
+
+      if((delta > 0) && !reserve(delta)) return;
+
+      memmove(&buf[old_end + delta], &buf[old_end], len - old_end);
+      memcpy(&buf[k->val_off], scratch, val_len);
+      len += delta, k->val_len = val_len;
+
+      for(u_int32_t j = i + 1; j < keys.size(); j++)
+	keys[j].key_off += delta, keys[j].val_off += delta;
+
+      return;
+    }
+  }
+
+  json_writer_key_t k;
+
+  k.hash = hash, k.key_off = key_off, k.key_len = key_len;
+  k.val_off = val_start, k.val_len = val_len;
+  keys.push_back(k);
+}
+
+/* ******************************************* */
+
+void JSONWriter::addString(const char *key, const char *value) {
+  beginValue(key);
+  append("\"", 1);
+  appendEscaped(value ? value : "");
+  append("\"", 1);
+  endValue();
+}
+
+/* ******************************************* */
+
+void JSONWriter::addInt(const char *key, int32_t value) {
+  char tmp[16];
+
+  beginValue(key);
+  append(tmp, snprintf(tmp, sizeof(tmp), "%d", value));
+  endValue();
+}
+
+/* ******************************************* */
+
+void JSONWriter::addInt64(const char *key, int64_t value) {
+  char tmp[24];
+
+  beginValue(key);
+  append(tmp, snprintf(tmp, sizeof(tmp), "%" PRId64, value));
+  endValue();
+}
+
+/* ******************************************* */
+
+void JSONWriter::addBool(const char *key, bool value) {
+  beginValue(key);
+  if(value) append("true", 4); else append("false", 5);
+  endValue();
+}
+
+/* ******************************************* */
+
+void JSONWriter::addDouble(const char *key, double value) {
+  beginValue(key);
+  appendDouble(value);
+  endValue();
+}
+
+/* ******************************************* */
+
+void JSONWriter::addDoubleArray(const char *key, const double *values, u_int16_t num_values) {
+  beginValue(key);
+  append("[", 1);
+
+  for(u_int16_t i = 0; i < num_values; i++) {
+    if(i > 0) append(",", 1);
+    append(" ", 1);
+    appendDouble(values[i]);
+  }
+
+  append(" ]", 2);
+  endValue();
+}
+
+/* ******************************************* */
+
+void JSONWriter::addRaw(const char *key, const char *json) {
+  beginValue(key);
+  append(json ? json : "null");
+  endValue();
+}
+
+/* ******************************************* */
+
+const char* JSONWriter::end(u_int32_t *out_len) {
+  append(" }", 2);
+
+  if(failed) return(NULL);
+
+  buf[len] = '\0';
+  if(out_len) *out_len = len;
+
+  return(buf);
+}
+
+/* ******************************************* */
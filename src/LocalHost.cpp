@@ -47,23 +47,41 @@ LocalHost::LocalHost(NetworkInterface *_iface, char *ipAddress,
 
 LocalHost::~LocalHost() {
   if(initial_ts_point) delete(initial_ts_point);
+  if(pending_restore)  pending_restore->release();
   freeLocalHostData();
 }
 
 /* *************************************** */
 
 void LocalHost::set_hash_entry_state_idle() {
-  /* Serialization is performed, inline, as soon as the LocalHost becomes idle, and
+  LocalHostCache *cache = iface->getLocalHostCache();
+  char redis_key[CONST_MAX_LEN_REDIS_KEY];
+  bool restore_pending;
+
+  if(pending_restore && pending_restore->isCompleted()) {
+    checkStatsReset(); /* Releases replaced stats, if any, so that the restore can be applied */
+    applyRestoredState();
+  }
+
+  restore_pending = isRestorePending();
+
+  /* Serialization is performed as soon as the LocalHost becomes idle, and
      not when it is deleted. This guarantees that, if the same host becomes active again,
-     its counters will be consistent even if its other instance has still to be deleted. */
-  if(data_delete_requested)
-    deleteRedisSerialization();
-  else if((ntop->getPrefs()->is_idle_local_host_cache_enabled()
+     its counters will be consistent even if its other instance has still to be deleted.
+     The local host cache writes requests in order, so this also holds in background. */
+  if(data_delete_requested) {
+    if(cache)
+      cache->del(getSerializationKey(redis_key, sizeof(redis_key)));
+    else
+      deleteRedisSerialization();
+  } else if((ntop->getPrefs()->is_idle_local_host_cache_enabled()
       || ntop->getPrefs()->is_active_local_host_cache_enabled())
-     && (!ip.isEmpty())) {
+     && (!ip.isEmpty())
+     && (!restore_pending) /* Don't overwrite the saved state with a partial one */) {
     Mac *mac = getMac();
+
     checkStatsReset();
-    serializeToRedis();
+    saveState();
 
     /* For LBD hosts in the DHCP range, also save the IP -> MAC
      * association. This allows us to both search the host by IP and to
@@ -76,7 +94,10 @@ void LocalHost::set_hash_entry_state_idle() {
       mac->print(mac_buf, sizeof(mac_buf));
 
       /* IP@VLAN -> MAC */
-      ntop->getRedis()->set(key, mac_buf, ntop->getPrefs()->get_local_host_cache_duration());
+      if(cache)
+	cache->save(key, mac_buf, ntop->getPrefs()->get_local_host_cache_duration());
+      else
+	ntop->getRedis()->set(key, mac_buf, ntop->getPrefs()->get_local_host_cache_duration());
     }
   }
 
@@ -89,6 +110,23 @@ void LocalHost::set_hash_entry_state_idle() {
 
 /* *************************************** */
 
+/* Saves the host state through the local host cache, in order with the other requests */
+void LocalHost::saveState() {
+  LocalHostCache *cache = iface->getLocalHostCache();
+  char redis_key[CONST_MAX_LEN_REDIS_KEY];
+  json_object *my_obj;
+
+  if(!cache)
+    serializeToRedis();
+  else if((my_obj = json_object_new_object()) != NULL) {
+    serialize(my_obj, details_max);
+    cache->save(getSerializationKey(redis_key, sizeof(redis_key)), my_obj,
+		ntop->getPrefs()->get_local_host_cache_duration());
+  }
+}
+
+/* *************************************** */
+
 /* NOTE: Host::initialize will be called from the Host initializator */
 void LocalHost::initialize() {
   char buf[64], host[96], rsp[256];
@@ -104,16 +142,24 @@ void LocalHost::initialize() {
 
   systemHost = ip.isLocalInterfaceAddress();
 
+  pending_restore = NULL, restore_deferred = false;
+
   PROFILING_SUB_SECTION_ENTER(iface, "LocalHost::initialize: local_host_cache", 16);
   if(ntop->getPrefs()->is_idle_local_host_cache_enabled()) {
-    if(!deserializeFromRedis())
+    LocalHostCache *cache = iface->getLocalHostCache();
+
+    /* The host starts with empty counters, merged with the restored ones by applyRestoredState() */
+    if(cache && cache->isRunning())
+      requestRestore();
+    else if(!deserializeFromRedis())
       deleteRedisSerialization();
   }
   PROFILING_SUB_SECTION_EXIT(iface, 16);
 
   /* Clone the initial point. It will be written to the timeseries DB to
-   * address the first point problem (https://github.com/ntop/ntopng/issues/2184). */
-  initial_ts_point = new (std::nothrow) LocalHostStats(*(LocalHostStats *)stats);
+   * address the first point problem (https://github.com/ntop/ntopng/issues/2184).
+   * When the state is being restored, this is done once it has been applied. */
+  initial_ts_point = isRestorePending() ? NULL : new (iface->get_local_host_stats_pool()) LocalHostStats(*(LocalHostStats *)stats);
   initialization_time = time(NULL);
 
   char *strIP = ip.print(buf, sizeof(buf));
@@ -156,10 +202,18 @@ char* LocalHost::getSerializationKey(char *redis_key, uint bufsize) {
 /* *************************************** */
 
 void LocalHost::deserialize(json_object *o) {
-  json_object *obj;
-
   if(!isBroadcastHost()) stats->deserialize(o);
 
+  deserializeHostData(o);
+  checkStatsReset();
+}
+
+/* *************************************** */
+
+/* Everything but the stats */
+void LocalHost::deserializeHostData(json_object *o) {
+  json_object *obj;
+
   if(! mac) {
     u_int8_t mac_buf[6];
     memset(mac_buf, 0, sizeof(mac_buf));
@@ -185,8 +239,106 @@ void LocalHost::deserialize(json_object *o) {
   activityStats.reset();
   if(json_object_object_get_ex(o, "activityStats", &obj)) activityStats.deserialize(obj);
 #endif
+}
 
-  checkStatsReset();
+/* *************************************** */
+
+/* Queues the restore of the host state, deferred when the local host cache queue is full */
+void LocalHost::requestRestore() {
+  char key[CONST_MAX_LEN_REDIS_KEY];
+
+  pending_restore = iface->getLocalHostCache()->restore(getSerializationKey(key, sizeof(key)));
+  restore_deferred = (pending_restore == NULL);
+}
+
+/* *************************************** */
+
+/* Adds the numbers of from to those of to, recursing into the nested objects */
+static void addJSONCounters(json_object *to, json_object *from) {
+  json_object_object_foreach(from, key, val) {
+    json_object *cur;
+
+    if(!json_object_object_get_ex(to, key, &cur)) {
+      json_object_object_add(to, key, json_object_get(val));
+      continue;
+    }
+
+    switch(json_object_get_type(val)) {
+    case json_type_int:
+      if(json_object_is_type(cur, json_type_int))
+	json_object_object_add(to, key, json_object_new_int64(json_object_get_int64(cur) + json_object_get_int64(val)));
+      break;
+
+    case json_type_double:
+      if(json_object_is_type(cur, json_type_double))
+	json_object_object_add(to, key, json_object_new_double(json_object_get_double(cur) + json_object_get_double(val)));
+      break;
+
+    case json_type_object:
+      if(json_object_is_type(cur, json_type_object))
+	addJSONCounters(cur, val);
+      break;
+
+    default:
+      break; /* The restored value is kept */
+    }
+  }
+}
+
+/* *************************************** */
+
+/*
+  Applies the state restored in background by the LocalHostCache. It runs
+  on the thread updating the host, so no packet is accounted meanwhile.
+  The restored stats replace the current ones as a stats reset does (the
+  current ones are released at the next checkStatsReset()). The counters
+  of the traffic seen while the state was restored are added to the
+  serialized ones before deserializing them, so that the whole state is
+  restored as when done inline.
+*/
+void LocalHost::applyRestoredState() {
+  json_object *o = pending_restore->getState();
+
+  if(o) {
+    if(stats_shadow)
+      return; /* Retry at the next update, once the replaced stats have been released */
+
+    deserializeHostData(o);
+
+    /* Restored stats older than the last stats reset are discarded, as when restored inline */
+    if(!isBroadcastHost() && !statsResetRequested()) {
+      HostStats *restored_stats = allocateStats();
+      json_object *seen;
+
+      if((seen = json_object_new_object()) != NULL) {
+	((LocalHostStats*)stats)->getCountersJSONObject(seen, details_max);
+	addJSONCounters(o, seen);
+	json_object_put(seen);
+      }
+
+      restored_stats->deserialize(o);
+
+      /* As in checkStatsReset(), not while the host checks are using the stats */
+      lockChecks();
+      stats_shadow = stats, stats = restored_stats;
+      unlockChecks();
+    }
+  }
+
+  if(!initial_ts_point)
+    initial_ts_point = new (iface->get_local_host_stats_pool()) LocalHostStats(*(LocalHostStats *)stats);
+
+  pending_restore->release();
+  pending_restore = NULL;
+}
+
+/* *************************************** */
+
+void LocalHost::custom_periodic_stats_update(const struct timeval *tv) {
+  if(restore_deferred)
+    requestRestore();
+  else if(pending_restore && pending_restore->isCompleted())
+    applyRestoredState();
 }
 
 /* *************************************** */
@@ -312,6 +464,33 @@ void LocalHost::inlineSetOSDetail(const char *_os_detail) {
 
 /* *************************************** */
 
+/* Bytes used by this host, broken down by (lazily allocated) sub-structure */
+void LocalHost::lua_memory_stats(lua_State* vm) const {
+  u_int32_t tot = sizeof(LocalHost);
+
+  lua_newtable(vm);
+
+  lua_push_uint32_table_entry(vm, "host", sizeof(LocalHost));
+
+  if(stats) tot += ((LocalHostStats*)stats)->luaMemory(vm);
+
+  if(initial_ts_point) {
+    u_int32_t initial_ts_point_bytes;
+
+    /* Only the total is relevant here, use a scratch table */
+    lua_newtable(vm);
+    initial_ts_point_bytes = initial_ts_point->luaMemory(vm);
+    lua_pop(vm, 1);
+
+    lua_push_uint32_table_entry(vm, "initial_ts_point", initial_ts_point_bytes);
+    tot += initial_ts_point_bytes;
+  }
+
+  lua_push_uint32_table_entry(vm, "total", tot);
+}
+
+/* *************************************** */
+
 void LocalHost::lua_peers_stats(lua_State* vm) const {
   if(stats)
     stats->luaPeers(vm);
@@ -0,0 +1,386 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#include "ntop_includes.h"
+
+/* #define LOCAL_HOST_CACHE_DEBUG 1 */
+
+/* ******************************************* */
+
+LocalHostCacheRequest::LocalHostCacheRequest(LocalHostCacheOp _op, const char *_key, u_int8_t _num_refs) {
+  op = _op, key = strdup(_key), value = NULL, state = NULL;
+  expire_secs = 0;
+  num_refs = _num_refs, completed = false;
+  gettimeofday(&enqueue_time, NULL);
+}
+
+/* ******************************************* */
+
+LocalHostCacheRequest::~LocalHostCacheRequest() {
+  if(key)   free(key);
+  if(value) free(value);
+  if(state) json_object_put(state);
+}
+
+/* ******************************************* */
+
+static void* hostCacheLoaderLoop(void* ptr) {
+  Utils::setThreadName("HostCacheLoader");
+
+  ((LocalHostCache*)ptr)->loaderLoop();
+
+  return(NULL);
+}
+
+/* ******************************************* */
+
+LocalHostCache::LocalHostCache(NetworkInterface *_iface) {
+  iface = _iface;
+  shutdown = false;
+  memset(&stats, 0, sizeof(stats));
+
+  thread_started = (pthread_create(&loaderThread, NULL, hostCacheLoaderLoop, (void*)this) == 0);
+
+  if(!thread_started)
+    ntop->getTrace()->traceEvent(TRACE_WARNING, "Unable to start the local host cache thread on %s: hosts will be restored inline",
+				 iface->get_name());
+}
+
+/* ******************************************* */
+
+LocalHostCache::~LocalHostCache() {
+  /* Pending saves are written before leaving */
+  queue_lock.lock(__FILE__, __LINE__);
+  shutdown = true;
+  queue_lock.unlock(__FILE__, __LINE__);
+
+  if(thread_started) {
+    queue_cond.signal();
+    pthread_join(loaderThread, NULL);
+  }
+
+  while(!requests.empty()) {
+    requests.front()->release();
+    requests.pop();
+  }
+}
+
+/* ******************************************* */
+
+/*
+  Never waits, as callers are the threads updating the hosts: returns false
+  when the queue is full or the loader thread is not running.
+*/
+bool LocalHostCache::enqueue(LocalHostCacheRequest *req) {
+  bool was_empty;
+
+  queue_lock.lock(__FILE__, __LINE__);
+
+  if(!thread_started || shutdown) {
+    queue_lock.unlock(__FILE__, __LINE__);
+    return(false);
+  }
+
+  if(requests.size() >= LOCAL_HOST_CACHE_QUEUE_LEN) {
+    stats.num_full++;
+    queue_lock.unlock(__FILE__, __LINE__);
+    return(false);
+  }
+
+  was_empty = requests.empty();
+  requests.push(req);
+
+  if(requests.size() > stats.max_queued)
+    stats.max_queued = requests.size();
+
+  switch(req->op) {
+  case local_host_cache_save:   stats.num_saves++;   break;
+  case local_host_cache_delete: stats.num_deletes++; break;
+  default: break;
+  }
+
+  queue_lock.unlock(__FILE__, __LINE__);
+
+  /* The loader only sleeps when there is nothing to do */
+  if(was_empty)
+    queue_cond.signal();
+
+  return(true);
+}
+
+/* ******************************************* */
+
+/*
+  Saves and deletes are executed inline only when the loader thread could not
+  be started, as nothing is queued then. When the queue is full or while
+  shutting down they are dropped, as they could overtake the queued requests.
+*/
+void LocalHostCache::enqueueOrDrop(LocalHostCacheRequest *req) {
+  if(enqueue(req))
+    return;
+
+  queue_lock.lock(__FILE__, __LINE__);
+
+  if(thread_started)
+    stats.num_dropped++;
+  else
+    stats.num_inline++;
+
+  queue_lock.unlock(__FILE__, __LINE__);
+
+  if(thread_started)
+    req->release();
+  else
+    processBatch(&req, 1);
+}
+
+/* ******************************************* */
+
+LocalHostCacheRequest* LocalHostCache::restore(const char *key) {
+  LocalHostCacheRequest *req;
+
+  if(!key || ((req = new (std::nothrow) LocalHostCacheRequest(local_host_cache_restore, key, 2 /* Cache + host */)) == NULL))
+    return(NULL);
+
+  if(!enqueue(req)) {
+    if(!thread_started) {
+      queue_lock.lock(__FILE__, __LINE__);
+      stats.num_inline++;
+      queue_lock.unlock(__FILE__, __LINE__);
+    }
+
+    delete req;
+    return(NULL);
+  }
+
+  return(req);
+}
+
+/* ******************************************* */
+
+void LocalHostCache::save(const char *key, json_object *state, u_int32_t expire_secs) {
+  LocalHostCacheRequest *req;
+
+  if(!key || ((req = new (std::nothrow) LocalHostCacheRequest(local_host_cache_save, key, 1)) == NULL)) {
+    json_object_put(state);
+    return;
+  }
+
+  req->state = state, req->expire_secs = expire_secs;
+  enqueueOrDrop(req);
+}
+
+/* ******************************************* */
+
+void LocalHostCache::save(const char *key, const char *value, u_int32_t expire_secs) {
+  LocalHostCacheRequest *req;
+
+  if(!key || !value || ((req = new (std::nothrow) LocalHostCacheRequest(local_host_cache_save, key, 1)) == NULL))
+    return;
+
+  if((req->value = strdup(value)) == NULL) {
+    delete req;
+    return;
+  }
+
+  req->expire_secs = expire_secs;
+  enqueueOrDrop(req);
+}
+
+/* ******************************************* */
+
+void LocalHostCache::del(const char *key) {
+  LocalHostCacheRequest *req;
+
+  if(key && ((req = new (std::nothrow) LocalHostCacheRequest(local_host_cache_delete, key, 1)) != NULL))
+    enqueueOrDrop(req);
+}
+
+/* ******************************************* */
+
+static void setCommand(redis_pipeline_cmd_t *cmd, const char *name, const char *key, const char *arg = NULL) {
+  cmd->argc = 2;
+  cmd->argv[0] = name, cmd->argvlen[0] = strlen(name);
+  cmd->argv[1] = key,  cmd->argvlen[1] = strlen(key);
+
+  if(arg)
+    cmd->argv[2] = arg, cmd->argvlen[2] = strlen(arg), cmd->argc++;
+}
+
+/* ******************************************* */
+
+void LocalHostCache::processBatch(LocalHostCacheRequest **reqs, u_int num_reqs) {
+  redis_pipeline_cmd_t cmds[2 * LOCAL_HOST_CACHE_BATCH];
+  u_int16_t first_cmd[LOCAL_HOST_CACHE_BATCH];
+  char expire_buf[LOCAL_HOST_CACHE_BATCH][16];
+  u_int num_cmds = 0, num_dels = 0, i;
+  struct timeval now;
+
+  /* Stringify the states to save and send everything in a single round trip */
+  for(i = 0; i < num_reqs; i++) {
+    LocalHostCacheRequest *r = reqs[i];
+    const char *value;
+
+    first_cmd[i] = num_cmds;
+
+    switch(r->op) {
+    case local_host_cache_restore:
+      setCommand(&cmds[num_cmds++], "GET", r->key);
+      break;
+
+    case local_host_cache_save:
+      if((value = r->state ? json_object_to_json_string(r->state) : r->value) == NULL)
+	break;
+
+      setCommand(&cmds[num_cmds++], "SET", r->key, value);
+
+      if(r->expire_secs) {
+	snprintf(expire_buf[i], sizeof(expire_buf[i]), "%u", r->expire_secs);
+	setCommand(&cmds[num_cmds++], "EXPIRE", r->key, expire_buf[i]);
+      }
+      break;
+
+    case local_host_cache_delete:
+      setCommand(&cmds[num_cmds++], "DEL", r->key);
+      break;
+    }
+  }
+
+  ntop->getRedis()->pipeline(cmds, num_cmds);
+  gettimeofday(&now, NULL);
+
+  for(i = 0; i < num_reqs; i++) {
+    LocalHostCacheRequest *r = reqs[i];
+    redisReply *reply;
+    u_int64_t latency_ms;
+
+    if(r->op != local_host_cache_restore)
+      continue;
+
+    reply = cmds[first_cmd[i]].reply;
+
+    if(reply && (reply->type == REDIS_REPLY_STRING)) {
+      enum json_tokener_error jerr = json_tokener_success;
+
+      if((r->state = json_tokener_parse_verbose(reply->str, &jerr)) == NULL) {
+	ntop->getTrace()->traceEvent(TRACE_WARNING, "JSON Parse error [%s] key: %s: %s",
+				     json_tokener_error_desc(jerr), r->key, reply->str);
+
+	/* As when restoring inline, an invalid serialization is deleted */
+	setCommand(&cmds[num_cmds + num_dels++], "DEL", r->key);
+      }
+    }
+
+    latency_ms = Utils::msTimevalDiff(&now, &r->enqueue_time);
+
+    /* Also updated by the callers restoring inline */
+    queue_lock.lock(__FILE__, __LINE__);
+    stats.num_restores++;
+    if(r->state) stats.num_restored++;
+    stats.restore_total_ms += latency_ms, stats.restore_last_ms = latency_ms;
+    if(latency_ms > stats.restore_max_ms) stats.restore_max_ms = latency_ms;
+    queue_lock.unlock(__FILE__, __LINE__);
+
+#ifdef LOCAL_HOST_CACHE_DEBUG
+    ntop->getTrace()->traceEvent(TRACE_NORMAL, "Restored %s [found: %u][latency: %u ms]",
+				 r->key, r->state ? 1 : 0, (u_int32_t)latency_ms);
+#endif
+  }
+
+  for(i = 0; i < num_cmds; i++)
+    if(cmds[i].reply) freeReplyObject(cmds[i].reply);
+
+  if(num_dels > 0) {
+    ntop->getRedis()->pipeline(&cmds[num_cmds], num_dels);
+
+    for(i = 0; i < num_dels; i++)
+      if(cmds[num_cmds + i].reply) freeReplyObject(cmds[num_cmds + i].reply);
+  }
+
+  for(i = 0; i < num_reqs; i++) {
+    reqs[i]->setCompleted();
+    reqs[i]->release();
+  }
+}
+
+/* ******************************************* */
+
+void LocalHostCache::loaderLoop() {
+  LocalHostCacheRequest *batch[LOCAL_HOST_CACHE_BATCH];
+
+  while(true) {
+    u_int num_reqs = 0;
+    bool done;
+
+    queue_lock.lock(__FILE__, __LINE__);
+
+    while((num_reqs < LOCAL_HOST_CACHE_BATCH) && !requests.empty()) {
+      batch[num_reqs++] = requests.front();
+      requests.pop();
+    }
+
+    done = shutdown && (num_reqs == 0);
+
+    queue_lock.unlock(__FILE__, __LINE__);
+
+    if(num_reqs > 0)
+      processBatch(batch, num_reqs);
+    else if(done)
+      break;
+    else {
+      struct timespec expiration;
+
+      expiration.tv_sec = time(NULL) + 1, expiration.tv_nsec = 0;
+      queue_cond.timedWait(&expiration);
+    }
+  }
+}
+
+/* ******************************************* */
+
+void LocalHostCache::lua(lua_State *vm) {
+  lua_newtable(vm);
+
+  queue_lock.lock(__FILE__, __LINE__);
+
+  lua_push_uint32_table_entry(vm, "queued", requests.size());
+  lua_push_uint32_table_entry(vm, "max_queued", stats.max_queued);
+  lua_push_uint64_table_entry(vm, "num_restores", stats.num_restores);
+  lua_push_uint64_table_entry(vm, "num_restored", stats.num_restored);
+  lua_push_uint64_table_entry(vm, "num_saves", stats.num_saves);
+  lua_push_uint64_table_entry(vm, "num_deletes", stats.num_deletes);
+  lua_push_uint64_table_entry(vm, "num_inline", stats.num_inline);
+  lua_push_uint64_table_entry(vm, "num_full", stats.num_full);
+  lua_push_uint64_table_entry(vm, "num_dropped", stats.num_dropped);
+  lua_push_uint64_table_entry(vm, "restore_last_ms", stats.restore_last_ms);
+  lua_push_uint64_table_entry(vm, "restore_max_ms", stats.restore_max_ms);
+  lua_push_float_table_entry(vm, "restore_avg_ms",
+			     stats.num_restores ? ((float)stats.restore_total_ms / stats.num_restores) : 0);
+
+  queue_lock.unlock(__FILE__, __LINE__);
+
+  lua_pushstring(vm, "local_host_cache");
+  lua_insert(vm, -2);
+  lua_settable(vm, -3);
+}
+
+/* ******************************************* */
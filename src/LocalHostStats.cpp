@@ -24,66 +24,38 @@
 /* *************************************** */
 
 LocalHostStats::LocalHostStats(Host *_host) : HostStats(_host) {
-  top_sites = new (std::nothrow) MostVisitedList(HOST_SITES_TOP_NUMBER);
-
-  dns  = new (std::nothrow) DnsStats();
-  http = new (std::nothrow) HTTPstats(_host);
-  icmp = new (std::nothrow) ICMPstats();
-  peers = new (std::nothrow) PeerStats(MAX_DYNAMIC_STATS_VALUES /* 10 as default */ );
+  /*
+    Protocol details are allocated on first use (see alloc*()), most
+    local hosts never speak DNS, HTTP or ICMP nor visit any site
+  */
+  top_sites = NULL;
+  dns = NULL, http = NULL, icmp = NULL;
+  peers = NULL;
 
   nextPeriodicUpdate = 0;
   num_contacts_as_cli = num_contacts_as_srv = 0;
-  
-  num_contacted_hosts_as_client.init(8);       /* 128 bytes */
-  num_host_contacts_as_server.init(8);         /* 128 bytes */
-  num_contacted_services_as_client.init(8);    /* 128 bytes */
-  num_contacted_ports_as_client.init(4);       /* 16 bytes  */
-  num_host_contacted_ports_as_server.init(4);  /* 16 bytes  */
-  contacts_as_cli.init(4);                     /* 16 bytes  */
-  contacts_as_srv.init(4);                     /* 16 bytes  */
-
-  /* hll init, 8 bits -> 256 bytes per LocalHost */
-  if(ndpi_hll_init(&hll_contacted_hosts, 8) != 0)
-    throw "Failed HLL initialization";  
   hll_delta_value = 0, old_hll_value = 0, new_hll_value = 0;
-
-  /* hll init, 5 bits -> 32 bytes per LocalHost */
-  if(ndpi_hll_init(&hll_countries_contacts, 5) != 0)
-    throw "Failed HLL initialization";  
   old_hll_countries_value = 0, new_hll_countries_value = 0, hll_delta_countries_value = 0;
+  domain_names_reset_req = false;
 
-  num_dns_servers.init(5);
-  num_smtp_servers.init(5);
-  num_ntp_servers.init(5);
-  num_contacted_domain_names.init(4);
+  initCardinalities();
 }
 
 /* *************************************** */
 
 LocalHostStats::LocalHostStats(LocalHostStats &s) : HostStats(s) {
-  top_sites = new (std::nothrow) MostVisitedList(HOST_SITES_TOP_NUMBER);
-  peers = new (std::nothrow) PeerStats(MAX_DYNAMIC_STATS_VALUES /* 10 as default */ );
+  top_sites = NULL;
+  peers = NULL;
   dns = s.getDNSstats() ? new (std::nothrow) DnsStats(*s.getDNSstats()) : NULL;
   http = NULL;
   icmp = NULL;
   nextPeriodicUpdate = 0;
   num_contacts_as_cli = num_contacts_as_srv = 0;
-
-  /* hll init, 8 bits -> 256 bytes per LocalHost */
-  if(ndpi_hll_init(&hll_contacted_hosts, 8))
-    throw "Failed HLL initialization";
   hll_delta_value = 0, old_hll_value = 0, new_hll_value = 0;
+  old_hll_countries_value = 0, new_hll_countries_value = 0, hll_delta_countries_value = 0;
+  domain_names_reset_req = false;
 
-  /* hll init, 5 bits -> 32 bytes per LocalHost */
-  if(ndpi_hll_init(&hll_countries_contacts, 5) != 0)
-    throw "Failed HLL initialization";
-  old_hll_countries_value = 0, new_hll_countries_value = 0, hll_delta_countries_value = 0;  
-  
-  
-  num_dns_servers.init(5);
-  num_smtp_servers.init(5);
-  num_ntp_servers.init(5);
-  num_contacted_domain_names.init(4);
+  initCardinalities();
 }
 
 /* *************************************** */
@@ -94,9 +66,59 @@ LocalHostStats::~LocalHostStats() {
   if(http)                delete http;
   if(icmp)                delete icmp;
   if(peers)               delete(peers);
+}
+
+/* *************************************** */
 
-  ndpi_hll_destroy(&hll_contacted_hosts);
-  ndpi_hll_destroy(&hll_countries_contacts);
+/* Sketches registers are only allocated when the first element is added */
+void LocalHostStats::initCardinalities() {
+  num_contacted_hosts_as_client.init(LOCAL_HOST_HLL_BITS);
+  num_host_contacts_as_server.init(LOCAL_HOST_HLL_BITS);
+  num_contacted_services_as_client.init(LOCAL_HOST_HLL_BITS);
+  num_contacted_ports_as_client.init(4);       /* 16 bytes  */
+  num_host_contacted_ports_as_server.init(4);  /* 16 bytes  */
+  contacts_as_cli.init(4);                     /* 16 bytes  */
+  contacts_as_srv.init(4);                     /* 16 bytes  */
+
+  hll_contacted_hosts.init(LOCAL_HOST_HLL_BITS);
+  hll_countries_contacts.init(5);              /* 32 bytes  */
+
+  num_dns_servers.init(5);
+  num_smtp_servers.init(5);
+  num_ntp_servers.init(5);
+  num_contacted_domain_names.init(4);
+}
+
+/* *************************************** */
+
+HTTPstats* LocalHostStats::allocHTTPstats() {
+  if(!http) http = new (std::nothrow) HTTPstats(host);
+
+  return(http);
+}
+
+/* *************************************** */
+
+DnsStats* LocalHostStats::allocDNSstats() {
+  if(!dns) dns = new (std::nothrow) DnsStats();
+
+  return(dns);
+}
+
+/* *************************************** */
+
+ICMPstats* LocalHostStats::allocICMPstats() {
+  if(!icmp) icmp = new (std::nothrow) ICMPstats();
+
+  return(icmp);
+}
+
+/* *************************************** */
+
+MostVisitedList* LocalHostStats::allocTopSites() {
+  if(!top_sites) top_sites = new (std::nothrow) MostVisitedList(HOST_SITES_TOP_NUMBER);
+
+  return(top_sites);
 }
 
 /* *************************************** */
@@ -109,11 +131,11 @@ void LocalHostStats::incrVisitedWebSite(char *hostname) {
      && (sscanf(hostname, "%u.%u.%u.%u", &ip4_0, &ip4_1, &ip4_2, &ip4_3) != 4)
      ) {
     /* HyperLogLog update regarding visited sites */
-    ndpi_hll_add(&hll_contacted_hosts, hostname, strlen(hostname));
+    hll_contacted_hosts.addElement(hostname, strlen(hostname));
     
     /* Top Sites update, done only if the preference is enabled */
-    if(top_sites
-       && ntop->getPrefs()->are_top_talkers_enabled()) {
+    if(ntop->getPrefs()->are_top_talkers_enabled()
+       && allocTopSites()) {
       if(ntop->isATrackerHost(hostname)) {
 	ntop->getTrace()->traceEvent(TRACE_INFO, "[TRACKER] %s", hostname);
 	return; /* Ignore trackers */
@@ -170,6 +192,11 @@ void LocalHostStats::updateStats(const struct timeval *tv) {
 
 void LocalHostStats::updateHostContacts() {
   num_contacts_as_cli = contacts_as_cli.getEstimate(), num_contacts_as_srv = contacts_as_srv.getEstimate();
+
+  /* Hosts that never had a contact don't need the peers window */
+  if(!peers && (num_contacts_as_cli || num_contacts_as_srv))
+    peers = new (std::nothrow) PeerStats(MAX_DYNAMIC_STATS_VALUES /* 10 as default */ );
+
   if(peers) {
     peers->addElement(num_contacts_as_cli, true);
     peers->addElement(num_contacts_as_srv, false);
@@ -180,6 +207,13 @@ void LocalHostStats::updateHostContacts() {
 /* *************************************** */
 
 void LocalHostStats::getJSONObject(json_object *my_object, DetailsLevel details_level) {
+  getCountersJSONObject(my_object, details_level);
+  addRedisSitesKey();
+}
+
+/* *************************************** */
+
+void LocalHostStats::getCountersJSONObject(json_object *my_object, DetailsLevel details_level) {
   HostStats::getJSONObject(my_object, details_level);
 
   if(dns)  json_object_object_add(my_object, "dns", dns->getJSONObject());
@@ -188,8 +222,6 @@ void LocalHostStats::getJSONObject(json_object *my_object, DetailsLevel details_
   /* UDP stats */
   if(udp_sent_unicast) json_object_object_add(my_object, "udpBytesSent.unicast", json_object_new_int64(udp_sent_unicast));
   if(udp_sent_non_unicast) json_object_object_add(my_object, "udpBytesSent.non_unicast", json_object_new_int64(udp_sent_non_unicast));
-
-  addRedisSitesKey();
 }
 
 /* *************************************** */
@@ -264,6 +296,38 @@ void LocalHostStats::lua(lua_State* vm, bool mask_host, DetailsLevel details_lev
 
 /* *************************************** */
 
+/* Adds to the table on top of the stack the bytes used by these stats, returns the total */
+u_int32_t LocalHostStats::luaMemory(lua_State *vm) {
+  u_int32_t dns_bytes = dns ? sizeof(DnsStats) : 0;
+  u_int32_t http_bytes = http ? sizeof(HTTPstats) : 0;
+  u_int32_t icmp_bytes = icmp ? sizeof(ICMPstats) : 0;
+  u_int32_t top_sites_bytes = top_sites ? sizeof(MostVisitedList) : 0;
+  u_int32_t peers_bytes = peers ? peers->getMemoryUsage() : 0;
+  u_int32_t hll_bytes, tot;
+
+  hll_bytes = num_dns_servers.getMemoryUsage() + num_smtp_servers.getMemoryUsage()
+    + num_ntp_servers.getMemoryUsage() + num_contacted_domain_names.getMemoryUsage()
+    + hll_contacted_hosts.getMemoryUsage() + hll_countries_contacts.getMemoryUsage()
+    + num_contacted_hosts_as_client.getMemoryUsage() + num_host_contacts_as_server.getMemoryUsage()
+    + num_contacted_services_as_client.getMemoryUsage() + num_contacted_ports_as_client.getMemoryUsage()
+    + num_host_contacted_ports_as_server.getMemoryUsage()
+    + contacts_as_cli.getMemoryUsage() + contacts_as_srv.getMemoryUsage();
+
+  tot = sizeof(*this) + dns_bytes + http_bytes + icmp_bytes + top_sites_bytes + peers_bytes + hll_bytes;
+
+  lua_push_uint32_table_entry(vm, "stats", sizeof(*this));
+  lua_push_uint32_table_entry(vm, "dns", dns_bytes);
+  lua_push_uint32_table_entry(vm, "http", http_bytes);
+  lua_push_uint32_table_entry(vm, "icmp", icmp_bytes);
+  lua_push_uint32_table_entry(vm, "top_sites", top_sites_bytes);
+  lua_push_uint32_table_entry(vm, "peers", peers_bytes);
+  lua_push_uint32_table_entry(vm, "cardinality", hll_bytes);
+
+  return(tot);
+}
+
+/* *************************************** */
+
 void LocalHostStats::luaPeers(lua_State *vm) {
   if (peers) {
     if (peers->getSlidingWinStatus()) {
@@ -320,11 +384,11 @@ void LocalHostStats::deserialize(json_object *o) {
   if(json_object_object_get_ex(o, "total_activity_time", &obj))  total_activity_time = json_object_get_int(obj);
 
   if(json_object_object_get_ex(o, "dns", &obj)) {
-    if(dns) dns->deserialize(obj);
+    if(allocDNSstats()) dns->deserialize(obj);
   }
 
   if(json_object_object_get_ex(o, "http", &obj)) {
-    if(http) http->deserialize(obj);
+    if(allocHTTPstats()) http->deserialize(obj);
   }
 
   if(json_object_object_get_ex(o, "pktStats.sent", &obj)) sent_stats.deserialize(obj);
@@ -415,6 +479,9 @@ void LocalHostStats::removeRedisSitesKey() {
   if(!host->get_mac() && !host->get_ip())
     return;
 
+  if(!ntop->getPrefs()->are_top_talkers_enabled() || !allocTopSites())
+    return;
+
   /* String like `_1.1.1.1@2` */
   snprintf(additional_key_info, sizeof(additional_key_info), "%s_", host->get_tskey(additional_key_info, sizeof(additional_key_info)));
   /* Deserializing the info */
@@ -427,7 +494,7 @@ void LocalHostStats::removeRedisSitesKey() {
 void LocalHostStats::addRedisSitesKey() {
   char additional_key_info[128];
 
-  if(!host->get_mac() && !host->get_ip())
+  if(!top_sites || (!host->get_mac() && !host->get_ip()))
     return;
 
   /* String like `_1.1.1.1@2` */
@@ -445,7 +512,7 @@ void LocalHostStats::resetTopSitesData() {
   if(!host->get_mac() && !host->get_ip())
     return;
   
-  if(!host->getInterface())
+  if(!host->getInterface() || !top_sites)
     return;
 
   /* String like `_1.1.1.1@2` */
@@ -458,7 +525,7 @@ void LocalHostStats::resetTopSitesData() {
 void LocalHostStats::updateContactedHostsBehaviour() {
   /* Update the old and new hll value and do the delta */
   old_hll_value = new_hll_value;
-  new_hll_value = ndpi_hll_count(&hll_contacted_hosts);
+  new_hll_value = hll_contacted_hosts.getEstimate();
   hll_delta_value = abs(new_hll_value - old_hll_value);
 
 #ifdef TRACE_ME
@@ -467,7 +534,7 @@ void LocalHostStats::updateContactedHostsBehaviour() {
   ntop->getTrace()->traceEvent(TRACE_NORMAL, "%s / %f contacts",
 			       host->get_ip()->print(buf, sizeof(buf)),
 			       last_hll_contacted_hosts_value);
-  ndpi_hll_reset(&hll_contacted_hosts);
+  hll_contacted_hosts.reset();
 #endif
   
   contacted_hosts.addObservation((u_int64_t)hll_delta_value);
@@ -476,7 +543,7 @@ void LocalHostStats::updateContactedHostsBehaviour() {
 void LocalHostStats::updateCountriesContactsBehaviour() {
   /* Update the old and new hll value and do the delta */
   old_hll_countries_value = new_hll_countries_value;
-  new_hll_countries_value = ndpi_hll_count(&hll_countries_contacts);
+  new_hll_countries_value = hll_countries_contacts.getEstimate();
   hll_delta_countries_value = abs(new_hll_countries_value - old_hll_countries_value);
 
 #ifdef TRACE_ME
@@ -485,7 +552,7 @@ void LocalHostStats::updateCountriesContactsBehaviour() {
   ntop->getTrace()->traceEvent(TRACE_NORMAL, "%s / %f contacts",
 			       host->get_ip()->print(buf, sizeof(buf)),
 			       last_hll_countries_contacts_value);
-  ndpi_hll_reset(&hll_countries_contacts);
+  hll_countries_contacts.reset();
 #endif
 
   host->resetCountriesContacts();
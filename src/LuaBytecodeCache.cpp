@@ -0,0 +1,106 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "ntop_includes.h"
+
+/* ******************************************* */
+
+LuaBytecodeCache::LuaBytecodeCache() {
+  num_hits = num_misses = tot_bytes = 0;
+}
+
+/* ******************************************* */
+
+static int bytecode_writer(lua_State *L, const void *p, size_t sz, void *ud) {
+  ((std::string*)ud)->append((const char*)p, sz);
+  return(0);
+}
+
+/* ******************************************* */
+
+int LuaBytecodeCache::load(lua_State *L, const char *script_path) {
+  std::map<std::string, lua_bytecode_cache_entry_t>::iterator it;
+  lua_bytecode_cache_entry_t entry;
+  char chunkname[MAX_PATH];
+  struct stat buf;
+  int rc;
+
+  if(stat(script_path, &buf) != 0)
+    return(luaL_loadfile(L, script_path)); /* Let Lua report the error */
+
+  /* Same chunk name as luaL_loadfile, so errors report the script path */
+  snprintf(chunkname, sizeof(chunkname), "@%s", script_path);
+
+  lock.rdlock(__FILE__, __LINE__);
+
+  if(((it = entries.find(script_path)) != entries.end())
+     && (it->second.mtime == buf.st_mtime)
+     && (it->second.size == buf.st_size)) {
+    rc = luaL_loadbufferx(L, it->second.bytecode.data(), it->second.bytecode.size(), chunkname, "b");
+    num_hits++;
+    lock.unlock(__FILE__, __LINE__);
+
+    return(rc);
+  }
+
+  lock.unlock(__FILE__, __LINE__);
+
+  /* Not cached or changed on disk */
+  if((rc = luaL_loadfile(L, script_path)) != LUA_OK)
+    return(rc);
+
+  entry.mtime = buf.st_mtime, entry.size = buf.st_size;
+
+  /* Debug info is kept (no strip) to have line numbers in errors */
+  if(lua_dump(L, bytecode_writer, &entry.bytecode, 0) != 0)
+    return(rc);
+
+  lock.wrlock(__FILE__, __LINE__);
+
+  if((it = entries.find(script_path)) != entries.end())
+    tot_bytes -= it->second.bytecode.size();
+
+  tot_bytes += entry.bytecode.size();
+  entries[script_path] = entry;
+  num_misses++;
+
+  lock.unlock(__FILE__, __LINE__);
+
+  return(rc);
+}
+
+/* ******************************************* */
+
+void LuaBytecodeCache::lua(lua_State *vm) {
+  lock.rdlock(__FILE__, __LINE__);
+
+  lua_newtable(vm);
+  lua_push_uint64_table_entry(vm, "num_hits", num_hits);
+  lua_push_uint64_table_entry(vm, "num_misses", num_misses);
+  lua_push_uint64_table_entry(vm, "num_entries", entries.size());
+  lua_push_uint64_table_entry(vm, "bytes", tot_bytes);
+
+  lock.unlock(__FILE__, __LINE__);
+
+  lua_pushstring(vm, "bytecode_cache");
+  lua_insert(vm, -2);
+  lua_settable(vm, -3);
+}
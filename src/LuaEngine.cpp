@@ -88,6 +88,7 @@ LuaEngine::LuaEngine(lua_State *vm) {
   void *ctx;
 
   loaded_script_path = NULL;
+  http_vm_ready = false, bytecode_cache = NULL, num_http_requests = 0;
 
   L = luaL_newstate();
 
@@ -125,43 +126,50 @@ LuaEngine::~LuaEngine() {
     ctx = getLuaVMContext(L);
 
     if(ctx) {
+      cleanupContext(ctx);
+      free(ctx);
+    }
+
+    lua_close(L);
+  }
+
+  if(loaded_script_path) free(loaded_script_path);
+}
+
+/* ******************************* */
+
+/* Releases what the scripts have allocated into the context */
+void LuaEngine::cleanupContext(struct ntopngLuaContext *ctx) {
 #ifndef HAVE_NEDGE
-      if(ctx->snmpBatch) delete ctx->snmpBatch;
+  if(ctx->snmpBatch) delete ctx->snmpBatch;
 
-      for(u_int8_t slot_id=0; slot_id<MAX_NUM_ASYNC_SNMP_ENGINES; slot_id++) {
-	if(ctx->snmpAsyncEngine[slot_id] != NULL)
-	  delete ctx->snmpAsyncEngine[slot_id];
-      }
+  for(u_int8_t slot_id=0; slot_id<MAX_NUM_ASYNC_SNMP_ENGINES; slot_id++) {
+    if(ctx->snmpAsyncEngine[slot_id] != NULL)
+      delete ctx->snmpAsyncEngine[slot_id];
+  }
 #endif
 
-      if(ctx->pkt_capture.end_capture > 0) {
-	ctx->pkt_capture.end_capture = 0; /* Force stop */
-	pthread_join(ctx->pkt_capture.captureThreadLoop, NULL);
-      }
+  if(ctx->pkt_capture.end_capture > 0) {
+    ctx->pkt_capture.end_capture = 0; /* Force stop */
+    pthread_join(ctx->pkt_capture.captureThreadLoop, NULL);
+  }
 
-      if((ctx->iface != NULL) && ctx->live_capture.pcaphdr_sent)
-	ctx->iface->deregisterLiveCapture(ctx);
+  if((ctx->iface != NULL) && ctx->live_capture.pcaphdr_sent)
+    ctx->iface->deregisterLiveCapture(ctx);
 
-      if(ctx->addr_tree != NULL)
-        delete ctx->addr_tree;
+  if(ctx->addr_tree != NULL)
+    delete ctx->addr_tree;
 
-      if(ctx->sqlite_hosts_filter)
-	free(ctx->sqlite_hosts_filter);
+  if(ctx->sqlite_hosts_filter)
+    free(ctx->sqlite_hosts_filter);
 
-      if(ctx->sqlite_flows_filter)
-	free(ctx->sqlite_flows_filter);
+  if(ctx->sqlite_flows_filter)
+    free(ctx->sqlite_flows_filter);
 
 #if defined(NTOPNG_PRO)
-      if(ctx->bin)
-	delete ctx->bin;
+  if(ctx->bin)
+    delete ctx->bin;
 #endif
-      free(ctx);
-    }
-
-    lua_close(L);
-  }
-
-  if(loaded_script_path) free(loaded_script_path);
 }
 
 /* ****************************************** */
@@ -454,6 +462,133 @@ static int ntop_lua_loadfile(lua_State* L) {
 
 /* ****************************************** */
 
+/*
+  Replaces the standard Lua files searcher of require(), so that modules
+  are loaded from the bytecode cache passed as upvalue
+*/
+static int ntop_lua_cached_searcher(lua_State* L) {
+  LuaBytecodeCache *cache = (LuaBytecodeCache*)lua_touserdata(L, lua_upvalueindex(1));
+  const char *name = luaL_checkstring(L, 1), *filename;
+
+  lua_getglobal(L, "package");
+  lua_getfield(L, -1, "searchpath");
+  lua_pushstring(L, name);
+  lua_getfield(L, -3, "path");
+  lua_call(L, 2, 2);
+
+  if(lua_isnil(L, -2))
+    return(1); /* The error message listing the paths tried */
+
+  lua_pop(L, 1);
+  filename = lua_tostring(L, -1);
+
+  if(cache->load(L, filename) != LUA_OK)
+    return(luaL_error(L, "error loading module '%s' from file '%s':\n\t%s",
+		      name, filename, lua_tostring(L, -1)));
+
+  lua_pushvalue(L, -2); /* The file name is passed to the module */
+
+  return(2);
+}
+
+/* ****************************************** */
+
+/*
+  Saves a copy of the table at idx, and of every table reachable from it, in the
+  table at snapshots ([table] = copy). Library and module tables are saved too,
+  so that changes made in place by a request (e.g. string.foo = ...) can be undone.
+*/
+static void snapshot_tables(lua_State* L, int idx, int snapshots) {
+  int copy;
+
+  idx = lua_absindex(L, idx), snapshots = lua_absindex(L, snapshots);
+  luaL_checkstack(L, 8, "snapshot_tables");
+
+  lua_pushvalue(L, idx);
+  lua_rawget(L, snapshots);
+
+  if(!lua_isnil(L, -1)) {
+    lua_pop(L, 1);
+    return; /* Already saved, e.g. _G._G */
+  }
+
+  lua_pop(L, 1);
+
+  lua_newtable(L);
+  copy = lua_gettop(L);
+
+  lua_pushvalue(L, idx);
+  lua_pushvalue(L, copy);
+  lua_rawset(L, snapshots);
+
+  lua_pushnil(L);
+
+  while(lua_next(L, idx) != 0) {
+    if(lua_type(L, -1) == LUA_TTABLE)
+      snapshot_tables(L, -1, snapshots);
+
+    lua_pushvalue(L, -2);
+    lua_insert(L, -2);
+    lua_rawset(L, copy);
+  }
+
+  lua_pop(L, 1);
+}
+
+/* ****************************************** */
+
+/* Brings the table at idx back to its copy at snapshot */
+static void restore_table(lua_State* L, int idx, int snapshot) {
+  idx = lua_absindex(L, idx), snapshot = lua_absindex(L, snapshot);
+
+  /* Remove the keys added after the snapshot (clearing fields while traversing is allowed) */
+  lua_pushnil(L);
+
+  while(lua_next(L, idx) != 0) {
+    lua_pop(L, 1);
+    lua_pushvalue(L, -1);
+    lua_rawget(L, snapshot);
+
+    if(lua_isnil(L, -1)) {
+      lua_pop(L, 1);
+      lua_pushvalue(L, -1);
+      lua_pushnil(L);
+      lua_rawset(L, idx);
+    } else
+      lua_pop(L, 1);
+  }
+
+  /* Restore the values overwritten after the snapshot */
+  lua_pushnil(L);
+
+  while(lua_next(L, snapshot) != 0) {
+    lua_pushvalue(L, -2);
+    lua_insert(L, -2);
+    lua_rawset(L, idx);
+  }
+}
+
+/* ****************************************** */
+
+/* Restores every table saved by snapshot_tables() in the registry table registry_key */
+static void restore_tables(lua_State* L, const char *registry_key) {
+  int snapshots;
+
+  lua_getfield(L, LUA_REGISTRYINDEX, registry_key);
+  snapshots = lua_gettop(L);
+
+  lua_pushnil(L);
+
+  while(lua_next(L, snapshots) != 0) {
+    restore_table(L, -2, -1);
+    lua_pop(L, 1);
+  }
+
+  lua_pop(L, 1);
+}
+
+/* ****************************************** */
+
 void LuaEngine::lua_register_classes(lua_State *L, bool http_mode) {
   if(!L) return;
 
@@ -595,16 +730,36 @@ int LuaEngine::run_loaded_script() {
       ntop->getTrace()->traceEvent(TRACE_WARNING, "Script failure [%s][%s]", loaded_script_path, err ? err : "");
     }
 
+    lua_pop(L, 1); /* The error, the chunk is left on the stack */
     rv = -2;
   }
 
-  lua_pop(L, 1);
-
   return(rv);
 }
 
 /* ****************************************** */
 
+/*
+  Undo the changes a run of the loaded script may have done to the context
+  (e.g., interface.select()) before running it again on the same VM.
+*/
+void LuaEngine::reset_script_context(NetworkInterface *iface) {
+  struct ntopngLuaContext *c = getLuaVMContext(L);
+
+  if(c) {
+    c->iface = iface;
+    c->host = NULL, c->network = NULL, c->flow = NULL;
+    c->observationPointId = 0;
+
+    if(c->addr_tree) {
+      delete c->addr_tree;
+      c->addr_tree = NULL;
+    }
+  }
+}
+
+/* ****************************************** */
+
 /* http://www.geekhideout.com/downloads/urlcode.c */
 
 #if 0
@@ -957,8 +1112,10 @@ int LuaEngine::handle_script_request(struct mg_connection *conn,
 
   if(!L) return(-1);
 
-  luaL_openlibs(L); /* Load base libraries */
-  lua_register_classes(L, true); /* Load custom classes */
+  if(!http_vm_ready) {
+    luaL_openlibs(L); /* Load base libraries */
+    lua_register_classes(L, true); /* Load custom classes */
+  }
 
   getLuaVMUservalue(L, conn) = conn;
 
@@ -1246,7 +1403,7 @@ int LuaEngine::handle_script_request(struct mg_connection *conn,
     rc = __ntop_lua_handlefile(L, script_path, true);
   else
 #endif
-    rc = luaL_dofile(L, script_path);
+    rc = run_http_file(script_path);
 
   if(rc != 0) {
     const char *err = lua_tostring(L, -1);
@@ -1260,6 +1417,86 @@ int LuaEngine::handle_script_request(struct mg_connection *conn,
 
 /* ****************************************** */
 
+/* Same as luaL_dofile, using the compiled chunk when cached */
+int LuaEngine::run_http_file(char *script_path) {
+  int rc;
+
+  if(!bytecode_cache)
+    return(luaL_dofile(L, script_path));
+
+  if((rc = bytecode_cache->load(L, script_path)) != LUA_OK)
+    return(rc);
+
+  return(lua_pcall(L, 0, LUA_MULTRET, 0));
+}
+
+/* ****************************************** */
+
+/*
+  Prepares the VM to serve HTTP requests: libraries and classes are loaded
+  once, then the globals are saved so that reset_http_vm() can bring every
+  request back to this state.
+*/
+void LuaEngine::init_http_vm(LuaBytecodeCache *cache) {
+  luaL_openlibs(L); /* Load base libraries */
+  lua_register_classes(L, true); /* Load custom classes */
+
+  bytecode_cache = cache;
+
+#if defined(NTOPNG_PRO) || defined(HAVE_NEDGE)
+  if(!ntop->getPro()->has_valid_license())
+#endif
+  {
+    if(bytecode_cache) {
+      lua_getglobal(L, "package");
+      lua_getfield(L, -1, "searchers");
+      lua_pushlightuserdata(L, bytecode_cache);
+      lua_pushcclosure(L, ntop_lua_cached_searcher, 1);
+      lua_rawseti(L, -2, 2); /* Replaces the Lua files searcher */
+      lua_pop(L, 2);
+    }
+  }
+
+  lua_newtable(L);
+  lua_pushglobaltable(L);
+  snapshot_tables(L, -1, -2);
+  lua_pop(L, 1);
+  lua_getfield(L, LUA_REGISTRYINDEX, LUA_LOADED_TABLE);
+  snapshot_tables(L, -1, -2);
+  lua_pop(L, 1);
+  lua_setfield(L, LUA_REGISTRYINDEX, "ntopng.http_snapshots");
+
+  http_vm_ready = true;
+}
+
+/* ****************************************** */
+
+/*
+  Brings the VM back to the state saved by init_http_vm() once a request is over:
+  globals (_GET, _POST, _SESSION...) and modules set by the request are dropped
+  and the context (user, interface, allowed networks...) is cleared.
+  Returns false when the VM can't be reused and must be deleted.
+*/
+bool LuaEngine::reset_http_vm() {
+  struct ntopngLuaContext *ctx = getLuaVMContext(L);
+
+  if(!http_vm_ready || !ctx
+     || (ctx->pkt_capture.end_capture > 0) || ctx->live_capture.pcaphdr_sent /* Bound to the connection */
+     || (++num_http_requests >= HTTP_LUA_VM_MAX_REQUESTS))
+    return(false);
+
+  cleanupContext(ctx);
+  memset(ctx, 0, sizeof(struct ntopngLuaContext));
+
+  lua_settop(L, 0);
+
+  restore_tables(L, "ntopng.http_snapshots");
+
+  return(true);
+}
+
+/* ****************************************** */
+
 void LuaEngine::setHost(Host* h) {
   struct ntopngLuaContext *c = getLuaVMContext(L);
 
@@ -1081,12 +1081,9 @@ static int ntop_get_zmq_flow_field_descr(lua_State* vm) {
   if((ntop_lua_check(vm, __FUNCTION__, 1, LUA_TSTRING) != CONST_LUA_OK))
     return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_ERROR));
 
-  char *key = (char*)lua_tostring(vm, 1);
-  u_int32_t pen = UNKNOWN_PEN, field = UNKNOWN_FLOW_ELEMENT;
-  const char *descr;
+  const char *descr = zmq_ntop_interface->lookupKeyDescription(lua_tostring(vm, 1));
 
-  if(zmq_ntop_interface->getKeyId((char*)key, strlen(key), &pen, &field)
-     && (descr = zmq_ntop_interface->getKeyDescription(pen, field)))
+  if(descr)
     lua_pushstring(vm, descr);
 
   return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_OK));
@@ -2246,6 +2243,29 @@ static int ntop_get_interface_host_country(lua_State* vm) {
 
 /* ****************************************** */
 
+static int ntop_get_interface_host_memory_usage(lua_State* vm) {
+  NetworkInterface *ntop_interface = getCurrentInterface(vm);
+  char *host_ip;
+  VLANid vlan_id = 0;
+  char buf[64];
+  Host* h = NULL;
+
+  ntop->getTrace()->traceEvent(TRACE_DEBUG, "%s() called", __FUNCTION__);
+
+  if(ntop_lua_check(vm, __FUNCTION__, 1, LUA_TSTRING) != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_ERROR));
+  get_host_vlan_info((char*)lua_tostring(vm, 1), &host_ip, &vlan_id, buf, sizeof(buf));
+
+  if((!ntop_interface) || ((h = ntop_interface->findHostByIP(get_allowed_nets(vm), host_ip, vlan_id, getLuaVMUservalue(vm, observationPointId))) == NULL))
+    return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_ERROR));
+  else {
+    /* nil for remote hosts */
+    h->lua_memory_stats(vm);
+    return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_OK));
+  }
+}
+
+/* ****************************************** */
+
 static int ntop_prepare_delete_interface_observation_point(lua_State* vm) {
   NetworkInterface *ntop_interface = getCurrentInterface(vm);
   u_int16_t obs_point_id;
@@ -2889,6 +2909,35 @@ static int ntop_update_lbd_identifier(lua_State* vm) {
 
 /* ****************************************** */
 
+static int ntop_update_flow_indexes(lua_State* vm) {
+  NetworkInterface *ntop_interface = getCurrentInterface(vm);
+
+  ntop->getTrace()->traceEvent(TRACE_DEBUG, "%s() called", __FUNCTION__);
+
+  if(ntop_interface)
+    ntop_interface->updateFlowIndexes();
+
+  lua_pushnil(vm);
+  return CONST_LUA_OK;
+}
+
+/* ****************************************** */
+
+static int ntop_get_flow_indexes_stats(lua_State* vm) {
+  NetworkInterface *ntop_interface = getCurrentInterface(vm);
+
+  ntop->getTrace()->traceEvent(TRACE_DEBUG, "%s() called", __FUNCTION__);
+
+  if(!ntop_interface)
+    return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_ERROR));
+
+  ntop_interface->luaFlowIndexes(vm);
+
+  return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_OK));
+}
+
+/* ****************************************** */
+
 static int ntop_update_discard_probing_traffic(lua_State* vm) {
   NetworkInterface *ntop_interface = getCurrentInterface(vm);
 
@@ -3442,6 +3491,20 @@ static int ntop_get_interface_queues_stats(lua_State* vm) {
 
 /* ****************************************** */
 
+/* Per flow check and hook: number of calls, flows skipped by the protocol/risk filters and CPU cycles */
+static int ntop_get_interface_flow_checks_stats(lua_State* vm) {
+  NetworkInterface *ntop_interface = getCurrentInterface(vm);
+
+  if(!ntop_interface)
+    return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_ERROR));
+
+  ntop_interface->luaFlowChecksStats(vm);
+
+  return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_OK));
+}
+
+/* ****************************************** */
+
 static int ntop_set_interface_periodic_activity_progress(lua_State* vm) {
   int progress;
   struct ntopngLuaContext *ctx = getLuaVMContext(vm);
@@ -4343,6 +4406,7 @@ static luaL_Reg _ntop_interface_reg[] = {
 
   /* Functions related to the management of per-interface queues */
   { "getQueuesStats",           ntop_get_interface_queues_stats },
+  { "getFlowChecksStats",       ntop_get_interface_flow_checks_stats },
 
   /* Functions related to the management of the internal hash tables */
   { "getHashTablesStats",       ntop_get_interface_hash_tables_stats },
@@ -4383,6 +4447,7 @@ static luaL_Reg _ntop_interface_reg[] = {
   { "getHostInfo",              ntop_get_interface_host_info },
   { "getHostMinInfo",           ntop_get_interface_get_host_min_info },
   { "getHostCountry",           ntop_get_interface_host_country },
+  { "getHostMemoryUsage",       ntop_get_interface_host_memory_usage },
   { "addMacsIpAddresses",       ntop_add_macs_ip_addresses },
   { "getNetworksStats",         ntop_get_interface_networks_stats       },
   { "getNetworkStats",          ntop_get_interface_network_stats        },
@@ -4409,6 +4474,8 @@ static luaL_Reg _ntop_interface_reg[] = {
   { "updateLbdIdentifier",              ntop_update_lbd_identifier                   },
   { "updateHostTrafficPolicy",          ntop_update_host_traffic_policy              },
   { "updateDiscardProbingTraffic",      ntop_update_discard_probing_traffic          },
+  { "updateFlowIndexes",                ntop_update_flow_indexes                     },
+  { "getFlowIndexesStats",              ntop_get_flow_indexes_stats                  },
   { "updateFlowsOnlyInterface",         ntop_update_flows_only_interface             },
   { "getEndpoint",                      ntop_get_interface_endpoint },
   { "isPacketInterface",                ntop_interface_is_packet_interface },
@@ -728,6 +728,21 @@ static int ntop_reload_host_checks(lua_State* vm) {
 
 /* ****************************************** */
 
+static int ntop_get_host_checks_scheduler_stats(lua_State* vm) {
+  HostChecksScheduler *scheduler = ntop->getHostChecksScheduler();
+
+  ntop->getTrace()->traceEvent(TRACE_DEBUG, "%s() called", __FUNCTION__);
+
+  if(scheduler)
+    scheduler->lua(vm);
+  else
+    lua_pushnil(vm);
+
+  return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_OK));
+}
+
+/* ****************************************** */
+
 static int ntop_get_flow_alert_score(lua_State* vm) {
   FlowAlertTypeEnum alert_id;
 
@@ -4636,6 +4651,112 @@ static int ntop_llen_redis(lua_State* vm) {
 
 /* ****************************************** */
 
+static void ntop_push_redis_reply(lua_State* vm, redisReply *reply) {
+  switch(reply->type) {
+  case REDIS_REPLY_STRING:
+  case REDIS_REPLY_STATUS:
+    lua_pushlstring(vm, reply->str, reply->len);
+    break;
+
+  case REDIS_REPLY_INTEGER:
+    lua_pushinteger(vm, reply->integer);
+    break;
+
+  case REDIS_REPLY_ARRAY:
+    lua_newtable(vm);
+
+    for(size_t i = 0; i < reply->elements; i++) {
+      ntop_push_redis_reply(vm, reply->element[i]);
+      lua_rawseti(vm, -2, i + 1);
+    }
+    break;
+
+  default: /* REDIS_REPLY_NIL, REDIS_REPLY_ERROR (already traced) */
+    lua_pushnil(vm);
+    break;
+  }
+}
+
+/* ****************************************** */
+
+/*
+  ntop.pipelineCache({ {"SET", "k", "v"}, {"EXPIRE", "k", 60}, {"GET", "k"} })
+  sends all the commands in a single round trip and returns their replies
+  in the same order (nil for missing keys and failed commands)
+*/
+static int ntop_pipeline_redis(lua_State* vm) {
+  Redis *redis = ntop->getRedis();
+  redis_pipeline_cmd_t *cmds;
+  std::vector<std::string> args;
+  u_int num_cmds;
+
+  ntop->getTrace()->traceEvent(TRACE_DEBUG, "%s() called", __FUNCTION__);
+
+  if(ntop_lua_check(vm, __FUNCTION__, 1, LUA_TTABLE) != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_ERROR));
+
+  num_cmds = (u_int)lua_rawlen(vm, 1);
+
+  if((num_cmds == 0) || (num_cmds > REDIS_PIPELINE_MAX_CMDS))
+    return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_PARAM_ERROR));
+
+  if((cmds = new (std::nothrow) redis_pipeline_cmd_t[num_cmds]) == NULL)
+    return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_ERROR));
+
+  /* argv points to the strings stored here: they must never be reallocated */
+  args.reserve(num_cmds * REDIS_PIPELINE_MAX_ARGS);
+
+  for(u_int i = 0; i < num_cmds; i++) {
+    u_int argc;
+
+    lua_rawgeti(vm, 1, i + 1);
+
+    if((lua_type(vm, -1) != LUA_TTABLE)
+       || ((argc = (u_int)lua_rawlen(vm, -1)) == 0)
+       || (argc > REDIS_PIPELINE_MAX_ARGS)) {
+      delete[] cmds;
+      return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_PARAM_ERROR));
+    }
+
+    cmds[i].argc = argc;
+
+    for(u_int j = 0; j < argc; j++) {
+      const char *arg;
+      size_t len;
+
+      lua_rawgeti(vm, -1, j + 1);
+
+      if((arg = lua_tolstring(vm, -1, &len)) == NULL) {
+	delete[] cmds;
+	return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_PARAM_ERROR));
+      }
+
+      args.push_back(std::string(arg, len));
+      cmds[i].argv[j] = args.back().c_str(), cmds[i].argvlen[j] = len;
+      lua_pop(vm, 1);
+    }
+
+    lua_pop(vm, 1);
+  }
+
+  redis->pipeline(cmds, num_cmds);
+
+  lua_newtable(vm);
+
+  for(u_int i = 0; i < num_cmds; i++) {
+    if(cmds[i].reply) {
+      ntop_push_redis_reply(vm, cmds[i].reply);
+      lua_rawseti(vm, -2, i + 1);
+      freeReplyObject(cmds[i].reply);
+    }
+  }
+
+  delete[] cmds;
+
+  return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_OK));
+}
+
+/* ****************************************** */
+
 static int ntop_redis_dump(lua_State* vm) {
   char *key, *dump;
   Redis *redis = ntop->getRedis();
@@ -5044,6 +5165,21 @@ static int ntop_is_gui_access_restricted(lua_State* vm) {
 
 /* ****************************************** */
 
+static int ntop_get_http_lua_vm_stats(lua_State* vm) {
+  LuaEnginePool *pool = ntop->get_HTTPserver() ? ntop->get_HTTPserver()->getLuaEnginePool() : NULL;
+
+  ntop->getTrace()->traceEvent(TRACE_DEBUG, "%s() called", __FUNCTION__);
+
+  if(!pool)
+    return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_ERROR));
+
+  pool->lua(vm);
+
+  return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_OK));
+}
+
+/* ****************************************** */
+
 static int ntop_service_restart(lua_State* vm) {
 #if defined(__linux__) && defined(NTOPNG_PRO)
   extern AfterShutdownAction afterShutdownAction;
@@ -5435,6 +5571,295 @@ static int ntop_rrd_inc_num_drops(lua_State* vm) {
 
 /* ****************************************** */
 
+/*
+  Hands a batch of RRD updates to the RRDWriteEngine. The batch is a flat
+  array of { <rrd path>, "<timestamp>:<value>[:<value>...]", ... }.
+  Returns the number of updates accepted, nil when the RRDs must be
+  updated with ntop.rrd_update (--rrd-writers 0)
+*/
+static int ntop_rrd_update_batch(lua_State* vm) {
+  RRDWriteEngine *engine = ntop->getRRDWriteEngine();
+  std::vector<std::pair<std::string, std::string> > points;
+  size_t num_items;
+
+  if(ntop_lua_check(vm, __FUNCTION__, 1, LUA_TTABLE) != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_PARAM_ERROR));
+
+  if(!engine) {
+    lua_pushnil(vm);
+    return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_OK));
+  }
+
+  num_items = lua_rawlen(vm, 1);
+  points.reserve(num_items / 2);
+
+  for(size_t i = 1; i + 1 <= num_items; i += 2) {
+    const char *path, *update;
+
+    lua_rawgeti(vm, 1, i);
+    lua_rawgeti(vm, 1, i + 1);
+
+    path = lua_tostring(vm, -2), update = lua_tostring(vm, -1);
+
+    if(path && update)
+      points.push_back(std::make_pair(std::string(path), std::string(update)));
+
+    lua_pop(vm, 2);
+  }
+
+  lua_pushinteger(vm, engine->submit(points));
+  return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_OK));
+}
+
+/* ****************************************** */
+
+static int ntop_rrd_get_writer_stats(lua_State* vm) {
+  RRDWriteEngine *engine = ntop->getRRDWriteEngine();
+
+  if(engine)
+    engine->lua(vm);
+  else
+    lua_pushnil(vm);
+
+  return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_OK));
+}
+
+/* ****************************************** */
+
+/* Embedded timeseries store (tsdb driver). Series keys are built by the driver from the schema tags */
+static int ntop_tsdb_append(lua_State* vm) {
+  TimeseriesStore *store = ntop->getTimeseriesStore();
+  const char *schema, *key;
+  u_int32_t timestamp;
+  double values[UCHAR_MAX];
+  size_t num_metrics;
+
+  if(ntop_lua_check(vm, __FUNCTION__, 1, LUA_TSTRING) != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_PARAM_ERROR));
+  if(ntop_lua_check(vm, __FUNCTION__, 2, LUA_TSTRING) != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_PARAM_ERROR));
+  if(ntop_lua_check(vm, __FUNCTION__, 3, LUA_TNUMBER) != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_PARAM_ERROR));
+  if(ntop_lua_check(vm, __FUNCTION__, 4, LUA_TTABLE) != CONST_LUA_OK)  return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_PARAM_ERROR));
+
+  schema = lua_tostring(vm, 1), key = lua_tostring(vm, 2);
+  timestamp = (u_int32_t)lua_tonumber(vm, 3);
+
+  if(!store || ((num_metrics = lua_rawlen(vm, 4)) == 0) || (num_metrics > UCHAR_MAX)) {
+    lua_pushboolean(vm, false);
+    return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_OK));
+  }
+
+  for(size_t i = 0; i < num_metrics; i++) {
+    lua_rawgeti(vm, 4, i + 1);
+    values[i] = lua_tonumber(vm, -1);
+    lua_pop(vm, 1);
+  }
+
+  lua_pushboolean(vm, store->append(schema, key, timestamp, values, (u_int8_t)num_metrics));
+  return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_OK));
+}
+
+/* ****************************************** */
+
+/*
+  ntop.tsdb_fetch(schema, key, cf, tstart, tend, step, is_counter)
+  Returns start, step, {<values of each metric>}, count as ntop.rrd_fetch_columns,
+  nil when the series has no points in the range
+*/
+static int ntop_tsdb_fetch(lua_State* vm) {
+  TimeseriesStore *store = ntop->getTimeseriesStore();
+  const char *schema, *key, *cf;
+  TsConsolidation consolidation = ts_cf_average;
+  int rv;
+
+  if(ntop_lua_check(vm, __FUNCTION__, 1, LUA_TSTRING) != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_PARAM_ERROR));
+  if(ntop_lua_check(vm, __FUNCTION__, 2, LUA_TSTRING) != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_PARAM_ERROR));
+  if(ntop_lua_check(vm, __FUNCTION__, 3, LUA_TSTRING) != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_PARAM_ERROR));
+  if(ntop_lua_check(vm, __FUNCTION__, 4, LUA_TNUMBER) != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_PARAM_ERROR));
+  if(ntop_lua_check(vm, __FUNCTION__, 5, LUA_TNUMBER) != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_PARAM_ERROR));
+  if(ntop_lua_check(vm, __FUNCTION__, 6, LUA_TNUMBER) != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_PARAM_ERROR));
+
+  schema = lua_tostring(vm, 1), key = lua_tostring(vm, 2), cf = lua_tostring(vm, 3);
+
+  if(!strcmp(cf, "MIN"))       consolidation = ts_cf_min;
+  else if(!strcmp(cf, "MAX"))  consolidation = ts_cf_max;
+  else if(!strcmp(cf, "LAST")) consolidation = ts_cf_last;
+
+  if(store
+     && ((rv = store->fetch(vm, schema, key, (u_int32_t)lua_tonumber(vm, 4), (u_int32_t)lua_tonumber(vm, 5),
+			    (u_int32_t)lua_tonumber(vm, 6), consolidation,
+			    (lua_type(vm, 7) == LUA_TBOOLEAN) && lua_toboolean(vm, 7))) > 0))
+    return(rv);
+
+  lua_pushnil(vm);
+  return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_OK));
+}
+
+/* ****************************************** */
+
+static int ntop_tsdb_list_series(lua_State* vm) {
+  TimeseriesStore *store = ntop->getTimeseriesStore();
+
+  if(ntop_lua_check(vm, __FUNCTION__, 1, LUA_TSTRING) != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_PARAM_ERROR));
+  if(ntop_lua_check(vm, __FUNCTION__, 2, LUA_TNUMBER) != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_PARAM_ERROR));
+
+  if(store)
+    store->listSeries(vm, lua_tostring(vm, 1), (u_int32_t)lua_tonumber(vm, 2));
+  else
+    lua_newtable(vm);
+
+  return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_OK));
+}
+
+/* ****************************************** */
+
+static int ntop_tsdb_flush(lua_State* vm) {
+  TimeseriesStore *store = ntop->getTimeseriesStore();
+
+  if(store)
+    store->flush(false);
+
+  lua_pushnil(vm);
+  return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_OK));
+}
+
+/* ****************************************** */
+
+/*
+  ntop.tsdb_fetch_many(schema, {"<tag>=<value>", ...}, cf, tstart, tend, step, is_counter)
+  Returns start, step, {<key> = {<values of each metric>}, ...}, count for all the
+  series matching the filters, reading each segment once; nil when nothing matches
+*/
+static int ntop_tsdb_fetch_many(lua_State* vm) {
+  TimeseriesStore *store = ntop->getTimeseriesStore();
+  std::vector<std::string> filters;
+  const char *schema, *cf;
+  TsConsolidation consolidation = ts_cf_average;
+  size_t num_filters;
+  int rv;
+
+  if(ntop_lua_check(vm, __FUNCTION__, 1, LUA_TSTRING) != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_PARAM_ERROR));
+  if(ntop_lua_check(vm, __FUNCTION__, 2, LUA_TTABLE)  != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_PARAM_ERROR));
+  if(ntop_lua_check(vm, __FUNCTION__, 3, LUA_TSTRING) != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_PARAM_ERROR));
+  if(ntop_lua_check(vm, __FUNCTION__, 4, LUA_TNUMBER) != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_PARAM_ERROR));
+  if(ntop_lua_check(vm, __FUNCTION__, 5, LUA_TNUMBER) != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_PARAM_ERROR));
+  if(ntop_lua_check(vm, __FUNCTION__, 6, LUA_TNUMBER) != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_PARAM_ERROR));
+
+  schema = lua_tostring(vm, 1), cf = lua_tostring(vm, 3);
+  num_filters = lua_rawlen(vm, 2);
+
+  for(size_t i = 1; i <= num_filters; i++) {
+    const char *filter;
+
+    lua_rawgeti(vm, 2, i);
+    if((filter = lua_tostring(vm, -1)) != NULL)
+      filters.push_back(filter);
+    lua_pop(vm, 1);
+  }
+
+  if(!strcmp(cf, "MIN"))       consolidation = ts_cf_min;
+  else if(!strcmp(cf, "MAX"))  consolidation = ts_cf_max;
+  else if(!strcmp(cf, "LAST")) consolidation = ts_cf_last;
+
+  if(store
+     && ((rv = store->fetchMany(vm, schema, filters, (u_int32_t)lua_tonumber(vm, 4), (u_int32_t)lua_tonumber(vm, 5),
+				(u_int32_t)lua_tonumber(vm, 6), consolidation,
+				(lua_type(vm, 7) == LUA_TBOOLEAN) && lua_toboolean(vm, 7))) > 0))
+    return(rv);
+
+  lua_pushnil(vm);
+  return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_OK));
+}
+
+/* ****************************************** */
+
+/* ntop.tsdb_delete(schema_prefix, {"<tag>=<value>", ...}) */
+static int ntop_tsdb_delete(lua_State* vm) {
+  TimeseriesStore *store = ntop->getTimeseriesStore();
+  std::vector<std::string> filters;
+
+  if(ntop_lua_check(vm, __FUNCTION__, 1, LUA_TSTRING) != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_PARAM_ERROR));
+
+  if(lua_type(vm, 2) == LUA_TTABLE) {
+    size_t num_filters = lua_rawlen(vm, 2);
+
+    for(size_t i = 1; i <= num_filters; i++) {
+      const char *filter;
+
+      lua_rawgeti(vm, 2, i);
+      if((filter = lua_tostring(vm, -1)) != NULL)
+	filters.push_back(filter);
+      lua_pop(vm, 1);
+    }
+  }
+
+  lua_pushboolean(vm, store ? store->deleteSeries(lua_tostring(vm, 1), filters) : false);
+  return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_OK));
+}
+
+/* ****************************************** */
+
+static int ntop_tsdb_delete_old_data(lua_State* vm) {
+  TimeseriesStore *store = ntop->getTimeseriesStore();
+
+  if(ntop_lua_check(vm, __FUNCTION__, 1, LUA_TNUMBER) != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_PARAM_ERROR));
+
+  if(store)
+    store->deleteOldData((u_int32_t)lua_tonumber(vm, 1));
+
+  lua_pushnil(vm);
+  return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_OK));
+}
+
+/* ****************************************** */
+
+static int ntop_tsdb_get_stats(lua_State* vm) {
+  TimeseriesStore *store = ntop->getTimeseriesStore();
+
+  if(store)
+    store->lua(vm);
+  else
+    lua_pushnil(vm);
+
+  return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_OK));
+}
+
+/* ****************************************** */
+
+/* Set by the influxdb timeseries driver: points are posted there by the InfluxDBStreamer */
+static int ntop_influxdb_set_endpoint(lua_State* vm) {
+  InfluxDBStreamer *streamer = ntop->getInfluxDBStreamer();
+  const char *url, *db, *user = NULL, *pwd = NULL;
+
+  if(ntop_lua_check(vm, __FUNCTION__, 1, LUA_TSTRING) != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_PARAM_ERROR));
+  url = lua_tostring(vm, 1);
+
+  if(ntop_lua_check(vm, __FUNCTION__, 2, LUA_TSTRING) != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_PARAM_ERROR));
+  db = lua_tostring(vm, 2);
+
+  if(lua_type(vm, 3) == LUA_TSTRING) user = lua_tostring(vm, 3);
+  if(lua_type(vm, 4) == LUA_TSTRING) pwd = lua_tostring(vm, 4);
+
+  if(streamer)
+    streamer->setEndpoint(url, db, user, pwd);
+
+  lua_pushboolean(vm, streamer ? true : false);
+
+  return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_OK));
+}
+
+/* ****************************************** */
+
+static int ntop_influxdb_get_stream_stats(lua_State* vm) {
+  InfluxDBStreamer *streamer = ntop->getInfluxDBStreamer();
+
+  if(streamer)
+    streamer->lua(vm);
+  else
+    lua_pushnil(vm);
+
+  return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_OK));
+}
+
+/* ****************************************** */
+
 static int ntop_get_drop_pool_info(lua_State* vm) {
   lua_newtable(vm);
 
@@ -5834,26 +6259,62 @@ static int ntop_recipient_enqueue(lua_State* vm) {
 
 /* ****************************************** */
 
+static void ntop_push_recipient_notification(lua_State* vm, AlertFifoItem *notification) {
+  lua_newtable(vm);
+
+  lua_push_str_table_entry(vm, "alert", notification->alert);
+  lua_push_uint64_table_entry(vm, "score", notification->score);
+  lua_push_uint64_table_entry(vm, "alert_severity", notification->alert_severity);
+
+  notification->payload->decRefs();
+}
+
+/* ****************************************** */
+
 static int ntop_recipient_dequeue(lua_State* vm) {
   u_int16_t recipient_id;
   AlertFifoItem notification;
-  bool res;
 
   if(ntop_lua_check(vm, __FUNCTION__, 1, LUA_TNUMBER) != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_ERROR));
   recipient_id = lua_tointeger(vm, 1);
 
-  res = ntop->recipient_dequeue(recipient_id, &notification);
+  if(ntop->recipient_dequeue(recipient_id, &notification, 1) == 1)
+    ntop_push_recipient_notification(vm, &notification);
+  else
+    lua_pushnil(vm);
 
-  if(res && notification.alert) {
-    lua_newtable(vm);
+  return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_OK));
+}
 
-    lua_push_str_table_entry(vm, "alert", notification.alert);
-    lua_push_uint64_table_entry(vm, "score", notification.score);
-    lua_push_uint64_table_entry(vm, "alert_severity", notification.alert_severity);
+/* ****************************************** */
 
-    free(notification.alert);
-  } else
-    lua_pushnil(vm);
+/* Returns an array with up to max_notifications notifications (empty when there are none) */
+static int ntop_recipient_dequeue_batch(lua_State* vm) {
+  u_int16_t recipient_id;
+  u_int32_t max_notifications, num = 0;
+  AlertFifoItem notifications[ALERTS_NOTIFICATIONS_DEQUEUE_BATCH];
+
+  if(ntop_lua_check(vm, __FUNCTION__, 1, LUA_TNUMBER) != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_ERROR));
+  recipient_id = lua_tointeger(vm, 1);
+
+  if(ntop_lua_check(vm, __FUNCTION__, 2, LUA_TNUMBER) != CONST_LUA_OK) return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_ERROR));
+  max_notifications = (u_int32_t)lua_tointeger(vm, 2);
+
+  lua_newtable(vm);
+
+  while(num < max_notifications) {
+    u_int32_t n = ntop->recipient_dequeue(recipient_id, notifications,
+					  min_val(max_notifications - num, (u_int32_t)ALERTS_NOTIFICATIONS_DEQUEUE_BATCH));
+
+    for(u_int32_t i = 0; i < n; i++) {
+      lua_pushinteger(vm, ++num);
+      ntop_push_recipient_notification(vm, &notifications[i]);
+      lua_settable(vm, -3);
+    }
+
+    if(n < ALERTS_NOTIFICATIONS_DEQUEUE_BATCH)
+      break; /* Queue drained */
+  }
 
   return(ntop_lua_return_value(vm, __FUNCTION__, CONST_LUA_OK));
 }
@@ -6237,6 +6698,7 @@ static luaL_Reg _ntop_reg[] = {
   { "getKeysCache",      ntop_get_keys_redis },
   { "dumpCache",         ntop_redis_dump },
   { "restoreCache",      ntop_redis_restore },
+  { "pipelineCache",     ntop_pipeline_redis },
   { "addLocalNetwork",   ntop_add_local_network },
   { "setResolvedAddress",ntop_set_resolved_address },
 
@@ -6327,6 +6789,22 @@ static luaL_Reg _ntop_reg[] = {
   { "rrd_lastupdate",    ntop_rrd_lastupdate    },
   { "rrd_tune",          ntop_rrd_tune          },
   { "rrd_inc_num_drops", ntop_rrd_inc_num_drops },
+  { "rrd_update_batch",  ntop_rrd_update_batch  },
+  { "rrd_get_writer_stats", ntop_rrd_get_writer_stats },
+
+  /* Embedded timeseries store */
+  { "tsdb_append",          ntop_tsdb_append },
+  { "tsdb_fetch",           ntop_tsdb_fetch },
+  { "tsdb_fetch_many",      ntop_tsdb_fetch_many },
+  { "tsdb_list_series",     ntop_tsdb_list_series },
+  { "tsdb_flush",           ntop_tsdb_flush },
+  { "tsdb_delete",          ntop_tsdb_delete },
+  { "tsdb_delete_old_data", ntop_tsdb_delete_old_data },
+  { "tsdb_get_stats",       ntop_tsdb_get_stats },
+
+  /* InfluxDB */
+  { "influxdb_set_endpoint",     ntop_influxdb_set_endpoint },
+  { "influxdb_get_stream_stats", ntop_influxdb_get_stream_stats },
 
   /* Prefs */
   { "getPrefs",          ntop_get_prefs },
@@ -6369,6 +6847,7 @@ static luaL_Reg _ntop_reg[] = {
   { "getNetworkIdByName",   ntop_network_id_by_name },
   { "getNetworks",          ntop_get_networks },
   { "isGuiAccessRestricted", ntop_is_gui_access_restricted },
+  { "getHttpLuaVMStats",     ntop_get_http_lua_vm_stats },
   { "serviceRestart",       ntop_service_restart },
   { "getUserObservationPointId", ntop_get_user_observation_point_id },
 
@@ -6458,6 +6937,7 @@ static luaL_Reg _ntop_reg[] = {
   { "getMac64",              ntop_get_mac_64              },
   { "reloadFlowChecks",      ntop_reload_flow_checks      },
   { "reloadHostChecks",      ntop_reload_host_checks      },
+  { "getHostChecksSchedulerStats", ntop_get_host_checks_scheduler_stats },
   { "reloadAlertExclusions", ntop_reload_hosts_control    },
   { "getFlowAlertScore",     ntop_get_flow_alert_score    },
   { "getFlowAlertRisk",      ntop_get_flow_alert_risk     },
@@ -6506,6 +6986,7 @@ static luaL_Reg _ntop_reg[] = {
   /* Recipient queues */
   { "recipient_enqueue",             ntop_recipient_enqueue            },
   { "recipient_dequeue",             ntop_recipient_dequeue            },
+  { "recipient_dequeue_batch",       ntop_recipient_dequeue_batch      },
   { "recipient_stats",               ntop_recipient_stats              },
   { "recipient_last_use",            ntop_recipient_last_use           },
   { "recipient_delete",              ntop_recipient_delete             },
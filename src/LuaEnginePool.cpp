@@ -0,0 +1,161 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "ntop_includes.h"
+
+static const u_int32_t latency_buckets_ms[] = LUA_ENGINE_POOL_LATENCY_BUCKETS;
+
+/* ******************************************* */
+
+LuaEnginePool::LuaEnginePool(u_int16_t _max_idle_engines) {
+  max_idle_engines = _max_idle_engines;
+  num_hits = num_misses = num_discarded = 0;
+  memset(&latency, 0, sizeof(latency));
+}
+
+/* ******************************************* */
+
+LuaEnginePool::~LuaEnginePool() {
+  for(std::vector<LuaEngine*>::iterator it = idle_engines.begin(); it != idle_engines.end(); ++it)
+    delete *it;
+}
+
+/* ******************************************* */
+
+/* NOTE: can throw std::bad_alloc as new LuaEngine() does */
+LuaEngine* LuaEnginePool::get(bool *reused) {
+  LuaEngine *l = NULL;
+
+  m.lock(__FILE__, __LINE__);
+
+  if(!idle_engines.empty()) {
+    l = idle_engines.back();
+    idle_engines.pop_back();
+    num_hits++;
+  } else
+    num_misses++;
+
+  m.unlock(__FILE__, __LINE__);
+
+  if((*reused = (l != NULL)))
+    return(l);
+
+  l = new LuaEngine(NULL);
+  l->init_http_vm(&bytecode_cache);
+
+  return(l);
+}
+
+/* ******************************************* */
+
+void LuaEnginePool::release(LuaEngine *l, bool reused, const char *path, u_int32_t latency_ms) {
+  std::map<std::string, struct lua_engine_pool_latency>::iterator it;
+  struct lua_engine_pool_latency *path_latency;
+  u_int i;
+  bool keep;
+
+  for(i = 0; (i < LUA_ENGINE_POOL_NUM_BUCKETS - 1) && (latency_ms > latency_buckets_ms[i]); i++)
+    ;
+
+  /* Reset outside of the lock as it walks the VM globals */
+  keep = l->reset_http_vm();
+
+  m.lock(__FILE__, __LINE__);
+
+  if((it = latency_by_path.find(path)) == latency_by_path.end()) {
+    if(latency_by_path.size() >= LUA_ENGINE_POOL_MAX_PATHS)
+      path = LUA_ENGINE_POOL_OTHER_PATHS;
+
+    path_latency = &latency_by_path[path]; /* Zero-initialized on insertion */
+  } else
+    path_latency = &it->second;
+
+  if(reused)
+    latency.hit[i]++, path_latency->hit[i]++;
+  else
+    latency.miss[i]++, path_latency->miss[i]++;
+
+  if(keep && (idle_engines.size() < max_idle_engines))
+    idle_engines.push_back(l), l = NULL;
+  else
+    num_discarded++;
+
+  m.unlock(__FILE__, __LINE__);
+
+  if(l) delete l;
+}
+
+/* ******************************************* */
+
+void LuaEnginePool::luaHistogram(lua_State *vm, const char *name, const u_int64_t *buckets) {
+  char key[16];
+
+  lua_newtable(vm);
+
+  for(u_int i = 0; i < LUA_ENGINE_POOL_NUM_BUCKETS; i++) {
+    if(i < LUA_ENGINE_POOL_NUM_BUCKETS - 1)
+      snprintf(key, sizeof(key), "le_%u", latency_buckets_ms[i]);
+    else
+      snprintf(key, sizeof(key), "gt_%u", latency_buckets_ms[i - 1]);
+
+    lua_push_uint64_table_entry(vm, key, buckets[i]);
+  }
+
+  lua_pushstring(vm, name);
+  lua_insert(vm, -2);
+  lua_settable(vm, -3);
+}
+
+/* ******************************************* */
+
+void LuaEnginePool::luaLatency(lua_State *vm, const struct lua_engine_pool_latency *l) {
+  luaHistogram(vm, "latency_ms_hit", l->hit);
+  luaHistogram(vm, "latency_ms_miss", l->miss);
+}
+
+/* ******************************************* */
+
+void LuaEnginePool::lua(lua_State *vm) {
+  lua_newtable(vm);
+
+  m.lock(__FILE__, __LINE__);
+
+  lua_push_uint64_table_entry(vm, "num_hits", num_hits);
+  lua_push_uint64_table_entry(vm, "num_misses", num_misses);
+  lua_push_uint64_table_entry(vm, "num_discarded", num_discarded);
+  lua_push_uint64_table_entry(vm, "num_idle", idle_engines.size());
+  luaLatency(vm, &latency);
+
+  lua_newtable(vm);
+
+  for(std::map<std::string, struct lua_engine_pool_latency>::const_iterator it = latency_by_path.begin();
+      it != latency_by_path.end(); ++it) {
+    lua_newtable(vm);
+    luaLatency(vm, &it->second);
+    lua_setfield(vm, -2, it->first.c_str());
+  }
+
+  lua_setfield(vm, -2, "latency_ms_by_path");
+
+  m.unlock(__FILE__, __LINE__);
+
+  bytecode_cache.lua(vm);
+}
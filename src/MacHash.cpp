@@ -30,35 +30,17 @@ MacHash::MacHash(NetworkInterface *_iface, u_int _num_hashes, u_int _max_hash_si
 
 /* ************************************ */
 
-Mac* MacHash::get(const u_int8_t mac[6], bool is_inline_call) {
-  if(mac == NULL)
-    return(NULL);
-  else {
-    u_int32_t hash = Utils::macHash((u_int8_t*)mac);
-
-    hash %= num_hashes;
-
-    if(table[hash] == NULL) {
-      return(NULL);
-    } else {
-      Mac *head;
-
-      if(!is_inline_call)
-	locks[hash]->rdlock(__FILE__, __LINE__);
+static bool mac_matches(GenericHashEntry *h, void *user_data) {
+  Mac *m = (Mac*)h;
 
-      head = (Mac*)table[hash];
-
-      while(head != NULL) {
-	if((!head->idle()) && head->equal(mac))
-	  break;
-	else
-	  head = (Mac*)head->next();
-      }
+  return((!m->idle()) && m->equal((const u_int8_t*)user_data));
+}
 
-      if(!is_inline_call)
-	locks[hash]->unlock(__FILE__, __LINE__);
+/* ************************************ */
 
-      return(head);
-    }
-  }
+Mac* MacHash::get(const u_int8_t mac[6], bool is_inline_call) {
+  if(mac == NULL)
+    return(NULL);
+  else
+    return((Mac*)lookup<mac_matches>(Utils::macHash((u_int8_t*)mac), (void*)mac, !is_inline_call));
 }
@@ -54,6 +54,11 @@ void* MySQLDB::queryLoop() {
   if(ntop->getGlobals()->isShutdown())
     return(NULL);
 
+  if(filling) {
+    batchQueryLoop();
+    return(NULL);
+  }
+
   while(isRunning() || queue_not_empty) {
     int rc = r->lpop(CONST_SQL_QUEUE, sql, sizeof(sql));
 
@@ -450,6 +455,20 @@ MySQLDB::MySQLDB(NetworkInterface *_iface) : DB(_iface) {
   open_log();
   db_created = false;
 
+  memset(batches, 0, sizeof(batches));
+  filling = flushing = NULL;
+  num_batches = num_batch_rows = 0;
+  last_batch_ms = total_batch_ms = last_batch_rows_sec = 0;
+
+  if((batch_max_rows = ntop->getPrefs()->get_mysql_batch_rows()) > 1) {
+    if(initBatch(&batches[0]) && initBatch(&batches[1]))
+      filling = &batches[0];
+    else {
+      ntop->getTrace()->traceEvent(TRACE_WARNING, "Not enough memory: MySQL batch inserts disabled");
+      batch_max_rows = 1;
+    }
+  }
+
   connectToDB(&mysql, false);
 }
 
@@ -459,6 +478,10 @@ MySQLDB::~MySQLDB() {
   shutdown();
   disconnectFromDB(&mysql);
 
+  for(int i = 0; i < 2; i++)
+    for(int j = 0; j < 2; j++)
+      if(batches[i].sql[j]) free(batches[i].sql[j]);
+
   if(log_fd) fclose(log_fd);
 }
 
@@ -509,6 +532,7 @@ void MySQLDB::shutdown() {
     void *res;
 
     DB::shutdown();
+    if(filling) batch_ready.signal();
     
     pthread_join(queryThreadLoop, &res);
   }
@@ -648,12 +672,216 @@ void MySQLDB::try_exec_sql_query(MYSQL *conn, char *sql) {
 
 /* ******************************************* */
 
+bool MySQLDB::initBatch(mysql_batch_t *b) {
+  for(int i = 0; i < 2; i++) {
+    b->sql_size[i] = 4 * CONST_MAX_SQL_QUERY_LEN;
+
+    if((b->sql[i] = (char*)malloc(b->sql_size[i])) == NULL)
+      return(false);
+  }
+
+  resetBatch(b);
+  return(true);
+}
+
+/* ******************************************* */
+
+void MySQLDB::resetBatch(mysql_batch_t *b) {
+  for(int i = 0; i < 2; i++) {
+    b->sql_len[i] = snprintf(b->sql[i], b->sql_size[i], "INSERT INTO `%sv%c` " MYSQL_INSERT_FIELDS " VALUES ",
+			     ntop->getPrefs()->get_mysql_tablename(), (i == 0) ? '4' : '6');
+    b->num_rows[i] = 0;
+  }
+}
+
+/* ******************************************* */
+
+/* Hands the filling batch over to the query thread. Call it with batch_lock held */
+bool MySQLDB::swapBatches() {
+  if(flushing /* The query thread is still busy with the previous one */
+     || (filling->num_rows[0] + filling->num_rows[1] == 0))
+    return(false);
+
+  flushing = filling;
+  filling = (filling == &batches[0]) ? &batches[1] : &batches[0];
+  batch_ready.signal();
+
+  return(true);
+}
+
+/* ******************************************* */
+
+/*
+  Called by the dumper: adds the flow tuple to the multi-row INSERT. When
+  the database is slower than the flows, the batch keeps growing up to
+  MYSQL_BATCH_MAX_LEN, then flows are dropped.
+*/
+bool MySQLDB::appendToBatch(bool ipv4, const char *values, u_int32_t values_len) {
+  u_int idx = ipv4 ? 0 : 1;
+  mysql_batch_t *b;
+  u_int32_t needed;
+  bool rc = true;
+
+  batch_lock.lock(__FILE__, __LINE__);
+
+  b = filling;
+
+  if((b->sql_len[idx] + values_len + 2 > MYSQL_BATCH_MAX_LEN) && !swapBatches())
+    rc = false;
+  else {
+    b = filling;
+    needed = b->sql_len[idx] + values_len + 2;
+
+    if(needed > b->sql_size[idx]) {
+      u_int32_t new_size = min_val(max_val(2 * b->sql_size[idx], needed), MYSQL_BATCH_MAX_LEN);
+      char *sql = (char*)realloc(b->sql[idx], new_size);
+
+      if(sql)
+	b->sql[idx] = sql, b->sql_size[idx] = new_size;
+      else
+	rc = false;
+    }
+  }
+
+  if(rc) {
+    if(b->num_rows[0] + b->num_rows[1] == 0)
+      gettimeofday(&b->first_row, NULL);
+
+    if(b->num_rows[idx] > 0)
+      b->sql[idx][b->sql_len[idx]++] = ',';
+
+    memcpy(&b->sql[idx][b->sql_len[idx]], values, values_len);
+    b->sql_len[idx] += values_len, b->sql[idx][b->sql_len[idx]] = '\0';
+    b->num_rows[idx]++;
+
+    if(b->num_rows[0] + b->num_rows[1] >= batch_max_rows)
+      swapBatches();
+  }
+
+  batch_lock.unlock(__FILE__, __LINE__);
+
+  return(rc);
+}
+
+/* ******************************************* */
+
+void MySQLDB::flushBatch(mysql_batch_t *b) {
+  struct timeval begin, end;
+  u_int32_t num_rows = 0;
+  float ms;
+
+  gettimeofday(&begin, NULL);
+
+  for(int i = 0; i < 2; i++) {
+    if(b->num_rows[i] == 0)
+      continue;
+
+    if(exec_sql_query(&mysql, b->sql[i], true /* Attempt to reconnect */, true /* Don't print errors */, false) < 0) {
+      ntop->getTrace()->traceEvent(TRACE_ERROR, "MySQL error: %s [%u flows dropped]",
+				   get_last_db_error(&mysql), b->num_rows[i]);
+      incNumDroppedFlows(b->num_rows[i]);
+
+      /* Don't give up, manually re-connect */
+      disconnectFromDB(&mysql);
+      if(!connectToDB(&mysql, true)) _usleep(100);
+    } else {
+      incNumExportedFlows(b->num_rows[i]);
+      num_rows += b->num_rows[i];
+    }
+  }
+
+  gettimeofday(&end, NULL);
+  ms = Utils::msTimevalDiff(&end, &begin);
+
+  num_batches++, num_batch_rows += num_rows;
+  last_batch_ms = ms, total_batch_ms += ms;
+  last_batch_rows_sec = (ms > 0) ? (num_rows * 1000.) / ms : num_rows;
+}
+
+/* ******************************************* */
+
+void MySQLDB::batchQueryLoop() {
+  u_int32_t window_ms = ntop->getPrefs()->get_mysql_batch_window_ms();
+  u_int32_t wait_ms = min_val(window_ms, 1000);
+
+  while(true) {
+    struct timeval now;
+    struct timespec expiration;
+    mysql_batch_t *b;
+    bool is_running = isRunning();
+
+    if(is_running) {
+      gettimeofday(&now, NULL);
+      expiration.tv_sec = now.tv_sec + wait_ms / 1000;
+      expiration.tv_nsec = (now.tv_usec + (wait_ms % 1000) * 1000) * 1000;
+
+      if(expiration.tv_nsec >= 1000000000)
+	expiration.tv_sec++, expiration.tv_nsec -= 1000000000;
+
+      batch_ready.timedWait(&expiration);
+    }
+
+    batch_lock.lock(__FILE__, __LINE__);
+
+    if(!flushing && (filling->num_rows[0] + filling->num_rows[1] > 0)) {
+      /* Flush on time, or whatever is left at shutdown */
+      gettimeofday(&now, NULL);
+
+      if(!is_running || (Utils::msTimevalDiff(&now, &filling->first_row) >= window_ms))
+	swapBatches();
+    }
+
+    b = flushing;
+    batch_lock.unlock(__FILE__, __LINE__);
+
+    if(b) {
+      if(db_operational || connectToDB(&mysql, true))
+	flushBatch(b);
+      else
+	incNumDroppedFlows(b->num_rows[0] + b->num_rows[1]);
+
+      resetBatch(b);
+
+      batch_lock.lock(__FILE__, __LINE__);
+      flushing = NULL;
+      batch_lock.unlock(__FILE__, __LINE__);
+    } else if(!is_running)
+      break;
+  }
+}
+
+/* ******************************************* */
+
+void MySQLDB::lua(lua_State *vm, bool since_last_checkpoint) const {
+  DB::lua(vm, since_last_checkpoint);
+
+  if(batch_max_rows > 1) {
+    lua_push_uint64_table_entry(vm, "flow_export_batches", num_batches);
+    lua_push_uint64_table_entry(vm, "flow_export_batch_rows", num_batch_rows);
+    lua_push_float_table_entry(vm, "flow_export_batch_last_ms", last_batch_ms);
+    lua_push_float_table_entry(vm, "flow_export_batch_avg_ms", num_batches ? total_batch_ms / num_batches : 0);
+    lua_push_float_table_entry(vm, "flow_export_batch_rows_sec", last_batch_rows_sec);
+  }
+}
+
+/* ******************************************* */
+
 bool MySQLDB::dumpFlow(time_t when, Flow *f, char *json) {
   char sql[CONST_MAX_SQL_QUERY_LEN];
 
   if((f->get_cli_ip_addr() == NULL) || (f->get_srv_ip_addr() == NULL) || !MySQLDB::db_created)
     return(false);
 
+  if(filling) {
+    /* Batch mode: the tuple goes to the multi-row INSERT (drops are counted by the caller) */
+    int len = flow2InsertValues(f, json, sql, sizeof(sql));
+
+    if((len <= 0) || (len >= (int)sizeof(sql)) /* Truncated */)
+      return(false);
+
+    return(appendToBatch(f->get_cli_ip_addr()->isIPv4(), sql, len));
+  }
+
   if(f->get_cli_ip_addr()->isIPv4())
     snprintf(sql, sizeof(sql), "INSERT INTO `%sv4` " MYSQL_INSERT_FIELDS " VALUES ",
 	     ntop->getPrefs()->get_mysql_tablename());
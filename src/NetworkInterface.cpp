@@ -231,6 +231,7 @@ NetworkInterface::NetworkInterface(const char *name,
   updateLbdIdentifier();
   updateDiscardProbingTraffic();
   updateFlowsOnlyInterface();
+  updateFlowIndexes();
 }
 
 /* **************************************************** */
@@ -249,6 +250,8 @@ void NetworkInterface::init() {
     discard_probing_traffic = false;
     flows_only_interface = false;
     numSubInterfaces = 0;
+    packet_shards = NULL, num_packet_shards = 0, shard_parent = NULL;
+    flow_indexes = NULL, flow_indexes_requested = false;
     enable_ip_reassignment_alerts = false;
     pcap_datalink_type = 0, mtuWarningShown = false,
     purge_idle_flows_hosts = true, id = (u_int8_t)-1,
@@ -270,6 +273,7 @@ void NetworkInterface::init() {
     last_obs_point_id = 0;
 
   flows_hash = NULL, hosts_hash = NULL;
+  flows_pool = ndpi_flows_pool = local_hosts_pool = remote_hosts_pool = local_host_stats_pool = NULL;
   macs_hash = NULL, ases_hash = NULL, oses_hash = NULL, vlans_hash = NULL, obs_hash = NULL;
   countries_hash = NULL;
   gw_macs = NULL;
@@ -345,6 +349,8 @@ void NetworkInterface::init() {
   next_compq_insert_idx = next_compq_remove_idx = 0;
 
   idleFlowsToDump = activeFlowsToDump = NULL;
+  flows_dump_json_writer = NULL;
+  local_host_cache = NULL;
   flowAlertsQueue = new (std::nothrow) SPSCQueue<FlowAlert *>(MAX_FLOW_CHECKS_QUEUE_LEN, "flowAlertsQueue");
   hostAlertsQueue = new (std::nothrow) SPSCQueue<HostAlertReleasedPair>(MAX_HOST_CHECKS_QUEUE_LEN, "hostAlertsQueue");
 
@@ -427,6 +433,11 @@ bool NetworkInterface::initnDPIReload() {
 
   /* No need to dedicate another variable for the reload, we can use the shadow itself */
   ndpi_struct_shadow = initnDPIStruct();
+
+  /* Packet shards are not known to ntop: reload them along with this interface */
+  for(u_int8_t i = 0; i < num_packet_shards; i++)
+    packet_shards[i]->getInterface()->initnDPIReload();
+
   return(true);
 }
 
@@ -460,6 +471,9 @@ void NetworkInterface::finalizenDPIReload() {
     ntop->getTrace()->traceEvent(TRACE_INFO, "nDPI reload completed");
     ndpiReloadInProgress = false;
   }
+
+  for(u_int8_t i = 0; i < num_packet_shards; i++)
+    packet_shards[i]->getInterface()->finalizenDPIReload();
 }
 
 /* ******************************************* */
@@ -503,6 +517,9 @@ void NetworkInterface::nDPILoadIPCategory(char *what, ndpi_protocol_category_t i
 
   if(what && ndpi_struct_shadow)
     ndpi_load_ip_category(ndpi_struct_shadow, what, id);
+
+  for(u_int8_t i = 0; i < num_packet_shards; i++)
+    packet_shards[i]->getInterface()->nDPILoadIPCategory(what, id);
 }
 
 /* *************************************** */
@@ -512,6 +529,9 @@ void NetworkInterface::nDPILoadHostnameCategory(char *what, ndpi_protocol_catego
 
   if(what && ndpi_struct_shadow)
     ndpi_load_hostname_category(ndpi_struct_shadow, what, id);
+
+  for(u_int8_t i = 0; i < num_packet_shards; i++)
+    packet_shards[i]->getInterface()->nDPILoadHostnameCategory(what, id);
 }
 
 /* *************************************** */
@@ -524,6 +544,9 @@ int NetworkInterface::nDPILoadMaliciousJA3Signatures(const char *file_path) {
   if(file_path && ndpi_struct_shadow)
     n = ndpi_load_malicious_ja3_file(ndpi_struct_shadow, file_path);
 
+  for(u_int8_t i = 0; i < num_packet_shards; i++)
+    packet_shards[i]->getInterface()->nDPILoadMaliciousJA3Signatures(file_path);
+
   return n;
 }
 
@@ -542,6 +565,9 @@ ndpi_protocol_category_t NetworkInterface::get_ndpi_proto_category(u_int protoid
 
 void NetworkInterface::setnDPIProtocolCategory(u_int16_t protoId, ndpi_protocol_category_t protoCategory) {
   ndpi_set_proto_category(get_ndpi_struct(), protoId, protoCategory);
+
+  for(u_int8_t i = 0; i < num_packet_shards; i++)
+    packet_shards[i]->getInterface()->setnDPIProtocolCategory(protoId, protoCategory);
 }
 
 /* **************************************************** */
@@ -708,6 +734,90 @@ void NetworkInterface::updateFlowsOnlyInterface() {
   flows_only_interface = getInterfaceBooleanPref(CONST_FLOWS_ONLY_INTERFACE, CONST_DEFAULT_FLOWS_ONLY_INTERFACE);
 }
 
+/* **************************************** */
+
+void NetworkInterface::updateFlowIndexes() {
+  requestFlowIndexes(getInterfaceBooleanPref(CONST_FLOW_INDEXES_PREFS, CONST_DEFAULT_FLOW_INDEXES));
+}
+
+/* **************************************** */
+
+/* Applied by checkFlowIndexes(), packet shards follow the interface setting */
+void NetworkInterface::requestFlowIndexes(bool enabled) {
+  flow_indexes_requested = enabled;
+
+  for(u_int8_t i = 0; i < num_packet_shards; i++)
+    packet_shards[i]->getInterface()->requestFlowIndexes(enabled);
+}
+
+/* **************************************** */
+
+static bool flow_index_walker(GenericHashEntry *h, void *user_data, bool *matched) {
+  ((FlowIndexes*)user_data)->indexFlow((Flow*)h);
+  *matched = true;
+
+  return(false); /* false = keep on walking */
+}
+
+/* **************************************** */
+
+/*
+  Creates or drops the flow indexes as requested. Executed inline with
+  the purge, that is, in the thread that also creates and idles flows
+*/
+void NetworkInterface::checkFlowIndexes() {
+  if(flow_indexes_requested && !isView()) {
+    if(!flow_indexes && ((flow_indexes = new (std::nothrow) FlowIndexes()) == NULL))
+      return;
+
+    if(!flow_indexes->isMaintained()) {
+      u_int32_t begin_slot = 0;
+
+      /* Flows created from now on are indexed, then the existing ones are added */
+      flow_indexes->startMaintenance();
+
+      if(flows_hash)
+	flows_hash->walk(&begin_slot, true /* walk all */, flow_index_walker, flow_indexes);
+
+      flow_indexes->flushPending();
+      flow_indexes->setUsable();
+
+      ntop->getTrace()->traceEvent(TRACE_INFO, "Flow indexes enabled on %s", ifname);
+    } else
+      flow_indexes->flushPending();
+  } else if(flow_indexes && flow_indexes->isMaintained()) {
+    flow_indexes->disable();
+
+    ntop->getTrace()->traceEvent(TRACE_INFO, "Flow indexes disabled on %s", ifname);
+  }
+}
+
+/* **************************************** */
+
+void NetworkInterface::indexFlow(Flow *f) {
+  if(flow_indexes && flow_indexes->isMaintained())
+    flow_indexes->indexFlow(f);
+}
+
+/* **************************************** */
+
+void NetworkInterface::unindexFlow(Flow *f, bool wait) {
+  /* Also when maintenance is over, flows could have been indexed concurrently */
+  if(flow_indexes && f->getIndexRefs())
+    flow_indexes->unindexFlow(f, wait);
+}
+
+/* **************************************** */
+
+void NetworkInterface::luaFlowIndexes(lua_State *vm) {
+  if(flow_indexes)
+    flow_indexes->lua(vm);
+  else {
+    lua_newtable(vm);
+    lua_push_bool_table_entry(vm, "enabled", false);
+  }
+}
+
 /* **************************************************** */
 
 bool NetworkInterface::checkIdle() {
@@ -738,6 +848,15 @@ void NetworkInterface::deleteDataStructures() {
   if(countries_hash)        { delete(countries_hash);  countries_hash = NULL;  }
   if(vlans_hash)            { delete(vlans_hash); vlans_hash = NULL; }
   if(macs_hash)             { delete(macs_hash);  macs_hash = NULL;  }
+
+  /* After the hash tables, as deleting their entries releases them to the pools.
+     Pools with objects still in use are freed when the last one is released */
+  ObjectPool **pools[] = { &flows_pool, &ndpi_flows_pool, &local_hosts_pool, &remote_hosts_pool, &local_host_stats_pool };
+
+  for(u_int i = 0; i < sizeof(pools) / sizeof(pools[0]); i++) {
+    if(*pools[i]) { (*pools[i])->destroy(); *pools[i] = NULL; }
+  }
+
   if(gw_macs)               { delete(gw_macs);    gw_macs = NULL;    }
   if(download_stats)        { delete(download_stats); download_stats = NULL;   }
   if(upload_stats)          { delete(upload_stats); upload_stats = NULL;       }
@@ -769,12 +888,29 @@ NetworkInterface::~NetworkInterface() {
   }
 #endif
 
+  /* The VMs kept by the periodic scripts point to this interface */
+  ntop->purgePeriodicActivitiesVMs(this);
+
+  if(packet_shards) {
+    /* Before the hosts are cleaned up: the shard flows hold a use of them */
+    for(u_int8_t i = 0; i < num_packet_shards; i++)
+      delete packet_shards[i];
+
+    delete[] packet_shards;
+  }
+
   cleanup();
 
   deleteDataStructures();
 
+  /* After the flows, which unindex themselves when deleted */
+  if(flow_indexes) delete flow_indexes;
+
   if(idleFlowsToDump)   delete idleFlowsToDump;
   if(activeFlowsToDump) delete activeFlowsToDump;
+  if(flows_dump_json_writer) delete flows_dump_json_writer;
+  /* After the hosts, whose state is saved through it on purge */
+  if(local_host_cache) delete local_host_cache;
 
   if(db) {
     db->shutdown();
@@ -934,7 +1070,7 @@ int NetworkInterface::dumpFlow(time_t when, Flow *f) {
 	Don't signal for view interfaces, they use sleep.
        */
 #ifndef WIN32
-      if(!isViewed()) dump_condition.signal();
+      if(!isViewed() && !isPacketShard()) dump_condition.signal();
 #endif
 
 #if DEBUG_FLOW_DUMP
@@ -952,7 +1088,7 @@ int NetworkInterface::dumpFlow(time_t when, Flow *f) {
 	Signal there's work to do.
        */
 #ifndef WIN32
-      if(!isViewed()) dump_condition.signal();
+      if(!isViewed() && !isPacketShard()) dump_condition.signal();
 #endif
 
 #if DEBUG_FLOW_DUMP
@@ -983,8 +1119,13 @@ static bool local_hosts_2_redis_walker(GenericHashEntry *h, void *user_data, boo
   Host *host = (Host*)h;
 
   if(host && (host->isLocalHost() || host->isSystemHost())) {
-    ((LocalHost*)host)->serializeToRedis();
-    *matched = true;
+    LocalHost *lh = (LocalHost*)host;
+
+    /* A host being restored has not its full state yet: the saved one is kept */
+    if(!lh->isRestorePending()) {
+      lh->saveState();
+      *matched = true;
+    }
   }
 
   return(false); /* false = keep on walking */
@@ -1062,11 +1203,46 @@ bool NetworkInterface::walker(u_int32_t *begin_slot,
 			      WalkerType wtype,
 			      bool (*walker)(GenericHashEntry *h, void *user_data, bool *matched),
 			      void *user_data) {
-  bool ret = false;
+  const u_int32_t slot_mask = (1 << PACKET_SHARD_WALKER_BITS) - 1;
+  u_int32_t unit, slot;
+  bool ret;
 
   if(id == SYSTEM_INTERFACE_ID)
     return(false);
 
+  if((num_packet_shards == 0) || (wtype != walker_flows) /* Only flows are kept by the shards */)
+    return(walkHashTables(begin_slot, walk_all, wtype, walker, user_data));
+
+  /*
+    Walk this interface (unit 0) and then every packet shard: the upper
+    bits of begin_slot keep the unit to resume from when walking in steps
+  */
+  for(unit = *begin_slot >> PACKET_SHARD_WALKER_BITS, slot = *begin_slot & slot_mask;
+      unit <= num_packet_shards; unit++, slot = 0) {
+    NetworkInterface *iface = (unit == 0) ? this : packet_shards[unit - 1]->getInterface();
+
+    ret = (iface == this) ? walkHashTables(&slot, walk_all, wtype, walker, user_data)
+      : iface->walker(&slot, walk_all, wtype, walker, user_data);
+
+    if(ret || (slot != 0) /* Walk step over */) {
+      *begin_slot = (unit << PACKET_SHARD_WALKER_BITS) | (slot & slot_mask);
+      return(ret);
+    }
+  }
+
+  *begin_slot = 0 /* start over */;
+  return(false);
+}
+
+/* **************************************************** */
+
+bool NetworkInterface::walkHashTables(u_int32_t *begin_slot,
+				      bool walk_all,
+				      WalkerType wtype,
+				      bool (*walker)(GenericHashEntry *h, void *user_data, bool *matched),
+				      void *user_data) {
+  bool ret = false;
+
   switch(wtype) {
   case walker_hosts:
     ret = hosts_hash ? hosts_hash->walk(begin_slot, walk_all, walker, user_data) : false;
@@ -1106,6 +1282,47 @@ bool NetworkInterface::walker(u_int32_t *begin_slot,
 
 /* **************************************************** */
 
+/* True when this interface and all of its packet shards have complete flow indexes */
+bool NetworkInterface::canUseFlowIndexes() {
+  if(isView() || !flow_indexes || !flow_indexes->isUsable())
+    return(false);
+
+  for(u_int8_t i = 0; i < num_packet_shards; i++) {
+    if(!packet_shards[i]->getInterface()->canUseFlowIndexes())
+      return(false);
+  }
+
+  return(true);
+}
+
+/* **************************************************** */
+
+/*
+  Walks the flows for a query filtered by the paginator and/or host. When
+  possible, only the flows of the most selective index posting are walked.
+*/
+bool NetworkInterface::walkFlows(u_int32_t *begin_slot, bool walk_all, Paginator *p, Host *host,
+				 bool (*walker)(GenericHashEntry *h, void *user_data, bool *matched),
+				 void *user_data) {
+  u_int32_t slot;
+
+  if(!walk_all || !canUseFlowIndexes()
+     || !flow_indexes->walk(p, host, walker, user_data) /* No usable filter */)
+    return(this->walker(begin_slot, walk_all, walker_flows, walker, user_data));
+
+  for(u_int8_t i = 0; i < num_packet_shards; i++) {
+    NetworkInterface *iface = packet_shards[i]->getInterface();
+
+    if(!iface->flow_indexes->walk(p, host, walker, user_data))
+      slot = 0, iface->walkHashTables(&slot, true, walker_flows, walker, user_data);
+  }
+
+  *begin_slot = 0;
+  return(false);
+}
+
+/* **************************************************** */
+
 Flow* NetworkInterface::getFlow(Mac *srcMac, Mac *dstMac,
 				VLANid vlan_id, u_int16_t observation_domain_id,
 				u_int32_t deviceIP,
@@ -1155,11 +1372,11 @@ Flow* NetworkInterface::getFlow(Mac *srcMac, Mac *dstMac,
 
     try {
       PROFILING_SECTION_ENTER("NetworkInterface::getFlow: new Flow", 2);
-      ret = new (std::nothrow) Flow(this, vlan_id, observation_domain_id, l4_proto,
-				    srcMac, src_ip, src_port,
-				    dstMac, dst_ip, dst_port,
-				    icmp_info,
-				    first_seen, last_seen,
+      ret = new (flows_pool) Flow(this, vlan_id, observation_domain_id, l4_proto,
+				  srcMac, src_ip, src_port,
+				  dstMac, dst_ip, dst_port,
+				  icmp_info,
+				  first_seen, last_seen,
             view_cli_mac, view_srv_mac);
       PROFILING_SECTION_EXIT(2);
     } catch(std::bad_alloc& ba) {
@@ -1176,6 +1393,7 @@ Flow* NetworkInterface::getFlow(Mac *srcMac, Mac *dstMac,
 
     if(flows_hash->add(ret, false /* Don't lock, we're inline with the purgeIdle */)) {
       *src2dst_direction = true;
+      indexFlow(ret);
     } else {
       /* Note: this should never happen as we are checking hasEmptyRoom() */
       delete ret;
@@ -1415,6 +1633,24 @@ bool NetworkInterface::processPacket(u_int32_t bridge_iface_idx,
 
   if(!isSubInterface()) {
     bool processed = false;
+
+#ifndef HAVE_NEDGE
+    if(num_packet_shards > 0) {
+      /* Hand the packet over to the worker owning its flow */
+      PacketShard *shard = packet_shards[PacketShard::symmetricHash(iph, ip6, packet, ip_offset, h->caplen)
+					 % num_packet_shards];
+
+      shard->enqueue(bridge_iface_idx, ingressPacket, when, packet_time,
+		     eth, vlan_id, ip6 != NULL, ip_offset,
+		     encapsulation_overhead, len_on_wire, h, packet,
+		     read_from_pcap_dump() /* Never drop the packets of a file */);
+
+      /* All the other counters are updated by the shard and merged by sumStats() */
+      incEthStats(ingressPacket, iph ? ETHERTYPE_IP : ETHERTYPE_IPV6, 1, len_on_wire, getPacketOverhead());
+      return(pass_verdict);
+    }
+#endif
+
 #ifdef NTOPNG_PRO
 #ifndef HAVE_NEDGE
     /* Custom disaggregation */
@@ -2020,6 +2256,8 @@ void NetworkInterface::purgeIdle(time_t when, bool force_idle, bool full_scan) {
   u_int n, m, o;
   last_pkt_rcvd = when;
 
+  checkFlowIndexes();
+
   bcast_domains->reloadBroadcastDomains(full_scan /* Force a reload only if a full scan is requested */);
 
   if((n = purgeIdleFlows(force_idle, full_scan)) > 0)
@@ -2037,7 +2275,10 @@ void NetworkInterface::purgeIdle(time_t when, bool force_idle, bool full_scan) {
   for(std::map<u_int64_t, NetworkInterface*>::iterator it = flowHashing.begin(); it != flowHashing.end(); ++it)
     it->second->purgeIdle(when, force_idle, full_scan);
 
+  /* Hosts are added inline, see purgeIdleHosts */
+  if(hasPacketShards()) shard_hosts_lock.lock(__FILE__, __LINE__);
   checkHostsToRestore();
+  if(hasPacketShards()) shard_hosts_lock.unlock(__FILE__, __LINE__);
 
 #if defined(NTOPNG_PRO)
   if(pMap) pMap->purgeIdle(when);
@@ -2899,8 +3140,9 @@ u_int64_t NetworkInterface::dequeueHostAlertsFromChecks(u_int budget) {
 void NetworkInterface::incNumQueueDroppedFlows(u_int32_t num) {
   /*
     For viewed interface, the dumper database is the one belonging to the overlying view interface.
+    Same for packet shards and their parent interface.
   */
-  DB *dumper = isViewed() ? viewedBy()->getDB() : getDB();
+  DB *dumper = isViewed() ? viewedBy()->getDB() : (isPacketShard() ? getShardParent()->getDB() : getDB());
 
   if(dumper)
     dumper->incNumQueueDroppedFlows(num);
@@ -2920,8 +3162,9 @@ void NetworkInterface::incNumQueueDroppedFlows(u_int32_t num) {
 u_int64_t NetworkInterface::dequeueFlowsForDump(u_int idle_flows_budget, u_int active_flows_budget) {
   /*
     For viewed interface, the dumper database is the one belonging to the overlying view interface.
+    Same for packet shards and their parent interface.
   */
-  DB *dumper = isViewed() ? viewedBy()->getDB() : getDB();
+  DB *dumper = isViewed() ? viewedBy()->getDB() : (isPacketShard() ? getShardParent()->getDB() : getDB());
   u_int64_t idle_flows_done = 0, active_flows_done = 0;
 
   if(!dumper) {
@@ -2934,19 +3177,23 @@ u_int64_t NetworkInterface::dequeueFlowsForDump(u_int idle_flows_budget, u_int a
    */
   while(idleFlowsToDump->isNotEmpty()) {
     Flow *f = idleFlowsToDump->dequeue();
-    char *json = NULL;
+    char *json = NULL, *json_to_free = NULL;
     bool rc = true;
 
     f->update_partial_traffic_stats_db_dump(); /* Checkpoint flow traffic counters for the dump */
 
     /* Prepare the JSON - if requested */
-    if(flows_dump_json)
-      json = f->serialize(flows_dump_json_use_labels);
+    if(flows_dump_json) {
+      if(flows_dump_json_writer)
+	json = (char*)f->serialize(flows_dump_json_writer, flows_dump_json_use_labels);
+      else
+	json = json_to_free = f->serialize(flows_dump_json_use_labels);
+    }
 
     if(f->get_partial_bytes()) /* Make sure data is not at zero */
       rc = dumper->dumpFlow(f->get_last_seen(), f, json); /* Finally dump this flow */
 
-    if(json) free(json);
+    if(json_to_free) free(json_to_free);
 
 #if DEBUG_FLOW_DUMP
     ntop->getTrace()->traceEvent(TRACE_NORMAL, "Dumped idle flow");
@@ -2966,19 +3213,23 @@ u_int64_t NetworkInterface::dequeueFlowsForDump(u_int idle_flows_budget, u_int a
   */
   while(activeFlowsToDump->isNotEmpty()) {
     Flow *f = activeFlowsToDump->dequeue();
-    char *json = NULL;
+    char *json = NULL, *json_to_free = NULL;
     bool rc = true;
 
     f->update_partial_traffic_stats_db_dump(); /* Checkpoint flow traffic counters for the dump */
 
     /* Prepare the JSON - if requested */
-    if(flows_dump_json)
-      json = f->serialize(flows_dump_json_use_labels);
+    if(flows_dump_json) {
+      if(flows_dump_json_writer)
+	json = (char*)f->serialize(flows_dump_json_writer, flows_dump_json_use_labels);
+      else
+	json = json_to_free = f->serialize(flows_dump_json_use_labels);
+    }
 
     if(f->get_partial_bytes()) /* Make sure data is not at zero */
       rc = dumper->dumpFlow(f->get_last_seen(), f, json); /* Finally dump this flow */
 
-    if(json) free(json);
+    if(json_to_free) free(json_to_free);
 
 #if DEBUG_FLOW_DUMP
     ntop->getTrace()->traceEvent(TRACE_NORMAL, "Dumped active flow");
@@ -3000,7 +3251,8 @@ u_int64_t NetworkInterface::dequeueFlowsForDump(u_int idle_flows_budget, u_int a
   u_int64_t num_done = idle_flows_done + active_flows_done;
 
 #ifndef WIN32
-  if(!isViewed()
+  if(!isViewed() && !isPacketShard()
+     && !hasPacketShards() /* Dumps its shards too, see dumpFlowLoop */
      && num_done == 0) {
     /*
       Do a timedwait to avoid blocking indefinitely. Failing to do this, for interfaces with no traffic,
@@ -3123,9 +3375,16 @@ void NetworkInterface::dumpFlowLoop() {
     u_int64_t n = dequeueFlowsForDump(0 /* Unlimited budget for idle flows */,
 				      MAX_ACTIVE_FLOW_QUEUE_LEN /* Limited budged for active flows */);
 
+    /* Packet shards are dumped as the view does with the viewed interfaces */
+    for(u_int8_t i = 0; i < num_packet_shards; i++)
+      n += packet_shards[i]->getInterface()->dequeueFlowsForDump(128 /* Limited budget for idle flows */,
+								  32 /* Limited budged for active flows */);
+
     if(n == 0) {
 #ifdef WIN32
       _usleep(10000);
+#else
+      if(hasPacketShards()) _usleep(100); /* No timed wait, see dequeueFlowsForDump */
 #endif
     }
   }
@@ -3177,9 +3436,12 @@ void NetworkInterface::startFlowDumping() {
      */
     flows_dump_json_use_labels = ntop->getPrefs()->do_dump_flows_on_es()
       || ntop->getPrefs()->do_dump_flows_on_syslog();
+
+    /* Reusable buffer for the flow JSON, only accessed by the thread dumping this interface */
+    flows_dump_json_writer = new (std::nothrow) JSONWriter();
   }
 
-  if(!isViewed()) { /* Do not spawn the dumper thread for viewed interfaces - it's the view interface that has the dumper thread */
+  if(!isViewed() && !isPacketShard()) { /* Do not spawn the dumper thread for viewed interfaces (shards) - it's the view interface (parent) that has the dumper thread */
     if(idleFlowsToDump && activeFlowsToDump) {
       pthread_create(&flowDumpLoop, NULL, flowDumper, (void*)this);
       flowDumpLoopCreated = true;
@@ -3217,6 +3479,9 @@ void NetworkInterface::startPacketPolling() {
 #endif
   }
 
+  initPacketShards();
+  offloadHousekeeping();
+
   ntop->getTrace()->traceEvent(TRACE_NORMAL,
 			       "Started packet polling on interface %s [id: %u]...",
 			       get_description(), get_id());
@@ -3226,6 +3491,111 @@ void NetworkInterface::startPacketPolling() {
 
 /* **************************************************** */
 
+/*
+  Spawn the --packet-workers shards of a packet interface. Shards are
+  sub-interfaces with their own flows hash table, each fed by a worker thread,
+  so that flows are dissected in parallel. They are internal to this interface:
+  hosts are only kept here and updated by the shards (see shardFlowUpdate).
+ */
+void NetworkInterface::initPacketShards() {
+#ifndef HAVE_NEDGE
+  u_int8_t n = ntop->getPrefs()->get_num_packet_shards();
+
+  if((n < 2)
+     || (!pollLoopCreated) /* Not a packet capture interface */
+     || isSubInterface() || isView() || isViewed()
+     || (flowHashingMode != flowhashing_none) /* VLAN disaggregation in place */)
+    return;
+
+  if((packet_shards = new (std::nothrow) PacketShard*[n]) == NULL)
+    return;
+
+  for(u_int8_t i = 0; i < n; i++) {
+    NetworkInterface *shard_iface;
+    PacketShard *shard;
+
+    /* Same name, hence same id, of this interface: flows are dumped and looked up with it */
+    if((shard_iface = new (std::nothrow) NetworkInterface(ifname, CONST_INTERFACE_TYPE_SHARD)) == NULL)
+      break;
+
+    shard_iface->setSubInterface(flowhashing_packet_shard, i);
+    shard_iface->setPacketShard(this);
+    shard_iface->requestFlowIndexes(flow_indexes_requested);
+    shard_iface->allocateStructures();
+
+    /* Flow hash ids encode the shard, see findFlowByKeyAndHashId */
+    if(shard_iface->get_flows_hash())
+      shard_iface->get_flows_hash()->setEntryIdUnit(i, n);
+
+    if(ntop->getFlowChecksLoader())
+      shard_iface->reloadFlowChecks(ntop->getFlowChecksLoader());
+
+    if(ntop->getPrefs()->do_dump_flows())
+      shard_iface->initFlowDump(0); /* Queues only, dumped by this interface */
+
+    shard_iface->initFlowChecksLoop();
+    shard_iface->startPacketPolling(); /* Won't actually start a thread, just mark this interface as running */
+
+    /* The shard owns (and deletes) shard_iface */
+    if((shard = new (std::nothrow) PacketShard(shard_iface, i)) == NULL) {
+      shard_iface->shutdown();
+      delete shard_iface;
+      break;
+    }
+
+    if(!shard->startWorker()) {
+      delete shard;
+      break;
+    }
+
+    packet_shards[num_packet_shards++] = shard;
+  }
+
+  if(num_packet_shards > 0) {
+    ntop->getTrace()->traceEvent(TRACE_NORMAL, "Dissecting packets of %s with %u workers",
+				 get_description(), num_packet_shards);
+    ntop->getRedis()->set(CONST_STR_RELOAD_LISTS, (const char *)"1"); /* Load the categories in the shards */
+  } else {
+    delete[] packet_shards;
+    packet_shards = NULL;
+  }
+#endif
+}
+
+/* **************************************************** */
+
+/*
+  Hand the periodic walks of the hosts, MACs, ASes... hash tables to the
+  housekeeping workers. Flows are still walked inline: their housekeeping
+  feeds the single-producer dump and alert queues of the interface.
+ */
+void NetworkInterface::offloadHousekeeping() {
+  HousekeepingEngine *hk = ntop->getHousekeepingEngine();
+  GenericHash *gh[] = {
+    hosts_hash, macs_hash, vlans_hash, ases_hash, oses_hash, countries_hash, obs_hash
+  };
+
+  if(!hk)
+    return;
+
+  for(u_int i = 0; i < sizeof(gh) / sizeof(gh[0]); i++) {
+    if(gh[i])
+      hk->registerHash(gh[i]);
+  }
+}
+
+/* **************************************************** */
+
+/* Called when the capture thread is over, so no more packets are enqueued */
+void NetworkInterface::stopPacketShards() {
+  for(u_int8_t i = 0; i < num_packet_shards; i++) {
+    packet_shards[i]->stopWorker();
+    packet_shards[i]->getInterface()->shutdown(); /* Not known to ntop, shut down here */
+  }
+}
+
+/* **************************************************** */
+
 void NetworkInterface::shutdown() {
   void *res;
 
@@ -3233,6 +3603,7 @@ void NetworkInterface::shutdown() {
     running = false;
 
     if(pollLoopCreated)          pthread_join(pollLoop, &res);
+    stopPacketShards();
     if(flowDumpLoopCreated)      pthread_join(flowDumpLoop, &res);
     if(flowAlertsDequeueLoopCreated) pthread_join(flowChecksLoop, &res);
     if(hostAlertsDequeueLoopCreated) pthread_join(hostChecksLoop, &res);
@@ -3284,8 +3655,10 @@ void NetworkInterface::findFlowHosts(VLANid vlanId, u_int16_t observation_domain
   }
 
   PROFILING_SECTION_ENTER("NetworkInterface::findFlowHosts: hosts_hash->get", 3);
-  /* Do not look on sub interfaces, Flows are always created in the same interface of its hosts */
-  (*src) = hosts_hash->get(vlanId, _src_ip, true /* Inline call */, observation_domain_id);
+  /* Do not look on sub interfaces, Flows are always created in the same interface of its hosts.
+     The hosts are returned with a use taken under the hash lock, so that the housekeeping
+     workers cannot idle them before the caller gets hold of them. */
+  (*src) = hosts_hash->get(vlanId, _src_ip, true /* Inline call */, observation_domain_id, true /* Take a use */);
   PROFILING_SECTION_EXIT(3);
 
   if((*src) == NULL) {
@@ -3298,21 +3671,24 @@ void NetworkInterface::findFlowHosts(VLANid vlanId, u_int16_t observation_domain
     if(_src_ip
        && (_src_ip->isLocalHost(&local_network_id) || _src_ip->isLocalInterfaceAddress())) {
       PROFILING_SECTION_ENTER("NetworkInterface::findFlowHosts: new LocalHost", 4);
-      (*src) = new (std::nothrow) LocalHost(this, src_mac, vlanId, observation_domain_id, _src_ip);
+      (*src) = new (local_hosts_pool) LocalHost(this, src_mac, vlanId, observation_domain_id, _src_ip);
       PROFILING_SECTION_EXIT(4);
     } else {
       PROFILING_SECTION_ENTER("NetworkInterface::findFlowHosts: new RemoteHost", 5);
-      (*src) = new (std::nothrow) RemoteHost(this, src_mac, vlanId, observation_domain_id, _src_ip);
+      (*src) = new (remote_hosts_pool) RemoteHost(this, src_mac, vlanId, observation_domain_id, _src_ip);
       PROFILING_SECTION_EXIT(5);
     }
 
     if(*src) {
+      (*src)->incUses(); /* Before the host becomes visible to the housekeeping workers */
+
       PROFILING_SECTION_ENTER("NetworkInterface::findFlowHosts: hosts_hash->add", 6);
       bool add_res = hosts_hash->add(*src, false /* Don't lock, we're inline with the purgeIdle */);
       PROFILING_SECTION_EXIT(6);
 
       if(!add_res) {
 	//ntop->getTrace()->traceEvent(TRACE_WARNING, "Too many hosts in interface %s", ifname);
+	(*src)->decUses();
 	delete *src;
 	*src = *dst = NULL;
 	has_too_many_hosts = true;
@@ -3326,7 +3702,7 @@ void NetworkInterface::findFlowHosts(VLANid vlanId, u_int16_t observation_domain
   /* ***************************** */
 
   PROFILING_SECTION_ENTER("NetworkInterface::findFlowHosts: hosts_hash->get", 3);
-  (*dst) = hosts_hash->get(vlanId, _dst_ip, true /* Inline call */, observation_domain_id);
+  (*dst) = hosts_hash->get(vlanId, _dst_ip, true /* Inline call */, observation_domain_id, true /* Take a use */);
   PROFILING_SECTION_EXIT(3);
 
   if((*dst) == NULL) {
@@ -3339,21 +3715,24 @@ void NetworkInterface::findFlowHosts(VLANid vlanId, u_int16_t observation_domain
     if(_dst_ip
        && (_dst_ip->isLocalHost(&local_network_id) || _dst_ip->isLocalInterfaceAddress())) {
       PROFILING_SECTION_ENTER("NetworkInterface::findFlowHosts: new LocalHost", 4);
-      (*dst) = new (std::nothrow) LocalHost(this, dst_mac, vlanId, observation_domain_id, _dst_ip);
+      (*dst) = new (local_hosts_pool) LocalHost(this, dst_mac, vlanId, observation_domain_id, _dst_ip);
       PROFILING_SECTION_EXIT(4);
     } else {
       PROFILING_SECTION_ENTER("NetworkInterface::findFlowHosts: new RemoteHost", 5);
-      (*dst) = new (std::nothrow) RemoteHost(this, dst_mac, vlanId, observation_domain_id, _dst_ip);
+      (*dst) = new (remote_hosts_pool) RemoteHost(this, dst_mac, vlanId, observation_domain_id, _dst_ip);
       PROFILING_SECTION_EXIT(5);
     }
 
     if(*dst) {
+      (*dst)->incUses(); /* Before the host becomes visible to the housekeeping workers */
+
       PROFILING_SECTION_ENTER("NetworkInterface::findFlowHosts: hosts_hash->add", 6);
       bool add_res = hosts_hash->add(*dst, false /* Don't lock, we're inline with the purgeIdle */);
       PROFILING_SECTION_EXIT(6);
 
       if(!add_res) {
 	// ntop->getTrace()->traceEvent(TRACE_WARNING, "Too many hosts in interface %s", ifname);
+	(*dst)->decUses();
 	delete *dst;
 	*dst = NULL;
 	has_too_many_hosts = true;
@@ -3367,6 +3746,92 @@ void NetworkInterface::findFlowHosts(VLANid vlanId, u_int16_t observation_domain
 
 /* **************************************************** */
 
+/*
+  Called by a packet shard on the housekeeping of its flows, whose hosts are in
+  this (parent) interface: hosts are updated with the traffic of the flow since
+  the previous call, as the ViewInterface does for the flows of viewed interfaces.
+
+  NOTE: shards run concurrently, and hosts are added to the hash inline, hence
+  the shard_hosts_lock, also held while purging hosts (see purgeIdleHosts).
+*/
+void NetworkInterface::shardFlowUpdate(Flow *f, time_t t) {
+  PartializableFlowTrafficStats partials;
+  const IpAddress *cli_ip = f->get_cli_ip_addr(), *srv_ip = f->get_srv_ip_addr();
+  Host *cli_host = NULL, *srv_host = NULL;
+  NetworkStats *network_stats;
+  struct timeval tv;
+  bool first_partial;
+
+  /* Partials only touch the flow, owned by the calling shard */
+  if(!cli_ip || !srv_ip || !f->get_partial_traffic_stats_view(&partials, &first_partial))
+    return;
+
+  tv.tv_sec = t, tv.tv_usec = 0;
+
+  shard_hosts_lock.lock(__FILE__, __LINE__);
+
+  /* Hosts are returned with a use taken, released by ~Flow */
+  if(first_partial) {
+    findFlowHosts(f->get_vlan_id(), f->get_observation_point_id(),
+		  NULL /* Mac Address */, (IpAddress*)cli_ip, &cli_host,
+		  NULL /* Mac Address */, (IpAddress*)srv_ip, &srv_host);
+
+    if(f->getViewInterfaceFlowStats()) {
+      f->getViewInterfaceFlowStats()->setClientHost(cli_host);
+      f->getViewInterfaceFlowStats()->setServerHost(srv_host);
+    }
+  } else {
+    cli_host = f->getViewSharedClient();
+    srv_host = f->getViewSharedServer();
+  }
+
+  f->hosts_periodic_stats_update(this, cli_host, srv_host, &partials, first_partial, &tv);
+
+  if(cli_host) {
+    if(first_partial) {
+      network_stats = cli_host->getNetworkStats(cli_host->get_local_network_id());
+      if(network_stats) network_stats->incNumFlows(f->get_last_seen(), true);
+      cli_host->incNumFlows(f->get_last_seen(), true);
+      cli_host->setLastDeviceIp(f->getFlowDeviceIP());
+    }
+
+    if(partials.get_is_flow_alerted())
+      cli_host->incNumAlertedFlows(true /* As client */), cli_host->incTotalAlerts();
+
+    if((f->get_state() == hash_entry_state_idle) && f->isIncomplete())
+      cli_host->incIncompleteFlows();
+  }
+
+  if(srv_host) {
+    if(first_partial) {
+      network_stats = srv_host->getNetworkStats(srv_host->get_local_network_id());
+      if(network_stats) network_stats->incNumFlows(f->get_last_seen(), false);
+      srv_host->incNumFlows(f->get_last_seen(), false);
+      srv_host->setLastDeviceIp(f->getFlowDeviceIP());
+    }
+
+    if(partials.get_is_flow_alerted())
+      srv_host->incNumAlertedFlows(false /* As server */), srv_host->incTotalAlerts();
+  }
+
+  /* Score increments, decremented by ~Flow as for viewed interfaces */
+  for(int i = 0; i < MAX_NUM_SCORE_CATEGORIES; i++) {
+    ScoreCategory score_category = (ScoreCategory)i;
+    u_int16_t cli_score_val = partials.get_cli_score(score_category),
+      srv_score_val = partials.get_srv_score(score_category);
+
+    if(cli_score_val && cli_host)
+      cli_host->incScoreValue(cli_score_val, score_category, true /* as client */);
+
+    if(srv_score_val && srv_host)
+      srv_host->incScoreValue(srv_score_val, score_category, false /* as server */);
+  }
+
+  shard_hosts_lock.unlock(__FILE__, __LINE__);
+}
+
+/* **************************************************** */
+
 bool NetworkInterface::viewEnqueue(time_t t, Flow *f) {
   /*
      Enqueue is only performed when the interface is 'viewed'.
@@ -4151,8 +4616,10 @@ struct flowHostRetriever {
 
   /* Return values */
   u_int32_t maxNumEntries, actNumEntries;
+  u_int32_t totNumEntries; /* Matching entries, including those discarded by topk */
   u_int64_t totBytesSent, totBytesRcvd, totThpt;
   struct flowHostRetrieveList *elems;
+  TopKSelector *topk; /* When set, elems only holds the best entries for the paginator */
 
   bool only_traffic_stats;
   /* Used by getActiveFlowsStats */
@@ -4211,7 +4678,7 @@ static bool flow_matches(Flow *f, struct flowHostRetriever *retriever) {
     }
 
     if(retriever->host) {
-      if(!f->getInterface()->isViewed()) {
+      if(!f->getInterface()->isViewed() && !f->getInterface()->isPacketShard()) {
 	/*
 	  For non-viewed interfaces it is safe to just check on pointers equality.
 	  Indeed, the retriever->host has been obtained with getHost(), which has returned
@@ -4227,6 +4694,7 @@ static bool flow_matches(Flow *f, struct flowHostRetriever *retriever) {
 	  pointers equality. This need to use the retriever->host which comes from the view interface
 	  to retrieve an IpAddress, and check it against the flow ip address, along with the vlan.
 	  Indeed, flow ip addresses exist also when a flow doesn't have Host* as in the case of viewed interfaces.
+	  The same holds for the flows of packet shards, whose hosts are in the parent interface.
 	 */
 	if(!(retriever->host->get_ip()->equal(f->get_cli_ip_addr()) && retriever->host->get_vlan_id() == f->get_vlan_id())
 	   &&!(retriever->host->get_ip()->equal(f->get_srv_ip_addr()) && retriever->host->get_vlan_id() == f->get_vlan_id()))
@@ -4463,83 +4931,97 @@ static bool flow_matches(Flow *f, struct flowHostRetriever *retriever) {
 
 static bool flow_search_walker(GenericHashEntry *h, void *user_data, bool *matched) {
   struct flowHostRetriever *retriever = (struct flowHostRetriever*)user_data;
+  struct flowHostRetrieveList *e;
   Flow *f = (Flow*)h;
   const char *flow_info;
   const TcpInfo *tcp_info;
+  bool add = true;
 
-  if(retriever->actNumEntries >= retriever->maxNumEntries)
+  if((retriever->topk == NULL) && (retriever->actNumEntries >= retriever->maxNumEntries))
     return(true); /* Limit reached - stop iterating */
 
   if(flow_matches(f, retriever)) {
-    retriever->elems[retriever->actNumEntries].flow = f;
+    e = retriever->topk ? (struct flowHostRetrieveList*)retriever->topk->candidate() : &retriever->elems[retriever->actNumEntries];
+    e->flow = f;
     retriever->totBytesSent += f->get_bytes_cli2srv();
     retriever->totBytesRcvd += f->get_bytes_srv2cli();
 
     switch(retriever->sorter) {
       case column_client:
-	if(f->getInterface()->isViewed())
-	  retriever->elems[retriever->actNumEntries++].ipValue = (IpAddress*)f->get_cli_ip_addr();
+	if(f->getInterface()->isViewed() || f->getInterface()->isPacketShard())
+	  e->ipValue = (IpAddress*)f->get_cli_ip_addr();
 	else
-	  retriever->elems[retriever->actNumEntries++].hostValue = f->get_cli_host();
+	  e->hostValue = f->get_cli_host();
 	break;
       case column_server:
-	if(f->getInterface()->isViewed())
-	  retriever->elems[retriever->actNumEntries++].ipValue = (IpAddress*)f->get_srv_ip_addr();
+	if(f->getInterface()->isViewed() || f->getInterface()->isPacketShard())
+	  e->ipValue = (IpAddress*)f->get_srv_ip_addr();
 	else
-	  retriever->elems[retriever->actNumEntries++].hostValue = f->get_srv_host();
+	  e->hostValue = f->get_srv_host();
 	break;
       case column_vlan:
-	retriever->elems[retriever->actNumEntries++].numericValue = f->get_vlan_id();
+	e->numericValue = f->get_vlan_id();
 	break;
       case column_proto_l4:
-	retriever->elems[retriever->actNumEntries++].numericValue = f->get_protocol();
+	e->numericValue = f->get_protocol();
 	break;
       case column_ndpi:
-	retriever->elems[retriever->actNumEntries++].numericValue = f->get_detected_protocol().app_protocol;
+	e->numericValue = f->get_detected_protocol().app_protocol;
 	  break;
   case column_duration:
-	  retriever->elems[retriever->actNumEntries++].numericValue = f->get_duration();
+	  e->numericValue = f->get_duration();
 	  break;
   case column_score:
-    retriever->elems[retriever->actNumEntries++].numericValue = f->getScore();
+    e->numericValue = f->getScore();
     break;
   case column_thpt:
-	  retriever->elems[retriever->actNumEntries++].numericValue = f->get_bytes_thpt();
+	  e->numericValue = f->get_bytes_thpt();
 	break;
       case column_bytes:
-	retriever->elems[retriever->actNumEntries++].numericValue = f->get_bytes();
+	e->numericValue = f->get_bytes();
 	break;
       case column_last_seen:
-  retriever->elems[retriever->actNumEntries++].numericValue = f->get_last_seen();
+  e->numericValue = f->get_last_seen();
   break;
       case column_first_seen:
-  retriever->elems[retriever->actNumEntries++].numericValue = f->get_first_seen();
+  e->numericValue = f->get_first_seen();
   break;
       case column_client_rtt:
 	if((tcp_info = f->getClientTcpInfo()))
-	  retriever->elems[retriever->actNumEntries++].numericValue = (u_int64_t)(tcp_info->rtt * 1000);
+	  e->numericValue = (u_int64_t)(tcp_info->rtt * 1000);
 	else
-	  retriever->elems[retriever->actNumEntries++].numericValue = 0;
+	  e->numericValue = 0;
 	break;
       case column_server_rtt:
 	if((tcp_info = f->getServerTcpInfo()))
-	  retriever->elems[retriever->actNumEntries++].numericValue = (u_int64_t)(tcp_info->rtt * 1000);
+	  e->numericValue = (u_int64_t)(tcp_info->rtt * 1000);
 	else
-	  retriever->elems[retriever->actNumEntries++].numericValue = 0;
+	  e->numericValue = 0;
 	break;
       case column_info:
 	{
 	  char buf[64];
 
 	  flow_info = f->getFlowInfo(buf, sizeof(buf), false);
-	  retriever->elems[retriever->actNumEntries++].stringValue = flow_info ? flow_info : (char*)"";
+	  e->stringValue = flow_info ? flow_info : (char*)"";
 	}
 	break;
       default:
 	ntop->getTrace()->traceEvent(TRACE_WARNING, "Internal error: column %d not handled", retriever->sorter);
+	add = false;
 	break;
     }
 
+    if(add) {
+      retriever->totNumEntries++;
+
+      if(retriever->topk) {
+	retriever->topk->commit();
+	retriever->actNumEntries = retriever->topk->size();
+      } else
+	retriever->actNumEntries++;
+    }
+
     *matched = true;
   }
 
@@ -5067,8 +5549,10 @@ int NetworkInterface::sortFlows(u_int32_t *begin_slot,
 				AddressTree *allowed_hosts,
 				Host *host,
 				Paginator *p,
-				const char *sortColumn) {
+				const char *sortColumn,
+				bool top_only) {
   int (*sorter)(const void *_a, const void *_b);
+  u_int32_t num_top = 0;
 
   if(retriever == NULL)
     return(-1);
@@ -5076,18 +5560,27 @@ int NetworkInterface::sortFlows(u_int32_t *begin_slot,
   retriever->pag = p;
   retriever->host = host, retriever->location = location_all;
   retriever->ndpi_proto = -1;
-  retriever->actNumEntries = 0, retriever->maxNumEntries = getFlowsHashSize(), retriever->allowed_hosts = allowed_hosts;
+  retriever->actNumEntries = 0, retriever->totNumEntries = 0, retriever->maxNumEntries = getFlowsHashSize(), retriever->allowed_hosts = allowed_hosts;
+  retriever->topk = NULL;
 
-  retriever->elems = (struct flowHostRetrieveList*)calloc(sizeof(struct flowHostRetrieveList), retriever->maxNumEntries);
+  /*
+    When only a page is requested there is no need to keep and sort all the
+    matching flows: the best toSkip()+maxHits() are selected while walking
+  */
+  if(top_only && p && ((u_int64_t)p->toSkip() + p->maxHits() < retriever->maxNumEntries))
+    num_top = p->toSkip() + p->maxHits();
+
+  retriever->elems = (struct flowHostRetrieveList*)calloc(sizeof(struct flowHostRetrieveList),
+							  num_top ? (num_top + 1 /* Candidate */) : retriever->maxNumEntries);
 
   if(retriever->elems == NULL) {
     ntop->getTrace()->traceEvent(TRACE_WARNING, "Out of memory :-(");
     return(-1);
   }
 
-  if(!strcmp(sortColumn, "column_client")) retriever->sorter = column_client, sorter = (isViewed() || isView()) ? ipSorter : hostSorter;
+  if(!strcmp(sortColumn, "column_client")) retriever->sorter = column_client, sorter = (isViewed() || isView() || hasPacketShards()) ? ipSorter : hostSorter;
   else if(!strcmp(sortColumn, "column_vlan")) retriever->sorter = column_vlan, sorter = numericSorter;
-  else if(!strcmp(sortColumn, "column_server")) retriever->sorter = column_server, sorter = (isViewed() || isView()) ? ipSorter : hostSorter;
+  else if(!strcmp(sortColumn, "column_server")) retriever->sorter = column_server, sorter = (isViewed() || isView() || hasPacketShards()) ? ipSorter : hostSorter;
   else if(!strcmp(sortColumn, "column_proto_l4")) retriever->sorter = column_proto_l4, sorter = numericSorter;
   else if(!strcmp(sortColumn, "column_ndpi")) retriever->sorter = column_ndpi, sorter = numericSorter;
   else if(!strcmp(sortColumn, "column_duration")) retriever->sorter = column_duration, sorter = numericSorter;
@@ -5106,10 +5599,28 @@ int NetworkInterface::sortFlows(u_int32_t *begin_slot,
     retriever->sorter = column_bytes, sorter = numericSorter;
   }
 
+  if(num_top) {
+    try {
+      /* Ascending results are read from the head of elems, descending ones from the tail */
+      retriever->topk = new TopKSelector(retriever->elems, sizeof(struct flowHostRetrieveList),
+					 num_top, sorter, !p->a2zSortOrder());
+    } catch(std::bad_alloc& ba) {
+      free(retriever->elems);
+      retriever->elems = NULL;
+      ntop->getTrace()->traceEvent(TRACE_WARNING, "Out of memory :-(");
+      return(-1);
+    }
+  }
+
   // make sure the caller has disabled the purge!!
-  walker(begin_slot, walk_all,  walker_flows, flow_search_walker, (void*)retriever);
+  walkFlows(begin_slot, walk_all, p, (isViewed() || isView() || hasPacketShards()) ? NULL : host, flow_search_walker, (void*)retriever);
 
-  qsort(retriever->elems, retriever->actNumEntries, sizeof(struct flowHostRetrieveList), sorter);
+  if(retriever->topk) {
+    retriever->topk->sort();
+    delete retriever->topk;
+    retriever->topk = NULL;
+  } else
+    qsort(retriever->elems, retriever->actNumEntries, sizeof(struct flowHostRetrieveList), sorter);
 
   return(retriever->actNumEntries);
 }
@@ -5162,7 +5673,7 @@ void NetworkInterface::getActiveFlowsStats(nDPIStats *ndpi_stats, FlowStats *sta
   retriever.only_traffic_stats = only_traffic_stats;
   retriever.observationPointId = getLuaVMUservalue(vm, observationPointId);
 
-  walker(&begin_slot, walk_all, walker_flows, flow_sum_stats, &retriever);
+  walkFlows(&begin_slot, walk_all, p, (isViewed() || isView() || hasPacketShards()) ? NULL : h, flow_sum_stats, &retriever);
 
   lua_newtable(vm);
   /* Overview stats */
@@ -5207,12 +5718,12 @@ int NetworkInterface::getFlows(lua_State* vm,
 
   retriever.observationPointId = getLuaVMUservalue(vm, observationPointId);
 
-  if(sortFlows(begin_slot, walk_all, &retriever, allowed_hosts, host, p, sortColumn) < 0) {
+  if(sortFlows(begin_slot, walk_all, &retriever, allowed_hosts, host, p, sortColumn, true /* Only the page */) < 0) {
     return(-1);
   }
 
   lua_newtable(vm);
-  lua_push_uint64_table_entry(vm, "numFlows", retriever.actNumEntries);
+  lua_push_uint64_table_entry(vm, "numFlows", retriever.totNumEntries);
   lua_push_uint64_table_entry(vm, "nextSlot", *begin_slot);
 
   lua_newtable(vm);
@@ -5249,7 +5760,7 @@ int NetworkInterface::getFlows(lua_State* vm,
 
   if(retriever.elems) free(retriever.elems);
 
-  return(retriever.actNumEntries);
+  return(retriever.totNumEntries);
 }
 
 /* **************************************************** */
@@ -5270,7 +5781,7 @@ int NetworkInterface::getFlowsGroup(lua_State* vm,
 
   retriever.observationPointId = getLuaVMUservalue(vm, observationPointId);
 
-  if(sortFlows(&begin_slot, walk_all, &retriever, allowed_hosts, NULL, p, groupColumn) < 0) {
+  if(sortFlows(&begin_slot, walk_all, &retriever, allowed_hosts, NULL, p, groupColumn, false /* Groups need all flows */) < 0) {
     return(-1);
   }
 
@@ -5931,6 +6442,10 @@ void NetworkInterface::reloadFlowChecks(FlowChecksLoader *fcbl) {
   if(prev_flow_checks_executor) delete prev_flow_checks_executor;
   prev_flow_checks_executor = flow_checks_executor;
   flow_checks_executor = fce;
+
+  /* Packet shards are not known to ntop: reload them along with this interface */
+  for(u_int8_t i = 0; i < num_packet_shards; i++)
+    packet_shards[i]->getInterface()->reloadFlowChecks(fcbl);
 }
 
 /* **************************************************** */
@@ -6025,7 +6540,12 @@ u_int64_t NetworkInterface::getNumDiscardedProbingBytes() const {
 /* **************************************************** */
 
 u_int NetworkInterface::getNumFlows() {
-  return(flows_hash ? flows_hash->getNumEntries() : 0);
+  u_int n = flows_hash ? flows_hash->getNumEntries() : 0;
+
+  for(u_int8_t i = 0; i < num_packet_shards; i++)
+    n += packet_shards[i]->getInterface()->getNumFlows();
+
+  return(n);
 };
 
 /* **************************************************** */
@@ -6078,7 +6598,10 @@ u_int NetworkInterface::purgeIdleHosts(bool force_idle, bool full_scan) {
 #endif
 
     // ntop->getTrace()->traceEvent(TRACE_INFO, "Purging idle hosts");
+    /* Packet shards add and update hosts concurrently, see shardFlowUpdate */
+    if(hasPacketShards()) shard_hosts_lock.lock(__FILE__, __LINE__);
     n = (hosts_hash ? hosts_hash->purgeIdle(&tv, force_idle, full_scan) : 0);
+    if(hasPacketShards()) shard_hosts_lock.unlock(__FILE__, __LINE__);
 
     next_idle_host_purge = last_packet_time + HOST_PURGE_FREQUENCY;
     return(n);
@@ -6098,12 +6621,15 @@ u_int NetworkInterface::purgeIdleMacsASesCountriesVLANs(bool force_idle, bool fu
     u_int n;
     /* If the interface is no longer running it is safe to force all entries as idle */
 
+    /* Created along with the hosts, see purgeIdleHosts */
+    if(hasPacketShards()) shard_hosts_lock.lock(__FILE__, __LINE__);
     n = (macs_hash ? macs_hash->purgeIdle(&tv, force_idle, full_scan) : 0)
       + (ases_hash ? ases_hash->purgeIdle(&tv, force_idle, full_scan) : 0)
       + (oses_hash ? oses_hash->purgeIdle(&tv, force_idle, full_scan) : 0)
       + (countries_hash ? countries_hash->purgeIdle(&tv, force_idle, full_scan) : 0)
       + (vlans_hash ? vlans_hash->purgeIdle(&tv, force_idle, full_scan) : 0)
       + (obs_hash ? obs_hash->purgeIdle(&tv, force_idle, full_scan) : 0);
+    if(hasPacketShards()) shard_hosts_lock.unlock(__FILE__, __LINE__);
 
     next_idle_other_purge = last_packet_time + OTHER_PURGE_FREQUENCY;
 
@@ -6244,6 +6770,15 @@ void NetworkInterface::sumStats(TcpFlowStats *_tcpFlowStats,
 
   if(upload_stats && _uploadStats)
     upload_stats->sum(_uploadStats);
+
+  if(num_packet_shards > 0) {
+    EthStats shardsEthStats; /* Already accounted by the capture thread */
+
+    for(u_int8_t i = 0; i < num_packet_shards; i++)
+      packet_shards[i]->getInterface()->sumStats(_tcpFlowStats, &shardsEthStats, _localStats, _ndpiStats,
+						  _pktStats, _tcpPacketStats, _discardedProbingStats,
+						  _dscpStats, _syslogStats, _downloadStats, _uploadStats);
+  }
 }
 
 /* *************************************** */
@@ -6282,6 +6817,17 @@ void NetworkInterface::lua(lua_State *vm) {
 #endif
 #endif
 
+  if(num_packet_shards > 0) {
+    lua_newtable(vm);
+
+    for(u_int8_t i = 0; i < num_packet_shards; i++)
+      packet_shards[i]->lua(vm);
+
+    lua_pushstring(vm, "packet_shards");
+    lua_insert(vm, -2);
+    lua_settable(vm, -3);
+  }
+
   lua_push_bool_table_entry(vm, "isFlowDumpDisabled", isFlowDumpDisabled());
   lua_push_bool_table_entry(vm, "isFlowDumpRunning", db != NULL);
   lua_push_uint64_table_entry(vm, "seen.last", getTimeLastPktRcvd());
@@ -6424,6 +6970,9 @@ void NetworkInterface::luaSubInterface(lua_State *vm) {
     lua_push_str_table_entry(vm, "dynamic_interface_probe_ip", Utils::intoaV4(dynamic_interface_criteria >> 32, buf, sizeof(buf)));
     lua_push_uint64_table_entry(vm, "dynamic_interface_inifidx", dynamic_interface_criteria & 0xFFFFFFFF);
     break;
+  case flowhashing_packet_shard:
+    lua_push_uint64_table_entry(vm, "dynamic_interface_shard_id", dynamic_interface_criteria);
+    break;
   default:
     break;
   }
@@ -6471,6 +7020,7 @@ void NetworkInterface::lua_queues_stats(lua_State *vm) {
   if(idleFlowsToDump)   idleFlowsToDump->lua(vm);
   if(activeFlowsToDump) activeFlowsToDump->lua(vm);
   if(flowAlertsQueue)  flowAlertsQueue->lua(vm);
+  if(local_host_cache) local_host_cache->lua(vm);
 }
 
 /* **************************************************** */
@@ -6771,7 +7321,14 @@ Flow* NetworkInterface::findFlowByKeyAndHashId(u_int32_t key, u_int hash_id, Add
   if(!flows_hash)
     return NULL;
 
-  f = flows_hash->findByKeyAndHashId(key, hash_id);
+  if(num_packet_shards > 0) {
+    /* The hash id encodes the shard owning the flow, see initPacketShards */
+    u_int8_t unit = hash_id % ntop->getPrefs()->get_num_packet_shards();
+
+    if(unit < num_packet_shards)
+      f = packet_shards[unit]->getInterface()->findFlowByKeyAndHashId(key, hash_id, NULL);
+  } else
+    f = flows_hash->findByKeyAndHashId(key, hash_id);
 
   if(f && (!f->match(allowed_hosts))) f = NULL;
 
@@ -7208,6 +7765,36 @@ void NetworkInterface::FillObsHash() {
 
 /* **************************************** */
 
+void NetworkInterface::allocateFlowsPools() {
+  u_int32_t max_num_flows = ntop->getPrefs()->get_max_num_flows();
+
+  /* Slabs are allocated on demand: no memory is used by the pools that are never used */
+  flows_pool      = new (std::nothrow) ObjectPool("Flow", sizeof(Flow), max_num_flows);
+  ndpi_flows_pool = new (std::nothrow) ObjectPool("ndpi_flow_struct", get_flow_size(), max_num_flows);
+
+  if(flows_pool)      flows_hash->addPool(flows_pool);
+  if(ndpi_flows_pool) flows_hash->addPool(ndpi_flows_pool);
+}
+
+/* **************************************** */
+
+void NetworkInterface::allocateHostsPools() {
+  u_int32_t max_num_hosts = ntop->getPrefs()->get_max_num_hosts();
+  ObjectPool **pools[] = { &local_hosts_pool, &remote_hosts_pool, &local_host_stats_pool };
+
+  local_hosts_pool      = new (std::nothrow) ObjectPool("LocalHost", sizeof(LocalHost), max_num_hosts);
+  remote_hosts_pool     = new (std::nothrow) ObjectPool("RemoteHost", sizeof(RemoteHost), max_num_hosts);
+  /* Hosts keep a second copy of their stats as initial timeseries point */
+  local_host_stats_pool = new (std::nothrow) ObjectPool("LocalHostStats", sizeof(LocalHostStats), 2 * max_num_hosts);
+
+  for(u_int i = 0; i < sizeof(pools) / sizeof(pools[0]); i++) {
+    if(*pools[i])
+      hosts_hash->addPool(*pools[i]);
+  }
+}
+
+/* **************************************** */
+
 void NetworkInterface::allocateStructures() {
   u_int8_t numNetworks = ntop->getNumLocalNetworks();
   char buf[16];
@@ -7217,12 +7804,18 @@ void NetworkInterface::allocateStructures() {
       u_int32_t num_hashes = max_val(4096, ntop->getPrefs()->get_max_num_flows()/4);
 
       flows_hash     = new FlowHash(this, num_hashes, ntop->getPrefs()->get_max_num_flows());
+      allocateFlowsPools();
 
       if(!flowsOnlyInterface() /* Do not allocate HTs when the interface should only have flows */
-	 && !isViewed() /* Do not allocate HTs when the interface is viewed, HTs are allocated in the corresponding ViewInterface */)
+	 && !isViewed() /* Do not allocate HTs when the interface is viewed, HTs are allocated in the corresponding ViewInterface */
+	 && !isPacketShard() /* Same for packet shards, HTs are allocated in the parent interface */)
 	{
 	  num_hashes     = max_val(4096, ntop->getPrefs()->get_max_num_hosts() / 4);
 	  hosts_hash     = new HostHash(this, num_hashes, ntop->getPrefs()->get_max_num_hosts());
+	  allocateHostsPools();
+	  if(ntop->getPrefs()->is_idle_local_host_cache_enabled()
+	     || ntop->getPrefs()->is_active_local_host_cache_enabled())
+	    local_host_cache = new (std::nothrow) LocalHostCache(this);
 	  /* The number of ASes cannot be greater than the number of hosts */
 	  ases_hash      = new AutonomousSystemHash(this, ndpi_min(num_hashes, 4096), 32768);
 	  if(!isPacketInterface()) obs_hash = new ObservationPointHash(this, ndpi_min(num_hashes, 4096), 32768);
@@ -7236,7 +7829,8 @@ void NetworkInterface::allocateStructures() {
     FillObsHash();
 
     networkStats     = new NetworkStats*[numNetworks];
-    statsManager     = new StatsManager(id, STATS_MANAGER_STORE_NAME);
+    if(!isPacketShard()) /* Shares the parent id, hence the store */
+      statsManager   = new StatsManager(id, STATS_MANAGER_STORE_NAME);
     ndpiStats        = new nDPIStats(true /* Enable throughput calculation */, ntop->getPrefs()->isIfaceL7BehavourAnalysisEnabled());
     dscpStats        = new DSCPStats();
 
@@ -7245,8 +7839,10 @@ void NetworkInterface::allocateStructures() {
 
     gw_macs          = new MacHash(this, 32, 64);
 
-    top_sites = new (std::nothrow) MostVisitedList(HOST_SITES_TOP_NUMBER);
-    top_os    = new (std::nothrow) MostVisitedList(HOST_SITES_TOP_NUMBER);
+    if(!isPacketShard()) { /* Sites are visited by hosts, kept by the parent */
+      top_sites = new (std::nothrow) MostVisitedList(HOST_SITES_TOP_NUMBER);
+      top_os    = new (std::nothrow) MostVisitedList(HOST_SITES_TOP_NUMBER);
+    }
 
     /* Allocations for the system interface */
     if(ntop->getSystemInterface() == this) {
@@ -7265,7 +7861,7 @@ void NetworkInterface::allocateStructures() {
       }
     }
 
-    if(!isViewed()) {
+    if(!isViewed() && !isPacketShard()) {
 #if defined(HAVE_CLICKHOUSE) && defined(HAVE_MYSQL)
       if(ntop->getPrefs()->useClickHouse())
 	alertStore    = new ClickHouseAlertStore(this);
@@ -7296,6 +7892,7 @@ void NetworkInterface::allocateStructures() {
      && ifname
      && strcmp(ifname, SYSTEM_INTERFACE_NAME)
      && !isViewed() /* Skip for viewed interface, only store service maps in the view to save memory */
+     && !isPacketShard() /* Same for packet shards and their parent */
      ) {
     pMap = new (std::nothrow) PeriodicityMap(this, ntop->getPrefs()->get_max_num_flows()/8, 3600 /* 1h idleness */);
     sMap = new (std::nothrow) ServiceMap    (this, ntop->getPrefs()->get_max_num_flows()/8, 86400 /* 1d idleness */);
@@ -7319,6 +7916,8 @@ void NetworkInterface::allocateStructures() {
 AlertsQueue *NetworkInterface::getAlertsQueue() const {
   if(isViewed())
     return viewedBy()->getAlertsQueue();
+  else if(isPacketShard())
+    return getShardParent()->getAlertsQueue();
   else
     return alertsQueue;
 }
@@ -8350,6 +8949,10 @@ bool NetworkInterface::initFlowDump(u_int8_t num_dump_interfaces) {
     /* No need to allocate databases on view interfaces */
     return(true);
 
+  /* Same for packet shards, dumped by their parent */
+  if(isPacketShard())
+    return(true);
+
   if(db == NULL) {
     if(ntop->getPrefs()->do_dump_flows_on_mysql()) {
 #ifdef NTOPNG_PRO
@@ -9325,9 +9928,9 @@ void NetworkInterface::checkHostsToRestore() {
 
     /* TODO provide the host MAC address when available to properly restore LBD hosts */
     if(ipa.isLocalHost(&local_network_id) || ipa.isLocalInterfaceAddress())
-      h = new (std::nothrow) LocalHost(this, mac, vlan_id, 0 /* any observation point */, &ipa);
+      h = new (local_hosts_pool) LocalHost(this, mac, vlan_id, 0 /* any observation point */, &ipa);
     else
-      h = new (std::nothrow) RemoteHost(this, mac, vlan_id, 0 /* any observation point */, &ipa);
+      h = new (remote_hosts_pool) RemoteHost(this, mac, vlan_id, 0 /* any observation point */, &ipa);
 
     if(!h)
       goto next_host;
@@ -9419,6 +10022,8 @@ void NetworkInterface::luaServiceMap(lua_State* vm,
 void NetworkInterface::updateFlowPeriodicity(Flow *f) {
   if(isViewed())
     viewedBy()->updateFlowPeriodicity(f);
+  else if(isPacketShard())
+    getShardParent()->updateFlowPeriodicity(f);
   else if(pMap)
     pMap->updateElement(f, f->get_first_seen());
 }
@@ -9428,6 +10033,8 @@ void NetworkInterface::updateFlowPeriodicity(Flow *f) {
 void NetworkInterface::updateServiceMap(Flow *f) {
   if(isViewed())
     viewedBy()->updateServiceMap(f);
+  else if(isPacketShard())
+    getShardParent()->updateServiceMap(f);
   else if(sMap)
     sMap->update(f, f->get_first_seen());
 }
@@ -9516,6 +10123,15 @@ void NetworkInterface::execFlowBeginChecks(Flow *f) {
 
 /* *************************************** */
 
+void NetworkInterface::luaFlowChecksStats(lua_State *vm) {
+  lua_newtable(vm);
+
+  if(flow_checks_executor)
+    flow_checks_executor->lua(vm);
+}
+
+/* *************************************** */
+
 void NetworkInterface::luaScore(lua_State *vm) {
   /* Score */
   lua_newtable(vm);
@@ -78,6 +78,11 @@ Ntop::Ntop(const char *appName) {
   hostChecksReloadInProgress = true;
   flow_checks_loader = NULL;
   host_checks_loader = NULL;
+  host_checks_scheduler = NULL;
+  housekeeping_engine = NULL;
+  rrd_write_engine = NULL;
+  ts_store = NULL;
+  influxdb_streamer = NULL;
 
   /* Flow alerts exclusions */
 #ifdef NTOPNG_PRO
@@ -276,6 +281,11 @@ Ntop::~Ntop() {
   if(purgeLoop_started)
     pthread_join(purgeLoop, NULL);
 
+  if(host_checks_scheduler) {
+    delete host_checks_scheduler;
+    host_checks_scheduler = NULL; /* Checked by the Host destructor */
+  }
+
   for(int i = 0; i < num_defined_interfaces; i++) {
     if(iface[i]) {
       delete iface[i];
@@ -287,6 +297,12 @@ Ntop::~Ntop() {
 
   if(system_interface)    delete system_interface;
 
+  /* After the interfaces, as their hash tables unregister from it */
+  if(housekeeping_engine) delete housekeeping_engine;
+  if(rrd_write_engine)    delete rrd_write_engine;
+  if(ts_store)            delete ts_store;
+  if(influxdb_streamer)   delete influxdb_streamer;
+
   if(extract)             delete extract;
 
 #ifndef WIN32
@@ -374,7 +390,8 @@ void Ntop::registerPrefs(Prefs *_prefs, bool quick_registration) {
 
   /* Initialize redis and populate some default values */
   Utils::initRedis(&redis, prefs->get_redis_host(), prefs->get_redis_password(),
-		   prefs->get_redis_port(), prefs->get_redis_db_id(), quick_registration);
+		   prefs->get_redis_port(), prefs->get_redis_db_id(), quick_registration,
+		   prefs->get_num_redis_connections());
   if(redis) redis->setDefaults();
 
   if(!quick_registration) {
@@ -544,6 +561,26 @@ void Ntop::start() {
   checkReloadFlowChecks();
   checkReloadHostChecks();
 
+  if((host_checks_scheduler = new (std::nothrow) HostChecksScheduler()) != NULL)
+    host_checks_scheduler->start();
+  else
+    ntop->getTrace()->traceEvent(TRACE_WARNING, "Unable to start the host checks scheduler: checks will run inline");
+
+  if(prefs->get_num_housekeeping_workers() > 0
+     && (housekeeping_engine = new (std::nothrow) HousekeepingEngine(prefs->get_num_housekeeping_workers())) != NULL)
+    housekeeping_engine->start();
+
+  if(prefs->get_num_rrd_writers() > 0
+     && (rrd_write_engine = new (std::nothrow) RRDWriteEngine(prefs->get_num_rrd_writers())) != NULL)
+    rrd_write_engine->start();
+
+  /* Files are only created when the tsdb timeseries driver is used */
+  ts_store = new (std::nothrow) TimeseriesStore(working_dir);
+
+  /* Idle until the influxdb timeseries driver is used */
+  if((influxdb_streamer = new (std::nothrow) InfluxDBStreamer()) != NULL)
+    influxdb_streamer->start();
+
   for(int i=0; i<num_defined_interfaces; i++)
     iface[i]->startPacketPolling();
 
@@ -974,6 +1011,13 @@ void Ntop::lua_periodic_activities_stats(NetworkInterface *iface, lua_State* vm)
 
 /* ******************************************* */
 
+void Ntop::purgePeriodicActivitiesVMs(NetworkInterface *iface) {
+  if(pa)
+    pa->purgeVMs(iface);
+}
+
+/* ******************************************* */
+
 void Ntop::lua_alert_queues_stats(lua_State* vm) {
   lua_newtable(vm);
 
@@ -1004,8 +1048,8 @@ bool Ntop::recipient_enqueue(u_int16_t recipient_id, const AlertFifoItem* const
 
 /* ******************************************* */
 
-bool Ntop::recipient_dequeue(u_int16_t recipient_id, AlertFifoItem *notification) {
-  return recipients.dequeue(recipient_id, notification);
+u_int32_t Ntop::recipient_dequeue(u_int16_t recipient_id, AlertFifoItem *notifications, u_int32_t max_notifications) {
+  return recipients.dequeue(recipient_id, notifications, max_notifications);
 }
 
 /* ******************************************* */
@@ -2831,9 +2875,29 @@ void Ntop::shutdownAll() {
    Periodic activites should not run during interfaces shutdown */
   ntop->shutdownPeriodicActivities();
 
+  /* Stop the host checks workers and release the queued hosts before the interfaces go away */
+  if(host_checks_scheduler)
+    host_checks_scheduler->shutdown();
+
   /* Perform shutdown operations on all active interfaces */
   ntop->shutdownInterfaces();
 
+  /* Interfaces have walked their hash tables inline one last time */
+  if(housekeeping_engine)
+    housekeeping_engine->shutdown();
+
+  /* Writes the RRD updates still journaled */
+  if(rrd_write_engine)
+    rrd_write_engine->shutdown();
+
+  /* Writes the head blocks of the embedded timeseries store */
+  if(ts_store)
+    ts_store->flush(true);
+
+  /* Posts the InfluxDB points still queued */
+  if(influxdb_streamer)
+    influxdb_streamer->shutdown();
+
   ntop->getTrace()->traceEvent(TRACE_NORMAL, "Executing shutdown script [%s]", SHUTDOWN_SCRIPT_PATH);
 
   /* Exec shutdown script before shutting down ntopng */
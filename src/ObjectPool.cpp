@@ -0,0 +1,251 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#include "ntop_includes.h"
+
+/* ******************************************* */
+
+ObjectPool::ObjectPool(const char *_name, size_t _object_size, u_int32_t max_objects) {
+  name = strdup(_name ? _name : "???");
+  object_size = _object_size;
+  /* Keep the objects 16-byte aligned, as malloc does */
+  chunk_size = (sizeof(pool_chunk_t) + object_size + 15) & ~((size_t)15);
+  objects_per_slab = max_val(OBJECT_POOL_SLAB_SIZE / chunk_size, 16);
+  max_slabs = max_val((max_objects + objects_per_slab - 1) / objects_per_slab, 1);
+
+  local_free = NULL;
+  remote_free.store(NULL);
+  owner_state.store(0);
+
+  num_slabs = num_in_use = 0;
+  num_refs = 1;
+  num_allocs = num_fallback_allocs = num_remote_frees = 0;
+}
+
+/* ******************************************* */
+
+/* Called by the last unref(): no object is in use anymore */
+ObjectPool::~ObjectPool() {
+  for(std::vector<void*>::iterator it = slabs.begin(); it != slabs.end(); ++it)
+    free(*it);
+
+  free(name);
+}
+
+/* ******************************************* */
+
+void ObjectPool::destroy() {
+  if(num_in_use > 0)
+    ntop->getTrace()->traceEvent(TRACE_INFO, "[%s] %u objects still in use: pool released with the last one",
+				 name, (u_int32_t)num_in_use);
+
+  unref();
+}
+
+/* ******************************************* */
+
+void ObjectPool::unref() {
+  if(num_refs.fetch_sub(1) == 1)
+    delete this;
+}
+
+/* ******************************************* */
+
+/* The first thread allocating from the pool becomes its owner */
+bool ObjectPool::isOwner() {
+  u_int8_t state = owner_state.load();
+
+  if(state == 0) {
+    if(owner_state.compare_exchange_strong(state, 1)) {
+      owner = pthread_self();
+      owner_state.store(2);
+      return(true);
+    }
+  }
+
+  return((owner_state.load() == 2) && pthread_equal(owner, pthread_self()));
+}
+
+/* ******************************************* */
+
+bool ObjectPool::addSlab() {
+  char *slab;
+
+  if((num_slabs >= max_slabs)
+     || ((slab = (char*)malloc(objects_per_slab * chunk_size)) == NULL))
+    return(false);
+
+  try {
+    slabs.push_back(slab);
+  } catch(std::bad_alloc& ba) {
+    free(slab);
+    return(false);
+  }
+
+  for(u_int32_t i = 0; i < objects_per_slab; i++) {
+    pool_chunk_t *c = (pool_chunk_t*)&slab[i * chunk_size];
+
+    c->pool = this, c->next = local_free;
+    local_free = c;
+  }
+
+  num_slabs++;
+  return(true);
+}
+
+/* ******************************************* */
+
+void* ObjectPool::mallocChunk(size_t sz) {
+  pool_chunk_t *c = (pool_chunk_t*)malloc(sizeof(pool_chunk_t) + sz);
+
+  if(!c) return(NULL);
+
+  c->pool = NULL, c->next = NULL;
+  return(c + 1);
+}
+
+/* ******************************************* */
+
+void* ObjectPool::alloc(size_t sz) {
+  pool_chunk_t *c;
+
+  if((sz > object_size) || !isOwner()) {
+    num_fallback_allocs++;
+    return(mallocChunk(sz));
+  }
+
+  if(!local_free) {
+    /* Take back, in one shot, all the objects released by the other threads */
+    local_free = remote_free.exchange(NULL);
+
+    if(!local_free && !addSlab()) {
+      num_fallback_allocs++;
+      return(mallocChunk(sz));
+    }
+  }
+
+  c = local_free, local_free = c->next;
+  num_in_use++, num_allocs++, num_refs++;
+
+  return(c + 1);
+}
+
+/* ******************************************* */
+
+void ObjectPool::push(pool_chunk_t *c) {
+  num_in_use--;
+
+  if(isOwner())
+    c->next = local_free, local_free = c;
+  else {
+    /* Multiple producers, the only consumer takes the whole stack (no ABA) */
+    pool_chunk_t *head = remote_free.load();
+
+    do {
+      c->next = head;
+    } while(!remote_free.compare_exchange_weak(head, c));
+
+    num_remote_frees++;
+  }
+
+  unref(); /* Last, as it can delete the pool */
+}
+
+/* ******************************************* */
+
+void ObjectPool::release(void *ptr) {
+  pool_chunk_t *c;
+
+  if(!ptr) return;
+
+  c = chunkOf(ptr);
+
+  if(c->pool)
+    c->pool->push(c);
+  else
+    free(c);
+}
+
+/* ******************************************* */
+
+void ObjectPool::lua(lua_State *vm) {
+  u_int64_t capacity = (u_int64_t)num_slabs * objects_per_slab;
+
+  lua_newtable(vm);
+
+  lua_push_uint64_table_entry(vm, "object_size", object_size);
+  lua_push_uint32_table_entry(vm, "num_slabs", num_slabs);
+  lua_push_uint32_table_entry(vm, "max_slabs", max_slabs);
+  lua_push_uint64_table_entry(vm, "capacity", capacity);
+  lua_push_uint32_table_entry(vm, "num_in_use", num_in_use);
+  lua_push_float_table_entry(vm, "occupancy_pct", capacity ? ((float)num_in_use * 100) / capacity : 0);
+  lua_push_uint64_table_entry(vm, "memory_bytes", (u_int64_t)num_slabs * objects_per_slab * chunk_size);
+  lua_push_uint64_table_entry(vm, "num_allocs", num_allocs);
+  lua_push_uint64_table_entry(vm, "num_fallback_allocs", num_fallback_allocs);
+  lua_push_uint64_table_entry(vm, "num_remote_frees", num_remote_frees);
+
+  lua_pushstring(vm, name);
+  lua_insert(vm, -2);
+  lua_settable(vm, -3);
+}
+
+/* ******************************************* */
+
+void* PoolAllocated::operator new(size_t sz) {
+  void *ptr = ObjectPool::alloc(NULL, sz);
+
+  if(!ptr) throw std::bad_alloc();
+
+  return(ptr);
+}
+
+/* ******************************************* */
+
+void* PoolAllocated::operator new(size_t sz, const std::nothrow_t&) throw() {
+  return(ObjectPool::alloc(NULL, sz));
+}
+
+/* ******************************************* */
+
+void* PoolAllocated::operator new(size_t sz, ObjectPool *pool) throw() {
+  return(ObjectPool::alloc(pool, sz));
+}
+
+/* ******************************************* */
+
+void PoolAllocated::operator delete(void *ptr) {
+  ObjectPool::release(ptr);
+}
+
+/* ******************************************* */
+
+void PoolAllocated::operator delete(void *ptr, const std::nothrow_t&) {
+  ObjectPool::release(ptr);
+}
+
+/* ******************************************* */
+
+void PoolAllocated::operator delete(void *ptr, ObjectPool *pool) {
+  ObjectPool::release(ptr);
+}
+
+/* ******************************************* */
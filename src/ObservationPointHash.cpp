@@ -30,35 +30,17 @@ ObservationPointHash::ObservationPointHash(NetworkInterface *_iface, u_int _num_
 
 /* ************************************ */
 
-ObservationPoint* ObservationPointHash::get(u_int16_t obs_point, bool is_inline_call) {
-  if(obs_point == 0 || obs_point == (u_int16_t) -1)
-    return(NULL);
-  else {
-    u_int32_t hash = obs_point;
-
-    hash %= num_hashes;
-
-    if(table[hash] == NULL) {
-      return(NULL);
-    } else {
-      ObservationPoint *head;
-
-      if(!is_inline_call)
-	locks[hash]->rdlock(__FILE__, __LINE__);
+static bool obs_point_matches(GenericHashEntry *h, void *user_data) {
+  ObservationPoint *op = (ObservationPoint*)h;
 
-      head = (ObservationPoint*)table[hash];
-
-      while(head != NULL) {
-	if((!head->idle()) && head->equal(obs_point))
-	  break;
-	else
-	  head = (ObservationPoint*)head->next();
-      }
+  return((!op->idle()) && op->equal(*((u_int16_t*)user_data)));
+}
 
-      if(!is_inline_call)
-	locks[hash]->unlock(__FILE__, __LINE__);
+/* ************************************ */
 
-      return(head);
-    }
-  }
+ObservationPoint* ObservationPointHash::get(u_int16_t obs_point, bool is_inline_call) {
+  if(obs_point == 0 || obs_point == (u_int16_t) -1)
+    return(NULL);
+  else
+    return((ObservationPoint*)lookup<obs_point_matches>(obs_point, &obs_point, !is_inline_call));
 }
@@ -30,33 +30,14 @@ OperatingSystemHash::OperatingSystemHash(NetworkInterface *_iface, u_int _num_ha
 
 /* ************************************ */
 
-OperatingSystem* OperatingSystemHash::get(OSType os_type, bool is_inline_call) {
-  u_int32_t hash;
-
-  hash = os_type;
-  
-  hash %= num_hashes;
-
-  if(table[hash] == NULL) {
-    return(NULL);
-  } else {
-    OperatingSystem *head;
-
-    if(!is_inline_call)
-      locks[hash]->rdlock(__FILE__, __LINE__);
+static bool os_matches(GenericHashEntry *h, void *user_data) {
+  OperatingSystem *os = (OperatingSystem*)h;
 
-    head = (OperatingSystem*)table[hash];
-
-    while(head != NULL) {
-      if(!head->idle() && head->equal(os_type))
-	break;
-      else
-	head = (OperatingSystem*)head->next();
-    }
+  return(!os->idle() && os->equal(*((OSType*)user_data)));
+}
 
-    if(!is_inline_call)
-      locks[hash]->unlock(__FILE__, __LINE__);
+/* ************************************ */
 
-    return(head);
-  }
+OperatingSystem* OperatingSystemHash::get(OSType os_type, bool is_inline_call) {
+  return((OperatingSystem*)lookup<os_matches>(os_type, &os_type, !is_inline_call));
 }
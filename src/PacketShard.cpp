@@ -0,0 +1,290 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "ntop_includes.h"
+
+/* ************************************ */
+
+PacketShard::PacketShard(NetworkInterface *_iface, u_int8_t _shard_id) {
+  char buf[32];
+
+  iface = _iface, shard_id = _shard_id, spare_item = NULL;
+  workerLoopCreated = false, stopRequested = false;
+  num_enqueued = num_dropped = num_processed = num_waits = 0;
+
+  snprintf(buf, sizeof(buf), "packetShard%u", shard_id);
+  queue = new (std::nothrow) SPSCQueue<PacketShardItem*>(PACKET_SHARD_QUEUE_LEN, buf);
+  snprintf(buf, sizeof(buf), "packetShardFree%u", shard_id);
+  free_items = new (std::nothrow) SPSCQueue<PacketShardItem*>(PACKET_SHARD_QUEUE_LEN, buf);
+
+  /*
+    Items circulate between the two queues, so there are never more than
+    NUM_PACKET_SHARD_ITEMS items queued: this guarantees the enqueues never
+    fail, even when the consumer has not yet published (see QUEUE_WATERMARK)
+    the slots it has already dequeued.
+  */
+  if((items = (PacketShardItem*)calloc(NUM_PACKET_SHARD_ITEMS, sizeof(PacketShardItem))) != NULL) {
+    for(u_int32_t i = 0; free_items && (i < NUM_PACKET_SHARD_ITEMS); i++)
+      free_items->enqueue(&items[i], true);
+  }
+}
+
+/* ************************************ */
+
+PacketShard::~PacketShard() {
+  stopWorker();
+
+  /* Stops its checks loop, if not already done by the parent */
+  iface->shutdown();
+  delete iface;
+
+  if(queue)      delete queue;
+  if(free_items) delete free_items;
+
+  if(items) {
+    for(u_int32_t i = 0; i < NUM_PACKET_SHARD_ITEMS; i++)
+      if(items[i].packet) free(items[i].packet);
+
+    free(items);
+  }
+}
+
+/* ************************************ */
+
+/*
+  Hash a packet so that both directions of a flow return the same value.
+  Ports are used when the packet carries the L4 header (i.e., it's not a
+  non-first fragment), so the flows of a busy host pair are still spread.
+ */
+u_int32_t PacketShard::symmetricHash(const struct ndpi_iphdr *iph, const struct ndpi_ipv6hdr *ip6,
+				     const u_char *packet, u_int16_t ip_offset, u_int32_t caplen) {
+  u_int32_t h = 0, l4_offset;
+  u_int8_t l4_proto;
+
+  if(iph) {
+    h = ntohl(iph->saddr) + ntohl(iph->daddr);
+    l4_proto = iph->protocol;
+
+    if(iph->frag_off & htons(0x1FFF /* IP_OFFSET */))
+      l4_offset = 0; /* No L4 header */
+    else
+      l4_offset = ip_offset + iph->ihl * 4;
+  } else if(ip6) {
+    for(u_int i = 0; i < 4; i++)
+      h += ntohl(ip6->ip6_src.u6_addr.u6_addr32[i]) + ntohl(ip6->ip6_dst.u6_addr.u6_addr32[i]);
+
+    l4_proto = ip6->ip6_hdr.ip6_un1_nxt;
+    l4_offset = ip_offset + sizeof(struct ndpi_ipv6hdr);
+
+    /* Skip options as NetworkInterface::processPacket does */
+    if(((l4_proto == 0x3C /* IPv6 destination option */) || (l4_proto == 0x0 /* Hop-by-hop option */))
+       && (caplen >= l4_offset + 2)) {
+      l4_proto = packet[l4_offset];
+      l4_offset += 8 * (packet[l4_offset + 1] + 1);
+    }
+  } else
+    return(0);
+
+  if(l4_offset
+     && ((l4_proto == IPPROTO_TCP) || (l4_proto == IPPROTO_UDP) || (l4_proto == IPPROTO_SCTP))
+     && (caplen >= l4_offset + 4)) {
+    /* Source and destination ports are the first 4 bytes of TCP, UDP and SCTP */
+    h += ((u_int32_t)packet[l4_offset] << 8) + packet[l4_offset + 1]
+      + ((u_int32_t)packet[l4_offset + 2] << 8) + packet[l4_offset + 3];
+  }
+
+  h += l4_proto;
+
+  /* Finalizer (murmur3) to spread sequential addresses among shards */
+  h ^= h >> 16, h *= 0x85ebca6b;
+  h ^= h >> 13, h *= 0xc2b2ae35;
+  h ^= h >> 16;
+
+  return(h);
+}
+
+/* ************************************ */
+
+/* Called by the capture thread (single producer) */
+bool PacketShard::enqueue(u_int32_t bridge_iface_idx, bool ingressPacket,
+			  const struct bpf_timeval *when, const u_int64_t packet_time,
+			  struct ndpi_ethhdr *eth, VLANid vlan_id,
+			  bool is_ipv6, u_int16_t ip_offset,
+			  u_int16_t encapsulation_overhead, u_int32_t len_on_wire,
+			  const struct pcap_pkthdr *h, const u_char *packet,
+			  bool wait_for_room) {
+  PacketShardItem *item;
+
+  if(wait_for_room && queue && free_items && !spare_item && !free_items->isNotEmpty()) {
+    /* Backpressure: the file is read as fast as the worker processes it */
+    num_waits++;
+
+    while(!free_items->isNotEmpty() && !stopRequested && !ntop->getGlobals()->isShutdownRequested())
+      _usleep(10);
+  }
+
+  if(spare_item)
+    item = spare_item, spare_item = NULL;
+  else if(queue && free_items && free_items->isNotEmpty())
+    item = free_items->dequeue();
+  else {
+    /* The worker is not keeping up */
+    num_dropped++;
+    return(false);
+  }
+
+  if(item->packet_size < h->caplen) {
+    /* The whole packet is copied, so the worker accounts it as the capture thread would */
+    u_char *packet_buf = (u_char*)realloc(item->packet, h->caplen);
+
+    if(packet_buf == NULL) {
+      spare_item = item; /* Can't go back to free_items, the worker is its producer */
+      num_dropped++;
+      return(false);
+    }
+
+    item->packet = packet_buf, item->packet_size = h->caplen;
+  }
+
+  memcpy(&item->h, h, sizeof(struct pcap_pkthdr));
+  memcpy(&item->when, when, sizeof(struct bpf_timeval));
+  memcpy(&item->eth, eth, sizeof(struct ndpi_ethhdr));
+  item->packet_time = packet_time;
+  item->bridge_iface_idx = bridge_iface_idx, item->ingressPacket = ingressPacket;
+  item->vlan_id = vlan_id, item->is_ipv6 = is_ipv6;
+  item->ip_offset = ip_offset, item->encapsulation_overhead = encapsulation_overhead;
+  item->len_on_wire = len_on_wire;
+
+  memcpy(item->packet, packet, item->h.caplen);
+
+  queue->enqueue(item, true);
+  num_enqueued++;
+
+  return(true);
+}
+
+/* ************************************ */
+
+void PacketShard::processLoop() {
+  PacketShardItem *item;
+  u_int16_t ndpiProtocol;
+  Host *srcHost, *dstHost;
+  Flow *flow;
+  time_t last_idle_purge = 0;
+
+  while(!stopRequested || queue->isNotEmpty()) {
+    if(!queue->isNotEmpty()) {
+      time_t now = time(NULL);
+
+      /* No traffic: keep purging idle entries as the capture thread does */
+      if(now != last_idle_purge) {
+	iface->purgeIdle(now);
+	last_idle_purge = now;
+      }
+
+      _usleep(100);
+      continue;
+    }
+
+    item = queue->dequeue();
+
+    iface->setTimeLastPktRcvd(item->h.ts.tv_sec);
+    iface->purgeIdle(item->h.ts.tv_sec);
+
+    try {
+      iface->processPacket(item->bridge_iface_idx,
+			   item->ingressPacket, &item->when, item->packet_time,
+			   &item->eth, item->vlan_id,
+			   item->is_ipv6 ? NULL : (struct ndpi_iphdr*)&item->packet[item->ip_offset],
+			   item->is_ipv6 ? (struct ndpi_ipv6hdr*)&item->packet[item->ip_offset] : NULL,
+			   item->ip_offset, item->encapsulation_overhead,
+			   item->len_on_wire, &item->h, item->packet,
+			   &ndpiProtocol, &srcHost, &dstHost, &flow);
+    } catch(std::bad_alloc& ba) {
+      static bool oom_warning_sent = false;
+
+      if(!oom_warning_sent) {
+	ntop->getTrace()->traceEvent(TRACE_WARNING, "Not enough memory");
+	oom_warning_sent = true;
+      }
+    }
+
+    num_processed++;
+    free_items->enqueue(item, true);
+  }
+}
+
+/* ************************************ */
+
+static void* packetShardLoop(void *ptr) {
+  ((PacketShard*)ptr)->processLoop();
+  return(NULL);
+}
+
+/* ************************************ */
+
+bool PacketShard::startWorker() {
+  if(!queue || !free_items || !items)
+    return(false);
+
+  if(pthread_create(&workerLoop, NULL, packetShardLoop, (void*)this) != 0)
+    return(false);
+
+  workerLoopCreated = true;
+
+#ifdef __linux__
+  char buf[16];
+
+  snprintf(buf, sizeof(buf), "%u/pkt_shard%u", iface->get_id(), shard_id);
+  pthread_setname_np(workerLoop, buf);
+#endif
+
+  return(true);
+}
+
+/* ************************************ */
+
+/* Processes the packets still queued and waits for the worker to terminate */
+void PacketShard::stopWorker() {
+  void *res;
+
+  if(workerLoopCreated) {
+    stopRequested = true;
+    pthread_join(workerLoop, &res);
+    workerLoopCreated = false;
+  }
+}
+
+/* ************************************ */
+
+void PacketShard::lua(lua_State *vm) const {
+  lua_newtable(vm);
+
+  lua_push_uint64_table_entry(vm, "num_flows", iface->getNumFlows());
+  lua_push_uint64_table_entry(vm, "num_enqueued", num_enqueued);
+  lua_push_uint64_table_entry(vm, "num_waits", num_waits);
+  lua_push_uint64_table_entry(vm, "num_processed", num_processed);
+  lua_push_uint64_table_entry(vm, "num_dropped", num_dropped);
+
+  lua_pushinteger(vm, shard_id);
+  lua_insert(vm, -2);
+  lua_settable(vm, -3);
+}
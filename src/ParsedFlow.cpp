@@ -69,6 +69,7 @@ ParsedFlow::ParsedFlow(const ParsedFlow &pf) : ParsedFlowCore(pf), ParsedeBPF(pf
 
   tls_cipher = pf.tls_cipher;
   tls_unsafe_cipher = pf.tls_unsafe_cipher;
+  flow_verdict = pf.flow_verdict;
   ndpi_flow_risk_bitmap = pf.ndpi_flow_risk_bitmap;
   http_ret_code = pf.http_ret_code;
   dns_query_type = pf.dns_query_type;
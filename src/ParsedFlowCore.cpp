@@ -54,6 +54,7 @@ ParsedFlowCore::ParsedFlowCore(const ParsedFlowCore &pfc) {
   memcpy(&src_mac, &pfc.src_mac, sizeof(src_mac));
   memcpy(&dst_mac, &pfc.dst_mac, sizeof(dst_mac));
   memcpy(&device_ipv6, &pfc.device_ipv6, sizeof(device_ipv6));
+  src_tos = pfc.src_tos, dst_tos = pfc.dst_tos;
   version = pfc.version;
   device_ip = pfc.device_ip;
   src_port = pfc.src_port, dst_port = pfc.dst_port;
@@ -66,6 +67,7 @@ ParsedFlowCore::ParsedFlowCore(const ParsedFlowCore &pfc) {
   in_pkts = pfc.in_pkts, in_bytes = pfc.in_bytes;
   out_pkts = pfc.out_pkts, out_bytes = pfc.out_bytes;
   vrfId = pfc.vrfId;
+  in_fragments = pfc.in_fragments, out_fragments = pfc.out_fragments;
   absolute_packet_octet_counters = pfc.absolute_packet_octet_counters;
   memcpy(&tcp, &pfc.tcp, sizeof(tcp));
   first_switched = pfc.first_switched, last_switched = pfc.last_switched;
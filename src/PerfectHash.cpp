@@ -0,0 +1,195 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#include "ntop_includes.h"
+
+/* Bound on the seeds tried for a single bucket before giving up */
+#define PERFECT_HASH_MAX_SEED  (1 << 20)
+
+/* ******************************************* */
+
+PerfectHash::PerfectHash() {
+  displacements = slots = NULL;
+  key_offsets = key_lens = NULL;
+  values = NULL, keys = NULL;
+  num_keys = 0, mask = 0;
+}
+
+/* ******************************************* */
+
+PerfectHash::~PerfectHash() {
+  cleanup();
+}
+
+/* ******************************************* */
+
+void PerfectHash::cleanup() {
+  if(displacements) free(displacements);
+  if(slots)         free(slots);
+  if(key_offsets)   free(key_offsets);
+  if(key_lens)      free(key_lens);
+  if(values)        free(values);
+  if(keys)          free(keys);
+
+  displacements = slots = NULL;
+  key_offsets = key_lens = NULL;
+  values = NULL, keys = NULL;
+  num_keys = 0, mask = 0;
+}
+
+/* ******************************************* */
+
+/* FNV-1a seeded and followed by a final avalanche so that the low bits,
+   used to select buckets and slots, depend on all the key bytes */
+u_int32_t PerfectHash::hash(u_int32_t seed, const char *key, u_int32_t key_len) {
+  u_int32_t h = 2166136261U ^ (seed * 0x9E3779B9U);
+
+  for(u_int32_t i = 0; i < key_len; i++)
+    h = (h ^ (u_int8_t)key[i]) * 16777619U;
+
+  h ^= h >> 16, h *= 0x85EBCA6BU;
+  h ^= h >> 13, h *= 0xC2B2AE35U;
+  h ^= h >> 16;
+
+  return(h);
+}
+
+/* ******************************************* */
+
+bool PerfectHash::build(const std::vector<std::pair<std::string, u_int64_t> > &entries) {
+  std::vector<std::vector<u_int32_t> > buckets;
+  std::vector<u_int32_t> order, placed;
+  u_int32_t n = entries.size(), size = 1, keys_len = 0, i;
+
+  cleanup();
+
+  if(n == 0)
+    return(true);
+
+  /* Load factor between 1/4 and 1/2 keeps the seed search short */
+  while(size < 2 * n) size <<= 1;
+
+  for(i = 0; i < n; i++) keys_len += entries[i].first.size();
+
+  displacements = (int32_t*)calloc(size, sizeof(int32_t));
+  slots         = (int32_t*)malloc(size * sizeof(int32_t));
+  key_offsets   = (u_int32_t*)malloc(n * sizeof(u_int32_t));
+  key_lens      = (u_int32_t*)malloc(n * sizeof(u_int32_t));
+  values        = (u_int64_t*)malloc(n * sizeof(u_int64_t));
+  keys          = (char*)malloc(keys_len + 1);
+
+  if(!displacements || !slots || !key_offsets || !key_lens || !values || !keys) {
+    cleanup();
+    return(false);
+  }
+
+  mask = size - 1;
+  memset(slots, 0xFF, size * sizeof(int32_t));
+
+  for(i = 0, keys_len = 0; i < n; i++) {
+    key_offsets[i] = keys_len, key_lens[i] = entries[i].first.size(), values[i] = entries[i].second;
+    memcpy(&keys[keys_len], entries[i].first.data(), key_lens[i]);
+    keys_len += key_lens[i];
+  }
+
+  buckets.resize(size);
+  for(i = 0; i < n; i++)
+    buckets[hash(0, &keys[key_offsets[i]], key_lens[i]) & mask].push_back(i);
+
+  for(i = 0; i < size; i++)
+    if(!buckets[i].empty()) order.push_back(i);
+
+  /* Largest buckets first, while most of the slots are still free */
+  std::sort(order.begin(), order.end(),
+	    [&buckets](u_int32_t a, u_int32_t b) { return(buckets[a].size() > buckets[b].size()); });
+
+  for(std::vector<u_int32_t>::const_iterator b = order.begin(); b != order.end(); ++b) {
+    const std::vector<u_int32_t> &bucket = buckets[*b];
+
+    if(bucket.size() == 1) {
+      /* Any free slot will do: store it directly */
+      u_int32_t s = 0;
+
+      while(slots[s] != -1) s++;
+
+      slots[s] = bucket[0], displacements[*b] = -(int32_t)s - 1;
+      continue;
+    }
+
+    for(u_int32_t seed = 1; ; seed++) {
+      if(seed >= PERFECT_HASH_MAX_SEED) {
+	cleanup();
+	return(false);
+      }
+
+      placed.clear();
+
+      for(i = 0; i < bucket.size(); i++) {
+	u_int32_t s = hash(seed, &keys[key_offsets[bucket[i]]], key_lens[bucket[i]]) & mask;
+
+	if((slots[s] != -1) || (std::find(placed.begin(), placed.end(), s) != placed.end()))
+	  break;
+
+	placed.push_back(s);
+      }
+
+      if(placed.size() == bucket.size()) {
+	for(i = 0; i < bucket.size(); i++)
+	  slots[placed[i]] = bucket[i];
+
+	displacements[*b] = seed;
+	break;
+      }
+    }
+  }
+
+  num_keys = n;
+  return(true);
+}
+
+/* ******************************************* */
+
+bool PerfectHash::find(const char *key, u_int32_t key_len, u_int64_t *value) const {
+  int32_t d, k;
+  u_int32_t s;
+
+  if(num_keys == 0)
+    return(false);
+
+  d = displacements[hash(0, key, key_len) & mask];
+
+  if(d == 0)
+    return(false); /* Empty bucket */
+
+  s = (d < 0) ? (u_int32_t)(-d - 1) : (hash(d, key, key_len) & mask);
+
+  if((k = slots[s]) == -1)
+    return(false);
+
+  if((key_lens[k] != key_len) || memcmp(&keys[key_offsets[k]], key, key_len))
+    return(false);
+
+  *value = values[k];
+  return(true);
+}
+
+/* ******************************************* */
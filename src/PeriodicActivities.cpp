@@ -74,6 +74,13 @@ void PeriodicActivities::lua(NetworkInterface *iface, lua_State *vm) {
 
 /* **************************************************** */
 
+void PeriodicActivities::purgeVMs(NetworkInterface *iface) {
+  for(int i = 0; i < num_activities; i++)
+    activities[i]->purgeVMs(iface);
+}
+
+/* **************************************************** */
+
 static void* startActivity(void* ptr)  {
   Utils::setThreadName("PeriodicActivities");
 
@@ -40,6 +40,11 @@ Prefs::Prefs(Ntop *_ntop) {
   ntop = _ntop, pcap_file_purge_hosts_flows = false,
     ignore_vlans = false, simulate_vlans = false, simulate_macs = false, ignore_macs = false;
   insecure_tls = false;
+  hash_table_engine = hash_table_engine_chaining;
+  num_packet_shards = 1, num_view_workers = VIEW_DEFAULT_NUM_WORKERS;
+  num_housekeeping_workers = HOUSEKEEPING_DEFAULT_NUM_WORKERS;
+  num_zmq_collector_workers = 0;
+  num_rrd_writers = RRD_WRITERS_DEFAULT_NUM;
   local_networks = strdup(CONST_DEFAULT_HOME_NET "," CONST_DEFAULT_LOCAL_NETS);
   num_simulated_ips = 0, enable_behaviour_analysis = false;
   local_networks_set = false, shutdown_when_done = false;
@@ -117,7 +122,7 @@ Prefs::Prefs(Ntop *_ntop) {
   redis_host = strdup("127.0.0.1");
   redis_password = NULL;
   redis_port = 6379;
-  redis_db_id = 0;
+  redis_db_id = 0, num_redis_connections = REDIS_DEFAULT_NUM_CONNECTIONS;
   dns_mode = 0;
   pid_path = strdup(DEFAULT_PID_PATH);
   packet_filter = NULL;
@@ -163,6 +168,7 @@ Prefs::Prefs(Ntop *_ntop) {
 
   mysql_host = mysql_dbname = mysql_user = mysql_pw = NULL;
   mysql_port = CONST_DEFAULT_MYSQL_PORT;
+  mysql_batch_rows = 1, mysql_batch_window_ms = MYSQL_BATCH_DEFAULT_WINDOW_MS;
   clickhouse_tcp_port = CONST_DEFAULT_CLICKHOUSE_TCP_PORT;
   #ifndef WIN32
   flows_syslog_facility = CONST_DEFAULT_DUMP_SYSLOG_FACILITY;
@@ -354,6 +360,8 @@ void usage() {
 	 "[--other-core-affinity|-y] <ids>    | Bind service threads to specific CPU cores\n"
 	 "                                    | (specified as a comma-separated list of core id)\n"
 #endif
+	 "[--redis-connections] <num>         | Number of redis connections shared by the\n"
+	 "                                    | ntopng threads (default: 4, max: 32)\n"
 	 "[--user|-U] <sys user>              | Run ntopng with the specified user\n"
 	 "                                    | instead of %s\n"
 	 "[--dont-change-user|-s]             | Do not change user (debug only)\n"
@@ -422,6 +430,11 @@ void usage() {
 	 "                                    |   mysql;<host[@port]|socket>;<dbname><user>;<pw>\n"
 	 "                                    |   mysql;127.0.0.1;ntopng;root;\n"
 	 "                                    |\n"
+#endif
+#ifdef HAVE_MYSQL
+	 "[--mysql-batch-rows] <num>          | Insert flows in MySQL with multi-row INSERTs of up\n"
+	 "                                    | to <num> flows (default: 1, one INSERT per flow)\n"
+	 "[--mysql-batch-window] <msec>       | Max time a flow waits for its MySQL batch (default: 1000)\n"
 #endif
 	 "[--export-flows|-I] <endpoint>      | Export flows with the specified endpoint\n"
 	 "                                    | See https://wp.me/p1LxdS-O5 for a -I use case.\n"
@@ -461,6 +474,20 @@ void usage() {
 	 "[--simulate-vlans]                  | Simulate VLAN traffic (debug only)\n"
 	 "[--simulate-macs]                   | Simulate MACs in the traffic (debug only)\n"
 	 "[--simulate-ips] <num>              | Simulate IPs by choosing clients and servers among <num> random addresses\n"
+	 "[--hash-table-engine] <engine>      | Hash table engine for flows, hosts, MACs...:\n"
+	 "                                    | chaining        - Linked buckets (default)\n"
+	 "                                    | open-addressing - Lock-striped open addressing\n"
+	 "[--packet-workers] <num>            | Dissect packets of each packet interface with <num>\n"
+	 "                                    | threads sharded by 5-tuple (default: 1)\n"
+	 "[--view-workers] <num>              | Threads aggregating the flows of each view\n"
+	 "                                    | interface (default: 4, at most one per viewed interface)\n"
+	 "[--housekeeping-workers] <num>      | Threads walking the hosts, MACs, ASes... hash tables\n"
+	 "                                    | out of the packet path (default: 2, 0 = inline)\n"
+	 "[--zmq-collector-workers] <num>     | Threads receiving and decoding the messages of each ZMQ\n"
+	 "                                    | collector interface, one or more ZMQ endpoints each\n"
+	 "                                    | (default: 0 = same thread processing the flows)\n"
+	 "[--rrd-writers] <num>               | Threads writing the RRD timeseries updates, batched\n"
+	 "                                    | per file (default: 2, 0 = written by the Lua scripts)\n"
 	 "[--help|-h]                         | Help\n",
 #ifdef HAVE_NEDGE
 	 "edge "
@@ -587,6 +614,8 @@ static TsDriver str2TsDriver(const char *driver) {
     return(ts_driver_influxdb);
   else if(!strcmp(driver, "prometheus"))
     return(ts_driver_prometheus);
+  else if(!strcmp(driver, "tsdb"))
+    return(ts_driver_tsdb);
   else
     return(ts_driver_rrd);
 }
@@ -860,6 +889,15 @@ static const struct option long_options[] = {
   { "appliance",                         no_argument,       NULL, 223 },
 #endif
   { "insecure",                          no_argument,       NULL, 225 },
+  { "hash-table-engine",                 required_argument, NULL, 226 },
+  { "packet-workers",                    required_argument, NULL, 227 },
+  { "mysql-batch-rows",                  required_argument, NULL, 228 },
+  { "mysql-batch-window",                required_argument, NULL, 229 },
+  { "redis-connections",                 required_argument, NULL, 230 },
+  { "view-workers",                      required_argument, NULL, 231 },
+  { "housekeeping-workers",              required_argument, NULL, 232 },
+  { "zmq-collector-workers",             required_argument, NULL, 233 },
+  { "rrd-writers",                       required_argument, NULL, 234 },
 #ifdef NTOPNG_PRO
   { "vm",                                no_argument,       NULL, 251 }, // --vm no longer used (keeping for backward cmpatibility)
   { "check-maintenance",                 no_argument,       NULL, 252 },
@@ -1650,6 +1688,48 @@ int Prefs::setOption(int optkey, char *optarg) {
     insecure_tls = true;
     break;
 
+  case 226:
+    if(!strcmp(optarg, "open-addressing"))
+      hash_table_engine = hash_table_engine_open_addressing;
+    else if(!strcmp(optarg, "chaining"))
+      hash_table_engine = hash_table_engine_chaining;
+    else
+      ntop->getTrace()->traceEvent(TRACE_WARNING,
+				   "Unknown --hash-table-engine %s, it has been ignored", optarg);
+    break;
+
+  case 227:
+    num_packet_shards = min_val(max_val(atoi(optarg), 1), MAX_NUM_PACKET_SHARDS);
+    break;
+
+  case 228:
+    mysql_batch_rows = min_val(max_val(atoi(optarg), 1), MYSQL_BATCH_MAX_ROWS);
+    break;
+
+  case 229:
+    mysql_batch_window_ms = max_val(atoi(optarg), 10);
+    break;
+
+  case 230:
+    num_redis_connections = min_val(max_val(atoi(optarg), 1), REDIS_MAX_NUM_CONNECTIONS);
+    break;
+
+  case 231:
+    num_view_workers = min_val(max_val(atoi(optarg), 1), MAX_NUM_VIEW_INTERFACES);
+    break;
+
+  case 232:
+    num_housekeeping_workers = min_val(max_val(atoi(optarg), 0), HOUSEKEEPING_MAX_NUM_WORKERS);
+    break;
+
+  case 233:
+    num_zmq_collector_workers = min_val(max_val(atoi(optarg), 0), MAX_ZMQ_SUBSCRIBERS);
+    break;
+
+  case 234:
+    num_rrd_writers = min_val(max_val(atoi(optarg), 0), RRD_WRITERS_MAX_NUM);
+    break;
+
 #ifdef NTOPNG_PRO
 #ifdef __linux__
   case 251:
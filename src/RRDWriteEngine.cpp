@@ -0,0 +1,362 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "ntop_includes.h"
+#include "rrd.h"
+
+/* ******************************************* */
+
+RRDWriteEngine::RRDWriteEngine(u_int8_t _num_writers) {
+  num_writers = min_val(max_val(_num_writers, 1), RRD_WRITERS_MAX_NUM);
+  started = stopping = false;
+
+  for(u_int8_t i = 0; i < RRD_WRITERS_MAX_NUM; i++) {
+    rrd_writer_t *w = &writers[i];
+
+    w->num_pending = 0, w->last_pass = 0;
+    w->num_submitted = w->num_dropped = 0;
+    w->num_written = w->num_rejected = w->num_files = w->num_passes = w->num_late = 0;
+    w->max_delay = w->last_pass_ms = 0;
+    w->last_rate_update = 0, w->last_rate_written = 0, w->points_rate = 0;
+  }
+}
+
+/* ******************************************* */
+
+RRDWriteEngine::~RRDWriteEngine() {
+  shutdown();
+}
+
+/* ******************************************* */
+
+typedef struct {
+  RRDWriteEngine *engine;
+  u_int8_t writer_id;
+} rrd_writer_arg_t;
+
+static void* rrdWriter(void *ptr) {
+  rrd_writer_arg_t *arg = (rrd_writer_arg_t*)ptr;
+  RRDWriteEngine *engine = arg->engine;
+  u_int8_t writer_id = arg->writer_id;
+  char name[32];
+
+  delete arg;
+
+  snprintf(name, sizeof(name), "ntopng-rrd-%u", writer_id);
+  Utils::setThreadName(name);
+  engine->writerLoop(writer_id);
+
+  return(NULL);
+}
+
+/* ******************************************* */
+
+void RRDWriteEngine::start() {
+  if(started) return;
+
+  for(u_int8_t i = 0; i < num_writers; i++) {
+    rrd_writer_arg_t *arg = new rrd_writer_arg_t;
+
+    arg->engine = this, arg->writer_id = i;
+    pthread_create(&writers[i].thread, NULL, rrdWriter, (void*)arg);
+  }
+
+  started = true;
+
+  ntop->getTrace()->traceEvent(TRACE_NORMAL, "RRD updates written by %u threads", num_writers);
+}
+
+/* ******************************************* */
+
+void RRDWriteEngine::shutdown() {
+  stopping = true;
+
+  if(started) {
+    for(u_int8_t i = 0; i < num_writers; i++) {
+      writers[i].work_cond.signalAll();
+      writers[i].room_cond.signalAll();
+    }
+
+    for(u_int8_t i = 0; i < num_writers; i++)
+      pthread_join(writers[i].thread, NULL);
+
+    started = false;
+  }
+}
+
+/* ******************************************* */
+
+u_int32_t RRDWriteEngine::submit(const std::vector<std::pair<std::string, std::string> > &points) {
+  std::vector<u_int8_t> shards(points.size());
+  time_t now = time(NULL);
+  u_int32_t num_accepted = 0;
+  struct timeval begin;
+
+  if(stopping || points.empty())
+    return(0);
+
+  /* A file always belongs to the same writer, so its points are written in order */
+  for(size_t i = 0; i < points.size(); i++)
+    shards[i] = Utils::hashString(points[i].first.c_str()) % num_writers;
+
+  gettimeofday(&begin, NULL);
+
+  for(u_int8_t s = 0; s < num_writers; s++) {
+    rrd_writer_t *w = &writers[s];
+
+    w->lock.lock(__FILE__, __LINE__);
+
+    for(size_t i = 0; i < points.size(); i++) {
+      rrd_point_t p;
+
+      if(shards[i] != s) continue;
+
+      /* Backpressure: wait for the writer to take its journal */
+      while((w->num_pending >= RRD_WRITER_MAX_PENDING) && !stopping) {
+	struct timespec expiration;
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	if(Utils::msTimevalDiff(&tv, &begin) >= RRD_WRITER_MAX_WAIT_MS)
+	  break; /* The waits of a batch are bounded */
+
+	w->lock.unlock(__FILE__, __LINE__);
+
+	w->work_cond.signal();
+	expiration.tv_sec = tv.tv_sec + (tv.tv_usec + 100000) / 1000000;
+	expiration.tv_nsec = ((tv.tv_usec + 100000) % 1000000) * 1000;
+	w->room_cond.timedWait(&expiration);
+
+	w->lock.lock(__FILE__, __LINE__);
+      }
+
+      if(w->num_pending >= RRD_WRITER_MAX_PENDING) {
+	w->num_dropped++;
+	continue;
+      }
+
+      p.timestamp = strtoul(points[i].second.c_str(), NULL, 10), p.queued = now;
+      p.update = points[i].second;
+      w->journal[points[i].first].push_back(p);
+      w->num_pending++, w->num_submitted++, num_accepted++;
+    }
+
+    w->lock.unlock(__FILE__, __LINE__);
+  }
+
+  return(num_accepted);
+}
+
+/* ******************************************* */
+
+/* Returns the time of the last update of the RRD, 0 if unknown */
+static time_t rrdLastUpdate(const char *path) {
+  time_t last_update;
+  unsigned long ds_count;
+  char **ds_names, **last_ds;
+
+  rrd_clear_error();
+
+  if(rrd_lastupdate_r(path, &last_update, &ds_count, &ds_names, &last_ds) != 0)
+    return(0);
+
+  for(unsigned long i = 0; i < ds_count; i++)
+    free(last_ds[i]), free(ds_names[i]);
+
+  free(last_ds), free(ds_names);
+
+  return(last_update);
+}
+
+/* ******************************************* */
+
+void RRDWriteEngine::applyJournal(rrd_writer_t *w, rrd_journal_t *journal) {
+  std::vector<const char*> argv;
+  struct timeval begin, end;
+
+  gettimeofday(&begin, NULL);
+
+  /* Sorted by path: the files of a directory are updated in a row */
+  for(rrd_journal_t::iterator it = journal->begin(); it != journal->end(); ++it) {
+    const char *path = it->first.c_str();
+    std::vector<rrd_point_t> &points = it->second;
+    u_int32_t last_timestamp;
+    time_t now;
+
+    /* rrd_update wants increasing timestamps */
+    if(points.size() > 1)
+      std::stable_sort(points.begin(), points.end(), comparePoints);
+
+    /*
+      librrd rejects the whole batch at the first point not newer than the
+      last update: drop such points (and duplicates) before the update
+    */
+    last_timestamp = (u_int32_t)rrdLastUpdate(path);
+
+    argv.clear();
+    for(std::vector<rrd_point_t>::const_iterator p = points.begin(); p != points.end(); ++p) {
+      if(p->timestamp <= last_timestamp) {
+	w->num_rejected++;
+	continue;
+      }
+
+      argv.push_back(p->update.c_str());
+      last_timestamp = p->timestamp;
+    }
+
+    if(!argv.empty()) {
+      /* A single open/read/modify/write of the file for all its points */
+      rrd_clear_error();
+
+      if(rrd_update_r(path, NULL, argv.size(), &argv[0]) == 0)
+	w->num_written += argv.size();
+      else {
+	ntop->getTrace()->traceEvent(TRACE_INFO, "rrd_update_r() [%s][%u points] failed [%s]",
+				     path, (u_int32_t)argv.size(), rrd_get_error());
+
+	if(argv.size() == 1)
+	  w->num_rejected++;
+	else {
+	  /*
+	    librrd stops at the first invalid point (e.g., the file has been
+	    updated meanwhile): retry the points one by one to write the valid ones
+	  */
+	  for(size_t i = 0; i < argv.size(); i++) {
+	    rrd_clear_error();
+
+	    if(rrd_update_r(path, NULL, 1, &argv[i]) == 0)
+	      w->num_written++;
+	    else
+	      w->num_rejected++;
+	  }
+	}
+      }
+    }
+
+    w->num_files++;
+
+    now = time(NULL);
+
+    for(std::vector<rrd_point_t>::const_iterator p = points.begin(); p != points.end(); ++p) {
+      u_int32_t delay = (now > p->queued) ? (now - p->queued) : 0;
+
+      if(delay > RRD_WRITER_DEADLINE) w->num_late++;
+      if(delay > w->max_delay) w->max_delay = delay;
+    }
+
+    updateRate(w, now);
+  }
+
+  gettimeofday(&end, NULL);
+
+  w->num_passes++;
+  w->last_pass_ms = (u_int32_t)(Utils::msTimevalDiff(&end, &begin));
+}
+
+/* ******************************************* */
+
+void RRDWriteEngine::updateRate(rrd_writer_t *w, time_t now) {
+  if(now == w->last_rate_update)
+    return;
+
+  if(w->last_rate_update)
+    w->points_rate = (w->num_written - w->last_rate_written) / (float)(now - w->last_rate_update);
+
+  w->last_rate_update = now, w->last_rate_written = w->num_written;
+}
+
+/* ******************************************* */
+
+void RRDWriteEngine::writerLoop(u_int8_t writer_id) {
+  rrd_writer_t *w = &writers[writer_id];
+
+  while(true) {
+    rrd_journal_t journal;
+    bool stop = stopping;
+    time_t now = time(NULL);
+
+    w->lock.lock(__FILE__, __LINE__);
+
+    /* Points coalesce in the journal between two passes, unless it is full */
+    if((w->num_pending > 0)
+       && (stop || (w->num_pending >= RRD_WRITER_MAX_PENDING) || (now >= w->last_pass + RRD_WRITER_PASS_INTERVAL)))
+      journal.swap(w->journal), w->num_pending = 0;
+
+    w->lock.unlock(__FILE__, __LINE__);
+
+    if(!journal.empty()) {
+      w->room_cond.signalAll();
+      applyJournal(w, &journal);
+      w->last_pass = now;
+    } else
+      updateRate(w, now);
+
+    if(stop)
+      break;
+
+    if(journal.empty()) {
+      struct timespec expiration;
+
+      expiration.tv_sec = time(NULL) + 1, expiration.tv_nsec = 0;
+      w->work_cond.timedWait(&expiration);
+    }
+  }
+}
+
+/* ******************************************* */
+
+void RRDWriteEngine::lua(lua_State *vm) {
+  u_int64_t num_submitted = 0, num_dropped = 0, num_written = 0, num_rejected = 0;
+  u_int64_t num_files = 0, num_passes = 0, num_late = 0, num_pending = 0;
+  u_int32_t max_delay = 0, last_pass_ms = 0;
+  float points_rate = 0;
+
+  for(u_int8_t i = 0; i < num_writers; i++) {
+    rrd_writer_t *w = &writers[i];
+
+    num_submitted += w->num_submitted, num_dropped += w->num_dropped;
+    num_written += w->num_written, num_rejected += w->num_rejected;
+    num_files += w->num_files, num_passes += w->num_passes;
+    num_late += w->num_late, num_pending += w->num_pending;
+    max_delay = max_val(max_delay, w->max_delay), last_pass_ms = max_val(last_pass_ms, w->last_pass_ms);
+    points_rate += w->points_rate;
+  }
+
+  lua_newtable(vm);
+  lua_push_uint32_table_entry(vm, "num_writers", num_writers);
+  lua_push_uint64_table_entry(vm, "points_submitted", num_submitted);
+  lua_push_uint64_table_entry(vm, "points_dropped", num_dropped);
+  lua_push_uint64_table_entry(vm, "points_pending", num_pending);
+  lua_push_uint64_table_entry(vm, "points_written", num_written);
+  lua_push_uint64_table_entry(vm, "points_rejected", num_rejected);
+  lua_push_float_table_entry(vm, "points_per_sec", points_rate);
+  lua_push_uint64_table_entry(vm, "files_updated", num_files);
+  lua_push_float_table_entry(vm, "points_per_file", num_files ? (float)(num_written + num_rejected) / num_files : 0);
+  lua_push_uint64_table_entry(vm, "passes", num_passes);
+  lua_push_uint32_table_entry(vm, "last_pass_ms", last_pass_ms);
+  /* Points written more than RRD_WRITER_DEADLINE seconds after their submission */
+  lua_push_uint64_table_entry(vm, "deadline_misses", num_late);
+  lua_push_uint32_table_entry(vm, "deadline_sec", RRD_WRITER_DEADLINE);
+  lua_push_uint32_table_entry(vm, "max_write_delay_sec", max_delay);
+}
+
+/* ******************************************* */
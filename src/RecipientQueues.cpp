@@ -25,8 +25,10 @@
 
 RecipientQueues::RecipientQueues(u_int16_t _recipient_id) {
   recipient_id = _recipient_id;
-  queue = NULL, drops = 0, uses = 0;
+  drops = 0, uses = 0;
+  enqueue_nsec = max_enqueue_nsec = 0;
   last_use = 0;
+  queue = NULL;
 
   /* No minimum severity */
   minimum_severity = alert_level_none;
@@ -39,29 +41,64 @@ RecipientQueues::RecipientQueues(u_int16_t _recipient_id) {
 /* *************************************** */
 
 RecipientQueues::~RecipientQueues() {
-  if(queue)
-    delete queue;
+  AlertFifoQueue *q = queue.load();
+
+  if(q)
+    delete q;
+}
+
+/* *************************************** */
+
+/*
+  Producers enqueue concurrently: the first one allocating the queue
+  publishes it, the others release their copy. NULL is returned on
+  allocation failures, to be retried by the next enqueue.
+*/
+AlertFifoQueue* RecipientQueues::getQueue() {
+  AlertFifoQueue *q = queue.load(std::memory_order_acquire), *expected = NULL;
+
+  if(q)
+    return(q);
+
+  try {
+    q = new AlertFifoQueue(ALERTS_NOTIFICATIONS_QUEUE_SIZE);
+  } catch(std::bad_alloc& ba) {
+    return(NULL);
+  }
+
+  if(!queue.compare_exchange_strong(expected, q, std::memory_order_acq_rel)) {
+    delete q;
+    q = expected;
+  }
+
+  return(q);
 }
 
 /* *************************************** */
 
-bool RecipientQueues::dequeue(AlertFifoItem *notification) {
-  if(!queue || !notification)
-    return false;
+u_int32_t RecipientQueues::dequeue(AlertFifoItem *notifications, u_int32_t max_notifications) {
+  AlertFifoQueue *q = queue.load(std::memory_order_acquire);
+  u_int32_t n;
+
+  if(!q || !notifications)
+    return 0;
 
-  *notification = queue->dequeue();
+  dequeue_lock.lock(__FILE__, __LINE__);
+  n = q->dequeue(notifications, max_notifications);
+  dequeue_lock.unlock(__FILE__, __LINE__);
 
-  if(notification->alert) {
+  if(n > 0)
     last_use = time(NULL);
-    return true;
-  }
 
-  return false;
+  return n;
 }
 
 /* *************************************** */
 
-bool RecipientQueues::enqueue(const AlertFifoItem* const notification, AlertEntity alert_entity) {
+bool RecipientQueues::enqueue(const AlertFifoItem* const notification, AlertEntity alert_entity,
+			      AlertFifoPayload *payload) {
+  AlertFifoQueue *q;
+  u_int64_t begin, elapsed;
   bool res = false;
 
   if(!notification
@@ -82,22 +119,23 @@ bool RecipientQueues::enqueue(const AlertFifoItem* const notification, AlertEnti
     }
   }
 
-  if ((!queue &&
-       !(queue = new (nothrow) AlertFifoQueue(ALERTS_NOTIFICATIONS_QUEUE_SIZE)))) {
-    /* Queue not available */
+  if(!payload || !payload->isValid() || ((q = getQueue()) == NULL)) {
+    /* Queue or payload not available */
     drops++;
     return false; /* Enqueue failed */
   }
 
-  /* Enqueue the notification (allocate memory for the alert string) */
-  AlertFifoItem q = *notification;
-  if((q.alert = strdup(notification->alert)))
-    res = queue->enqueue(q);
+  /* Enqueue the notification (the alert string is shared with the other recipients) */
+  begin = Utils::monotonicNsec();
+  res = q->enqueue(notification, payload);
+  elapsed = Utils::monotonicNsec() - begin;
+
+  enqueue_nsec += elapsed;
+  if(elapsed > max_enqueue_nsec) max_enqueue_nsec = elapsed; /* Racy, approximate is fine */
 
-  if(!res) {
+  if(!res)
     drops++;
-    if(q.alert) free(q.alert);
-  } else
+  else
     uses++;
 
   return res;
@@ -106,20 +144,26 @@ bool RecipientQueues::enqueue(const AlertFifoItem* const notification, AlertEnti
 /* *************************************** */
 
 void RecipientQueues::lua(lua_State* vm) {
+  AlertFifoQueue *q = queue.load(std::memory_order_acquire);
+
   lua_newtable(vm);
   lua_push_uint64_table_entry(vm, "last_use", last_use);
   lua_push_uint64_table_entry(vm, "num_drops", drops);
   lua_push_uint64_table_entry(vm, "num_uses", uses);
-  lua_push_uint64_table_entry(vm, "fill_pct", queue ? queue->fillPct() : 0);
+  lua_push_uint64_table_entry(vm, "fill_pct", q ? q->fillPct() : 0);
+  lua_push_uint32_table_entry(vm, "num_queued", q ? q->getLength() : 0);
+  lua_push_uint64_table_entry(vm, "avg_enqueue_nsec", (uses + drops) ? enqueue_nsec / (uses + drops) : 0);
+  lua_push_uint64_table_entry(vm, "max_enqueue_nsec", max_enqueue_nsec);
 }
 
 /* *************************************** */
 
 bool RecipientQueues::empty() {
+  AlertFifoQueue *q = queue.load(std::memory_order_acquire);
   bool res = true;
 
-  if(queue) {
-    if(!queue->empty()) {
+  if(q) {
+    if(!q->empty()) {
       res = false;
     }  
   }
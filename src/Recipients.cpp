@@ -38,20 +38,20 @@ Recipients::~Recipients() {
 
 /* *************************************** */
 
-bool Recipients::dequeue(u_int16_t recipient_id, AlertFifoItem *notification) {
-  bool res = false;
+u_int32_t Recipients::dequeue(u_int16_t recipient_id, AlertFifoItem *notifications, u_int32_t max_notifications) {
+  u_int32_t res = 0;
 
   if(recipient_id >= MAX_NUM_RECIPIENTS
-     || !notification)
-    return false;
+     || !notifications)
+    return 0;
 
-  m.lock(__FILE__, __LINE__);
+  m.rdlock(__FILE__, __LINE__);
 
   if(recipient_queues[recipient_id]) {
     /*
-      Dequeue the notification
+      Dequeue the notifications
     */
-    res = recipient_queues[recipient_id]->dequeue(notification);
+    res = recipient_queues[recipient_id]->dequeue(notifications, max_notifications);
   }
 
   m.unlock(__FILE__, __LINE__);
@@ -62,34 +62,46 @@ bool Recipients::dequeue(u_int16_t recipient_id, AlertFifoItem *notification) {
 /* *************************************** */
 
 bool Recipients::enqueue(u_int16_t recipient_id, const AlertFifoItem* const notification) {
+  AlertFifoPayload *payload;
   bool res = false;
 
   if(recipient_id >= MAX_NUM_RECIPIENTS
      || !notification)
     return false;
 
-  m.lock(__FILE__, __LINE__);
+  if((payload = new (nothrow) AlertFifoPayload(notification->alert)) == NULL)
+    return false;
+
+  m.rdlock(__FILE__, __LINE__);
 
   /* 
      Perform the actual enqueue
    */
   if(recipient_queues[recipient_id])
-    res = recipient_queues[recipient_id]->enqueue(notification, alert_entity_other /* TODO */);
+    res = recipient_queues[recipient_id]->enqueue(notification, alert_entity_other /* TODO */, payload);
 
   m.unlock(__FILE__, __LINE__);
 
+  payload->decRefs(); /* Now owned by the queue, if enqueued */
+
   return res;
 }
 
 /* *************************************** */
 
 bool Recipients::enqueue(const AlertFifoItem* const notification, AlertEntity alert_entity) {
+  AlertFifoPayload *payload;
   bool res = true; /* Initialized to true so that if no recipient is responsible for the notification, true will be returned. */
 
   if(!notification)
     return false;
 
-  m.lock(__FILE__, __LINE__);
+  /* A single copy of the alert is shared by all the recipients */
+  if((payload = new (nothrow) AlertFifoPayload(notification->alert)) == NULL)
+    return false;
+
+  /* Producers only share the read lock: queues are lockless */
+  m.rdlock(__FILE__, __LINE__);
 
   /* 
      Perform the actual enqueue to all available recipients
@@ -98,7 +110,7 @@ bool Recipients::enqueue(const AlertFifoItem* const notification, AlertEntity al
     if(recipient_queues[recipient_id]) {
       bool success;
 
-      success = recipient_queues[recipient_id]->enqueue(notification, alert_entity);
+      success = recipient_queues[recipient_id]->enqueue(notification, alert_entity, payload);
       
       res &= success;
     }
@@ -106,6 +118,8 @@ bool Recipients::enqueue(const AlertFifoItem* const notification, AlertEntity al
 
   m.unlock(__FILE__, __LINE__);
 
+  payload->decRefs(); /* Freed here unless enqueued */
+
   return res;
 }
 
@@ -116,7 +130,7 @@ void Recipients::register_recipient(u_int16_t recipient_id, AlertLevel minimum_s
   if(recipient_id >= MAX_NUM_RECIPIENTS)
     return;
 
-  m.lock(__FILE__, __LINE__);
+  m.wrlock(__FILE__, __LINE__);
 
   if(!recipient_queues[recipient_id])
     recipient_queues[recipient_id] = new (nothrow) RecipientQueues(recipient_id);
@@ -138,7 +152,7 @@ void Recipients::delete_recipient(u_int16_t recipient_id) {
   if(recipient_id >= MAX_NUM_RECIPIENTS)
     return;
 
-  m.lock(__FILE__, __LINE__);
+  m.wrlock(__FILE__, __LINE__);
 
   if(recipient_queues[recipient_id]) {
     delete recipient_queues[recipient_id];
@@ -154,7 +168,7 @@ void Recipients::lua(u_int16_t recipient_id, lua_State* vm) {
   if(recipient_id >= MAX_NUM_RECIPIENTS)
     return;
 
-  m.lock(__FILE__, __LINE__);
+  m.rdlock(__FILE__, __LINE__);
 
   if(recipient_queues[recipient_id])
     recipient_queues[recipient_id]->lua(vm);
@@ -170,7 +184,7 @@ time_t Recipients::last_use(u_int16_t recipient_id) {
   if(recipient_id >= MAX_NUM_RECIPIENTS)
     return 0;
 
-  m.lock(__FILE__, __LINE__);
+  m.rdlock(__FILE__, __LINE__);
 
   if(recipient_queues[recipient_id])
     res = recipient_queues[recipient_id]->get_last_use();
@@ -185,7 +199,7 @@ time_t Recipients::last_use(u_int16_t recipient_id) {
 bool Recipients::empty() {
   bool res = true;
 
-  m.lock(__FILE__, __LINE__);
+  m.rdlock(__FILE__, __LINE__);
 
   for(int recipient_id = 0; recipient_id < MAX_NUM_RECIPIENTS; recipient_id++) {
     if(recipient_queues[recipient_id]) {
@@ -29,10 +29,40 @@
 
 // #define CACHE_DEBUG 1
 
+/* Index of the connection used by the calling thread, assigned round robin */
+static __thread int redis_connection_slot = -1;
+static std::atomic<u_int32_t> redis_next_connection_slot(0);
+
+/* **************************************** */
+
+static inline void addLatency(redis_connection_t *c, RedisLatencyClass latency_class, u_int64_t usec) {
+  u_int bucket = 0;
+
+  while((usec > 0) && (bucket < REDIS_LATENCY_BUCKETS - 1))
+    usec >>= 1, bucket++;
+
+  c->stats.latency[latency_class][bucket]++;
+}
+
+/* **************************************** */
+
+/* Commands whose first argument is a key that is not modified */
+static bool isReadOnlyCommand(const char *cmd) {
+  static const char *read_only[] = { "GET", "TTL", "STRLEN", "EXISTS", "HGET", "HGETALL", "HKEYS",
+				     "HSTRLEN", "LLEN", "LINDEX", "LRANGE", "SMEMBERS", "SISMEMBER",
+				     "KEYS", "DUMP", NULL };
+
+  for(u_int i = 0; read_only[i] != NULL; i++)
+    if(!strcasecmp(cmd, read_only[i]))
+      return(true);
+
+  return(false);
+}
+
 /* **************************************** */
 
 Redis::Redis(const char *_redis_host, const char *_redis_password, u_int16_t _redis_port,
-	     u_int8_t _redis_db_id, bool giveup_on_failure) {
+	     u_int8_t _redis_db_id, bool giveup_on_failure, u_int8_t _num_connections) {
   redis_host = _redis_host ? strdup(_redis_host) : NULL;
   redis_password = _redis_password ? strdup(_redis_password) : NULL;
   redis_port = _redis_port, redis_db_id = _redis_db_id;
@@ -42,13 +72,27 @@ Redis::Redis(const char *_redis_host, const char *_redis_password, u_int16_t _re
 
   memset(&stats, 0, sizeof(stats));
 
-  redis = NULL, operational = false;
+  num_connections = min_val(max_val(_num_connections, 1), REDIS_MAX_NUM_CONNECTIONS);
+  connections = new (std::nothrow) redis_connection_t[num_connections];
+
+  for(u_int i = 0; i < num_connections; i++) {
+    memset(&connections[i].stats, 0, sizeof(connections[i].stats));
+    connections[i].ctx = NULL;
+    connections[i].m = new (std::nothrow) Mutex();
+  }
+
+  stringCache = new (std::nothrow) StringLRUCache(REDIS_CACHE_SHARDS, REDIS_CACHE_MAX_ENTRIES);
+  operational = false;
+  redis_version = NULL, num_redis_version = 0;
   initializationCompleted = false;
   localToResolve = new (std::nothrow) StringFifoQueue(MAX_NUM_QUEUED_ADDRS);
   remoteToResolve = new (std::nothrow) StringFifoQueue(MAX_NUM_QUEUED_ADDRS);
-  reconnectRedis(giveup_on_failure);
-  numCached = 0;
-  l = new (std::nothrow) Mutex();
+
+  for(u_int i = 0; i < num_connections; i++) {
+    reconnectRedis(&connections[i], giveup_on_failure);
+
+    if(!operational) break;
+  }
 
   if(operational) getRedisVersion();
 }
@@ -57,9 +101,14 @@ Redis::Redis(const char *_redis_host, const char *_redis_password, u_int16_t _re
 
 Redis::~Redis() {
   flushCache();
-  redisFree(redis);
-  // flushCache();
-  delete l;
+
+  for(u_int i = 0; i < num_connections; i++) {
+    if(connections[i].ctx) redisFree(connections[i].ctx);
+    delete connections[i].m;
+  }
+
+  delete[] connections;
+  delete stringCache;
   
   if(redis_host)     free(redis_host);
   if(redis_password) free(redis_password);
@@ -70,7 +119,8 @@ Redis::~Redis() {
 
 /* **************************************** */
 
-void Redis::reconnectRedis(bool giveup_on_failure) {
+/* NOTE: must be called with the connection locked (or not yet in use) */
+void Redis::reconnectRedis(redis_connection_t *c, bool giveup_on_failure) {
   struct timeval timeout = { 1, 500000 }; // 1.5 seconds
   redisReply *reply = NULL;
   u_int num_attempts;
@@ -79,31 +129,31 @@ void Redis::reconnectRedis(bool giveup_on_failure) {
   operational = connected = false;
 
   for(num_attempts = CONST_MAX_REDIS_CONN_RETRIES; num_attempts > 0; num_attempts--) {
-    if(redis) {
+    if(c->ctx) {
       ntop->getTrace()->traceEvent(TRACE_NORMAL, "Redis has disconnected, reconnecting [remaining attempts: %u]",
 				   num_attempts - 1);
-      redisFree(redis);
+      redisFree(c->ctx);
     }
 
 #ifdef __linux__
     struct stat buf;
 
     if(!stat(redis_host, &buf) && S_ISSOCK(buf.st_mode))
-      redis = redisConnectUnixWithTimeout(redis_host, timeout), is_socket_connection = true;
+      c->ctx = redisConnectUnixWithTimeout(redis_host, timeout), is_socket_connection = true;
     else
 #endif
-      redis = redisConnectWithTimeout(redis_host, redis_port, timeout);
+      c->ctx = redisConnectWithTimeout(redis_host, redis_port, timeout);
 
-    if(redis == NULL || redis->err) {
-      if(redis)
-	ntop->getTrace()->traceEvent(TRACE_ERROR, "Connection error [%s]", redis->errstr);
+    if(c->ctx == NULL || c->ctx->err) {
+      if(c->ctx)
+	ntop->getTrace()->traceEvent(TRACE_ERROR, "Connection error [%s]", c->ctx->errstr);
 
       goto conn_retry;
     }
 
     if(redis_password) {
-      stats.num_other++;
-      reply = (redisReply*)redisCommand(redis, "AUTH %s", redis_password);
+      c->stats.num_other++;
+      reply = (redisReply*)redisCommand(c->ctx, "AUTH %s", redis_password);
       if(reply && (reply->type == REDIS_REPLY_ERROR)) {
 	ntop->getTrace()->traceEvent(TRACE_ERROR,
 				     "Redis authentication failed: %s", reply->str ? reply->str : "???");
@@ -113,8 +163,8 @@ void Redis::reconnectRedis(bool giveup_on_failure) {
     }
 
     if(reply) freeReplyObject(reply);
-    stats.num_other++;
-    reply = (redisReply*)redisCommand(redis, "PING");
+    c->stats.num_other++;
+    reply = (redisReply*)redisCommand(c->ctx, "PING");
     if(reply && (reply->type == REDIS_REPLY_ERROR)) {
       ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
@@ -122,8 +172,8 @@ void Redis::reconnectRedis(bool giveup_on_failure) {
     }
 
     if(reply) freeReplyObject(reply);
-    stats.num_other++;
-    reply = (redisReply*)redisCommand(redis, "SELECT %u", redis_db_id);
+    c->stats.num_other++;
+    reply = (redisReply*)redisCommand(c->ctx, "SELECT %u", redis_db_id);
     if(reply && (reply->type == REDIS_REPLY_ERROR)) {
       ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
@@ -163,30 +213,120 @@ void Redis::reconnectRedis(bool giveup_on_failure) {
 				 "Successfully connected to redis %s@%u",
 				 redis_host, redis_db_id);
 
-  stats.num_reconnections++;
+  c->stats.num_reconnections++;
   operational = true;
 }
 
 /* **************************************** */
 
+redis_connection_t* Redis::lockConnection(const char *filename, const int line, bool trace_errors) {
+  redis_connection_t *c;
+  u_int64_t begin, waited;
+
+  if(redis_connection_slot == -1)
+    redis_connection_slot = redis_next_connection_slot++ & 0x7FFFFFFF;
+
+  c = &connections[redis_connection_slot % num_connections];
+
+  begin = Utils::monotonicUsec();
+  c->m->lock(filename, line, trace_errors);
+  waited = Utils::monotonicUsec() - begin;
+
+  c->stats.num_locks++, c->stats.lock_wait_usec += waited;
+  if(waited > c->stats.max_lock_wait_usec) c->stats.max_lock_wait_usec = waited;
+
+  return(c);
+}
+
+/* **************************************** */
+
+void Redis::unlockConnection(redis_connection_t *c, const char *filename, const int line, bool trace_errors) {
+  c->m->unlock(filename, line, trace_errors);
+}
+
+/* **************************************** */
+
+/* NOTE: the connection must be locked */
+redisReply* Redis::command(redis_connection_t *c, RedisLatencyClass latency_class, const char *format, ...) {
+  redisReply *reply;
+  u_int64_t begin = Utils::monotonicUsec();
+  va_list ap;
+
+  va_start(ap, format);
+  reply = (redisReply*)redisvCommand(c->ctx, format, ap);
+  va_end(ap);
+
+  addLatency(c, latency_class, Utils::monotonicUsec() - begin);
+
+  if(!reply) reconnectRedis(c, true);
+
+  return(reply);
+}
+
+/* **************************************** */
+
+/* NOTE: the connection must be locked */
+redisReply* Redis::commandArgv(redis_connection_t *c, RedisLatencyClass latency_class,
+			       int argc, const char **argv, const size_t *argvlen) {
+  redisReply *reply;
+  u_int64_t begin = Utils::monotonicUsec();
+
+  reply = (redisReply*)redisCommandArgv(c->ctx, argc, argv, argvlen);
+
+  addLatency(c, latency_class, Utils::monotonicUsec() - begin);
+
+  if(!reply) reconnectRedis(c, true);
+
+  return(reply);
+}
+
+/* **************************************** */
+
+/* NOTE: counters are read without locking the connections, as for the other stats */
+void Redis::sumStats(redis_stats_t *tot) {
+  memcpy(tot, &stats, sizeof(*tot));
+
+  for(u_int i = 0; i < num_connections; i++) {
+    redis_stats_t *s = &connections[i].stats;
+
+    tot->num_expire += s->num_expire, tot->num_get += s->num_get;
+    tot->num_ttl += s->num_ttl, tot->num_del += s->num_del;
+    tot->num_hget += s->num_hget, tot->num_hset += s->num_hset;
+    tot->num_hdel += s->num_hdel, tot->num_set += s->num_set;
+    tot->num_keys += s->num_keys, tot->num_hkeys += s->num_hkeys;
+    tot->num_llen += s->num_llen, tot->num_other += s->num_other;
+    tot->num_hgetall += s->num_hgetall, tot->num_trim += s->num_trim;
+    tot->num_lpush_rpush += s->num_lpush_rpush, tot->num_lpop_rpop += s->num_lpop_rpop;
+    tot->num_strlen += s->num_strlen, tot->num_pipelines += s->num_pipelines;
+    tot->num_reconnections += s->num_reconnections;
+    tot->num_locks += s->num_locks, tot->lock_wait_usec += s->lock_wait_usec;
+
+    if(s->max_lock_wait_usec > tot->max_lock_wait_usec)
+      tot->max_lock_wait_usec = s->max_lock_wait_usec;
+
+    for(u_int j = 0; j < redis_latency_num_classes; j++)
+      for(u_int k = 0; k < REDIS_LATENCY_BUCKETS; k++)
+	tot->latency[j][k] += s->latency[j][k];
+  }
+}
+
+/* **************************************** */
+
 int Redis::expire(char *key, u_int expire_secs) {
   int rc;
   redisReply *reply;
+  redis_connection_t *c;
 
-  l->lock(__FILE__, __LINE__);
-
-  if(expireCache(key, expire_secs)) {
-    l->unlock(__FILE__, __LINE__);
+  if(expireCache(key, expire_secs))
     return(0);
-  }
 
-  stats.num_expire++;
-  reply = (redisReply*)redisCommand(redis, "EXPIRE %s %u", key, expire_secs);
-  if(!reply) reconnectRedis(true);
+  c = lockConnection(__FILE__, __LINE__);
+  c->stats.num_expire++;
+  reply = (redisReply*)command(c, redis_latency_set, "EXPIRE %s %u", key, expire_secs);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
   if(reply) freeReplyObject(reply), rc = 0; else rc = -1;
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
 
   return(rc);
 }
@@ -205,18 +345,11 @@ bool Redis::isCacheable(const char * key) {
 /* **************************************** */
 
 bool Redis::expireCache(char *key, u_int expire_secs) {
-  std::map<std::string, StringCache>::iterator it;
-
 #ifdef CACHE_DEBUG
   printf("**** Setting cache expire for %s [%u sec]\n", key, expire_secs);
 #endif
 
-  if((it = stringCache.find(key)) != stringCache.end()) {
-    it->second.expire = expire_secs ? time(NULL)+expire_secs : 0;
-    return(true);
-  }
-
-  return(false);
+  return(stringCache->expire(key, expire_secs));
 }
 
 /* **************************************** */
@@ -240,10 +373,9 @@ int Redis::info(char *rsp, u_int rsp_len) {
   int rc;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
-  stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "INFO");
-  if(!reply) reconnectRedis(true);
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
+  c->stats.num_other++;
+  reply = (redisReply*)command(c, redis_latency_other, "INFO");
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
@@ -252,7 +384,7 @@ int Redis::info(char *rsp, u_int rsp_len) {
   } else
     rsp[0] = 0, rc = -1;
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
 
   return(rc);
 }
@@ -263,12 +395,11 @@ u_int Redis::dbsize() {
   redisReply *reply;
   u_int num = 0;
 
-  l->lock(__FILE__, __LINE__);
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
 
-  stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "DBSIZE");
+  c->stats.num_other++;
+  reply = (redisReply*)command(c, redis_latency_other, "DBSIZE");
 
-  if(!reply) reconnectRedis(true);
   if(reply) {
     if(reply->type == REDIS_REPLY_ERROR)
       ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
@@ -276,7 +407,7 @@ u_int Redis::dbsize() {
       num = (u_int)reply->integer;
   }
 
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
   if(reply) freeReplyObject(reply);
 
   return(num);
@@ -284,30 +415,15 @@ u_int Redis::dbsize() {
 
 /* **************************************** */
 
-/* NOTE: We assume that the addToCache() caller locks this instance */
+/* NOTE: the cache has its own locks, callers can hold a connection */
 void Redis::addToCache(const char * key, const char * value, u_int expire_secs) {
-  std::map<std::string, StringCache>::iterator it;
   if(!initializationCompleted) return;
 
 #ifdef CACHE_DEBUG
   printf("**** Caching %s=%s [len: %lu]\n", key, value ? value : "<NULL>", value ? strlen(value) : 0);
 #endif
 
-  if((it = stringCache.find(key)) != stringCache.end()) {
-    StringCache *cached = &it->second;
-
-    cached->value = value;
-    cached->expire = expire_secs ? time(NULL)+expire_secs : 0;
-    return;
-  } else {
-    StringCache item;
-
-    item.value = value;
-    item.expire = expire_secs ? time(NULL)+expire_secs : 0;
-
-    stringCache[key] = item;
-    numCached++;
-  }
+  stringCache->set(key, value, expire_secs);
 }
 
 /* **************************************** */
@@ -316,27 +432,16 @@ int Redis::get(char *key, char *rsp, u_int rsp_len, bool cache_it) {
   int rc;
   bool cacheable = false;
   redisReply *reply;
-  std::map<std::string, StringCache>::iterator it;
-
-  l->lock(__FILE__, __LINE__);
-
-  if((it = stringCache.find(key)) != stringCache.end()) {
-    StringCache *cached = &it->second;
+  redis_connection_t *c;
+  u_int64_t cache_version;
 
-    if((cached->expire > 0) && (time(NULL) >= cached->expire)) {
-#ifdef CACHE_DEBUG
-      printf("**** Cache expired %s\n", key);
-#endif
-
-      stringCache.erase(it);
-      rsp[0] = '\0';
-    } else
-      snprintf(rsp, rsp_len, "%s", cached->value.c_str());
+  cacheable = isCacheable(key);
 
+  /* Expired keys are read again from redis */
+  if((cache_it || cacheable) && stringCache->get(key, rsp, rsp_len)) {
 #ifdef CACHE_DEBUG
     printf("**** Read from cache %s=%s\n", key, rsp);
 #endif
-    l->unlock(__FILE__, __LINE__);
     return(rsp[0] == '\0' ? -1 : 0);
   } else {
 #ifdef CACHE_DEBUG
@@ -344,13 +449,16 @@ int Redis::get(char *key, char *rsp, u_int rsp_len, bool cache_it) {
 #endif
   }
 
-  stats.num_get++;
-  reply = (redisReply*)redisCommand(redis, "GET %s", key);
-  if(!reply) reconnectRedis(true);
+  /* Writers update the cache once redis has the new value: a write meanwhile discards what is read here */
+  cache_version = stringCache->getVersion(key);
+
+  c = lockConnection(__FILE__, __LINE__);
+
+  c->stats.num_get++;
+  reply = (redisReply*)command(c, redis_latency_get, "GET %s", key);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
-  cacheable = isCacheable(key);
   if(reply && reply->str) {
     snprintf(rsp, rsp_len, "%s", reply->str ? reply->str : ""), rc = 0;
   } else {
@@ -361,9 +469,8 @@ int Redis::get(char *key, char *rsp, u_int rsp_len, bool cache_it) {
     u_int expire_sec = 0;
 
     if(reply) freeReplyObject(reply);
-    stats.num_ttl++;
-    reply = (redisReply*)redisCommand(redis, "TTL %s", key);
-    if(!reply) reconnectRedis(true);
+    c->stats.num_ttl++;
+    reply = (redisReply*)command(c, redis_latency_get, "TTL %s", key);
     if(reply && (reply->type != REDIS_REPLY_INTEGER))
       ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
@@ -374,11 +481,12 @@ int Redis::get(char *key, char *rsp, u_int rsp_len, bool cache_it) {
     printf("**** ADD TO CACHE %s=%s [expire_sec=%u]\n", key, rsp, expire_sec);
 #endif
 
-    addToCache(key, rsp, expire_sec);
+    if(initializationCompleted)
+      stringCache->fill(key, rsp, expire_sec, cache_version);
   }
 
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
 
   if(cacheable && (rc == -1)) {
     /* Don't fill redis with default empty strings.
@@ -394,17 +502,92 @@ int Redis::get(char *key, char *rsp, u_int rsp_len, bool cache_it) {
 
 /* **************************************** */
 
+/* NOTE: keys are not looked up in the stringCache: cached copies of the
+   keys written by the pipeline are dropped once written, and read again on the next get() */
+int Redis::pipeline(redis_pipeline_cmd_t *cmds, u_int num_cmds) {
+  u_int i, num_sent;
+  int rc = 0;
+  u_int64_t begin;
+  redis_connection_t *c;
+
+  for(i = 0; i < num_cmds; i++)
+    cmds[i].reply = NULL;
+
+  if(num_cmds == 0)
+    return(0);
+
+  c = lockConnection(__FILE__, __LINE__);
+
+  c->stats.num_pipelines++;
+  begin = Utils::monotonicUsec();
+
+  for(num_sent = 0; num_sent < num_cmds; num_sent++) {
+    const char *cmd = cmds[num_sent].argv[0];
+
+    if(redisAppendCommandArgv(c->ctx, cmds[num_sent].argc, cmds[num_sent].argv, cmds[num_sent].argvlen) != REDIS_OK)
+      break;
+
+    if(!strcasecmp(cmd, "GET"))         c->stats.num_get++;
+    else if(!strcasecmp(cmd, "SET"))    c->stats.num_set++;
+    else if(!strcasecmp(cmd, "DEL"))    c->stats.num_del++;
+    else if(!strcasecmp(cmd, "EXPIRE")) c->stats.num_expire++;
+    else                                c->stats.num_other++;
+  }
+
+  for(i = 0; i < num_sent; i++) {
+    void *reply = NULL;
+
+    if(redisGetReply(c->ctx, &reply) != REDIS_OK) {
+      /* Replies of the remaining commands are lost with the connection */
+      reconnectRedis(c, true);
+      break;
+    }
+
+    cmds[i].reply = (redisReply*)reply;
+
+    if(cmds[i].reply->type == REDIS_REPLY_ERROR)
+      ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", cmds[i].reply->str ? cmds[i].reply->str : "???");
+  }
+
+  if((num_sent < num_cmds) || (i < num_sent))
+    rc = -1;
+
+  addLatency(c, redis_latency_pipeline, Utils::monotonicUsec() - begin);
+  unlockConnection(c, __FILE__, __LINE__);
+
+  /*
+    Dropped after the writes (also the failed ones, whose outcome is unknown),
+    so that a get() that read the old value meanwhile does not cache it
+  */
+  for(i = 0; i < num_cmds; i++) {
+    if((cmds[i].argc > 1) && (!isReadOnlyCommand(cmds[i].argv[0]))) {
+      std::string key(cmds[i].argv[1], cmds[i].argvlen[1]);
+
+      if(isCacheable(key.c_str()))
+	stringCache->remove(key.c_str());
+
+      if(cmds[i].reply)
+	checkDumpable(key.c_str());
+    }
+  }
+
+  return(rc);
+}
+
+/* **************************************** */
+
 int Redis::del(char *key){
   int rc;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
+  redis_connection_t *c;
 
-  stringCache.erase(key);
+  stringCache->remove(key);
 
-  stats.num_del++;
-  reply = (redisReply*)redisCommand(redis, "DEL %s", key);
-  if(!reply) reconnectRedis(true);
+  c = lockConnection(__FILE__, __LINE__);
+
+  c->stats.num_del++;
+  reply = (redisReply*)command(c, redis_latency_del, "DEL %s", key);
   if(reply && (reply->type == REDIS_REPLY_ERROR)){
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
     rc = -1;
@@ -413,7 +596,10 @@ int Redis::del(char *key){
   }
 
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
+
+  /* Dropped again: a get() may have cached the old value meanwhile */
+  stringCache->remove(key);
 
   if(reply) checkDumpable(key);
 
@@ -426,10 +612,9 @@ int Redis::hashGet(const char * key, const char * field, char * const rsp, u_int
   int rc;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
-  stats.num_hget++;
-  reply = (redisReply*)redisCommand(redis, "HGET %s %s", key, field);
-  if(!reply) reconnectRedis(true);
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
+  c->stats.num_hget++;
+  reply = (redisReply*)command(c, redis_latency_hash, "HGET %s %s", key, field);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "failure on HGET %s %s (%s)", key, field, reply->str ? reply->str : "???");
 
@@ -438,7 +623,7 @@ int Redis::hashGet(const char * key, const char * field, char * const rsp, u_int
   } else
     rsp[0] = 0, rc = -1;
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
 
   return(rc);
 }
@@ -449,14 +634,13 @@ int Redis::hashSet(const char * key, const char * field, const char * value) {
   int rc = 0;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
-  stats.num_hset++;
-  reply = (redisReply*)redisCommand(redis, "HSET %s %s %s", key, field, value);
-  if(!reply) reconnectRedis(true);
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
+  c->stats.num_hset++;
+  reply = (redisReply*)command(c, redis_latency_hash, "HSET %s %s %s", key, field, value);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s [HSET %s %s %s]", reply->str ? reply->str : "???", key, field, value), rc = -1;
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
 
   if(reply) checkDumpable(key);
 
@@ -469,10 +653,9 @@ int Redis::hashDel(const char * key, const char * field) {
   int rc;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
-  stats.num_hdel++;
-  reply = (redisReply*)redisCommand(redis, "HDEL %s %s", key, field);
-  if(!reply) reconnectRedis(true);
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
+  c->stats.num_hdel++;
+  reply = (redisReply*)command(c, redis_latency_hash, "HDEL %s %s", key, field);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
@@ -480,7 +663,7 @@ int Redis::hashDel(const char * key, const char * field) {
     freeReplyObject(reply), rc = 0;
   } else
     rc = -1;
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
 
   if(reply) checkDumpable(key);
 
@@ -501,14 +684,10 @@ int Redis::_set(bool use_nx, const char * key, const char * value, u_int expire_
     }
   }
   
-  l->lock(__FILE__, __LINE__);
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
 
-  if(isCacheable(key))
-    addToCache(key, value, expire_secs);
-
-  stats.num_set++;
-  reply = (redisReply*)redisCommand(redis, "%s %s %s", cmd, key, value);
-  if(!reply) reconnectRedis(true);
+  c->stats.num_set++;
+  reply = (redisReply*)command(c, redis_latency_set, "%s %s %s", cmd, key, value);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
   if(reply) {
@@ -524,14 +703,24 @@ int Redis::_set(bool use_nx, const char * key, const char * value, u_int expire_
   if((expire_secs != 0)
      && ((use_nx && (ret_code == 1))
 	 || ((!use_nx) && (rc == 0)))) {
-    stats.num_expire++;
-    reply = (redisReply*)redisCommand(redis, "EXPIRE %s %u", key, expire_secs);
-    if(!reply) reconnectRedis(true);
+    c->stats.num_expire++;
+    reply = (redisReply*)command(c, redis_latency_set, "EXPIRE %s %u", key, expire_secs);
     if(reply && (reply->type == REDIS_REPLY_ERROR))
       ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
     if(reply) freeReplyObject(reply), rc = 0; else rc = -1;
   }
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
+
+  /*
+    Cached once redis holds the value: a get() racing with this SET
+    either reads the new value or has its fill() discarded
+  */
+  if(isCacheable(key)) {
+    if((rc == 0) && ((!use_nx) || (ret_code == 1)))
+      addToCache(key, value, expire_secs);
+    else
+      stringCache->remove(key);
+  }
 
   if(reply && expire_secs == 0)
     checkDumpable(key);
@@ -549,10 +738,9 @@ int Redis::keys(const char *pattern, char ***keys_p) {
   u_int i;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
-  stats.num_keys++;
-  reply = (redisReply*)redisCommand(redis, "KEYS %s", pattern);
-  if(!reply) reconnectRedis(true);
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
+  c->stats.num_keys++;
+  reply = (redisReply*)command(c, redis_latency_other, "KEYS %s", pattern);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
@@ -566,7 +754,7 @@ int Redis::keys(const char *pattern, char ***keys_p) {
   }
 
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
 
   return(rc);
 }
@@ -578,10 +766,9 @@ int Redis::hashKeys(const char *pattern, char ***keys_p) {
   u_int i;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
-  stats.num_hkeys++;
-  reply = (redisReply*)redisCommand(redis, "HKEYS %s", pattern);
-  if(!reply) reconnectRedis(true);
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
+  c->stats.num_hkeys++;
+  reply = (redisReply*)command(c, redis_latency_hash, "HKEYS %s", pattern);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s [HKEYS %s]", reply->str ? reply->str : "???", pattern);
 
@@ -600,7 +787,7 @@ int Redis::hashKeys(const char *pattern, char ***keys_p) {
   }
 
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
 
   return(rc);
 }
@@ -612,10 +799,9 @@ int Redis::hashGetAll(const char *key, char ***keys_p, char ***values_p) {
   int i, j;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
-  stats.num_hgetall++;
-  reply = (redisReply*)redisCommand(redis, "HGETALL %s", key);
-  if(!reply) reconnectRedis(true);
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
+  c->stats.num_hgetall++;
+  reply = (redisReply*)command(c, redis_latency_hash, "HGETALL %s", key);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s [HGETALL %s]", reply->str ? reply->str : "???", key);
 
@@ -644,7 +830,7 @@ int Redis::hashGetAll(const char *key, char ***keys_p, char ***values_p) {
   }
 
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
 
   return(rc);
 }
@@ -665,7 +851,7 @@ int Redis::pushHostToResolve(char *hostname, bool dont_check_for_existence, bool
 
   snprintf(key, sizeof(key), "%s.%s", DNS_CACHE, hostname);
 
-  l->lock(__FILE__, __LINE__);
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
 
   if(dont_check_for_existence)
     found = false;
@@ -674,9 +860,8 @@ int Redis::pushHostToResolve(char *hostname, bool dont_check_for_existence, bool
       Add only if the address has not been resolved yet
     */
 
-    stats.num_get++;
-    reply = (redisReply*)redisCommand(redis, "GET %s", key);
-    if(!reply) reconnectRedis(true);
+    c->stats.num_get++;
+    reply = (redisReply*)command(c, redis_latency_get, "GET %s", key);
 
     if(reply && (reply->type == REDIS_REPLY_ERROR))
       ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
@@ -692,7 +877,7 @@ int Redis::pushHostToResolve(char *hostname, bool dont_check_for_existence, bool
       rc = -1;
   }
 
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
 
   if(!found) {
     /* Add to the list of addresses to resolve */
@@ -763,16 +948,15 @@ int Redis::flushDb() {
   int rc;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
 
-  stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "FLUSHDB");
-  if(!reply) reconnectRedis(true);
+  c->stats.num_other++;
+  reply = (redisReply*)command(c, redis_latency_other, "FLUSHDB");
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
   if(reply) freeReplyObject(reply), rc = 0; else rc = -1;
 
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
 
   if (rc == 0) {
     flushCache();
@@ -852,12 +1036,11 @@ int Redis::setResolvedAddress(char *numeric_ip, char *symbolic_ip) {
 char* Redis::getRedisVersion() {
   redisReply *reply;
   char str[32];
-  int a, b, c;
+  int major, minor, patch;
   
-  l->lock(__FILE__, __LINE__);
-  stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "INFO");
-  if(!reply) reconnectRedis(true);
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
+  c->stats.num_other++;
+  reply = (redisReply*)command(c, redis_latency_other, "INFO");
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
@@ -882,10 +1065,10 @@ char* Redis::getRedisVersion() {
     freeReplyObject(reply);
   }
   
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
   redis_version = strdup(str);
-  sscanf(redis_version, "%d.%d.%d", &a, &b, &c);
-  num_redis_version = (a << 16) + (b << 8) + c;
+  sscanf(redis_version, "%d.%d.%d", &major, &minor, &patch);
+  num_redis_version = (major << 16) + (minor << 8) + patch;
 
   return(redis_version);
 }
@@ -914,10 +1097,9 @@ int Redis::smembers(lua_State* vm, char *setName) {
 
   lua_newtable(vm);
 
-  l->lock(__FILE__, __LINE__);
-  stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "SMEMBERS %s", setName);
-  if(!reply) reconnectRedis(true);
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
+  c->stats.num_other++;
+  reply = (redisReply*)command(c, redis_latency_other, "SMEMBERS %s", setName);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
@@ -934,7 +1116,7 @@ int Redis::smembers(lua_State* vm, char *setName) {
     rc = -1;
 
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
 
   return(rc);
 }
@@ -945,11 +1127,10 @@ bool Redis::sismember(const char *set_name, const char * member) {
   redisReply *reply = NULL;
   bool res = false;
 
-  l->lock(__FILE__, __LINE__);
-  stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "SISMEMBER %s %s", set_name, member);
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
+  c->stats.num_other++;
+  reply = (redisReply*)command(c, redis_latency_other, "SISMEMBER %s %s", set_name, member);
 
-  if(!reply) reconnectRedis(true);
 
   if(reply) {
     if(reply->type == REDIS_REPLY_ERROR)
@@ -958,7 +1139,7 @@ bool Redis::sismember(const char *set_name, const char * member) {
       res = (u_int)reply->integer == 1 ? true : false;
   }
 
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
   if(reply) freeReplyObject(reply);
 
   return res;
@@ -971,11 +1152,10 @@ int Redis::smembers(const char *set_name, char ***members) {
   u_int i;
   redisReply *reply = NULL;
 
-  l->lock(__FILE__, __LINE__);
-  stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "SMEMBERS %s", set_name);
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
+  c->stats.num_other++;
+  reply = (redisReply*)command(c, redis_latency_other, "SMEMBERS %s", set_name);
 
-  if(!reply) reconnectRedis(true);
 
   if(reply && (reply->type == REDIS_REPLY_ERROR)) {
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s [SMEMBERS %s]", reply->str ? reply->str : "???", set_name);
@@ -998,7 +1178,7 @@ int Redis::smembers(const char *set_name, char ***members) {
 
  out:
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
 
   return(rc);
 }
@@ -1034,11 +1214,10 @@ int Redis::msg_push(const char * cmd, const char * queue_name, const char * msg,
   gettimeofday(&begin, NULL);
 #endif
 
-  l->lock(__FILE__, __LINE__, trace_errors);
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__, trace_errors);
   /* Put the latest messages on top so old messages (if any) will be discarded */
-  reply = (redisReply*)redisCommand(redis, "%s %s %s", cmd,  queue_name, msg);
+  reply = (redisReply*)command(c, redis_latency_list, "%s %s %s", cmd,  queue_name, msg);
 
-  if(!reply) reconnectRedis(true);
   if(reply) {
     if(reply->type == REDIS_REPLY_ERROR && trace_errors)
       ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???"), rc = -1;
@@ -1059,12 +1238,11 @@ int Redis::msg_push(const char * cmd, const char * queue_name, const char * msg,
     freeReplyObject(reply);
 
     if(queue_trim_size > 0) {
-      stats.num_trim++;
+      c->stats.num_trim++;
       if(head_trim)
-        reply = (redisReply*)redisCommand(redis, "LTRIM %s 0 %u", queue_name, queue_trim_size - 1);
+        reply = (redisReply*)command(c, redis_latency_list, "LTRIM %s 0 %u", queue_name, queue_trim_size - 1);
       else
-        reply = (redisReply*)redisCommand(redis, "LTRIM %s -%u -1", queue_name, queue_trim_size);
-      if(!reply) reconnectRedis(true);
+        reply = (redisReply*)command(c, redis_latency_list, "LTRIM %s -%u -1", queue_name, queue_trim_size);
       if(reply) {
 	if(reply->type == REDIS_REPLY_ERROR && trace_errors)
 	  ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???"), rc = -1;
@@ -1076,7 +1254,7 @@ int Redis::msg_push(const char * cmd, const char * queue_name, const char * msg,
   } else
     rc = -1;
 
-  l->unlock(__FILE__, __LINE__, trace_errors);
+  unlockConnection(c, __FILE__, __LINE__, trace_errors);
   return(rc);
 }
 
@@ -1086,12 +1264,11 @@ u_int Redis::len(const char * key) {
   redisReply *reply;
   u_int num = 0;
 
-  l->lock(__FILE__, __LINE__);
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
 
-  stats.num_strlen++;
-  reply = (redisReply*)redisCommand(redis, "STRLEN %s", key);
+  c->stats.num_strlen++;
+  reply = (redisReply*)command(c, redis_latency_get, "STRLEN %s", key);
 
-  if(!reply) reconnectRedis(true);
 
   if(reply) {
     if(reply->type == REDIS_REPLY_ERROR)
@@ -1100,7 +1277,7 @@ u_int Redis::len(const char * key) {
       num = (u_int)reply->integer;
   }
 
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
   if(reply) freeReplyObject(reply);
 
   return(num);
@@ -1114,12 +1291,11 @@ u_int Redis::hstrlen(const char * key, const char * value) {
   u_int num = 0;
   static bool error_sent = false;
 
-  l->lock(__FILE__, __LINE__);
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
 
-  stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "HSTRLEN %s %s", key, value);
+  c->stats.num_other++;
+  reply = (redisReply*)command(c, redis_latency_hash, "HSTRLEN %s %s", key, value);
 
-  if(!reply) reconnectRedis(true);
   if(reply) {
     if(reply->type == REDIS_REPLY_ERROR) {
       if(!error_sent) {
@@ -1130,7 +1306,7 @@ u_int Redis::hstrlen(const char * key, const char * value) {
       num = (u_int)reply->integer;
   }
 
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
   if(reply) freeReplyObject(reply);
 
   return(num);
@@ -1142,17 +1318,16 @@ u_int Redis::llen(const char *queue_name) {
   redisReply *reply;
   u_int num = 0;
 
-  l->lock(__FILE__, __LINE__);
-  stats.num_llen++;
-  reply = (redisReply*)redisCommand(redis, "LLEN %s", queue_name);
-  if(!reply) reconnectRedis(true);
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
+  c->stats.num_llen++;
+  reply = (redisReply*)command(c, redis_latency_list, "LLEN %s", queue_name);
   if(reply) {
     if(reply->type == REDIS_REPLY_ERROR)
       ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
     else
       num = (u_int)reply->integer;
   }
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
   if(reply) freeReplyObject(reply);
 
   return(num);
@@ -1163,14 +1338,13 @@ u_int Redis::llen(const char *queue_name) {
 int Redis::lset(const char *queue_name, u_int32_t idx, const char *value) {
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
-  stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "LSET %s %u %s", queue_name, idx, value);
-  if(!reply) reconnectRedis(true);
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
+  c->stats.num_other++;
+  reply = (redisReply*)command(c, redis_latency_list, "LSET %s %u %s", queue_name, idx, value);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
 
   if(reply) freeReplyObject(reply);
 
@@ -1182,14 +1356,13 @@ int Redis::lset(const char *queue_name, u_int32_t idx, const char *value) {
 int Redis::lrem(const char *queue_name, const char *value) {
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
-  stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "LREM %s 0 %s", queue_name, value);
-  if(!reply) reconnectRedis(true);
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
+  c->stats.num_other++;
+  reply = (redisReply*)command(c, redis_latency_list, "LREM %s 0 %s", queue_name, value);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
 
   if(reply) freeReplyObject(reply);
 
@@ -1202,10 +1375,9 @@ int Redis::lrpop(const char *queue_name, char *buf, u_int buf_len, bool lpop) {
   int rc;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
-  stats.num_lpop_rpop++;
-  reply = (redisReply*)redisCommand(redis, "%sPOP %s", lpop ? "L" : "R", queue_name);
-  if(!reply) reconnectRedis(true);
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
+  c->stats.num_lpop_rpop++;
+  reply = (redisReply*)command(c, redis_latency_list, "%sPOP %s", lpop ? "L" : "R", queue_name);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
@@ -1215,7 +1387,7 @@ int Redis::lrpop(const char *queue_name, char *buf, u_int buf_len, bool lpop) {
     buf[0] = '\0', rc = -1;
 
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
 
   return(rc);
 }
@@ -1238,11 +1410,10 @@ int Redis::lindex(const char *queue_name, int idx, char *buf, u_int buf_len) {
   int rc;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
-  stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "LINDEX %s %d", queue_name, idx);
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
+  c->stats.num_other++;
+  reply = (redisReply*)command(c, redis_latency_list, "LINDEX %s %d", queue_name, idx);
 
-  if(!reply) reconnectRedis(true);
 
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
@@ -1253,7 +1424,7 @@ int Redis::lindex(const char *queue_name, int idx, char *buf, u_int buf_len) {
     buf[0] = '\0', rc = -1;
 
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
 
   return(rc);
 }
@@ -1265,11 +1436,10 @@ int Redis::lrange(const char *list_name, char ***elements, int start_offset, int
   u_int i;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
-  stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "LRANGE %s %i %i", list_name, start_offset, end_offset);
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
+  c->stats.num_other++;
+  reply = (redisReply*)command(c, redis_latency_list, "LRANGE %s %i %i", list_name, start_offset, end_offset);
 
-  if(!reply) reconnectRedis(true);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
@@ -1283,7 +1453,7 @@ int Redis::lrange(const char *list_name, char ***elements, int start_offset, int
   }
 
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
 
   return(rc);
 }
@@ -1294,16 +1464,15 @@ int Redis::ltrim(const char *queue_name, int start_idx, int end_idx) {
   int rc = 0;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
-  stats.num_other++;
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
+  c->stats.num_other++;
 
-  reply = (redisReply*)redisCommand(redis, "LTRIM %s %d %d", queue_name, start_idx, end_idx);
-  if(!reply) reconnectRedis(true);
+  reply = (redisReply*)command(c, redis_latency_list, "LTRIM %s %d %d", queue_name, start_idx, end_idx);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     rc = -1, ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
 
   return(rc);
 }
@@ -1314,10 +1483,9 @@ int Redis::incr(const char *key, int amount) {
   redisReply *reply;
   int num = 0;
 
-  l->lock(__FILE__, __LINE__);
-  stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "INCRBY %s %d", key, amount);
-  if(!reply) reconnectRedis(true);
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
+  c->stats.num_other++;
+  reply = (redisReply*)command(c, redis_latency_set, "INCRBY %s %d", key, amount);
   if(reply) {
     if(reply->type == REDIS_REPLY_ERROR)
       ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
@@ -1332,7 +1500,7 @@ int Redis::incr(const char *key, int amount) {
       }
     }
   }
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
   if(reply) freeReplyObject(reply);
 
   return(num);
@@ -1341,40 +1509,85 @@ int Redis::incr(const char *key, int amount) {
 /* **************************************** */
 
 void Redis::lua(lua_State *vm) {
+  static const char *latency_class_names[redis_latency_num_classes] = {
+    "get", "set", "del", "hash", "list", "other", "pipeline"
+  };
+  redis_stats_t tot;
+
+  sumStats(&tot);
+
   lua_newtable(vm);
 
-  lua_push_uint64_table_entry(vm, "num_expire", stats.num_expire);
-  lua_push_uint64_table_entry(vm, "num_get", stats.num_get);
-  lua_push_uint64_table_entry(vm, "num_ttl", stats.num_ttl);
-  lua_push_uint64_table_entry(vm, "num_del", stats.num_del);
-  lua_push_uint64_table_entry(vm, "num_hget", stats.num_hget);
-  lua_push_uint64_table_entry(vm, "num_hset", stats.num_hset);
-  lua_push_uint64_table_entry(vm, "num_hdel", stats.num_hdel);
-  lua_push_uint64_table_entry(vm, "num_set", stats.num_set);
-  lua_push_uint64_table_entry(vm, "num_expire", stats.num_expire);
-  lua_push_uint64_table_entry(vm, "num_keys", stats.num_keys);
-  lua_push_uint64_table_entry(vm, "num_hkeys", stats.num_hkeys);
-  lua_push_uint64_table_entry(vm, "num_hgetall", stats.num_hgetall);
-  lua_push_uint64_table_entry(vm, "num_trim", stats.num_trim);
-  lua_push_uint64_table_entry(vm, "num_reconnections", stats.num_reconnections);
-  lua_push_uint64_table_entry(vm, "num_lpush_rpush", stats.num_lpush_rpush);
-  lua_push_uint64_table_entry(vm, "num_lpop_rpop", stats.num_lpop_rpop);
-  lua_push_uint64_table_entry(vm, "num_llen", stats.num_llen);
-  lua_push_uint64_table_entry(vm, "num_strlen", stats.num_strlen);
-  lua_push_uint64_table_entry(vm, "num_other", stats.num_other);
+  lua_push_uint64_table_entry(vm, "num_expire", tot.num_expire);
+  lua_push_uint64_table_entry(vm, "num_get", tot.num_get);
+  lua_push_uint64_table_entry(vm, "num_ttl", tot.num_ttl);
+  lua_push_uint64_table_entry(vm, "num_del", tot.num_del);
+  lua_push_uint64_table_entry(vm, "num_hget", tot.num_hget);
+  lua_push_uint64_table_entry(vm, "num_hset", tot.num_hset);
+  lua_push_uint64_table_entry(vm, "num_hdel", tot.num_hdel);
+  lua_push_uint64_table_entry(vm, "num_set", tot.num_set);
+  lua_push_uint64_table_entry(vm, "num_expire", tot.num_expire);
+  lua_push_uint64_table_entry(vm, "num_keys", tot.num_keys);
+  lua_push_uint64_table_entry(vm, "num_hkeys", tot.num_hkeys);
+  lua_push_uint64_table_entry(vm, "num_hgetall", tot.num_hgetall);
+  lua_push_uint64_table_entry(vm, "num_trim", tot.num_trim);
+  lua_push_uint64_table_entry(vm, "num_reconnections", tot.num_reconnections);
+  lua_push_uint64_table_entry(vm, "num_lpush_rpush", tot.num_lpush_rpush);
+  lua_push_uint64_table_entry(vm, "num_lpop_rpop", tot.num_lpop_rpop);
+  lua_push_uint64_table_entry(vm, "num_llen", tot.num_llen);
+  lua_push_uint64_table_entry(vm, "num_strlen", tot.num_strlen);
+  lua_push_uint64_table_entry(vm, "num_other", tot.num_other);
+  lua_push_uint64_table_entry(vm, "num_pipelines", tot.num_pipelines);
 
   /* Address resolution */
-  lua_push_uint64_table_entry(vm, "num_resolver_saved_lookups", stats.num_saved_lookups);
-  lua_push_uint64_table_entry(vm, "num_resolver_get_address",   stats.num_get_address);
-  lua_push_uint64_table_entry(vm, "num_resolver_set_address",   stats.num_set_resolved_address);  
+  lua_push_uint64_table_entry(vm, "num_resolver_saved_lookups", tot.num_saved_lookups);
+  lua_push_uint64_table_entry(vm, "num_resolver_get_address",   tot.num_get_address);
+  lua_push_uint64_table_entry(vm, "num_resolver_set_address",   tot.num_set_resolved_address);
+
+  /* In-memory cache of the ntopng.cache/prefs/user keys */
+  stringCache->lua(vm);
+
+  /* Connections */
+  lua_push_uint32_table_entry(vm, "num_connections", num_connections);
+  lua_push_uint64_table_entry(vm, "num_locks", tot.num_locks);
+  lua_push_uint64_table_entry(vm, "lock_wait_usec", tot.lock_wait_usec);
+  lua_push_uint64_table_entry(vm, "max_lock_wait_usec", tot.max_lock_wait_usec);
+  lua_push_float_table_entry(vm, "avg_lock_wait_usec",
+			     tot.num_locks ? ((float)tot.lock_wait_usec) / tot.num_locks : 0);
+
+  /* Latency histograms: bucket "N" counts commands faster than N usec */
+  lua_newtable(vm);
+
+  for(u_int i = 0; i < redis_latency_num_classes; i++) {
+    lua_newtable(vm);
+
+    for(u_int j = 0; j < REDIS_LATENCY_BUCKETS; j++) {
+      char bucket[16];
+
+      if(tot.latency[i][j] == 0) continue;
+
+      if(j < REDIS_LATENCY_BUCKETS - 1)
+	snprintf(bucket, sizeof(bucket), "%u", 1 << j);
+      else
+	snprintf(bucket, sizeof(bucket), "inf");
+
+      lua_push_uint64_table_entry(vm, bucket, tot.latency[i][j]);
+    }
+
+    lua_pushstring(vm, latency_class_names[i]);
+    lua_insert(vm, -2);
+    lua_settable(vm, -3);
+  }
+
+  lua_pushstring(vm, "latency_usec");
+  lua_insert(vm, -2);
+  lua_settable(vm, -3);
 }
 
 /* **************************************** */
 
 void Redis::flushCache() {
-  l->lock(__FILE__, __LINE__);
-  stringCache.clear();
-  l->unlock(__FILE__, __LINE__);
+  stringCache->clear();
 
 #ifdef CACHE_DEBUG
   ntop->getTrace()->traceEvent(TRACE_NORMAL, "**** Successfully flushed cache\n");
@@ -1419,10 +1632,9 @@ char* Redis::dump(char *key) {
   char *rsp = NULL;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
-  stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "DUMP %s", key);
-  if(!reply) reconnectRedis(true);
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
+  c->stats.num_other++;
+  reply = (redisReply*)command(c, redis_latency_other, "DUMP %s", key);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
@@ -1433,7 +1645,7 @@ char* Redis::dump(char *key) {
     freeReplyObject(reply);
   }
 
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
 
   return(rsp);
 }
@@ -1452,12 +1664,11 @@ int Redis::restore(char *key, char *buf) {
 
   hex2bin(buf, buf_bin);
 
-  l->lock(__FILE__, __LINE__);
-  stats.num_del++;
+  redis_connection_t *c = lockConnection(__FILE__, __LINE__);
+  c->stats.num_del++;
 
   /* Delete the key first */
-  reply = (redisReply*)redisCommand(redis, "DEL %s", key);
-  if(!reply) reconnectRedis(true);
+  reply = (redisReply*)command(c, redis_latency_del, "DEL %s", key);
 
   if(reply && (reply->type == REDIS_REPLY_ERROR)) {
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
@@ -1469,7 +1680,7 @@ int Redis::restore(char *key, char *buf) {
     argvlen[2] = strlen(argv[2]);
     argvlen[3] = strlen(buf) / 2;
 
-    reply = (redisReply*)redisCommandArgv(redis, 4, argv, argvlen);
+    reply = (redisReply*)commandArgv(c, redis_latency_other, 4, argv, argvlen);
 
     rc = reply ? 0 : -1;
 
@@ -1479,7 +1690,7 @@ int Redis::restore(char *key, char *buf) {
     rc = -1;
 
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  unlockConnection(c, __FILE__, __LINE__);
 
   free(buf_bin);
 
@@ -0,0 +1,369 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#include "ntop_includes.h"
+
+/* ******************************************* */
+
+StringLRUCache::StringLRUCache(u_int32_t _num_shards, u_int32_t max_entries) {
+  u_int32_t num_buckets = 1;
+
+  num_shards = 1;
+  while((num_shards < _num_shards) && (num_shards < 256)) num_shards <<= 1;
+
+  max_shard_entries = max_val(max_entries / num_shards, 1);
+
+  /* Chains stay short as shards never hold more keys than buckets */
+  while(num_buckets < max_shard_entries) num_buckets <<= 1;
+  bucket_mask = num_buckets - 1;
+
+  shards = new (std::nothrow) Shard[num_shards];
+
+  for(u_int32_t i = 0; i < num_shards; i++) {
+    Shard *s = &shards[i];
+
+    s->buckets = (Entry**)calloc(num_buckets, sizeof(Entry*));
+    s->lru_head = s->lru_tail = NULL;
+    memset(s->wheel, 0, sizeof(s->wheel));
+    s->wheel_last = 0;
+    s->num_entries = 0, s->version = 0;
+    s->num_hits = s->num_misses = s->num_evictions = s->num_expirations = s->num_stale_fills = 0;
+  }
+}
+
+/* ******************************************* */
+
+StringLRUCache::~StringLRUCache() {
+  clear();
+
+  for(u_int32_t i = 0; i < num_shards; i++)
+    free(shards[i].buckets);
+
+  delete[] shards;
+}
+
+/* ******************************************* */
+
+/* FNV-1a: the top bits select the shard, the bottom ones the bucket */
+u_int32_t StringLRUCache::hash(const char *key) {
+  u_int32_t h = 2166136261U;
+
+  while(*key)
+    h = (h ^ (u_int8_t)*key++) * 16777619U;
+
+  return(h);
+}
+
+/* ******************************************* */
+
+StringLRUCache::Entry* StringLRUCache::find(Shard *s, const char *key, u_int32_t h) {
+  Entry *e = s->buckets ? s->buckets[h & bucket_mask] : NULL;
+
+  while(e && ((e->hash != h) || strcmp(e->key.c_str(), key)))
+    e = e->hash_next;
+
+  return(e);
+}
+
+/* ******************************************* */
+
+void StringLRUCache::lruUnlink(Shard *s, Entry *e) {
+  if(e->lru_prev) e->lru_prev->lru_next = e->lru_next; else s->lru_head = e->lru_next;
+  if(e->lru_next) e->lru_next->lru_prev = e->lru_prev; else s->lru_tail = e->lru_prev;
+}
+
+/* ******************************************* */
+
+void StringLRUCache::lruPushFront(Shard *s, Entry *e) {
+  e->lru_prev = NULL, e->lru_next = s->lru_head;
+
+  if(s->lru_head) s->lru_head->lru_prev = e; else s->lru_tail = e;
+  s->lru_head = e;
+}
+
+/* ******************************************* */
+
+void StringLRUCache::wheelUnlink(Shard *s, Entry *e) {
+  if(e->expire == 0) return;
+
+  if(e->wheel_prev) e->wheel_prev->wheel_next = e->wheel_next;
+  else s->wheel[e->expire % STRING_LRU_CACHE_WHEEL_SLOTS] = e->wheel_next;
+
+  if(e->wheel_next) e->wheel_next->wheel_prev = e->wheel_prev;
+}
+
+/* ******************************************* */
+
+void StringLRUCache::wheelLink(Shard *s, Entry *e) {
+  Entry **slot;
+
+  if(e->expire == 0) return;
+
+  slot = &s->wheel[e->expire % STRING_LRU_CACHE_WHEEL_SLOTS];
+  e->wheel_prev = NULL, e->wheel_next = *slot;
+  if(*slot) (*slot)->wheel_prev = e;
+  *slot = e;
+}
+
+/* ******************************************* */
+
+void StringLRUCache::remove(Shard *s, Entry *e) {
+  Entry **p = &s->buckets[e->hash & bucket_mask];
+
+  while(*p != e) p = &(*p)->hash_next;
+  *p = e->hash_next;
+
+  lruUnlink(s, e);
+  wheelUnlink(s, e);
+  s->num_entries--;
+
+  delete e;
+}
+
+/* ******************************************* */
+
+/* Visits the wheel slots of the seconds elapsed since the last call: a slot
+   also holds keys expiring in the next laps, those are left in place */
+void StringLRUCache::purgeExpired(Shard *s, time_t now) {
+  time_t t, from;
+
+  if(s->wheel_last == 0) {
+    s->wheel_last = now;
+    return;
+  }
+
+  if(now <= s->wheel_last)
+    return;
+
+  from = max_val(s->wheel_last + 1, now - STRING_LRU_CACHE_WHEEL_SLOTS + 1);
+
+  for(t = from; t <= now; t++) {
+    Entry *e = s->wheel[t % STRING_LRU_CACHE_WHEEL_SLOTS];
+
+    while(e) {
+      Entry *next = e->wheel_next;
+
+      if(e->expire <= now)
+	remove(s, e), s->num_expirations++;
+
+      e = next;
+    }
+  }
+
+  s->wheel_last = now;
+}
+
+/* ******************************************* */
+
+bool StringLRUCache::get(const char *key, char *rsp, u_int rsp_len) {
+  u_int32_t h = hash(key);
+  Shard *s = getShard(h);
+  time_t now = time(NULL);
+  Entry *e;
+  bool found = false;
+
+  s->m.lock(__FILE__, __LINE__);
+
+  purgeExpired(s, now);
+
+  if((e = find(s, key, h)) != NULL) {
+    if(e->expire && (now >= e->expire))
+      remove(s, e), s->num_expirations++;
+    else {
+      if(s->lru_head != e)
+	lruUnlink(s, e), lruPushFront(s, e);
+
+      snprintf(rsp, rsp_len, "%s", e->value.c_str());
+      found = true;
+    }
+  }
+
+  if(found) s->num_hits++; else s->num_misses++;
+
+  s->m.unlock(__FILE__, __LINE__);
+
+  return(found);
+}
+
+/* ******************************************* */
+
+/* Must be called with the shard lock held */
+void StringLRUCache::store(Shard *s, const char *key, u_int32_t h, const char *value, u_int expire_secs) {
+  time_t now = time(NULL);
+  Entry *e;
+
+  purgeExpired(s, now);
+
+  if((e = find(s, key, h)) != NULL) {
+    lruUnlink(s, e);
+    wheelUnlink(s, e);
+  } else {
+    if(s->num_entries >= max_shard_entries)
+      remove(s, s->lru_tail), s->num_evictions++;
+
+    if((e = new (std::nothrow) Entry) == NULL)
+      return;
+
+    e->hash = h, e->key = key;
+    e->hash_next = s->buckets[h & bucket_mask];
+    s->buckets[h & bucket_mask] = e;
+    s->num_entries++;
+  }
+
+  e->value = value ? value : "";
+  e->expire = expire_secs ? now + expire_secs : 0;
+  lruPushFront(s, e);
+  wheelLink(s, e);
+}
+
+/* ******************************************* */
+
+void StringLRUCache::set(const char *key, const char *value, u_int expire_secs) {
+  u_int32_t h = hash(key);
+  Shard *s = getShard(h);
+
+  if(s->buckets == NULL) return;
+
+  s->m.lock(__FILE__, __LINE__);
+  s->version++;
+  store(s, key, h, value, expire_secs);
+  s->m.unlock(__FILE__, __LINE__);
+}
+
+/* ******************************************* */
+
+u_int64_t StringLRUCache::getVersion(const char *key) {
+  Shard *s = getShard(hash(key));
+  u_int64_t version;
+
+  s->m.lock(__FILE__, __LINE__);
+  version = s->version;
+  s->m.unlock(__FILE__, __LINE__);
+
+  return(version);
+}
+
+/* ******************************************* */
+
+bool StringLRUCache::fill(const char *key, const char *value, u_int expire_secs, u_int64_t version) {
+  u_int32_t h = hash(key);
+  Shard *s = getShard(h);
+  bool filled;
+
+  if(s->buckets == NULL) return(false);
+
+  s->m.lock(__FILE__, __LINE__);
+
+  if((filled = (s->version == version)))
+    store(s, key, h, value, expire_secs);
+  else
+    s->num_stale_fills++;
+
+  s->m.unlock(__FILE__, __LINE__);
+
+  return(filled);
+}
+
+/* ******************************************* */
+
+bool StringLRUCache::expire(const char *key, u_int expire_secs) {
+  u_int32_t h = hash(key);
+  Shard *s = getShard(h);
+  Entry *e;
+
+  s->m.lock(__FILE__, __LINE__);
+
+  if((e = find(s, key, h)) != NULL) {
+    wheelUnlink(s, e);
+    e->expire = expire_secs ? time(NULL) + expire_secs : 0;
+    wheelLink(s, e);
+  }
+
+  s->m.unlock(__FILE__, __LINE__);
+
+  return(e != NULL);
+}
+
+/* ******************************************* */
+
+void StringLRUCache::remove(const char *key) {
+  u_int32_t h = hash(key);
+  Shard *s = getShard(h);
+  Entry *e;
+
+  s->m.lock(__FILE__, __LINE__);
+
+  s->version++;
+
+  if((e = find(s, key, h)) != NULL)
+    remove(s, e);
+
+  s->m.unlock(__FILE__, __LINE__);
+}
+
+/* ******************************************* */
+
+void StringLRUCache::clear() {
+  for(u_int32_t i = 0; i < num_shards; i++) {
+    Shard *s = &shards[i];
+
+    s->m.lock(__FILE__, __LINE__);
+
+    s->version++;
+
+    while(s->lru_head)
+      remove(s, s->lru_head);
+
+    s->m.unlock(__FILE__, __LINE__);
+  }
+}
+
+/* ******************************************* */
+
+u_int32_t StringLRUCache::getNumEntries() {
+  u_int32_t num = 0;
+
+  for(u_int32_t i = 0; i < num_shards; i++)
+    num += shards[i].num_entries;
+
+  return(num);
+}
+
+/* ******************************************* */
+
+void StringLRUCache::lua(lua_State *vm) {
+  u_int64_t hits = 0, misses = 0, evictions = 0, expirations = 0, stale_fills = 0;
+
+  for(u_int32_t i = 0; i < num_shards; i++) {
+    hits += shards[i].num_hits, misses += shards[i].num_misses;
+    evictions += shards[i].num_evictions, expirations += shards[i].num_expirations;
+    stale_fills += shards[i].num_stale_fills;
+  }
+
+  lua_push_uint32_table_entry(vm, "num_cache_entries", getNumEntries());
+  lua_push_uint32_table_entry(vm, "max_cache_entries", max_shard_entries * num_shards);
+  lua_push_uint64_table_entry(vm, "num_cache_hits", hits);
+  lua_push_uint64_table_entry(vm, "num_cache_misses", misses);
+  lua_push_uint64_table_entry(vm, "num_cache_evictions", evictions);
+  lua_push_uint64_table_entry(vm, "num_cache_expirations", expirations);
+  lua_push_uint64_table_entry(vm, "num_cache_stale_fills", stale_fills);
+}
@@ -58,6 +58,11 @@ ThreadedActivity::~ThreadedActivity() {
     delete it->second;
   }
 
+  for(std::map<std::string, threaded_activity_vm_t>::iterator it = idle_vms.begin();
+      it != idle_vms.end(); ++it) {
+    delete it->second.vm;
+  }
+
   if(periodic_script) delete periodic_script;
 }
 
@@ -270,6 +275,11 @@ void ThreadedActivity::runScript(time_t now, char *script_name, NetworkInterface
   LuaEngine *l = NULL;
   u_long msec_diff;
   struct timeval begin, end;
+  threaded_activity_vm_t pooled;
+  struct stat st;
+  ticks load_begin;
+  bool reused;
+  int rc;
   ThreadedActivityStats *thstats = getThreadedActivityStats(iface, script_name, true);
 
   if(!iface)
@@ -287,14 +297,27 @@ void ThreadedActivity::runScript(time_t now, char *script_name, NetworkInterface
 
   ntop->getTrace()->traceEvent(TRACE_INFO, "Running %s (iface=%p)", script_name, iface);
 
-  l = loadVM(script_name, iface, now);
-  if(!l) {
-    ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to load the Lua vm [%s][vm: %s][script: %s]",
-				 iface->get_name(), activityPath(),
-				 script_name);
-    return;
+  load_begin = Utils::getticks();
+
+  if(isVMReusable() && getPooledVM(script_name, iface, now, &pooled))
+    l = pooled.vm, reused = true;
+  else {
+    /* Read before loading so that a script changed meanwhile is reloaded next time */
+    pooled.script_mtime = (stat(script_name, &st) == 0) ? st.st_mtime : 0;
+    pooled.created = now;
+    l = pooled.vm = loadVM(script_name, iface, now), reused = false;
+
+    if(!l) {
+      ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to load the Lua vm [%s][vm: %s][script: %s]",
+				   iface->get_name(), activityPath(),
+				   script_name);
+      return;
+    }
   }
 
+  if(thstats)
+    thstats->updateVMStats(reused, Utils::getticks() - load_begin);
+
   /* Set the deadline and the threaded activity in the vm so they can be accessed */
   l->setThreadedActivityData(this, thstats, deadline);
 
@@ -313,7 +336,7 @@ void ThreadedActivity::runScript(time_t now, char *script_name, NetworkInterface
   /* Set the current time globally  */
   lua_pushinteger(l->getState(), now);
   lua_setglobal(l->getState(), "_now");
-  l->run_loaded_script();
+  rc = l->run_loaded_script();
 
   gettimeofday(&end, NULL);
   msec_diff = (end.tv_sec - begin.tv_sec) * 1000 + (end.tv_usec - begin.tv_usec) / 1000;
@@ -322,12 +345,95 @@ void ThreadedActivity::runScript(time_t now, char *script_name, NetworkInterface
   if(thstats && isDeadlineApproaching(deadline))
     thstats->setSlowPeriodicActivity(true);
 
-  if(l)
+  if((rc == 0) && isVMReusable() && !isTerminating())
+    releaseVM(script_name, iface, &pooled);
+  else
     delete l;
 }
 
 /* ******************************************* */
 
+/*
+  Only periodic scripts keep their VM: one-shot scripts (e.g. startup.lua)
+  run once and would just waste memory.
+ */
+bool ThreadedActivity::isVMReusable() {
+  return(getPeriodicity() > 0);
+}
+
+/* ******************************************* */
+
+/*
+  Takes the VM used during the previous run of the script on the interface,
+  if still valid. As the ThreadPool never runs two instances of a script on
+  the same interface, a VM is never used by two threads at the same time.
+ */
+bool ThreadedActivity::getPooledVM(char *script_name, NetworkInterface *iface,
+				   time_t when, threaded_activity_vm_t *pooled) {
+  std::string key = vmKey(script_name, iface);
+  std::map<std::string, threaded_activity_vm_t>::iterator it;
+  struct stat buf;
+
+  m.lock(__FILE__, __LINE__);
+
+  if((it = idle_vms.find(key)) == idle_vms.end()) {
+    m.unlock(__FILE__, __LINE__);
+    return(false);
+  }
+
+  *pooled = it->second;
+  idle_vms.erase(it);
+
+  m.unlock(__FILE__, __LINE__);
+
+  if(((when - pooled->created) >= PERIODIC_SCRIPT_VM_MAX_AGE) /* Periodically start over with a fresh VM */
+     || (stat(script_name, &buf) != 0)
+     || (buf.st_mtime != pooled->script_mtime) /* The script has changed */) {
+    delete pooled->vm;
+    return(false);
+  }
+
+  pooled->vm->reset_script_context(iface);
+
+  return(true);
+}
+
+/* ******************************************* */
+
+/* Keeps the VM that has just run the script for its next run */
+void ThreadedActivity::releaseVM(char *script_name, NetworkInterface *iface, threaded_activity_vm_t *pooled) {
+  std::string key = vmKey(script_name, iface);
+
+  m.lock(__FILE__, __LINE__);
+  idle_vms[key] = *pooled;
+  m.unlock(__FILE__, __LINE__);
+}
+
+/* ******************************************* */
+
+std::string ThreadedActivity::vmKey(char *script_name, NetworkInterface *iface) {
+  return(std::to_string(iface->get_id()) + "/" + std::string(script_name));
+}
+
+/* ******************************************* */
+
+void ThreadedActivity::purgeVMs(NetworkInterface *iface) {
+  std::string prefix = std::to_string(iface->get_id()) + "/";
+  std::map<std::string, threaded_activity_vm_t>::iterator it;
+
+  m.lock(__FILE__, __LINE__);
+
+  for(it = idle_vms.lower_bound(prefix);
+      (it != idle_vms.end()) && (it->first.compare(0, prefix.size(), prefix) == 0); ) {
+    delete it->second.vm;
+    idle_vms.erase(it++);
+  }
+
+  m.unlock(__FILE__, __LINE__);
+}
+
+/* ******************************************* */
+
 LuaEngine* ThreadedActivity::loadVM(char *script_name, NetworkInterface *iface, time_t when) {
   LuaEngine *l = NULL;
 
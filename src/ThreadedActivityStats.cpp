@@ -30,6 +30,7 @@ ThreadedActivityStats::ThreadedActivityStats(const ThreadedActivity *ta) {
   last_start_time = in_progress_since = 0;
   last_queued_time = deadline = scheduled_time = 0;
   last_duration_ms = max_duration_ms = 0;
+  num_vm_created = num_vm_reused = 0, tot_vm_load_ticks = 0;
   threaded_activity = ta;
   num_not_executed = num_is_slow = 0;
   not_executed = is_slow = false;
@@ -97,6 +98,15 @@ void ThreadedActivityStats::updateStatsEnd(u_long duration_ms) {
 
 /* ******************************************* */
 
+void ThreadedActivityStats::updateVMStats(bool reused, ticks load_ticks) {
+  if(reused)
+    num_vm_reused++;
+  else
+    num_vm_created++, tot_vm_load_ticks += load_ticks;
+}
+
+/* ******************************************* */
+
 void ThreadedActivityStats::luaTimeseriesStats(lua_State *vm) {
   threaded_activity_timeseries_stats_t *cur_stats = &ta_stats.timeseries.write;
 
@@ -158,6 +168,23 @@ void ThreadedActivityStats::lua(lua_State *vm) {
 
   luaTimeseriesStats(vm);
 
+  lua_newtable(vm);
+
+  lua_push_uint64_table_entry(vm, "num_created", (u_int64_t)num_vm_created);
+  lua_push_uint64_table_entry(vm, "num_reused", (u_int64_t)num_vm_reused);
+
+  if(num_vm_created > 0) {
+    float avg_load_ms = tot_vm_load_ticks / (float)tickspersec / num_vm_created * 1000;
+
+    lua_push_float_table_entry(vm, "avg_load_ms", avg_load_ms);
+    /* Estimated as each reuse avoids creating a new VM */
+    lua_push_float_table_entry(vm, "time_saved_ms", avg_load_ms * num_vm_reused);
+  }
+
+  lua_pushstring(vm, "vm");
+  lua_insert(vm, -2);
+  lua_settable(vm, -3);
+
   if(in_progress_since)
     lua_push_uint64_table_entry(vm, "in_progress_since", in_progress_since);
 
@@ -0,0 +1,241 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "ntop_includes.h"
+
+/* ******************************************* */
+
+void TimeseriesBlock::BitWriter::write(u_int64_t value, u_int8_t num_bits) {
+  while(num_bits > 0) {
+    u_int8_t n;
+
+    if(free_bits == 0)
+      out->push_back(0), free_bits = 8;
+
+    n = min_val(num_bits, free_bits);
+    /* The n most significant bits still to write */
+    (*out)[out->size() - 1] |= (u_int8_t)(((value >> (num_bits - n)) & ((1 << n) - 1)) << (free_bits - n));
+    num_bits -= n, free_bits -= n;
+  }
+}
+
+/* ******************************************* */
+
+bool TimeseriesBlock::BitReader::read(u_int8_t num_bits, u_int64_t *value) {
+  u_int64_t v = 0;
+
+  if((u_int64_t)bit_offset + num_bits > (u_int64_t)data_len * 8)
+    return(false);
+
+  while(num_bits > 0) {
+    u_int8_t avail = 8 - (bit_offset & 7);
+    u_int8_t n = min_val(num_bits, avail);
+    u_int8_t bits = (data[bit_offset >> 3] >> (avail - n)) & ((1 << n) - 1);
+
+    v = (v << n) | bits;
+    num_bits -= n, bit_offset += n;
+  }
+
+  *value = v;
+  return(true);
+}
+
+/* ******************************************* */
+
+static inline u_int64_t doubleToBits(double d) {
+  u_int64_t u;
+
+  memcpy(&u, &d, sizeof(u));
+  return(u);
+}
+
+static inline double bitsToDouble(u_int64_t u) {
+  double d;
+
+  memcpy(&d, &u, sizeof(d));
+  return(d);
+}
+
+/* ******************************************* */
+
+void TimeseriesBlock::encodeValues(BitWriter *w, const double *values, u_int16_t num_points, u_int8_t stride) {
+  u_int64_t prev = doubleToBits(values[0]);
+  u_int8_t prev_leading = 0xFF, prev_trailing = 0;
+
+  w->write(prev, 64);
+
+  for(u_int16_t i = 1; i < num_points; i++) {
+    u_int64_t cur = doubleToBits(values[i * stride]);
+    u_int64_t x = cur ^ prev;
+
+    prev = cur;
+
+    if(x == 0) {
+      w->write(0, 1); /* Same value */
+      continue;
+    }
+
+    u_int8_t leading = min_val(__builtin_clzll(x), 31), trailing = __builtin_ctzll(x);
+
+    if((prev_leading != 0xFF) && (leading >= prev_leading) && (trailing >= prev_trailing)) {
+      /* The meaningful bits fit the window of the previous value */
+      w->write(2, 2);
+      w->write(x >> prev_trailing, 64 - prev_leading - prev_trailing);
+    } else {
+      u_int8_t meaningful = 64 - leading - trailing;
+
+      w->write(3, 2);
+      w->write(leading, 5);
+      w->write(meaningful - 1, 6);
+      w->write(x >> trailing, meaningful);
+      prev_leading = leading, prev_trailing = trailing;
+    }
+  }
+}
+
+/* ******************************************* */
+
+bool TimeseriesBlock::decodeValues(BitReader *r, double *values, u_int16_t num_points, u_int8_t stride) {
+  u_int64_t prev, bit, v;
+  u_int8_t prev_leading = 0, prev_trailing = 0;
+
+  if(!r->read(64, &prev)) return(false);
+  values[0] = bitsToDouble(prev);
+
+  for(u_int16_t i = 1; i < num_points; i++) {
+    if(!r->read(1, &bit)) return(false);
+
+    if(bit) {
+      u_int8_t meaningful;
+
+      if(!r->read(1, &bit)) return(false);
+
+      if(bit) {
+	u_int64_t leading, len;
+
+	if(!r->read(5, &leading) || !r->read(6, &len)) return(false);
+	prev_leading = (u_int8_t)leading, meaningful = (u_int8_t)len + 1;
+	prev_trailing = 64 - prev_leading - meaningful;
+      } else
+	meaningful = 64 - prev_leading - prev_trailing;
+
+      if(!r->read(meaningful, &v)) return(false);
+      prev ^= (v << prev_trailing);
+    }
+
+    values[i * stride] = bitsToDouble(prev);
+  }
+
+  return(true);
+}
+
+/* ******************************************* */
+
+void TimeseriesBlock::encode(const u_int32_t *timestamps, const double *values,
+			     u_int16_t num_points, u_int8_t num_metrics, std::string *out) {
+  BitWriter w(out);
+  int64_t prev_delta = 0;
+
+  if(num_points == 0) return;
+
+  w.write(timestamps[0], 32);
+
+  for(u_int16_t i = 1; i < num_points; i++) {
+    int64_t delta = (int64_t)timestamps[i] - timestamps[i - 1];
+    int64_t dod = delta - prev_delta;
+
+    prev_delta = delta;
+
+    /* Regular steps take a single bit */
+    if(dod == 0)
+      w.write(0, 1);
+    else if((dod >= -64) && (dod < 64))
+      w.write(2, 2), w.write((u_int64_t)dod, 7);
+    else if((dod >= -256) && (dod < 256))
+      w.write(6, 3), w.write((u_int64_t)dod, 9);
+    else if((dod >= -2048) && (dod < 2048))
+      w.write(14, 4), w.write((u_int64_t)dod, 12);
+    else
+      w.write(15, 4), w.write((u_int64_t)dod, 32);
+  }
+
+  for(u_int8_t m = 0; m < num_metrics; m++)
+    encodeValues(&w, &values[m], num_points, num_metrics);
+}
+
+/* ******************************************* */
+
+static inline int64_t signExtend(u_int64_t v, u_int8_t num_bits) {
+  u_int64_t sign = (u_int64_t)1 << (num_bits - 1);
+
+  return((int64_t)((v ^ sign) - sign));
+}
+
+bool TimeseriesBlock::decode(const u_int8_t *data, u_int32_t data_len,
+			     u_int16_t num_points, u_int8_t num_metrics,
+			     u_int32_t *timestamps, double *values) {
+  BitReader r(data, data_len);
+  int64_t prev_delta = 0;
+  u_int64_t v;
+
+  if(num_points == 0) return(true);
+
+  if(!r.read(32, &v)) return(false);
+  timestamps[0] = (u_int32_t)v;
+
+  for(u_int16_t i = 1; i < num_points; i++) {
+    u_int8_t prefix_bits = 0, num_bits;
+    int64_t dod;
+
+    /* Up to four 1s select the width of the delta-of-delta */
+    while(prefix_bits < 4) {
+      if(!r.read(1, &v)) return(false);
+      if(!v) break;
+      prefix_bits++;
+    }
+
+    switch(prefix_bits) {
+    case 0:  num_bits = 0;  break;
+    case 1:  num_bits = 7;  break;
+    case 2:  num_bits = 9;  break;
+    case 3:  num_bits = 12; break;
+    default: num_bits = 32; break;
+    }
+
+    if(num_bits == 0)
+      dod = 0;
+    else {
+      if(!r.read(num_bits, &v)) return(false);
+      dod = signExtend(v, num_bits);
+    }
+
+    prev_delta += dod;
+    timestamps[i] = (u_int32_t)(timestamps[i - 1] + prev_delta);
+  }
+
+  for(u_int8_t m = 0; m < num_metrics; m++)
+    if(!decodeValues(&r, &values[m], num_points, num_metrics))
+      return(false);
+
+  return(true);
+}
+
+/* ******************************************* */
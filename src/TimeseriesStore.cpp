@@ -0,0 +1,1155 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "ntop_includes.h"
+
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+
+/* ******************************************* */
+
+TimeseriesStore::TimeseriesStore(const char *working_dir) {
+  base_dir = std::string(working_dir) + "/tsdb";
+  last_flush = time(NULL);
+  num_index_uses = 0;
+
+  num_points = num_rejected = num_blocks = num_written_points = num_bytes = num_raw_bytes = 0;
+  num_write_errors = num_queries = query_usec = 0;
+}
+
+/* ******************************************* */
+
+TimeseriesStore::~TimeseriesStore() {
+  flush(true);
+}
+
+/* ******************************************* */
+
+/* Schema names become directory names */
+bool TimeseriesStore::validSchema(const char *schema) {
+  return((schema[0] != '\0') && (schema[0] != '.') && (strchr(schema, '/') == NULL));
+}
+
+/* ******************************************* */
+
+std::string TimeseriesStore::schemaPath(const std::string &schema) const {
+  return(base_dir + "/" + schema);
+}
+
+/* ******************************************* */
+
+std::string TimeseriesStore::segmentPath(const std::string &schema, u_int32_t window) const {
+  char name[32];
+
+  snprintf(name, sizeof(name), "/%u.tsb", window);
+
+  return(schemaPath(schema) + name);
+}
+
+/* ******************************************* */
+
+void TimeseriesStore::listSegments(const std::string &schema, std::vector<u_int32_t> *windows) const {
+  DIR *dir;
+  struct dirent *entry;
+
+  if((dir = opendir(schemaPath(schema).c_str())) == NULL)
+    return;
+
+  while((entry = readdir(dir)) != NULL) {
+    u_int32_t window;
+    char ext[8];
+
+    if((sscanf(entry->d_name, "%u.%7s", &window, ext) == 2) && !strcmp(ext, "tsb"))
+      windows->push_back(window);
+  }
+
+  closedir(dir);
+
+  std::sort(windows->begin(), windows->end());
+}
+
+/* ******************************************* */
+
+void TimeseriesStore::listSchemas(std::set<std::string> *schemas) const {
+  DIR *dir;
+  struct dirent *entry;
+
+  for(std::map<std::string, ts_heads_t>::const_iterator it = heads.begin(); it != heads.end(); ++it)
+    schemas->insert(it->first);
+
+  if((dir = opendir(base_dir.c_str())) == NULL)
+    return;
+
+  while((entry = readdir(dir)) != NULL) {
+    if(validSchema(entry->d_name))
+      schemas->insert(entry->d_name);
+  }
+
+  closedir(dir);
+}
+
+/* ******************************************* */
+
+bool TimeseriesStore::mapSegment(const std::string &path, u_int8_t **addr, size_t *len, ino_t *ino) const {
+  bool rv;
+  int fd;
+
+  if((fd = open(path.c_str(), O_RDONLY)) < 0)
+    return(false);
+
+  rv = mapSegmentFd(fd, path, addr, len, ino);
+  close(fd);
+
+  return(rv);
+}
+
+/* ******************************************* */
+
+/* Maps the segment opened as fd, which is left open */
+bool TimeseriesStore::mapSegmentFd(int fd, const std::string &path, u_int8_t **addr, size_t *len, ino_t *ino) const {
+  struct stat st;
+  void *m;
+
+  if((fstat(fd, &st) != 0) || (st.st_size == 0))
+    return(false);
+
+  m = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+  if(m == MAP_FAILED) {
+    ntop->getTrace()->traceEvent(TRACE_WARNING, "Unable to map %s [%s]", path.c_str(), strerror(errno));
+    return(false);
+  }
+
+  /* Blocks are mostly scanned in order */
+  madvise(m, st.st_size, MADV_SEQUENTIAL);
+
+  *addr = (u_int8_t*)m, *len = st.st_size;
+  if(ino) *ino = st.st_ino;
+
+  return(true);
+}
+
+/* ******************************************* */
+
+/* false at the end of the segment, or at a block truncated by a crash */
+bool TimeseriesStore::readBlock(const u_int8_t *addr, size_t len, size_t *offset,
+				ts_block_header_t *hdr, const u_int8_t **key, const u_int8_t **data) {
+  size_t off = *offset;
+
+  if(off + sizeof(*hdr) > len)
+    return(false);
+
+  /* Blocks are not aligned */
+  memcpy(hdr, &addr[off], sizeof(*hdr));
+
+  if((hdr->magic != TSDB_BLOCK_MAGIC)
+     || (off + sizeof(*hdr) + hdr->key_len + hdr->data_len > len))
+    return(false);
+
+  *key = &addr[off + sizeof(*hdr)], *data = *key + hdr->key_len;
+  *offset = off + sizeof(*hdr) + hdr->key_len + hdr->data_len;
+
+  return(true);
+}
+
+/* ******************************************* */
+
+/* Keys are <tag>=<value>[,<tag>=<value>...] */
+bool TimeseriesStore::matchesKey(const u_int8_t *key, u_int16_t key_len, const std::vector<std::string> &filters) {
+  std::string k((const char*)key, key_len);
+
+  for(std::vector<std::string>::const_iterator f = filters.begin(); f != filters.end(); ++f) {
+    size_t pos = 0;
+    bool found = false;
+
+    while((pos = k.find(*f, pos)) != std::string::npos) {
+      size_t end = pos + f->size();
+
+      if(((pos == 0) || (k[pos - 1] == ',')) && ((end == k.size()) || (k[end] == ','))) {
+	found = true;
+	break;
+      }
+
+      pos = end;
+    }
+
+    if(!found)
+      return(false);
+  }
+
+  return(true);
+}
+
+/* ******************************************* */
+
+/* The series of selected_key if set, otherwise the series matching the filters */
+bool TimeseriesStore::selectsKey(const u_int8_t *key, u_int16_t key_len,
+				 const std::string *selected_key, const std::vector<std::string> *filters) {
+  if(selected_key)
+    return((key_len == selected_key->size()) && !memcmp(key, selected_key->data(), key_len));
+
+  return(matchesKey(key, key_len, *filters));
+}
+
+/* ******************************************* */
+
+/* Copies to kept the blocks not matching the filters. Returns true if some blocks have been dropped */
+bool TimeseriesStore::dropBlocks(const u_int8_t *addr, size_t len, const std::vector<std::string> &filters, std::string *kept) {
+  size_t offset = 0, block_offset = 0;
+  ts_block_header_t hdr;
+  const u_int8_t *key, *data;
+  bool dropped = false;
+
+  while(readBlock(addr, len, &offset, &hdr, &key, &data)) {
+    if(matchesKey(key, hdr.key_len, filters))
+      dropped = true;
+    else
+      kept->append((const char*)&addr[block_offset], offset - block_offset);
+
+    block_offset = offset;
+  }
+
+  return(dropped);
+}
+
+/* ******************************************* */
+
+/*
+  Must be called with indexes_lock held. Indexes the blocks of the segment
+  mapped at addr that have been appended since the last call. The index is
+  rebuilt when the file is not the one indexed: queries map the segments
+  with no lock held, and can still read the file replaced by a rewrite.
+*/
+TimeseriesStore::ts_segment_index_t* TimeseriesStore::indexSegment(const std::string &path, const u_int8_t *addr, size_t len,
+								   ino_t ino) {
+  std::map<std::string, ts_segment_index_t>::iterator it = indexes.find(path);
+  ts_segment_index_t *idx;
+  ts_block_header_t hdr;
+  const u_int8_t *key, *data;
+  size_t offset;
+
+  if(it == indexes.end()) {
+    /* Bounded memory: evict the least recently used index */
+    if(indexes.size() >= TSDB_MAX_INDEXED_SEGMENTS) {
+      std::map<std::string, ts_segment_index_t>::iterator lru = indexes.begin();
+
+      for(std::map<std::string, ts_segment_index_t>::iterator i = indexes.begin(); i != indexes.end(); ++i) {
+	if(i->second.last_use < lru->second.last_use)
+	  lru = i;
+      }
+
+      indexes.erase(lru);
+    }
+
+    idx = &indexes[path];
+    idx->ino = ino, idx->len = 0;
+  } else
+    idx = &it->second;
+
+  if(idx->ino != ino)
+    idx->ino = ino, idx->len = 0, idx->keys.clear();
+
+  idx->last_use = ++num_index_uses;
+
+  /* Stops at the end of the mapping, or at a block still being written */
+  for(offset = idx->len; readBlock(addr, len, &offset, &hdr, &key, &data); idx->len = offset) {
+    ts_key_blocks_t *blocks = &idx->keys[std::string((const char*)key, hdr.key_len)];
+
+    blocks->offsets.push_back(idx->len);
+    blocks->t_max = max_val(blocks->t_max, hdr.t_max);
+  }
+
+  return(idx);
+}
+
+/* ******************************************* */
+
+/*
+  Appends to offsets the blocks, in the segment order, of the series of key
+  (or, if NULL, of the series matching filters) with points since from
+*/
+void TimeseriesStore::findBlocks(const std::string &path, const u_int8_t *addr, size_t len, ino_t ino,
+				 const std::string *key, const std::vector<std::string> *filters,
+				 u_int32_t from, std::vector<size_t> *offsets) {
+  ts_segment_index_t *idx;
+
+  indexes_lock.lock(__FILE__, __LINE__);
+
+  idx = indexSegment(path, addr, len, ino);
+
+  if(key) {
+    std::map<std::string, ts_key_blocks_t>::const_iterator it = idx->keys.find(*key);
+
+    if((it != idx->keys.end()) && (it->second.t_max >= from))
+      offsets->insert(offsets->end(), it->second.offsets.begin(), it->second.offsets.end());
+  } else {
+    for(std::map<std::string, ts_key_blocks_t>::const_iterator it = idx->keys.begin(); it != idx->keys.end(); ++it) {
+      if((it->second.t_max >= from)
+	 && matchesKey((const u_int8_t*)it->first.data(), it->first.size(), *filters))
+	offsets->insert(offsets->end(), it->second.offsets.begin(), it->second.offsets.end());
+    }
+  }
+
+  indexes_lock.unlock(__FILE__, __LINE__);
+
+  if(!key)
+    std::sort(offsets->begin(), offsets->end());
+}
+
+/* ******************************************* */
+
+/*
+  Forgets the indexes of the segment at path, rewritten, truncated or
+  deleted, or of all the segments under the directory path
+*/
+void TimeseriesStore::dropIndexes(const std::string &path) {
+  indexes_lock.lock(__FILE__, __LINE__);
+
+  for(std::map<std::string, ts_segment_index_t>::iterator it = indexes.begin(); it != indexes.end(); ) {
+    /* Only up to a separator: schema "a" must not match the segments of schema "ab" */
+    if((it->first.compare(0, path.size(), path) == 0)
+       && ((it->first.size() == path.size()) || (it->first[path.size()] == '/')))
+      indexes.erase(it++);
+    else
+      ++it;
+  }
+
+  indexes_lock.unlock(__FILE__, __LINE__);
+}
+
+/* ******************************************* */
+
+void TimeseriesStore::sealHead(const std::string &key, ts_head_t *head, std::string *buf) {
+  ts_block_header_t hdr;
+  std::string data;
+  u_int16_t n = head->timestamps.size();
+
+  TimeseriesBlock::encode(&head->timestamps[0], &head->values[0], n, head->num_metrics, &data);
+
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.magic = TSDB_BLOCK_MAGIC;
+  hdr.t_min = head->timestamps[0], hdr.t_max = head->timestamps[n - 1];
+  hdr.data_len = data.size(), hdr.num_points = n, hdr.key_len = key.size();
+  hdr.num_metrics = head->num_metrics;
+
+  buf->append((const char*)&hdr, sizeof(hdr));
+  buf->append(key);
+  buf->append(data);
+
+  num_blocks++, num_written_points += n, num_bytes += sizeof(hdr) + key.size() + data.size();
+  num_raw_bytes += n * (sizeof(u_int32_t) + head->num_metrics * sizeof(double));
+
+  head->timestamps.clear(), head->values.clear();
+}
+
+/* ******************************************* */
+
+/* Must be called with the lock held in write. The blocks of buf are moved to the pending writes */
+void TimeseriesStore::queueWrite(const std::string &schema, u_int32_t window, std::string *buf) {
+  pending.push_back(ts_pending_write_t());
+  pending.back().schema = schema, pending.back().window = window;
+  pending.back().buf.swap(*buf);
+}
+
+/* ******************************************* */
+
+/* Writes the pending blocks. Must be called with the lock released */
+void TimeseriesStore::writePending() {
+  write_lock.lock(__FILE__, __LINE__);
+  writePendingLocked();
+  write_lock.unlock(__FILE__, __LINE__);
+}
+
+/* ******************************************* */
+
+/*
+  Must be called with write_lock held. The blocks are written in the order
+  they have been sealed, with the lock released: until removed from the
+  pending writes, queries also read them from memory.
+*/
+void TimeseriesStore::writePendingLocked() {
+  std::vector<const ts_pending_write_t*> writes;
+
+  lock.rdlock(__FILE__, __LINE__);
+
+  /* List elements don't move: the ones queued meanwhile are written by their sealer */
+  for(std::list<ts_pending_write_t>::const_iterator it = pending.begin(); it != pending.end(); ++it)
+    writes.push_back(&*it);
+
+  lock.unlock(__FILE__, __LINE__);
+
+  if(writes.empty())
+    return;
+
+  for(std::vector<const ts_pending_write_t*>::const_iterator it = writes.begin(); it != writes.end(); ++it) {
+    if(!(*it)->buf.empty()) /* Emptied by deleteSeries() */
+      writeSegment((*it)->schema, (*it)->window, (*it)->buf);
+  }
+
+  /* Only removed here, under write_lock: the writes are still the oldest ones */
+  lock.wrlock(__FILE__, __LINE__);
+
+  for(size_t i = 0; i < writes.size(); i++)
+    pending.pop_front();
+
+  lock.unlock(__FILE__, __LINE__);
+}
+
+/* ******************************************* */
+
+/* A crash can leave a half written block: new blocks go after the last valid one. Must be called with write_lock held */
+void TimeseriesStore::checkSegmentTail(const std::string &path) {
+  u_int8_t *addr;
+  size_t len, offset = 0;
+  ts_block_header_t hdr;
+  const u_int8_t *key, *data;
+
+  if(!checked_segments.insert(path).second)
+    return;
+
+  if(!mapSegment(path, &addr, &len))
+    return;
+
+  while(readBlock(addr, len, &offset, &hdr, &key, &data))
+    ;
+
+  munmap(addr, len);
+
+  if(offset < len) {
+    ntop->getTrace()->traceEvent(TRACE_WARNING, "Truncating %s to its last valid block [%lu/%lu bytes]",
+				 path.c_str(), (unsigned long)offset, (unsigned long)len);
+
+    if(truncate(path.c_str(), offset) != 0)
+      ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to truncate %s [%s]", path.c_str(), strerror(errno));
+
+    dropIndexes(path);
+  }
+}
+
+/* ******************************************* */
+
+/* Must be called with write_lock held */
+bool TimeseriesStore::writeSegment(const std::string &schema, u_int32_t window, const std::string &buf) {
+  std::string path = segmentPath(schema, window);
+  const char *p = buf.data();
+  size_t len = buf.size();
+  int fd;
+
+  if(!Utils::dir_exists(schemaPath(schema).c_str())) {
+    char dir[MAX_PATH];
+
+    snprintf(dir, sizeof(dir), "%s", schemaPath(schema).c_str());
+    Utils::mkdir_tree(dir);
+  }
+
+  checkSegmentTail(path);
+
+  if((fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644)) < 0) {
+    ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to open %s [%s]", path.c_str(), strerror(errno));
+    num_write_errors++;
+    return(false);
+  }
+
+  /* All the blocks of the schema and window in a single append */
+  while(len > 0) {
+    ssize_t rc = write(fd, p, len);
+
+    if(rc < 0) {
+      if(errno == EINTR) continue;
+
+      ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to write %s [%s]", path.c_str(), strerror(errno));
+      num_write_errors++;
+      close(fd);
+      return(false);
+    }
+
+    p += rc, len -= rc;
+  }
+
+  close(fd);
+  return(true);
+}
+
+/* ******************************************* */
+
+bool TimeseriesStore::append(const char *schema, const char *key, u_int32_t timestamp,
+			     const double *values, u_int8_t num_metrics) {
+  u_int32_t window = timestamp - (timestamp % TSDB_SEGMENT_DURATION);
+  size_t key_len = strlen(key);
+  ts_head_t *head;
+  bool sealed = false;
+
+  if((num_metrics == 0) || (key_len == 0) || (key_len > 0xFFFF) || !validSchema(schema))
+    return(false);
+
+  lock.wrlock(__FILE__, __LINE__);
+
+  head = &heads[schema][key];
+
+  if(timestamp <= head->last_timestamp) {
+    num_rejected++;
+    lock.unlock(__FILE__, __LINE__);
+    return(false);
+  }
+
+  /* A block belongs to a single segment */
+  if(!head->timestamps.empty() && ((head->window != window) || (head->num_metrics != num_metrics))) {
+    std::string buf;
+
+    sealHead(key, head, &buf);
+    queueWrite(schema, head->window, &buf);
+    sealed = true;
+  }
+
+  if(head->timestamps.empty())
+    head->window = window, head->num_metrics = num_metrics;
+
+  head->timestamps.push_back(timestamp);
+  head->values.insert(head->values.end(), values, values + num_metrics);
+  head->last_timestamp = timestamp;
+  num_points++;
+
+  if(head->timestamps.size() >= TSDB_HEAD_BLOCK_POINTS) {
+    std::string buf;
+
+    sealHead(key, head, &buf);
+    queueWrite(schema, head->window, &buf);
+    sealed = true;
+  }
+
+  lock.unlock(__FILE__, __LINE__);
+
+  if(sealed)
+    writePending();
+
+  return(true);
+}
+
+/* ******************************************* */
+
+/* Must be called with the lock held in write */
+void TimeseriesStore::flushSchema(const std::string &schema, ts_heads_t *schema_heads, time_t now, bool force) {
+  std::map<u_int32_t, std::string> bufs; /* By window */
+
+  for(ts_heads_t::iterator it = schema_heads->begin(); it != schema_heads->end(); ) {
+    ts_head_t *head = &it->second;
+
+    if(!head->timestamps.empty()) {
+      if(force || ((time_t)head->timestamps[0] + TSDB_HEAD_BLOCK_MAX_AGE <= now))
+	sealHead(it->first, head, &bufs[head->window]);
+
+      ++it;
+    } else if((time_t)head->last_timestamp + 2 * TSDB_HEAD_BLOCK_MAX_AGE <= now)
+      schema_heads->erase(it++); /* Idle series */
+    else
+      ++it;
+  }
+
+  for(std::map<u_int32_t, std::string>::iterator it = bufs.begin(); it != bufs.end(); ++it)
+    queueWrite(schema, it->first, &it->second);
+}
+
+/* ******************************************* */
+
+void TimeseriesStore::flush(bool force) {
+  time_t now = time(NULL);
+
+  if(!force && (now < last_flush + TSDB_FLUSH_INTERVAL))
+    return;
+
+  lock.wrlock(__FILE__, __LINE__);
+
+  last_flush = now;
+
+  for(std::map<std::string, ts_heads_t>::iterator it = heads.begin(); it != heads.end(); ++it)
+    flushSchema(it->first, &it->second, now, force);
+
+  lock.unlock(__FILE__, __LINE__);
+
+  writePending();
+}
+
+/* ******************************************* */
+
+/* Appends the points in [from, to] newer than the last one of the series */
+void TimeseriesStore::addPoints(ts_points_t *points, const u_int32_t *timestamps, const double *values,
+				u_int32_t num_points, u_int8_t num_metrics, u_int32_t from, u_int32_t to) {
+  if(points->num_metrics && (points->num_metrics != num_metrics))
+    return;
+
+  points->num_metrics = num_metrics;
+
+  for(u_int32_t i = 0; i < num_points; i++) {
+    /* Points older than the last one were rejected, unless written before a restart */
+    if((timestamps[i] < from) || (timestamps[i] > to)
+       || (!points->timestamps.empty() && (timestamps[i] <= points->timestamps.back())))
+      continue;
+
+    points->timestamps.push_back(timestamps[i]);
+    points->values.insert(points->values.end(), &values[i * num_metrics], &values[(i + 1) * num_metrics]);
+  }
+}
+
+/* ******************************************* */
+
+/*
+  Must be called with the lock held. Takes what the query of the series of
+  key (or, if NULL, of the series matching filters) needs to read with the
+  lock released: the segments of [from, to] are opened, the pending blocks
+  and the points in memory of the series are copied.
+*/
+void TimeseriesStore::snapshotQuery(const std::string &schema, const std::string *key,
+				    const std::vector<std::string> *filters,
+				    u_int32_t from, u_int32_t to, ts_query_snapshot_t *snapshot) {
+  std::map<std::string, ts_heads_t>::const_iterator s;
+  ts_block_header_t hdr;
+  const u_int8_t *k, *data;
+
+  for(u_int32_t window = from - (from % TSDB_SEGMENT_DURATION); window <= to; window += TSDB_SEGMENT_DURATION) {
+    std::string path = segmentPath(schema, window);
+    int fd;
+
+    if((fd = open(path.c_str(), O_RDONLY)) >= 0)
+      snapshot->paths.push_back(path), snapshot->fds.push_back(fd);
+
+    if(window > to - TSDB_SEGMENT_DURATION) break; /* Avoid the wrap around */
+  }
+
+  for(std::list<ts_pending_write_t>::const_iterator p = pending.begin(); p != pending.end(); ++p) {
+    const u_int8_t *addr = (const u_int8_t*)p->buf.data();
+    size_t begin = 0, offset = 0;
+
+    if(p->schema != schema)
+      continue;
+
+    for(; readBlock(addr, p->buf.size(), &offset, &hdr, &k, &data); begin = offset) {
+      if((hdr.t_max >= from) && (hdr.t_min <= to) && selectsKey(k, hdr.key_len, key, filters))
+	snapshot->pending.append((const char*)&addr[begin], offset - begin);
+    }
+  }
+
+  if((s = heads.find(schema)) != heads.end()) {
+    for(ts_heads_t::const_iterator h = key ? s->second.find(*key) : s->second.begin(); h != s->second.end(); ++h) {
+      const ts_head_t *head = &h->second;
+
+      if(!head->timestamps.empty()
+	 && (key || matchesKey((const u_int8_t*)h->first.data(), h->first.size(), *filters)))
+	addPoints(&snapshot->heads[h->first], &head->timestamps[0], &head->values[0],
+		  head->timestamps.size(), head->num_metrics, from, to);
+
+      if(key) break;
+    }
+  }
+}
+
+/* ******************************************* */
+
+/*
+  Must be called with the lock released. Collects the points in [from, to]
+  of the series of the snapshot: written, pending write and in memory, in
+  this order as they get newer. The segments of the snapshot are closed.
+*/
+void TimeseriesStore::collectPoints(const std::string *key, const std::vector<std::string> *filters,
+				    u_int32_t from, u_int32_t to, ts_query_snapshot_t *snapshot,
+				    ts_series_points_t *series) {
+  std::vector<u_int32_t> block_ts;
+  std::vector<double> block_values;
+  std::vector<size_t> offsets;
+  ts_block_header_t hdr;
+  const u_int8_t *k, *data;
+  const u_int8_t *pending_addr = (const u_int8_t*)snapshot->pending.data();
+  size_t pending_offset = 0;
+
+  for(size_t i = 0; i < snapshot->fds.size(); i++) {
+    const std::string &path = snapshot->paths[i];
+    u_int8_t *addr;
+    size_t len;
+    ino_t ino;
+    bool mapped = mapSegmentFd(snapshot->fds[i], path, &addr, &len, &ino);
+
+    close(snapshot->fds[i]);
+
+    if(!mapped)
+      continue;
+
+    offsets.clear();
+    findBlocks(path, addr, len, ino, key, filters, from, &offsets);
+
+    for(std::vector<size_t>::const_iterator o = offsets.begin(); o != offsets.end(); ++o) {
+      size_t offset = *o;
+
+      if(!readBlock(addr, len, &offset, &hdr, &k, &data)
+	 || (hdr.t_max < from) || (hdr.t_min > to))
+	continue;
+
+      block_ts.resize(hdr.num_points), block_values.resize(hdr.num_points * hdr.num_metrics);
+
+      if(TimeseriesBlock::decode(data, hdr.data_len, hdr.num_points, hdr.num_metrics,
+				 &block_ts[0], &block_values[0]))
+	addPoints(&(*series)[std::string((const char*)k, hdr.key_len)], &block_ts[0], &block_values[0],
+		  hdr.num_points, hdr.num_metrics, from, to);
+    }
+
+    munmap(addr, len);
+  }
+
+  snapshot->paths.clear(), snapshot->fds.clear();
+
+  /* Blocks written meanwhile are found twice: their points are no longer newer */
+  while(readBlock(pending_addr, snapshot->pending.size(), &pending_offset, &hdr, &k, &data)) {
+    block_ts.resize(hdr.num_points), block_values.resize(hdr.num_points * hdr.num_metrics);
+
+    if(TimeseriesBlock::decode(data, hdr.data_len, hdr.num_points, hdr.num_metrics,
+			       &block_ts[0], &block_values[0]))
+      addPoints(&(*series)[std::string((const char*)k, hdr.key_len)], &block_ts[0], &block_values[0],
+		hdr.num_points, hdr.num_metrics, from, to);
+  }
+
+  for(ts_series_points_t::const_iterator h = snapshot->heads.begin(); h != snapshot->heads.end(); ++h) {
+    if(!h->second.timestamps.empty())
+      addPoints(&(*series)[h->first], &h->second.timestamps[0], &h->second.values[0],
+		h->second.timestamps.size(), h->second.num_metrics, from, to);
+  }
+}
+
+/* ******************************************* */
+
+/* Pushes a table with the values of each metric, consolidated in count steps from start */
+void TimeseriesStore::pushConsolidated(lua_State *vm, const ts_points_t *points, u_int32_t start, u_int32_t step,
+				       u_int32_t count, TsConsolidation cf, bool is_counter) {
+  const std::vector<u_int32_t> &timestamps = points->timestamps;
+  const std::vector<double> &values = points->values;
+  u_int8_t num_metrics = points->num_metrics;
+  std::vector<double> acc;
+  std::vector<u_int32_t> num_acc;
+
+  acc.assign((size_t)count * num_metrics, 0), num_acc.assign((size_t)count * num_metrics, 0);
+
+  for(size_t i = 0; i < timestamps.size(); i++) {
+    u_int32_t bucket;
+
+    if((timestamps[i] < start) || (is_counter && (i == 0)))
+      continue;
+
+    bucket = (timestamps[i] - start) / step;
+
+    for(u_int8_t m = 0; m < num_metrics; m++) {
+      size_t idx = (size_t)bucket * num_metrics + m;
+      double v = values[i * num_metrics + m];
+
+      if(is_counter) {
+	double prev = values[(i - 1) * num_metrics + m];
+
+	if(v < prev) continue; /* Counter reset */
+	v = (v - prev) / (timestamps[i] - timestamps[i - 1]);
+      }
+
+      switch(cf) {
+      case ts_cf_min:
+	if(!num_acc[idx] || (v < acc[idx])) acc[idx] = v;
+	break;
+      case ts_cf_max:
+	if(!num_acc[idx] || (v > acc[idx])) acc[idx] = v;
+	break;
+      case ts_cf_last:
+	acc[idx] = v;
+	break;
+      default:
+	acc[idx] += v;
+	break;
+      }
+
+      num_acc[idx]++;
+    }
+  }
+
+  lua_createtable(vm, num_metrics, 0);
+
+  for(u_int8_t m = 0; m < num_metrics; m++) {
+    lua_createtable(vm, count, 0);
+
+    for(u_int32_t b = 0; b < count; b++) {
+      size_t idx = (size_t)b * num_metrics + m;
+      double v;
+
+      if(num_acc[idx] == 0)
+	v = NAN; /* No points in the step, as in RRD */
+      else
+	v = (cf == ts_cf_average) ? (acc[idx] / num_acc[idx]) : acc[idx];
+
+      lua_pushnumber(vm, (lua_Number)v);
+      lua_rawseti(vm, -2, b + 1);
+    }
+
+    lua_rawseti(vm, -2, m + 1);
+  }
+}
+
+/* ******************************************* */
+
+int TimeseriesStore::fetch(lua_State *vm, const char *schema, const char *key,
+			   u_int32_t tstart, u_int32_t tend, u_int32_t step,
+			   TsConsolidation cf, bool is_counter) {
+  ts_query_snapshot_t snapshot;
+  ts_series_points_t series;
+  ts_series_points_t::const_iterator it;
+  std::string k(key);
+  u_int32_t start, count, from;
+  struct timeval begin, end;
+
+  if((step == 0) || (tend <= tstart) || !validSchema(schema))
+    return(0);
+
+  gettimeofday(&begin, NULL);
+
+  start = tstart - (tstart % step);
+  count = (tend - start + step - 1) / step;
+  /* Counters need the point before the range for their first rate */
+  from = (is_counter && (start > step)) ? (start - step) : start;
+
+  lock.rdlock(__FILE__, __LINE__);
+  snapshotQuery(schema, &k, NULL, from, start + count * step - 1, &snapshot);
+  lock.unlock(__FILE__, __LINE__);
+
+  collectPoints(&k, NULL, from, start + count * step - 1, &snapshot, &series);
+
+  if(((it = series.find(k)) == series.end()) || it->second.timestamps.empty())
+    return(0);
+
+  lua_pushinteger(vm, (lua_Integer)start);
+  lua_pushinteger(vm, (lua_Integer)step);
+  pushConsolidated(vm, &it->second, start, step, count, cf, is_counter);
+  lua_pushinteger(vm, (lua_Integer)count);
+
+  gettimeofday(&end, NULL);
+  num_queries++, query_usec += (u_int64_t)(Utils::msTimevalDiff(&end, &begin) * 1000);
+
+  return(4);
+}
+
+/* ******************************************* */
+
+int TimeseriesStore::fetchMany(lua_State *vm, const char *schema, const std::vector<std::string> &filters,
+			       u_int32_t tstart, u_int32_t tend, u_int32_t step,
+			       TsConsolidation cf, bool is_counter) {
+  ts_query_snapshot_t snapshot;
+  ts_series_points_t series;
+  u_int32_t start, count, from;
+  struct timeval begin, end;
+  bool found = false;
+
+  if((step == 0) || (tend <= tstart) || !validSchema(schema))
+    return(0);
+
+  gettimeofday(&begin, NULL);
+
+  start = tstart - (tstart % step);
+  count = (tend - start + step - 1) / step;
+  from = (is_counter && (start > step)) ? (start - step) : start;
+
+  lock.rdlock(__FILE__, __LINE__);
+  snapshotQuery(schema, NULL, &filters, from, start + count * step - 1, &snapshot);
+  lock.unlock(__FILE__, __LINE__);
+
+  collectPoints(NULL, &filters, from, start + count * step - 1, &snapshot, &series);
+
+  for(ts_series_points_t::const_iterator it = series.begin(); (it != series.end()) && !found; ++it)
+    found = !it->second.timestamps.empty();
+
+  if(!found)
+    return(0);
+
+  lua_pushinteger(vm, (lua_Integer)start);
+  lua_pushinteger(vm, (lua_Integer)step);
+
+  lua_newtable(vm);
+
+  for(ts_series_points_t::const_iterator it = series.begin(); it != series.end(); ++it) {
+    if(it->second.timestamps.empty())
+      continue;
+
+    lua_pushstring(vm, it->first.c_str());
+    pushConsolidated(vm, &it->second, start, step, count, cf, is_counter);
+    lua_settable(vm, -3);
+  }
+
+  lua_pushinteger(vm, (lua_Integer)count);
+
+  gettimeofday(&end, NULL);
+  num_queries++, query_usec += (u_int64_t)(Utils::msTimevalDiff(&end, &begin) * 1000);
+
+  return(4);
+}
+
+/* ******************************************* */
+
+void TimeseriesStore::listSeries(lua_State *vm, const char *schema, u_int32_t start_time) {
+  std::set<std::string> keys;
+  std::vector<u_int32_t> windows;
+  std::map<std::string, ts_heads_t>::const_iterator s;
+  ts_block_header_t hdr;
+  const u_int8_t *key, *data;
+  int i = 1;
+
+  lua_newtable(vm);
+
+  if(!validSchema(schema))
+    return;
+
+  lock.rdlock(__FILE__, __LINE__);
+
+  listSegments(schema, &windows);
+
+  for(std::vector<u_int32_t>::const_iterator w = windows.begin(); w != windows.end(); ++w) {
+    std::string path = segmentPath(schema, *w);
+    ts_segment_index_t *idx;
+    u_int8_t *addr;
+    size_t len;
+    ino_t ino;
+
+    if((*w + TSDB_SEGMENT_DURATION <= start_time)
+       || !mapSegment(path, &addr, &len, &ino))
+      continue;
+
+    indexes_lock.lock(__FILE__, __LINE__);
+
+    idx = indexSegment(path, addr, len, ino);
+
+    for(std::map<std::string, ts_key_blocks_t>::const_iterator it = idx->keys.begin(); it != idx->keys.end(); ++it) {
+      if(it->second.t_max >= start_time)
+	keys.insert(it->first);
+    }
+
+    indexes_lock.unlock(__FILE__, __LINE__);
+
+    munmap(addr, len);
+  }
+
+  for(std::list<ts_pending_write_t>::const_iterator p = pending.begin(); p != pending.end(); ++p) {
+    size_t offset = 0;
+
+    if(p->schema != schema)
+      continue;
+
+    while(readBlock((const u_int8_t*)p->buf.data(), p->buf.size(), &offset, &hdr, &key, &data)) {
+      if(hdr.t_max >= start_time)
+	keys.insert(std::string((const char*)key, hdr.key_len));
+    }
+  }
+
+  if((s = heads.find(schema)) != heads.end()) {
+    for(ts_heads_t::const_iterator h = s->second.begin(); h != s->second.end(); ++h) {
+      if(h->second.last_timestamp >= start_time)
+	keys.insert(h->first);
+    }
+  }
+
+  lock.unlock(__FILE__, __LINE__);
+
+  for(std::set<std::string>::const_iterator k = keys.begin(); k != keys.end(); ++k) {
+    lua_pushstring(vm, k->c_str());
+    lua_rawseti(vm, -2, i++);
+  }
+}
+
+/* ******************************************* */
+
+/* Must be called with write_lock and the lock held */
+bool TimeseriesStore::rewriteSegment(const std::string &path, const std::vector<std::string> &filters) {
+  u_int8_t *addr;
+  size_t len;
+  std::string kept, tmp_path = path + ".tmp";
+  bool dropped, rv = true;
+  FILE *fd;
+
+  if(!mapSegment(path, &addr, &len))
+    return(true);
+
+  dropped = dropBlocks(addr, len, filters, &kept);
+
+  munmap(addr, len);
+
+  if(!dropped)
+    return(true);
+
+  dropIndexes(path);
+
+  if(kept.empty())
+    return(unlink(path.c_str()) == 0);
+
+  /* Readers keep the old file mapped until done */
+  if(((fd = fopen(tmp_path.c_str(), "wb")) == NULL)
+     || (fwrite(kept.data(), 1, kept.size(), fd) != kept.size()))
+    rv = false;
+
+  if(fd && (fclose(fd) != 0))
+    rv = false;
+
+  if(rv && (rename(tmp_path.c_str(), path.c_str()) != 0))
+    rv = false;
+
+  if(!rv) {
+    ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to rewrite %s [%s]", path.c_str(), strerror(errno));
+    unlink(tmp_path.c_str());
+  }
+
+  return(rv);
+}
+
+/* ******************************************* */
+
+bool TimeseriesStore::deleteSeries(const char *schema_prefix, const std::vector<std::string> &filters) {
+  std::set<std::string> schemas;
+  size_t prefix_len = strlen(schema_prefix);
+  bool rv = true;
+
+  /* No segment write while rewriting them */
+  write_lock.lock(__FILE__, __LINE__);
+  writePendingLocked();
+
+  lock.wrlock(__FILE__, __LINE__);
+
+  listSchemas(&schemas);
+
+  for(std::set<std::string>::const_iterator s = schemas.begin(); s != schemas.end(); ++s) {
+    std::map<std::string, ts_heads_t>::iterator h;
+
+    if(s->compare(0, prefix_len, schema_prefix) != 0)
+      continue;
+
+    /* Blocks sealed after writePendingLocked(), written when write_lock is released */
+    for(std::list<ts_pending_write_t>::iterator p = pending.begin(); p != pending.end(); ++p) {
+      std::string kept;
+
+      if(p->schema != *s)
+	continue;
+
+      if(filters.empty())
+	p->buf.clear();
+      else if(dropBlocks((const u_int8_t*)p->buf.data(), p->buf.size(), filters, &kept))
+	p->buf.swap(kept);
+    }
+
+    if(filters.empty()) {
+      heads.erase(*s);
+      dropIndexes(schemaPath(*s));
+
+      if(Utils::dir_exists(schemaPath(*s).c_str()) && (Utils::remove_recursively(schemaPath(*s).c_str()) != 0))
+	rv = false;
+
+      continue;
+    }
+
+    if((h = heads.find(*s)) != heads.end()) {
+      for(ts_heads_t::iterator it = h->second.begin(); it != h->second.end(); ) {
+	if(matchesKey((const u_int8_t*)it->first.data(), it->first.size(), filters))
+	  h->second.erase(it++);
+	else
+	  ++it;
+      }
+    }
+
+    std::vector<u_int32_t> windows;
+
+    listSegments(*s, &windows);
+
+    for(std::vector<u_int32_t>::const_iterator w = windows.begin(); w != windows.end(); ++w)
+      rv = rewriteSegment(segmentPath(*s, *w), filters) && rv;
+  }
+
+  lock.unlock(__FILE__, __LINE__);
+  write_lock.unlock(__FILE__, __LINE__);
+
+  return(rv);
+}
+
+/* ******************************************* */
+
+void TimeseriesStore::deleteOldData(u_int32_t retention_secs) {
+  std::set<std::string> schemas;
+  time_t deadline = time(NULL) - retention_secs;
+
+  write_lock.lock(__FILE__, __LINE__);
+  lock.wrlock(__FILE__, __LINE__);
+
+  listSchemas(&schemas);
+
+  for(std::set<std::string>::const_iterator s = schemas.begin(); s != schemas.end(); ++s) {
+    std::vector<u_int32_t> windows;
+
+    listSegments(*s, &windows);
+
+    for(std::vector<u_int32_t>::const_iterator w = windows.begin(); w != windows.end(); ++w) {
+      std::string path = segmentPath(*s, *w);
+
+      /* Whole segments only: no rewrite of the files */
+      if((time_t)(*w + TSDB_SEGMENT_DURATION) > deadline)
+	break;
+
+      ntop->getTrace()->traceEvent(TRACE_INFO, "Deleting expired %s", path.c_str());
+      unlink(path.c_str());
+      checked_segments.erase(path);
+      dropIndexes(path);
+    }
+  }
+
+  lock.unlock(__FILE__, __LINE__);
+  write_lock.unlock(__FILE__, __LINE__);
+}
+
+/* ******************************************* */
+
+void TimeseriesStore::lua(lua_State *vm) {
+  u_int64_t num_series = 0, num_head_points = 0, num_indexed_segments;
+
+  lock.rdlock(__FILE__, __LINE__);
+
+  for(std::map<std::string, ts_heads_t>::const_iterator s = heads.begin(); s != heads.end(); ++s) {
+    num_series += s->second.size();
+
+    for(ts_heads_t::const_iterator h = s->second.begin(); h != s->second.end(); ++h)
+      num_head_points += h->second.timestamps.size();
+  }
+
+  lock.unlock(__FILE__, __LINE__);
+
+  indexes_lock.lock(__FILE__, __LINE__);
+  num_indexed_segments = indexes.size();
+  indexes_lock.unlock(__FILE__, __LINE__);
+
+  lua_newtable(vm);
+  lua_push_uint64_table_entry(vm, "series_in_memory", num_series);
+  lua_push_uint64_table_entry(vm, "points_in_memory", num_head_points);
+  lua_push_uint64_table_entry(vm, "points_appended", num_points);
+  lua_push_uint64_table_entry(vm, "points_rejected", num_rejected);
+  lua_push_uint64_table_entry(vm, "points_written", num_written_points);
+  lua_push_uint64_table_entry(vm, "blocks_written", num_blocks);
+  lua_push_uint64_table_entry(vm, "bytes_written", num_bytes);
+  lua_push_float_table_entry(vm, "bytes_per_point", num_written_points ? (float)num_bytes / num_written_points : 0);
+  lua_push_float_table_entry(vm, "compression_ratio", num_bytes ? (float)num_raw_bytes / num_bytes : 0);
+  lua_push_uint64_table_entry(vm, "write_errors", num_write_errors);
+  lua_push_uint64_table_entry(vm, "indexed_segments", num_indexed_segments);
+  lua_push_uint64_table_entry(vm, "queries", num_queries);
+  lua_push_float_table_entry(vm, "avg_query_ms", num_queries ? (float)query_usec / num_queries / 1000 : 0);
+}
+
+/* ******************************************* */
@@ -0,0 +1,98 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "ntop_includes.h"
+
+/* ******************************************* */
+
+TopKSelector::TopKSelector(void *_elems, size_t _elem_size, u_int32_t _k,
+			   int (*_cmp)(const void *_a, const void *_b), bool keep_greatest) {
+  elems = (u_int8_t*)_elems, elem_size = _elem_size, k = _k, num = 0;
+  cmp = _cmp, dir = keep_greatest ? 1 : -1;
+
+  if((tmp = (u_int8_t*)malloc(elem_size)) == NULL)
+    throw std::bad_alloc();
+}
+
+/* ******************************************* */
+
+TopKSelector::~TopKSelector() {
+  free(tmp);
+}
+
+/* ******************************************* */
+
+void TopKSelector::swap(u_int32_t a, u_int32_t b) {
+  memcpy(tmp, at(a), elem_size);
+  memcpy(at(a), at(b), elem_size);
+  memcpy(at(b), tmp, elem_size);
+}
+
+/* ******************************************* */
+
+/* The root (index 0) is the worst element kept */
+void TopKSelector::siftUp(u_int32_t i) {
+  while(i > 0) {
+    u_int32_t parent = (i - 1) / 2;
+
+    if(!worse(i, parent))
+      break;
+
+    swap(i, parent);
+    i = parent;
+  }
+}
+
+/* ******************************************* */
+
+void TopKSelector::siftDown(u_int32_t i) {
+  while(true) {
+    u_int32_t l = 2 * i + 1, r = l + 1, w = i;
+
+    if((l < num) && worse(l, w)) w = l;
+    if((r < num) && worse(r, w)) w = r;
+
+    if(w == i)
+      break;
+
+    swap(i, w);
+    i = w;
+  }
+}
+
+/* ******************************************* */
+
+void TopKSelector::commit() {
+  if(num < k) {
+    /* Not yet full: the candidate is already in place */
+    siftUp(num++);
+  } else if((k > 0) && worse(0, k)) {
+    /* Replaces the worst element kept */
+    memcpy(at(0), at(k), elem_size);
+    siftDown(0);
+  }
+}
+
+/* ******************************************* */
+
+void TopKSelector::sort() {
+  qsort(elems, num, elem_size, cmp);
+}
@@ -1327,6 +1327,20 @@ static size_t curl_get_writefunc(void *contents, size_t size, size_t nmemb, void
 
 /* **************************************************** */
 
+/*
+  As curl_get_writefunc, but the response exceeding the buffer is discarded
+  rather than failing the transfer with CURLE_WRITE_ERROR
+*/
+static size_t curl_truncating_writefunc(void *contents, size_t size, size_t nmemb, void *userp) {
+  size_t realsize = size * nmemb;
+
+  curl_get_writefunc(contents, size, nmemb, userp);
+
+  return realsize;
+}
+
+/* **************************************************** */
+
 /**
  * @brief Implement HTTP POST of JSON data
  *
@@ -1549,6 +1563,207 @@ bool Utils::postHTTPJsonData(char *username, char *password, char *url,
 
 /* **************************************** */
 
+typedef struct {
+  const struct iovec *iov;
+  u_int iovcnt, cur;
+  size_t cur_off;
+} curl_iovec_reader_t;
+
+/* Feeds curl straight from the iovecs, without assembling the body first */
+static size_t curl_iovec_readfunc(char *ptr, size_t size, size_t nmemb, void *userdata) {
+  curl_iovec_reader_t *r = (curl_iovec_reader_t*)userdata;
+  size_t avail = size * nmemb, written = 0;
+
+  while((written < avail) && (r->cur < r->iovcnt)) {
+    const struct iovec *v = &r->iov[r->cur];
+    size_t n = min(avail - written, v->iov_len - r->cur_off);
+
+    memcpy(&ptr[written], &((const char*)v->iov_base)[r->cur_off], n);
+    written += n, r->cur_off += n;
+
+    if(r->cur_off == v->iov_len)
+      r->cur++, r->cur_off = 0;
+  }
+
+  return(written);
+}
+
+/* **************************************** */
+
+bool Utils::postHTTPJsonIovec(char *username, char *password, char *url,
+			      const struct iovec *iov, u_int iovcnt,
+			      int timeout, HTTPTranferStats *stats) {
+  CURL *curl;
+  bool ret = false;
+  curl_iovec_reader_t reader;
+  curl_off_t body_len = 0;
+
+  for(u_int i = 0; i < iovcnt; i++)
+    body_len += iov[i].iov_len;
+
+  reader.iov = iov, reader.iovcnt = iovcnt, reader.cur = 0, reader.cur_off = 0;
+
+  curl = curl_easy_init();
+  if(curl) {
+    CURLcode res;
+    struct curl_slist* headers = NULL;
+
+    fillcURLProxy(curl);
+
+    memset(stats, 0, sizeof(HTTPTranferStats));
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+
+    if((username && (username[0] != '\0'))
+       || (password && (password[0] != '\0'))) {
+      char auth[64];
+
+      snprintf(auth, sizeof(auth), "%s:%s",
+	       username ? username : "",
+	       password ? password : "");
+      curl_easy_setopt(curl, CURLOPT_USERPWD, auth);
+      curl_easy_setopt(curl, CURLOPT_HTTPAUTH, (long)CURLAUTH_BASIC);
+    }
+
+    if(!strncmp(url, "https", 5) && ntop->getPrefs()->do_insecure_tls()) {
+      curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+      curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+    }
+
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
+    headers = curl_slist_append(headers, "Content-Type: application/json");
+    headers = curl_slist_append(headers, "Expect:"); // Disable 100-continue as it may cause issues (e.g. in InfluxDB)
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_READDATA, &reader);
+    curl_easy_setopt(curl, CURLOPT_READFUNCTION, curl_iovec_readfunc);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, body_len);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curl_post_writefunc);
+
+    if(timeout) {
+      curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout);
+      curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, timeout);
+#ifdef CURLOPT_CONNECTTIMEOUT_MS
+      curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, timeout*1000);
+#endif
+    }
+
+    res = curl_easy_perform(curl);
+
+    if(res != CURLE_OK) {
+      ntop->getTrace()->traceEvent(TRACE_WARNING,
+				   "Unable to post data to (%s): %s",
+				   url, curl_easy_strerror(res));
+    } else {
+      long http_code = 0;
+
+      ntop->getTrace()->traceEvent(TRACE_INFO, "Posted JSON to %s", url);
+      readCurlStats(curl, stats, NULL);
+
+      curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+      // Success if http_code is 2xx, failure otherwise
+      if(http_code >= 200 && http_code <= 299)
+	ret = true;
+      else
+	ntop->getTrace()->traceEvent(TRACE_WARNING, "Unexpected HTTP response code received %u", http_code);
+    }
+
+    /* always cleanup */
+    curl_slist_free_all(headers);
+    curl_easy_cleanup(curl);
+  } else
+    ntop->getTrace()->traceEvent(TRACE_WARNING, "Unable to initialize curl");
+
+  return(ret);
+}
+
+/* **************************************** */
+
+/*
+  The handle is reset but not cleaned up, so its connection cache survives
+  the calls and consecutive posts to the same server reuse the connection.
+  Returns the HTTP response code, or 0 when the request can't be performed.
+*/
+long Utils::postHTTPKeepAlive(CURL *curl, const char *username, const char *password,
+			      const char *url, const char *content_type, const char *content_encoding,
+			      const char *data, u_int32_t data_len, int timeout,
+			      HTTPTranferStats *stats, char *return_data, int return_data_size) {
+  CURLcode res;
+  struct curl_slist* headers = NULL;
+  long http_code = 0;
+  char hdr[128];
+  curl_fetcher_t fetcher = {
+			    /* .payload =  */ return_data,
+			    /* .cur_size = */ 0,
+			    /* .max_size = */ (size_t)return_data_size};
+
+  if(return_data_size)
+    return_data[0] = '\0';
+
+  curl_easy_reset(curl);
+  fillcURLProxy(curl);
+
+  memset(stats, 0, sizeof(HTTPTranferStats));
+  curl_easy_setopt(curl, CURLOPT_URL, url);
+
+  if((username && (username[0] != '\0'))
+     || (password && (password[0] != '\0'))) {
+    char auth[128];
+
+    snprintf(auth, sizeof(auth), "%s:%s",
+	     username ? username : "",
+	     password ? password : "");
+    curl_easy_setopt(curl, CURLOPT_USERPWD, auth);
+    curl_easy_setopt(curl, CURLOPT_HTTPAUTH, (long)CURLAUTH_BASIC);
+  }
+
+  if(!strncmp(url, "https", 5) && ntop->getPrefs()->do_insecure_tls()) {
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+  }
+
+  curl_easy_setopt(curl, CURLOPT_POST, 1L);
+  snprintf(hdr, sizeof(hdr), "Content-Type: %s", content_type);
+  headers = curl_slist_append(headers, hdr);
+
+  if(content_encoding) {
+    snprintf(hdr, sizeof(hdr), "Content-Encoding: %s", content_encoding);
+    headers = curl_slist_append(headers, hdr);
+  }
+
+  headers = curl_slist_append(headers, "Expect:"); // Disable 100-continue as it may cause issues (e.g. in InfluxDB)
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+  curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data);
+  curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)data_len);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &fetcher);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curl_truncating_writefunc);
+  curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+
+  if(timeout) {
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, timeout);
+  }
+
+  res = curl_easy_perform(curl);
+
+  if(res != CURLE_OK) {
+    ntop->getTrace()->traceEvent(TRACE_WARNING,
+				 "Unable to post data to (%s): %s",
+				 url, curl_easy_strerror(res));
+
+    if(return_data_size)
+      snprintf(return_data, return_data_size, "%s", curl_easy_strerror(res));
+  } else
+    readCurlStats(curl, stats, NULL);
+
+  /* Set even on errors (e.g. timeout) once the response headers were received */
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+
+  curl_slist_free_all(headers);
+
+  return(http_code);
+}
+
+/* **************************************** */
+
 bool Utils::postHTTPJsonData(char *username, char *password, char *url,
                              char *json, int timeout, HTTPTranferStats *stats,
                              char *return_data, int return_data_size, int *response_code) {
@@ -3324,10 +3539,12 @@ int Utils::numberOfSetBits(u_int32_t i) {
 /* ******************************************* */
 
 void Utils::initRedis(Redis **r, const char *redis_host, const char *redis_password,
-		      u_int16_t redis_port, u_int8_t _redis_db_id, bool giveup_on_failure) {
+		      u_int16_t redis_port, u_int8_t _redis_db_id, bool giveup_on_failure,
+		      u_int8_t num_connections) {
   if(r) {
     if(*r) delete(*r);
-    (*r) = new (std::nothrow) Redis(redis_host, redis_password, redis_port, _redis_db_id, giveup_on_failure);
+    (*r) = new (std::nothrow) Redis(redis_host, redis_password, redis_port, _redis_db_id,
+				    giveup_on_failure, num_connections);
   }
 }
 
@@ -30,31 +30,14 @@ VLANHash::VLANHash(NetworkInterface *_iface, u_int _num_hashes, u_int _max_hash_
 
 /* ************************************ */
 
-VLAN* VLANHash::get(VLANid _vlan_id, bool is_inline_call) {
-  u_int32_t hash = _vlan_id;
-
-  hash %= num_hashes;
-
-  if(table[hash] == NULL) {
-    return(NULL);
-  } else {
-    VLAN *head;
-
-    if(!is_inline_call)
-      locks[hash]->rdlock(__FILE__, __LINE__);
+static bool vlan_matches(GenericHashEntry *h, void *user_data) {
+  VLAN *vl = (VLAN*)h;
 
-    head = (VLAN*)table[hash];
+  return((!vl->idle()) && vl->equal(*((VLANid*)user_data)));
+}
 
-    while(head != NULL) {
-      if((!head->idle()) && head->equal(_vlan_id))
-	break;
-      else
-	head = (VLAN*)head->next();
-    }
+/* ************************************ */
 
-    if(!is_inline_call)
-      locks[hash]->unlock(__FILE__, __LINE__);
-    
-    return(head);
-  }
+VLAN* VLANHash::get(VLANid _vlan_id, bool is_inline_call) {
+  return((VLAN*)lookup<vlan_matches>(_vlan_id, &_vlan_id, !is_inline_call));
 }
@@ -29,7 +29,10 @@ ViewInterface::ViewInterface(const char *_endpoint) : NetworkInterface(_endpoint
 
   memset(viewed_interfaces, 0, sizeof(viewed_interfaces));
   memset(viewed_interfaces_queues, 0, sizeof(viewed_interfaces_queues));
-  num_viewed_interfaces = 0;
+  memset(view_workers, 0, sizeof(view_workers));
+  memset(viewWorkerLoopsCreated, 0, sizeof(viewWorkerLoopsCreated));
+  num_viewed_interfaces = 0, num_view_workers = 0;
+  view_workers_stop = false;
 
   if(!strcmp(_endpoint, "view:all")) {
     /* Create a view on all the active interfaces */
@@ -87,6 +90,21 @@ ViewInterface::ViewInterface(const char *_endpoint) : NetworkInterface(_endpoint
 
   if(num_viewed_interfaces == 0)
     ntop->getTrace()->traceEvent(TRACE_WARNING, "Empty view interface: \"%s\"", get_name());
+
+  /* No point in having more workers than queues to dequeue */
+  num_view_workers = min_val(ntop->getPrefs()->get_num_view_workers(), num_viewed_interfaces);
+
+  for(u_int8_t i = 0; i < num_view_workers; i++) {
+    if((view_workers[i] = new (std::nothrow) view_worker_t()) == NULL) {
+      ntop->getTrace()->traceEvent(TRACE_WARNING, "Not enough memory for view worker %u", i);
+      break;
+    }
+
+    view_workers[i]->iface = this, view_workers[i]->worker_id = i;
+  }
+
+  while((num_view_workers > 0) && (view_workers[num_view_workers - 1] == NULL))
+    num_view_workers--;
 }
 
 /* **************************************************** */
@@ -97,6 +115,11 @@ ViewInterface::~ViewInterface() {
     if(viewed_interfaces_queues[i])
       delete viewed_interfaces_queues[i];
   }
+
+  for(int i = 0; i < MAX_NUM_VIEW_INTERFACES; i++) {
+    if(view_workers[i])
+      delete view_workers[i];
+  }
 }
 
 /* **************************************************** */
@@ -119,35 +142,75 @@ bool ViewInterface::viewEnqueue(time_t t, Flow *f, u_int8_t viewed_interface_id)
 
 /* **************************************************** */
 
-u_int64_t ViewInterface::viewDequeue(u_int budget) {
+u_int64_t ViewInterface::viewDequeue(u_int8_t worker_id, u_int budget) {
+  view_worker_t *w = (worker_id < num_view_workers) ? view_workers[worker_id] : NULL;
   u_int64_t num = 0;
   struct timeval tv;
 
+  if(!w)
+    return(0);
+
   gettimeofday(&tv, NULL);
 
-  for(int i = 0; i < num_viewed_interfaces; i++) {
+  for(int i = worker_id; i < num_viewed_interfaces; i += num_view_workers) {
     u_int64_t flows_done = 0;
 
-    while(viewed_interfaces_queues[i]->isNotEmpty()) {
-      Flow *f = viewed_interfaces_queues[i]->dequeue();
+    while(budget == 0 /* No budget requested */
+	  || flows_done < budget /* Budget not exceeded */) {
+      u_int32_t max_items = VIEW_DEQUEUE_BATCH, n;
+
+      if(budget > 0 && (budget - flows_done) < max_items)
+	max_items = budget - flows_done;
 
-      viewed_flows_walker(f, &tv);
+      if((n = viewed_interfaces_queues[i]->dequeueBatch(w->flows, max_items)) == 0)
+	break;
+
+      /*
+	Partials only touch the flow, which is only enqueued to this queue:
+	compute them without holding the aggregation locks
+      */
+      for(u_int32_t j = 0; j < n; j++)
+	w->valid[j] = w->flows[j]->get_partial_traffic_stats_view(&w->partials[j], &w->first_partial[j]);
+
+      shared_stats_lock.lock(__FILE__, __LINE__);
+
+      for(u_int32_t j = 0; j < n; j++) {
+	Flow *f = w->flows[j];
+
+	if(f->get_last_seen() > getTimeLastPktRcvd())
+	  setTimeLastPktRcvd(f->get_last_seen());
+
+	w->cli_hosts[j] = w->srv_hosts[j] = NULL;
+
+	if(w->valid[j])
+	  viewed_flows_shared_update(f, &w->partials[j], w->first_partial[j], &tv,
+				     &w->cli_hosts[j], &w->srv_hosts[j]);
+      }
+
+      shared_stats_lock.unlock(__FILE__, __LINE__);
+
+      /* Host stats only contend with the workers updating hosts in the same shards */
+      for(u_int32_t j = 0; j < n; j++) {
+	if(w->valid[j])
+	  viewed_flows_hosts_update(w->flows[j], &w->partials[j], w->first_partial[j], &tv,
+				    w->cli_hosts[j], w->srv_hosts[j]);
+      }
 
 #if 0
-      ntop->getTrace()->traceEvent(TRACE_NORMAL, "Dequeued view flow");
+      ntop->getTrace()->traceEvent(TRACE_NORMAL, "Dequeued %u view flows", n);
 #endif
 
-      f->decUses(); /* Decrease uses now that the job is done */
+      for(u_int32_t j = 0; j < n; j++)
+	w->flows[j]->decUses(); /* Decrease uses now that the job is done */
 
-      flows_done++;
-      if(budget > 0 /* Budget requested */
-	 && flows_done >= budget /* Budget exceeded */)
-	break;
+      flows_done += n, w->num_batches++;
     }
 
     num += flows_done;
   }
 
+  w->num_flows += num;
+
   return num;
 }
 
@@ -456,94 +519,131 @@ Flow* ViewInterface::findFlowByTuple(VLANid vlan_id,
 
 /* **************************************************** */
 
-void ViewInterface::viewed_flows_walker(Flow *f, const struct timeval *tv) {
+/*
+  first_partial tells whether this is the first time the view is visiting this flow.
+
+  NOTE: partials are calculated as a delta between the current and the past traffic.
+  When the hash tables are full and hosts cannot be allocated during the
+  first iteration of this method on the flow (when first_partial is true),
+  such stats on the hosts will be lost.
+*/
+void ViewInterface::viewed_flows_shared_update(Flow *f, PartializableFlowTrafficStats *partials,
+					       bool first_partial, const struct timeval *tv,
+					       Host **cli_host_p, Host **srv_host_p) {
   NetworkStats *network_stats;
-  PartializableFlowTrafficStats partials;
-  bool first_partial; /* Whether this is the first time the view is visiting this flow */
   const IpAddress *cli_ip = f->get_cli_ip_addr(), *srv_ip = f->get_srv_ip_addr();
 
-  if(f->get_last_seen() > getTimeLastPktRcvd())
-    setTimeLastPktRcvd(f->get_last_seen());
+  if(!cli_ip || !srv_ip)
+    ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to get flow hosts. Out of memory? Expect issues.");
+
+  if(cli_ip && srv_ip) {
+    Host *cli_host = NULL, *srv_host = NULL;
+    /* Add MAC Addresses to view interfaces, if NULL the don't add */
+    
+    /* Important: findFlowHosts can allocate new hosts and returns them with a use taken.
+     * The first_partial condition is used to call `incNumFlows` on the hosts below, so it is essential that
+     * findFlowHosts is called only when first_partial is true. Hosts are added to the hash
+     * inline, hence with the shared_stats_lock held as the ViewInterface purgeIdle. */
+    if(first_partial) {
+      findFlowHosts(f->get_vlan_id(), f->get_observation_point_id(),
+		    NULL /* Mac Address */, (IpAddress*)cli_ip, &cli_host,
+		    NULL /* Mac Address */, (IpAddress*)srv_ip, &srv_host);
+
+	if(cli_host) cli_host->setViewInterfaceMac(f->getViewCliMac());
+	if(srv_host) srv_host->setViewInterfaceMac(f->getViewSrvMac());
+    } else {
+      /* The unsafe pointers can be used here as the hosts cannot be purged while
+       * the shared_stats_lock is held, see the ViewInterface purgeIdle. This also
+       * saves some unnecessary hash table lookup time. */
+      cli_host = f->getViewSharedClient();
+      srv_host = f->getViewSharedServer();
+    }
 
-  /* NOTE: partials are calculated as a delta between the current and the past traffic.
-   * When the hash tables are full and hosts cannot be allocated during the
-   * first iteration of this method on the flow (when first_partial is true),
-   * such stats on the hosts will be lost.
-   */
-  if(f->get_partial_traffic_stats_view(&partials, &first_partial)) {
-    if(!cli_ip || !srv_ip)
-      ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to get flow hosts. Out of memory? Expect issues.");
+    f->hosts_shared_stats_update(this, cli_host, srv_host, partials, tv);
 
-    if(cli_ip && srv_ip) {
-      Host *cli_host = NULL, *srv_host = NULL;
-      /* Add MAC Addresses to view interfaces, if NULL the don't add */
-      
-      /* Important: findFlowHosts can allocate new hosts. The first_partial condition
-       * is used to call `incNumFlows` and `incUses` on the hosts below, so it is essential that
-       * findFlowHosts is called only when first_partial is true. */
+    if(cli_host) {
       if(first_partial) {
-	findFlowHosts(f->get_vlan_id(), f->get_observation_point_id(),
-		      NULL /* Mac Address */, (IpAddress*)cli_ip, &cli_host,
-		      NULL /* Mac Address */, (IpAddress*)srv_ip, &srv_host);
-
-          if(cli_host) cli_host->setViewInterfaceMac(f->getViewCliMac());
-          if(srv_host) srv_host->setViewInterfaceMac(f->getViewSrvMac());
-      } else {
-	/* The unsafe pointers can be used here as ViewInterface::viewed_flows_walker is
-	 * called synchronously with the ViewInterface purgeIdle. This also saves some
-	 * unnecessary hash table lookup time. */
-	cli_host = f->getViewSharedClient();
-	srv_host = f->getViewSharedServer();
+	network_stats = cli_host->getNetworkStats(cli_host->get_local_network_id());
+	if(network_stats) network_stats->incNumFlows(f->get_last_seen(), true);
+	if(f->getViewInterfaceFlowStats()) f->getViewInterfaceFlowStats()->setClientHost(cli_host);
       }
+    }
 
-      f->hosts_periodic_stats_update(this, cli_host, srv_host, &partials, first_partial, tv);
-
-      if(cli_host) {
-	if(first_partial) {
-	  cli_host->incNumFlows(f->get_last_seen(), true), cli_host->incUses();
-	  network_stats = cli_host->getNetworkStats(cli_host->get_local_network_id());
-	  if(network_stats) network_stats->incNumFlows(f->get_last_seen(), true);
-	  if(f->getViewInterfaceFlowStats()) f->getViewInterfaceFlowStats()->setClientHost(cli_host);
-    cli_host->setLastDeviceIp(f->getFlowDeviceIP());
-	}
+    if(srv_host) {
+      if(first_partial) {
+	network_stats = srv_host->getNetworkStats(srv_host->get_local_network_id());
+	if(network_stats) network_stats->incNumFlows(f->get_last_seen(), false);
+	if(f->getViewInterfaceFlowStats()) f->getViewInterfaceFlowStats()->setServerHost(srv_host);
       }
+    }
 
-      if(srv_host) {
-	if(first_partial) {
-	  srv_host->incUses(), srv_host->incNumFlows(f->get_last_seen(), false);
-	  network_stats = srv_host->getNetworkStats(srv_host->get_local_network_id());
-	  if(network_stats) network_stats->incNumFlows(f->get_last_seen(), false);
-	  if(f->getViewInterfaceFlowStats()) f->getViewInterfaceFlowStats()->setServerHost(srv_host);
-    srv_host->setLastDeviceIp(f->getFlowDeviceIP());
-	}
-      }
+    /* Score increments are performed here periodically for view interfaces.
+       They also update the host AS, VLAN, country, network and interface */
+    for(int i = 0; i < MAX_NUM_SCORE_CATEGORIES; i++) {
+      ScoreCategory score_category = (ScoreCategory)i;
+      u_int16_t cli_score_val = partials->get_cli_score(score_category),
+	srv_score_val = partials->get_srv_score(score_category);
 
-      /* Score increments are performed here periodically for view interfaces */
-      for(int i = 0; i < MAX_NUM_SCORE_CATEGORIES; i++) {
-	ScoreCategory score_category = (ScoreCategory)i;
-	u_int16_t cli_score_val = partials.get_cli_score(score_category),
-	  srv_score_val = partials.get_srv_score(score_category);
+      if(cli_score_val && cli_host)
+	cli_host->incScoreValue(cli_score_val, score_category, true /* as client */);
 
-	if(cli_score_val && cli_host)
-	  cli_host->incScoreValue(cli_score_val, score_category, true /* as client */);
+      if(srv_score_val && srv_host)
+	srv_host->incScoreValue(srv_score_val, score_category, false /* as server */);
+    }
 
-	if(srv_score_val && srv_host)
-	  srv_host->incScoreValue(srv_score_val, score_category, false /* as server */);
-      }
+    incStats(true /* ingressPacket */,
+	     tv->tv_sec, cli_ip && cli_ip->isIPv4() ? ETHERTYPE_IP : ETHERTYPE_IPV6,
+	     f->getStatsProtocol(), f->get_protocol_category(),
+	     f->get_protocol(),
+	     partials->get_srv2cli_bytes() + partials->get_cli2srv_bytes(),
+	     partials->get_srv2cli_packets() + partials->get_cli2srv_packets());
 
-      if(partials.get_is_flow_alerted()) {
-	if(cli_host) cli_host->incNumAlertedFlows(true /* As client */),  cli_host->incTotalAlerts();
-	if(srv_host) srv_host->incNumAlertedFlows(false /* As server */), srv_host->incTotalAlerts();
-      }
+    *cli_host_p = cli_host, *srv_host_p = srv_host;
+  }
+}
+
+/* **************************************************** */
+
+void ViewInterface::viewed_flows_hosts_update(Flow *f, PartializableFlowTrafficStats *partials,
+					      bool first_partial, const struct timeval *tv,
+					      Host *cli_host, Host *srv_host) {
+  u_int32_t s1 = cli_host ? hostShard(cli_host) : VIEW_AGGREGATION_SHARDS;
+  u_int32_t s2 = srv_host ? hostShard(srv_host) : VIEW_AGGREGATION_SHARDS;
+
+  if(s1 > s2) {
+    u_int32_t tmp = s1;
 
-      incStats(true /* ingressPacket */,
-	       tv->tv_sec, cli_ip && cli_ip->isIPv4() ? ETHERTYPE_IP : ETHERTYPE_IPV6,
-	       f->getStatsProtocol(), f->get_protocol_category(),
-	       f->get_protocol(),
-	       partials.get_srv2cli_bytes() + partials.get_cli2srv_bytes(),
-	       partials.get_srv2cli_packets() + partials.get_cli2srv_packets());
+    s1 = s2, s2 = tmp;
+  }
+
+  /* Shards are locked in ascending order so that workers cannot deadlock */
+  if(s1 < VIEW_AGGREGATION_SHARDS) host_locks[s1].lock(__FILE__, __LINE__);
+  if((s2 < VIEW_AGGREGATION_SHARDS) && (s2 != s1)) host_locks[s2].lock(__FILE__, __LINE__);
+
+  f->hosts_own_stats_update(cli_host, srv_host, partials, first_partial, tv);
+
+  if(cli_host) {
+    if(first_partial) {
+      cli_host->incNumFlows(f->get_last_seen(), true);
+      cli_host->setLastDeviceIp(f->getFlowDeviceIP());
+    }
+
+    if(partials->get_is_flow_alerted())
+      cli_host->incNumAlertedFlows(true /* As client */), cli_host->incTotalAlerts();
+  }
+
+  if(srv_host) {
+    if(first_partial) {
+      srv_host->incNumFlows(f->get_last_seen(), false);
+      srv_host->setLastDeviceIp(f->getFlowDeviceIP());
     }
+
+    if(partials->get_is_flow_alerted())
+      srv_host->incNumAlertedFlows(false /* As server */), srv_host->incTotalAlerts();
   }
+
+  if((s2 < VIEW_AGGREGATION_SHARDS) && (s2 != s1)) host_locks[s2].unlock(__FILE__, __LINE__);
+  if(s1 < VIEW_AGGREGATION_SHARDS) host_locks[s1].unlock(__FILE__, __LINE__);
 }
 
 /* **************************************************** */
@@ -575,10 +675,19 @@ void ViewInterface::flowPollLoop() {
   while(!ntop->getGlobals()->isShutdownRequested()) {
     while(idle()) sleep(1);
 
-    u_int64_t num = viewDequeue(MAX_VIEW_INTERFACE_QUEUE_LEN);
+    u_int64_t num = viewDequeue(0 /* worker */, MAX_VIEW_INTERFACE_QUEUE_LEN);
+
+    /* Hosts can be purged only when no worker is aggregating flows on them */
+    shared_stats_lock.lock(__FILE__, __LINE__);
+    for(int i = 0; i < VIEW_AGGREGATION_SHARDS; i++)
+      host_locks[i].lock(__FILE__, __LINE__);
 
     purgeIdle(time(NULL));
 
+    for(int i = VIEW_AGGREGATION_SHARDS - 1; i >= 0; i--)
+      host_locks[i].unlock(__FILE__, __LINE__);
+    shared_stats_lock.unlock(__FILE__, __LINE__);
+
     if(num == 0)
       _usleep(100);
   }
@@ -616,6 +725,34 @@ void ViewInterface::dumpFlowLoop() {
 
 /* **************************************************** */
 
+void ViewInterface::viewWorkerLoop(u_int8_t worker_id) {
+  while(!ntop->getGlobals()->isShutdownRequested() && !view_workers_stop) {
+    while(idle() && !view_workers_stop) sleep(1);
+
+    if(viewDequeue(worker_id, MAX_VIEW_INTERFACE_QUEUE_LEN) == 0)
+      _usleep(100);
+  }
+}
+
+/* **************************************************** */
+
+static void* viewWorkerLoop(void* ptr) {
+  view_worker_t *w = (view_worker_t*)ptr;
+  char buf[16];
+
+  snprintf(buf, sizeof(buf), "ntopng-view-%u", w->worker_id);
+  Utils::setThreadName(buf);
+
+  /* Wait until the initialization completes */
+  while(!w->iface->isRunning()) sleep(1);
+
+  w->iface->viewWorkerLoop(w->worker_id);
+
+  return NULL;
+}
+
+/* **************************************************** */
+
 static void* flowPollLoop(void* ptr) {
   ViewInterface *iface = (ViewInterface*)ptr;
 
@@ -632,12 +769,55 @@ static void* flowPollLoop(void* ptr) {
 void ViewInterface::startPacketPolling() {
   pthread_create(&pollLoop, NULL, ::flowPollLoop, this);
   pollLoopCreated = true;
+
+  /* Worker 0 is the poll loop */
+  for(u_int8_t i = 1; i < num_view_workers; i++) {
+    if(pthread_create(&viewWorkerLoops[i], NULL, ::viewWorkerLoop, view_workers[i]) == 0)
+      viewWorkerLoopsCreated[i] = true;
+    else
+      ntop->getTrace()->traceEvent(TRACE_WARNING, "Unable to start view worker %u on %s", i, get_name());
+  }
+
+  if(num_view_workers > 1)
+    ntop->getTrace()->traceEvent(TRACE_NORMAL, "Aggregating %u viewed interfaces of %s with %u workers",
+				 num_viewed_interfaces, get_description(), num_view_workers);
+
   NetworkInterface::startPacketPolling();
 }
 
 /* **************************************************** */
 
+void ViewInterface::shutdown() {
+  void *res;
+
+  view_workers_stop = true;
+
+  for(u_int8_t i = 1; i < num_view_workers; i++) {
+    if(viewWorkerLoopsCreated[i]) {
+      pthread_join(viewWorkerLoops[i], &res);
+      viewWorkerLoopsCreated[i] = false;
+    }
+  }
+
+  NetworkInterface::shutdown();
+}
+
+/* **************************************************** */
+
 void ViewInterface::lua_queues_stats(lua_State* vm) {
   for(int i = 0; i < num_viewed_interfaces; i++)
     viewed_interfaces_queues[i]->lua(vm);
+
+  for(int i = 0; i < num_view_workers; i++) {
+    char buf[32];
+
+    snprintf(buf, sizeof(buf), "view_worker_%u", i);
+
+    lua_newtable(vm);
+    lua_push_uint64_table_entry(vm, "num_flows", view_workers[i]->num_flows);
+    lua_push_uint64_table_entry(vm, "num_batches", view_workers[i]->num_batches);
+    lua_pushstring(vm, buf);
+    lua_insert(vm, -2);
+    lua_settable(vm, -3);
+  }
 }
@@ -30,27 +30,16 @@ VirtualHostHash::VirtualHostHash(NetworkInterface *_iface, u_int _num_hashes, u_
 
 /* *********************************************************** */
 
+static bool vhost_matches(GenericHashEntry *h, void *user_data) {
+  VirtualHost *vh = (VirtualHost*)h;
+
+  return((!vh->idle())
+	 && vh->get_name()
+	 && (strcmp((const char*)user_data, vh->get_name()) == 0));
+}
+
+/* *********************************************************** */
+
 VirtualHost* VirtualHostHash::get(char *vhost_name) {
-  u_int32_t hash = Utils::hashString(vhost_name) % num_hashes;
-
-  if(table[hash] == NULL) {
-    return(NULL);
-  } else {
-    VirtualHost *head;
-
-    locks[hash]->wrlock(__FILE__, __LINE__);
-    head = (VirtualHost*)table[hash];
-    
-    while(head != NULL) {      
-      if((!head->idle())
-	 && head->get_name()
-	 && (strcmp(vhost_name, head->get_name()) == 0))
-	break;
-      else
-	head = (VirtualHost*)head->next();
-    }
-    locks[hash]->unlock(__FILE__, __LINE__);
-
-    return(head);
-  }
+  return((VirtualHost*)lookup<vhost_matches>(Utils::hashString(vhost_name), vhost_name, true /* Lock */));
 }
@@ -39,7 +39,7 @@ ZMQCollectorInterface::ZMQCollectorInterface(const char *_endpoint) : ZMQParserI
      NULL
     };
   
-  num_subscribers = 0;
+  num_subscribers = 0, num_workers = 0, num_unprocessed_flows = 0;
   server_secret_key[0] = '\0';
   server_public_key[0] = '\0';
 
@@ -184,6 +184,12 @@ ZMQCollectorInterface::~ZMQCollectorInterface() {
   }
 #endif
 
+  /* Workers use the sockets */
+  stopWorkers();
+
+  for(u_int8_t i = 0; i < num_workers; i++)
+    delete workers[i];
+
   for(int i=0; i<num_subscribers; i++) {
     if(subscriber[i].endpoint) free(subscriber[i].endpoint);
     zmq_close(subscriber[i].socket);
@@ -253,23 +259,303 @@ void ZMQCollectorInterface::checkPointCounters(bool drops_only) {
 
 /* **************************************************** */
 
-void ZMQCollectorInterface::collect_flows() {
+/*
+  Decompresses src into the arena of ctx, grown (up to MAX_ZMQ_DECOMPRESSED_LEN)
+  when the uncompressed length is not known in advance.
+  Returns the uncompressed length, -1 on error.
+*/
+int ZMQCollectorInterface::decompress(u_int8_t compression, const char *src, u_int32_t src_len,
+				      ZMQRecvContext *ctx) {
+  switch(compression) {
+#ifdef HAVE_ZLIB
+  case ZMQ_MSG_COMPRESSION_ZLIB:
+    {
+      /* Start from the arena size: it fits the messages seen so far */
+      u_int32_t len = max_val(max_val(5 * src_len, (u_int32_t)MAX_ZMQ_FLOW_BUF),
+			      ctx->arena_size ? ctx->arena_size - 1 : 0);
+      int err;
+
+      while(ctx->reserveArena(len)) {
+	uLongf uLen = len;
+
+	if((err = uncompress((Bytef*)ctx->arena, &uLen, (Bytef*)src, src_len)) == Z_OK)
+	  return(uLen);
+	else if((err != Z_BUF_ERROR) || (len >= MAX_ZMQ_DECOMPRESSED_LEN)) {
+	  ntop->getTrace()->traceEvent(TRACE_ERROR, "Uncompress error [%d][len: %u]", err, src_len);
+	  break;
+	}
+
+	len = min_val(2 * len, (u_int32_t)MAX_ZMQ_DECOMPRESSED_LEN);
+      }
+    }
+    break;
+#endif
+
+#ifdef HAVE_LZ4
+  case ZMQ_MSG_COMPRESSION_LZ4:
+    {
+      u_int32_t len;
+      int rc;
+
+      if(src_len < sizeof(len))
+	break;
+
+      memcpy(&len, src, sizeof(len));
+      len = ntohl(len);
+
+      if((len > MAX_ZMQ_DECOMPRESSED_LEN) || !ctx->reserveArena(len))
+	break;
+
+      if((rc = LZ4_decompress_safe(&src[sizeof(len)], ctx->arena, src_len - sizeof(len), len)) >= 0)
+	return(rc);
+
+      ntop->getTrace()->traceEvent(TRACE_ERROR, "LZ4 decompress error [%d][len: %u]", rc, src_len);
+    }
+    break;
+#endif
+
+#ifdef HAVE_ZSTD
+  case ZMQ_MSG_COMPRESSION_ZSTD:
+    {
+      unsigned long long content_len = ZSTD_getFrameContentSize(src, src_len);
+      u_int32_t len;
+      size_t rc;
+
+      if(content_len == ZSTD_CONTENTSIZE_ERROR)
+	break;
+
+      len = ((content_len == ZSTD_CONTENTSIZE_UNKNOWN) || (content_len > MAX_ZMQ_DECOMPRESSED_LEN)) ?
+	max_val(5 * src_len, (u_int32_t)MAX_ZMQ_FLOW_BUF) : (u_int32_t)content_len;
+
+      while(ctx->reserveArena(len)) {
+	if(!ZSTD_isError(rc = ZSTD_decompress(ctx->arena, len, src, src_len)))
+	  return(rc);
+	else if((content_len != ZSTD_CONTENTSIZE_UNKNOWN) || (len >= MAX_ZMQ_DECOMPRESSED_LEN)) {
+	  ntop->getTrace()->traceEvent(TRACE_ERROR, "Zstd decompress error [%s][len: %u]",
+				       ZSTD_getErrorName(rc), src_len);
+	  break;
+	}
+
+	len = min_val(2 * len, (u_int32_t)MAX_ZMQ_DECOMPRESSED_LEN);
+      }
+    }
+    break;
+#endif
+
+  default:
+    {
+      static bool once = false;
+
+      if(!once)
+	ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to decompress ZMQ traffic [compression: 0x%02X]: "
+				     "ntopng compiled without support for it", compression), once = true;
+    }
+    break;
+  }
+
+  return(-1);
+}
+
+/* **************************************************** */
+
+/*
+  Receives a message (header and payload) from socket and decodes it, i.e.
+  decompresses and decrypts it. The payload is received into ctx->payload and
+  is not copied, unless it must be decompressed (into the ctx->arena) or NUL
+  terminated. Returns false when there is nothing to process.
+  Called by the interface thread or, each with its own ctx, by the
+  ZMQCollectorWorker threads.
+*/
+bool ZMQCollectorInterface::recvMessage(void *socket, ZMQRecvContext *ctx, ZMQCollectorMsg *msg) {
   struct zmq_msg_hdr_v0 h0;
   struct zmq_msg_hdr *h = (struct zmq_msg_hdr *) &h0; /* NOTE: in network-byte-order format */
-  char *payload = NULL;
-  const u_int payload_len = 131072;
+  u_int32_t msg_id, last_msg_id;
+  u_int8_t source_id = 0, compression = 0;
+  u_int32_t publisher_version = 0;
+  char *payload;
+  int size;
+
+  size = zmq_recv(socket, &h0, sizeof(h0), 0);
+
+  if(size == sizeof(struct zmq_msg_hdr_v0)) {
+    /* Legacy version */
+    msg_id = 0, source_id = 0;
+    publisher_version = h0.version;
+
+  } else /* size == struct zmq_msg_hdr */ {
+    u_int8_t version = h->version & ZMQ_MSG_VERSION_MASK;
+
+    /* safety checks */
+    if(size != sizeof(struct zmq_msg_hdr) || (
+      version != ZMQ_MSG_VERSION && 
+      version != ZMQ_MSG_VERSION_TLV &&
+      version != ZMQ_COMPATIBILITY_MSG_VERSION
+    )) {
+      ntop->getTrace()->traceEvent(TRACE_WARNING,
+				   "Unsupported publisher version: is your nProbe sender "
+				   "outdated? [%u][%u][%u][%u][%u]",
+				   size, sizeof(struct zmq_msg_hdr), h->version,
+				   ZMQ_MSG_VERSION, ZMQ_COMPATIBILITY_MSG_VERSION);
+      return(false); /* skip message */
+    }
+
+#ifdef ZMQ_DEBUG
+    ntop->getTrace()->traceEvent(TRACE_NORMAL, "[version: %u]", h->version);
+#endif
+
+    compression = h->version & ZMQ_MSG_COMPRESSION_MASK;
+
+    if(version == ZMQ_COMPATIBILITY_MSG_VERSION) {
+      source_id = 0, msg_id = h->msg_id; // host byte order
+      publisher_version = version;
+    } else {
+      source_id = h->source_id, msg_id = ntohl(h->msg_id);
+      publisher_version = version;
+    }
+  }
+
+  if(ctx->last_msg_ids.find(source_id) == ctx->last_msg_ids.end())
+    ctx->last_msg_ids[source_id] = 0;
+
+  last_msg_id = ctx->last_msg_ids[source_id];
+
+#ifdef ZMQ_DEBUG
+  ntop->getTrace()->traceEvent(TRACE_NORMAL, "[topic: %s]", h->url);
+  ntop->getTrace()->traceEvent(TRACE_NORMAL, "[message source: %u]"
+			       "[msg_id: %u][last_msg_id: %u][lost: %i]",
+			       source_id, msg_id, last_msg_id, msg_id - last_msg_id - 1);
+#endif
+
+  if(msg_id > 0) {
+    if(msg_id < last_msg_id) ; /* Start over */
+    else if(last_msg_id > 0) {
+      int32_t diff = msg_id - last_msg_id;
+
+      if(diff > 1) {
+	ctx->num_msg_drops += diff - 1;
+
+#ifdef ZMQ_DEBUG
+	ntop->getTrace()->traceEvent(TRACE_NORMAL, "[msg_id=%u][last=%u][tot_msgs=%u][drops=%u][+%u]", 
+				     msg_id, last_msg_id, ctx->num_msgs, ctx->num_msg_drops, diff-1);
+#endif
+      }
+    }
+
+    ctx->last_msg_ids[source_id] = msg_id;
+  }
+
+  /* Any previous payload is released by zmq_msg_recv() */
+  if((size = zmq_msg_recv(&ctx->payload, socket, 0)) <= 0)
+    return(false);
+
+  /* Received messages are owned by ctx: they can be decoded and parsed in place */
+  payload = (char*)zmq_msg_data(&ctx->payload);
+
+  ctx->num_msgs++, ctx->num_bytes += size;
+
+  msg->topic = h->url[0], msg->source_id = source_id, msg->msg_id = msg_id;
+  msg->tlv_encoding = (publisher_version == ZMQ_MSG_VERSION_TLV);
+
+  if(!compression && !msg->tlv_encoding && (payload[0] == 0)) {
+    /* Legacy zlib framing */
+    compression = ZMQ_MSG_COMPRESSION_ZLIB;
+    payload++, size--;
+  }
+
+  if(compression) {
+    ticks begin = Utils::getticks();
+    int len = decompress(compression, payload, size, ctx);
+
+    ctx->decompress_ticks += Utils::getticks() - begin, ctx->num_decompressed++;
+
+    if(len < 0)
+      return(false);
+
+    msg->buf = ctx->arena, msg->len = len, msg->buf[len] = '\0';
+  } else if(msg->topic != 'f') {
+    /* Parsed with json-c, a NUL terminated copy is needed */
+    if(!ctx->reserveArena(size))
+      return(false);
+
+    memcpy(ctx->arena, payload, size);
+    ctx->arena[size] = '\0', ctx->num_bytes_copied += size;
+    msg->buf = ctx->arena, msg->len = size;
+  } else /* Flows (TLV or JSON) are parsed in place */
+    msg->buf = payload, msg->len = size;
+
+  if(ntop->getPrefs()->get_zmq_encryption_pwd())
+    Utils::xor_encdec((u_char*)msg->buf, msg->len, (u_char*)ntop->getPrefs()->get_zmq_encryption_pwd());
+
+  return(true);
+}
+
+/* **************************************************** */
+
+/* Parses a decoded message on the interface thread */
+void ZMQCollectorInterface::processMessage(u_int8_t subscriber_id, ZMQCollectorMsg *msg) {
+  char *uncompressed = msg->buf;
+  u_int uncompressed_len = msg->len;
+  u_int8_t source_id = msg->source_id;
+
+  switch(msg->topic) {
+  case 'e': /* event */
+    recvStats.num_events++;
+    parseEvent(uncompressed, uncompressed_len, source_id, this);
+    break;
+
+  case 'f': /* flow */
+    if(msg->tlv_encoding) 
+      recvStats.num_flows += parseTLVFlow(uncompressed, uncompressed_len, subscriber_id, this);
+    else
+      recvStats.num_flows += parseJSONFlow(uncompressed, uncompressed_len, subscriber_id, &parser_ctx);
+    break;
+
+  case 'c': /* counter */
+    recvStats.num_counters++;
+    parseCounter(uncompressed, uncompressed_len, subscriber_id, this);
+    break;
+
+  case 't': /* template */
+    recvStats.num_templates++;
+    parseTemplate(uncompressed, uncompressed_len, subscriber_id, this);
+    break;
+
+  case 'o': /* option */
+    recvStats.num_options++;
+    parseOption(uncompressed, uncompressed_len, subscriber_id, this);
+    break;
+
+  case 'h': /* hello */
+    recvStats.num_hello++;
+    /* ntop->getTrace()->traceEvent(TRACE_NORMAL, "[HELLO] %s", uncompressed); */
+    ntop->askToRefreshIPSRules();
+    break;
+
+  case 'l': /* listening-ports */
+    recvStats.num_listening_ports++;
+    parseListeningPorts(uncompressed, uncompressed_len, subscriber_id, this);
+    break;
+  }
+
+  /* ntop->getTrace()->traceEvent(TRACE_INFO, "[%c] %s", msg->topic, uncompressed); */
+}
+
+/* **************************************************** */
+
+void ZMQCollectorInterface::collect_flows() {
   zmq_pollitem_t items[MAX_ZMQ_SUBSCRIBERS];
   u_int32_t zmq_max_num_polls_before_purge = MAX_ZMQ_POLLS_BEFORE_PURGE;
   u_int32_t now, next_purge_idle = (u_int32_t)time(NULL) + FLOW_PURGE_FREQUENCY;
-  int rc, size;
+  int rc;
 
   ntop->getTrace()->traceEvent(TRACE_NORMAL, "Collecting flows on %s", ifname);
 
-  if((payload = (char*)malloc(payload_len+1 /* Leave a char for \0 */)) == NULL) {
-    ntop->getTrace()->traceEvent(TRACE_ERROR, "Out of memory");
+  if(num_workers > 0) {
+    /* Messages are received and parsed by the workers */
+    collectFromWorkers();
     return;
   }
-  
+
   while(isRunning()) {
     while(idle()) {
       purgeIdle(time(NULL));
@@ -277,7 +563,6 @@ void ZMQCollectorInterface::collect_flows() {
       
       if(ntop->getGlobals()->isShutdown()) {
         ntop->getTrace()->traceEvent(TRACE_NORMAL, "Flow collection is over: ntop is shutting down");
-        free(payload);
         return;
       }
     }
@@ -292,7 +577,6 @@ void ZMQCollectorInterface::collect_flows() {
       zmq_max_num_polls_before_purge--;
 
       if(rc < 0 || !isRunning()) {
-	      if(payload) free(payload);
 	      ntop->getTrace()->traceEvent(TRACE_NORMAL, "Flow collection is over: ntop is shutting down");
         return;
       }
@@ -305,192 +589,164 @@ void ZMQCollectorInterface::collect_flows() {
     } while(rc == 0);
 
     for(int subscriber_id = 0; subscriber_id < num_subscribers; subscriber_id++) {
-      u_int32_t msg_id, last_msg_id;
-      u_int8_t source_id = 0;
-      u_int32_t publisher_version = 0;
-	
-      if(items[subscriber_id].revents & ZMQ_POLLIN) {
-	size = zmq_recv(items[subscriber_id].socket, &h0, sizeof(h0), 0);
-
-	if(size == sizeof(struct zmq_msg_hdr_v0)) {
-	  /* Legacy version */
-	  msg_id = 0, source_id = 0;
-          publisher_version = h0.version;
-
-	} else /* size == struct zmq_msg_hdr */ {
-          /* safety checks */
-          if(size != sizeof(struct zmq_msg_hdr) || (
-            h->version != ZMQ_MSG_VERSION && 
-            h->version != ZMQ_MSG_VERSION_TLV &&
-            h->version != ZMQ_COMPATIBILITY_MSG_VERSION
-          )) {
-	    ntop->getTrace()->traceEvent(TRACE_WARNING,
-				         "Unsupported publisher version: is your nProbe sender "
-					 "outdated? [%u][%u][%u][%u][%u]",
-				         size, sizeof(struct zmq_msg_hdr), h->version,
-					 ZMQ_MSG_VERSION, ZMQ_COMPATIBILITY_MSG_VERSION);
-	    continue; /* skip message */
-          }
+      ZMQCollectorMsg msg;
 
-#ifdef ZMQ_DEBUG
-	  ntop->getTrace()->traceEvent(TRACE_NORMAL, "[version: %u]", h->version);
-#endif
+      if((items[subscriber_id].revents & ZMQ_POLLIN)
+	 && recvMessage(items[subscriber_id].socket, &recv_ctx, &msg))
+	processMessage(subscriber_id, &msg);
+    } /* for */
 
-	  if(h->version == ZMQ_COMPATIBILITY_MSG_VERSION) {
-	    source_id = 0, msg_id = h->msg_id; // host byte order
-            publisher_version = h->version;
-	  } else {
-	    source_id = h->source_id, msg_id = ntohl(h->msg_id);
-            publisher_version = h->version;
-          }
-        }
+    recvStats.zmq_msg_rcvd = recv_ctx.num_msgs, recvStats.zmq_msg_drops = recv_ctx.num_msg_drops;
+  }
 
-	if(source_id_last_msg_id.find(source_id) == source_id_last_msg_id.end())
-	  source_id_last_msg_id[source_id] = 0;
+  ntop->getTrace()->traceEvent(TRACE_NORMAL, "Flow collection is over.");
+}
 
-	last_msg_id = source_id_last_msg_id[source_id];
-	
-#ifdef ZMQ_DEBUG
-	ntop->getTrace()->traceEvent(TRACE_NORMAL, "[topic: %s]", h->url);
-	ntop->getTrace()->traceEvent(TRACE_NORMAL, "[subscriber_id: %u][message source: %u]"
-				     "[msg_id: %u][last_msg_id: %u][lost: %i]",
-				     subscriber_id, source_id, msg_id, last_msg_id, msg_id - last_msg_id - 1);
-#endif
-	
-	if(msg_id > 0) {
-	  if(msg_id < last_msg_id) ; /* Start over */
-	  else if(last_msg_id > 0) {
-	    int32_t diff = msg_id - last_msg_id;
+/* **************************************************** */
 
-	    if(diff > 1) {
-	      recvStats.zmq_msg_drops += diff - 1;
+/* Called by the interface thread: flows are only processed here */
+void ZMQCollectorInterface::processItem(ZMQCollectorItem *item) {
+  if(item->flow) {
+    if(processFlow(item->flow))
+      recvStats.num_flows++;
+    else
+      num_unprocessed_flows++;
 
-#ifdef ZMQ_DEBUG
-	      ntop->getTrace()->traceEvent(TRACE_NORMAL, "[msg_id=%u][last=%u][tot_msgs=%u][drops=%u][+%u]", 
-					   msg_id, last_msg_id, recvStats.zmq_msg_rcvd, recvStats.zmq_msg_drops, diff-1);
-#endif
-	    }
-	  }
-
-	  source_id_last_msg_id[source_id] = msg_id;
-	}       
-
-	/*
-          The zmq_recv() function shall return number of bytes in the message if successful.
-          Note that the value can exceed the value of the len parameter in case the message was truncated.
-          If not successful the function shall return -1 and set errno to one of the values defined below.
-	*/
-	size = zmq_recv(items[subscriber_id].socket, payload, payload_len, 0);
-	
-	if(size > 0 && (u_int32_t)size > payload_len)
-	  ntop->getTrace()->traceEvent(TRACE_WARNING,
-				       "ZMQ message truncated? [size: %u][payload_len: %u]",
-				       size, payload_len);
-	else if(size > 0) {
-	  char *uncompressed = NULL;
-	  u_int uncompressed_len;
-          bool tlv_encoding = false;
-          bool compressed = false;
-
-	  recvStats.zmq_msg_rcvd++;
-	  payload[size] = '\0';
-	  
-          if(publisher_version == ZMQ_MSG_VERSION_TLV)
-            tlv_encoding = true;
-          else if(payload[0] == 0)
-            compressed = true;
-
-	  if(compressed /* Compressed traffic */) {
-#ifdef HAVE_ZLIB
-	    int err;
-	    uLongf uLen;
+    delete item->flow;
+  } else {
+    ZMQCollectorMsg msg;
 
-	    uLen = uncompressed_len = max(5 * size, MAX_ZMQ_FLOW_BUF);
-	    uncompressed = (char*)malloc(uncompressed_len+1);
-	    if((err = uncompress((Bytef*)uncompressed, &uLen, (Bytef*)&payload[1], size-1)) != Z_OK) {
-	      ntop->getTrace()->traceEvent(TRACE_ERROR, "Uncompress error [%d][len: %u]", err, size);
-	      continue;
-	    }
+    msg.topic = item->topic, msg.source_id = item->source_id, msg.msg_id = 0;
+    msg.tlv_encoding = false;
+    msg.buf = item->payload, msg.len = item->payload_len;
 
-	    uncompressed_len = uLen, uncompressed[uLen] = '\0';
-#else
-	    static bool once = false;
+    processMessage(item->subscriber_id, &msg);
+    free(item->payload);
+  }
+}
 
-	    if(!once)
-	      ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to uncompress ZMQ traffic: ntopng compiled without zlib"), once = true;
+/* **************************************************** */
 
-	    continue;
-#endif
-          } else if(tlv_encoding /* TLV encoding */) {
-            // ntop->getTrace()->traceEvent(TRACE_NORMAL, "TLV message over ZMQ");
-	    uncompressed = payload, uncompressed_len = size;
-	  } else /* JSON string */
-	    uncompressed = payload, uncompressed_len = size;          
-
-	  if(ntop->getPrefs()->get_zmq_encryption_pwd())
-	    Utils::xor_encdec((u_char*)uncompressed, uncompressed_len, (u_char*)ntop->getPrefs()->get_zmq_encryption_pwd());
-
-	  if(false) {
-	    ntop->getTrace()->traceEvent(TRACE_NORMAL, "[url: %s]", h->url);
-	    ntop->getTrace()->traceEvent(TRACE_NORMAL, "%s [msg_id=%u][url: %s]", uncompressed, msg_id, h->url);
-	  }
-	  
-          switch(h->url[0]) {
-          case 'e': /* event */
-            recvStats.num_events++;
-            parseEvent(uncompressed, uncompressed_len, source_id, this);
-            break;
-
-          case 'f': /* flow */
-            if(tlv_encoding) 
-              recvStats.num_flows += parseTLVFlow(uncompressed, uncompressed_len, subscriber_id, this);
-            else {
-	      uncompressed[uncompressed_len] = '\0';
-              recvStats.num_flows += parseJSONFlow(uncompressed, uncompressed_len, subscriber_id);
-	    }
-            break;
-
-          case 'c': /* counter */
-            recvStats.num_counters++;
-            parseCounter(uncompressed, uncompressed_len, subscriber_id, this);
-            break;
-
-          case 't': /* template */
-            recvStats.num_templates++;
-            parseTemplate(uncompressed, uncompressed_len, subscriber_id, this);
-            break;
-
-          case 'o': /* option */
-            recvStats.num_options++;
-            parseOption(uncompressed, uncompressed_len, subscriber_id, this);
-            break;
-
-	  case 'h': /* hello */
-	    recvStats.num_hello++;
-	    /* ntop->getTrace()->traceEvent(TRACE_NORMAL, "[HELLO] %s", uncompressed); */
-	    ntop->askToRefreshIPSRules();
-	    break;
-
-	  case 'l': /* listening-ports */
-	    recvStats.num_listening_ports++;
-	    parseListeningPorts(uncompressed, uncompressed_len, subscriber_id, this);
-	    break;
-	  }
-
-	  /* ntop->getTrace()->traceEvent(TRACE_INFO, "[%s] %s", h->url, uncompressed); */
+/* Counters of the workers are merged into recvStats by the interface thread */
+void ZMQCollectorInterface::updateWorkersStats() {
+  u_int32_t num_rcvd = 0, num_drops = 0, num_templates = 0, num_invalid = 0;
 
-#ifdef HAVE_ZLIB
-	  if(compressed /* only if the traffic was actually compressed */)
-	    if(uncompressed) free(uncompressed);
-#endif
-	} /* size > 0 */
-      }
-    } /* for */
+  for(u_int8_t i = 0; i < num_workers; i++) {
+    num_rcvd += workers[i]->getNumMsgs();
+    num_drops += workers[i]->getNumMsgDrops();
+    num_templates += workers[i]->getNumTemplates();
+    num_invalid += workers[i]->getNumInvalidFlows();
+  }
+
+  recvStats.zmq_msg_rcvd = num_rcvd, recvStats.zmq_msg_drops = num_drops;
+  recvStats.num_templates = num_templates;
+  recvStats.num_dropped_flows = num_unprocessed_flows + num_invalid;
+}
+
+/* **************************************************** */
+
+void ZMQCollectorInterface::collectFromWorkers() {
+  ZMQCollectorItem items[ZMQ_COLLECTOR_DEQUEUE_BATCH];
+  time_t now, last_idle_purge = 0;
+
+  while(isRunning()) {
+    u_int32_t num_items = 0;
+
+    while(idle()) {
+      purgeIdle(time(NULL));
+      sleep(1);
+
+      if(ntop->getGlobals()->isShutdown())
+	break;
+    }
+
+    if(ntop->getGlobals()->isShutdown())
+      break;
+
+    /* Visit the workers in turn so that a busy one can't starve the others */
+    for(u_int8_t i = 0; i < num_workers; i++) {
+      u_int32_t n = workers[i]->dequeueBatch(items, ZMQ_COLLECTOR_DEQUEUE_BATCH);
+
+      for(u_int32_t j = 0; j < n; j++)
+	processItem(&items[j]);
+
+      num_items += n;
+    }
+
+    now = time(NULL);
+
+    if(now != last_idle_purge) {
+      updateWorkersStats();
+      purgeIdle(now);
+      last_idle_purge = now;
+    }
+
+    if(num_items == 0)
+      _usleep(100);
   }
 
   ntop->getTrace()->traceEvent(TRACE_NORMAL, "Flow collection is over.");
 
-  if(payload) free(payload);
+  stopWorkers();
+}
+
+/* **************************************************** */
+
+void ZMQCollectorInterface::startWorkers() {
+  u_int8_t n = min_val(ntop->getPrefs()->get_num_zmq_collector_workers(), num_subscribers);
+
+  /* Endpoints are assigned round-robin: a socket is only used by its worker */
+  for(u_int8_t i = 0; i < n; i++) {
+    if((workers[num_workers] = new (std::nothrow) ZMQCollectorWorker(this, i)) == NULL)
+      break;
+
+    for(u_int8_t s = i; s < num_subscribers; s += n)
+      workers[num_workers]->addSubscriber(s);
+
+    num_workers++;
+  }
+
+  for(u_int8_t i = 0; i < num_workers; i++) {
+    if(!workers[i]->startWorker()) {
+      ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to start the ZMQ collector workers");
+
+      /* Fallback to receiving on the interface thread */
+      stopWorkers();
+
+      for(u_int8_t j = 0; j < num_workers; j++)
+	delete workers[j];
+
+      num_workers = 0;
+      return;
+    }
+  }
+
+  if(num_workers > 0)
+    ntop->getTrace()->traceEvent(TRACE_NORMAL, "Receiving %u ZMQ endpoint(s) with %u worker(s) on %s",
+				 num_subscribers, num_workers, ifname);
+}
+
+/* **************************************************** */
+
+/*
+  Waits for the workers to terminate and releases what they have not handed
+  over. Workers are deleted with the interface as Lua can still read them.
+*/
+void ZMQCollectorInterface::stopWorkers() {
+  ZMQCollectorItem items[ZMQ_COLLECTOR_DEQUEUE_BATCH];
+
+  for(u_int8_t i = 0; i < num_workers; i++) {
+    u_int32_t n;
+
+    workers[i]->stopWorker();
+
+    while((n = workers[i]->dequeueBatch(items, ZMQ_COLLECTOR_DEQUEUE_BATCH)) > 0) {
+      for(u_int32_t j = 0; j < n; j++) {
+	if(items[j].flow) delete items[j].flow;
+	if(items[j].payload) free(items[j].payload);
+      }
+    }
+  }
 }
 
 /* **************************************************** */
@@ -508,6 +764,9 @@ static void* packetPollLoop(void* ptr) {
 /* **************************************************** */
 
 void ZMQCollectorInterface::startPacketPolling() {
+  if(ntop->getPrefs()->get_num_zmq_collector_workers() > 0)
+    startWorkers();
+
   pthread_create(&pollLoop, NULL, packetPollLoop, (void*)this);
   pollLoopCreated = true;
   NetworkInterface::startPacketPolling();
@@ -524,6 +783,16 @@ bool ZMQCollectorInterface::set_packet_filter(char *filter) {
 /* **************************************************** */
 
 void ZMQCollectorInterface::lua(lua_State* vm) {
+  u_int64_t num_bytes = recv_ctx.num_bytes, num_bytes_copied = recv_ctx.num_bytes_copied;
+  u_int64_t num_decompressed = recv_ctx.num_decompressed, decompress_ticks = recv_ctx.decompress_ticks;
+
+  for(u_int8_t i = 0; i < num_workers; i++) {
+    const ZMQRecvContext *ctx = workers[i]->getRecvContext();
+
+    num_bytes += ctx->num_bytes, num_bytes_copied += workers[i]->getNumBytesCopied();
+    num_decompressed += ctx->num_decompressed, decompress_ticks += ctx->decompress_ticks;
+  }
+
   ZMQParserInterface::lua(vm);
 
   lua_newtable(vm);
@@ -533,6 +802,14 @@ void ZMQCollectorInterface::lua(lua_State* vm) {
   lua_push_uint64_table_entry(vm, "counters", recvStats.num_counters);
   lua_push_uint64_table_entry(vm, "zmq_msg_rcvd", recvStats.zmq_msg_rcvd);
   lua_push_uint64_table_entry(vm, "zmq_msg_drops", recvStats.zmq_msg_drops);
+  lua_push_uint64_table_entry(vm, "zmq_bytes_rcvd", num_bytes);
+  /* Payload bytes copied before parsing: 0 when decoded in place */
+  lua_push_uint64_table_entry(vm, "bytes_copied", num_bytes_copied);
+  lua_push_float_table_entry(vm, "bytes_copied_per_flow",
+			     recvStats.num_flows ? (float)num_bytes_copied / recvStats.num_flows : 0);
+  lua_push_uint64_table_entry(vm, "decompressed_msgs", num_decompressed);
+  lua_push_uint64_table_entry(vm, "decompress_cycles", decompress_ticks);
+  lua_push_uint64_table_entry(vm, "avg_decompress_cycles", num_decompressed ? decompress_ticks / num_decompressed : 0);
   lua_pushstring(vm, "zmqRecvStats");
   lua_insert(vm, -2);
   lua_settable(vm, -3);
@@ -548,6 +825,17 @@ void ZMQCollectorInterface::lua(lua_State* vm) {
   lua_insert(vm, -2);
   lua_settable(vm, -3);
 
+  if(num_workers > 0) {
+    lua_newtable(vm);
+
+    for(u_int8_t i = 0; i < num_workers; i++)
+      workers[i]->lua(vm);
+
+    lua_pushstring(vm, "zmqWorkers");
+    lua_insert(vm, -2);
+    lua_settable(vm, -3);
+  }
+
   if(ntop->getPrefs()->is_zmq_encryption_enabled() && strlen(server_public_key) > 0) {
     lua_newtable(vm);
     lua_push_str_table_entry(vm, "public_key", server_public_key);
@@ -0,0 +1,255 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "ntop_includes.h"
+
+#ifndef HAVE_NEDGE
+
+/* ************************************ */
+
+ZMQCollectorWorker::ZMQCollectorWorker(ZMQCollectorInterface *_iface, u_int8_t _worker_id) {
+  char buf[32];
+
+  iface = _iface, worker_id = _worker_id, num_subscribers = 0;
+  workerLoopCreated = false, stopRequested = false;
+  num_templates = 0;
+  num_flows = num_queue_full = 0;
+  last_rate_update = 0, last_num_msgs = 0, last_num_flows = 0;
+  msgs_rate = flows_rate = 0;
+
+  snprintf(buf, sizeof(buf), "zmqWorker%u", worker_id);
+  queue = new (std::nothrow) SPSCQueue<ZMQCollectorItem>(ZMQ_COLLECTOR_QUEUE_LEN, buf);
+
+  /* Parsed flows are collected here instead of being processed */
+  parser_ctx.parsed_flows = &parsed_flows;
+}
+
+/* ************************************ */
+
+ZMQCollectorWorker::~ZMQCollectorWorker() {
+  stopWorker();
+
+  if(queue) delete queue;
+}
+
+/* ************************************ */
+
+/*
+  Called by the worker (single producer). The worker waits for room rather
+  than dropping what it has already received: if the interface thread does
+  not keep up, the ZMQ socket buffers fill and drops show up as message
+  drops (msg_id gaps).
+*/
+bool ZMQCollectorWorker::enqueue(ZMQCollectorItem *item) {
+  if(queue->enqueue(*item, false))
+    return(true);
+
+  num_queue_full++;
+  queue->flush();
+
+  while(!stopRequested) {
+    _usleep(100);
+
+    if(queue->enqueue(*item, false))
+      return(true);
+  }
+
+  return(false);
+}
+
+/* ************************************ */
+
+void ZMQCollectorWorker::handleMessage(u_int8_t subscriber_id, ZMQCollectorMsg *msg) {
+  ZMQCollectorItem item;
+
+  memset(&item, 0, sizeof(item));
+  item.subscriber_id = subscriber_id, item.source_id = msg->source_id, item.topic = msg->topic;
+
+  switch(msg->topic) {
+  case 'f': /* flow */
+    if(msg->tlv_encoding)
+      iface->parseTLVFlow(msg->buf, msg->len, subscriber_id, &parser_ctx);
+    else
+      iface->parseJSONFlow(msg->buf, msg->len, subscriber_id, &parser_ctx);
+
+    for(std::vector<ParsedFlow*>::const_iterator it = parsed_flows.begin(); it != parsed_flows.end(); ++it) {
+      item.flow = *it;
+
+      if(!enqueue(&item))
+	delete item.flow; /* Shutting down */
+    }
+
+    num_flows += parsed_flows.size();
+    parsed_flows.clear();
+    break;
+
+  case 't': /* template */
+    num_templates++;
+    iface->parseTemplate(msg->buf, msg->len, subscriber_id, iface);
+    break;
+
+  default:
+    /*
+      Events, counters... are parsed by the interface thread, in order with
+      the flows: msg->buf is reused by the next message, hand over a copy
+    */
+    if((item.payload = (char*)malloc(msg->len + 1)) != NULL) {
+      memcpy(item.payload, msg->buf, msg->len + 1 /* NUL */);
+      item.payload_len = msg->len;
+      recv_ctx.num_bytes_copied += msg->len;
+
+      if(!enqueue(&item))
+	free(item.payload);
+    }
+    break;
+  }
+
+  /* The flows of a message are handed over as a batch */
+  queue->flush();
+}
+
+/* ************************************ */
+
+void ZMQCollectorWorker::updateRates(time_t now) {
+  if(last_rate_update && (now > last_rate_update)) {
+    float elapsed = (float)(now - last_rate_update);
+
+    msgs_rate = (recv_ctx.num_msgs - last_num_msgs) / elapsed;
+    flows_rate = (num_flows - last_num_flows) / elapsed;
+  }
+
+  last_rate_update = now, last_num_msgs = recv_ctx.num_msgs, last_num_flows = num_flows;
+}
+
+/* ************************************ */
+
+void ZMQCollectorWorker::receiveLoop() {
+  zmq_pollitem_t items[MAX_ZMQ_SUBSCRIBERS];
+  time_t now;
+  int rc;
+
+  for(u_int8_t i = 0; i < num_subscribers; i++)
+    items[i].socket = iface->getSocket(subscriber_ids[i]), items[i].fd = 0, items[i].events = ZMQ_POLLIN;
+
+  while(!stopRequested) {
+    for(u_int8_t i = 0; i < num_subscribers; i++)
+      items[i].revents = 0;
+
+    rc = zmq_poll(items, num_subscribers, MAX_ZMQ_POLL_WAIT_MS);
+
+    if(rc < 0) {
+      if(errno == EINTR) continue;
+      break; /* Context terminated */
+    }
+
+    now = time(NULL);
+    if(now != last_rate_update)
+      updateRates(now);
+
+    for(u_int8_t i = 0; i < num_subscribers; i++) {
+      ZMQCollectorMsg msg;
+
+      if((items[i].revents & ZMQ_POLLIN)
+	 && iface->recvMessage(items[i].socket, &recv_ctx, &msg))
+	handleMessage(subscriber_ids[i], &msg);
+    }
+  }
+}
+
+/* ************************************ */
+
+static void* zmqCollectorWorkerLoop(void *ptr) {
+  ((ZMQCollectorWorker*)ptr)->receiveLoop();
+  return(NULL);
+}
+
+/* ************************************ */
+
+bool ZMQCollectorWorker::startWorker() {
+  if(!queue || (num_subscribers == 0))
+    return(false);
+
+  if(pthread_create(&workerLoop, NULL, zmqCollectorWorkerLoop, (void*)this) != 0)
+    return(false);
+
+  workerLoopCreated = true;
+
+#ifdef __linux__
+  char buf[16];
+
+  snprintf(buf, sizeof(buf), "%u/zmq_worker%u", iface->get_id(), worker_id);
+  pthread_setname_np(workerLoop, buf);
+#endif
+
+  return(true);
+}
+
+/* ************************************ */
+
+/* Waits for the worker to terminate (within MAX_ZMQ_POLL_WAIT_MS) */
+void ZMQCollectorWorker::stopWorker() {
+  void *res;
+
+  if(workerLoopCreated) {
+    stopRequested = true;
+    pthread_join(workerLoop, &res);
+    workerLoopCreated = false;
+  }
+}
+
+/* ************************************ */
+
+void ZMQCollectorWorker::lua(lua_State *vm) const {
+  lua_newtable(vm);
+
+  lua_newtable(vm);
+  for(u_int8_t i = 0; i < num_subscribers; i++) {
+    lua_pushinteger(vm, i + 1);
+    lua_pushstring(vm, iface->getEndpoint(subscriber_ids[i]));
+    lua_settable(vm, -3);
+  }
+  lua_pushstring(vm, "endpoints");
+  lua_insert(vm, -2);
+  lua_settable(vm, -3);
+
+  lua_push_uint64_table_entry(vm, "msgs", recv_ctx.num_msgs);
+  lua_push_uint64_table_entry(vm, "bytes", recv_ctx.num_bytes);
+  lua_push_uint64_table_entry(vm, "bytes_copied", getNumBytesCopied());
+  lua_push_uint64_table_entry(vm, "decompressed_msgs", recv_ctx.num_decompressed);
+  lua_push_uint64_table_entry(vm, "decompress_cycles", recv_ctx.decompress_ticks);
+  lua_push_uint64_table_entry(vm, "flows", num_flows);
+  lua_push_uint64_table_entry(vm, "templates", num_templates);
+  lua_push_uint64_table_entry(vm, "msg_drops", recv_ctx.num_msg_drops);
+  lua_push_uint64_table_entry(vm, "invalid_flows", parser_ctx.num_invalid_flows);
+  lua_push_uint64_table_entry(vm, "queue_full", num_queue_full);
+  lua_push_float_table_entry(vm, "msgs_per_sec", msgs_rate);
+  lua_push_float_table_entry(vm, "flows_per_sec", flows_rate);
+
+  if(queue) queue->lua(vm);
+
+  lua_pushinteger(vm, worker_id);
+  lua_insert(vm, -2);
+  lua_settable(vm, -3);
+}
+
+/* ************************************ */
+
+#endif /* HAVE_NEDGE */
@@ -37,6 +37,7 @@ ZMQParserInterface::ZMQParserInterface(const char *endpoint, const char *custom_
   remote_lifetime_timeout = remote_idle_timeout = 0;
   once = false, is_sampled_traffic = false;
   flow_max_idle = ntop->getPrefs()->get_pkt_ifaces_flow_max_idle();
+  labels_hash = NULL, labels_hash_dirty = false;
 #ifdef NTOPNG_PRO
   custom_app_maps = NULL;
 #endif
@@ -125,6 +126,8 @@ ZMQParserInterface::ZMQParserInterface(const char *endpoint, const char *custom_
   addMapping("SERVER_NW_LATENCY_MS", SERVER_NW_LATENCY_MS, NTOP_PEN);
   addMapping("L7_PROTO_RISK", L7_PROTO_RISK, NTOP_PEN);
   addMapping("FLOW_VERDICT", FLOW_VERDICT, NTOP_PEN);
+
+  updateLabelsHash();
 }
 
 /* **************************************************** */
@@ -134,6 +137,7 @@ ZMQParserInterface::~ZMQParserInterface() {
 
   if(zmq_remote_stats)        free(zmq_remote_stats);
   if(zmq_remote_stats_shadow) free(zmq_remote_stats_shadow);
+  if(labels_hash)             delete(labels_hash);
 #ifdef NTOPNG_PRO
   if(custom_app_maps)         delete(custom_app_maps);
 #endif
@@ -152,9 +156,9 @@ void ZMQParserInterface::addMapping(const char *sym, u_int32_t num, u_int32_t pe
   pen_value_t cur_pair = make_pair(pen, num);
 
   if((it = labels_map.find(label)) == labels_map.end())
-    labels_map.insert(make_pair(label, cur_pair));
-  else
-    it->second.first = pen, it->second.second = num;
+    labels_map.insert(make_pair(label, cur_pair)), labels_hash_dirty = true;
+  else if(it->second != cur_pair)
+    it->second.first = pen, it->second.second = num, labels_hash_dirty = true;
 
   if(descr) {
     descriptions_map_t::iterator dit;
@@ -166,10 +170,37 @@ void ZMQParserInterface::addMapping(const char *sym, u_int32_t num, u_int32_t pe
 
 /* **************************************************** */
 
+/* Compiles labels_map into a perfect hash. Called with labels_lock write locked
+   (or from the constructor): every getKeyId() caller holds the read lock */
+void ZMQParserInterface::updateLabelsHash() {
+  std::vector<std::pair<std::string, u_int64_t> > entries;
+  PerfectHash *h;
+
+  entries.reserve(labels_map.size());
+
+  for(labels_map_t::const_iterator it = labels_map.begin(); it != labels_map.end(); ++it)
+    entries.push_back(make_pair(it->first, ((u_int64_t)it->second.first << 32) | it->second.second));
+
+  if((h = new (std::nothrow) PerfectHash()) == NULL)
+    return;
+
+  if(!h->build(entries)) {
+    ntop->getTrace()->traceEvent(TRACE_WARNING, "Unable to build the labels hash [%u labels]", (u_int32_t)entries.size());
+    delete h;
+    return; /* labels_hash_dirty stays set, falling back to labels_map */
+  }
+
+  if(labels_hash) delete labels_hash;
+  labels_hash = h;
+  labels_hash_dirty = false;
+}
+
+/* **************************************************** */
+
 bool ZMQParserInterface::getKeyId(char *sym, u_int32_t sym_len, u_int32_t * const pen, u_int32_t * const field) const {
   u_int32_t cur_pen, cur_field;
-  string label(sym);
   labels_map_t::const_iterator it;
+  u_int64_t pen_field;
   bool is_num, is_dotted;
 
   *pen = UNKNOWN_PEN, *field = UNKNOWN_FLOW_ELEMENT;
@@ -183,7 +214,11 @@ bool ZMQParserInterface::getKeyId(char *sym, u_int32_t sym_len, u_int32_t * cons
   } else if(is_num) {
     cur_field = atoi(sym);
     *pen = 0, *field = cur_field;
-  } else if((it = labels_map.find(label)) != labels_map.end()) {
+  } else if(labels_hash && !labels_hash_dirty) {
+    if(!labels_hash->find(sym, sym_len, &pen_field))
+      return false;
+    *pen = pen_field >> 32, *field = pen_field & 0xFFFFFFFF;
+  } else if((it = labels_map.find(string(sym, sym_len))) != labels_map.end()) {
     *pen = it->second.first, *field = it->second.second;
   } else {
     return false;
@@ -205,6 +240,22 @@ const char* ZMQParserInterface::getKeyDescription(u_int32_t pen, u_int32_t field
 
 /* **************************************************** */
 
+const char* ZMQParserInterface::lookupKeyDescription(const char *key) {
+  u_int32_t pen, field;
+  const char *descr = NULL;
+
+  labels_lock.rdlock(__FILE__, __LINE__);
+
+  if(getKeyId((char*)key, strlen(key), &pen, &field))
+    descr = getKeyDescription(pen, field); /* Descriptions are never removed */
+
+  labels_lock.unlock(__FILE__, __LINE__);
+
+  return(descr);
+}
+
+/* **************************************************** */
+
 u_int8_t ZMQParserInterface::parseEvent(const char * payload, int payload_size,
 					u_int8_t source_id, void *data) {
   json_object *o;
@@ -1196,7 +1247,7 @@ bool ZMQParserInterface::parseNProbeAgentField(ParsedFlow * const flow, const ch
 
 /* **************************************************** */
 
-bool ZMQParserInterface::preprocessFlow(ParsedFlow *flow) {
+bool ZMQParserInterface::preprocessFlow(ParsedFlow *flow, ZMQParserContext *ctx) {
   bool invalid_flow = false;
   bool rc = false;
 
@@ -1327,135 +1378,177 @@ bool ZMQParserInterface::preprocessFlow(ParsedFlow *flow) {
     }
 #endif
 
-    /* Process Flow */
-    PROFILING_SECTION_ENTER("processFlow", 30);
-    rc = processFlow(flow);
-    PROFILING_SECTION_EXIT(30);
+    if(ctx->parsed_flows) {
+      /* Processed later by the interface thread (see ZMQCollectorWorker) */
+      ParsedFlow *copy = new (std::nothrow) ParsedFlow(*flow);
+
+      if(copy) {
+	copy->setAdditionalFieldsTLV(flow->getAdditionalFieldsTLV());
+	ctx->parsed_flows->push_back(copy);
+	rc = true;
+      }
+    } else {
+      /* Process Flow */
+      PROFILING_SECTION_ENTER("processFlow", 30);
+      rc = processFlow(flow);
+      PROFILING_SECTION_EXIT(30);
+    }
   }
 
-  if(!rc)
-    recvStats.num_dropped_flows++;
+  if(!rc) {
+    if(ctx->parsed_flows)
+      ctx->num_invalid_flows++;
+    else
+      recvStats.num_dropped_flows++;
+  }
 
   return rc;
 }
 
 /* **************************************************** */
 
-int ZMQParserInterface::parseSingleJSONFlow(json_object *o, u_int8_t source_id) {
+json_object* ZMQParserInterface::getJSONValue(const json_scanner_value_t *v, ZMQParserContext *ctx) {
+  json_object *o = JSONScanner::toJSONObject(v, ctx->json_tok);
+
+  /* Kept alive as the flow can point to its strings until it is processed */
+  if(o) ctx->json_values.push_back(o);
+
+  return(o);
+}
+
+/* **************************************************** */
+
+void ZMQParserInterface::releaseJSONValues(ZMQParserContext *ctx) {
+  for(std::vector<json_object*>::const_iterator it = ctx->json_values.begin(); it != ctx->json_values.end(); ++it)
+    json_object_put(*it);
+
+  ctx->json_values.clear();
+}
+
+/* **************************************************** */
+
+/* json additional object added by Flow::serialize() */
+void ZMQParserInterface::parseAdditionalJSON(ParsedFlow * const flow, char *json, u_int32_t json_len) const {
+  JSONScanner scanner(json, json_len);
+  json_scanner_value_t v;
+  char *key;
+  u_int32_t key_len;
+
+  if(!scanner.enterObject())
+    return;
+
+  while(scanner.nextMember(&key, &key_len) && scanner.readValue(&v)) {
+    if(v.type == json_scanner_null)
+      continue;
+
+    //ntop->getTrace()->traceEvent(TRACE_NORMAL, "Additional field: %s", key);
+    flow->addAdditionalField(key, (v.type == json_scanner_string)
+			     ? json_object_new_string_len(v.string, v.len)
+			     : json_object_new_string_len(v.raw, v.len));
+  }
+}
+
+/* **************************************************** */
+
+int ZMQParserInterface::parseSingleJSONFlow(JSONScanner *scanner, u_int8_t source_id, ZMQParserContext *ctx) {
   ParsedFlow flow;
-  struct json_object_iterator it = json_object_iter_begin(o);
-  struct json_object_iterator itEnd = json_object_iter_end(o);
+  char *key;
+  u_int32_t key_len;
   int ret = 0;
 
   /* Reset data */
   flow.source_id = source_id;
   flow.direction = UNKNOWN_FLOW_DIRECTION;
-  
-  while(!json_object_iter_equal(&it, &itEnd)) {
-    const char *key     = json_object_iter_peek_name(&it);
-    json_object *jvalue = json_object_iter_peek_value(&it);
-    json_object *additional_o = NULL;
-    enum json_type type = json_object_get_type(jvalue);
+
+  if(!scanner->enterObject())
+    return(0);
+
+  while(scanner->nextMember(&key, &key_len)) {
+    json_scanner_value_t jvalue;
+    json_object *jobj = NULL; /* Built only when a json-c object is actually needed */
     ParsedValue value = { 0 };
     bool add_to_additional_fields = false;
+    u_int32_t pen, key_id;
+    bool res;
+
+    if(!scanner->readValue(&jvalue))
+      break;
 
-    switch(type) {
-    case json_type_int:
-      value.int_num = json_object_get_int64(jvalue);
+    switch(jvalue.type) {
+    case json_scanner_int:
+      value.int_num = jvalue.int_num;
       value.double_num = value.int_num;
       break;
-    case json_type_double:
-      value.double_num = json_object_get_double(jvalue);
+    case json_scanner_double:
+      value.double_num = jvalue.double_num;
       break;
-    case json_type_string:
-      value.string = json_object_get_string(jvalue);
-      if(strcmp(key,"json") == 0)
-	additional_o = json_tokener_parse(value.string);
+    case json_scanner_string:
+      value.string = jvalue.string;
       break;
-    case json_type_object:
+    case json_scanner_object:
       /* This is handled by parseNProbeAgentField or addAdditionalField */
       break;
     default:
-      ntop->getTrace()->traceEvent(TRACE_WARNING, "JSON type %u not supported [key: %s]\n", type, key);
+      ntop->getTrace()->traceEvent(TRACE_WARNING, "JSON type %s not supported [key: %s]\n",
+				   JSONScanner::getTypeName(jvalue.type), key);
       break;
     }
 
-    if((key != NULL) && (jvalue != NULL)) {
-      u_int32_t pen, key_id;
-      bool res;
+    if(jvalue.type == json_scanner_null)
+      continue;
 
-      getKeyId((char*)key, strlen(key), &pen, &key_id);
+    getKeyId(key, key_len, &pen, &key_id);
 
-      switch(pen) {
-      case 0: /* No PEN */
-	res = parsePENZeroField(&flow, key_id, &value);
-	if(res)
-	  break;
-	/* Dont'break when res == false for backward compatibility: attempt to parse Zero-PEN as Ntop-PEN */
-      case NTOP_PEN:
-	res = parsePENNtopField(&flow, key_id, &value);
-	break;
-      case UNKNOWN_PEN:
-      default:
-	res = false;
+    switch(pen) {
+    case 0: /* No PEN */
+      res = parsePENZeroField(&flow, key_id, &value);
+      if(res)
 	break;
-      }
+      /* Dont'break when res == false for backward compatibility: attempt to parse Zero-PEN as Ntop-PEN */
+    case NTOP_PEN:
+      res = parsePENNtopField(&flow, key_id, &value);
+      break;
+    case UNKNOWN_PEN:
+    default:
+      res = false;
+      break;
+    }
 
-      if(!res) {
-	switch(key_id) {
-	case 0: //json additional object added by Flow::serialize()
-	  if(additional_o != NULL) {
-	    struct json_object_iterator additional_it = json_object_iter_begin(additional_o);
-	    struct json_object_iterator additional_itEnd = json_object_iter_end(additional_o);
-
-	    while(!json_object_iter_equal(&additional_it, &additional_itEnd)) {
-
-	      const char *additional_key   = json_object_iter_peek_name(&additional_it);
-	      json_object *additional_v    = json_object_iter_peek_value(&additional_it);
-	      const char *additional_value = json_object_get_string(additional_v);
-
-	      if((additional_key != NULL) && (additional_value != NULL)) {
-                //ntop->getTrace()->traceEvent(TRACE_NORMAL, "Additional field: %s", additional_key);
-		flow.addAdditionalField(additional_key,
-				        json_object_new_string(additional_value));
-	      }
-	      json_object_iter_next(&additional_it);
-	    }
+    if(!res) {
+      switch(key_id) {
+      case 0: //json additional object added by Flow::serialize()
+	if((jvalue.type == json_scanner_string) && (strcmp(key, "json") == 0))
+	  parseAdditionalJSON(&flow, jvalue.string, jvalue.len);
+	break;
+      case UNKNOWN_FLOW_ELEMENT:
+	/* Attempt to parse it as an nProbe mini field */
+	jobj = getJSONValue(&jvalue, ctx);
+	if(parseNProbeAgentField(&flow, key, &value, jobj)) {
+	  if(!flow.hasParsedeBPF()) {
+	    flow.setParsedeBPF();
+	    flow.absolute_packet_octet_counters = true;
 	  }
 	  break;
-	case UNKNOWN_FLOW_ELEMENT:
-	  /* Attempt to parse it as an nProbe mini field */
-	  if(parseNProbeAgentField(&flow, key, &value, jvalue)) {
-	    if(!flow.hasParsedeBPF()) {
-	      flow.setParsedeBPF();
-	      flow.absolute_packet_octet_counters = true;
-	    }
-	    break;
-	  }
-	default:
+	}
+      default:
 #ifdef NTOPNG_PRO
-	  if(custom_app_maps || (custom_app_maps = new(std::nothrow) CustomAppMaps()))
-	    custom_app_maps->checkCustomApp(key, &value, &flow);
+	if(custom_app_maps || (custom_app_maps = new(std::nothrow) CustomAppMaps()))
+	  custom_app_maps->checkCustomApp(key, &value, &flow);
 #endif
-	  ntop->getTrace()->traceEvent(TRACE_DEBUG, "Not handled ZMQ field %u/%s", key_id, key);
-	  add_to_additional_fields = true;
-	  break;
-	} /* switch */
-      }
-
-      if(add_to_additional_fields) {
-        //ntop->getTrace()->traceEvent(TRACE_NORMAL, "Additional field: %s", key);
-	flow.addAdditionalField(key, json_object_get(jvalue));
-      }
-
-      if(additional_o) json_object_put(additional_o);
-    } /* if */
+	ntop->getTrace()->traceEvent(TRACE_DEBUG, "Not handled ZMQ field %u/%s", key_id, key);
+	add_to_additional_fields = true;
+	break;
+      } /* switch */
+    }
 
-    /* Move to the next element */
-    json_object_iter_next(&it);
-  } // while json_object_iter_equal
+    if(add_to_additional_fields && (jobj || (jobj = getJSONValue(&jvalue, ctx)))) {
+      //ntop->getTrace()->traceEvent(TRACE_NORMAL, "Additional field: %s", key);
+      flow.addAdditionalField(key, json_object_get(jobj));
+    }
+  } /* while */
 
-  if(preprocessFlow(&flow))
+  /* A truncated or malformed flow is discarded */
+  if(!scanner->hasFailed() && preprocessFlow(&flow, ctx))
     ret = 1;
 
   return ret;
@@ -1464,7 +1557,7 @@ int ZMQParserInterface::parseSingleJSONFlow(json_object *o, u_int8_t source_id)
 /* **************************************************** */
 
 int ZMQParserInterface::parseSingleTLVFlow(ndpi_deserializer *deserializer,
-					   u_int8_t source_id) {
+					   u_int8_t source_id, ZMQParserContext *ctx) {
   ndpi_serialization_type kt, et;
   ParsedFlow flow;
   int ret = 0, rc;
@@ -1678,7 +1771,7 @@ int ZMQParserInterface::parseSingleTLVFlow(ndpi_deserializer *deserializer,
   if(recordFound) {
     PROFILING_SECTION_EXIT(9); /* Closes Decode TLV */
     PROFILING_SECTION_ENTER("processFlow", 10);
-    if(preprocessFlow(&flow))
+    if(preprocessFlow(&flow, ctx))
       ret = 1;
     PROFILING_SECTION_EXIT(10);
   }
@@ -1689,61 +1782,75 @@ int ZMQParserInterface::parseSingleTLVFlow(ndpi_deserializer *deserializer,
 
 /* **************************************************** */
 
-u_int8_t ZMQParserInterface::parseJSONFlow(const char * payload, int payload_size, u_int8_t source_id) {
-  json_object *f;
-  enum json_tokener_error jerr = json_tokener_success;
+/* Keys and strings are unescaped over payload, that does not need to be NUL terminated */
+u_int8_t ZMQParserInterface::parseJSONFlow(char * payload, int payload_size, u_int8_t source_id, ZMQParserContext *ctx) {
+  u_int32_t len = (payload_size > 0) ? payload_size : 0;
 
 #if 0
-  ntop->getTrace()->traceEvent(TRACE_NORMAL, "JSON: '%s' [len=%lu]", payload, strlen(payload));
-  printf("\n\n%s\n\n", payload);
+  ntop->getTrace()->traceEvent(TRACE_NORMAL, "JSON: '%.*s' [len=%u]", len, payload, len);
 #endif
 
-  f = json_tokener_parse_verbose(payload, &jerr);
+  /* Senders may include the trailing NUL */
+  while((len > 0) && ((payload[len - 1] == '\0') || isspace(payload[len - 1])))
+    len--;
 
-  if(f != NULL) {
-    int n = 0, rc;
+  if(len == 0)
+    return 0;
 
-    if(json_object_get_type(f) == json_type_array) {
-      /* Flow array */
-      int id, num_elements = json_object_array_length(f);
+  return(scanJSONFlow(payload, len, source_id, ctx));
+}
 
-      for(id = 0; id < num_elements; id++) {
-	rc = parseSingleJSONFlow(json_object_array_get_idx(f, id), source_id);
+/* **************************************************** */
 
-        if(rc > 0)
-          n++;
-      }
+u_int8_t ZMQParserInterface::scanJSONFlow(char *payload, u_int32_t payload_len, u_int8_t source_id, ZMQParserContext *ctx) {
+  JSONScanner scanner(payload, payload_len);
+  int n = 0, rc;
+  char c;
 
-    } else {
-      rc = parseSingleJSONFlow(f, source_id);
+  labels_lock.rdlock(__FILE__, __LINE__);
+
+  if((c = scanner.peek()) == '[') {
+    /* Flow array */
+    scanner.enterArray();
+
+    while(scanner.nextElement()) {
+      rc = parseSingleJSONFlow(&scanner, source_id, ctx);
+      releaseJSONValues(ctx);
 
       if(rc > 0)
-        n++;
+	n++;
     }
+  } else if(c == '{') {
+    rc = parseSingleJSONFlow(&scanner, source_id, ctx);
+    releaseJSONValues(ctx);
 
-    json_object_put(f);
-    return n;
-  } else {
-    // if o != NULL
+    if(rc > 0)
+      n++;
+  } else
+    scanner.enterObject(); /* Flags the error */
+
+  labels_lock.unlock(__FILE__, __LINE__);
+
+  if(scanner.hasFailed()) {
     if(!once) {
       ntop->getTrace()->traceEvent(TRACE_WARNING,
 				   "Invalid message received: your nProbe sender is outdated, data encrypted or invalid JSON?");
-      ntop->getTrace()->traceEvent(TRACE_WARNING, "JSON Parse error [%s] payload size: %u payload: %s",
-				   json_tokener_error_desc(jerr),
-				   payload_size,
-				   payload);
+      /* Strings before the offset have been unescaped in place: only what follows is still as received */
+      ntop->getTrace()->traceEvent(TRACE_WARNING, "JSON Parse error [offset: %u] payload size: %u near: %.*s",
+				   scanner.getOffset(),
+				   payload_len,
+				   (int)min_val(payload_len - scanner.getOffset(), 64u), &payload[scanner.getOffset()]);
     }
 
     once = true;
-    return 0;
   }
 
-  return 0;
+  return n;
 }
 
 /* **************************************************** */
 
-u_int8_t ZMQParserInterface::parseTLVFlow(const char * payload, int payload_size, u_int8_t source_id, void *data) {
+u_int8_t ZMQParserInterface::parseTLVFlow(const char * payload, int payload_size, u_int8_t source_id, ZMQParserContext *ctx) {
   ndpi_deserializer deserializer;
   ndpi_serialization_type kt;
   int n = 0, rc;
@@ -1763,8 +1870,10 @@ u_int8_t ZMQParserInterface::parseTLVFlow(const char * payload, int payload_size
     return 0;
   }
 
+  labels_lock.rdlock(__FILE__, __LINE__);
+
   while(ndpi_deserialize_get_item_type(&deserializer, &kt) != ndpi_serialization_unknown) {
-    rc = parseSingleTLVFlow(&deserializer, source_id);
+    rc = parseSingleTLVFlow(&deserializer, source_id, ctx);
 
     if(rc < 0)
       break;
@@ -1772,6 +1881,8 @@ u_int8_t ZMQParserInterface::parseTLVFlow(const char * payload, int payload_size
       n++;
   }
 
+  labels_lock.unlock(__FILE__, __LINE__);
+
   return n;
 }
 
@@ -1912,6 +2023,9 @@ u_int8_t ZMQParserInterface::parseTemplate(const char * payload, int payload_siz
   obj = json_tokener_parse_verbose(payload, &jerr);
 
   if(obj) {
+    /* Flows can be parsed meanwhile by the ZMQ collector workers */
+    labels_lock.wrlock(__FILE__, __LINE__);
+
     if(json_object_get_type(obj) == json_type_array) {
       int i, num_elements = json_object_array_length(obj);
       std::set<std::string> mandatory_fields(mandatory_template_fields,
@@ -1948,6 +2062,9 @@ u_int8_t ZMQParserInterface::parseTemplate(const char * payload, int payload_siz
 	  ;
       }
 
+      if(labels_hash_dirty)
+	updateLabelsHash();
+
       if(mandatory_fields.size() > 0) {
 	static bool template_warning_sent = 0;
 
@@ -1963,6 +2080,9 @@ u_int8_t ZMQParserInterface::parseTemplate(const char * payload, int payload_siz
 	}
       }
     }
+
+    labels_lock.unlock(__FILE__, __LINE__);
+
     json_object_put(obj);
   } else {
     // if o != NULL
@@ -25,15 +25,15 @@
 /* ***************************************************** */
 
 void SYNScan::periodicUpdate(Host *h, HostAlert *engaged_alert) {
-  u_int16_t hits = 0;
+  u_int32_t attacker_hits, victim_hits;
 
-  if((hits = h->syn_scan_attacker_hits()) > threshold)
-    triggerFlowHitsAlert(h, engaged_alert, true, hits, threshold, CLIENT_FULL_RISK_PERCENTAGE);
-  else if((hits = h->syn_scan_victim_hits()) > threshold) 
-    triggerFlowHitsAlert(h, engaged_alert, false, hits, threshold, CLIENT_NO_RISK_PERCENTAGE);
+  /* Counters are reset as they are read */
+  h->getAndResetSynScanHits(&attacker_hits, &victim_hits);
 
-  /* Reset counters once done */
-  h->reset_syn_scan_hits();
+  if(attacker_hits > threshold)
+    triggerFlowHitsAlert(h, engaged_alert, true, attacker_hits, threshold, CLIENT_FULL_RISK_PERCENTAGE);
+  else if(victim_hits > threshold)
+    triggerFlowHitsAlert(h, engaged_alert, false, victim_hits, threshold, CLIENT_NO_RISK_PERCENTAGE);
 }
 
 /* ***************************************************** */
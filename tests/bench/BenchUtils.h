@@ -0,0 +1,136 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _BENCH_UTILS_H_
+#define _BENCH_UTILS_H_
+
+/*
+  Helpers shared by the microbenchmarks. Each benchmark is a standalone
+  program, hence everything here is static.
+*/
+
+/* ******************************************* */
+
+static double elapsed_ms(struct timespec *begin) {
+  struct timespec end;
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  return((end.tv_sec - begin->tv_sec) * 1e3 + (end.tv_nsec - begin->tv_nsec) / 1e6);
+}
+
+/* ******************************************* */
+
+/*
+  Local HTTP sink: a thread per connection reads the requests and answers
+  each one with the response returned by the handler, called with the
+  request body. Connections are kept alive unless the response closes them.
+*/
+
+typedef const char* (*bench_sink_handler_t)(const char *body, size_t body_len, bool gzip);
+
+static int bench_sink_fd;
+static bench_sink_handler_t bench_sink_handler;
+static std::atomic<u_int64_t> bench_sink_requests, bench_sink_connections, bench_sink_body_bytes;
+
+/* ******************************************* */
+
+static void* bench_sink_connection(void *ptr) {
+  int fd = (int)(long)ptr;
+  std::string data;
+  char buf[65536];
+  ssize_t n;
+  bool keep_alive = true;
+
+  bench_sink_connections++;
+
+  while(keep_alive && ((n = recv(fd, buf, sizeof(buf), 0)) > 0)) {
+    size_t header_end;
+
+    data.append(buf, n);
+
+    while(keep_alive && ((header_end = data.find("\r\n\r\n")) != std::string::npos)) {
+      const char *cl = strcasestr(data.c_str(), "Content-Length:");
+      const char *ce = strcasestr(data.c_str(), "Content-Encoding: gzip");
+      size_t body_len = (cl && (cl < data.c_str() + header_end)) ? atol(cl + 15) : 0;
+      bool gzip = ce && (ce < data.c_str() + header_end);
+      const char *rsp;
+
+      if(data.size() < header_end + 4 + body_len)
+	break; /* Body not complete */
+
+      bench_sink_requests++, bench_sink_body_bytes += body_len;
+
+      rsp = bench_sink_handler(&data[header_end + 4], body_len, gzip);
+      keep_alive = (strcasestr(rsp, "Connection: close") == NULL);
+
+      if(write(fd, rsp, strlen(rsp)) < 0) keep_alive = false;
+
+      data.erase(0, header_end + 4 + body_len);
+    }
+  }
+
+  close(fd);
+  return(NULL);
+}
+
+/* ******************************************* */
+
+static void* bench_sink_loop(void *ptr) {
+  while(true) {
+    int fd = accept(bench_sink_fd, NULL, NULL);
+    pthread_t t;
+
+    if(fd < 0) break;
+    pthread_create(&t, NULL, bench_sink_connection, (void*)(long)fd);
+    pthread_detach(t);
+  }
+
+  return(NULL);
+}
+
+/* ******************************************* */
+
+/* Listens on a loopback ephemeral port, returning its http://127.0.0.1:<port> URL */
+static bool bench_start_sink(bench_sink_handler_t handler, char *url, u_int url_len) {
+  struct sockaddr_in sin;
+  socklen_t len = sizeof(sin);
+  pthread_t t;
+
+  if((bench_sink_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) return(false);
+
+  memset(&sin, 0, sizeof(sin));
+  sin.sin_family = AF_INET, sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK), sin.sin_port = 0;
+
+  if((bind(bench_sink_fd, (struct sockaddr*)&sin, sizeof(sin)) < 0)
+     || (listen(bench_sink_fd, 128) < 0)
+     || (getsockname(bench_sink_fd, (struct sockaddr*)&sin, &len) < 0))
+    return(false);
+
+  bench_sink_handler = handler;
+  snprintf(url, url_len, "http://127.0.0.1:%u", ntohs(sin.sin_port));
+  pthread_create(&t, NULL, bench_sink_loop, NULL);
+  pthread_detach(t);
+
+  return(true);
+}
+
+#endif /* _BENCH_UTILS_H_ */
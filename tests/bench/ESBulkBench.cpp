@@ -0,0 +1,228 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+/*
+  Compares the former ElasticSearch export path (strdup'ed list protected by
+  a mutex, bulk assembled with snprintf, one POST at a time) with the
+  DocumentRing based one (bulk posted from the ring slots through iovecs,
+  ES_BULK_MAX_INFLIGHT requests in flight), against a local HTTP sink that
+  reads the whole request and answers 200.
+
+  make tests/bench/ESBulkBench
+  ./tests/bench/ESBulkBench [num flows] [sink delay ms]
+*/
+
+#include "ntop_includes.h"
+#include "BenchUtils.h"
+
+AfterShutdownAction afterShutdownAction = after_shutdown_nop;
+
+static int sink_delay_ms = 0;
+static char sink_url[64], doc[768];
+static u_int32_t num_flows = 500000;
+static std::atomic<u_int64_t> num_received;
+static volatile bool producer_done;
+
+/* ******************************************* */
+
+static const char* es_sink(const char *body, size_t body_len, bool gzip) {
+  static const char rsp[] = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\nConnection: close\r\n\r\n{}";
+
+  /* Each bulk line pair is a flow */
+  num_received += body_len / (strlen(doc) + 1 + 64);
+  if(sink_delay_ms) usleep(sink_delay_ms * 1000);
+
+  return(rsp);
+}
+
+/* ******************************************* */
+
+/* Padded so that every bulk line pair has the same size */
+static u_int header(char *buf, u_int buf_len) {
+  return(snprintf(buf, buf_len, "%-63s", "{\"index\": {\"_type\": \"_doc\", \"_index\": \"ntopng-bench\"}}"));
+}
+
+/* ******************************************* */
+
+/* Former path */
+
+static std::list<char*> legacy_list;
+static Mutex legacy_lock;
+
+static void* legacy_poster(void *ptr) {
+  char *postbuf = (char*)malloc(ES_BULK_BUFFER_SIZE), hdr[128];
+  HTTPTranferStats stats;
+
+  header(hdr, sizeof(hdr));
+
+  while(!producer_done || !legacy_list.empty()) {
+    u_int len = 0;
+
+    legacy_lock.lock(__FILE__, __LINE__);
+    while(!legacy_list.empty()
+	  && (len <= ES_BULK_BUFFER_SIZE - strlen(hdr) - strlen(legacy_list.back()) - 5)) {
+      char *e = legacy_list.back();
+
+      len += snprintf(&postbuf[len], ES_BULK_BUFFER_SIZE - len, "%s\n%s\n", hdr, e);
+      free(e);
+      legacy_list.pop_back();
+    }
+    legacy_lock.unlock(__FILE__, __LINE__);
+
+    if(len > 0)
+      Utils::postHTTPJsonData(NULL, NULL, sink_url, postbuf, 0, &stats);
+    else
+      usleep(1000);
+  }
+
+  free(postbuf);
+  return(NULL);
+}
+
+static void run_legacy() {
+  struct timespec begin;
+  pthread_t poster;
+
+  num_received = 0, producer_done = false;
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  pthread_create(&poster, NULL, legacy_poster, NULL);
+
+  for(u_int32_t i = 0; i < num_flows; i++) {
+    legacy_lock.lock(__FILE__, __LINE__);
+    legacy_list.push_front(strdup(doc));
+    legacy_lock.unlock(__FILE__, __LINE__);
+  }
+
+  producer_done = true;
+  pthread_join(poster, NULL);
+
+  printf("%-24s %10u %12.2f %12.0f\n", "list+snprintf, 1 POST", (u_int32_t)num_received.load(),
+	 elapsed_ms(&begin), num_received * 1000. / elapsed_ms(&begin));
+}
+
+/* ******************************************* */
+
+/* DocumentRing path */
+
+static DocumentRing *ring;
+
+static void* ring_poster(void *ptr) {
+  struct iovec *iov = (struct iovec*)malloc(3 * ES_BULK_MAX_DOCS * sizeof(struct iovec));
+  char hdr[128];
+  u_int hdr_len = header(hdr, sizeof(hdr));
+  HTTPTranferStats stats;
+
+  hdr[hdr_len++] = '\n';
+
+  while(!producer_done || ring->getNumQueued()) {
+    u_int64_t first_pos;
+    u_int32_t n = ring->claim(ES_BULK_MAX_DOCS, ES_BULK_BUFFER_SIZE, hdr_len + 1, &first_pos), iovcnt = 0;
+
+    if(n == 0) {
+      usleep(1000);
+      continue;
+    }
+
+    for(u_int32_t i = 0; i < n; i++) {
+      u_int32_t len;
+      const char *d = ring->getDocument(first_pos + i, &len);
+
+      iov[iovcnt].iov_base = hdr, iov[iovcnt++].iov_len = hdr_len;
+      iov[iovcnt].iov_base = (void*)d, iov[iovcnt++].iov_len = len;
+      iov[iovcnt].iov_base = (void*)"\n", iov[iovcnt++].iov_len = 1;
+    }
+
+    Utils::postHTTPJsonIovec(NULL, NULL, sink_url, iov, iovcnt, 0, &stats);
+    ring->release(first_pos, n);
+  }
+
+  free(iov);
+  return(NULL);
+}
+
+static void run_ring(u_int32_t num_posters) {
+  struct timespec begin;
+  pthread_t posters[ES_BULK_MAX_INFLIGHT];
+  u_int32_t doc_len = strlen(doc);
+  u_int64_t num_full = 0;
+  char label[32];
+
+  ring = new DocumentRing(ES_MAX_QUEUE_LEN, ES_BULK_MIN_DOCS);
+  num_received = 0, producer_done = false;
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+
+  for(u_int32_t i = 0; i < num_posters; i++)
+    pthread_create(&posters[i], NULL, ring_poster, NULL);
+
+  for(u_int32_t i = 0; i < num_flows; i++) {
+    while(!ring->enqueue(doc, doc_len))
+      num_full++, sched_yield(); /* Backpressure: the exporter would drop here */
+  }
+
+  producer_done = true;
+  for(u_int32_t i = 0; i < num_posters; i++)
+    pthread_join(posters[i], NULL);
+
+  snprintf(label, sizeof(label), "ring+iovec, %u POST", num_posters);
+  printf("%-24s %10u %12.2f %12.0f %10llu\n", label, (u_int32_t)num_received.load(),
+	 elapsed_ms(&begin), num_received * 1000. / elapsed_ms(&begin), (unsigned long long)num_full);
+
+  delete ring;
+}
+
+/* ******************************************* */
+
+int main(int argc, char *argv[]) {
+  Prefs *prefs;
+
+  if((ntop = new (std::nothrow) Ntop("ntopng")) == NULL)
+    return(-1);
+
+  prefs = new (std::nothrow) Prefs(ntop);
+  ntop->registerPrefs(prefs, false);
+  ntop->getTrace()->set_trace_level(TRACE_LEVEL_ERROR);
+
+  if(argc > 1) num_flows = atoi(argv[1]);
+  if(argc > 2) sink_delay_ms = atoi(argv[2]);
+
+  /* A flow JSON of typical size */
+  memset(doc, 'x', sizeof(doc) - 1);
+  memcpy(doc, "{ \"IPV4_SRC_ADDR\": \"", 20);
+  doc[sizeof(doc) - 3] = '"', doc[sizeof(doc) - 2] = '}';
+
+  if(!bench_start_sink(es_sink, sink_url, sizeof(sink_url))) {
+    printf("Unable to start the HTTP sink\n");
+    return(-1);
+  }
+
+  strncat(sink_url, "/_bulk", sizeof(sink_url) - strlen(sink_url) - 1);
+
+  printf("%-24s %10s %12s %12s %10s\n", "Path", "Flows", "Time (ms)", "Flows/sec", "Ring full");
+
+  run_legacy();
+  run_ring(1);
+  run_ring(ES_BULK_MAX_INFLIGHT);
+
+  delete ntop;
+
+  return(0);
+}
@@ -0,0 +1,239 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+/*
+  Compares the json-c flow serialization used by Flow::serialize(use_labels)
+  (object tree, json_object_to_json_string, strdup) with the JSONWriter
+  streaming path used for the flow dump, on a record with the same fields
+  and key layout as Flow::flow2JSON. Both label modes are checked for
+  byte-identical output, including the keys that numeric mode repeats.
+
+  make tests/bench/FlowJSONBench
+  ./tests/bench/FlowJSONBench [num flows]
+*/
+
+#include "ntop_includes.h"
+#include "BenchUtils.h"
+
+AfterShutdownAction afterShutdownAction = after_shutdown_nop;
+
+struct benchFlow {
+  char cli_ip[32], srv_ip[32], cli_name[64], srv_name[64], l7_name[32];
+  u_int16_t cli_port, srv_port, vlan_id;
+  u_int8_t protocol, tcp_flags;
+  u_int64_t retr[2], ooo[2], lost[2], pkts[2], bytes[2];
+  u_int32_t first_seen, last_seen;
+  double cli_latency, srv_latency;
+  float lat, lon;
+  json_object *json_info;
+};
+
+/* ******************************************* */
+
+static const char* label(bool use_labels, int id, const char *str, char *buf, u_int buf_len) {
+  if(use_labels) return(str);
+  snprintf(buf, buf_len, "%d", id);
+  return(buf);
+}
+
+/* ******************************************* */
+
+static char* serialize_jsonc(struct benchFlow *f, bool use_labels) {
+  json_object *o = json_object_new_object(), *location;
+  char k[16], *rsp;
+  double loc[2] = { f->lon, f->lat };
+
+  json_object_object_add(o, label(use_labels, IPV4_SRC_ADDR, "IPV4_SRC_ADDR", k, sizeof(k)), json_object_new_string(f->cli_ip));
+  json_object_object_add(o, label(use_labels, SRC_ADDR_LOCAL, "SRC_ADDR_LOCAL", k, sizeof(k)), json_object_new_boolean(1));
+  json_object_object_add(o, label(use_labels, SRC_NAME, "SRC_NAME", k, sizeof(k)), json_object_new_string(f->cli_name));
+  json_object_object_add(o, label(use_labels, IPV4_DST_ADDR, "IPV4_DST_ADDR", k, sizeof(k)), json_object_new_string(f->srv_ip));
+  json_object_object_add(o, label(use_labels, DST_ADDR_LOCAL, "DST_ADDR_LOCAL", k, sizeof(k)), json_object_new_boolean(0));
+  json_object_object_add(o, label(use_labels, SRC_NAME, "DST_NAME", k, sizeof(k)), json_object_new_string(f->srv_name));
+  json_object_object_add(o, label(use_labels, L4_SRC_PORT, "L4_SRC_PORT", k, sizeof(k)), json_object_new_int(f->cli_port));
+  json_object_object_add(o, label(use_labels, L4_DST_PORT, "L4_DST_PORT", k, sizeof(k)), json_object_new_int(f->srv_port));
+  json_object_object_add(o, label(use_labels, PROTOCOL, "PROTOCOL", k, sizeof(k)), json_object_new_int(f->protocol));
+  json_object_object_add(o, label(use_labels, L7_PROTO_NAME, "L7_PROTO_NAME", k, sizeof(k)), json_object_new_string(f->l7_name));
+  json_object_object_add(o, label(use_labels, TCP_FLAGS, "TCP_FLAGS", k, sizeof(k)), json_object_new_int(f->tcp_flags));
+  json_object_object_add(o, label(use_labels, TCP_FLAGS, "IN_RETRASMISSIONS", k, sizeof(k)), json_object_new_int64(f->retr[0]));
+  json_object_object_add(o, label(use_labels, TCP_FLAGS, "OUT_RETRASMISSIONS", k, sizeof(k)), json_object_new_int64(f->retr[1]));
+  json_object_object_add(o, label(use_labels, TCP_FLAGS, "IN_OUT_OF_ORDER", k, sizeof(k)), json_object_new_int64(f->ooo[0]));
+  json_object_object_add(o, label(use_labels, TCP_FLAGS, "OUT_OUT_OF_ORDER", k, sizeof(k)), json_object_new_int64(f->ooo[1]));
+  json_object_object_add(o, label(use_labels, TCP_FLAGS, "IN_LOST", k, sizeof(k)), json_object_new_int64(f->lost[0]));
+  json_object_object_add(o, label(use_labels, TCP_FLAGS, "OUT_LOST", k, sizeof(k)), json_object_new_int64(f->lost[1]));
+  json_object_object_add(o, label(use_labels, IN_PKTS, "IN_PKTS", k, sizeof(k)), json_object_new_int64(f->pkts[0]));
+  json_object_object_add(o, label(use_labels, IN_BYTES, "IN_BYTES", k, sizeof(k)), json_object_new_int64(f->bytes[0]));
+  json_object_object_add(o, label(use_labels, OUT_PKTS, "OUT_PKTS", k, sizeof(k)), json_object_new_int64(f->pkts[1]));
+  json_object_object_add(o, label(use_labels, OUT_BYTES, "OUT_BYTES", k, sizeof(k)), json_object_new_int64(f->bytes[1]));
+  json_object_object_add(o, label(use_labels, FIRST_SWITCHED, "FIRST_SWITCHED", k, sizeof(k)), json_object_new_int(f->first_seen));
+  json_object_object_add(o, label(use_labels, LAST_SWITCHED, "LAST_SWITCHED", k, sizeof(k)), json_object_new_int(f->last_seen));
+  json_object_object_add(o, "json", json_object_get(f->json_info));
+  json_object_object_add(o, label(use_labels, SRC_VLAN, "SRC_VLAN", k, sizeof(k)), json_object_new_int(f->vlan_id));
+  json_object_object_add(o, label(use_labels, CLIENT_NW_LATENCY_MS, "CLIENT_NW_LATENCY_MS", k, sizeof(k)), json_object_new_double(f->cli_latency));
+  json_object_object_add(o, label(use_labels, SERVER_NW_LATENCY_MS, "SERVER_NW_LATENCY_MS", k, sizeof(k)), json_object_new_double(f->srv_latency));
+  json_object_object_add(o, "SRC_IP_COUNTRY", json_object_new_string("IT"));
+  location = json_object_new_array();
+  json_object_array_add(location, json_object_new_double(loc[0]));
+  json_object_array_add(location, json_object_new_double(loc[1]));
+  json_object_object_add(o, "SRC_IP_LOCATION", location);
+  json_object_object_add(o, "INTERFACE", json_object_new_string("eth0"));
+  json_object_object_add(o, "HTTP_URL", json_object_new_string("/index.html?q=\"a\tb\""));
+
+  rsp = strdup(json_object_to_json_string(o));
+  json_object_put(o);
+
+  return(rsp);
+}
+
+/* ******************************************* */
+
+static const char* serialize_writer(JSONWriter *w, struct benchFlow *f, bool use_labels, u_int32_t *len = NULL) {
+  char k[16];
+  double loc[2] = { f->lon, f->lat };
+
+  w->reset();
+  w->addString(label(use_labels, IPV4_SRC_ADDR, "IPV4_SRC_ADDR", k, sizeof(k)), f->cli_ip);
+  w->addBool(label(use_labels, SRC_ADDR_LOCAL, "SRC_ADDR_LOCAL", k, sizeof(k)), true);
+  w->addString(label(use_labels, SRC_NAME, "SRC_NAME", k, sizeof(k)), f->cli_name);
+  w->addString(label(use_labels, IPV4_DST_ADDR, "IPV4_DST_ADDR", k, sizeof(k)), f->srv_ip);
+  w->addBool(label(use_labels, DST_ADDR_LOCAL, "DST_ADDR_LOCAL", k, sizeof(k)), false);
+  w->addString(label(use_labels, SRC_NAME, "DST_NAME", k, sizeof(k)), f->srv_name);
+  w->addInt(label(use_labels, L4_SRC_PORT, "L4_SRC_PORT", k, sizeof(k)), f->cli_port);
+  w->addInt(label(use_labels, L4_DST_PORT, "L4_DST_PORT", k, sizeof(k)), f->srv_port);
+  w->addInt(label(use_labels, PROTOCOL, "PROTOCOL", k, sizeof(k)), f->protocol);
+  w->addString(label(use_labels, L7_PROTO_NAME, "L7_PROTO_NAME", k, sizeof(k)), f->l7_name);
+  w->addInt(label(use_labels, TCP_FLAGS, "TCP_FLAGS", k, sizeof(k)), f->tcp_flags);
+  w->addInt64(label(use_labels, TCP_FLAGS, "IN_RETRASMISSIONS", k, sizeof(k)), f->retr[0]);
+  w->addInt64(label(use_labels, TCP_FLAGS, "OUT_RETRASMISSIONS", k, sizeof(k)), f->retr[1]);
+  w->addInt64(label(use_labels, TCP_FLAGS, "IN_OUT_OF_ORDER", k, sizeof(k)), f->ooo[0]);
+  w->addInt64(label(use_labels, TCP_FLAGS, "OUT_OUT_OF_ORDER", k, sizeof(k)), f->ooo[1]);
+  w->addInt64(label(use_labels, TCP_FLAGS, "IN_LOST", k, sizeof(k)), f->lost[0]);
+  w->addInt64(label(use_labels, TCP_FLAGS, "OUT_LOST", k, sizeof(k)), f->lost[1]);
+  w->addInt64(label(use_labels, IN_PKTS, "IN_PKTS", k, sizeof(k)), f->pkts[0]);
+  w->addInt64(label(use_labels, IN_BYTES, "IN_BYTES", k, sizeof(k)), f->bytes[0]);
+  w->addInt64(label(use_labels, OUT_PKTS, "OUT_PKTS", k, sizeof(k)), f->pkts[1]);
+  w->addInt64(label(use_labels, OUT_BYTES, "OUT_BYTES", k, sizeof(k)), f->bytes[1]);
+  w->addInt(label(use_labels, FIRST_SWITCHED, "FIRST_SWITCHED", k, sizeof(k)), (int32_t)f->first_seen);
+  w->addInt(label(use_labels, LAST_SWITCHED, "LAST_SWITCHED", k, sizeof(k)), (int32_t)f->last_seen);
+  w->addRaw("json", json_object_to_json_string(f->json_info));
+  w->addInt(label(use_labels, SRC_VLAN, "SRC_VLAN", k, sizeof(k)), f->vlan_id);
+  w->addDouble(label(use_labels, CLIENT_NW_LATENCY_MS, "CLIENT_NW_LATENCY_MS", k, sizeof(k)), f->cli_latency);
+  w->addDouble(label(use_labels, SERVER_NW_LATENCY_MS, "SERVER_NW_LATENCY_MS", k, sizeof(k)), f->srv_latency);
+  w->addString("SRC_IP_COUNTRY", "IT");
+  w->addDoubleArray("SRC_IP_LOCATION", loc, 2);
+  w->addString("INTERFACE", "eth0");
+  w->addString("HTTP_URL", "/index.html?q=\"a\tb\"");
+
+  return(w->end(len));
+}
+
+/* ******************************************* */
+
+static void run(struct benchFlow *flows, u_int32_t num_flows, bool use_labels) {
+  JSONWriter w;
+  struct timespec begin;
+  double jsonc_ms, writer_ms;
+  u_int64_t jsonc_len = 0, writer_len = 0;
+  u_int32_t num_diffs = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  for(u_int32_t i = 0; i < num_flows; i++) {
+    char *json = serialize_jsonc(&flows[i], use_labels);
+
+    jsonc_len += strlen(json);
+    free(json);
+  }
+  jsonc_ms = elapsed_ms(&begin);
+
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  for(u_int32_t i = 0; i < num_flows; i++) {
+    u_int32_t len;
+
+    serialize_writer(&w, &flows[i], use_labels, &len);
+    writer_len += len;
+  }
+  writer_ms = elapsed_ms(&begin);
+
+  for(u_int32_t i = 0; i < num_flows; i++) {
+    char *json = serialize_jsonc(&flows[i], use_labels);
+    const char *out = serialize_writer(&w, &flows[i], use_labels);
+
+    if(strcmp(json, out) != 0) {
+      if(num_diffs++ == 0)
+	printf("json-c: %s\nwriter: %s\n", json, out);
+    }
+
+    free(json);
+  }
+
+  if(jsonc_len != writer_len) num_diffs++;
+
+  printf("%-8s %10u %12.2f %12.2f %8.1fx %10s\n",
+	 use_labels ? "labels" : "ids", num_flows, jsonc_ms, writer_ms, jsonc_ms / writer_ms,
+	 num_diffs ? "DIFFERENT" : "identical");
+}
+
+/* ******************************************* */
+
+int main(int argc, char *argv[]) {
+  u_int32_t num_flows = 200000;
+  struct benchFlow *flows;
+
+  if(argc > 1) num_flows = atoi(argv[1]);
+
+  srand(1);
+  flows = (struct benchFlow*)calloc(num_flows, sizeof(struct benchFlow));
+
+  for(u_int32_t i = 0; i < num_flows; i++) {
+    struct benchFlow *f = &flows[i];
+
+    snprintf(f->cli_ip, sizeof(f->cli_ip), "192.168.%u.%u", rand() % 256, rand() % 256);
+    snprintf(f->srv_ip, sizeof(f->srv_ip), "10.%u.%u.%u", rand() % 256, rand() % 256, rand() % 256);
+    snprintf(f->cli_name, sizeof(f->cli_name), "host-%u.local", rand());
+    snprintf(f->srv_name, sizeof(f->srv_name), "www.example%u.com", rand() % 1000);
+    snprintf(f->l7_name, sizeof(f->l7_name), "TLS.Google");
+    f->cli_port = rand(), f->srv_port = 443, f->vlan_id = rand() % 4096;
+    f->protocol = IPPROTO_TCP, f->tcp_flags = rand();
+    f->retr[0] = rand() % 10, f->retr[1] = rand() % 10, f->ooo[0] = rand() % 5, f->ooo[1] = rand() % 5;
+    f->lost[0] = rand() % 3, f->lost[1] = rand() % 3;
+    f->pkts[0] = rand(), f->pkts[1] = rand();
+    f->bytes[0] = ((u_int64_t)rand() << 20), f->bytes[1] = rand();
+    f->first_seen = 1650000000 + i, f->last_seen = f->first_seen + rand() % 600;
+    f->cli_latency = (rand() % 100000) / 1000., f->srv_latency = (i % 7) ? (rand() % 1000) / 10. : 0;
+    f->lat = 43.72f + (rand() % 1000) / 1000.f, f->lon = -(10.40f + (rand() % 1000) / 1000.f);
+
+    f->json_info = json_object_new_object();
+    json_object_object_add(f->json_info, "source", json_object_new_string("nprobe/1"));
+    json_object_object_add(f->json_info, "id", json_object_new_int(i));
+  }
+
+  printf("%-8s %10s %12s %12s %9s %10s\n",
+	 "Keys", "Flows", "json-c (ms)", "writer (ms)", "Speedup", "Output");
+
+  run(flows, num_flows, true);
+  run(flows, num_flows, false);
+
+  for(u_int32_t i = 0; i < num_flows; i++)
+    json_object_put(flows[i].json_info);
+  free(flows);
+
+  return(0);
+}
@@ -0,0 +1,146 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+/*
+  Compares the flows paginator sort (qsort of all the matching flows) with
+  the bounded heap selection of TopKSelector, as done by NetworkInterface::sortFlows
+
+  make tests/bench/FlowTopKBench
+  ./tests/bench/FlowTopKBench [num flows]
+*/
+
+#include "ntop_includes.h"
+#include "BenchUtils.h"
+
+AfterShutdownAction afterShutdownAction = after_shutdown_nop;
+
+/* Same layout as the flowHostRetrieveList of NetworkInterface.cpp */
+struct benchRetrieveList {
+  void *flow;
+  void *values[7];
+  u_int64_t numericValue;
+  const char *stringValue;
+  void *ipValue;
+};
+
+/* ******************************************* */
+
+static int benchSorter(const void *_a, const void *_b) {
+  struct benchRetrieveList *a = (struct benchRetrieveList*)_a;
+  struct benchRetrieveList *b = (struct benchRetrieveList*)_b;
+
+  if(a->numericValue < b->numericValue)      return(-1);
+  else if(a->numericValue > b->numericValue) return(1);
+  else return(0);
+}
+
+/* ******************************************* */
+
+/* Old behaviour: all the matches are stored, then sorted */
+static u_int64_t sort_all(const u_int64_t *values, u_int32_t num_flows, u_int32_t to_skip, u_int32_t max_hits) {
+  struct benchRetrieveList *elems = (struct benchRetrieveList*)calloc(sizeof(struct benchRetrieveList), num_flows);
+  u_int64_t rc;
+
+  for(u_int32_t i = 0; i < num_flows; i++)
+    elems[i].flow = &elems[i], elems[i].numericValue = values[i];
+
+  qsort(elems, num_flows, sizeof(struct benchRetrieveList), benchSorter);
+
+  /* Descending order, as the GUI default */
+  rc = elems[num_flows - 1 - to_skip].numericValue;
+  free(elems);
+
+  return(rc);
+}
+
+/* ******************************************* */
+
+static u_int64_t select_top(const u_int64_t *values, u_int32_t num_flows, u_int32_t to_skip, u_int32_t max_hits) {
+  u_int32_t num_top = to_skip + max_hits;
+  struct benchRetrieveList *elems = (struct benchRetrieveList*)calloc(sizeof(struct benchRetrieveList), num_top + 1);
+  TopKSelector *topk = new TopKSelector(elems, sizeof(struct benchRetrieveList), num_top, benchSorter, true);
+  u_int64_t rc;
+
+  for(u_int32_t i = 0; i < num_flows; i++) {
+    struct benchRetrieveList *e = (struct benchRetrieveList*)topk->candidate();
+
+    e->flow = e, e->numericValue = values[i];
+    topk->commit();
+  }
+
+  topk->sort();
+  rc = elems[topk->size() - 1 - to_skip].numericValue;
+  delete topk;
+  free(elems);
+
+  return(rc);
+}
+
+/* ******************************************* */
+
+static void run(u_int32_t num_flows, u_int32_t to_skip, u_int32_t max_hits) {
+  u_int64_t *values = (u_int64_t*)malloc(num_flows * sizeof(u_int64_t));
+  u_int64_t v1, v2;
+  struct timespec begin;
+  double qsort_ms, topk_ms;
+
+  for(u_int32_t i = 0; i < num_flows; i++)
+    values[i] = ((u_int64_t)rand() << 16) ^ rand(); /* e.g. flow bytes */
+
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  v1 = sort_all(values, num_flows, to_skip, max_hits);
+  qsort_ms = elapsed_ms(&begin);
+
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  v2 = select_top(values, num_flows, to_skip, max_hits);
+  topk_ms = elapsed_ms(&begin);
+
+  printf("%10u %8u %8u %12.2f %12.2f %8.1fx\n",
+	 num_flows, to_skip, max_hits, qsort_ms, topk_ms, qsort_ms / topk_ms);
+
+  if(v1 != v2)
+    printf("WARNING: results differ\n");
+
+  free(values);
+}
+
+/* ******************************************* */
+
+int main(int argc, char *argv[]) {
+  u_int32_t sizes[] = { 10000, 100000, 1000000, 5000000 };
+  u_int32_t num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+
+  if(argc > 1)
+    sizes[0] = atoi(argv[1]), num_sizes = 1;
+
+  srand(1);
+
+  printf("%10s %8s %8s %12s %12s %9s\n",
+	 "Flows", "Skip", "Hits", "qsort (ms)", "topk (ms)", "Speedup");
+
+  for(u_int32_t i = 0; i < num_sizes; i++) {
+    run(sizes[i], 0, 10);
+    run(sizes[i], 0, 100);
+    run(sizes[i], 1000, 10);
+  }
+
+  return(0);
+}
@@ -0,0 +1,167 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+/*
+  Compares find/insert/purge of the chaining and open addressing GenericHash engines
+
+  make tests/bench/GenericHashBench
+  ./tests/bench/GenericHashBench [num entries]
+*/
+
+#include "ntop_includes.h"
+
+AfterShutdownAction afterShutdownAction = after_shutdown_nop;
+
+/* ******************************************* */
+
+class BenchEntry : public GenericHashEntry {
+ private:
+  u_int32_t k;
+
+ public:
+  bool expired;
+
+  BenchEntry(NetworkInterface *_iface, u_int32_t _k) : GenericHashEntry(_iface) { k = _k, expired = false; };
+  u_int32_t key() { return(k); };
+  bool is_hash_entry_state_idle_transition_ready() { return(expired); };
+};
+
+/* ******************************************* */
+
+class BenchHash : public GenericHash {
+ private:
+  static bool matches(GenericHashEntry *h, void *user_data) {
+    return(!h->idle() && (h->key() == *((u_int32_t*)user_data)));
+  };
+
+ public:
+  BenchHash(NetworkInterface *_iface, u_int _num_entries, HashTableEngine _engine)
+    : GenericHash(_iface, _num_entries / 4 /* Same ratio used by -X */, _num_entries, "BenchHash", _engine) { };
+
+  BenchEntry* find(u_int32_t k) { return((BenchEntry*)lookup<matches>(k, &k, false /* Inline */)); };
+};
+
+/* ******************************************* */
+
+static double elapsed_ns(struct timespec *begin) {
+  struct timespec end;
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  return((end.tv_sec - begin->tv_sec) * 1e9 + (end.tv_nsec - begin->tv_nsec));
+}
+
+/* ******************************************* */
+
+static void run(NetworkInterface *iface, HashTableEngine engine, u_int32_t num_entries) {
+  BenchHash *h = new BenchHash(iface, num_entries, engine);
+  vector<BenchEntry*> entries;
+  struct timespec begin;
+  struct timeval tv;
+  u_int32_t num_added = 0, num_found = 0, num_purged = 0;
+  double insert_ns, find_ns, miss_ns, purge_ns;
+
+  entries.reserve(num_entries);
+
+  for(u_int32_t i = 0; i < num_entries; i++)
+    /* Sums of addresses and ports as FlowHash keys are */
+    entries.push_back(new BenchEntry(iface, 0x0A000000 + (rand() % 65536) + (rand() % 65536) + (i * 7)));
+
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  for(u_int32_t i = 0; i < num_entries; i++) {
+    if(h->add(entries[i], false))
+      num_added++;
+  }
+  insert_ns = elapsed_ns(&begin);
+
+  for(u_int32_t i = num_added; i < num_entries; i++)
+    delete entries[i];
+  entries.resize(num_added);
+
+  random_shuffle(entries.begin(), entries.end());
+
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  for(u_int32_t i = 0; i < num_added; i++) {
+    if(h->find(entries[i]->key()))
+      num_found++;
+  }
+  find_ns = elapsed_ns(&begin);
+
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  for(u_int32_t i = 0; i < num_added; i++)
+    h->find(0xF0000000 + i);
+  miss_ns = elapsed_ns(&begin);
+
+  for(u_int32_t i = 0; i < num_added; i += 2)
+    entries[i]->expired = true;
+
+  gettimeofday(&tv, NULL);
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  num_purged = h->purgeIdle(&tv, false, true /* full scan */);
+  purge_ns = elapsed_ns(&begin);
+
+  printf("%-16s %10u %10u %10.1f %10.1f %10.1f %12.1f\n",
+	 (engine == hash_table_engine_open_addressing) ? "open-addressing" : "chaining",
+	 num_added, num_purged,
+	 insert_ns / num_entries, find_ns / num_added, miss_ns / num_added,
+	 purge_ns / 1000000);
+
+  if(num_found != num_added)
+    printf("WARNING: %u entries not found\n", num_added - num_found);
+
+  /* Entries are deleted by the hash, idle ones included */
+  delete h;
+}
+
+/* ******************************************* */
+
+int main(int argc, char *argv[]) {
+  u_int32_t sizes[] = { 100000, 1000000, 5000000 };
+  u_int32_t num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+  NetworkInterface *iface;
+  Prefs *prefs;
+
+  if((ntop = new (std::nothrow) Ntop("ntopng")) == NULL)
+    return(-1);
+
+  prefs = new (std::nothrow) Prefs(ntop);
+  ntop->registerPrefs(prefs, false);
+  ntop->getTrace()->set_trace_level(TRACE_LEVEL_ERROR);
+
+  if(argc > 1)
+    sizes[0] = atoi(argv[1]), num_sizes = 1;
+
+  iface = new (std::nothrow) NetworkInterface(SYSTEM_INTERFACE_NAME);
+  srand(1);
+
+  printf("%-16s %10s %10s %10s %10s %10s %12s\n",
+	 "Engine", "Entries", "Purged", "Add (ns)", "Find (ns)", "Miss (ns)", "Purge (ms)");
+
+  for(u_int32_t i = 0; i < num_sizes; i++) {
+    run(iface, hash_table_engine_chaining, sizes[i]);
+    run(iface, hash_table_engine_open_addressing, sizes[i]);
+  }
+
+  delete iface;
+  delete ntop;
+
+  return(0);
+}
@@ -0,0 +1,298 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+/*
+  Compares the former InfluxDB export path (lines written to a temporary file,
+  then posted one file per request as the influxdb driver export() does) with
+  the InfluxDBStreamer (pooled batches gzipped and posted from a sender thread
+  over a kept-alive connection), against a local fake InfluxDB that decodes
+  the requests and counts the received lines. A last run answers 500 to check
+  that the batches that can't be posted are spilled to disk.
+
+  make tests/bench/InfluxDBStreamBench
+  ./tests/bench/InfluxDBStreamBench [num points]
+*/
+
+#include "ntop_includes.h"
+#include "BenchUtils.h"
+
+AfterShutdownAction afterShutdownAction = after_shutdown_nop;
+
+static char sink_url[64];
+static u_int32_t num_points = 1000000;
+static std::atomic<u_int64_t> num_lines;
+static volatile bool sink_fail = false;
+
+/* Gives access to the escape function used by InfluxDBTimeseriesExporter */
+class BenchExporter : public TimeseriesExporter {
+ public:
+  static int escape(char *buf, int buf_len, const char *unescaped) { return(escape_spaces(buf, buf_len, unescaped)); };
+};
+
+/* ******************************************* */
+
+static u_int64_t count_lines(const char *body, size_t len, bool gzip) {
+  u_int64_t n = 0;
+
+  if(!gzip) {
+    for(size_t i = 0; i < len; i++)
+      if(body[i] == '\n') n++;
+  } else {
+#ifdef HAVE_ZLIB
+    z_stream zs;
+    char out[65536];
+    int rc;
+
+    memset(&zs, 0, sizeof(zs));
+    if(inflateInit2(&zs, 15 + 16) != Z_OK) return(0);
+
+    zs.next_in = (Bytef*)body, zs.avail_in = len;
+
+    do {
+      zs.next_out = (Bytef*)out, zs.avail_out = sizeof(out);
+      rc = inflate(&zs, Z_NO_FLUSH);
+
+      for(size_t i = 0; i < sizeof(out) - zs.avail_out; i++)
+	if(out[i] == '\n') n++;
+    } while(rc == Z_OK);
+
+    inflateEnd(&zs);
+#endif
+  }
+
+  return(n);
+}
+
+/* ******************************************* */
+
+static const char* influxdb_sink(const char *body, size_t body_len, bool gzip) {
+  static const char ok_rsp[] = "HTTP/1.1 204 No Content\r\nContent-Length: 0\r\n\r\n";
+  static const char err_rsp[] = "HTTP/1.1 500 Internal Server Error\r\nContent-Type: application/json\r\n"
+    "Content-Length: 26\r\n\r\n{\"error\":\"engine is down\"}";
+
+  if(sink_fail)
+    return(err_rsp);
+
+  num_lines += count_lines(body, body_len, gzip);
+  return(ok_rsp);
+}
+
+/* ******************************************* */
+
+static void reset_sink(bool fail) {
+  sink_fail = fail;
+  num_lines = 0, bench_sink_requests = 0, bench_sink_connections = 0, bench_sink_body_bytes = 0;
+}
+
+/* ******************************************* */
+
+/* The arguments of interface.appendInfluxDB() for a host point */
+static void push_point(lua_State *vm, u_int32_t i) {
+  char host[32];
+
+  snprintf(host, sizeof(host), "10.0.%u.%u", (i / 256) % 16, i % 256);
+
+  lua_settop(vm, 0);
+  lua_pushstring(vm, "host:traffic");
+  lua_pushinteger(vm, 1650000000 + (i / 4096) * 60);
+
+  lua_newtable(vm);
+  lua_pushstring(vm, "0"), lua_setfield(vm, -2, "ifid");
+  lua_pushstring(vm, host), lua_setfield(vm, -2, "host");
+
+  lua_newtable(vm);
+  lua_pushinteger(vm, (lua_Integer)i * 1500), lua_setfield(vm, -2, "bytes_sent");
+  lua_pushinteger(vm, (lua_Integer)i * 900), lua_setfield(vm, -2, "bytes_rcvd");
+}
+
+/* ******************************************* */
+
+static u_int32_t count_dir(const char *path, u_int64_t *lines) {
+  DIR *dir;
+  struct dirent *entry;
+  u_int32_t n = 0;
+
+  *lines = 0;
+
+  if((dir = opendir(path)) == NULL)
+    return(0);
+
+  while((entry = readdir(dir)) != NULL) {
+    char fname[MAX_PATH];
+    char buf[65536];
+    size_t len;
+    FILE *fd;
+
+    if(entry->d_name[0] == '.') continue;
+
+    snprintf(fname, sizeof(fname), "%s/%s", path, entry->d_name);
+
+    if((fd = fopen(fname, "rb")) == NULL) continue;
+    while((len = fread(buf, 1, sizeof(buf), fd)) > 0)
+      *lines += count_lines(buf, len, false);
+    fclose(fd);
+    n++;
+  }
+
+  closedir(dir);
+
+  return(n);
+}
+
+/* ******************************************* */
+
+static void print_result(const char *label, double ms) {
+  printf("%-22s %10llu %12.2f %12.0f %8llu %8llu %12llu\n", label,
+	 (unsigned long long)num_lines.load(), ms, num_lines * 1000. / ms,
+	 (unsigned long long)bench_sink_requests.load(), (unsigned long long)bench_sink_connections.load(),
+	 (unsigned long long)bench_sink_body_bytes.load());
+}
+
+/* ******************************************* */
+
+/* Former path: files of CONST_INFLUXDB_MAX_DUMP_SIZE bytes, posted when complete */
+static void run_files(const char *spool_dir) {
+  lua_State *vm = luaL_newstate(), *rsp_vm = luaL_newstate();
+  char url[128], fname[MAX_PATH], line[LINE_PROTOCOL_MAX_LINE];
+  std::vector<std::string> files;
+  struct timespec begin;
+  HTTPTranferStats stats;
+  u_int32_t cursize = 0;
+  FILE *fd = NULL;
+
+  reset_sink(false);
+  snprintf(url, sizeof(url), "%s/write?precision=s&db=ntopng", sink_url);
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+
+  for(u_int32_t i = 0; i < num_points; i++) {
+    int len;
+
+    push_point(vm, i);
+
+    if((len = TimeseriesExporter::line_protocol_write_line(vm, line, sizeof(line), BenchExporter::escape)) < 0)
+      continue;
+
+    if(!fd) {
+      snprintf(fname, sizeof(fname), "%s/%u%s", spool_dir, (u_int32_t)files.size(), TMP_TRAILER);
+      fd = fopen(fname, "wb"), cursize = 0;
+    }
+
+    cursize += fwrite(line, 1, strlen(line), fd);
+
+    if(cursize >= 4194304 /* the former dump size */ || (i == num_points - 1)) {
+      std::string ready(fname, strlen(fname) - strlen(TMP_TRAILER));
+
+      fclose(fd), fd = NULL;
+      rename(fname, ready.c_str());
+      files.push_back(ready);
+    }
+  }
+
+  /* The export() of the influxdb driver */
+  for(std::vector<std::string>::iterator it = files.begin(); it != files.end(); ++it) {
+    Utils::postHTTPTextFile(rsp_vm, NULL, NULL, url, (char*)it->c_str(), 30, &stats);
+    lua_settop(rsp_vm, 0);
+    unlink(it->c_str());
+  }
+
+  print_result("tmp file + POST", elapsed_ms(&begin));
+
+  lua_close(vm);
+  lua_close(rsp_vm);
+}
+
+/* ******************************************* */
+
+static void run_streamer(const char *label, u_int32_t n, bool fail) {
+  InfluxDBStreamer *streamer = new (std::nothrow) InfluxDBStreamer();
+  lua_State *vm = luaL_newstate();
+  struct timespec begin;
+
+  reset_sink(fail);
+  streamer->setEndpoint(sink_url, "ntopng", NULL, NULL);
+  streamer->start();
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+
+  for(u_int32_t i = 0; i < n; i++) {
+    push_point(vm, i);
+    streamer->enqueue(vm, BenchExporter::escape);
+  }
+
+  /* Posts the batch being filled */
+  streamer->shutdown();
+
+  print_result(label, elapsed_ms(&begin));
+
+  lua_close(vm);
+  delete streamer;
+}
+
+/* ******************************************* */
+
+int main(int argc, char *argv[]) {
+  Prefs *prefs;
+  char working_dir[] = "/tmp/influxdb_bench.XXXXXX", spool_dir[MAX_PATH];
+  u_int32_t num_fail_points, num_spilled_files;
+  u_int64_t num_spilled_lines;
+
+  if((ntop = new (std::nothrow) Ntop("ntopng")) == NULL)
+    return(-1);
+
+  prefs = new (std::nothrow) Prefs(ntop);
+  ntop->registerPrefs(prefs, false);
+  ntop->getTrace()->set_trace_level(TRACE_LEVEL_ERROR);
+
+  if(argc > 1) num_points = atoi(argv[1]);
+
+  if(!mkdtemp(working_dir)) {
+    printf("Unable to create the bench directory\n");
+    return(-1);
+  }
+
+  ntop->setWorkingDir(working_dir);
+  snprintf(spool_dir, sizeof(spool_dir), "%s/tmp/influxdb", working_dir);
+  Utils::mkdir_tree(spool_dir);
+
+  if(!bench_start_sink(influxdb_sink, sink_url, sizeof(sink_url))) {
+    printf("Unable to start the fake InfluxDB\n");
+    return(-1);
+  }
+
+  printf("%-22s %10s %12s %12s %8s %8s %12s\n", "Path", "Lines", "Time (ms)", "Lines/sec", "POSTs", "Conns", "Body bytes");
+
+  run_files(spool_dir);
+  run_streamer("streamer, gzip", num_points, false);
+
+  /* A couple of batches: retried, then written where export() finds them */
+  num_fail_points = 2 * INFLUXDB_STREAM_BATCH_SIZE / 64;
+  run_streamer("streamer, HTTP 500", num_fail_points, true);
+
+  num_spilled_files = count_dir(spool_dir, &num_spilled_lines);
+  printf("\nHTTP 500: %u points enqueued, %llu spilled in %u files\n",
+	 num_fail_points, (unsigned long long)num_spilled_lines, num_spilled_files);
+
+  Utils::remove_recursively(working_dir);
+
+  delete ntop;
+
+  return((num_spilled_lines == num_fail_points) ? 0 : 1);
+}
@@ -0,0 +1,228 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+/*
+  Compares writing and reading a day of 5 minutes points of many series
+  with one RRD file per series and with the embedded TimeseriesStore
+
+  make tests/bench/TimeseriesStoreBench
+  ./tests/bench/TimeseriesStoreBench [num series] [num points]
+*/
+
+#include "ntop_includes.h"
+#include "BenchUtils.h"
+#include "rrd.h"
+
+AfterShutdownAction afterShutdownAction = after_shutdown_nop;
+
+#define BENCH_STEP 300
+
+static u_int32_t num_series = 1000, num_points = 288;
+
+/* ******************************************* */
+
+static u_int64_t disk_usage(const char *path) {
+  DIR *dir;
+  struct dirent *entry;
+  u_int64_t total = 0;
+
+  if((dir = opendir(path)) == NULL)
+    return(0);
+
+  while((entry = readdir(dir)) != NULL) {
+    char child[MAX_PATH];
+    struct stat st;
+
+    if(entry->d_name[0] == '.') continue;
+
+    snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+
+    if(stat(child, &st) != 0) continue;
+
+    if(S_ISDIR(st.st_mode))
+      total += disk_usage(child);
+    else
+      total += st.st_blocks * 512;
+  }
+
+  closedir(dir);
+
+  return(total);
+}
+
+/* ******************************************* */
+
+/* Traffic counters of a host: slowly increasing, as most ntopng series */
+static void point_values(u_int32_t serie, u_int32_t point, double *values) {
+  values[0] = (double)point * (1000 + serie % 977) + (point * 7919 + serie) % 500;
+  values[1] = (double)point * (300 + serie % 331);
+}
+
+/* ******************************************* */
+
+static void print_result(const char *label, double write_ms, u_int64_t bytes, double read_ms) {
+  u_int64_t tot_points = (u_int64_t)num_series * num_points;
+
+  printf("%-18s %12.2f %14.0f %12.2f %14.2f\n", label, write_ms, tot_points * 1000. / write_ms,
+	 (double)bytes / tot_points, read_ms / num_series);
+}
+
+/* ******************************************* */
+
+static void run_rrd(const char *base, u_int32_t tstart) {
+  char path[MAX_PATH], start[16], update[64];
+  const char *create_argv[] = { "DS:sent:DERIVE:600:U:U", "DS:rcvd:DERIVE:600:U:U", "RRA:AVERAGE:0.5:1:2016" };
+  struct timespec begin;
+  double write_ms, read_ms;
+
+  snprintf(start, sizeof(start), "%u", tstart - BENCH_STEP);
+
+  for(u_int32_t s = 0; s < num_series; s++) {
+    snprintf(path, sizeof(path), "%s/%u.rrd", base, s);
+    rrd_clear_error();
+
+    if(rrd_create_r(path, BENCH_STEP, tstart - BENCH_STEP, 3, create_argv) != 0) {
+      printf("rrd_create_r(%s) failed [%s]\n", path, rrd_get_error());
+      return;
+    }
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+
+  /* As the timeseries scripts: every step updates all the series */
+  for(u_int32_t p = 0; p < num_points; p++) {
+    for(u_int32_t s = 0; s < num_series; s++) {
+      const char *argv[1] = { update };
+      double values[2];
+
+      point_values(s, p, values);
+      snprintf(path, sizeof(path), "%s/%u.rrd", base, s);
+      snprintf(update, sizeof(update), "%u:%.0f:%.0f", tstart + p * BENCH_STEP, values[0], values[1]);
+      rrd_update_r(path, NULL, 1, argv);
+    }
+  }
+
+  write_ms = elapsed_ms(&begin);
+
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+
+  for(u_int32_t s = 0; s < num_series; s++) {
+    time_t t_start = tstart, t_end = tstart + num_points * BENCH_STEP;
+    unsigned long step = BENCH_STEP, ds_cnt;
+    char **names;
+    rrd_value_t *data;
+
+    snprintf(path, sizeof(path), "%s/%u.rrd", base, s);
+
+    if(rrd_fetch_r(path, "AVERAGE", &t_start, &t_end, &step, &ds_cnt, &names, &data) == 0) {
+      for(unsigned long i = 0; i < ds_cnt; i++) rrd_freemem(names[i]);
+      rrd_freemem(names);
+      rrd_freemem(data);
+    }
+  }
+
+  read_ms = elapsed_ms(&begin);
+
+  print_result("RRD", write_ms, disk_usage(base), read_ms);
+}
+
+/* ******************************************* */
+
+static void run_tsdb(const char *base, u_int32_t tstart) {
+  TimeseriesStore *store = new (std::nothrow) TimeseriesStore(base);
+  lua_State *vm = luaL_newstate();
+  char key[64], tsdb_path[MAX_PATH];
+  struct timespec begin;
+  double write_ms, read_ms;
+
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+
+  for(u_int32_t p = 0; p < num_points; p++) {
+    for(u_int32_t s = 0; s < num_series; s++) {
+      double values[2];
+
+      point_values(s, p, values);
+      snprintf(key, sizeof(key), "ifid=0,host=10.0.%u.%u", s / 256, s % 256);
+      store->append("host:traffic", key, tstart + p * BENCH_STEP, values, 2);
+    }
+  }
+
+  /* Head blocks are written at shutdown */
+  store->flush(true);
+
+  write_ms = elapsed_ms(&begin);
+
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+
+  for(u_int32_t s = 0; s < num_series; s++) {
+    snprintf(key, sizeof(key), "ifid=0,host=10.0.%u.%u", s / 256, s % 256);
+    store->fetch(vm, "host:traffic", key, tstart, tstart + num_points * BENCH_STEP,
+		 BENCH_STEP, ts_cf_average, true /* counter */);
+    lua_settop(vm, 0);
+  }
+
+  read_ms = elapsed_ms(&begin);
+
+  snprintf(tsdb_path, sizeof(tsdb_path), "%s/tsdb", base);
+  print_result("TimeseriesStore", write_ms, disk_usage(tsdb_path), read_ms);
+
+  lua_close(vm);
+  delete store;
+}
+
+/* ******************************************* */
+
+int main(int argc, char *argv[]) {
+  Prefs *prefs;
+  char rrd_dir[] = "/tmp/ts_bench_rrd.XXXXXX", tsdb_dir[] = "/tmp/ts_bench_tsdb.XXXXXX";
+  /* A day aligned start, as the points fall in a single segment */
+  u_int32_t tstart = time(NULL) - 2 * 86400;
+
+  tstart -= tstart % 86400;
+
+  if((ntop = new (std::nothrow) Ntop("ntopng")) == NULL)
+    return(-1);
+
+  prefs = new (std::nothrow) Prefs(ntop);
+  ntop->registerPrefs(prefs, false);
+  ntop->getTrace()->set_trace_level(TRACE_LEVEL_ERROR);
+
+  if(argc > 1) num_series = atoi(argv[1]);
+  if(argc > 2) num_points = min_val((u_int32_t)atoi(argv[2]), (u_int32_t)(86400 / BENCH_STEP));
+
+  if(!mkdtemp(rrd_dir) || !mkdtemp(tsdb_dir)) {
+    printf("Unable to create the bench directories\n");
+    return(-1);
+  }
+
+  printf("%u series, %u points each\n", num_series, num_points);
+  printf("%-18s %12s %14s %12s %14s\n", "Store", "Write (ms)", "Points/sec", "Bytes/point", "Read/serie (ms)");
+
+  run_rrd(rrd_dir, tstart);
+  run_tsdb(tsdb_dir, tstart);
+
+  Utils::remove_recursively(rrd_dir);
+  Utils::remove_recursively(tsdb_dir);
+
+  delete ntop;
+
+  return(0);
+}
@@ -0,0 +1,506 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+/*
+  Replays nProbe-like ZMQ flow messages from N local publishers and compares
+  the two ways ZMQCollectorInterface can consume them: a single thread polling
+  all the endpoints, receiving and decoding every message (as when
+  --zmq-collector-workers is not set), and one worker per endpoint receiving
+  and decoding, that hands the decoded flows to a single consumer through an
+  SPSCQueue (as with --zmq-collector-workers N). The consumer only
+  accumulates what it dequeues, so the reported rates are an upper bound of
+  what the receive/decode stage can feed to processFlow().
+
+  Endpoints are PUSH/PULL over inproc so that publishers block on the
+  high-water mark instead of dropping, and both runs see the same messages.
+  Messages can be sent as LZ4 or Zstd frames (flagged in the header version
+  as nProbe does), which are then decompressed into a reused arena before
+  being decoded.
+
+  make tests/bench/ZMQCollectorReplayBench
+  ./tests/bench/ZMQCollectorReplayBench [endpoints] [messages per endpoint] [none|lz4|zstd]
+*/
+
+#include "ntop_includes.h"
+#include "BenchUtils.h"
+
+AfterShutdownAction afterShutdownAction = after_shutdown_nop;
+
+#define MAX_ENDPOINTS        16
+#define DEQUEUE_BATCH        256
+
+/* Extra template labels, to get a label map of the size sent by nProbe */
+#define NUM_TEMPLATE_LABELS  400
+#define FLOWS_PER_MESSAGE    16
+#define NUM_SYNTH_MESSAGES   1024
+
+static const char *labels[] = {
+  "IN_SRC_MAC", "OUT_DST_MAC", "SRC_VLAN", "INPUT_SNMP", "OUTPUT_SNMP", "IPV4_SRC_ADDR",
+  "IPV4_DST_ADDR", "SRC_TOS", "L4_SRC_PORT", "L4_DST_PORT", "IPV6_SRC_ADDR", "IPV6_DST_ADDR",
+  "IP_PROTOCOL_VERSION", "PROTOCOL", "L7_PROTO", "L7_PROTO_NAME", "L7_INFO", "IN_BYTES",
+  "IN_PKTS", "OUT_BYTES", "OUT_PKTS", "FIRST_SWITCHED", "LAST_SWITCHED", "TCP_FLAGS",
+  "CLIENT_TCP_FLAGS", "SERVER_TCP_FLAGS", "EXPORTER_IPV4_ADDRESS", "DIRECTION",
+  "HTTP_URL", "HTTP_SITE", "HTTP_USER_AGENT", "DNS_QUERY", "TLS_SERVER_NAME",
+  "JA3C_HASH", "CLIENT_NW_LATENCY_MS", "SERVER_NW_LATENCY_MS", "L7_PROTO_RISK", NULL
+};
+
+static std::vector<std::string> messages; /* As sent, compressed when compression is set */
+static u_int8_t compression = 0;
+static PerfectHash hash;
+static void *zmq_ctx;
+static u_int32_t num_msgs_per_endpoint;
+
+/* ******************************************* */
+
+static std::string synth_message() {
+  std::string msg("[");
+  char buf[256];
+
+  for(int i = 0; i < FLOWS_PER_MESSAGE; i++) {
+    snprintf(buf, sizeof(buf),
+	     "%s{\"IPV4_SRC_ADDR\":\"192.168.%u.%u\",\"IPV4_DST_ADDR\":\"10.%u.%u.%u\","
+	     "\"L4_SRC_PORT\":%u,\"L4_DST_PORT\":443,\"PROTOCOL\":6,\"IP_PROTOCOL_VERSION\":4,",
+	     i ? "," : "", rand() % 256, rand() % 256, rand() % 256, rand() % 256, rand() % 256,
+	     1024 + rand() % 60000);
+    msg += buf;
+    snprintf(buf, sizeof(buf),
+	     "\"IN_BYTES\":%u,\"IN_PKTS\":%u,\"OUT_BYTES\":%u,\"OUT_PKTS\":%u,"
+	     "\"FIRST_SWITCHED\":%u,\"LAST_SWITCHED\":%u,\"TCP_FLAGS\":27,\"SRC_VLAN\":0,",
+	     rand() % 1000000, rand() % 1000, rand() % 1000000, rand() % 1000,
+	     1650000000 + i, 1650000060 + i);
+    msg += buf;
+    snprintf(buf, sizeof(buf),
+	     "\"INPUT_SNMP\":%u,\"OUTPUT_SNMP\":%u,\"L7_PROTO\":\"91.126\",\"L7_PROTO_NAME\":\"TLS.Google\","
+	     "\"TLS_SERVER_NAME\":\"www.example%u.com\",\"JA3C_HASH\":\"e7d705a3286e19ea42f587b344ee6865\",",
+	     rand() % 16, rand() % 16, rand() % 1000);
+    msg += buf;
+    snprintf(buf, sizeof(buf),
+	     "\"CLIENT_NW_LATENCY_MS\":%.3f,\"SERVER_NW_LATENCY_MS\":%.3f,\"57943\":\"\\/path\\u0021\","
+	     "\"EXPORTER_IPV4_ADDRESS\":\"172.16.0.1\",\"DIRECTION\":0,\"FIELD_%u\":%u}",
+	     (rand() % 100000) / 1000.0, (rand() % 100000) / 1000.0, rand() % NUM_TEMPLATE_LABELS, rand());
+    msg += buf;
+  }
+
+  msg += "]";
+  return(msg);
+}
+
+/* ******************************************* */
+
+/* Frames msg as nProbe does for the selected compression. False on error */
+static bool compress_message(const std::string &msg, std::string *frame) {
+  switch(compression) {
+#ifdef HAVE_LZ4
+  case ZMQ_MSG_COMPRESSION_LZ4:
+    {
+      u_int32_t len = htonl(msg.size());
+      int bound = LZ4_compressBound(msg.size()), rc;
+
+      frame->resize(sizeof(len) + bound);
+      memcpy(&(*frame)[0], &len, sizeof(len));
+
+      if((rc = LZ4_compress_default(msg.c_str(), &(*frame)[sizeof(len)], msg.size(), bound)) <= 0)
+	return(false);
+
+      frame->resize(sizeof(len) + rc);
+    }
+    return(true);
+#endif
+
+#ifdef HAVE_ZSTD
+  case ZMQ_MSG_COMPRESSION_ZSTD:
+    {
+      size_t rc;
+
+      frame->resize(ZSTD_compressBound(msg.size()));
+
+      if(ZSTD_isError(rc = ZSTD_compress(&(*frame)[0], frame->size(), msg.c_str(), msg.size(), ZSTD_CLEVEL_DEFAULT)))
+	return(false);
+
+      frame->resize(rc);
+    }
+    return(true);
+#endif
+
+  case 0:
+    *frame = msg;
+    return(true);
+
+  default:
+    return(false);
+  }
+}
+
+/* ******************************************* */
+
+/*
+  Decompresses a frame into the arena of ctx, as
+  ZMQCollectorInterface::decompress() does. Returns the uncompressed length,
+  -1 on error.
+*/
+static int decompress_frame(const char *src, u_int32_t src_len, ZMQRecvContext *ctx) {
+  switch(compression) {
+#ifdef HAVE_LZ4
+  case ZMQ_MSG_COMPRESSION_LZ4:
+    {
+      u_int32_t len;
+
+      if(src_len < sizeof(len))
+	break;
+
+      memcpy(&len, src, sizeof(len));
+      len = ntohl(len);
+
+      if((len > MAX_ZMQ_DECOMPRESSED_LEN) || !ctx->reserveArena(len))
+	break;
+
+      return(LZ4_decompress_safe(&src[sizeof(len)], ctx->arena, src_len - sizeof(len), len));
+    }
+#endif
+
+#ifdef HAVE_ZSTD
+  case ZMQ_MSG_COMPRESSION_ZSTD:
+    {
+      unsigned long long content_len = ZSTD_getFrameContentSize(src, src_len);
+      size_t rc;
+
+      /* Frames are compressed in one shot, their content size is known */
+      if((content_len >= MAX_ZMQ_DECOMPRESSED_LEN) || !ctx->reserveArena((u_int32_t)content_len))
+	break;
+
+      rc = ZSTD_decompress(ctx->arena, (size_t)content_len, src, src_len);
+      return(ZSTD_isError(rc) ? -1 : (int)rc);
+    }
+#endif
+
+  default:
+    break;
+  }
+
+  return(-1);
+}
+
+/* ******************************************* */
+
+/* Sums the label ids and values of a flow, as parseJSONFlow() would look them up */
+static u_int64_t decode_flow(JSONScanner *s) {
+  json_scanner_value_t v;
+  u_int64_t sum = 0, pen_field;
+  char *key;
+  u_int32_t key_len;
+
+  if(!s->enterObject()) return(0);
+
+  while(s->nextMember(&key, &key_len) && s->readValue(&v)) {
+    if(hash.find(key, key_len, &pen_field))
+      sum = (sum * 31) + pen_field;
+
+    sum += (v.type == json_scanner_string) ? v.len : (u_int64_t)v.int_num;
+  }
+
+  return(sum);
+}
+
+/* ******************************************* */
+
+/*
+  Receives a message (header + payload, as recvMessage() does) and decodes
+  its flows in place, or in the arena once decompressed. Returns the number
+  of flows, 0 when the socket is closed.
+*/
+static u_int32_t recv_and_decode(void *socket, ZMQRecvContext *ctx, u_int64_t *sums) {
+  struct zmq_msg_hdr h;
+  u_int32_t num_flows = 0;
+  char *payload;
+  int size;
+
+  if(zmq_recv(socket, &h, sizeof(h), 0) != sizeof(h)) return(0);
+  if((size = zmq_msg_recv(&ctx->payload, socket, 0)) <= 0) return(0);
+
+  payload = (char*)zmq_msg_data(&ctx->payload);
+
+  if(h.version & ZMQ_MSG_COMPRESSION_MASK) {
+    if((size = decompress_frame(payload, size, ctx)) < 0) return(0);
+
+    payload = ctx->arena, payload[size] = '\0';
+    ctx->num_decompressed++;
+  }
+
+  JSONScanner s(payload, size);
+
+  if(s.peek() == '[') {
+    s.enterArray();
+    while(s.nextElement())
+      sums[num_flows++] = decode_flow(&s);
+  } else
+    sums[num_flows++] = decode_flow(&s);
+
+  return(num_flows);
+}
+
+/* ******************************************* */
+
+static void* publisher(void *ptr) {
+  void *socket = ptr;
+  struct zmq_msg_hdr h;
+
+  memset(&h, 0, sizeof(h));
+  strncpy(h.url, "flow", sizeof(h.url));
+  h.version = ZMQ_MSG_VERSION | compression;
+
+  for(u_int32_t i = 0; i < num_msgs_per_endpoint; i++) {
+    const std::string &msg = messages[i % messages.size()];
+
+    h.msg_id = htonl(i + 1);
+    zmq_send(socket, &h, sizeof(h), ZMQ_SNDMORE);
+    zmq_send(socket, msg.c_str(), msg.size(), 0);
+  }
+
+  return(NULL);
+}
+
+/* ******************************************* */
+
+static bool open_endpoints(u_int32_t run, u_int32_t n, void **push, void **pull) {
+  for(u_int32_t i = 0; i < n; i++) {
+    char endpoint[64];
+
+    snprintf(endpoint, sizeof(endpoint), "inproc://replay.%u.%u", run, i);
+
+    if(((pull[i] = zmq_socket(zmq_ctx, ZMQ_PULL)) == NULL)
+       || (zmq_bind(pull[i], endpoint) != 0)
+       || ((push[i] = zmq_socket(zmq_ctx, ZMQ_PUSH)) == NULL)
+       || (zmq_connect(push[i], endpoint) != 0))
+      return(false);
+  }
+
+  return(true);
+}
+
+/* ******************************************* */
+
+static void close_endpoints(u_int32_t n, void **push, void **pull) {
+  for(u_int32_t i = 0; i < n; i++) {
+    zmq_close(push[i]);
+    zmq_close(pull[i]);
+  }
+}
+
+/* ******************************************* */
+
+/* Single thread polling all the endpoints */
+static u_int64_t run_single(u_int32_t n, void **pull, u_int64_t *num_flows) {
+  zmq_pollitem_t items[MAX_ENDPOINTS];
+  u_int64_t sums[FLOWS_PER_MESSAGE * 4], sum = 0;
+  u_int32_t remaining = n * num_msgs_per_endpoint;
+  ZMQRecvContext ctx;
+
+  for(u_int32_t i = 0; i < n; i++)
+    items[i].socket = pull[i], items[i].fd = 0, items[i].events = ZMQ_POLLIN;
+
+  while(remaining > 0) {
+    for(u_int32_t i = 0; i < n; i++) items[i].revents = 0;
+
+    if(zmq_poll(items, n, MAX_ZMQ_POLL_WAIT_MS) <= 0)
+      continue;
+
+    for(u_int32_t i = 0; i < n; i++) {
+      if(items[i].revents & ZMQ_POLLIN) {
+	u_int32_t num = recv_and_decode(pull[i], &ctx, sums);
+
+	for(u_int32_t j = 0; j < num; j++) sum += sums[j];
+	*num_flows += num, remaining--;
+      }
+    }
+  }
+
+  return(sum);
+}
+
+/* ******************************************* */
+
+typedef struct {
+  void *socket;
+  SPSCQueue<u_int64_t> *queue;
+  u_int64_t num_queue_full;
+} replay_worker_t;
+
+static void* worker(void *ptr) {
+  replay_worker_t *w = (replay_worker_t*)ptr;
+  u_int64_t sums[FLOWS_PER_MESSAGE * 4];
+  ZMQRecvContext ctx;
+
+  for(u_int32_t i = 0; i < num_msgs_per_endpoint; i++) {
+    u_int32_t num = recv_and_decode(w->socket, &ctx, sums);
+
+    for(u_int32_t j = 0; j < num; j++) {
+      /* Decoded flows are handed over, the worker waits when the consumer lags */
+      while(!w->queue->enqueue(sums[j], false)) {
+	w->queue->flush();
+	w->num_queue_full++;
+	_usleep(10);
+      }
+    }
+
+    w->queue->flush();
+  }
+
+  return(NULL);
+}
+
+/* ******************************************* */
+
+/* A worker per endpoint, decoded flows consumed by the calling thread */
+static u_int64_t run_workers(u_int32_t n, void **pull, u_int64_t *num_flows, u_int64_t *num_queue_full) {
+  replay_worker_t workers[MAX_ENDPOINTS];
+  pthread_t threads[MAX_ENDPOINTS];
+  u_int64_t items[DEQUEUE_BATCH], sum = 0;
+  u_int64_t expected = (u_int64_t)n * num_msgs_per_endpoint * FLOWS_PER_MESSAGE;
+
+  for(u_int32_t i = 0; i < n; i++) {
+    workers[i].socket = pull[i], workers[i].num_queue_full = 0;
+    workers[i].queue = new SPSCQueue<u_int64_t>(ZMQ_COLLECTOR_QUEUE_LEN, "replay");
+    pthread_create(&threads[i], NULL, worker, &workers[i]);
+  }
+
+
+  while(*num_flows < expected) {
+    u_int32_t num_items = 0;
+
+    for(u_int32_t i = 0; i < n; i++) {
+      u_int32_t num = workers[i].queue->dequeueBatch(items, DEQUEUE_BATCH);
+
+      for(u_int32_t j = 0; j < num; j++) sum += items[j];
+      num_items += num;
+    }
+
+    *num_flows += num_items;
+    if(num_items == 0) _usleep(10);
+  }
+
+  for(u_int32_t i = 0; i < n; i++) {
+    pthread_join(threads[i], NULL);
+    *num_queue_full += workers[i].num_queue_full;
+    delete workers[i].queue;
+  }
+
+  return(sum);
+}
+
+/* ******************************************* */
+
+int main(int argc, char *argv[]) {
+  std::vector<std::pair<std::string, u_int64_t> > entries;
+  u_int32_t n = (argc > 1) ? atoi(argv[1]) : 4;
+  void *push[MAX_ENDPOINTS], *pull[MAX_ENDPOINTS];
+  pthread_t publishers[MAX_ENDPOINTS];
+  u_int64_t single_flows = 0, workers_flows = 0, num_queue_full = 0;
+  u_int64_t single_sum, workers_sum, bytes = 0, frame_bytes = 0;
+  const char *format = (argc > 3) ? argv[3] : "none";
+  struct timespec begin;
+  double single_ms, workers_ms;
+
+  num_msgs_per_endpoint = (argc > 2) ? atoi(argv[2]) : 20000;
+  n = min_val(max_val(n, 1), MAX_ENDPOINTS);
+
+  if(!strcmp(format, "lz4"))
+    compression = ZMQ_MSG_COMPRESSION_LZ4;
+  else if(!strcmp(format, "zstd"))
+    compression = ZMQ_MSG_COMPRESSION_ZSTD;
+  else if(strcmp(format, "none")) {
+    printf("Unknown compression %s, use none, lz4 or zstd\n", format);
+    return(1);
+  }
+
+  for(u_int32_t i = 0; labels[i]; i++)
+    entries.push_back(std::make_pair(std::string(labels[i]), ((u_int64_t)((i % 3) ? 0 : NTOP_PEN) << 32) | (i + 1)));
+
+  for(u_int32_t i = 0; i < NUM_TEMPLATE_LABELS; i++) {
+    char name[32];
+
+    snprintf(name, sizeof(name), "FIELD_%u", i);
+    entries.push_back(std::make_pair(std::string(name), ((u_int64_t)NTOP_PEN << 32) | (1000 + i)));
+  }
+
+  if(!hash.build(entries)) {
+    printf("Unable to build the perfect hash\n");
+    return(1);
+  }
+
+  srand(7);
+  for(u_int32_t i = 0; i < NUM_SYNTH_MESSAGES; i++) {
+    std::string msg = synth_message(), frame;
+
+    if(!compress_message(msg, &frame)) {
+      printf("Unable to compress the messages with %s: ntopng compiled without support for it?\n", format);
+      return(1);
+    }
+
+    bytes += msg.size(), frame_bytes += frame.size();
+    messages.push_back(frame);
+  }
+
+  if((zmq_ctx = zmq_ctx_new()) == NULL)
+    return(1);
+
+  /* Single thread */
+  if(!open_endpoints(0, n, push, pull)) {
+    printf("Unable to open the endpoints\n");
+    return(1);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  for(u_int32_t i = 0; i < n; i++) pthread_create(&publishers[i], NULL, publisher, push[i]);
+  single_sum = run_single(n, pull, &single_flows);
+  single_ms = elapsed_ms(&begin);
+  for(u_int32_t i = 0; i < n; i++) pthread_join(publishers[i], NULL);
+  close_endpoints(n, push, pull);
+
+  /* A worker per endpoint */
+  if(!open_endpoints(1, n, push, pull)) {
+    printf("Unable to open the endpoints\n");
+    return(1);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  for(u_int32_t i = 0; i < n; i++) pthread_create(&publishers[i], NULL, publisher, push[i]);
+  workers_sum = run_workers(n, pull, &workers_flows, &num_queue_full);
+  workers_ms = elapsed_ms(&begin);
+  for(u_int32_t i = 0; i < n; i++) pthread_join(publishers[i], NULL);
+  close_endpoints(n, push, pull);
+
+  zmq_ctx_destroy(zmq_ctx);
+
+  printf("%u endpoints, %u messages per endpoint [%.1f KB avg, %u flows each, %s frames of %.1f KB avg]\n",
+	 n, num_msgs_per_endpoint, bytes / 1024.0 / messages.size(), FLOWS_PER_MESSAGE,
+	 format, frame_bytes / 1024.0 / messages.size());
+  printf("%-10s %12s %12s %12s %14s\n", "Receiver", "Flows", "Time (ms)", "Msgs/s", "Flows/s");
+  printf("%-10s %12llu %12.2f %12.0f %14.0f\n", "single", (unsigned long long)single_flows, single_ms,
+	 (n * num_msgs_per_endpoint) / (single_ms / 1e3), single_flows / (single_ms / 1e3));
+  printf("%-10s %12llu %12.2f %12.0f %14.0f\n", "workers", (unsigned long long)workers_flows, workers_ms,
+	 (n * num_msgs_per_endpoint) / (workers_ms / 1e3), workers_flows / (workers_ms / 1e3));
+  printf("Speedup %.1fx, %llu queue full waits, results %s\n", single_ms / workers_ms,
+	 (unsigned long long)num_queue_full,
+	 ((single_sum == workers_sum) && (single_flows == workers_flows)) ? "identical" : "DIFFERENT");
+
+  return(0);
+}
@@ -0,0 +1,273 @@
+/*
+ *
+ * (C) 2013-22 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+/*
+  Replays ZMQ JSON flow messages through ZMQParserInterface::parseJSONFlow(),
+  decoding them into ParsedFlow as ZMQCollectorWorker does, and compares it
+  with a json-c DOM walk with std::map label lookups (the decoding used
+  before JSONScanner, without filling any ParsedFlow). Both must find the
+  same number of flows. Reported rates are for a single thread, i.e. flows/s
+  per core.
+
+  Messages are read from a file, one JSON message (flow object or array of
+  flows, as sent by nProbe) per line; when no file is given nProbe-like
+  messages are synthesized.
+
+  make tests/bench/ZMQJSONParseBench
+  ./tests/bench/ZMQJSONParseBench [messages file] [rounds]
+*/
+
+#include "ntop_includes.h"
+#include "BenchUtils.h"
+
+AfterShutdownAction afterShutdownAction = after_shutdown_nop;
+
+/* Extra template labels, to get a label map of the size sent by nProbe */
+#define NUM_TEMPLATE_LABELS  400
+#define FLOWS_PER_MESSAGE    16
+#define NUM_SYNTH_MESSAGES   4096
+#define BENCH_TEMPLATE_PEN   99999
+
+static const char *labels[] = {
+  "IN_SRC_MAC", "OUT_DST_MAC", "SRC_VLAN", "INPUT_SNMP", "OUTPUT_SNMP", "IPV4_SRC_ADDR",
+  "IPV4_DST_ADDR", "SRC_TOS", "L4_SRC_PORT", "L4_DST_PORT", "IPV6_SRC_ADDR", "IPV6_DST_ADDR",
+  "IP_PROTOCOL_VERSION", "PROTOCOL", "L7_PROTO", "L7_PROTO_NAME", "L7_INFO", "IN_BYTES",
+  "IN_PKTS", "OUT_BYTES", "OUT_PKTS", "FIRST_SWITCHED", "LAST_SWITCHED", "TCP_FLAGS",
+  "CLIENT_TCP_FLAGS", "SERVER_TCP_FLAGS", "EXPORTER_IPV4_ADDRESS", "DIRECTION",
+  "HTTP_URL", "HTTP_SITE", "HTTP_USER_AGENT", "DNS_QUERY", "TLS_SERVER_NAME",
+  "JA3C_HASH", "CLIENT_NW_LATENCY_MS", "SERVER_NW_LATENCY_MS", "L7_PROTO_RISK", NULL
+};
+
+typedef std::map<std::string, std::pair<u_int32_t, u_int32_t> > labels_map_t;
+
+/* ******************************************* */
+
+static u_int64_t checksum(u_int64_t sum, u_int32_t pen, u_int32_t field, int64_t int_num, u_int32_t str_len) {
+  return((sum * 31) + ((u_int64_t)pen << 40) + ((u_int64_t)field << 20) + (u_int64_t)int_num + str_len);
+}
+
+/* ******************************************* */
+
+static u_int64_t decode_jsonc(const char *msg, const labels_map_t *map, u_int32_t *num_flows) {
+  json_object *f = json_tokener_parse(msg);
+  u_int64_t sum = 0;
+  int n;
+
+  if(!f) return(0);
+
+  n = (json_object_get_type(f) == json_type_array) ? json_object_array_length(f) : 1;
+
+  for(int i = 0; i < n; i++) {
+    json_object *o = (json_object_get_type(f) == json_type_array) ? json_object_array_get_idx(f, i) : f;
+    struct json_object_iterator it = json_object_iter_begin(o), itEnd = json_object_iter_end(o);
+    u_int64_t flow_sum = 0;
+
+    while(!json_object_iter_equal(&it, &itEnd)) {
+      const char *key = json_object_iter_peek_name(&it);
+      json_object *jvalue = json_object_iter_peek_value(&it);
+      labels_map_t::const_iterator l = map->find(std::string(key));
+      u_int32_t pen = UNKNOWN_PEN, field = UNKNOWN_FLOW_ELEMENT;
+      int64_t int_num = 0;
+      u_int32_t str_len = 0;
+
+      if(l != map->end()) pen = l->second.first, field = l->second.second;
+
+      switch(json_object_get_type(jvalue)) {
+      case json_type_int:    int_num = json_object_get_int64(jvalue); break;
+      case json_type_double: int_num = (int64_t)json_object_get_double(jvalue); break;
+      case json_type_string: str_len = strlen(json_object_get_string(jvalue)); break;
+      default: break;
+      }
+
+      flow_sum = checksum(flow_sum, pen, field, int_num, str_len);
+      json_object_iter_next(&it);
+    }
+
+    sum += flow_sum;
+    (*num_flows)++;
+  }
+
+  json_object_put(f);
+  return(sum);
+}
+
+/* ******************************************* */
+
+/* Flows are decoded into ParsedFlow and handed over, as done by ZMQCollectorWorker */
+static void decode_iface(ZMQParserInterface *iface, ZMQParserContext *ctx,
+			 const std::string *msg, char *buf, u_int32_t *num_flows) {
+  /* The message is parsed in place: restore it as it is replayed */
+  memcpy(buf, msg->c_str(), msg->size());
+
+  iface->parseJSONFlow(buf, msg->size(), 0 /* source_id */, ctx);
+
+  *num_flows += ctx->parsed_flows->size();
+
+  for(std::vector<ParsedFlow*>::const_iterator it = ctx->parsed_flows->begin(); it != ctx->parsed_flows->end(); ++it)
+    delete *it;
+
+  ctx->parsed_flows->clear();
+}
+
+/* ******************************************* */
+
+static std::string synth_message() {
+  std::string msg("[");
+  char buf[256];
+
+  for(int i = 0; i < FLOWS_PER_MESSAGE; i++) {
+    snprintf(buf, sizeof(buf),
+	     "%s{\"IPV4_SRC_ADDR\":\"192.168.%u.%u\",\"IPV4_DST_ADDR\":\"10.%u.%u.%u\","
+	     "\"L4_SRC_PORT\":%u,\"L4_DST_PORT\":443,\"PROTOCOL\":6,\"IP_PROTOCOL_VERSION\":4,",
+	     i ? "," : "", rand() % 256, rand() % 256, rand() % 256, rand() % 256, rand() % 256,
+	     1024 + rand() % 60000);
+    msg += buf;
+    snprintf(buf, sizeof(buf),
+	     "\"IN_BYTES\":%u,\"IN_PKTS\":%u,\"OUT_BYTES\":%u,\"OUT_PKTS\":%u,"
+	     "\"FIRST_SWITCHED\":%u,\"LAST_SWITCHED\":%u,\"TCP_FLAGS\":27,\"SRC_VLAN\":0,",
+	     rand() % 1000000, rand() % 1000, rand() % 1000000, rand() % 1000,
+	     1650000000 + i, 1650000060 + i);
+    msg += buf;
+    snprintf(buf, sizeof(buf),
+	     "\"INPUT_SNMP\":%u,\"OUTPUT_SNMP\":%u,\"L7_PROTO\":\"91.126\",\"L7_PROTO_NAME\":\"TLS.Google\","
+	     "\"TLS_SERVER_NAME\":\"www.example%u.com\",\"JA3C_HASH\":\"e7d705a3286e19ea42f587b344ee6865\",",
+	     rand() % 16, rand() % 16, rand() % 1000);
+    msg += buf;
+    snprintf(buf, sizeof(buf),
+	     "\"CLIENT_NW_LATENCY_MS\":%.3f,\"SERVER_NW_LATENCY_MS\":%.3f,\"57943\":\"\\/path\\u0021\","
+	     "\"EXPORTER_IPV4_ADDRESS\":\"172.16.0.1\",\"DIRECTION\":0,\"FIELD_%u\":%u}",
+	     (rand() % 100000) / 1000.0, (rand() % 100000) / 1000.0, rand() % NUM_TEMPLATE_LABELS, rand());
+    msg += buf;
+  }
+
+  msg += "]";
+  return(msg);
+}
+
+/* ******************************************* */
+
+int main(int argc, char *argv[]) {
+  std::vector<std::string> messages;
+  std::vector<ParsedFlow*> parsed_flows;
+  std::string tmpl("[");
+  labels_map_t map;
+  ZMQParserInterface *iface;
+  ZMQParserContext ctx;
+  Prefs *prefs;
+  u_int32_t rounds = (argc > 2) ? atoi(argv[2]) : 10, max_len = 0;
+  u_int32_t jsonc_flows = 0, iface_flows = 0;
+  u_int64_t jsonc_sum = 0, bytes = 0;
+  struct timespec begin;
+  double jsonc_ms, iface_ms;
+  char *buf;
+
+  if((ntop = new (std::nothrow) Ntop("ntopng")) == NULL)
+    return(-1);
+
+  prefs = new (std::nothrow) Prefs(ntop);
+  ntop->registerPrefs(prefs, false);
+  ntop->getTrace()->set_trace_level(TRACE_LEVEL_ERROR);
+
+  if((iface = new (std::nothrow) ZMQParserInterface("zmq-bench")) == NULL)
+    return(-1);
+
+  for(u_int32_t i = 0; labels[i]; i++)
+    map[labels[i]] = std::make_pair((i % 3) ? 0 : NTOP_PEN, i + 1);
+
+  /* Template labels, with a PEN unknown to the parser so that they land in the additional fields */
+  for(u_int32_t i = 0; i < NUM_TEMPLATE_LABELS; i++) {
+    char name[32], entry[128];
+
+    snprintf(name, sizeof(name), "FIELD_%u", i);
+    map[name] = std::make_pair(BENCH_TEMPLATE_PEN, 1000 + i);
+
+    snprintf(entry, sizeof(entry), "%s{\"PEN\":%u,\"field\":%u,\"name\":\"%s\"}",
+	     i ? "," : "", BENCH_TEMPLATE_PEN, 1000 + i, name);
+    tmpl += entry;
+  }
+
+  tmpl += "]";
+  iface->parseTemplate(tmpl.c_str(), tmpl.size(), 0 /* source_id */, iface);
+  ctx.parsed_flows = &parsed_flows;
+
+  if(argc > 1) {
+    FILE *fd = fopen(argv[1], "r");
+    char *line = NULL;
+    size_t line_size = 0;
+    ssize_t len;
+
+    if(!fd) {
+      printf("Unable to open %s\n", argv[1]);
+      return(1);
+    }
+
+    while((len = getline(&line, &line_size, fd)) > 0) {
+      while((len > 0) && ((line[len - 1] == '\n') || (line[len - 1] == '\r'))) line[--len] = '\0';
+      if(len > 0) messages.push_back(std::string(line, len));
+    }
+
+    free(line);
+    fclose(fd);
+  } else {
+    srand(7);
+    for(u_int32_t i = 0; i < NUM_SYNTH_MESSAGES; i++)
+      messages.push_back(synth_message());
+  }
+
+  for(u_int32_t i = 0; i < messages.size(); i++) {
+    max_len = max(max_len, (u_int32_t)messages[i].size());
+    bytes += messages[i].size();
+  }
+
+  if((buf = (char*)malloc(max_len + 1)) == NULL)
+    return(1);
+
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  for(u_int32_t r = 0; r < rounds; r++)
+    for(u_int32_t i = 0; i < messages.size(); i++)
+      jsonc_sum += decode_jsonc(messages[i].c_str(), &map, &jsonc_flows);
+  jsonc_ms = elapsed_ms(&begin);
+
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  for(u_int32_t r = 0; r < rounds; r++)
+    for(u_int32_t i = 0; i < messages.size(); i++)
+      decode_iface(iface, &ctx, &messages[i], buf, &iface_flows);
+  iface_ms = elapsed_ms(&begin);
+
+  free(buf);
+
+  printf("%u messages [%.1f KB avg], %u labels, %u rounds\n",
+	 (u_int32_t)messages.size(), bytes / 1024.0 / messages.size(), (u_int32_t)map.size(), rounds);
+  printf("%-10s %12s %12s %14s %10s\n", "Decoder", "Flows", "Time (ms)", "Flows/s/core", "MB/s");
+  printf("%-10s %12u %12.2f %14.0f %10.1f\n", "json-c", jsonc_flows, jsonc_ms,
+	 jsonc_flows / (jsonc_ms / 1e3), (bytes * rounds) / (jsonc_ms * 1e3));
+  printf("%-10s %12u %12.2f %14.0f %10.1f\n", "parser", iface_flows, iface_ms,
+	 iface_flows / (iface_ms / 1e3), (bytes * rounds) / (iface_ms * 1e3));
+  printf("Speedup %.1fx, flows %s [%u invalid] [checksum %llu]\n", jsonc_ms / iface_ms,
+	 (jsonc_flows == iface_flows + ctx.num_invalid_flows) ? "identical" : "DIFFERENT",
+	 ctx.num_invalid_flows, (unsigned long long)jsonc_sum);
+
+  delete iface;
+  delete ntop;
+
+  return(0);
+}